@@ -0,0 +1,224 @@
+// アセンブリ出力のベンチマーク
+// codegen.cのスタックマシン方式と同じ形の関数を大量に出力し、従来のfprintf
+// （書式文字列、ラベルは毎回mallocした文字列）とAsmWriterの所要時間を比べる。
+// 両方の出力が一致することも確かめる。
+// さらに.oを直接書く場合と、テキストを外部のアセンブラ（cc -c）に通す場合も比べる。
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "asm_writer.h"
+
+#define FUNCTION_COUNT 200000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// 従来の出力（codegen.cがFILE*に書いていた命令列）
+static char* fprintf_new_label(size_t* counter) {
+    char* label = malloc(32);
+    if (label == NULL) return NULL;
+    sprintf(label, "L%zu", (*counter)++);
+    return label;
+}
+
+static void fprintf_function(FILE* out, const char* name, size_t index, size_t* counter) {
+    fprintf(out, "\n%s:\n", name);
+    fprintf(out, "    push rbp\n");
+    fprintf(out, "    mov rbp, rsp\n");
+    fprintf(out, "    sub rsp, %zu\n", (size_t)16);
+    fprintf(out, "    mov qword ptr [rbp - %zu], %s\n", (size_t)8, "rdi");
+
+    char* else_label = fprintf_new_label(counter);
+    char* end_label = fprintf_new_label(counter);
+    fprintf(out, "    mov rax, %" PRId64 "\n", (int64_t)index);
+    fprintf(out, "    push rax\n");
+    fprintf(out, "    mov rax, qword ptr [rbp - %zu]\n", (size_t)8);
+    fprintf(out, "    pop rbx\n");
+    fprintf(out, "    cmp rax, rbx\n");
+    fprintf(out, "    setl al\n");
+    fprintf(out, "    movzx eax, al\n");
+    fprintf(out, "    cmp rax, 0\n");
+    fprintf(out, "    je .%s\n", else_label);
+    fprintf(out, "    mov rax, qword ptr [rip + %s]\n", "counter");
+    fprintf(out, "    add rax, rbx\n");
+    fprintf(out, "    jmp .%s\n", end_label);
+    fprintf(out, ".%s:\n", else_label);
+    fprintf(out, "    lea rax, [rip + str_%zu]\n", index);
+    fprintf(out, ".%s:\n", end_label);
+    fprintf(out, "    mov rsp, rbp\n");
+    fprintf(out, "    pop rbp\n");
+    fprintf(out, "    ret\n");
+    free(else_label);
+    free(end_label);
+}
+
+static void writer_function(AsmWriter* out, const char* name, size_t index, size_t* counter) {
+    asm_text(out, "\n");
+    asm_symbol(out, name);
+    asm_emit1(out, ASM_PUSH, asm_reg(X86_RBP));
+    asm_emit(out, ASM_MOV, asm_reg(X86_RBP), asm_reg(X86_RSP));
+    asm_emit(out, ASM_SUB, asm_reg(X86_RSP), asm_imm(16));
+    asm_emit(out, ASM_MOV, asm_frame(-8), asm_reg(X86_RDI));
+
+    size_t else_label = (*counter)++;
+    size_t end_label = (*counter)++;
+    asm_emit(out, ASM_MOV, asm_reg(X86_RAX), asm_imm((int64_t)index));
+    asm_emit1(out, ASM_PUSH, asm_reg(X86_RAX));
+    asm_emit(out, ASM_MOV, asm_reg(X86_RAX), asm_frame(-8));
+    asm_emit1(out, ASM_POP, asm_reg(X86_RBX));
+    asm_emit(out, ASM_CMP, asm_reg(X86_RAX), asm_reg(X86_RBX));
+    asm_emit1(out, ASM_SETL, asm_reg8(X86_RAX));
+    asm_emit(out, ASM_MOVZX, asm_reg32(X86_RAX), asm_reg8(X86_RAX));
+    asm_emit(out, ASM_CMP, asm_reg(X86_RAX), asm_imm(0));
+    asm_emit1(out, ASM_JE, asm_label_ref(NULL, else_label));
+    asm_emit(out, ASM_MOV, asm_reg(X86_RAX), asm_global("counter"));
+    asm_emit(out, ASM_ADD, asm_reg(X86_RAX), asm_reg(X86_RBX));
+    asm_emit1(out, ASM_JMP, asm_label_ref(NULL, end_label));
+    asm_label(out, NULL, else_label);
+    asm_emit(out, ASM_LEA, asm_reg(X86_RAX), asm_string(index));
+    asm_label(out, NULL, end_label);
+    asm_emit(out, ASM_MOV, asm_reg(X86_RSP), asm_reg(X86_RBP));
+    asm_emit1(out, ASM_POP, asm_reg(X86_RBP));
+    asm_emit0(out, ASM_RET);
+}
+
+static char* read_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (text != NULL && fread(text, 1, (size_t)size, file) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    fclose(file);
+    *length = (size_t)size;
+    return text;
+}
+
+int main(void) {
+    char old_path[] = "/tmp/slang_asm_old_XXXXXX";
+    char new_path[] = "/tmp/slang_asm_new_XXXXXX";
+    int old_fd = mkstemp(old_path);
+    int new_fd = mkstemp(new_path);
+    if (old_fd < 0 || new_fd < 0) {
+        perror("asm_writer_bench: mkstemp");
+        return 1;
+    }
+    close(old_fd);
+    close(new_fd);
+
+    char name[32];
+    size_t counter = 0;
+
+    double start = now_seconds();
+    FILE* old_file = fopen(old_path, "w");
+    if (old_file == NULL) {
+        perror("asm_writer_bench: fopen");
+        return 1;
+    }
+    fprintf(old_file, ".intel_syntax noprefix\n");
+    for (size_t i = 0; i < FUNCTION_COUNT; i++) {
+        snprintf(name, sizeof(name), "f%zu", i);
+        fprintf_function(old_file, name, i, &counter);
+    }
+    if (fclose(old_file) != 0) {
+        perror("asm_writer_bench: fclose");
+        return 1;
+    }
+    double fprintf_ms = (now_seconds() - start) * 1e3;
+
+    counter = 0;
+    start = now_seconds();
+    AsmWriter writer;
+    if (!asm_writer_open(&writer, new_path)) {
+        perror("asm_writer_bench: open");
+        return 1;
+    }
+    asm_text(&writer, ".intel_syntax noprefix\n");
+    for (size_t i = 0; i < FUNCTION_COUNT; i++) {
+        snprintf(name, sizeof(name), "f%zu", i);
+        writer_function(&writer, name, i, &counter);
+    }
+    size_t bytes = writer.bytes_written + writer.length;
+    if (!asm_writer_close(&writer)) {
+        fprintf(stderr, "asm_writer_bench: write failed\n");
+        return 1;
+    }
+    double writer_ms = (now_seconds() - start) * 1e3;
+
+    size_t old_length = 0, new_length = 0;
+    char* old_text = read_file(old_path, &old_length);
+    char* new_text = read_file(new_path, &new_length);
+    bool same = old_text != NULL && new_text != NULL && old_length == new_length &&
+                memcmp(old_text, new_text, old_length) == 0;
+    free(old_text);
+    free(new_text);
+    unlink(old_path);
+    if (!same) {
+        unlink(new_path);
+        fprintf(stderr, "asm_writer_bench: output mismatch\n");
+        return 1;
+    }
+
+    // 同じ関数を.oとして直接書く
+    char object_path[] = "/tmp/slang_asm_obj_XXXXXX";
+    int object_fd = mkstemp(object_path);
+    if (object_fd < 0) {
+        perror("asm_writer_bench: mkstemp");
+        unlink(new_path);
+        return 1;
+    }
+    close(object_fd);
+
+    counter = 0;
+    start = now_seconds();
+    if (!asm_writer_open_object(&writer, object_path)) {
+        perror("asm_writer_bench: open");
+        return 1;
+    }
+    for (size_t i = 0; i < FUNCTION_COUNT; i++) {
+        snprintf(name, sizeof(name), "f%zu", i);
+        writer_function(&writer, name, i, &counter);
+    }
+    size_t object_bytes = 0;
+    bool object_ok = asm_writer_flush(&writer);
+    object_bytes = writer.bytes_written;
+    object_ok = asm_writer_close(&writer) && object_ok;
+    double object_ms = (now_seconds() - start) * 1e3;
+    unlink(object_path);
+    if (!object_ok) {
+        unlink(new_path);
+        fprintf(stderr, "asm_writer_bench: object write failed\n");
+        return 1;
+    }
+
+    // テキストを外部のアセンブラに通す時間（使えなければ省く）
+    char command[256];
+    snprintf(command, sizeof(command), "cc -c -x assembler %s -o %s.o 2>/dev/null", new_path, new_path);
+    start = now_seconds();
+    bool assembled = system(command) == 0;
+    double assembler_ms = (now_seconds() - start) * 1e3;
+    snprintf(command, sizeof(command), "%s.o", new_path);
+    unlink(command);
+    unlink(new_path);
+
+    printf("{\"benchmark\": \"asm_writer\", \"functions\": %d, \"bytes\": %zu, "
+           "\"fprintf_ms\": %.2f, \"asm_writer_ms\": %.2f, \"speedup\": %.2f, "
+           "\"object_bytes\": %zu, \"object_ms\": %.2f",
+           FUNCTION_COUNT, bytes, fprintf_ms, writer_ms, fprintf_ms / writer_ms, object_bytes, object_ms);
+    if (assembled) {
+        printf(", \"text_and_assembler_ms\": %.2f, \"object_speedup\": %.2f",
+               writer_ms + assembler_ms, (writer_ms + assembler_ms) / object_ms);
+    }
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,283 @@
+// ネイティブコード生成のベンチマーク
+// 小さなプログラムをそれぞれ一時ディレクトリに書き、-O0から-O2までの各レベルでdriver_compileにかけて
+// コンパイルの時間を測り、.oをccでリンクして実行した終了状態（決めてあれば標準出力も）が期待どおりかを
+// 確かめる（ccがなければリンクは省く）。スタックマシン方式に落ちる関数はアセンブリの出力も見て、
+// callee-savedのrbxを作業用に使っていないことを確かめる。floatのプログラムはSystem V ABIのxmm渡しと
+// 整数からの変換を、vec・mat4・quatのプログラムはブロックの受け渡しと解放を確かめる。関数の外へ出ない
+// ブロックは、-O0ではmallocで確保し、-O1からはエスケープ解析でフレームに置くことも確かめる。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "intern.h"
+#include "driver.h"
+
+#define REPEATS 20
+
+typedef struct {
+    const char* name;
+    const char* source;
+    int expected;              // mainの終了状態
+    const char* output;        // 標準出力に書くはずの内容（NULLなら見ない）
+} Program;
+
+static const Program programs[] = {
+    // 7個目の引数はレジスタに載らないので、関数全体がスタックマシン方式になる
+    { "stack_fallback",
+      "fn f(a, b, c, d, e, g, h) {\n"
+      "    let x = (a * b - c) / d % e;\n"
+      "    if x < g { return -x + h; }\n"
+      "    return x;\n"
+      "}\n"
+      "fn main() -> int { return f(7, 6, 2, 4, 7, 100, 50); }\n",
+      47, NULL },
+    // floatの引数と戻り値はxmmで渡す
+    { "float_square",
+      "fn sq(x: float) -> float { return x * x; }\n"
+      "fn main() -> int {\n"
+      "    let y = sq(1.5);\n"
+      "    if y > 2.0 && y < 2.5 { return 1; }\n"
+      "    return 0;\n"
+      "}\n",
+      1, NULL },
+    // 整数からfloatへの暗黙の変換と、関数の値を通した呼び出し（mainはスタックマシン方式になる）
+    { "float_mixed",
+      "fn scale(n: int, x: float, y: float) -> float {\n"
+      "    let t = n * 2;\n"
+      "    return x * t + y / 4;\n"
+      "}\n"
+      "fn pick(x: float) -> int { if x >= 10.0 { return 5; } return 2; }\n"
+      "fn main() -> int {\n"
+      "    let f = scale;\n"
+      "    let a = scale(3, 1.5, 2);\n"
+      "    let b: float = f(1, 2.0, 8.0);\n"
+      "    if a == 9.5 && b == 6.0 { return pick(a) + pick(a * 2); }\n"
+      "    return 1;\n"
+      "}\n",
+      7, NULL },
+    // 整数の引数がレジスタに載りきらず、floatの引数と混ざってスタックに並ぶ
+    { "float_stack_args",
+      "fn mix(a: int, x: float, b: int, y: float, c: int, d: int, e: int, f: int, g: int, h: float) -> float {\n"
+      "    let z: float = a + b;\n"
+      "    return z * x + y - h + c + d + e + f + g;\n"
+      "}\n"
+      "fn main() -> int {\n"
+      "    let r = mix(1, 2.0, 3, 0.5, 1, 1, 1, 1, 1, 0.5);\n"
+      "    let n: float = 2;\n"
+      "    if r == 13.0 && -n < 0.0 { return 42; }\n"
+      "    return 7;\n"
+      "}\n",
+      42, NULL },
+    // 最上位のletの初期化式は畳み込んで.dataに置く
+    { "global_init",
+      "let g = 5;\n"
+      "let h: float = 2;\n"
+      "let k = -(3 * 4) + 1;\n"
+      "fn main() -> int {\n"
+      "    if h == 2.0 && k == -11 { return g * 5 + 4; }\n"
+      "    return 0;\n"
+      "}\n",
+      29, NULL },
+    // ログのマクロはprintfの呼び出しになり、ロガーのないインタプリタと同じ行を書く
+    // （fはスタックマシン方式で、rspを揃えてから呼ぶ）
+    { "log_macros",
+      "fn f(a, b, c, d, e, g, h) { debug!(\"in f {} {}\", 1.5, a > 0); return a; }\n"
+      "fn main() -> int {\n"
+      "    let n = 3;\n"
+      "    log!(\"Hello, World!\");\n"
+      "    info!(\"n = {}, x = {} 100%\", n, 2.5, \"tail\");\n"
+      "    error!(n);\n"
+      "    return f(4, 2, 3, 4, 5, 6, 7);\n"
+      "}\n",
+      4, "Hello, World!\n[info] n = 3, x = 2.5 100% tail\n[error] 3\n[debug] in f 1.5 true\n" },
+    // 数学の型の組み込み関数と演算（`acc = acc + a`はaccのブロックに直接書き、引数は借用で渡すので、
+    // どのブロックも外へ出ない）
+    { "vector_math",
+      "fn len2(v: vec3) -> float { return dot(v, v); }\n"
+      "fn main() -> int {\n"
+      "    let a = vec3(1.0, 2.0, 3.0);\n"
+      "    let b: vec3 = vec3(4, 5, 6);\n"
+      "    let c = a + b * 2.0 - -a;\n"
+      "    let m = mat4(vec4(1, 0, 0, 0), vec4(0, 2, 0, 0), vec4(0, 0, 3, 0), vec4(1, 1, 1, 1));\n"
+      "    let p = m * vec4(1, 1, 1, 1);\n"
+      "    let q = quat(0, 1, 0, 0) * quat(0, 0, 1, 0);\n"
+      "    let n = 0;\n"
+      "    let acc = vec3(0, 0, 0);\n"
+      "    while n < 10 { acc = acc + a; n = n + 1; }\n"
+      "    log!(\"{} {} {} {} {} {}\", len2(a), at(c, 0), at(p, 1), at(q, 3), at(acc, 2), at(at(m * m, 3), 2));\n"
+      "    return n + 8;\n"
+      "}\n",
+      18, "14 10 3 1 30 4\n" },
+    // 数学の型の値は呼び出し先が作ったブロックで返り、代入する引数は呼び出し元のブロックを書き換えない
+    { "vector_calls",
+      "fn pick(v: vec2, flag: bool) -> vec2 {\n"
+      "    if flag { v = v * 3; }\n"
+      "    let w = v;\n"
+      "    while true {\n"
+      "        let t = w + v;\n"
+      "        if at(t, 0) > 0.0 { return t; }\n"
+      "        return w;\n"
+      "    }\n"
+      "    return v;\n"
+      "}\n"
+      "fn column(m: mat4) -> vec4 { let c = at(m, 2); return c; }\n"
+      "fn main() -> int {\n"
+      "    let a = vec2(1, 2);\n"
+      "    let r = pick(a, true);\n"
+      "    let s = pick(a, false);\n"
+      "    let m = mat4(vec4(1, 0, 0, 0), vec4(0, 2, 0, 0), vec4(0, 0, 3, 0), vec4(1, 1, 1, 1));\n"
+      "    let x: vec4;\n"
+      "    x = column(m) + x;\n"
+      "    a = a / vec2(2, 4);\n"
+      "    if (dot(a, a) > 1.0 || dot(a + a, a) > 0.0) && at(r, 1) == 12.0 && at(s, 0) == 2.0 && at(x, 2) == 3.0 {\n"
+      "        return 7;\n"
+      "    }\n"
+      "    return 1;\n"
+      "}\n",
+      7, NULL },
+};
+
+// コンパイルエラーになるプログラム
+static const Program rejected[] = {
+    // 定数でないグローバル変数の初期化式
+    { "rejected_global",
+      "fn f() -> int { return 1; }\n"
+      "let bad = f();\n"
+      "fn main() -> int { return bad; }\n",
+      0, NULL },
+    // 数学の型はスタックマシン方式に落ちた関数（7個目の引数がある）では扱えない
+    { "rejected_vector",
+      "fn f(a, b, c, d, e, g, h, v: vec3) -> float { return dot(v, v); }\n"
+      "fn main() -> int { return 0; }\n",
+      0, NULL },
+};
+
+#define REJECTED_COUNT (sizeof(rejected) / sizeof(rejected[0]))
+
+#define PROGRAM_COUNT (sizeof(programs) / sizeof(programs[0]))
+
+static char directory[] = "/tmp/codegen_bench_XXXXXX";
+static bool have_cc;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool write_program(const Program* program, char* path, size_t size) {
+    snprintf(path, size, "%s/%s.sl", directory, program->name);
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return false;
+    bool ok = fputs(program->source, file) >= 0;
+    return fclose(file) == 0 && ok;
+}
+
+static bool compile(const char* path, int level, AsmOutputFormat format) {
+    DriverOptions options = { format, { level, false, NULL }, NULL, 1, NULL };
+    Driver* driver = driver_create(&options);
+    if (driver == NULL) return false;
+    SlangError error = driver_add_file(driver, path);
+    if (error == SLANG_SUCCESS) error = driver_compile(driver);
+    driver_destroy(driver);
+    return error == SLANG_SUCCESS;
+}
+
+// リンクして実行し、終了状態を確かめる（ccがなければ確かめたことにする）
+static bool link_and_run(const Program* program, const char* path, int level) {
+    if (!have_cc) return true;
+    char command[256];
+    snprintf(command, sizeof(command), "cc -no-pie -o %s/program %s.o 2>&1", directory, path);
+    if (system(command) != 0) {
+        fprintf(stderr, "codegen_bench: %s -O%d: link failed\n", program->name, level);
+        return false;
+    }
+    snprintf(command, sizeof(command), "%s/program > %s/output", directory, directory);
+    int status = system(command);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != program->expected) {
+        fprintf(stderr, "codegen_bench: %s -O%d: program exited with %d, expected %d\n", program->name, level,
+                WIFEXITED(status) ? WEXITSTATUS(status) : -1, program->expected);
+        return false;
+    }
+    if (program->output == NULL) return true;
+
+    char output[512];
+    snprintf(command, sizeof(command), "%s/output", directory);
+    FILE* file = fopen(command, "r");
+    size_t length = file != NULL ? fread(output, 1, sizeof(output) - 1, file) : 0;
+    if (file != NULL) fclose(file);
+    output[length] = '\0';
+    if (strcmp(output, program->output) != 0) {
+        fprintf(stderr, "codegen_bench: %s -O%d: program wrote \"%s\", expected \"%s\"\n", program->name, level,
+                output, program->output);
+        return false;
+    }
+    return true;
+}
+
+// 出力したアセンブリにwordが現れないことを確かめる
+static bool assembly_lacks(const char* path, const char* word) {
+    char assembly[160];
+    snprintf(assembly, sizeof(assembly), "%s.s", path);
+    FILE* file = fopen(assembly, "r");
+    if (file == NULL) return false;
+    char line[512];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file) != NULL) found = strstr(line, word) != NULL;
+    fclose(file);
+    return !found;
+}
+
+int main(void) {
+    if (!intern_init() || !type_table_init()) return 1;
+    if (mkdtemp(directory) == NULL) {
+        perror("codegen_bench: mkdtemp");
+        return 1;
+    }
+    have_cc = system("cc --version >/dev/null 2>&1") == 0;
+
+    bool ok = true;
+    for (size_t i = 0; i < PROGRAM_COUNT; i++) {
+        const Program* program = &programs[i];
+        char path[128];
+        bool program_ok = write_program(program, path, sizeof(path));
+        double ms[OPT_MAX_LEVEL + 1] = { 0 };
+        for (int level = 0; program_ok && level <= OPT_MAX_LEVEL; level++) {
+            double start = now_seconds();
+            for (int r = 0; program_ok && r < REPEATS; r++) program_ok = compile(path, level, ASM_OUTPUT_OBJECT);
+            ms[level] = (now_seconds() - start) * 1e3 / REPEATS;
+            if (!program_ok) fprintf(stderr, "codegen_bench: %s -O%d: compile failed\n", program->name, level);
+            program_ok = program_ok && link_and_run(program, path, level);
+        }
+        if (program_ok && strcmp(program->name, "stack_fallback") == 0) {
+            program_ok = compile(path, 0, ASM_OUTPUT_ASSEMBLY) && assembly_lacks(path, "rbx");
+            if (!program_ok) fprintf(stderr, "codegen_bench: %s: stack machine code touches rbx\n", program->name);
+        }
+        if (program_ok && strcmp(program->name, "vector_math") == 0) {
+            program_ok = compile(path, 0, ASM_OUTPUT_ASSEMBLY) && !assembly_lacks(path, "malloc");
+            for (int level = 1; program_ok && level <= OPT_MAX_LEVEL; level++) {
+                program_ok = compile(path, level, ASM_OUTPUT_ASSEMBLY) && assembly_lacks(path, "malloc");
+            }
+            if (!program_ok) fprintf(stderr, "codegen_bench: %s: blocks that do not escape stay on the heap\n", program->name);
+        }
+        printf("%-16s %s  compile %.3f / %.3f / %.3f ms at -O0 / -O1 / -O2, %s\n", program->name,
+               program_ok ? "ok    " : "FAILED", ms[0], ms[1], ms[2], have_cc ? "runs" : "link skipped (no cc)");
+        ok = ok && program_ok;
+    }
+
+    for (size_t i = 0; i < REJECTED_COUNT; i++) {
+        const Program* program = &rejected[i];
+        char path[128];
+        bool program_ok = write_program(program, path, sizeof(path)) && !compile(path, 0, ASM_OUTPUT_OBJECT);
+        if (!program_ok) fprintf(stderr, "codegen_bench: %s: program was accepted\n", program->name);
+        printf("%-16s %s  rejected at compile time\n", program->name, program_ok ? "ok    " : "FAILED");
+        ok = ok && program_ok;
+    }
+
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf %s", directory);
+    if (system(command) != 0) ok = false;
+    intern_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+// 複数ファイルのコンパイル（driver_compile）のベンチマーク
+// 一時ディレクトリに、汎用関数を持つlib.slと、それをuseする層状のモジュール（各層の単位は下の層の
+// 2つの単位をuseする）、互いにuseし合う2つの単位（1つの強連結成分）、それらをuseするmain.slを書き、
+// main.slだけを指定してコンパイルする。1スレッドとTHREADSスレッドのクリーンビルドの時間を比べ、
+// .oをccでリンクして実行した終了状態が期待どおりかを確かめる（ccがなければリンクは省く）。
+// 続けて--cache-dirと同じキャッシュで、何も変えないビルドが単位を作り直さないこと、汎用関数を使わなく
+// なるよう一番下の単位を書き換えたビルドの後も（キャッシュから使った単位が特殊化を持つので）リンクできる
+// ことを確かめる。
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "intern.h"
+#include "driver.h"
+
+#define LAYERS 5
+#define WIDTH 8
+#define FUNCTIONS 40
+#define THREADS 4
+#define RING_DEPTH 5
+#define UNIT_COUNT (LAYERS * WIDTH + 4)   // lib・ring_a・ring_b・mainを含む
+
+static char directory[] = "/tmp/driver_bench_XXXXXX";
+static char cache_dir[64];
+static char main_path[64];
+static bool have_cc;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Text;
+
+static void text_append(Text* text, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void text_append(Text* text, const char* format, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, format);
+        size_t room = text->capacity - text->length;
+        int written = vsnprintf(text->data ? text->data + text->length : NULL, room, format, args);
+        va_end(args);
+        if (written < 0) return;
+        if ((size_t)written < room) {
+            text->length += (size_t)written;
+            return;
+        }
+        size_t capacity = text->capacity ? text->capacity * 2 : 4096;
+        while (capacity - text->length <= (size_t)written) capacity *= 2;
+        char* grown = realloc(text->data, capacity);
+        if (grown == NULL) return;
+        text->data = grown;
+        text->capacity = capacity;
+    }
+}
+
+static bool write_text(const char* name, Text* text) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    FILE* out = fopen(path, "w");
+    bool ok = out != NULL && text->data != NULL && fwrite(text->data, 1, text->length, out) == text->length;
+    if (out != NULL) ok = fclose(out) == 0 && ok;
+    free(text->data);
+    *text = (Text){ NULL, 0, 0 };
+    return ok;
+}
+
+// 一番下の層の関数はf0_i_j(n) = n + i + j（genericならlibの汎用関数を通す）
+static bool write_bottom(int i, bool generic) {
+    Text text = { NULL, 0, 0 };
+    text_append(&text, "use lib;\n\n");
+    for (int j = 0; j < FUNCTIONS; j++) {
+        if (generic) {
+            text_append(&text, "fn f0_%d_%d(n: int) -> int {\n    let x: int = id(n);\n    return add(x, %d);\n}\n\n",
+                        i, j, i + j);
+        } else {
+            text_append(&text, "fn f0_%d_%d(n: int) -> int {\n    return n + %d;\n}\n\n", i, j, i + j);
+        }
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "m0_%d.sl", i);
+    return write_text(name, &text);
+}
+
+// 上の層の関数はfk_i_j(n) = f(k-1)_i_j(n) + f(k-1)_(i+1)_j(n) - n
+static bool write_layer(int k, int i) {
+    int next = (i + 1) % WIDTH;
+    Text text = { NULL, 0, 0 };
+    text_append(&text, "use m%d_%d;\nuse m%d_%d;\n\n", k - 1, i, k - 1, next);
+    for (int j = 0; j < FUNCTIONS; j++) {
+        text_append(&text, "fn f%d_%d_%d(n: int) -> int {\n    return f%d_%d_%d(n) + f%d_%d_%d(n) - n;\n}\n\n", k, i, j,
+                    k - 1, i, j, k - 1, next, j);
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "m%d_%d.sl", k, i);
+    return write_text(name, &text);
+}
+
+static bool write_sources(void) {
+    Text text = { NULL, 0, 0 };
+    text_append(&text, "fn id<T>(x: T) -> T {\n    return x;\n}\n\n"
+                       "fn add<T>(a: T, b: T) -> T {\n    return a + b;\n}\n");
+    bool ok = write_text("lib.sl", &text);
+
+    text_append(&text, "use ring_b;\n\nfn ring_a(n: int) -> int {\n    if n == 0 {\n        return 0;\n    }\n"
+                       "    return ring_b(n - 1) + 1;\n}\n");
+    ok = ok && write_text("ring_a.sl", &text);
+    text_append(&text, "use ring_a;\n\nfn ring_b(n: int) -> int {\n    if n == 0 {\n        return 0;\n    }\n"
+                       "    return ring_a(n - 1) + 1;\n}\n");
+    ok = ok && write_text("ring_b.sl", &text);
+
+    for (int i = 0; i < WIDTH && ok; i++) ok = write_bottom(i, true);
+    for (int k = 1; k < LAYERS && ok; k++) {
+        for (int i = 0; i < WIDTH && ok; i++) ok = write_layer(k, i);
+    }
+
+    for (int i = 0; i < WIDTH; i++) text_append(&text, "use m%d_%d;\n", LAYERS - 1, i);
+    text_append(&text, "use ring_a;\n\nfn main() -> int {\n    let total: int = ring_a(%d);\n", RING_DEPTH);
+    for (int i = 0; i < WIDTH; i++) text_append(&text, "    total = total + f%d_%d_0(1);\n", LAYERS - 1, i);
+    text_append(&text, "    return total;\n}\n");
+    return ok && write_text("main.sl", &text);
+}
+
+// mainの戻り値（ソースと同じ漸化式）
+static long long expected_result(void) {
+    long long values[LAYERS][WIDTH];
+    for (int i = 0; i < WIDTH; i++) values[0][i] = 1 + i;
+    for (int k = 1; k < LAYERS; k++) {
+        for (int i = 0; i < WIDTH; i++) values[k][i] = values[k - 1][i] + values[k - 1][(i + 1) % WIDTH] - 1;
+    }
+    long long total = RING_DEPTH;
+    for (int i = 0; i < WIDTH; i++) total += values[LAYERS - 1][i];
+    return total;
+}
+
+typedef struct {
+    double ms;
+    size_t units;
+    size_t rebuilt;            // キャッシュになかった単位
+    size_t components;
+} Build;
+
+static bool build(size_t threads, const char* cache, Build* result) {
+    DriverOptions options = { ASM_OUTPUT_OBJECT, { OPT_DEFAULT_LEVEL, false, NULL }, cache, threads, NULL };
+    Driver* driver = driver_create(&options);
+    if (driver == NULL) return false;
+    double start = now_seconds();
+    SlangError error = driver_add_file(driver, main_path);
+    if (error == SLANG_SUCCESS) error = driver_compile(driver);
+    result->ms = (now_seconds() - start) * 1e3;
+    result->units = driver->unit_count;
+    result->components = driver->component_count;
+    result->rebuilt = 0;
+    for (size_t i = 0; i < driver->unit_count; i++) {
+        if (driver->units[i].needs_output) result->rebuilt++;
+    }
+    driver_destroy(driver);
+    if (error != SLANG_SUCCESS) fprintf(stderr, "driver_bench: driver_compile failed (%d)\n", (int)error);
+    return error == SLANG_SUCCESS && result->units == UNIT_COUNT;
+}
+
+// 全ての.oをリンクして実行し、終了状態を確かめる（ccがなければ確かめたことにする）
+static bool link_and_run(const char* label) {
+    if (!have_cc) return true;
+    char command[256];
+    snprintf(command, sizeof(command), "cc -no-pie -o %s/program %s/*.sl.o 2>&1", directory, directory);
+    if (system(command) != 0) {
+        fprintf(stderr, "driver_bench: %s: link failed\n", label);
+        return false;
+    }
+    snprintf(command, sizeof(command), "%s/program", directory);
+    int status = system(command);
+    int expected = (int)(expected_result() & 0xff);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != expected) {
+        fprintf(stderr, "driver_bench: %s: program exited with %d, expected %d\n", label,
+                WIFEXITED(status) ? WEXITSTATUS(status) : -1, expected);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    if (!intern_init() || !type_table_init()) return 1;
+    if (mkdtemp(directory) == NULL) {
+        perror("driver_bench: mkdtemp");
+        return 1;
+    }
+    snprintf(cache_dir, sizeof(cache_dir), "%s/cache", directory);
+    snprintf(main_path, sizeof(main_path), "%s/main.sl", directory);
+    have_cc = system("cc --version >/dev/null 2>&1") == 0;
+
+    bool ok = write_sources();
+    Build serial = { 0 }, parallel = { 0 };
+    ok = ok && build(1, NULL, &serial) && build(THREADS, NULL, &parallel);
+    ok = ok && serial.rebuilt == UNIT_COUNT && parallel.rebuilt == UNIT_COUNT;
+    bool linked = ok && link_and_run("clean build");
+    printf("clean build      %s  %zu units in %zu components: %.1f ms on 1 thread, %.1f ms on %d threads (%.2fx)\n",
+           ok && linked ? "ok    " : "FAILED", parallel.units, parallel.components, serial.ms, parallel.ms, THREADS,
+           serial.ms / parallel.ms);
+    printf("link             %s  %s\n", linked ? "ok    " : "FAILED",
+           have_cc ? "main returns the expected value" : "skipped (no cc)");
+    ok = ok && linked;
+
+    // キャッシュを温めてから、何も変えずにもう一度
+    Build warm = { 0 }, cached = { 0 };
+    ok = ok && build(THREADS, cache_dir, &warm) && build(THREADS, cache_dir, &cached);
+    ok = ok && cached.rebuilt == 0;
+    printf("cached rebuild   %s  %zu of %zu units rebuilt: %.1f ms (cold %.1f ms)\n", ok ? "ok    " : "FAILED",
+           cached.rebuilt, cached.units, cached.ms, warm.ms);
+
+    // 一番下の単位が汎用関数を使わなくなっても、キャッシュから使う単位の.oが特殊化を持つ
+    Build edited = { 0 };
+    ok = ok && write_bottom(0, false) && build(THREADS, cache_dir, &edited) && edited.rebuilt > 0 &&
+         edited.rebuilt < edited.units;
+    bool relinked = ok && link_and_run("edited build");
+    printf("edit bottom unit %s  %zu of %zu units rebuilt: %.1f ms, %s\n", relinked ? "ok    " : "FAILED",
+           edited.rebuilt, edited.units, edited.ms, have_cc ? "links and runs" : "link skipped");
+    ok = ok && relinked;
+
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf %s", directory);
+    if (system(command) != 0) ok = false;
+    intern_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+// エスケープ解析のベンチマーク
+// ループの中で一時ブロックをIR_ALLOCで確保してベクトル演算に使い、IR_DROPで解放する関数をIRで組み、
+// -O0（毎回mallocとfree）と-O1（エスケープ解析でフレームに置く）で出力して、残った確保の数を比べる。
+// 借用で渡す呼び出しはフレームに置けるが、所有権ごと渡す呼び出しと返すブロックはヒープに残ることも確かめる。
+// ccが使えれば全部をアセンブルして実行し、結果が一致することを確かめて実行時間も測る。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "optimizer.h"
+#include "regalloc.h"
+#include "x86_emitter.h"
+
+#define LEVEL_COUNT 2
+#define VEC4_BYTES 32
+
+// for (i = 0; i < n; i++) body のループ
+typedef struct {
+    IrFunction* function;
+    IrValue i;
+    uint32_t start;
+    uint32_t exit;
+} Loop;
+
+static void loop_begin(Loop* loop, IrFunction* function, IrValue n) {
+    loop->function = function;
+    loop->i = ir_new_value(function, IR_INT);
+    loop->start = ir_new_label(function);
+    loop->exit = ir_new_label(function);
+    ir_emit_move(function, loop->i, ir_emit_const_int(function, 0));
+    ir_emit_label(function, loop->start);
+    ir_emit_branch_false(function, ir_emit_binary(function, IR_LT, loop->i, n), loop->exit);
+}
+
+static void loop_end(Loop* loop) {
+    IrFunction* function = loop->function;
+    IrValue next = ir_emit_binary(function, IR_ADD, loop->i, ir_emit_const_int(function, 1));
+    if (!ir_retarget_last(function, next, loop->i)) ir_emit_move(function, loop->i, next);
+    ir_emit_jump(function, loop->start);
+    ir_emit_label(function, loop->exit);
+}
+
+static void accumulate(IrFunction* function, IrValue s, IrValue value) {
+    IrValue sum = ir_emit_binary(function, IR_ADD, s, value);
+    if (!ir_retarget_last(function, sum, s)) ir_emit_move(function, s, sum);
+}
+
+// double temps(double* x, double* y, int64_t n)
+//   t = x + y; u = t * y; s += u・x を一時ブロックで繰り返す
+static IrFunction* build_temps(const char* name) {
+    IrFunction* function = ir_function_create(name);
+    IrValue x = ir_emit_param(function, 0, IR_INT);
+    IrValue y = ir_emit_param(function, 1, IR_INT);
+    IrValue n = ir_emit_param(function, 2, IR_INT);
+    IrValue s = ir_new_value(function, IR_FLOAT);
+    ir_emit_move(function, s, ir_emit_const_float(function, 0.0));
+
+    Loop loop;
+    loop_begin(&loop, function, n);
+    IrValue t = ir_emit_alloc(function, VEC4_BYTES);
+    ir_emit_vector_binary(function, IR_VEC_ADD, t, x, y, 4);
+    IrValue u = ir_emit_alloc(function, VEC4_BYTES);
+    ir_emit_vector_binary(function, IR_VEC_MUL, u, t, y, 4);
+    accumulate(function, s, ir_emit_vector_dot(function, u, x, 4));
+    ir_emit_drop(function, t);
+    ir_emit_drop(function, u);
+    loop_end(&loop);
+    ir_emit_return(function, s);
+    return function;
+}
+
+// double borrowed(double* x, double* y, int64_t n)
+//   t = x + y; s += sum4(&t) を繰り返す（sum4は借用で受け取る）
+static IrFunction* build_borrowed(const char* name) {
+    IrFunction* function = ir_function_create(name);
+    IrValue x = ir_emit_param(function, 0, IR_INT);
+    IrValue y = ir_emit_param(function, 1, IR_INT);
+    IrValue n = ir_emit_param(function, 2, IR_INT);
+    IrValue s = ir_new_value(function, IR_FLOAT);
+    ir_emit_move(function, s, ir_emit_const_float(function, 0.0));
+
+    Loop loop;
+    loop_begin(&loop, function, n);
+    IrValue t = ir_emit_alloc(function, VEC4_BYTES);
+    ir_emit_vector_binary(function, IR_VEC_ADD, t, x, y, 4);
+    IrValue sum = ir_emit_call(function, "sum4", IR_FLOAT, &t, 1);
+    ir_mark_borrowed(function, 0);
+    accumulate(function, s, sum);
+    ir_emit_drop(function, t);
+    loop_end(&loop);
+    ir_emit_return(function, s);
+    return function;
+}
+
+// double owned(double* x, double* y, int64_t n)
+//   t = x + y; s += consume4(t) を繰り返す（consume4は受け取ったブロックを解放する）
+static IrFunction* build_owned(const char* name) {
+    IrFunction* function = ir_function_create(name);
+    IrValue x = ir_emit_param(function, 0, IR_INT);
+    IrValue y = ir_emit_param(function, 1, IR_INT);
+    IrValue n = ir_emit_param(function, 2, IR_INT);
+    IrValue s = ir_new_value(function, IR_FLOAT);
+    ir_emit_move(function, s, ir_emit_const_float(function, 0.0));
+
+    Loop loop;
+    loop_begin(&loop, function, n);
+    IrValue t = ir_emit_alloc(function, VEC4_BYTES);
+    ir_emit_vector_binary(function, IR_VEC_ADD, t, x, y, 4);
+    accumulate(function, s, ir_emit_call(function, "consume4", IR_FLOAT, &t, 1));
+    loop_end(&loop);
+    ir_emit_return(function, s);
+    return function;
+}
+
+// double* returned(double* x, double* y)
+//   t = x + y を返す（呼び出し元が解放する）
+static IrFunction* build_returned(const char* name) {
+    IrFunction* function = ir_function_create(name);
+    IrValue x = ir_emit_param(function, 0, IR_INT);
+    IrValue y = ir_emit_param(function, 1, IR_INT);
+    IrValue t = ir_emit_alloc(function, VEC4_BYTES);
+    ir_emit_vector_binary(function, IR_VEC_ADD, t, x, y, 4);
+    ir_emit_return(function, t);
+    return function;
+}
+
+typedef struct {
+    const char* name;
+    IrFunction* (*build)(const char* name);
+    bool promoted;             // -O1ですべての確保がフレームに移るはずか
+} Kernel;
+
+static const Kernel kernels[] = {
+    { "temps", build_temps, true },
+    { "borrowed", build_borrowed, true },
+    { "owned", build_owned, false },
+    { "returned", build_returned, false },
+};
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+static const char* const driver_source =
+    "#include <stdio.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <time.h>\n"
+    "double sum4(const double* v) { return v[0] + v[1] + v[2] + v[3]; }\n"
+    "double consume4(double* v) { double s = sum4(v); free(v); return s; }\n"
+    "#define DECLARE(level) \\\n"
+    "    double o##level##_temps(double*, double*, int64_t); double o##level##_borrowed(double*, double*, int64_t); \\\n"
+    "    double o##level##_owned(double*, double*, int64_t); double* o##level##_returned(double*, double*); \\\n"
+    "    static double o##level##_returned_loop(double* x, double* y, int64_t n) { \\\n"
+    "        double s = 0; for (int64_t i = 0; i < n; i++) { double* t = o##level##_returned(x, y); s += sum4(t); free(t); } \\\n"
+    "        return s; }\n"
+    "DECLARE(0) DECLARE(1)\n"
+    "static double now(void) { struct timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec * 1e-9; }\n"
+    "_Alignas(16) static double x[4] = { 0.5, -1.25, 2.0, 0.75 }, y[4] = { 1.5, 0.25, -0.5, 3.0 };\n"
+    "#define TIME(label, name) do { double best[2] = { 1e9, 1e9 }; double r[2] = { 0, 0 }; \\\n"
+    "    for (int k = 0; k < 5; k++) { double t0 = now(); r[0] = o0_##name(x, y, 5000000); double t1 = now(); \\\n"
+    "        r[1] = o1_##name(x, y, 5000000); double t2 = now(); \\\n"
+    "        if (t1 - t0 < best[0]) best[0] = t1 - t0; if (t2 - t1 < best[1]) best[1] = t2 - t1; } \\\n"
+    "    if (r[0] != r[1]) { fprintf(stderr, \"%s mismatch\\n\", label); return 1; } \\\n"
+    "    printf(\"%s %.3f %.3f\\n\", label, best[0] * 1e3, best[1] * 1e3); } while (0)\n"
+    "int main(void) {\n"
+    "    TIME(\"temps\", temps);\n"
+    "    TIME(\"borrowed\", borrowed);\n"
+    "    TIME(\"owned\", owned);\n"
+    "    TIME(\"returned\", returned_loop);\n"
+    "    return 0;\n"
+    "}\n";
+
+typedef struct {
+    size_t heap[LEVEL_COUNT];      // 残ったIR_ALLOCの数
+    size_t stack[LEVEL_COUNT];     // IR_STACK_ALLOCの数
+    size_t drops[LEVEL_COUNT];
+    double ms[LEVEL_COUNT];
+    bool timed;
+} Result;
+
+static void count_storage(const IrFunction* function, Result* result, int level) {
+    for (size_t i = 0; i < function->count; i++) {
+        uint8_t op = function->code[i].op;
+        result->heap[level] += op == IR_ALLOC;
+        result->stack[level] += op == IR_STACK_ALLOC;
+        result->drops[level] += op == IR_DROP;
+    }
+}
+
+static bool write_file(const char* path, const char* text) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return false;
+    fputs(text, file);
+    return fclose(file) == 0;
+}
+
+static bool run_driver(const char* directory, Result* results) {
+    char driver[256], program[320], assembly[256], command[1200];
+    snprintf(driver, sizeof(driver), "%s/driver.c", directory);
+    snprintf(assembly, sizeof(assembly), "%s/kernels.s", directory);
+    snprintf(program, sizeof(program), "%s/driver", directory);
+    if (!write_file(driver, driver_source)) return true;
+
+    const char* cc = getenv("CC") ? getenv("CC") : "cc";
+    snprintf(command, sizeof(command), "%s -O2 -o %s %s %s 2>&1", cc, program, driver, assembly);
+    if (system(command) != 0) {
+        fprintf(stderr, "escape_bench: could not assemble %s, reporting allocation counts only\n", assembly);
+        return true;
+    }
+
+    FILE* pipe = popen(program, "r");
+    if (pipe == NULL) return true;
+    char name[32];
+    double ms[LEVEL_COUNT];
+    while (fscanf(pipe, "%31s %lf %lf", name, &ms[0], &ms[1]) == 3) {
+        for (size_t i = 0; i < KERNEL_COUNT; i++) {
+            if (strcmp(name, kernels[i].name) != 0) continue;
+            memcpy(results[i].ms, ms, sizeof(ms));
+            results[i].timed = true;
+        }
+    }
+    // 結果が食い違えばドライバが失敗する
+    return pclose(pipe) == 0;
+}
+
+int main(void) {
+    char directory[] = "/tmp/slang_escape_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        perror("escape_bench: mkdtemp");
+        return 1;
+    }
+    char assembly[256];
+    snprintf(assembly, sizeof(assembly), "%s/kernels.s", directory);
+    AsmWriter writer;
+    AsmWriter* out = &writer;
+    if (!asm_writer_open(out, assembly)) {
+        perror("escape_bench: open");
+        return 1;
+    }
+    asm_text(out, ".intel_syntax noprefix\n.section .text\n");
+
+    Result results[KERNEL_COUNT];
+    memset(results, 0, sizeof(results));
+    for (int level = 0; level < LEVEL_COUNT; level++) {
+        OptOptions options = { level, false, NULL };
+        Optimizer optimizer;
+        optimizer_init(&optimizer, &options);
+        for (size_t i = 0; i < KERNEL_COUNT; i++) {
+            char name[32];
+            snprintf(name, sizeof(name), "o%d_%s", level, kernels[i].name);
+            IrFunction* function = kernels[i].build(name);
+            if (function == NULL || function->failed ||
+                optimizer_run(&optimizer, function, NULL, 0) != SLANG_SUCCESS) {
+                fprintf(stderr, "escape_bench: %s: -O%d failed\n", kernels[i].name, level);
+                return 1;
+            }
+            count_storage(function, &results[i], level);
+
+            asm_text(out, ".global ");
+            asm_text(out, function->name);
+            asm_text(out, "\n");
+            RegisterAllocation allocation;
+            if (regalloc_run(function, &allocation) != SLANG_SUCCESS ||
+                x86_emit_function(out, function, &allocation, NULL) != SLANG_SUCCESS) {
+                fprintf(stderr, "escape_bench: %s: -O%d emission failed\n", kernels[i].name, level);
+                return 1;
+            }
+            regalloc_free(&allocation);
+            ir_function_destroy(function);
+        }
+    }
+    asm_text(out, ".section .note.GNU-stack,\"\",@progbits\n");
+    if (!asm_writer_close(out)) {
+        fprintf(stderr, "escape_bench: could not write %s\n", assembly);
+        return 1;
+    }
+
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        const Result* result = &results[i];
+        bool promoted = result->heap[1] == 0 && result->drops[1] == 0 && result->stack[1] > 0;
+        if (result->heap[0] == 0 || result->stack[0] != 0 || promoted != kernels[i].promoted) {
+            fprintf(stderr, "escape_bench: %s: %zu heap and %zu stack allocations remain at -O1\n", kernels[i].name,
+                    result->heap[1], result->stack[1]);
+            return 1;
+        }
+    }
+
+    if (!run_driver(directory, results)) {
+        fprintf(stderr, "escape_bench: -O1 code disagrees with -O0\n");
+        return 1;
+    }
+
+    printf("[");
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        const Result* result = &results[i];
+        printf("%s{\"benchmark\": \"escape_%s\", \"O0_heap\": %zu, \"O1_heap\": %zu, \"O1_stack\": %zu, "
+               "\"O1_drops\": %zu",
+               i ? ",\n " : "", kernels[i].name, result->heap[0], result->heap[1], result->stack[1], result->drops[1]);
+        if (result->timed) printf(", \"O0_ms\": %.2f, \"O1_ms\": %.2f", result->ms[0], result->ms[1]);
+        printf("}");
+    }
+    printf("]\n");
+    return 0;
+}
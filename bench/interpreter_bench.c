@@ -0,0 +1,324 @@
+// インタプリタのマイクロベンチマーク
+// バイトコードVMと、interpreter.hの旧APIが前提としていた素朴なAST直接評価
+// （void*で箱詰めした値、名前の線形探索）を同じASTで比較する。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "interpreter.h"
+#include "intern.h"
+
+#define FIB_N 27
+#define LOOP_N 3000000
+
+// ASTの組み立て（ast.cと同じくノードはアリーナから取る）
+static Arena* arena;
+
+static ASTNode* node(int type) {
+    ASTNode* n = arena_alloc(arena, sizeof(ASTNode));
+    memset(n, 0, sizeof(ASTNode));
+    n->type = type;
+    return n;
+}
+
+static ASTNode* integer(int64_t value) {
+    ASTNode* n = node(NODE_INTEGER_LITERAL);
+    n->data.integer_literal.value = value;
+    return n;
+}
+
+static ASTNode* ref(const char* name) {
+    ASTNode* n = node(NODE_VARIABLE_REFERENCE);
+    n->data.variable_reference.name = intern_cstr(name);
+    return n;
+}
+
+static ASTNode* binary(ASTNode* left, const char* op, ASTNode* right) {
+    ASTNode* n = node(NODE_BINARY_EXPRESSION);
+    n->data.binary_expression.left = left;
+    n->data.binary_expression.operator = intern_cstr(op);
+    n->data.binary_expression.right = right;
+    return n;
+}
+
+static ASTNode* call1(const char* name, ASTNode* argument) {
+    ASTNode* n = node(NODE_FUNCTION_CALL);
+    n->data.function_call.name = intern_cstr(name);
+    n->data.function_call.arguments = arena_memdup(arena, &argument, sizeof(ASTNode*));
+    n->data.function_call.argument_count = 1;
+    return n;
+}
+
+static ASTNode* let(const char* name, ASTNode* initializer) {
+    ASTNode* n = node(NODE_LET_STATEMENT);
+    n->data.let_statement.name = intern_cstr(name);
+    n->data.let_statement.initializer = initializer;
+    return n;
+}
+
+static ASTNode* assign(const char* name, ASTNode* value) {
+    ASTNode* n = node(NODE_ASSIGNMENT);
+    n->data.assignment.name = intern_cstr(name);
+    n->data.assignment.value = value;
+    return n;
+}
+
+static ASTNode* ret(ASTNode* value) {
+    ASTNode* n = node(NODE_RETURN_STATEMENT);
+    n->data.return_statement.value = value;
+    return n;
+}
+
+static ASTNode* block(ASTNode** statements, size_t count) {
+    ASTNode* n = node(NODE_BLOCK_STATEMENT);
+    n->data.block_statement.statements = arena_memdup(arena, statements, count * sizeof(ASTNode*));
+    n->data.block_statement.statement_count = count;
+    return n;
+}
+
+static ASTNode* function(const char* name, const char* parameter, ASTNode* body) {
+    Variable* variable = arena_alloc(arena, sizeof(Variable));
+    variable->name = intern_cstr(parameter);
+    variable->type = NULL;
+
+    ASTNode* n = node(NODE_FUNCTION);
+    n->data.function.name = intern_cstr(name);
+    n->data.function.parameters = arena_memdup(arena, &variable, sizeof(Variable*));
+    n->data.function.parameter_count = 1;
+    n->data.function.body = body;
+    return n;
+}
+
+// fn fib(n) { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }
+static ASTNode* build_fib(void) {
+    ASTNode* then_statements[] = {ret(ref("n"))};
+    ASTNode* condition = node(NODE_IF_STATEMENT);
+    condition->data.if_statement.condition = binary(ref("n"), "<", integer(2));
+    condition->data.if_statement.then_branch = block(then_statements, 1);
+
+    ASTNode* sum = binary(call1("fib", binary(ref("n"), "-", integer(1))), "+",
+                          call1("fib", binary(ref("n"), "-", integer(2))));
+    ASTNode* body[] = {condition, ret(sum)};
+    return function("fib", "n", block(body, 2));
+}
+
+// fn sum_loop(n) { let total = 0; let i = 0; while i < n { total = total + i % 7; i = i + 1; } return total; }
+static ASTNode* build_loop(void) {
+    ASTNode* loop_body[] = {
+        assign("total", binary(ref("total"), "+", binary(ref("i"), "%", integer(7)))),
+        assign("i", binary(ref("i"), "+", integer(1))),
+    };
+    ASTNode* loop = node(NODE_WHILE_STATEMENT);
+    loop->data.while_statement.condition = binary(ref("i"), "<", ref("n"));
+    loop->data.while_statement.body = block(loop_body, 2);
+
+    ASTNode* body[] = {let("total", integer(0)), let("i", integer(0)), loop, ret(ref("total"))};
+    return function("sum_loop", "n", block(body, 4));
+}
+
+// 素朴なAST直接評価
+// 値は毎回mallocした箱に入れ、変数と関数は名前をstrcmpで線形に探す。
+typedef struct {
+    char** keys;
+    void** values;
+    size_t count;
+    size_t capacity;
+} Environment;
+
+typedef struct {
+    ASTNode** functions;
+    size_t function_count;
+    bool returning;
+    void* return_value;
+} Walker;
+
+static void* box(int64_t value) {
+    int64_t* boxed = malloc(sizeof(int64_t));
+    *boxed = value;
+    return boxed;
+}
+
+static int64_t unbox(void* value) {
+    int64_t result = *(int64_t*)value;
+    free(value);
+    return result;
+}
+
+static void env_set(Environment* env, const char* name, void* value) {
+    for (size_t i = env->count; i > 0; i--) {
+        if (strcmp(env->keys[i - 1], name) == 0) {
+            free(env->values[i - 1]);
+            env->values[i - 1] = value;
+            return;
+        }
+    }
+    if (env->count == env->capacity) {
+        env->capacity = env->capacity ? env->capacity * 2 : 8;
+        env->keys = realloc(env->keys, env->capacity * sizeof(char*));
+        env->values = realloc(env->values, env->capacity * sizeof(void*));
+    }
+    env->keys[env->count] = strdup(name);
+    env->values[env->count] = value;
+    env->count++;
+}
+
+static void* env_get(Environment* env, const char* name) {
+    for (size_t i = env->count; i > 0; i--) {
+        if (strcmp(env->keys[i - 1], name) == 0) return box(*(int64_t*)env->values[i - 1]);
+    }
+    return box(0);
+}
+
+static void env_free(Environment* env) {
+    for (size_t i = 0; i < env->count; i++) {
+        free(env->keys[i]);
+        free(env->values[i]);
+    }
+    free(env->keys);
+    free(env->values);
+}
+
+static void walk_statement(Walker* walker, Environment* env, ASTNode* node);
+
+static void* walk_expression(Walker* walker, Environment* env, ASTNode* node) {
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL:
+            return box(node->data.integer_literal.value);
+        case NODE_VARIABLE_REFERENCE:
+            return env_get(env, node->data.variable_reference.name);
+        case NODE_BINARY_EXPRESSION: {
+            int64_t left = unbox(walk_expression(walker, env, node->data.binary_expression.left));
+            int64_t right = unbox(walk_expression(walker, env, node->data.binary_expression.right));
+            const char* op = node->data.binary_expression.operator;
+            if (strcmp(op, "+") == 0) return box(left + right);
+            if (strcmp(op, "-") == 0) return box(left - right);
+            if (strcmp(op, "%") == 0) return box(left % right);
+            if (strcmp(op, "<") == 0) return box(left < right);
+            return box(0);
+        }
+        case NODE_FUNCTION_CALL: {
+            ASTNode* callee = NULL;
+            for (size_t i = 0; i < walker->function_count; i++) {
+                if (strcmp(walker->functions[i]->data.function.name, node->data.function_call.name) == 0) {
+                    callee = walker->functions[i];
+                }
+            }
+            Environment frame = {0};
+            for (size_t i = 0; i < node->data.function_call.argument_count; i++) {
+                env_set(&frame, callee->data.function.parameters[i]->name,
+                        walk_expression(walker, env, node->data.function_call.arguments[i]));
+            }
+            walk_statement(walker, &frame, callee->data.function.body);
+            env_free(&frame);
+            walker->returning = false;
+            void* result = walker->return_value ? walker->return_value : box(0);
+            walker->return_value = NULL;
+            return result;
+        }
+        case NODE_ASSIGNMENT:
+            env_set(env, node->data.assignment.name, walk_expression(walker, env, node->data.assignment.value));
+            return box(0);
+        default:
+            return box(0);
+    }
+}
+
+static void walk_statement(Walker* walker, Environment* env, ASTNode* node) {
+    switch (node->type) {
+        case NODE_BLOCK_STATEMENT:
+            for (size_t i = 0; i < node->data.block_statement.statement_count && !walker->returning; i++) {
+                walk_statement(walker, env, node->data.block_statement.statements[i]);
+            }
+            break;
+        case NODE_LET_STATEMENT:
+            env_set(env, node->data.let_statement.name, walk_expression(walker, env, node->data.let_statement.initializer));
+            break;
+        case NODE_IF_STATEMENT:
+            if (unbox(walk_expression(walker, env, node->data.if_statement.condition))) {
+                walk_statement(walker, env, node->data.if_statement.then_branch);
+            }
+            break;
+        case NODE_WHILE_STATEMENT:
+            while (!walker->returning && unbox(walk_expression(walker, env, node->data.while_statement.condition))) {
+                walk_statement(walker, env, node->data.while_statement.body);
+            }
+            break;
+        case NODE_RETURN_STATEMENT:
+            walker->return_value = walk_expression(walker, env, node->data.return_statement.value);
+            walker->returning = true;
+            break;
+        default:
+            free(walk_expression(walker, env, node));
+            break;
+    }
+}
+
+static int64_t walk_call(Walker* walker, const char* name, int64_t argument) {
+    ASTNode* call = call1(name, integer(argument));
+    Environment env = {0};
+    int64_t result = unbox(walk_expression(walker, &env, call));
+    env_free(&env);
+    return result;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool vm_call(Interpreter* interpreter, const char* name, int64_t argument, int64_t* result) {
+    Value arg = value_int(argument);
+    Value value;
+    if (interpreter_call(interpreter, name, &arg, 1, &value) != SLANG_SUCCESS || value.type != VALUE_INT) {
+        fprintf(stderr, "interpreter_bench: %s failed: %s\n", name, interpreter_error(interpreter));
+        return false;
+    }
+    *result = value.as.integer;
+    return true;
+}
+
+int main(void) {
+    if (!intern_init()) return 1;
+    arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+
+    ASTNode* program[] = {build_fib(), build_loop()};
+    Interpreter* interpreter = create_interpreter();
+    // バイトコードVMそのものを測る（JITとの比較はjit_bench）
+    if (interpreter != NULL) interpreter_set_jit_threshold(interpreter, 0);
+    if (interpreter == NULL || interpret(interpreter, block(program, 2)) != SLANG_SUCCESS) {
+        fprintf(stderr, "interpreter_bench: compile failed\n");
+        return 1;
+    }
+    Walker walker = {program, 2, false, NULL};
+
+    const char* names[] = {"fib", "sum_loop"};
+    const int64_t arguments[] = {FIB_N, LOOP_N};
+    printf("[");
+    for (size_t i = 0; i < 2; i++) {
+        int64_t vm_result, walk_result;
+        double start = now_seconds();
+        if (!vm_call(interpreter, names[i], arguments[i], &vm_result)) return 1;
+        double vm_seconds = now_seconds() - start;
+
+        start = now_seconds();
+        walk_result = walk_call(&walker, names[i], arguments[i]);
+        double walk_seconds = now_seconds() - start;
+
+        if (vm_result != walk_result) {
+            fprintf(stderr, "interpreter_bench: %s mismatch (%lld vs %lld)\n",
+                    names[i], (long long)vm_result, (long long)walk_result);
+            return 1;
+        }
+        printf("%s{\"benchmark\": \"interpreter_%s\", \"argument\": %lld, \"vm_ms\": %.2f, "
+               "\"ast_walk_ms\": %.2f, \"speedup\": %.2f, \"result\": %lld}",
+               i ? ",\n " : "", names[i], (long long)arguments[i], vm_seconds * 1e3,
+               walk_seconds * 1e3, walk_seconds / vm_seconds, (long long)vm_result);
+    }
+    printf("]\n");
+
+    free_interpreter(interpreter);
+    arena_destroy(arena);
+    intern_shutdown();
+    return 0;
+}
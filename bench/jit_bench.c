@@ -0,0 +1,442 @@
+// 段階的なJITのベンチマーク
+// 同じS-Langのプログラムを、インタプリタだけ（しきい値0）・段階的な実行（既定のしきい値）・
+// 同じ計算をgccでコンパイルしたCで比べ、最初の呼び出しまでの時間とコンパイルにかかった時間も出す。
+// 伴って、引数の種類の確かめに落ちたとき・0での除算で脱出したとき・扱えない関数・脱出が続いて
+// 解釈に戻したとき・呼び出しが深すぎるときに、結果とエラーがインタプリタだけのときと同じになることを確かめる。
+// JITはバイトコードから線形IRに直し、AOT（codegen.cがASTから線形IRに直す）とは最適化から先だけを共有するので、
+// 同じプログラムをdriver_compileでも.oにしてccでリンクして実行し、JITと同じ値を出すことも確かめる
+// （ccがなければ省く）。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "interpreter.h"
+#include "intern.h"
+#include "lexer.h"
+#include "parser.h"
+#include "driver.h"
+
+#define FIB_N 30
+#define CHUNKS 200
+#define CHUNK_N 50000
+#define COLLATZ_LIMIT 300000
+#define WARM_CALLS (JIT_DEFAULT_THRESHOLD + 10)
+
+static const char* const source =
+    "let offset: int = 7;\n"
+    "fn fib(n: int) -> int { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+    "fn sum_loop(n: int) -> int {\n"
+    "    let total: int = 0;\n"
+    "    let i: int = 0;\n"
+    "    while i < n { total = total + i % 7; i = i + 1; }\n"
+    "    return total;\n"
+    "}\n"
+    "fn sum_chunks(chunks: int, n: int) -> int {\n"
+    "    let total: int = 0;\n"
+    "    let i: int = 0;\n"
+    "    while i < chunks { total = total + sum_loop(n + i); i = i + 1; }\n"
+    "    return total;\n"
+    "}\n"
+    "fn collatz(start: int) -> int {\n"
+    "    let n: int = start;\n"
+    "    let steps: int = 0;\n"
+    "    while n != 1 {\n"
+    "        if n % 2 == 0 { n = n / 2; } else { n = 3 * n + 1; }\n"
+    "        steps = steps + 1;\n"
+    "    }\n"
+    "    return steps;\n"
+    "}\n"
+    "fn collatz_total(limit: int) -> int {\n"
+    "    let total: int = 0;\n"
+    "    let i: int = 1;\n"
+    "    while i < limit { total = total + collatz(i); i = i + 1; }\n"
+    "    return total;\n"
+    "}\n"
+    "fn half(x: int) -> int { return x / 2; }\n"
+    "fn ratio(a: int, b: int) -> int { return a / b + a % b; }\n"
+    "fn shifted(x: int) -> int { return x + offset; }\n"
+    "fn is_small(x: int) -> bool { return x < 10 && x > -10; }\n"
+    "fn depth(n: int) -> int { if n == 0 { return 0; } return depth(n - 1) + 1; }\n";
+
+// gccでコンパイルした同じ計算
+__attribute__((noinline)) static long long c_fib(long long n) { return n < 2 ? n : c_fib(n - 1) + c_fib(n - 2); }
+
+__attribute__((noinline)) static long long c_sum_loop(long long n) {
+    long long total = 0;
+    for (long long i = 0; i < n; i++) total += i % 7;
+    return total;
+}
+
+__attribute__((noinline)) static long long c_sum_chunks(long long chunks, long long n) {
+    long long total = 0;
+    for (long long i = 0; i < chunks; i++) total += c_sum_loop(n + i);
+    return total;
+}
+
+__attribute__((noinline)) static long long c_collatz(long long n) {
+    long long steps = 0;
+    while (n != 1) {
+        n = n % 2 == 0 ? n / 2 : 3 * n + 1;
+        steps++;
+    }
+    return steps;
+}
+
+__attribute__((noinline)) static long long c_collatz_total(long long limit) {
+    long long total = 0;
+    for (long long i = 1; i < limit; i++) total += c_collatz(i);
+    return total;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    Arena* arena;
+    Lexer* lexer;
+    Parser* parser;
+    Interpreter* interpreter;
+} Program;
+
+static bool program_load(Program* program, unsigned threshold) {
+    memset(program, 0, sizeof(Program));
+    program->arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    program->lexer = lexer_create(source, strlen(source));
+    program->interpreter = create_interpreter();
+    ASTNode* root = NULL;
+    bool ok = program->arena != NULL && program->lexer != NULL && program->interpreter != NULL &&
+              lexer_scan(program->lexer) == SLANG_SUCCESS &&
+              (program->parser = parser_create(program->lexer, program->arena)) != NULL &&
+              parser_parse(program->parser, &root) == SLANG_SUCCESS;
+    if (ok) {
+        interpreter_set_jit_threshold(program->interpreter, threshold);
+        ok = interpret(program->interpreter, root) == SLANG_SUCCESS;
+    }
+    if (!ok) fprintf(stderr, "jit_bench: could not load the program\n");
+    return ok;
+}
+
+static void program_unload(Program* program) {
+    free_interpreter(program->interpreter);
+    parser_destroy(program->parser);
+    lexer_destroy(program->lexer);
+    arena_destroy(program->arena);
+}
+
+static bool call(Program* program, const char* name, const Value* args, size_t count, Value* result) {
+    SlangError error = interpreter_call(program->interpreter, name, args, count, result);
+    if (error != SLANG_SUCCESS) {
+        fprintf(stderr, "jit_bench: %s failed: %s\n", name, interpreter_error(program->interpreter));
+        return false;
+    }
+    return true;
+}
+
+static bool call_int(Program* program, const char* name, int64_t a, int64_t b, size_t count, int64_t* result) {
+    Value args[2] = { value_int(a), value_int(b) };
+    Value value;
+    if (!call(program, name, args, count, &value)) return false;
+    if (value.type != VALUE_INT) {
+        fprintf(stderr, "jit_bench: %s returned a non-integer\n", name);
+        return false;
+    }
+    *result = value.as.integer;
+    return true;
+}
+
+static BytecodeTier tier_of(Program* program, const char* name) {
+    return (BytecodeTier)bytecode_find_function(program->interpreter->program, intern_cstr(name))->tier;
+}
+
+typedef struct {
+    const char* name;
+    int64_t a;
+    int64_t b;
+    size_t count;
+    int64_t expected;
+    double c_seconds;
+} Workload;
+
+static bool run_workloads(void) {
+    Workload workloads[] = {
+        { "fib", FIB_N, 0, 1, 0, 0 },
+        { "sum_chunks", CHUNKS, CHUNK_N, 2, 0, 0 },
+        { "collatz_total", COLLATZ_LIMIT, 0, 1, 0, 0 },
+    };
+    size_t count = sizeof(workloads) / sizeof(workloads[0]);
+
+    double start = now_seconds();
+    workloads[0].expected = c_fib(FIB_N);
+    workloads[0].c_seconds = now_seconds() - start;
+    start = now_seconds();
+    workloads[1].expected = c_sum_chunks(CHUNKS, CHUNK_N);
+    workloads[1].c_seconds = now_seconds() - start;
+    start = now_seconds();
+    workloads[2].expected = c_collatz_total(COLLATZ_LIMIT);
+    workloads[2].c_seconds = now_seconds() - start;
+
+    // プログラムは測るたびに読み込み直す（どれも冷えたところから始める）
+    printf("[");
+    for (size_t i = 0; i < count; i++) {
+        Workload* w = &workloads[i];
+        double seconds[2];
+        JitStats stats;
+        for (int tiered = 0; tiered < 2; tiered++) {
+            Program program;
+            if (!program_load(&program, tiered ? JIT_DEFAULT_THRESHOLD : 0)) return false;
+            int64_t result;
+            start = now_seconds();
+            bool ok = call_int(&program, w->name, w->a, w->b, w->count, &result);
+            seconds[tiered] = now_seconds() - start;
+            interpreter_jit_stats(program.interpreter, &stats);
+            program_unload(&program);
+            if (!ok) return false;
+            if (result != w->expected) {
+                fprintf(stderr, "jit_bench: %s %s returned %lld, expected %lld\n", w->name,
+                        tiered ? "tiered" : "interpreted", (long long)result, (long long)w->expected);
+                return false;
+            }
+        }
+        printf("%s{\"benchmark\": \"jit_%s\", \"interpreter_ms\": %.2f, \"tiered_ms\": %.2f, \"c_ms\": %.2f, "
+               "\"speedup\": %.2f, \"of_c\": %.2f, \"compiled\": %zu, \"compile_ms\": %.3f, \"code_bytes\": %zu}",
+               i ? ",\n " : "", w->name, seconds[0] * 1e3, seconds[1] * 1e3, w->c_seconds * 1e3,
+               seconds[0] / seconds[1], w->c_seconds / seconds[1], stats.compiled, stats.compile_seconds * 1e3,
+               stats.code_bytes);
+    }
+    printf("]\n");
+    return true;
+}
+
+// 起動の速さ: 読み込みから、しきい値に届く前の短い呼び出しまで
+static bool run_startup(void) {
+    double seconds[2];
+    for (int tiered = 0; tiered < 2; tiered++) {
+        double start = now_seconds();
+        Program program;
+        if (!program_load(&program, tiered ? JIT_DEFAULT_THRESHOLD : 0)) return false;
+        int64_t result;
+        bool ok = call_int(&program, "fib", 10, 0, 1, &result) && result == 55;
+        seconds[tiered] = now_seconds() - start;
+        program_unload(&program);
+        if (!ok) return false;
+    }
+    printf("startup (load + fib(10)): %.3f ms interpreted, %.3f ms tiered\n", seconds[0] * 1e3, seconds[1] * 1e3);
+    return true;
+}
+
+#define CHECK(condition, message) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "jit_bench: %s\n", message); \
+            ok = false; \
+        } \
+    } while (0)
+
+// 機械語にできない場合と機械語から戻る場合
+static bool run_fallbacks(void) {
+    Program program;
+    if (!program_load(&program, JIT_DEFAULT_THRESHOLD)) return false;
+    bool ok = true;
+    int64_t result;
+
+    // 熱くする
+    const char* const warm[] = { "half", "ratio", "shifted", "is_small" };
+    for (size_t i = 0; i < sizeof(warm) / sizeof(warm[0]) && ok; i++) {
+        for (int n = 0; n < WARM_CALLS && ok; n++) {
+            Value args[2] = { value_int(n + 1), value_int(3) };
+            Value value;
+            ok = call(&program, warm[i], args, strcmp(warm[i], "ratio") == 0 ? 2 : 1, &value);
+        }
+    }
+    if (!ok) {
+        program_unload(&program);
+        return false;
+    }
+    CHECK(tier_of(&program, "half") == BYTECODE_TIER_NATIVE, "half was not compiled");
+    CHECK(tier_of(&program, "ratio") == BYTECODE_TIER_NATIVE, "ratio was not compiled");
+    CHECK(tier_of(&program, "is_small") == BYTECODE_TIER_NATIVE, "is_small was not compiled");
+    CHECK(tier_of(&program, "shifted") == BYTECODE_TIER_REJECTED, "shifted reads a global and must stay interpreted");
+
+    // 真偽値を返す関数
+    Value args[2] = { value_int(-3), value_int(0) };
+    Value value;
+    CHECK(call(&program, "is_small", args, 1, &value) && value.type == VALUE_BOOL && value.as.boolean,
+          "is_small(-3) is not true");
+    args[0] = value_int(40);
+    CHECK(call(&program, "is_small", args, 1, &value) && value.type == VALUE_BOOL && !value.as.boolean,
+          "is_small(40) is not false");
+    CHECK(call_int(&program, "ratio", -7, 2, 2, &result) && result == -3 - 1, "ratio(-7, 2) != -4");
+    CHECK(call_int(&program, "ratio", INT64_MIN, -1, 2, &result) && result == INT64_MIN,
+          "ratio(INT64_MIN, -1) did not wrap");
+
+    // 浮動小数点数の引数は入口で落ち、インタプリタが浮動小数点数で計算する
+    args[0] = value_float(3.0);
+    CHECK(call(&program, "half", args, 1, &value) && value.type == VALUE_FLOAT && value.as.number == 1.5,
+          "half(3.0) != 1.5");
+    // 0での除算は機械語から脱出し、インタプリタが同じエラーを返す
+    Value division[2] = { value_int(1), value_int(0) };
+    SlangError error = interpreter_call(program.interpreter, "ratio", division, 2, &value);
+    CHECK(error == SLANG_ERROR_RUNTIME && strcmp(interpreter_error(program.interpreter), "division by zero") == 0,
+          "ratio(1, 0) did not report division by zero");
+
+    // インタプリタだけのときと同じ深さで呼び出しが溢れる（溢れた呼び出しは深さごとに脱出する）
+    CHECK(call_int(&program, "depth", INTERPRETER_MAX_FRAMES - 1, 0, 1, &result) &&
+          result == INTERPRETER_MAX_FRAMES - 1, "depth below the frame limit failed");
+    CHECK(tier_of(&program, "depth") == BYTECODE_TIER_NATIVE, "depth was not compiled");
+    args[0] = value_int(INTERPRETER_MAX_FRAMES);
+    error = interpreter_call(program.interpreter, "depth", args, 1, &value);
+    CHECK(error == SLANG_ERROR_RUNTIME && strcmp(interpreter_error(program.interpreter), "call stack overflow") == 0,
+          "depth at the frame limit did not overflow");
+    CHECK(call_int(&program, "depth", INTERPRETER_MAX_FRAMES - 1, 0, 1, &result) &&
+          result == INTERPRETER_MAX_FRAMES - 1, "depth failed after the overflow");
+
+    // 落ち続ける関数は解釈に戻り、結果は変わらない
+    for (int n = 0; n < JIT_MAX_BAILOUTS && ok; n++) {
+        args[0] = value_float(n + 0.5);
+        ok = call(&program, "half", args, 1, &value) && value.type == VALUE_FLOAT && value.as.number == (n + 0.5) / 2;
+    }
+    CHECK(ok, "half on floats changed its result");
+    CHECK(tier_of(&program, "half") == BYTECODE_TIER_REJECTED, "half was not deoptimized");
+    CHECK(call_int(&program, "half", 9, 0, 1, &result) && result == 4, "half(9) != 4 after deoptimization");
+
+    JitStats stats;
+    interpreter_jit_stats(program.interpreter, &stats);
+    CHECK(stats.guard_failures == JIT_MAX_BAILOUTS && stats.bailouts >= 2 && stats.deoptimized >= 1 &&
+          stats.rejected >= 1, "unexpected JIT statistics");
+    if (ok) {
+        printf("fallbacks: %zu compiled, %zu rejected, %zu entries, %zu guard failures, %zu bailouts, %zu deoptimized\n",
+               stats.compiled, stats.rejected, stats.entries, stats.guard_failures, stats.bailouts, stats.deoptimized);
+    }
+    program_unload(&program);
+    return ok;
+}
+
+// JITとAOTの突き合わせ（呼び出しごとにlog!で1行書くmainを付けてAOTでコンパイルする）
+typedef struct {
+    const char* call;          // S-Langの式
+    const char* name;
+    int64_t a;
+    int64_t b;
+    size_t count;
+} CrossCall;
+
+static const CrossCall cross_calls[] = {
+    { "fib(20)", "fib", 20, 0, 1 },
+    { "sum_chunks(20, 1000)", "sum_chunks", 20, 1000, 2 },
+    { "collatz_total(3000)", "collatz_total", 3000, 0, 1 },
+    { "ratio(-7, 2)", "ratio", -7, 2, 2 },
+    { "half(-9)", "half", -9, 0, 1 },
+    { "is_small(-3)", "is_small", -3, 0, 1 },
+    { "is_small(40)", "is_small", 40, 0, 1 },
+    { "depth(500)", "depth", 500, 0, 1 },
+};
+
+#define CROSS_CALL_COUNT (sizeof(cross_calls) / sizeof(cross_calls[0]))
+
+static void append_value(char* out, size_t size, Value value) {
+    size_t length = strlen(out);
+    if (value.type == VALUE_BOOL) {
+        snprintf(out + length, size - length, "%s\n", value.as.boolean ? "true" : "false");
+    } else {
+        snprintf(out + length, size - length, "%lld\n", (long long)value.as.integer);
+    }
+}
+
+// しきい値1で2回ずつ呼び（2回目は機械語）、どちらもインタプリタだけのときと同じ行を書く
+static bool cross_jit(char* out, size_t size) {
+    Program interpreted, tiered;
+    if (!program_load(&interpreted, 0)) return false;
+    if (!program_load(&tiered, 1)) {
+        program_unload(&interpreted);
+        return false;
+    }
+    bool ok = true;
+    char expected[512] = "";
+    out[0] = '\0';
+    for (size_t i = 0; i < CROSS_CALL_COUNT && ok; i++) {
+        const CrossCall* c = &cross_calls[i];
+        Value args[2] = { value_int(c->a), value_int(c->b) };
+        Value first, second, reference;
+        ok = call(&interpreted, c->name, args, c->count, &reference) && call(&tiered, c->name, args, c->count, &first) &&
+             call(&tiered, c->name, args, c->count, &second);
+        if (!ok) break;
+        append_value(expected, sizeof(expected), reference);
+        append_value(out, size, second);
+        CHECK(value_equals(first, second) && value_equals(first, reference), "JIT and interpreter disagree");
+        CHECK(tier_of(&tiered, c->name) == BYTECODE_TIER_NATIVE, "cross-checked function was not compiled");
+        if (!ok) fprintf(stderr, "jit_bench: at %s\n", c->call);
+    }
+    CHECK(strcmp(out, expected) == 0, "JIT output differs from the interpreter");
+    program_unload(&tiered);
+    program_unload(&interpreted);
+    return ok;
+}
+
+// 同じプログラムをlevelでAOTコンパイルして実行し、標準出力をoutに読む（ccがなければ*ranはfalse）
+static bool cross_aot(int level, char* out, size_t size, bool* ran) {
+    *ran = false;
+    if (system("cc --version >/dev/null 2>&1") != 0) return true;
+    char directory[] = "/tmp/jit_bench_XXXXXX";
+    if (mkdtemp(directory) == NULL) return false;
+    char path[64], command[256];
+    snprintf(path, sizeof(path), "%s/cross.sl", directory);
+    FILE* file = fopen(path, "w");
+    bool ok = file != NULL && fputs(source, file) >= 0 && fputs("fn main() -> int {\n", file) >= 0;
+    for (size_t i = 0; ok && i < CROSS_CALL_COUNT; i++) {
+        ok = fprintf(file, "    log!(\"{}\", %s);\n", cross_calls[i].call) > 0;
+    }
+    ok = ok && fputs("    return 0;\n}\n", file) >= 0;
+    if (file != NULL && fclose(file) != 0) ok = false;
+
+    if (ok) {
+        DriverOptions options = { ASM_OUTPUT_OBJECT, { level, false, NULL }, NULL, 1, NULL };
+        Driver* driver = driver_create(&options);
+        ok = driver != NULL && driver_add_file(driver, path) == SLANG_SUCCESS && driver_compile(driver) == SLANG_SUCCESS;
+        driver_destroy(driver);
+        if (!ok) fprintf(stderr, "jit_bench: -O%d: the cross-check program did not compile\n", level);
+    }
+    if (ok) {
+        snprintf(command, sizeof(command), "cc -no-pie -o %s/cross %s.o && %s/cross > %s/output", directory, path,
+                 directory, directory);
+        ok = system(command) == 0;
+        if (!ok) fprintf(stderr, "jit_bench: -O%d: the cross-check program did not run\n", level);
+    }
+    if (ok) {
+        snprintf(command, sizeof(command), "%s/output", directory);
+        file = fopen(command, "r");
+        size_t length = file != NULL ? fread(out, 1, size - 1, file) : 0;
+        if (file != NULL) fclose(file);
+        out[length] = '\0';
+        *ran = true;
+    }
+    snprintf(command, sizeof(command), "rm -rf %s", directory);
+    if (system(command) != 0) ok = false;
+    return ok;
+}
+
+static bool run_cross_check(void) {
+    char jit[512], aot[512];
+    bool ran = false;
+    if (!cross_jit(jit, sizeof(jit))) return false;
+    for (int level = 0; level <= OPT_MAX_LEVEL; level++) {
+        if (!cross_aot(level, aot, sizeof(aot), &ran)) return false;
+        if (!ran) break;
+        if (strcmp(jit, aot) != 0) {
+            fprintf(stderr, "jit_bench: JIT wrote\n%sAOT -O%d wrote\n%s", jit, level, aot);
+            return false;
+        }
+    }
+    printf("cross-check: %zu calls, JIT matches the interpreter%s\n", CROSS_CALL_COUNT,
+           ran ? " and AOT at every -O level" : " (AOT skipped, no cc)");
+    return true;
+}
+
+int main(void) {
+    if (!intern_init() || !type_table_init()) return 1;
+    bool ok = run_workloads() && run_startup() && run_fallbacks() && run_cross_check();
+    intern_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// キーワード認識のマイクロベンチマーク
+// 完全ハッシュ（keyword_lookup）と従来の線形テーブル走査を比較する。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "keyword.h"
+
+// 従来の実装: キーワード表を先頭からstrcmpで走査する
+typedef struct {
+    const char* keyword;
+    TokenType type;
+} Keyword;
+
+static const Keyword keywords[] = {
+#define KEYWORD(text, type) {text, type},
+#include "keywords.def"
+#undef KEYWORD
+    {NULL, 0}
+};
+
+static TokenType table_scan_lookup(const char* text, size_t length) {
+    for (const Keyword* kw = keywords; kw->keyword != NULL; kw++) {
+        if (strncmp(text, kw->keyword, length) == 0 && kw->keyword[length] == '\0') {
+            return kw->type;
+        }
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+// 識別子とキーワードが混ざった入力
+static const char* const corpus[] = {
+    "fn", "main", "let", "count", "if", "x", "else", "while", "index", "for",
+    "return", "result", "break", "continue", "struct", "Point", "impl", "trait",
+    "use", "std", "pub", "priv", "task_manager", "priority", "value", "_tmp",
+    "len", "letter", "iff", "println", "self", "vector_push",
+};
+
+#define CORPUS_SIZE (sizeof(corpus) / sizeof(corpus[0]))
+#define ITERATIONS 2000000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef TokenType (*LookupFn)(const char*, size_t);
+
+static double run(LookupFn lookup, size_t* lengths, unsigned long* checksum) {
+    unsigned long sum = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        size_t j = i % CORPUS_SIZE;
+        sum += (unsigned long)lookup(corpus[j], lengths[j]);
+    }
+    double elapsed = now_seconds() - start;
+    *checksum = sum;
+    return elapsed * 1e9 / ITERATIONS;
+}
+
+int main(void) {
+    size_t lengths[CORPUS_SIZE];
+    for (size_t i = 0; i < CORPUS_SIZE; i++) {
+        lengths[i] = strlen(corpus[i]);
+        if (keyword_lookup(corpus[i], lengths[i]) != table_scan_lookup(corpus[i], lengths[i])) {
+            fprintf(stderr, "keyword_bench: mismatch for '%s'\n", corpus[i]);
+            return 1;
+        }
+    }
+
+    unsigned long hash_sum, scan_sum;
+    double hash_ns = run(keyword_lookup, lengths, &hash_sum);
+    double scan_ns = run(table_scan_lookup, lengths, &scan_sum);
+    if (hash_sum != scan_sum) {
+        fprintf(stderr, "keyword_bench: checksum mismatch\n");
+        return 1;
+    }
+
+    printf("{\"benchmark\": \"keyword_lookup\", \"iterations\": %d, "
+           "\"perfect_hash_ns\": %.2f, \"table_scan_ns\": %.2f, \"speedup\": %.2f, "
+           "\"checksum\": %lu}\n",
+           ITERATIONS, hash_ns, scan_ns, scan_ns / hash_ns, hash_sum);
+    return 0;
+}
@@ -0,0 +1,225 @@
+// 非同期ロガーのベンチマーク
+// 整形の規則と、複数スレッドから書いた記録が欠けず混ざらずに出ることを確かめてから、
+// 呼び出しの費用をその場でfprintfする場合と比べる（有効・段階で無効・コンパイル時に消した呼び出し）。
+// 最後にSlangのlog!/debug!を実行し、log_thresholdでdebug!が呼び出しごと消えることを確かめる。
+#define LOGGER_COMPILE_LEVEL LOG_LEVEL_INFO
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "logger.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "intern.h"
+
+#define THREADS 4
+#define RECORDS_PER_THREAD 20000
+#define CALLS 200000
+#define SCRIPT_ITERATIONS 200000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool check_format(void) {
+    static const struct {
+        LogLevel level;
+        const char* format;
+        LogArg args[3];
+        size_t count;
+        const char* expected;
+    } cases[] = {
+        { LOG_LEVEL_LOG, "Hello, World!", { { 0 } }, 0, "Hello, World!\n" },
+        { LOG_LEVEL_INFO, "x = {}, y = {}", { LOG_INT(-3), LOG_FLOAT(1.5) }, 2, "[info] x = -3, y = 1.5\n" },
+        { LOG_LEVEL_WARN, "{}", { LOG_BOOL(true), LOG_STRING("extra"), { LOG_ARG_NIL, { 0 } } }, 3,
+          "[warn] true extra nil\n" },
+        { LOG_LEVEL_ERROR, "{} {} left", { LOG_INT(1) }, 1, "[error] 1 {} left\n" },
+        { LOG_LEVEL_LOG, "", { LOG_INT(1), LOG_INT(2) }, 2, "1 2\n" },
+    };
+    char line[LOGGER_LINE_MAX];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        logger_format(line, sizeof(line), cases[i].level, cases[i].format, cases[i].args, cases[i].count);
+        if (strcmp(line, cases[i].expected) != 0) {
+            fprintf(stderr, "logger_bench: format %zu gave \"%s\"\n", i, line);
+            return false;
+        }
+    }
+
+    // 切り詰めても改行で終わる
+    size_t length = logger_format(line, 8, LOG_LEVEL_LOG, "0123456789", NULL, 0);
+    if (length != 7 || strcmp(line, "012345\n") != 0) {
+        fprintf(stderr, "logger_bench: truncated format gave \"%s\"\n", line);
+        return false;
+    }
+    return logger_level_of("alert") == LOG_LEVEL_ALERT && logger_level_of("println") == -1 &&
+           logger_level_class(LOG_LEVEL_DEBUG) == LOG_CLASS_LOG && logger_level_rank(LOG_LEVEL_DEBUG) == 2 &&
+           logger_level_class(LOG_LEVEL_WARN) == LOG_CLASS_EMERG && logger_level_rank(LOG_LEVEL_WARN) == 0;
+}
+
+typedef struct {
+    Logger* logger;
+    int thread;
+} Producer;
+
+static void* produce(void* argument) {
+    Producer* producer = argument;
+    char name[16];
+    snprintf(name, sizeof(name), "t%d", producer->thread);
+    for (int i = 0; i < RECORDS_PER_THREAD; i++) {
+        LOGGER_LOG(producer->logger, LOG_LEVEL_INFO, "{} {}", LOG_STRING(name), LOG_INT(i));
+    }
+    return NULL;
+}
+
+// 各スレッドの記録がすべて、書いた順に、壊れずに出ているか
+static bool check_threads(void) {
+    FILE* sink = tmpfile();
+    Logger* logger = sink != NULL ? logger_create(sink, LOG_LEVEL_LOG, 4u << 20) : NULL;
+    if (logger == NULL) return false;
+
+    pthread_t threads[THREADS];
+    Producer producers[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        producers[t] = (Producer){ logger, t };
+        pthread_create(&threads[t], NULL, produce, &producers[t]);
+    }
+    for (int t = 0; t < THREADS; t++) pthread_join(threads[t], NULL);
+    logger_flush(logger);
+    size_t dropped = atomic_load(&logger->dropped);
+    logger_destroy(logger);
+
+    rewind(sink);
+    int next[THREADS] = { 0 };
+    char line[128];
+    bool ok = dropped == 0;
+    while (ok && fgets(line, sizeof(line), sink) != NULL) {
+        int thread, index;
+        ok = sscanf(line, "[info] t%d %d\n", &thread, &index) == 2 && thread >= 0 && thread < THREADS &&
+             index == next[thread]++;
+    }
+    for (int t = 0; t < THREADS; t++) ok = ok && next[t] == RECORDS_PER_THREAD;
+    fclose(sink);
+    if (!ok) fprintf(stderr, "logger_bench: threaded records were lost or reordered (dropped %zu)\n", dropped);
+    return ok;
+}
+
+static void bench_calls(void) {
+    FILE* sink = fopen("/dev/null", "w");
+    // 計る間に背景のスレッドが追いつかなくても捨てない大きさ
+    Logger* logger = sink != NULL ? logger_create(sink, LOG_LEVEL_LOG, 32u << 20) : NULL;
+    if (logger == NULL) return;
+
+    double start = now_seconds();
+    for (int i = 0; i < CALLS; i++) {
+        fprintf(sink, "[info] request %d took %g ms\n", i, i * 0.25);
+    }
+    fflush(sink);
+    double sync = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < CALLS; i++) {
+        LOGGER_LOG(logger, LOG_LEVEL_INFO, "request {} took {} ms", LOG_INT(i), LOG_FLOAT(i * 0.25));
+    }
+    double async = now_seconds() - start;
+    logger_flush(logger);
+    double drained = now_seconds() - start;
+
+    logger_set_threshold(logger, LOG_LEVEL_ERROR);
+    start = now_seconds();
+    for (int i = 0; i < CALLS; i++) {
+        LOGGER_LOG(logger, LOG_LEVEL_WARN, "request {} took {} ms", LOG_INT(i), LOG_FLOAT(i * 0.25));
+    }
+    double disabled = now_seconds() - start;
+
+    // LOGGER_COMPILE_LEVELがINFOなのでLOGの呼び出しは消える
+    start = now_seconds();
+    for (int i = 0; i < CALLS; i++) {
+        LOGGER_LOG(logger, LOG_LEVEL_LOG, "request {} took {} ms", LOG_INT(i), LOG_FLOAT(i * 0.25));
+    }
+    double removed = now_seconds() - start;
+
+    printf("fprintf:            %7.1f ns/call\n", sync * 1e9 / CALLS);
+    printf("logger (enabled):   %7.1f ns/call  (%.1f ns/call until written, %zu dropped)\n",
+           async * 1e9 / CALLS, drained * 1e9 / CALLS, atomic_load(&logger->dropped));
+    printf("logger (disabled):  %7.1f ns/call\n", disabled * 1e9 / CALLS);
+    printf("logger (removed):   %7.1f ns/call\n", removed * 1e9 / CALLS);
+    logger_destroy(logger);
+    fclose(sink);
+}
+
+// Slangのプログラムを実行して、出力した行の数と時間を返す
+static bool run_script(const char* source, LogLevel threshold, int log_threshold, size_t* lines, double* seconds) {
+    FILE* sink = tmpfile();
+    Logger* logger = sink != NULL ? logger_create(sink, threshold, 32u << 20) : NULL;
+    Arena* arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    Lexer* lexer = lexer_create(source, strlen(source));
+    Parser* parser = NULL;
+    Interpreter* interpreter = create_interpreter();
+    ASTNode* program = NULL;
+    bool ok = logger != NULL && arena != NULL && lexer != NULL && interpreter != NULL &&
+              lexer_scan(lexer) == SLANG_SUCCESS && (parser = parser_create(lexer, arena)) != NULL &&
+              parser_parse(parser, &program) == SLANG_SUCCESS;
+    if (ok) {
+        logger_install(logger);
+        interpreter->program->log_threshold = log_threshold;
+        double start = now_seconds();
+        ok = interpret(interpreter, program) == SLANG_SUCCESS;
+        logger_flush(logger);
+        *seconds = now_seconds() - start;
+        logger_install(NULL);
+    }
+    if (ok) {
+        *lines = 0;
+        rewind(sink);
+        for (int c; (c = fgetc(sink)) != EOF;) *lines += c == '\n';
+        ok = atomic_load(&logger->dropped) == 0;
+    }
+    free_interpreter(interpreter);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    arena_destroy(arena);
+    logger_destroy(logger);
+    if (sink != NULL) fclose(sink);
+    return ok;
+}
+
+static bool bench_script(void) {
+    static const char check[] =
+        "let i = 0;\n"
+        "while i < 3 { debug!(\"d {}\", i); log!(\"i = {}\", i); i = i + 1; }\n"
+        "warn!(\"done {} {}\", 1.5, true);\n";
+    size_t lines;
+    double seconds;
+    // log!は[Log, 0]、debug!は[Log, 2]、warn!は[Emerg, 0]
+    if (!run_script(check, LOG_LEVEL_LOG, 0, &lines, &seconds) || lines != 7 ||
+        !run_script(check, LOG_LEVEL_LOG, LOG_LEVEL_INFO, &lines, &seconds) || lines != 4 ||
+        !run_script(check, LOG_LEVEL_WARN, 0, &lines, &seconds) || lines != 1) {
+        fprintf(stderr, "logger_bench: script logging gave the wrong lines\n");
+        return false;
+    }
+
+    char loop[256];
+    snprintf(loop, sizeof(loop),
+             "let i = 0;\n"
+             "while i < %d { debug!(\"step {} of {}\", i, %d); i = i + 1; }\n",
+             SCRIPT_ITERATIONS, SCRIPT_ITERATIONS);
+    double enabled, disabled, elided;
+    if (!run_script(loop, LOG_LEVEL_LOG, 0, &lines, &enabled) || lines != SCRIPT_ITERATIONS ||
+        !run_script(loop, LOG_LEVEL_WARN, 0, &lines, &disabled) || lines != 0 ||
+        !run_script(loop, LOG_LEVEL_LOG, LOG_LEVEL_WARN, &lines, &elided) || lines != 0) {
+        fprintf(stderr, "logger_bench: script loop failed\n");
+        return false;
+    }
+    printf("debug! in a loop:   %7.1f ns/iteration enabled, %.1f disabled, %.1f elided\n",
+           enabled * 1e9 / SCRIPT_ITERATIONS, disabled * 1e9 / SCRIPT_ITERATIONS, elided * 1e9 / SCRIPT_ITERATIONS);
+    return true;
+}
+
+int main(void) {
+    if (!check_format() || !check_threads()) return 1;
+    bench_calls();
+    return bench_script() ? 0 : 1;
+}
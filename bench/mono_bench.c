@@ -0,0 +1,360 @@
+// 汎用関数の特殊化のベンチマーク
+// 汎用関数を並べたライブラリの単位を検査してから、それを呼ぶ多数のクライアントの単位を
+// 複数のスレッドで1つのMonoCacheを共有して検査し、特殊化が型引数の組ごとに1つだけ作られ、
+// 1回だけ検査され、どのクライアントからも検査の終わりを待てることを確かめる。特殊化の数の上限とノード数の上限で
+// 共有の本体に戻ること、特殊化の中の型エラー、呼び出しに書かれる特殊化の名前、汎用関数の
+// 型引数が平らなASTを往復すること、特殊化の記号が.oでweakになることも確かめ、最後に
+// 特殊化あり・なしの検査の時間を比べる。
+#include <elf.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "intern.h"
+#include "parser.h"
+#include "flat_ast.h"
+#include "monomorph.h"
+#include "asm_writer.h"
+
+#define CLIENTS 64
+#define THREADS 4
+#define REPEATS 20
+#define EXPECTED_INSTANCES 6
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// twiceの特殊化はidの特殊化を使い、共有の本体のid(x)は型が分からないので共有の本体を呼ぶ
+static const char library_source[] =
+    "fn id<T>(x: T) -> T { return x; }\n"
+    "fn pick<T>(c: bool, a: T, b: T) -> T { if c { return a; } return b; }\n"
+    "fn twice<T>(x: T) -> T { let y: T = id(x); return id(y); }\n"
+    "fn sum<T>(a: T, b: T) -> T { return a + b; }\n";
+
+// 特殊化はid.int id.float pick.string twice.int sum.float sum.intの6つ
+static const char client_format[] =
+    "fn use%d(n: int) -> int {\n"
+    "    let a: int = id(n);\n"
+    "    let b: float = id(1.5);\n"
+    "    let s: string = pick(n > 0, \"a\", \"b\");\n"
+    "    let t: int = twice(n);\n"
+    "    let u: float = sum(2.5, 1.0);\n"
+    "    return sum(a, t);\n"
+    "}\n";
+
+typedef struct {
+    char* source;
+    Arena* arena;
+    Lexer* lexer;
+    Parser* parser;
+    ASTNode* program;
+} Unit;
+
+static bool unit_parse(Unit* unit, const char* source) {
+    unit->source = strdup(source);
+    unit->arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    unit->lexer = unit->source ? lexer_create(unit->source, strlen(unit->source)) : NULL;
+    unit->parser = NULL;
+    unit->program = NULL;
+    bool ok = unit->arena != NULL && unit->lexer != NULL && lexer_scan(unit->lexer) == SLANG_SUCCESS &&
+              (unit->parser = parser_create(unit->lexer, unit->arena)) != NULL &&
+              parser_parse(unit->parser, &unit->program) == SLANG_SUCCESS;
+    if (!ok) fprintf(stderr, "mono_bench: parsing failed:\n%s", source);
+    return ok;
+}
+
+static void unit_release(Unit* unit) {
+    parser_destroy(unit->parser);
+    if (unit->lexer != NULL) lexer_destroy(unit->lexer);
+    arena_destroy(unit->arena);
+    free(unit->source);
+}
+
+static SlangError check_program(TypeChecker* checker, const Unit* unit) {
+    const BlockStatement* program = &unit->program->data.block_statement;
+    return type_checker_check(checker, program->statements, program->statement_count);
+}
+
+// ドライバと同じく、ライブラリの検査器の関数をホストの宣言として見せる
+static TypeChecker* client_checker(const TypeChecker* library, MonoCache* cache) {
+    TypeChecker* checker = type_checker_create();
+    if (checker == NULL) return NULL;
+    for (size_t i = library->host_signature_count; i < library->signature_count; i++) {
+        if (!type_checker_declare_signature(checker, &library->signatures[i])) {
+            type_checker_destroy(checker);
+            return NULL;
+        }
+    }
+    checker->specializations = cache;
+    return checker;
+}
+
+typedef struct {
+    const TypeChecker* library;
+    MonoCache* cache;
+    Unit* clients;
+    size_t first;
+    size_t step;
+    size_t failures;
+    size_t used;               // クライアントごとの使った特殊化の数の合計
+    size_t ready;              // そのうち検査に成功したのを待てた数
+} Worker;
+
+static void* worker_main(void* argument) {
+    Worker* worker = argument;
+    for (size_t i = worker->first; i < CLIENTS; i += worker->step) {
+        TypeChecker* checker = client_checker(worker->library, worker->cache);
+        if (checker == NULL || check_program(checker, &worker->clients[i]) != SLANG_SUCCESS) {
+            if (checker != NULL) fprintf(stderr, "mono_bench: use%zu: %s\n", i, checker->error);
+            worker->failures++;
+        } else {
+            worker->used += checker->instance_count;
+            for (size_t k = 0; k < checker->instance_count; k++) {
+                if (mono_wait_check(worker->cache, checker->instances[k])) worker->ready++;
+            }
+        }
+        type_checker_destroy(checker);
+    }
+    return NULL;
+}
+
+// use0の最初のletの初期化式（id(n)）
+static const FunctionCall* first_call(const Unit* unit) {
+    const ASTNode* function = unit->program->data.block_statement.statements[0];
+    const ASTNode* let = function->data.function.body->data.block_statement.statements[0];
+    return &let->data.let_statement.initializer->data.function_call;
+}
+
+static bool check_dedup(const Unit* library, Unit* clients) {
+    MonoCache* cache = mono_cache_create(NULL);
+    TypeChecker* checker = type_checker_create();
+    if (cache == NULL || checker == NULL) return false;
+    checker->specializations = cache;
+    bool ok = check_program(checker, library) == SLANG_SUCCESS;
+    if (!ok) fprintf(stderr, "mono_bench: library: %s\n", checker->error);
+
+    Worker workers[THREADS];
+    pthread_t threads[THREADS];
+    for (size_t t = 0; t < THREADS; t++) {
+        workers[t] = (Worker){ checker, cache, clients, t, THREADS, 0, 0, 0 };
+        if (ok && pthread_create(&threads[t], NULL, worker_main, &workers[t]) != 0) {
+            perror("mono_bench: pthread_create");
+            return false;
+        }
+    }
+    size_t failures = 0, used = 0, ready = 0;
+    for (size_t t = 0; t < THREADS && ok; t++) {
+        pthread_join(threads[t], NULL);
+        failures += workers[t].failures;
+        used += workers[t].used;
+        ready += workers[t].ready;
+    }
+
+    MonoStats stats = mono_stats(cache);
+    const char* expected = intern_cstr("id.int");
+    const char* written = first_call(&clients[0])->specialization;
+    ok = ok && failures == 0 && stats.instances == EXPECTED_INSTANCES && stats.checks == EXPECTED_INSTANCES &&
+         ready == used && written == expected;
+    printf("dedup            %s  %d clients on %d threads: %zu instances (%zu hits, %zu fallbacks), %zu checked, "
+           "%zu of %zu uses ready\n", ok ? "ok    " : "FAILED", CLIENTS, THREADS, stats.instances, stats.hits, stats.fallbacks,
+           stats.checks, ready, used);
+    if (written != expected) fprintf(stderr, "mono_bench: id(n) uses %s\n", written ? written : "the shared body");
+
+    type_checker_destroy(checker);
+    mono_cache_destroy(cache);
+    return ok;
+}
+
+// 上限を超えた呼び出しは共有の本体を使い、検査は通る
+static bool check_limit(const char* name, const MonoOptions* options, const Unit* library, const Unit* client,
+                        size_t expected_instances) {
+    MonoCache* cache = mono_cache_create(options);
+    TypeChecker* checker = type_checker_create();
+    if (cache == NULL || checker == NULL) return false;
+    checker->specializations = cache;
+    bool ok = check_program(checker, library) == SLANG_SUCCESS;
+    TypeChecker* user = ok ? client_checker(checker, cache) : NULL;
+    ok = user != NULL && check_program(user, client) == SLANG_SUCCESS;
+
+    MonoStats stats = mono_stats(cache);
+    ok = ok && stats.instances == expected_instances && stats.fallbacks > 0;
+    printf("%-16s %s  %zu instances, %zu fallbacks, %zu nodes copied\n", name, ok ? "ok    " : "FAILED",
+           stats.instances, stats.fallbacks, stats.nodes);
+    type_checker_destroy(user);
+    type_checker_destroy(checker);
+    mono_cache_destroy(cache);
+    return ok;
+}
+
+// 共有の本体は型引数の型を実行時に決まる型として通るが、特殊化はその型で検査する
+static bool check_error(const Unit* library) {
+    Unit client;
+    bool ok = unit_parse(&client, "fn bad() -> int { let s: string = sum(\"a\", \"b\"); return 0; }\n");
+    MonoCache* cache = mono_cache_create(NULL);
+    TypeChecker* checker = type_checker_create();
+    if (!ok || cache == NULL || checker == NULL) return false;
+    checker->specializations = cache;
+    ok = check_program(checker, library) == SLANG_SUCCESS;
+    TypeChecker* user = ok ? client_checker(checker, cache) : NULL;
+    SlangError error = user ? check_program(user, &client) : SLANG_ERROR_INTERNAL;
+    const char* message = user ? user->error : NULL;
+    ok = error == SLANG_ERROR_TYPE && message == intern_cstr("sum.string: invalid operand types");
+    printf("instance error   %s  %s\n", ok ? "ok    " : "FAILED", message ? message : "(none)");
+    type_checker_destroy(user);
+    type_checker_destroy(checker);
+    mono_cache_destroy(cache);
+    unit_release(&client);
+    return ok;
+}
+
+static bool check_flat(const Unit* library) {
+    FlatAst* flat = flat_ast_create();
+    Arena* arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    ASTNode* copy = NULL;
+    bool ok = flat != NULL && arena != NULL && flat_ast_build(flat, library->program) == SLANG_SUCCESS &&
+              flat_ast_expand(flat, arena, &copy) == SLANG_SUCCESS;
+    const BlockStatement* before = &library->program->data.block_statement;
+    for (size_t i = 0; ok && i < before->statement_count; i++) {
+        const Function* original = &before->statements[i]->data.function;
+        const Function* expanded = &copy->data.block_statement.statements[i]->data.function;
+        ok = expanded->type_parameter_count == original->type_parameter_count;
+        for (size_t t = 0; ok && t < original->type_parameter_count; t++) {
+            ok = expanded->type_parameters[t] == original->type_parameters[t];
+        }
+    }
+    printf("flat ast         %s  type parameters survive build and expand\n", ok ? "ok    " : "FAILED");
+    flat_ast_destroy(flat);
+    arena_destroy(arena);
+    return ok;
+}
+
+// .oの記号表からnameのbindingを読む（見つからなければ-1）
+static int symbol_binding(const char* path, const char* name) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* image = size > 0 ? malloc((size_t)size) : NULL;
+    bool read = image != NULL && fread(image, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    if (!read || (size_t)size < sizeof(Elf64_Ehdr)) {
+        free(image);
+        return -1;
+    }
+
+    int binding = -1;
+    const Elf64_Ehdr* header = (const Elf64_Ehdr*)image;
+    const Elf64_Shdr* sections = (const Elf64_Shdr*)(image + header->e_shoff);
+    for (size_t s = 0; s < header->e_shnum && binding < 0; s++) {
+        if (sections[s].sh_type != SHT_SYMTAB) continue;
+        const Elf64_Sym* symbols = (const Elf64_Sym*)(image + sections[s].sh_offset);
+        const char* names = (const char*)image + sections[sections[s].sh_link].sh_offset;
+        size_t count = sections[s].sh_size / sizeof(Elf64_Sym);
+        for (size_t i = 1; i < count; i++) {
+            if (strcmp(names + symbols[i].st_name, name) == 0) {
+                binding = ELF64_ST_BIND(symbols[i].st_info);
+                break;
+            }
+        }
+    }
+    free(image);
+    return binding;
+}
+
+// codegen.cのプロローグと同じく、特殊化の名前ならweak、そうでなければglobalにする
+static bool check_weak(void) {
+    char path[] = "/tmp/slang_mono_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mono_bench: mkstemp");
+        return false;
+    }
+    close(fd);
+
+    static const char* const names[] = { "id.int", "use0" };
+    AsmWriter writer;
+    bool ok = asm_writer_open_object(&writer, path);
+    for (size_t i = 0; ok && i < 2; i++) {
+        if (mono_is_instance_name(names[i])) asm_weak_symbol(&writer, names[i]);
+        else asm_global_symbol(&writer, names[i]);
+    }
+    for (size_t i = 0; ok && i < 2; i++) {
+        asm_symbol(&writer, names[i]);
+        asm_emit0(&writer, ASM_RET);
+    }
+    ok = ok && asm_writer_close(&writer);
+    ok = ok && symbol_binding(path, "id.int") == STB_WEAK && symbol_binding(path, "use0") == STB_GLOBAL;
+    printf("weak symbol      %s  id.int is weak, use0 is global\n", ok ? "ok    " : "FAILED");
+    unlink(path);
+    return ok;
+}
+
+// 同じクライアントをすべて検査する時間（検査器には毎回ライブラリを宣言し直す）
+static double time_clients(const TypeChecker* library, const Unit* library_unit, const Unit* clients, bool specialize) {
+    double best = 0.0;
+    for (int r = 0; r < REPEATS; r++) {
+        MonoCache* cache = specialize ? mono_cache_create(NULL) : NULL;
+        double start = now_seconds();
+        if (cache != NULL) {
+            // 検査の最後にライブラリの環境をキャッシュに渡す
+            TypeChecker* owner = type_checker_create();
+            if (owner == NULL) return -1.0;
+            owner->specializations = cache;
+            check_program(owner, library_unit);
+            type_checker_destroy(owner);
+        }
+        for (size_t i = 0; i < CLIENTS; i++) {
+            TypeChecker* checker = client_checker(library, cache);
+            if (checker == NULL) return -1.0;
+            check_program(checker, &clients[i]);
+            type_checker_destroy(checker);
+        }
+        double elapsed = now_seconds() - start;
+        mono_cache_destroy(cache);
+        if (r == 0 || elapsed < best) best = elapsed;
+    }
+    return best * 1e3;
+}
+
+int main(void) {
+    if (!intern_init() || !type_table_init()) return 1;
+    Unit library;
+    Unit clients[CLIENTS];
+    bool ok = unit_parse(&library, library_source);
+    char source[sizeof(client_format) + 16];
+    for (int i = 0; i < CLIENTS && ok; i++) {
+        snprintf(source, sizeof(source), client_format, i);
+        ok = unit_parse(&clients[i], source);
+    }
+    if (!ok) return 1;
+
+    ok = check_dedup(&library, clients) && ok;
+    // idの2つ目の型引数の組で特殊化の数の上限に当たる（twice.intの中のid(y)はid.intを使う）
+    MonoOptions one = { 1, 0 };
+    ok = check_limit("instance limit", &one, &library, &clients[0], 4) && ok;
+    // 写しのノード数の上限が小さければ特殊化を作らない
+    MonoOptions tiny = { 0, 2 };
+    ok = check_limit("node budget", &tiny, &library, &clients[0], 0) && ok;
+    ok = check_error(&library) && ok;
+    ok = check_flat(&library) && ok;
+    ok = check_weak() && ok;
+
+    TypeChecker* checker = type_checker_create();
+    if (checker == NULL || check_program(checker, &library) != SLANG_SUCCESS) return 1;
+    double shared = time_clients(checker, &library, clients, false);
+    double specialized = time_clients(checker, &library, clients, true);
+    printf("\ncheck %d clients: %.3f ms with shared bodies, %.3f ms with specializations (%.2fx)\n",
+           CLIENTS, shared, specialized, shared > 0.0 ? specialized / shared : 0.0);
+    type_checker_destroy(checker);
+
+    unit_release(&library);
+    for (int i = 0; i < CLIENTS; i++) unit_release(&clients[i]);
+    intern_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,483 @@
+// 最適化パスのベンチマーク
+// ループ不変式・共通部分式・定数の条件・小さな関数の呼び出しを含む関数をIRで組み、
+// -O0・-O1・-O2のそれぞれで最適化してからレジスタ割り当てとx86_emitterで出力し、
+// IRの命令数と出力した命令数を比べる。ccが使えれば全部をアセンブルして実行し、
+// 結果が一致することを確かめて実行時間も測る。
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ir.h"
+#include "optimizer.h"
+#include "regalloc.h"
+#include "x86_emitter.h"
+
+// 関数本体の小さな木
+typedef enum { EXPR_INT, EXPR_FLOAT, EXPR_VAR, EXPR_GLOBAL, EXPR_BINARY, EXPR_CALL } ExprKind;
+
+typedef struct Expr {
+    ExprKind kind;
+    IrType type;
+    int64_t integer;
+    double number;
+    int var;
+    const char* name;          // EXPR_GLOBALの変数、EXPR_CALLの関数（接頭辞なし）
+    IrOpcode op;
+    struct Expr* left;
+    struct Expr* right;
+} Expr;
+
+typedef enum { STMT_ASSIGN, STMT_WHILE, STMT_IF, STMT_RETURN } StmtKind;
+
+typedef struct Stmt {
+    StmtKind kind;
+    int var;
+    Expr* expr;
+    struct Stmt** body;
+    size_t body_count;
+} Stmt;
+
+#define MAX_VARS 8
+
+typedef struct {
+    const char* name;
+    int param_count;
+    int var_count;
+    IrType types[MAX_VARS];   // 先頭param_count個が引数
+    Stmt** body;
+    size_t body_count;
+} Kernel;
+
+static Expr expr_pool[256];
+static Stmt stmt_pool[64];
+static Stmt* list_pool[128];
+static size_t expr_used, stmt_used, list_used;
+static const Kernel* building;
+
+static Expr* new_expr(ExprKind kind, IrType type) {
+    Expr* e = &expr_pool[expr_used++];
+    memset(e, 0, sizeof(Expr));
+    e->kind = kind;
+    e->type = type;
+    return e;
+}
+
+static Expr* i64(int64_t value) {
+    Expr* e = new_expr(EXPR_INT, IR_INT);
+    e->integer = value;
+    return e;
+}
+
+static Expr* f64(double value) {
+    Expr* e = new_expr(EXPR_FLOAT, IR_FLOAT);
+    e->number = value;
+    return e;
+}
+
+static Expr* var(int index) {
+    Expr* e = new_expr(EXPR_VAR, building->types[index]);
+    e->var = index;
+    return e;
+}
+
+static Expr* global(const char* name) {
+    Expr* e = new_expr(EXPR_GLOBAL, IR_INT);
+    e->name = name;
+    return e;
+}
+
+static Expr* bin(Expr* left, IrOpcode op, Expr* right) {
+    Expr* e = new_expr(EXPR_BINARY, ir_is_comparison(op) ? IR_INT : left->type);
+    e->op = op;
+    e->left = left;
+    e->right = right;
+    return e;
+}
+
+static Expr* call(const char* name, Expr* argument) {
+    Expr* e = new_expr(EXPR_CALL, IR_INT);
+    e->name = name;
+    e->left = argument;
+    return e;
+}
+
+static Stmt** list(size_t count, ...) {
+    Stmt** items = &list_pool[list_used];
+    va_list args;
+    va_start(args, count);
+    for (size_t i = 0; i < count; i++) list_pool[list_used++] = va_arg(args, Stmt*);
+    va_end(args);
+    return items;
+}
+
+static Stmt* new_stmt(StmtKind kind, Expr* expr) {
+    Stmt* s = &stmt_pool[stmt_used++];
+    memset(s, 0, sizeof(Stmt));
+    s->kind = kind;
+    s->expr = expr;
+    return s;
+}
+
+static Stmt* assign(int var_index, Expr* expr) {
+    Stmt* s = new_stmt(STMT_ASSIGN, expr);
+    s->var = var_index;
+    return s;
+}
+
+static Stmt* loop(Expr* condition, Stmt** body, size_t count) {
+    Stmt* s = new_stmt(STMT_WHILE, condition);
+    s->body = body;
+    s->body_count = count;
+    return s;
+}
+
+static Stmt* when(Expr* condition, Stmt** body, size_t count) {
+    Stmt* s = new_stmt(STMT_IF, condition);
+    s->body = body;
+    s->body_count = count;
+    return s;
+}
+
+static Stmt* ret(Expr* expr) {
+    return new_stmt(STMT_RETURN, expr);
+}
+
+// 計測する関数
+// invariant(n, a, b): ループ不変式（a * b + 3）と同じ式の繰り返し（i * t）
+// calls(n): 小さな関数sq(x)の呼び出し（-O2でインライン展開される）
+// folded(n): 定数になる条件の分岐と、定数どうしの演算
+// globals(n): ループの中で書き換えないグローバル変数の読み出し
+// floats(x, n): 浮動小数点数の不変式と共通部分式
+// sq(x): 呼び出される側
+enum { INV_N, INV_A, INV_B, INV_S, INV_I, INV_T };
+enum { CALLS_N, CALLS_S, CALLS_I };
+enum { FOLD_N, FOLD_K, FOLD_S, FOLD_I };
+enum { GLOB_N, GLOB_S, GLOB_I };
+enum { FLT_X, FLT_N, FLT_ACC, FLT_I };
+enum { SQ_X };
+
+static Kernel kernels[6] = {
+    {"invariant", 3, 6, {IR_INT, IR_INT, IR_INT, IR_INT, IR_INT, IR_INT}, NULL, 0},
+    {"calls", 1, 3, {IR_INT, IR_INT, IR_INT}, NULL, 0},
+    {"folded", 1, 4, {IR_INT, IR_INT, IR_INT, IR_INT}, NULL, 0},
+    {"globals", 1, 3, {IR_INT, IR_INT, IR_INT}, NULL, 0},
+    {"floats", 2, 4, {IR_FLOAT, IR_INT, IR_FLOAT, IR_INT}, NULL, 0},
+    {"sq", 1, 1, {IR_INT}, NULL, 0},
+};
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+// 計測するのはsq以外
+#define TIMED_COUNT (KERNEL_COUNT - 1)
+
+static void build_kernels(void) {
+    building = &kernels[0];
+    kernels[0].body = list(4,
+        assign(INV_S, i64(0)),
+        assign(INV_I, i64(0)),
+        loop(bin(var(INV_I), IR_LT, var(INV_N)), list(3,
+            assign(INV_T, bin(bin(var(INV_A), IR_MUL, var(INV_B)), IR_ADD, i64(3))),
+            assign(INV_S, bin(bin(var(INV_S), IR_ADD, bin(var(INV_I), IR_MUL, var(INV_T))), IR_SUB,
+                              bin(bin(var(INV_I), IR_MUL, var(INV_T)), IR_DIV, i64(4)))),
+            assign(INV_I, bin(var(INV_I), IR_ADD, i64(1)))), 3),
+        ret(var(INV_S)));
+    kernels[0].body_count = 4;
+
+    building = &kernels[1];
+    kernels[1].body = list(4,
+        assign(CALLS_S, i64(0)),
+        assign(CALLS_I, i64(0)),
+        loop(bin(var(CALLS_I), IR_LT, var(CALLS_N)), list(2,
+            assign(CALLS_S, bin(bin(var(CALLS_S), IR_ADD, call("sq", var(CALLS_I))), IR_SUB,
+                                call("sq", bin(var(CALLS_I), IR_SUB, i64(1))))),
+            assign(CALLS_I, bin(var(CALLS_I), IR_ADD, i64(1)))), 2),
+        ret(var(CALLS_S)));
+    kernels[1].body_count = 4;
+
+    building = &kernels[2];
+    kernels[2].body = list(5,
+        assign(FOLD_K, bin(i64(4), IR_MUL, i64(8))),
+        assign(FOLD_S, i64(0)),
+        assign(FOLD_I, i64(0)),
+        loop(bin(var(FOLD_I), IR_LT, var(FOLD_N)), list(3,
+            when(bin(var(FOLD_K), IR_GT, i64(10)), list(1,
+                assign(FOLD_S, bin(var(FOLD_S), IR_ADD, bin(bin(var(FOLD_I), IR_MUL, var(FOLD_K)), IR_ADD, i64(0))))), 1),
+            when(bin(var(FOLD_K), IR_LT, i64(10)), list(1,
+                assign(FOLD_S, bin(var(FOLD_S), IR_SUB, var(FOLD_I)))), 1),
+            assign(FOLD_I, bin(var(FOLD_I), IR_ADD, i64(1)))), 3),
+        ret(var(FOLD_S)));
+    kernels[2].body_count = 5;
+
+    building = &kernels[3];
+    kernels[3].body = list(4,
+        assign(GLOB_S, i64(0)),
+        assign(GLOB_I, i64(0)),
+        loop(bin(var(GLOB_I), IR_LT, var(GLOB_N)), list(2,
+            assign(GLOB_S, bin(var(GLOB_S), IR_ADD, bin(var(GLOB_I), IR_MUL, global("g_scale")))),
+            assign(GLOB_I, bin(var(GLOB_I), IR_ADD, i64(1)))), 2),
+        ret(var(GLOB_S)));
+    kernels[3].body_count = 4;
+
+    building = &kernels[4];
+    kernels[4].body = list(4,
+        assign(FLT_ACC, f64(0.0)),
+        assign(FLT_I, i64(0)),
+        loop(bin(var(FLT_I), IR_LT, var(FLT_N)), list(2,
+            assign(FLT_ACC, bin(bin(bin(var(FLT_ACC), IR_MUL, f64(0.5)), IR_ADD, bin(var(FLT_X), IR_MUL, var(FLT_X))),
+                                IR_ADD, bin(bin(var(FLT_X), IR_MUL, var(FLT_X)), IR_MUL, bin(f64(2.0), IR_MUL, f64(1.5))))),
+            assign(FLT_I, bin(var(FLT_I), IR_ADD, i64(1)))), 2),
+        ret(var(FLT_ACC)));
+    kernels[4].body_count = 4;
+
+    building = &kernels[5];
+    kernels[5].body = list(1, ret(bin(var(SQ_X), IR_MUL, var(SQ_X))));
+    kernels[5].body_count = 1;
+}
+
+// IRへの変換（変数ごとに1つの仮想レジスタ、代入は直前の命令の書き込み先を替える）
+typedef struct {
+    IrFunction* function;
+    const char* prefix;
+    IrValue vars[MAX_VARS];
+} Lowering;
+
+static const char* prefixed(const char* prefix, const char* name) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%s%s", prefix, name);
+    return strdup(buffer);
+}
+
+static IrValue lower_expression(Lowering* lowering, const Expr* e) {
+    switch (e->kind) {
+        case EXPR_INT:    return ir_emit_const_int(lowering->function, e->integer);
+        case EXPR_FLOAT:  return ir_emit_const_float(lowering->function, e->number);
+        case EXPR_VAR:    return lowering->vars[e->var];
+        case EXPR_GLOBAL: return ir_emit_load_global(lowering->function, e->name, IR_INT);
+        case EXPR_BINARY: {
+            IrValue left = lower_expression(lowering, e->left);
+            IrValue right = lower_expression(lowering, e->right);
+            return ir_emit_binary(lowering->function, e->op, left, right);
+        }
+        case EXPR_CALL: {
+            IrValue argument = lower_expression(lowering, e->left);
+            return ir_emit_call(lowering->function, prefixed(lowering->prefix, e->name), IR_INT, &argument, 1);
+        }
+    }
+    return IR_NO_VALUE;
+}
+
+static void lower_statements(Lowering* lowering, Stmt* const* body, size_t count) {
+    IrFunction* function = lowering->function;
+    for (size_t i = 0; i < count; i++) {
+        const Stmt* s = body[i];
+        switch (s->kind) {
+            case STMT_ASSIGN: {
+                IrValue value = lower_expression(lowering, s->expr);
+                IrValue target = lowering->vars[s->var];
+                if (s->expr->kind == EXPR_VAR || !ir_retarget_last(function, value, target)) {
+                    ir_emit_move(function, target, value);
+                }
+                break;
+            }
+            case STMT_WHILE: {
+                uint32_t start = ir_new_label(function), exit = ir_new_label(function);
+                ir_emit_label(function, start);
+                ir_emit_branch_false(function, lower_expression(lowering, s->expr), exit);
+                lower_statements(lowering, s->body, s->body_count);
+                ir_emit_jump(function, start);
+                ir_emit_label(function, exit);
+                break;
+            }
+            case STMT_IF: {
+                uint32_t skip = ir_new_label(function);
+                ir_emit_branch_false(function, lower_expression(lowering, s->expr), skip);
+                lower_statements(lowering, s->body, s->body_count);
+                ir_emit_label(function, skip);
+                break;
+            }
+            case STMT_RETURN:
+                ir_emit_return(function, lower_expression(lowering, s->expr));
+                break;
+        }
+    }
+}
+
+static IrFunction* lower_kernel(const Kernel* kernel, const char* prefix) {
+    Lowering lowering;
+    lowering.prefix = prefix;
+    lowering.function = ir_function_create(prefixed(prefix, kernel->name));
+    if (lowering.function == NULL) return NULL;
+
+    for (int i = 0; i < kernel->var_count; i++) {
+        lowering.vars[i] = i < kernel->param_count
+            ? ir_emit_param(lowering.function, (uint32_t)i, kernel->types[i])
+            : ir_new_value(lowering.function, kernel->types[i]);
+    }
+    lower_statements(&lowering, kernel->body, kernel->body_count);
+    return lowering.function;
+}
+
+// 実行時間を測るドライバ（3つのレベルの結果が一致することも確かめる）
+static const char* const driver_source =
+    "#include <stdio.h>\n"
+    "#include <stdint.h>\n"
+    "#include <time.h>\n"
+    "int64_t g_scale = 3;\n"
+    "#define DECLARE(level) \\\n"
+    "    int64_t o##level##_invariant(int64_t, int64_t, int64_t); int64_t o##level##_calls(int64_t); \\\n"
+    "    int64_t o##level##_folded(int64_t); int64_t o##level##_globals(int64_t); double o##level##_floats(double, int64_t);\n"
+    "DECLARE(0) DECLARE(1) DECLARE(2)\n"
+    "static double now(void) { struct timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec * 1e-9; }\n"
+    "#define TIME(label, type, name, args) do { double best[3] = { 1e9, 1e9, 1e9 }; type r[3] = { 0, 0, 0 }; \\\n"
+    "    for (int k = 0; k < 5; k++) { double t0 = now(); r[0] = o0_##name args; double t1 = now(); r[1] = o1_##name args; \\\n"
+    "        double t2 = now(); r[2] = o2_##name args; double t3 = now(); \\\n"
+    "        if (t1 - t0 < best[0]) best[0] = t1 - t0; if (t2 - t1 < best[1]) best[1] = t2 - t1; if (t3 - t2 < best[2]) best[2] = t3 - t2; } \\\n"
+    "    if (r[0] != r[1] || r[0] != r[2]) { fprintf(stderr, \"%s mismatch\\n\", label); return 1; } \\\n"
+    "    printf(\"%s %.3f %.3f %.3f\\n\", label, best[0] * 1e3, best[1] * 1e3, best[2] * 1e3); } while (0)\n"
+    "int main(void) {\n"
+    "    TIME(\"invariant\", int64_t, invariant, (20000000, 7, 11));\n"
+    "    TIME(\"calls\", int64_t, calls, (20000000));\n"
+    "    TIME(\"folded\", int64_t, folded, (20000000));\n"
+    "    TIME(\"globals\", int64_t, globals, (20000000));\n"
+    "    TIME(\"floats\", double, floats, (0.25, 20000000));\n"
+    "    return 0;\n"
+    "}\n";
+
+#define LEVEL_COUNT (OPT_MAX_LEVEL + 1)
+
+typedef struct {
+    size_t ir_instructions[LEVEL_COUNT];
+    size_t instructions[LEVEL_COUNT];
+    double ms[LEVEL_COUNT];
+    bool timed;
+} Result;
+
+static bool write_file(const char* path, const char* text) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return false;
+    fputs(text, file);
+    return fclose(file) == 0;
+}
+
+static bool run_driver(const char* directory, Result* results) {
+    char driver[256], program[320], assembly[256], command[1200];
+    snprintf(driver, sizeof(driver), "%s/driver.c", directory);
+    snprintf(assembly, sizeof(assembly), "%s/kernels.s", directory);
+    snprintf(program, sizeof(program), "%s/driver", directory);
+    if (!write_file(driver, driver_source)) return true;
+
+    const char* cc = getenv("CC") ? getenv("CC") : "cc";
+    snprintf(command, sizeof(command), "%s -O2 -o %s %s %s 2>&1", cc, program, driver, assembly);
+    if (system(command) != 0) {
+        fprintf(stderr, "optimizer_bench: could not assemble %s, reporting instruction counts only\n", assembly);
+        return true;
+    }
+
+    FILE* pipe = popen(program, "r");
+    if (pipe == NULL) return true;
+    char name[32];
+    double ms[LEVEL_COUNT];
+    while (fscanf(pipe, "%31s %lf %lf %lf", name, &ms[0], &ms[1], &ms[2]) == 4) {
+        for (size_t i = 0; i < TIMED_COUNT; i++) {
+            if (strcmp(name, kernels[i].name) != 0) continue;
+            memcpy(results[i].ms, ms, sizeof(ms));
+            results[i].timed = true;
+        }
+    }
+    // 結果が食い違えばドライバが失敗する
+    return pclose(pipe) == 0;
+}
+
+int main(void) {
+    build_kernels();
+
+    char directory[] = "/tmp/slang_optimizer_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        perror("optimizer_bench: mkdtemp");
+        return 1;
+    }
+    char assembly[256];
+    snprintf(assembly, sizeof(assembly), "%s/kernels.s", directory);
+    AsmWriter writer;
+    AsmWriter* out = &writer;
+    if (!asm_writer_open(out, assembly)) {
+        perror("optimizer_bench: open");
+        return 1;
+    }
+    asm_text(out, ".intel_syntax noprefix\n.section .text\n");
+
+    // 関数ごとの最適化はスレッドプールで並列に行う
+    ThreadPool* pool = thread_pool_create(0);
+    Result results[KERNEL_COUNT];
+    memset(results, 0, sizeof(results));
+    Optimizer optimizers[LEVEL_COUNT];
+    for (int level = 0; level < LEVEL_COUNT; level++) {
+        char prefix[8];
+        snprintf(prefix, sizeof(prefix), "o%d_", level);
+        OptOptions options = { level, true, NULL };
+        optimizer_init(&optimizers[level], &options);
+
+        // 1つのレベルの関数をまとめて変換し、呼び出される側も含めて最適化する
+        IrFunction* module[KERNEL_COUNT];
+        for (size_t i = 0; i < KERNEL_COUNT; i++) {
+            module[i] = lower_kernel(&kernels[i], prefix);
+            if (module[i] == NULL) {
+                fprintf(stderr, "optimizer_bench: %s: lowering failed\n", kernels[i].name);
+                return 1;
+            }
+        }
+        if (optimizer_run_module(&optimizers[level], pool, module, KERNEL_COUNT) != SLANG_SUCCESS) {
+            fprintf(stderr, "optimizer_bench: -O%d failed\n", level);
+            return 1;
+        }
+
+        for (size_t i = 0; i < KERNEL_COUNT; i++) {
+            asm_text(out, ".global ");
+            asm_text(out, module[i]->name);
+            asm_text(out, "\n");
+
+            RegisterAllocation allocation;
+            X86EmitStats stats = { 0, 0 };
+            if (regalloc_run(module[i], &allocation) != SLANG_SUCCESS ||
+                x86_emit_function(out, module[i], &allocation, &stats) != SLANG_SUCCESS) {
+                fprintf(stderr, "optimizer_bench: %s: -O%d emission failed\n", kernels[i].name, level);
+                return 1;
+            }
+            results[i].ir_instructions[level] = module[i]->count;
+            results[i].instructions[level] = stats.instructions;
+            regalloc_free(&allocation);
+        }
+        for (size_t i = 0; i < KERNEL_COUNT; i++) ir_function_destroy(module[i]);
+    }
+    thread_pool_destroy(pool);
+    asm_text(out, ".section .note.GNU-stack,\"\",@progbits\n");
+    if (!asm_writer_close(out)) {
+        fprintf(stderr, "optimizer_bench: could not write %s\n", assembly);
+        return 1;
+    }
+
+    if (!run_driver(directory, results)) {
+        fprintf(stderr, "optimizer_bench: optimized code disagrees with -O0\n");
+        return 1;
+    }
+
+    // パスごとの所要時間（-O2）
+    fprintf(stderr, "-O2 passes:\n");
+    optimizer_report(&optimizers[OPT_MAX_LEVEL], stderr);
+
+    printf("[");
+    for (size_t i = 0; i < TIMED_COUNT; i++) {
+        const Result* r = &results[i];
+        printf("%s{\"benchmark\": \"optimizer_%s\"", i ? ",\n " : "", kernels[i].name);
+        for (int level = 0; level < LEVEL_COUNT; level++) {
+            printf(", \"O%d_ir\": %zu, \"O%d_instructions\": %zu", level, r->ir_instructions[level], level,
+                   r->instructions[level]);
+        }
+        if (r->timed) {
+            for (int level = 0; level < LEVEL_COUNT; level++) printf(", \"O%d_ms\": %.2f", level, r->ms[level]);
+        }
+        printf("}");
+    }
+    printf("]\n");
+    return 0;
+}
@@ -0,0 +1,448 @@
+// 構文解析器のベンチマーク
+// 合成したソースを字句解析と構文解析にかけ、ソースのMB/sを一括モードとストリーミングモードで測る。
+// 測る前に、演算子の優先順位を解析したプログラムの実行結果で、エラーからの回復を
+// 集まったエラーの数と残った文の数で、字句のエラー（大きすぎる整数・途中の'\0'）をその診断で、
+// ノードの位置を先頭のトークンの行と列で、優先度のmost_low・most_highをスケジューラの段階で確かめる。
+// 続けて、解析した木を平らなAST（flat_ast.h）に並べ直し、大きさと木全体をなめる速さを木と比べる。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parser.h"
+#include "interpreter.h"
+#include "intern.h"
+#include "flat_ast.h"
+#include "scheduler.h"
+
+#define SOURCE_BYTES (8u << 20)
+#define REPEATS 5
+#define WALK_REPEATS 20
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// 関数をsize バイトを超えるまで並べる
+static char* generate_source(size_t size, size_t* length) {
+    static const char template[] =
+        "// function %zu\n"
+        "%s"
+        "fn f%zu(a: int, b: int) -> int {\n"
+        "    let x: int = a * %zu + b - (a %% 7) * 3;\n"
+        "    if x > 100 && !(b == 0) || a <= -5 {\n"
+        "        x = x / 2 + g(b, a - 1) * 4;\n"
+        "    } else if x != 3 {\n"
+        "        x = -x;\n"
+        "    } else {\n"
+        "        log!(\"value\", x, 1.5, true);\n"
+        "    }\n"
+        "    while x >= 10 { x = x - 10; }\n"
+        "    return x;\n"
+        "}\n";
+
+    char* source = malloc(size + sizeof(template) + 64);
+    if (source == NULL) return NULL;
+    size_t used = 0;
+    for (size_t i = 0; used < size; i++) {
+        // 4つに1つは優先度を付ける
+        const char* pragma = i % 4 == 0 ? "Function:type:priority:1;\n" : "";
+        used += (size_t)sprintf(source + used, template, i, pragma, i, i % 100);
+    }
+    *length = used;
+    return source;
+}
+
+typedef struct {
+    Arena* arena;
+    Lexer* lexer;
+    Parser* parser;
+    ASTNode* program;
+} Parsed;
+
+static SlangError parse(const char* source, size_t length, bool streaming, Parsed* parsed) {
+    parsed->arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    parsed->lexer = streaming ? lexer_create_streaming(source, length, LEXER_DEFAULT_RING_CAPACITY)
+                              : lexer_create(source, length);
+    parsed->parser = NULL;
+    parsed->program = NULL;
+    if (parsed->arena == NULL || parsed->lexer == NULL) return SLANG_ERROR_INTERNAL;
+
+    SlangError error = lexer_scan(parsed->lexer);
+    if (error != SLANG_SUCCESS) return error;
+    parsed->parser = parser_create(parsed->lexer, parsed->arena);
+    if (parsed->parser == NULL) return SLANG_ERROR_INTERNAL;
+    return parser_parse(parsed->parser, &parsed->program);
+}
+
+static void parsed_release(Parsed* parsed) {
+    parser_destroy(parsed->parser);
+    lexer_destroy(parsed->lexer);
+    arena_destroy(parsed->arena);
+}
+
+// 優先順位・結合・単項演算子・代入・if/else if/whileを実行結果で、優先度の指定を関数ノードで確かめる
+static bool check_semantics(void) {
+    static const char source[] =
+        "Function:type:priority:2;\n"
+        "fn calc(a, b) {\n"
+        "    let x = 1 + 2 * 3 - 8 / 4 % 3;\n"         // 1 + 6 - (2 % 3) = 5
+        "    let y = 100 - 10 - 1;\n"                  // 左結合なので89
+        "    let z = -a * -b + -(a - b);\n"            // a*b - (a - b)
+        "    let w = 0;\n"
+        "    if a < b && !(b == 0) || a > 100 { w = 1; } else if a == b { w = 2; } else { w = 3; }\n"
+        "    let n = 0;\n"
+        "    while n < 7 { n = n + 1; }\n"
+        "    let p = 0; let q = 0;\n"
+        "    p = q = 4;\n"
+        "    return x * 1000000 + y * 10000 + z * 100 + w * 10 + n - p - q;\n"
+        "}\n";
+
+    Parsed parsed;
+    if (parse(source, sizeof(source) - 1, false, &parsed) != SLANG_SUCCESS) {
+        fprintf(stderr, "parser_bench: semantics program failed to parse\n");
+        parsed_release(&parsed);
+        return false;
+    }
+
+    const ASTNode* calc = parsed.program->data.block_statement.statements[0];
+    if (calc->type != NODE_FUNCTION || calc->data.function.priority != 2) {
+        fprintf(stderr, "parser_bench: priority pragma was not attached to calc\n");
+        parsed_release(&parsed);
+        return false;
+    }
+
+    Interpreter* interpreter = create_interpreter();
+    bool ok = interpreter != NULL && interpret(interpreter, parsed.program) == SLANG_SUCCESS;
+    const int64_t cases[][3] = {
+        {3, 5, 3 * 5 - (3 - 5)},   // w = 1
+        {4, 4, 4 * 4},             // w = 2
+        {9, 2, 9 * 2 - 7},         // w = 3
+    };
+    const int64_t w[] = {1, 2, 3};
+    for (size_t i = 0; ok && i < sizeof(cases) / sizeof(cases[0]); i++) {
+        Value args[2] = {value_int(cases[i][0]), value_int(cases[i][1])};
+        Value result;
+        int64_t expected = 5 * 1000000 + 89 * 10000 + cases[i][2] * 100 + w[i] * 10 + 7 - 8;
+        ok = interpreter_call(interpreter, intern_cstr("calc"), args, 2, &result) == SLANG_SUCCESS &&
+             result.type == VALUE_INT && result.as.integer == expected;
+        if (!ok) {
+            fprintf(stderr, "parser_bench: calc(%lld, %lld) expected %lld\n",
+                    (long long)cases[i][0], (long long)cases[i][1], (long long)expected);
+        }
+    }
+    if (interpreter == NULL) fprintf(stderr, "parser_bench: interpreter failed\n");
+    if (interpreter != NULL) free_interpreter(interpreter);
+    parsed_release(&parsed);
+    return ok;
+}
+
+// 壊れた文を飛ばして、残りの文とすべてのエラーが得られることを確かめる
+static bool check_recovery(void) {
+    static const char source[] =
+        "let a = 1;\n"
+        "let b = (2 + ;\n"                     // 1: 式がない
+        "fn f(x) {\n"
+        "    let c = x +* 2;\n"                // 2: 式がない（関数の中で回復する）
+        "    return x;\n"
+        "}\n"
+        ") let d = 4;\n"                        // 3: 文の始まりに')'
+        "let e = 5 let g = 6;\n"                // 4: ';'がない
+        "for\n"                                 // 5: 未対応の文
+        "let h = a + d;\n";
+
+    Parsed parsed;
+    SlangError error = parse(source, sizeof(source) - 1, false, &parsed);
+    bool ok = error == SLANG_ERROR_PARSER && parsed.program != NULL &&
+              parsed.parser->error_count == 5;
+    // a, f, d, g, h が残り、fの本体にはreturnだけが残る
+    if (ok) {
+        const BlockStatement* program = &parsed.program->data.block_statement;
+        ok = program->statement_count == 5 && program->statements[1]->type == NODE_FUNCTION &&
+             program->statements[1]->data.function.body->data.block_statement.statement_count == 1;
+    }
+    if (!ok) {
+        fprintf(stderr, "parser_bench: recovery mismatch (error %d, %zu errors)\n", (int)error,
+                parsed.parser ? parsed.parser->error_count : 0);
+        for (size_t i = 0; parsed.parser != NULL && i < parsed.parser->error_count; i++) {
+            fprintf(stderr, "  %zu:%zu: %s\n", parsed.parser->errors[i].line, parsed.parser->errors[i].column,
+                    parsed.parser->errors[i].message);
+        }
+    }
+    parsed_release(&parsed);
+    return ok;
+}
+
+// ノードの位置（文はキーワードか先頭のトークン、二項演算は演算子、呼び出しは名前）を両方のモードで確かめる
+static bool expect_position(const ASTNode* node, uint32_t line, uint16_t column, const char* what) {
+    if (node != NULL && node->line == line && node->column == column) return true;
+    fprintf(stderr, "parser_bench: %s at %u:%u, expected %u:%u\n", what, node ? (unsigned)node->line : 0,
+            node ? (unsigned)node->column : 0, (unsigned)line, (unsigned)column);
+    return false;
+}
+
+static bool check_positions(void) {
+    static const char source[] =
+        "let a = 1;\n"
+        "fn f(x) {\n"
+        "    return -x + g(2);\n"
+        "}\n";
+
+    bool ok = true;
+    for (int streaming = 0; ok && streaming <= 1; streaming++) {
+        Parsed parsed;
+        ok = parse(source, sizeof(source) - 1, streaming, &parsed) == SLANG_SUCCESS;
+        if (ok) {
+            ASTNode* const* statements = parsed.program->data.block_statement.statements;
+            const ASTNode* body = statements[1]->data.function.body;
+            const ASTNode* ret = body->data.block_statement.statements[0];
+            const ASTNode* sum = ret->data.return_statement.value;
+            const ASTNode* call = sum->data.binary_expression.right;
+            ok = expect_position(statements[0], 1, 1, "let") && expect_position(statements[1], 2, 1, "fn") &&
+                 expect_position(body, 2, 9, "body") && expect_position(ret, 3, 5, "return") &&
+                 expect_position(sum->data.binary_expression.left, 3, 12, "negation") &&
+                 expect_position(sum, 3, 15, "'+'") && expect_position(call, 3, 17, "call") &&
+                 expect_position(call->data.function_call.arguments[0], 3, 19, "argument");
+        } else {
+            fprintf(stderr, "parser_bench: position program failed to parse\n");
+        }
+        parsed_release(&parsed);
+    }
+    return ok;
+}
+
+// 字句のエラーが最初のエラーとして報告されることを確かめる
+static bool expect_first_error(const char* source, size_t length, bool streaming, const char* message) {
+    Parsed parsed;
+    SlangError error = parse(source, length, streaming, &parsed);
+    bool ok = error == SLANG_ERROR_PARSER && parsed.parser->error_count > 0 &&
+              strcmp(parsed.parser->errors[0].message, message) == 0;
+    if (!ok) {
+        fprintf(stderr, "parser_bench: expected '%s' (error %d, first '%s')\n", message, (int)error,
+                parsed.parser != NULL && parsed.parser->error_count > 0 ? parsed.parser->errors[0].message : "");
+    }
+    parsed_release(&parsed);
+    return ok;
+}
+
+static bool check_lexer_errors(void) {
+    static const char largest[] = "let a = 9223372036854775807;\n";
+    static const char too_large[] = "let a = 9223372036854775808;\n";
+
+    Parsed parsed;
+    bool ok = parse(largest, sizeof(largest) - 1, false, &parsed) == SLANG_SUCCESS &&
+              parsed.program->data.block_statement.statements[0]->data.let_statement.initializer
+                  ->data.integer_literal.value == INT64_MAX;
+    if (!ok) fprintf(stderr, "parser_bench: INT64_MAX literal was not read back\n");
+    parsed_release(&parsed);
+
+    // 途中の'\0'は不正な文字で、その後ろも解析される（2つ目のエラーは'\0'の後ろの文）
+    static const char embedded_nul[] = "let a = 1;\0let b = (;\n";
+    for (int streaming = 0; ok && streaming <= 1; streaming++) {
+        ok = parse(embedded_nul, sizeof(embedded_nul) - 1, streaming, &parsed) == SLANG_ERROR_PARSER &&
+             parsed.parser->error_count == 2 && strcmp(parsed.parser->errors[0].message, "invalid character") == 0 &&
+             parsed.parser->errors[1].column > 11;
+        if (!ok) {
+            fprintf(stderr, "parser_bench: embedded NUL mismatch (%s, %zu errors)\n", streaming ? "streaming" : "batch",
+                    parsed.parser != NULL ? parsed.parser->error_count : 0);
+        }
+        parsed_release(&parsed);
+    }
+
+    return ok && expect_first_error(too_large, sizeof(too_large) - 1, false, "integer literal too large");
+}
+
+// most_low・most_highはスケジューラの最も低い段階と最も高い段階になり、ほかの名前は構文エラーになる
+static bool check_priority_words(void) {
+    static const char source[] =
+        "Function:type:priority:most_low;\n"
+        "fn background() { return 0; }\n"
+        "Function:type:priority:most_high;\n"
+        "fn request() { return 1; }\n";
+    static const char unknown[] = "Function:type:priority:most_middle;\nfn f() { return 0; }\n";
+
+    bool ok = true;
+    for (int streaming = 0; ok && streaming <= 1; streaming++) {
+        Parsed parsed;
+        ok = parse(source, sizeof(source) - 1, streaming, &parsed) == SLANG_SUCCESS;
+        if (ok) {
+            ASTNode* const* statements = parsed.program->data.block_statement.statements;
+            ok = statements[0]->data.function.priority == 0 &&
+                 statements[1]->data.function.priority == SCHEDULER_LEVELS - 1;
+        }
+        if (!ok) fprintf(stderr, "parser_bench: most_low/most_high were not mapped to the scheduler levels\n");
+        parsed_release(&parsed);
+    }
+    return ok && expect_first_error(unknown, sizeof(unknown) - 1, false,
+                                    "expected priority value, 'most_low' or 'most_high'");
+}
+
+// 木全体をなめて、整数リテラルの和と二項演算の数を求める（木は再帰で、平らなASTは番号の順に）
+typedef struct {
+    int64_t sum;
+    size_t binaries;
+} WalkResult;
+
+static void walk_tree(const ASTNode* node, WalkResult* result) {
+    if (node == NULL) return;
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL: result->sum += node->data.integer_literal.value; break;
+        case NODE_ASSIGNMENT: walk_tree(node->data.assignment.value, result); break;
+        case NODE_BINARY_EXPRESSION:
+            result->binaries++;
+            walk_tree(node->data.binary_expression.left, result);
+            walk_tree(node->data.binary_expression.right, result);
+            break;
+        case NODE_UNARY_EXPRESSION: walk_tree(node->data.unary_expression.right, result); break;
+        case NODE_EXPRESSION_STATEMENT: walk_tree(node->data.expression_statement.expression, result); break;
+        case NODE_RETURN_STATEMENT: walk_tree(node->data.return_statement.value, result); break;
+        case NODE_LET_STATEMENT: walk_tree(node->data.let_statement.initializer, result); break;
+        case NODE_WHILE_STATEMENT:
+            walk_tree(node->data.while_statement.condition, result);
+            walk_tree(node->data.while_statement.body, result);
+            break;
+        case NODE_IF_STATEMENT:
+            walk_tree(node->data.if_statement.condition, result);
+            walk_tree(node->data.if_statement.then_branch, result);
+            walk_tree(node->data.if_statement.else_branch, result);
+            break;
+        case NODE_BLOCK_STATEMENT:
+            for (size_t i = 0; i < node->data.block_statement.statement_count; i++) {
+                walk_tree(node->data.block_statement.statements[i], result);
+            }
+            break;
+        case NODE_FUNCTION_CALL:
+            for (size_t i = 0; i < node->data.function_call.argument_count; i++) {
+                walk_tree(node->data.function_call.arguments[i], result);
+            }
+            break;
+        case NODE_CALL_EXPRESSION:
+            walk_tree(node->data.call_expression.callee, result);
+            for (size_t i = 0; i < node->data.call_expression.argument_count; i++) {
+                walk_tree(node->data.call_expression.arguments[i], result);
+            }
+            break;
+        case NODE_FUNCTION: walk_tree(node->data.function.body, result); break;
+        default: break;
+    }
+}
+
+static void walk_flat(const FlatAst* ast, WalkResult* result) {
+    for (FlatNode i = 0; i < ast->node_count; i++) {
+        uint16_t kind = FLAT_AST_KIND(ast->tags[i]);
+        if (kind == NODE_INTEGER_LITERAL) result->sum += flat_ast_integer(ast, i);
+        result->binaries += kind == NODE_BINARY_EXPRESSION;
+    }
+}
+
+// 並べ直して戻した木をもう一度並べると同じ配列になることを確かめる
+static bool check_round_trip(const FlatAst* flat) {
+    Arena* arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    FlatAst* again = flat_ast_create();
+    ASTNode* tree = NULL;
+    bool ok = arena != NULL && again != NULL && flat_ast_expand(flat, arena, &tree) == SLANG_SUCCESS &&
+              flat_ast_build(again, tree) == SLANG_SUCCESS &&
+              again->node_count == flat->node_count && again->extra_count == flat->extra_count &&
+              again->string_size == flat->string_size && again->root == flat->root &&
+              memcmp(again->tags, flat->tags, flat->node_count * sizeof(uint16_t)) == 0 &&
+              memcmp(again->a, flat->a, flat->node_count * sizeof(uint32_t)) == 0 &&
+              memcmp(again->b, flat->b, flat->node_count * sizeof(uint32_t)) == 0 &&
+              memcmp(again->extra, flat->extra, flat->extra_count * sizeof(uint32_t)) == 0 &&
+              memcmp(again->strings, flat->strings, flat->string_size) == 0 &&
+              flat_ast_subtree_first(flat, flat->root) == 0;
+    if (!ok) fprintf(stderr, "parser_bench: flat AST round trip mismatch\n");
+    flat_ast_destroy(again);
+    arena_destroy(arena);
+    return ok;
+}
+
+static bool bench_flat_ast(const char* source, size_t length) {
+    Parsed parsed;
+    if (parse(source, length, false, &parsed) != SLANG_SUCCESS) {
+        parsed_release(&parsed);
+        return false;
+    }
+    size_t tree_bytes = parsed.arena->total_allocated;
+
+    FlatAst* flat = flat_ast_create();
+    double start = now_seconds();
+    bool ok = flat != NULL && flat_ast_build(flat, parsed.program) == SLANG_SUCCESS;
+    double build_seconds = now_seconds() - start;
+    ok = ok && check_round_trip(flat);
+
+    double tree_best = 0, flat_best = 0;
+    WalkResult tree_result = {0, 0}, flat_result = {0, 0};
+    for (size_t r = 0; ok && r < WALK_REPEATS; r++) {
+        WalkResult result = {0, 0};
+        start = now_seconds();
+        walk_tree(parsed.program, &result);
+        double elapsed = now_seconds() - start;
+        if (r == 0 || elapsed < tree_best) tree_best = elapsed;
+        tree_result = result;
+
+        result = (WalkResult){0, 0};
+        start = now_seconds();
+        walk_flat(flat, &result);
+        elapsed = now_seconds() - start;
+        if (r == 0 || elapsed < flat_best) flat_best = elapsed;
+        flat_result = result;
+    }
+    if (ok && (tree_result.sum != flat_result.sum || tree_result.binaries != flat_result.binaries)) {
+        fprintf(stderr, "parser_bench: flat AST walk mismatch\n");
+        ok = false;
+    }
+    if (ok) {
+        printf(",\n {\"benchmark\": \"flat_ast\", \"nodes\": %u, \"tree_bytes\": %zu, \"flat_bytes\": %zu, "
+               "\"build_ms\": %.2f, \"tree_walk_ms\": %.2f, \"flat_walk_ms\": %.2f, \"speedup\": %.2f}",
+               flat->node_count, tree_bytes, flat_ast_memory(flat), build_seconds * 1e3,
+               tree_best * 1e3, flat_best * 1e3, tree_best / flat_best);
+    }
+    flat_ast_destroy(flat);
+    parsed_release(&parsed);
+    return ok;
+}
+
+int main(void) {
+    if (!intern_init() || !type_table_init()) return 1;
+    if (!check_semantics() || !check_recovery() || !check_lexer_errors() || !check_positions() ||
+        !check_priority_words()) {
+        return 1;
+    }
+
+    size_t length;
+    char* source = generate_source(SOURCE_BYTES, &length);
+    if (source == NULL) return 1;
+
+    const char* modes[] = {"batch", "streaming"};
+    printf("[");
+    for (size_t m = 0; m < 2; m++) {
+        double best = 0;
+        size_t tokens = 0;
+        size_t statements = 0;
+        for (size_t r = 0; r < REPEATS; r++) {
+            Parsed parsed;
+            double start = now_seconds();
+            SlangError error = parse(source, length, m == 1, &parsed);
+            double elapsed = now_seconds() - start;
+            if (error != SLANG_SUCCESS) {
+                fprintf(stderr, "parser_bench: %s parse failed (%d)\n", modes[m], (int)error);
+                return 1;
+            }
+            if (r == 0 || elapsed < best) best = elapsed;
+            tokens = parsed.parser->consumed;
+            statements = parsed.program->data.block_statement.statement_count;
+            parsed_release(&parsed);
+        }
+        printf("%s{\"benchmark\": \"parser_%s\", \"bytes\": %zu, \"tokens\": %zu, \"functions\": %zu, "
+               "\"ms\": %.2f, \"mb_per_s\": %.1f}",
+               m ? ",\n " : "", modes[m], length, tokens, statements, best * 1e3,
+               (double)length / (1024.0 * 1024.0) / best);
+    }
+    if (!bench_flat_ast(source, length)) return 1;
+    printf("]\n");
+
+    free(source);
+    intern_shutdown();
+    return 0;
+}
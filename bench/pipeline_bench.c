@@ -0,0 +1,348 @@
+// コンパイラのフロントエンドのベンチマーク
+// source_gen.hの合成ソース（深い式・多数の関数・長い文字列・大きなファイル）ごとに、字句解析（lexer_scan）・
+// キーワードの判定（keyword_lookup）・構文解析（parser_parse）・型検査（type_checker_check）・
+// 式の型の推論（type_checker_infer）を測り、1行に1つの結果をJSONの配列で出力する。
+// ソースは毎回同じバイト列で、各段階はREPEATS回の中央値を報告するので、前回の出力と比べられる。
+// 大きなファイルは、ドライバと同じくストリーミングで読む（構文解析の時間に字句解析が入る）。
+// その後ろの段階はoptimizer_bench・regalloc_bench・asm_writer_benchで測る。
+//
+// --baseline=FILEを渡すと前回の出力と比べ、--tolerance（既定は0.25）より遅くなった段階があれば
+// 標準エラーに書いて1で終わる（前回がBASELINE_MIN_MSより速い段階は揺れが大きいので比べない）。
+// 遅い段階があったときは全体をCONFIRM_RUNS回まで測り直し、段階ごとに最も速い回の中央値で比べるので、
+// ほかのプロセスの負荷で1回だけ遅れた段階では落ちない。
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "source_gen.h"
+#include "keyword.h"
+#include "parser.h"
+#include "type_checker.h"
+#include "intern.h"
+
+#define REPEATS 9
+#define HUGE_REPEATS 5
+#define HUGE_BYTES (64u << 20)
+#define KEYWORD_ROUNDS 20
+#define MAX_RESULTS 32
+#define BASELINE_MIN_MS 1.0
+#define CONFIRM_RUNS 2
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    const char* name;
+    bool streaming;
+    char* source;
+    size_t length;
+} Shape;
+
+typedef struct {
+    char name[64];
+    double ms;
+} Result;
+
+static Result results[MAX_RESULTS];
+static size_t result_count;
+static bool remeasuring;       // 測り直しでは出力せず、速くなった段階だけ置き換える
+
+// 中央値（ほかのプロセスに割り込まれた回や最初の回の揺れに引きずられない）
+static double median(double* samples, int count) {
+    for (int i = 1; i < count; i++) {
+        double value = samples[i];
+        int j = i;
+        for (; j > 0 && samples[j - 1] > value; j--) samples[j] = samples[j - 1];
+        samples[j] = value;
+    }
+    return count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2.0;
+}
+
+static void report(const Shape* shape, const char* stage, size_t items, double seconds) {
+    Result* result = &results[result_count];
+    if (remeasuring) {
+        if (seconds * 1e3 < result->ms) result->ms = seconds * 1e3;
+        if (result_count < MAX_RESULTS - 1) result_count++;
+        return;
+    }
+    snprintf(result->name, sizeof(result->name), "pipeline_%s_%s", stage, shape->name);
+    result->ms = seconds * 1e3;
+    printf("%s{\"benchmark\": \"%s\", \"stage\": \"%s\", \"shape\": \"%s\", \"streaming\": %s, \"bytes\": %zu, "
+           "\"items\": %zu, \"ms\": %.3f, \"mb_per_s\": %.1f, \"items_per_s\": %.0f}",
+           result_count ? ",\n " : "", result->name, stage, shape->name, shape->streaming ? "true" : "false",
+           shape->length, items, result->ms, (double)shape->length / (1024.0 * 1024.0) / seconds,
+           (double)items / seconds);
+    fflush(stdout);
+    if (result_count < MAX_RESULTS - 1) result_count++;
+}
+
+static Lexer* shape_lexer(const Shape* shape) {
+    return shape->streaming ? lexer_create_streaming(shape->source, shape->length, LEXER_DEFAULT_RING_CAPACITY)
+                            : lexer_create(shape->source, shape->length);
+}
+
+// 字句解析（ストリーミングなら最後のトークンまで読み進める）
+static bool bench_lex(const Shape* shape, int repeats) {
+    double samples[REPEATS];
+    size_t tokens = 0;
+    for (int r = 0; r < repeats; r++) {
+        double start = now_seconds();
+        Lexer* lexer = shape_lexer(shape);
+        bool ok = lexer != NULL && lexer_scan(lexer) == SLANG_SUCCESS;
+        size_t count = 0;
+        if (ok && shape->streaming) {
+            const Token* token;
+            while ((token = lexer_next_token(lexer)) != NULL && token->type != TOKEN_EOF) count++;
+            ok = token != NULL;
+        } else if (ok) {
+            count = lexer->token_count;
+        }
+        double elapsed = now_seconds() - start;
+        if (lexer != NULL) lexer_destroy(lexer);
+        if (!ok) {
+            fprintf(stderr, "pipeline_bench: %s: lexing failed\n", shape->name);
+            return false;
+        }
+        samples[r] = elapsed;
+        tokens = count;
+    }
+    report(shape, "lex", tokens, median(samples, repeats));
+    return true;
+}
+
+// 識別子とキーワードのトークンをすべてkeyword_lookupに通す
+static bool bench_keyword(const Shape* shape, int repeats) {
+    Lexer* lexer = lexer_create(shape->source, shape->length);
+    if (lexer == NULL || lexer_scan(lexer) != SLANG_SUCCESS) {
+        if (lexer != NULL) lexer_destroy(lexer);
+        return false;
+    }
+    size_t words = 0;
+    for (size_t i = 0; i < lexer->token_count; i++) {
+        const Token* token = &lexer->tokens[i];
+        const char* text = lexer_token_start(lexer, token);
+        if (token->type != TOKEN_STRING && token->length != 0 && (isalpha((unsigned char)text[0]) || text[0] == '_')) {
+            lexer->tokens[words++] = *token;
+        }
+    }
+
+    double samples[REPEATS];
+    unsigned checksum = 0;
+    for (int r = 0; r < repeats; r++) {
+        double start = now_seconds();
+        for (int round = 0; round < KEYWORD_ROUNDS; round++) {
+            for (size_t i = 0; i < words; i++) {
+                const Token* token = &lexer->tokens[i];
+                checksum += (unsigned)keyword_lookup(lexer_token_start(lexer, token), token->length);
+            }
+        }
+        samples[r] = (now_seconds() - start) / KEYWORD_ROUNDS;
+    }
+    lexer_destroy(lexer);
+    // 最適化で呼び出しが消えないように使う
+    if (checksum == 1) printf(" ");
+    report(shape, "keyword", words, median(samples, repeats));
+    return true;
+}
+
+typedef struct {
+    Arena* arena;
+    Lexer* lexer;
+    Parser* parser;
+    ASTNode* program;
+} Parsed;
+
+static void parsed_release(Parsed* parsed) {
+    parser_destroy(parsed->parser);
+    if (parsed->lexer != NULL) lexer_destroy(parsed->lexer);
+    arena_destroy(parsed->arena);
+}
+
+// 一括モードなら字句解析を済ませてから、構文解析だけを測る
+static bool parse_shape(const Shape* shape, Parsed* parsed, double* seconds) {
+    parsed->arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    parsed->parser = NULL;
+    parsed->program = NULL;
+    double start = now_seconds();
+    parsed->lexer = shape_lexer(shape);
+    bool ok = parsed->arena != NULL && parsed->lexer != NULL && lexer_scan(parsed->lexer) == SLANG_SUCCESS;
+    if (!shape->streaming) start = now_seconds();
+    ok = ok && (parsed->parser = parser_create(parsed->lexer, parsed->arena)) != NULL &&
+         parser_parse(parsed->parser, &parsed->program) == SLANG_SUCCESS;
+    *seconds = now_seconds() - start;
+    if (!ok) fprintf(stderr, "pipeline_bench: %s: parsing failed\n", shape->name);
+    return ok;
+}
+
+static bool bench_parse(const Shape* shape, int repeats) {
+    double samples[REPEATS];
+    size_t nodes = 0;
+    for (int r = 0; r < repeats; r++) {
+        Parsed parsed;
+        double elapsed;
+        bool ok = parse_shape(shape, &parsed, &elapsed);
+        if (ok) nodes = ast_count_nodes(parsed.program);
+        parsed_release(&parsed);
+        if (!ok) return false;
+        samples[r] = elapsed;
+    }
+    report(shape, "parse", nodes, median(samples, repeats));
+    return true;
+}
+
+// 1つの木を検査し直すときは、毎回新しい検査器で（関数の結果のキャッシュを使わずに）検査する
+static bool bench_check(const Shape* shape, int repeats) {
+    Parsed parsed;
+    double parse_seconds;
+    if (!parse_shape(shape, &parsed, &parse_seconds)) {
+        parsed_release(&parsed);
+        return false;
+    }
+    const BlockStatement* program = &parsed.program->data.block_statement;
+    size_t nodes = ast_count_nodes(parsed.program);
+
+    double check_samples[REPEATS], infer_samples[REPEATS];
+    size_t expressions = 0;
+    bool ok = true;
+    int r = 0;
+    for (; r < repeats && ok; r++) {
+        TypeChecker* checker = type_checker_create();
+        double start = now_seconds();
+        SlangError error = checker ? type_checker_check(checker, program->statements, program->statement_count)
+                                   : SLANG_ERROR_INTERNAL;
+        double elapsed = now_seconds() - start;
+        if (error != SLANG_SUCCESS) {
+            fprintf(stderr, "pipeline_bench: %s: type check failed: %s\n", shape->name,
+                    checker && checker->error ? checker->error : "internal error");
+            ok = false;
+        }
+        check_samples[r] = elapsed;
+
+        // 最上位のletの初期化子（検査の後なので最上位の名前はすべて見える）
+        expressions = 0;
+        start = now_seconds();
+        for (size_t i = 0; i < program->statement_count && ok; i++) {
+            const ASTNode* statement = program->statements[i];
+            if (statement->type != NODE_LET_STATEMENT || statement->data.let_statement.initializer == NULL) continue;
+            const Type* type;
+            ok = type_checker_infer(checker, statement->data.let_statement.initializer, &type) == SLANG_SUCCESS;
+            expressions++;
+        }
+        infer_samples[r] = now_seconds() - start;
+        type_checker_destroy(checker);
+    }
+    parsed_release(&parsed);
+    if (!ok) return false;
+    report(shape, "check", nodes, median(check_samples, r));
+    if (expressions != 0) report(shape, "infer", expressions, median(infer_samples, r));
+    return true;
+}
+
+// 前回の出力（1行に1つの結果）の中からnameのmsを探す
+static bool baseline_ms(const char* text, const char* name, double* ms) {
+    char key[96];
+    snprintf(key, sizeof(key), "\"benchmark\": \"%.63s\"", name);
+    const char* line = strstr(text, key);
+    if (line == NULL) return false;
+    const char* field = strstr(line, "\"ms\": ");
+    const char* end = strchr(line, '}');
+    return field != NULL && (end == NULL || field < end) && sscanf(field + 6, "%lf", ms) == 1;
+}
+
+static char* read_baseline(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "pipeline_bench: could not read baseline '%s'\n", path);
+        return NULL;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    rewind(in);
+    char* text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    size_t read = text ? fread(text, 1, (size_t)size, in) : 0;
+    fclose(in);
+    if (text != NULL) text[read] = '\0';
+    return text;
+}
+
+// printがfalseなら遅い段階があるかだけを返す
+static bool compare_baseline(const char* text, double tolerance, bool print) {
+    bool ok = true;
+    for (size_t i = 0; i < result_count; i++) {
+        double before;
+        if (!baseline_ms(text, results[i].name, &before) || before < BASELINE_MIN_MS) continue;
+        double change = results[i].ms / before - 1.0;
+        if (change > tolerance) {
+            if (print) {
+                fprintf(stderr, "pipeline_bench: regression: %s %.3f ms (baseline %.3f ms, %+.0f%%)\n",
+                        results[i].name, results[i].ms, before, change * 100.0);
+            }
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static bool run_shapes(const Shape* shapes, size_t count) {
+    bool ok = true;
+    for (size_t s = 0; s < count && ok; s++) {
+        const Shape* shape = &shapes[s];
+        int repeats = shape->streaming ? HUGE_REPEATS : REPEATS;
+        ok = shape->source != NULL && bench_lex(shape, repeats) &&
+             (shape->streaming || bench_keyword(shape, repeats)) && bench_parse(shape, repeats) &&
+             bench_check(shape, repeats);
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    const char* baseline = NULL;
+    double tolerance = 0.25;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--baseline=", 11) == 0) {
+            baseline = argv[i] + 11;
+        } else if (strncmp(argv[i], "--tolerance=", 12) == 0) {
+            tolerance = strtod(argv[i] + 12, NULL);
+        } else {
+            fprintf(stderr, "Usage: pipeline_bench [--baseline=FILE] [--tolerance=FRACTION]\n");
+            return 64;
+        }
+    }
+    if (!intern_init() || !type_table_init()) return 1;
+
+    Shape shapes[] = {
+        { "deep_expressions", false, NULL, 0 },
+        { "many_functions", false, NULL, 0 },
+        { "long_strings", false, NULL, 0 },
+        { "huge_file", true, NULL, 0 },
+    };
+    shapes[0].source = source_gen_deep_expressions(2000, 48, &shapes[0].length);
+    shapes[1].source = source_gen_many_functions(40000, &shapes[1].length);
+    shapes[2].source = source_gen_long_strings(1024, 4096, &shapes[2].length);
+    shapes[3].source = source_gen_huge(HUGE_BYTES, &shapes[3].length);
+
+    printf("[");
+    bool ok = run_shapes(shapes, sizeof(shapes) / sizeof(shapes[0]));
+    printf("]\n");
+
+    if (ok && baseline != NULL) {
+        char* text = read_baseline(baseline);
+        ok = text != NULL;
+        for (int run = 0; ok && run < CONFIRM_RUNS && !compare_baseline(text, tolerance, false); run++) {
+            remeasuring = true;
+            result_count = 0;
+            ok = run_shapes(shapes, sizeof(shapes) / sizeof(shapes[0]));
+        }
+        ok = ok && compare_baseline(text, tolerance, true);
+        free(text);
+    }
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) free(shapes[s].source);
+    intern_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+// 優先度の段階ごとのメモリプールのベンチマーク
+// 4スレッドで大きさと段階を混ぜて確保と解放を繰り返し、malloc/freeと比べる。
+// 最も高い段階（前もって触ってある）と最も低い段階で、新しいブロックに初めて書くときのページフォールトの数を比べ、
+// 持ち主を移す（写さない）のと、新しい持ち主の段階に写すのとを比べる。
+// 最後にlimitを小さくして、高い段階の確保が低い段階の空のチャンクを返させて通り、
+// 低い段階の確保だけが断られることを確かめる。
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "priority_pool.h"
+
+#define THREADS 4
+#define SLOTS 4096
+#define OPERATIONS 1000000
+#define TOUCH_BLOCKS 4096
+#define TRANSFER_BLOCKS 4096
+#define TRANSFER_SIZE 1024
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static long minor_faults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// 大きさは小さいほど多く、ときどき区分より大きいものを混ぜる
+static size_t random_size(uint64_t* state) {
+    uint64_t r = next_random(state);
+    if (r % 1024 == 0) return 4096 + r % 8192;
+    return 8 + (r >> 8) % (r % 4 == 0 ? 2048 : 128);
+}
+
+typedef struct {
+    PriorityPool* pool;    // NULLならmalloc
+    uint64_t seed;
+    bool ok;
+} Worker;
+
+static void* churn_main(void* argument) {
+    Worker* worker = argument;
+    PoolCache* cache = worker->pool ? pool_cache_create(worker->pool) : NULL;
+    static _Thread_local void* slots[SLOTS];
+    static _Thread_local size_t sizes[SLOTS];
+    memset(slots, 0, sizeof(slots));
+    uint64_t state = worker->seed;
+    worker->ok = worker->pool == NULL || cache != NULL;
+
+    for (size_t i = 0; worker->ok && i < OPERATIONS; i++) {
+        size_t slot = next_random(&state) % SLOTS;
+        if (slots[slot] != NULL) {
+            // 書いた印が残っているか確かめてから返す
+            if (((unsigned char*)slots[slot])[sizes[slot] - 1] != (unsigned char)slot) worker->ok = false;
+            if (cache) {
+                priority_pool_free(cache, slots[slot]);
+            } else {
+                free(slots[slot]);
+            }
+            slots[slot] = NULL;
+            continue;
+        }
+        size_t size = random_size(&state);
+        unsigned tier = (unsigned)(slot % POOL_TIERS);
+        slots[slot] = cache ? priority_pool_alloc(cache, tier, size) : malloc(size);
+        if (slots[slot] == NULL) {
+            worker->ok = false;
+            break;
+        }
+        if (cache && (priority_pool_owner(slots[slot]) != tier || priority_pool_block_size(slots[slot]) < size)) {
+            worker->ok = false;
+        }
+        sizes[slot] = size;
+        ((unsigned char*)slots[slot])[size - 1] = (unsigned char)slot;
+    }
+    for (size_t slot = 0; slot < SLOTS; slot++) {
+        if (slots[slot] == NULL) continue;
+        if (cache) {
+            priority_pool_free(cache, slots[slot]);
+        } else {
+            free(slots[slot]);
+        }
+    }
+    pool_cache_destroy(cache);
+    return NULL;
+}
+
+static double run_churn(PriorityPool* pool, bool* ok) {
+    pthread_t threads[THREADS];
+    Worker workers[THREADS];
+    double start = now_seconds();
+    for (size_t i = 0; i < THREADS; i++) {
+        workers[i] = (Worker){ pool, 0x9e3779b97f4a7c15ull * (i + 1), false };
+        pthread_create(&threads[i], NULL, churn_main, &workers[i]);
+    }
+    *ok = true;
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        *ok = *ok && workers[i].ok;
+    }
+    return now_seconds() - start;
+}
+
+static bool bench_churn(void) {
+    PriorityPool* pool = priority_pool_create(NULL);
+    if (pool == NULL) return false;
+    bool pool_ok, malloc_ok;
+    double pool_seconds = run_churn(pool, &pool_ok);
+    double malloc_seconds = run_churn(NULL, &malloc_ok);
+
+    // すべて返したので、持ち主の集計は0に戻る
+    for (unsigned tier = 0; pool_ok && tier < POOL_TIERS; tier++) {
+        PoolTierStats stats;
+        priority_pool_stats(pool, tier, &stats);
+        pool_ok = stats.owned == 0;
+    }
+    priority_pool_destroy(pool);
+    if (!pool_ok || !malloc_ok) {
+        fprintf(stderr, "priority_pool_bench: churn check failed\n");
+        return false;
+    }
+
+    double operations = (double)THREADS * OPERATIONS;
+    printf("{\"benchmark\": \"churn\", \"threads\": %d, \"operations\": %.0f, \"pool_mops\": %.1f, "
+           "\"malloc_mops\": %.1f}",
+           THREADS, operations, operations / pool_seconds * 1e-6, operations / malloc_seconds * 1e-6);
+    return true;
+}
+
+// 新しいブロックに初めて書くときのページフォールトの数
+static long touch_faults(PoolCache* cache, unsigned tier, void** blocks) {
+    long before = minor_faults();
+    for (size_t i = 0; i < TOUCH_BLOCKS; i++) {
+        blocks[i] = priority_pool_alloc(cache, tier, POOL_MAX_BLOCK);
+        if (blocks[i] == NULL) return -1;
+        memset(blocks[i], (int)i, POOL_MAX_BLOCK);
+    }
+    long faults = minor_faults() - before;
+    for (size_t i = 0; i < TOUCH_BLOCKS; i++) priority_pool_free(cache, blocks[i]);
+    return faults;
+}
+
+static bool bench_prefault(void) {
+    static void* blocks[TOUCH_BLOCKS];
+    PriorityPoolOptions options = { 0, (size_t)TOUCH_BLOCKS * POOL_MAX_BLOCK * 2, true };
+    PriorityPool* pool = priority_pool_create(&options);
+    PoolCache* cache = pool ? pool_cache_create(pool) : NULL;
+    if (cache == NULL) return false;
+
+    long high = touch_faults(cache, POOL_TIERS - 1, blocks);
+    long low = touch_faults(cache, 0, blocks);
+    PoolTierStats stats;
+    priority_pool_stats(pool, POOL_TIERS - 1, &stats);
+    pool_cache_destroy(cache);
+    priority_pool_destroy(pool);
+    if (high < 0 || low < 0) {
+        fprintf(stderr, "priority_pool_bench: prefault allocation failed\n");
+        return false;
+    }
+    printf("{\"benchmark\": \"first_touch\", \"blocks\": %d, \"block_size\": %d, \"reserved_chunks\": %zu, "
+           "\"high_tier_faults\": %ld, \"low_tier_faults\": %ld}",
+           TOUCH_BLOCKS, POOL_MAX_BLOCK, stats.chunks, high, low);
+    return true;
+}
+
+// 持ち主を移すのと、新しい持ち主の段階に写すのとの比較
+static bool bench_transfer(void) {
+    static void* blocks[TRANSFER_BLOCKS];
+    PriorityPool* pool = priority_pool_create(NULL);
+    PoolCache* cache = pool ? pool_cache_create(pool) : NULL;
+    if (cache == NULL) return false;
+
+    // 引数のない整数の関数の型（持ち主の規則は関数型どうしの互換性）
+    const Type* integer_type = type_primitive(TYPE_INTEGER);
+    const Type* function_type = type_function_of(NULL, 0, integer_type);
+
+    bool ok = integer_type != NULL && function_type != NULL;
+    for (size_t i = 0; ok && i < TRANSFER_BLOCKS; i++) {
+        blocks[i] = priority_pool_alloc(cache, 0, TRANSFER_SIZE);
+        ok = blocks[i] != NULL;
+        if (ok) memset(blocks[i], (int)i, TRANSFER_SIZE);
+    }
+    // 持ち主の規則に合わなければ移さない
+    ok = ok && !priority_pool_transfer(cache, blocks[0], integer_type, function_type, POOL_TIERS - 1) &&
+         priority_pool_owner(blocks[0]) == 0;
+
+    double start = now_seconds();
+    for (size_t i = 0; ok && i < TRANSFER_BLOCKS; i++) {
+        ok = priority_pool_transfer(cache, blocks[i], function_type, function_type, POOL_TIERS - 1);
+    }
+    double transfer_seconds = now_seconds() - start;
+    PoolTierStats high;
+    priority_pool_stats(pool, POOL_TIERS - 1, &high);
+    ok = ok && high.owned == (int64_t)TRANSFER_BLOCKS * TRANSFER_SIZE;
+
+    start = now_seconds();
+    for (size_t i = 0; ok && i < TRANSFER_BLOCKS; i++) {
+        void* copy = priority_pool_alloc(cache, POOL_TIERS - 1, TRANSFER_SIZE);
+        ok = copy != NULL;
+        if (!ok) break;
+        memcpy(copy, blocks[i], TRANSFER_SIZE);
+        priority_pool_free(cache, blocks[i]);
+        blocks[i] = copy;
+    }
+    double copy_seconds = now_seconds() - start;
+
+    for (size_t i = 0; i < TRANSFER_BLOCKS; i++) {
+        if (ok && ((unsigned char*)blocks[i])[TRANSFER_SIZE - 1] != (unsigned char)i) ok = false;
+        priority_pool_free(cache, blocks[i]);
+    }
+    pool_cache_destroy(cache);
+    priority_pool_destroy(pool);
+    if (!ok) {
+        fprintf(stderr, "priority_pool_bench: transfer check failed\n");
+        return false;
+    }
+    printf("{\"benchmark\": \"transfer\", \"blocks\": %d, \"size\": %d, \"transfer_us\": %.1f, \"copy_us\": %.1f}",
+           TRANSFER_BLOCKS, TRANSFER_SIZE, transfer_seconds * 1e6, copy_seconds * 1e6);
+    return true;
+}
+
+// limitを超えるときの段階の取り合い
+static bool check_pressure(void) {
+    static void* blocks[8 * (POOL_CHUNK_SIZE / POOL_MAX_BLOCK)];
+    PriorityPoolOptions options = { 4 * POOL_CHUNK_SIZE, 0, false };
+    PriorityPool* pool = priority_pool_create(&options);
+    PoolCache* cache = pool ? pool_cache_create(pool) : NULL;
+    if (cache == NULL) return false;
+
+    // 低い段階でlimitまで埋めると、それ以上は断られる
+    size_t count = 0;
+    while (count < sizeof(blocks) / sizeof(blocks[0]) &&
+           (blocks[count] = priority_pool_alloc(cache, 0, POOL_MAX_BLOCK)) != NULL) {
+        count++;
+    }
+    PoolTierStats low;
+    priority_pool_stats(pool, 0, &low);
+    bool ok = low.denied > 0 && low.mapped <= options.limit;
+
+    // 低い段階のブロックを返しても、高い段階の確保が空のチャンクを返させて通る（低い段階は断られたまま）
+    for (size_t i = 0; i < count; i++) priority_pool_free(cache, blocks[i]);
+    pool_cache_flush(cache);
+    void* high = priority_pool_alloc(cache, POOL_TIERS - 1, 64);
+    void* large = priority_pool_alloc(cache, POOL_TIERS - 1, 3 * POOL_CHUNK_SIZE / 2);
+    ok = ok && high != NULL && large != NULL;
+    priority_pool_stats(pool, 0, &low);
+    size_t reclaimed = low.reclaimed;
+    ok = ok && reclaimed > 0;
+
+    // 新しいチャンクが要る低い段階の確保は、高い段階の分を空けさせられずに断られる
+    size_t denied = low.denied;
+    void* blocked = priority_pool_alloc(cache, 0, 64);
+    priority_pool_stats(pool, 0, &low);
+    PoolTierStats top;
+    priority_pool_stats(pool, POOL_TIERS - 1, &top);
+    ok = ok && blocked == NULL && low.denied > denied && top.mapped >= 2 * POOL_CHUNK_SIZE;
+
+    printf("{\"benchmark\": \"pressure\", \"limit\": %zu, \"low_blocks\": %zu, \"reclaimed\": %zu, "
+           "\"low_denied\": %zu, \"high_mapped\": %zu}",
+           options.limit, count, reclaimed, low.denied, top.mapped);
+    pool_cache_destroy(cache);
+    priority_pool_destroy(pool);
+    if (!ok) fprintf(stderr, "priority_pool_bench: pressure check failed\n");
+    return ok;
+}
+
+int main(void) {
+    printf("[");
+    if (!bench_churn()) return 1;
+    printf(",\n ");
+    if (!bench_prefault()) return 1;
+    printf(",\n ");
+    if (!bench_transfer()) return 1;
+    printf(",\n ");
+    if (!check_pressure()) return 1;
+    printf("]\n");
+    return 0;
+}
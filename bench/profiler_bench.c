@@ -0,0 +1,223 @@
+// 標本化プロファイラのベンチマーク
+// 優先度を宣言した関数（コード生成と同じ__slang_priority.の記号を付ける）を段階の違うタスクで回し、
+// 最も高い段階のタスクが低い段階のタスクを待つ（継承で上がる）場面も作ってから、畳んだ呼び出し列で
+// 関数が正しい段階と[priority N]に振り分けられ、逆転の間の標本が待たれた側の関数に付くことを確かめる。
+// pprofの形式は語の並びを読み戻して標本の数を比べ、最後に同じ計算を止めたときと動かしたときで比べた費用を出す。
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "profiler.h"
+#include "scheduler.h"
+
+#define WORKERS 4
+#define RENDER_TASKS 8
+#define COMPACT_TASKS 8
+#define TASK_MS 25              // タスク1つのCPU時間
+#define FLUSH_MS 200            // 待たれる低い段階のタスクのCPU時間
+#define MAIN_MS 100             // タスクの外で回す時間
+#define OVERHEAD_ITERATIONS 400000000ull
+
+// codegenのx86_emit_functionが出すのと同じ優先度の記号
+__asm__(".set " PROFILER_PRIORITY_PREFIX "render_frame, 3\n"
+        ".set " PROFILER_PRIORITY_PREFIX "compact_log, 1\n");
+
+static _Atomic uint64_t sink;    // 計算を消されないように結果を混ぜる（タスクから並行に書く）
+
+static double cpu_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t mix(uint64_t x, uint64_t rounds) {
+    for (uint64_t i = 0; i < rounds; i++) x = x * 6364136223846793005ull + 1442695040888963407ull;
+    return x;
+}
+
+// 時計を引く間隔を空けて、標本の大部分が計算の中に落ちるようにする
+// （計算は中に展開して、フレームを持つburnを葉にする。呼び出し側は戻り値を使うので末尾呼び出しにならない）
+__attribute__((noinline)) uint64_t burn(unsigned milliseconds) {
+    double end = cpu_seconds() + milliseconds * 1e-3;
+    uint64_t x = sink;
+    while (cpu_seconds() < end) x = mix(x, 20000);
+    return x;
+}
+
+__attribute__((noinline)) void render_frame(void* context) {
+    (void)context;
+    sink ^= burn(TASK_MS);
+}
+
+__attribute__((noinline)) void compact_log(void* context) {
+    (void)context;
+    sink ^= burn(TASK_MS);
+}
+
+__attribute__((noinline)) void flush_cache(void* context) {
+    (void)context;
+    sink ^= burn(FLUSH_MS);
+}
+
+// 最も高い段階から、先に投入しておいた低い段階のタスクを待つ
+__attribute__((noinline)) void await_flush(void* context) {
+    Scheduler* scheduler = ((void**)context)[0];
+    SchedulerTask* flush = ((void**)context)[1];
+    scheduler_wait(scheduler, flush);
+}
+
+static bool run_workload(void) {
+    Scheduler* scheduler = scheduler_create(WORKERS, 0);
+    if (scheduler == NULL) return false;
+    SchedulerTask* tasks[RENDER_TASKS + COMPACT_TASKS];
+    size_t task_count = 0;
+    for (int i = 0; i < COMPACT_TASKS; i++) tasks[task_count++] = scheduler_spawn(scheduler, 1, compact_log, NULL);
+    for (int i = 0; i < RENDER_TASKS; i++) tasks[task_count++] = scheduler_spawn(scheduler, 3, render_frame, NULL);
+    for (size_t i = 0; i < task_count; i++) {
+        if (tasks[i] != NULL) scheduler_wait(scheduler, tasks[i]);
+    }
+
+    SchedulerTask* flush = scheduler_spawn(scheduler, 0, flush_cache, NULL);
+    void* context[2] = { scheduler, flush };
+    SchedulerTask* waiter = flush != NULL ? scheduler_spawn(scheduler, 3, await_flush, context) : NULL;
+    if (waiter != NULL) scheduler_wait(scheduler, waiter);
+
+    sink ^= burn(MAIN_MS);
+    scheduler_destroy(scheduler);
+    return flush != NULL && waiter != NULL;
+}
+
+typedef struct {
+    size_t render;             // priority 3の根の下のrender_frame [priority 3]
+    size_t render_elsewhere;   // それ以外の根の下のrender_frame
+    size_t compact;
+    size_t inverted_flush;     // priority 3 (inherited from 0)の根の下のflush_cache
+    size_t outside;            // no taskの根の下のmain
+    size_t total;
+} FoldedCounts;
+
+static bool read_folded(const char* path, FoldedCounts* counts) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) return false;
+    memset(counts, 0, sizeof(FoldedCounts));
+    char line[8192];
+    bool ok = true;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char* space = strrchr(line, ' ');
+        if (space == NULL || strchr(line, '\n') == NULL) {
+            ok = false;
+            break;
+        }
+        size_t count = strtoul(space + 1, NULL, 10);
+        *space = '\0';
+        counts->total += count;
+        bool high = strncmp(line, "priority 3;", 11) == 0;
+        if (strstr(line, ";render_frame [priority 3]") != NULL) {
+            if (high) counts->render += count;
+            else counts->render_elsewhere += count;
+        }
+        if (strncmp(line, "priority 1;", 11) == 0 && strstr(line, ";compact_log [priority 1]") != NULL) {
+            counts->compact += count;
+        }
+        if (strncmp(line, "priority 3 (inherited from 0);", 30) == 0 && strstr(line, ";flush_cache;") != NULL) {
+            counts->inverted_flush += count;
+        }
+        if (strncmp(line, "no task;", 8) == 0 && strstr(line, ";main;") != NULL) counts->outside += count;
+    }
+    fclose(in);
+    return ok;
+}
+
+// 見出しの語と標本の数を読み戻す
+static bool read_pprof(const char* path, size_t* samples) {
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) return false;
+    uintptr_t header[5];
+    bool ok = fread(header, sizeof(uintptr_t), 5, in) == 5 && header[0] == 0 && header[1] == 3 && header[2] == 0 &&
+              header[3] > 0 && header[4] == 0;
+    *samples = 0;
+    while (ok) {
+        uintptr_t record[2];
+        if (fread(record, sizeof(uintptr_t), 2, in) != 2 || record[1] > PROFILER_MAX_DEPTH) {
+            ok = false;
+            break;
+        }
+        uintptr_t pcs[PROFILER_MAX_DEPTH];
+        if (fread(pcs, sizeof(uintptr_t), record[1], in) != record[1]) ok = false;
+        if (record[0] == 0) {
+            // 終わりの印（0, 1, 0）のあとに対応表の文字列が続く
+            ok = ok && record[1] == 1 && pcs[0] == 0 && fgetc(in) != EOF;
+            break;
+        }
+        *samples += record[0];
+    }
+    fclose(in);
+    return ok;
+}
+
+static double overhead_round(void) {
+    double start = cpu_seconds();
+    sink = mix(sink, OVERHEAD_ITERATIONS);
+    return cpu_seconds() - start;
+}
+
+int main(void) {
+    if (profiler_start(NULL) != SLANG_SUCCESS || profiler_start(NULL) != SLANG_ERROR_INTERNAL) return 1;
+    bool ok = run_workload();
+    profiler_stop();
+    if (!ok) return 1;
+
+    char folded[] = "/tmp/profiler_bench_XXXXXX";
+    char pprof[] = "/tmp/profiler_bench_XXXXXX";
+    int folded_fd = mkstemp(folded);
+    int pprof_fd = mkstemp(pprof);
+    if (folded_fd < 0 || pprof_fd < 0) return 1;
+    close(folded_fd);
+    close(pprof_fd);
+
+    ProfilerStats stats;
+    profiler_stats(&stats);
+    FoldedCounts counts;
+    size_t pprof_samples = 0;
+    ok = profiler_write_folded(folded) == SLANG_SUCCESS && read_folded(folded, &counts) &&
+         profiler_write_pprof(pprof) == SLANG_SUCCESS && read_pprof(pprof, &pprof_samples);
+    remove(folded);
+    remove(pprof);
+    if (!ok) {
+        fprintf(stderr, "profiler_bench: could not read back the profiles\n");
+        return 1;
+    }
+    // どの場面も数十標本は取れる長さにしてあるので、少なくとも数個は付いているはず
+    if (counts.total != stats.samples || pprof_samples != stats.samples || counts.render < 5 ||
+        counts.render_elsewhere != 0 || counts.compact < 5 || counts.inverted_flush < 5 || counts.outside < 5 ||
+        stats.inverted < counts.inverted_flush || stats.dropped != 0) {
+        fprintf(stderr,
+                "profiler_bench: %zu samples (%zu folded, %zu pprof, %zu dropped): render %zu (%zu elsewhere), "
+                "compact %zu, inverted flush %zu of %zu, outside %zu\n",
+                stats.samples, counts.total, pprof_samples, stats.dropped, counts.render, counts.render_elsewhere,
+                counts.compact, counts.inverted_flush, stats.inverted, counts.outside);
+        return 1;
+    }
+    printf("attribution: %zu samples, render_frame %zu at priority 3, compact_log %zu at priority 1, "
+           "flush_cache %zu inherited from 0, main %zu outside tasks\n\n",
+           stats.samples, counts.render, counts.compact, counts.inverted_flush, counts.outside);
+    if (profiler_report(stdout, 8) != SLANG_SUCCESS) return 1;
+
+    // 止めたときと動かしたときで3回ずつ回し、速いほうを比べる
+    double off = 1e9, on = 1e9;
+    for (int round = 0; round < 3; round++) {
+        double seconds = overhead_round();
+        if (seconds < off) off = seconds;
+        if (profiler_start(NULL) != SLANG_SUCCESS) return 1;
+        seconds = overhead_round();
+        profiler_stop();
+        if (seconds < on) on = seconds;
+    }
+    profiler_stats(&stats);
+    printf("\noverhead at %d Hz: %.3f s off, %.3f s on (%+.2f%%), max depth %zu\n", PROFILER_DEFAULT_FREQUENCY, off,
+           on, 100.0 * (on - off) / off, stats.max_depth);
+    return 0;
+}
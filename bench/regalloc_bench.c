@@ -0,0 +1,563 @@
+// コード生成のベンチマーク
+// 同じ小さな関数を、codegen.cの旧来のスタックマシン方式（演算ごとにpush/pop、
+// ローカル変数は毎回[rbp - n]、浮動小数点数はmovqでGPRを往復）と、
+// IR → 線形走査レジスタ割り当て → x86_emitterの経路の両方で出力し、命令数を比べる。
+// ccが使えれば両方をアセンブルして実行時間も測る。
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ir.h"
+#include "regalloc.h"
+#include "x86_emitter.h"
+
+// 関数本体の小さな木（codegen.cが扱うのと同じ形の構文）
+typedef enum { EXPR_INT, EXPR_FLOAT, EXPR_VAR, EXPR_BINARY } ExprKind;
+
+typedef struct Expr {
+    ExprKind kind;
+    IrType type;
+    int64_t integer;
+    double number;
+    int var;
+    IrOpcode op;
+    struct Expr* left;
+    struct Expr* right;
+} Expr;
+
+typedef enum { STMT_ASSIGN, STMT_WHILE, STMT_RETURN } StmtKind;
+
+typedef struct Stmt {
+    StmtKind kind;
+    int var;
+    Expr* expr;
+    struct Stmt** body;
+    size_t body_count;
+} Stmt;
+
+#define MAX_VARS 8
+
+typedef struct {
+    const char* name;
+    int param_count;
+    int var_count;
+    IrType types[MAX_VARS];   // 先頭param_count個が引数
+    Stmt** body;
+    size_t body_count;
+} Kernel;
+
+static Expr expr_pool[256];
+static Stmt stmt_pool[64];
+static Stmt* list_pool[128];
+static size_t expr_used, stmt_used, list_used;
+static const Kernel* building;
+
+static Expr* new_expr(ExprKind kind, IrType type) {
+    Expr* e = &expr_pool[expr_used++];
+    memset(e, 0, sizeof(Expr));
+    e->kind = kind;
+    e->type = type;
+    return e;
+}
+
+static Expr* i64(int64_t value) {
+    Expr* e = new_expr(EXPR_INT, IR_INT);
+    e->integer = value;
+    return e;
+}
+
+static Expr* f64(double value) {
+    Expr* e = new_expr(EXPR_FLOAT, IR_FLOAT);
+    e->number = value;
+    return e;
+}
+
+static Expr* var(int index) {
+    Expr* e = new_expr(EXPR_VAR, building->types[index]);
+    e->var = index;
+    return e;
+}
+
+static Expr* bin(Expr* left, IrOpcode op, Expr* right) {
+    Expr* e = new_expr(EXPR_BINARY, ir_is_comparison(op) ? IR_INT : left->type);
+    e->op = op;
+    e->left = left;
+    e->right = right;
+    return e;
+}
+
+static Stmt** list(size_t count, ...) {
+    Stmt** items = &list_pool[list_used];
+    va_list args;
+    va_start(args, count);
+    for (size_t i = 0; i < count; i++) list_pool[list_used++] = va_arg(args, Stmt*);
+    va_end(args);
+    return items;
+}
+
+static Stmt* assign(int var_index, Expr* expr) {
+    Stmt* s = &stmt_pool[stmt_used++];
+    memset(s, 0, sizeof(Stmt));
+    s->kind = STMT_ASSIGN;
+    s->var = var_index;
+    s->expr = expr;
+    return s;
+}
+
+static Stmt* loop(Expr* condition, Stmt** body, size_t count) {
+    Stmt* s = &stmt_pool[stmt_used++];
+    memset(s, 0, sizeof(Stmt));
+    s->kind = STMT_WHILE;
+    s->expr = condition;
+    s->body = body;
+    s->body_count = count;
+    return s;
+}
+
+static Stmt* ret(Expr* expr) {
+    Stmt* s = &stmt_pool[stmt_used++];
+    memset(s, 0, sizeof(Stmt));
+    s->kind = STMT_RETURN;
+    s->expr = expr;
+    return s;
+}
+
+// 計測する関数
+// sum_poly(n): 整数の算術
+// horner(x, n): 浮動小数点数の積和
+// mandel(cx, cy, n): 浮動小数点数の一時値が多い式
+// gcd_sum(n): 入れ子のループと剰余
+enum { SUM_N, SUM_S, SUM_I };
+enum { HORNER_X, HORNER_N, HORNER_ACC, HORNER_I };
+enum { MANDEL_CX, MANDEL_CY, MANDEL_N, MANDEL_ZX, MANDEL_ZY, MANDEL_I, MANDEL_T };
+enum { GCD_N, GCD_S, GCD_I, GCD_A, GCD_B, GCD_T };
+
+static Kernel kernels[4] = {
+    {"sum_poly", 1, 3, {IR_INT, IR_INT, IR_INT}, NULL, 0},
+    {"horner", 2, 4, {IR_FLOAT, IR_INT, IR_FLOAT, IR_INT}, NULL, 0},
+    {"mandel", 3, 7, {IR_FLOAT, IR_FLOAT, IR_INT, IR_FLOAT, IR_FLOAT, IR_INT, IR_FLOAT}, NULL, 0},
+    {"gcd_sum", 1, 6, {IR_INT, IR_INT, IR_INT, IR_INT, IR_INT, IR_INT}, NULL, 0},
+};
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+static void build_kernels(void) {
+    building = &kernels[0];
+    kernels[0].body = list(4,
+        assign(SUM_S, i64(0)),
+        assign(SUM_I, i64(0)),
+        loop(bin(var(SUM_I), IR_LT, var(SUM_N)), list(2,
+            assign(SUM_S, bin(var(SUM_S), IR_ADD,
+                              bin(bin(bin(var(SUM_I), IR_MUL, i64(3)), IR_ADD, i64(1)), IR_MUL,
+                                  bin(var(SUM_I), IR_SUB, i64(2))))),
+            assign(SUM_I, bin(var(SUM_I), IR_ADD, i64(1)))), 2),
+        ret(var(SUM_S)));
+    kernels[0].body_count = 4;
+
+    building = &kernels[1];
+    kernels[1].body = list(4,
+        assign(HORNER_ACC, f64(0.0)),
+        assign(HORNER_I, i64(0)),
+        loop(bin(var(HORNER_I), IR_LT, var(HORNER_N)), list(2,
+            assign(HORNER_ACC, bin(bin(var(HORNER_ACC), IR_MUL, var(HORNER_X)), IR_ADD, f64(1.5))),
+            assign(HORNER_I, bin(var(HORNER_I), IR_ADD, i64(1)))), 2),
+        ret(var(HORNER_ACC)));
+    kernels[1].body_count = 4;
+
+    building = &kernels[2];
+    kernels[2].body = list(5,
+        assign(MANDEL_ZX, f64(0.0)),
+        assign(MANDEL_ZY, f64(0.0)),
+        assign(MANDEL_I, i64(0)),
+        loop(bin(var(MANDEL_I), IR_LT, var(MANDEL_N)), list(4,
+            assign(MANDEL_T, bin(bin(bin(var(MANDEL_ZX), IR_MUL, var(MANDEL_ZX)), IR_SUB,
+                                     bin(var(MANDEL_ZY), IR_MUL, var(MANDEL_ZY))), IR_ADD, var(MANDEL_CX))),
+            assign(MANDEL_ZY, bin(bin(bin(f64(2.0), IR_MUL, var(MANDEL_ZX)), IR_MUL, var(MANDEL_ZY)),
+                                  IR_ADD, var(MANDEL_CY))),
+            assign(MANDEL_ZX, var(MANDEL_T)),
+            assign(MANDEL_I, bin(var(MANDEL_I), IR_ADD, i64(1)))), 4),
+        ret(bin(var(MANDEL_ZX), IR_ADD, var(MANDEL_ZY))));
+    kernels[2].body_count = 5;
+
+    building = &kernels[3];
+    kernels[3].body = list(4,
+        assign(GCD_S, i64(0)),
+        assign(GCD_I, i64(1)),
+        loop(bin(var(GCD_I), IR_LT, var(GCD_N)), list(5,
+            assign(GCD_A, var(GCD_I)),
+            assign(GCD_B, var(GCD_N)),
+            loop(bin(var(GCD_B), IR_NE, i64(0)), list(3,
+                assign(GCD_T, bin(var(GCD_A), IR_MOD, var(GCD_B))),
+                assign(GCD_A, var(GCD_B)),
+                assign(GCD_B, var(GCD_T))), 3),
+            assign(GCD_S, bin(var(GCD_S), IR_ADD, var(GCD_A))),
+            assign(GCD_I, bin(var(GCD_I), IR_ADD, i64(1)))), 5),
+        ret(var(GCD_S)));
+    kernels[3].body_count = 4;
+}
+
+// 旧来のスタックマシン方式（codegen_emit_binaryなどと同じ命令列）
+typedef struct {
+    AsmWriter* out;
+    const Kernel* kernel;
+    size_t instructions;
+    size_t memory_accesses;
+    size_t labels;
+} StackEmitter;
+
+static void stack_emit(StackEmitter* emitter, const char* format, ...) {
+    char line[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    asm_text(emitter->out, "    ");
+    asm_text(emitter->out, line);
+    asm_text(emitter->out, "\n");
+    emitter->instructions++;
+    if (strchr(line, '[') != NULL || strncmp(line, "push", 4) == 0 || strncmp(line, "pop", 3) == 0) {
+        emitter->memory_accesses++;
+    }
+}
+
+// ラベルなど命令以外の行
+static void stack_line(StackEmitter* emitter, const char* format, ...) {
+    char line[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    asm_text(emitter->out, line);
+    asm_text(emitter->out, "\n");
+}
+
+static size_t stack_offset(int var_index) {
+    return 8 * (size_t)(var_index + 1);
+}
+
+static void stack_expression(StackEmitter* emitter, const Expr* e) {
+    switch (e->kind) {
+        case EXPR_INT:
+            stack_emit(emitter, "mov rax, %" PRId64, e->integer);
+            return;
+        case EXPR_FLOAT: {
+            int64_t bits;
+            memcpy(&bits, &e->number, sizeof(bits));
+            stack_emit(emitter, "mov rax, %" PRId64, bits);
+            stack_emit(emitter, "movq xmm0, rax");
+            return;
+        }
+        case EXPR_VAR:
+            stack_emit(emitter, "mov rax, qword ptr [rbp - %zu]", stack_offset(e->var));
+            return;
+        case EXPR_BINARY:
+            break;
+    }
+
+    stack_expression(emitter, e->right);
+    stack_emit(emitter, "push rax");
+    stack_expression(emitter, e->left);
+    stack_emit(emitter, "pop rbx");
+
+    bool is_float = e->left->type == IR_FLOAT;
+    if (is_float) {
+        static const char* const float_ops[] = { [IR_ADD] = "addsd", [IR_SUB] = "subsd", [IR_MUL] = "mulsd", [IR_DIV] = "divsd" };
+        stack_emit(emitter, "movq xmm0, rax");
+        stack_emit(emitter, "movq xmm1, rbx");
+        if (ir_is_comparison(e->op)) {
+            static const char* const float_conditions[] = {
+                [IR_EQ] = "e", [IR_NE] = "ne", [IR_LT] = "b", [IR_LE] = "be", [IR_GT] = "a", [IR_GE] = "ae"
+            };
+            stack_emit(emitter, "comisd xmm0, xmm1");
+            stack_emit(emitter, "set%s al", float_conditions[e->op]);
+            stack_emit(emitter, "movzx rax, al");
+        } else {
+            stack_emit(emitter, "%s xmm0, xmm1", float_ops[e->op]);
+            stack_emit(emitter, "movq rax, xmm0");
+        }
+        return;
+    }
+
+    static const char* const int_conditions[] = {
+        [IR_EQ] = "e", [IR_NE] = "ne", [IR_LT] = "l", [IR_LE] = "le", [IR_GT] = "g", [IR_GE] = "ge"
+    };
+    switch (e->op) {
+        case IR_ADD: stack_emit(emitter, "add rax, rbx"); break;
+        case IR_SUB: stack_emit(emitter, "sub rax, rbx"); break;
+        case IR_MUL: stack_emit(emitter, "imul rax, rbx"); break;
+        case IR_DIV:
+        case IR_MOD:
+            stack_emit(emitter, "cqo");
+            stack_emit(emitter, "idiv rbx");
+            if (e->op == IR_MOD) stack_emit(emitter, "mov rax, rdx");
+            break;
+        default:
+            stack_emit(emitter, "cmp rax, rbx");
+            stack_emit(emitter, "set%s al", int_conditions[e->op]);
+            stack_emit(emitter, "movzx rax, al");
+            break;
+    }
+}
+
+static void stack_statements(StackEmitter* emitter, Stmt* const* body, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const Stmt* s = body[i];
+        switch (s->kind) {
+            case STMT_ASSIGN:
+                stack_expression(emitter, s->expr);
+                stack_emit(emitter, "mov qword ptr [rbp - %zu], rax", stack_offset(s->var));
+                break;
+            case STMT_WHILE: {
+                size_t start = emitter->labels++, exit = emitter->labels++;
+                stack_line(emitter, ".Lold_%s_%zu:", emitter->kernel->name, start);
+                stack_expression(emitter, s->expr);
+                stack_emit(emitter, "cmp rax, 0");
+                stack_emit(emitter, "je .Lold_%s_%zu", emitter->kernel->name, exit);
+                stack_statements(emitter, s->body, s->body_count);
+                stack_emit(emitter, "jmp .Lold_%s_%zu", emitter->kernel->name, start);
+                stack_line(emitter, ".Lold_%s_%zu:", emitter->kernel->name, exit);
+                break;
+            }
+            case STMT_RETURN:
+                stack_expression(emitter, s->expr);
+                // 旧方式は戻り値をraxにしか置かないので、浮動小数点数はxmm0へ移す
+                if (s->expr->type == IR_FLOAT) stack_emit(emitter, "movq xmm0, rax");
+                // 旧方式は退避せずにrbxを壊すので、呼び出し元のために戻しておく
+                stack_emit(emitter, "mov rbx, qword ptr [rbp - %zu]", stack_offset(emitter->kernel->var_count));
+                stack_emit(emitter, "mov rsp, rbp");
+                stack_emit(emitter, "pop rbp");
+                stack_emit(emitter, "ret");
+                break;
+        }
+    }
+}
+
+static void stack_function(StackEmitter* emitter) {
+    const Kernel* kernel = emitter->kernel;
+    size_t local_size = (stack_offset(kernel->var_count) + 15) & ~(size_t)15;
+    static const char* const int_args[] = { "rdi", "rsi", "rdx", "rcx", "r8", "r9" };
+
+    stack_line(emitter, "\nold_%s:", kernel->name);
+    stack_emit(emitter, "push rbp");
+    stack_emit(emitter, "mov rbp, rsp");
+    stack_emit(emitter, "sub rsp, %zu", local_size);
+    stack_emit(emitter, "mov qword ptr [rbp - %zu], rbx", stack_offset(kernel->var_count));
+
+    int ints = 0, floats = 0;
+    for (int i = 0; i < kernel->param_count; i++) {
+        if (kernel->types[i] == IR_FLOAT) {
+            stack_emit(emitter, "movsd qword ptr [rbp - %zu], xmm%d", stack_offset(i), floats++);
+        } else {
+            stack_emit(emitter, "mov qword ptr [rbp - %zu], %s", stack_offset(i), int_args[ints++]);
+        }
+    }
+    stack_statements(emitter, kernel->body, kernel->body_count);
+}
+
+// IRへの変換（変数ごとに1つの仮想レジスタ、代入は直前の命令の書き込み先を替える）
+typedef struct {
+    IrFunction* function;
+    IrValue vars[MAX_VARS];
+} Lowering;
+
+static IrValue lower_expression(Lowering* lowering, const Expr* e) {
+    switch (e->kind) {
+        case EXPR_INT:   return ir_emit_const_int(lowering->function, e->integer);
+        case EXPR_FLOAT: return ir_emit_const_float(lowering->function, e->number);
+        case EXPR_VAR:   return lowering->vars[e->var];
+        case EXPR_BINARY: {
+            IrValue left = lower_expression(lowering, e->left);
+            IrValue right = lower_expression(lowering, e->right);
+            return ir_emit_binary(lowering->function, e->op, left, right);
+        }
+    }
+    return IR_NO_VALUE;
+}
+
+static void lower_statements(Lowering* lowering, Stmt* const* body, size_t count) {
+    IrFunction* function = lowering->function;
+    for (size_t i = 0; i < count; i++) {
+        const Stmt* s = body[i];
+        switch (s->kind) {
+            case STMT_ASSIGN: {
+                IrValue value = lower_expression(lowering, s->expr);
+                IrValue target = lowering->vars[s->var];
+                if (s->expr->kind == EXPR_VAR || !ir_retarget_last(function, value, target)) {
+                    ir_emit_move(function, target, value);
+                }
+                break;
+            }
+            case STMT_WHILE: {
+                uint32_t start = ir_new_label(function), exit = ir_new_label(function);
+                ir_emit_label(function, start);
+                ir_emit_branch_false(function, lower_expression(lowering, s->expr), exit);
+                lower_statements(lowering, s->body, s->body_count);
+                ir_emit_jump(function, start);
+                ir_emit_label(function, exit);
+                break;
+            }
+            case STMT_RETURN:
+                ir_emit_return(function, lower_expression(lowering, s->expr));
+                break;
+        }
+    }
+}
+
+static IrFunction* lower_kernel(const Kernel* kernel, char* name, size_t name_size) {
+    snprintf(name, name_size, "new_%s", kernel->name);
+    Lowering lowering;
+    lowering.function = ir_function_create(name);
+    if (lowering.function == NULL) return NULL;
+
+    for (int i = 0; i < kernel->var_count; i++) {
+        lowering.vars[i] = i < kernel->param_count
+            ? ir_emit_param(lowering.function, (uint32_t)i, kernel->types[i])
+            : ir_new_value(lowering.function, kernel->types[i]);
+    }
+    lower_statements(&lowering, kernel->body, kernel->body_count);
+    return lowering.function;
+}
+
+// 実行時間を測るドライバ（両方の結果が一致することも確かめる）
+static const char* const driver_source =
+    "#include <stdio.h>\n"
+    "#include <stdint.h>\n"
+    "#include <time.h>\n"
+    "int64_t old_sum_poly(int64_t), new_sum_poly(int64_t);\n"
+    "double old_horner(double, int64_t), new_horner(double, int64_t);\n"
+    "double old_mandel(double, double, int64_t), new_mandel(double, double, int64_t);\n"
+    "int64_t old_gcd_sum(int64_t), new_gcd_sum(int64_t);\n"
+    "static double now(void) { struct timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec * 1e-9; }\n"
+    "#define TIME(label, type, call, fmt, cast) do { double best_old = 1e9, best_new = 1e9; type r_old = 0, r_new = 0; \\\n"
+    "    for (int k = 0; k < 5; k++) { double s = now(); r_old = old_##call; double m = now(); r_new = new_##call; double e = now(); \\\n"
+    "        if (m - s < best_old) best_old = m - s; if (e - m < best_new) best_new = e - m; } \\\n"
+    "    if (r_old != r_new) { fprintf(stderr, \"%s mismatch\\n\", label); return 1; } \\\n"
+    "    printf(\"%s %.3f %.3f \" fmt \"\\n\", label, best_old * 1e3, best_new * 1e3, (cast)r_new); } while (0)\n"
+    "int main(void) {\n"
+    "    TIME(\"sum_poly\", int64_t, sum_poly(20000000), \"%lld\", long long);\n"
+    "    TIME(\"horner\", double, horner(0.5, 20000000), \"%.6f\", double);\n"
+    "    TIME(\"mandel\", double, mandel(-0.1, 0.1, 20000000), \"%.6f\", double);\n"
+    "    TIME(\"gcd_sum\", int64_t, gcd_sum(300000), \"%lld\", long long);\n"
+    "    return 0;\n"
+    "}\n";
+
+typedef struct {
+    size_t old_instructions, old_memory;
+    size_t new_instructions, new_memory;
+    double old_ms, new_ms;
+    bool timed;
+} Result;
+
+static bool write_file(const char* path, const char* text) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return false;
+    fputs(text, file);
+    return fclose(file) == 0;
+}
+
+static void run_driver(const char* directory, Result* results) {
+    char driver[256], program[320], assembly[256], command[1200];
+    snprintf(driver, sizeof(driver), "%s/driver.c", directory);
+    snprintf(assembly, sizeof(assembly), "%s/kernels.s", directory);
+    snprintf(program, sizeof(program), "%s/driver", directory);
+    if (!write_file(driver, driver_source)) return;
+
+    const char* cc = getenv("CC") ? getenv("CC") : "cc";
+    snprintf(command, sizeof(command), "%s -O2 -o %s %s %s 2>&1", cc, program, driver, assembly);
+    if (system(command) != 0) {
+        fprintf(stderr, "regalloc_bench: could not assemble %s, reporting instruction counts only\n", assembly);
+        return;
+    }
+
+    FILE* pipe = popen(program, "r");
+    if (pipe == NULL) return;
+    char name[32];
+    double old_ms, new_ms;
+    char value[64];
+    while (fscanf(pipe, "%31s %lf %lf %63s", name, &old_ms, &new_ms, value) == 4) {
+        for (size_t i = 0; i < KERNEL_COUNT; i++) {
+            if (strcmp(name, kernels[i].name) != 0) continue;
+            results[i].old_ms = old_ms;
+            results[i].new_ms = new_ms;
+            results[i].timed = true;
+        }
+    }
+    pclose(pipe);
+}
+
+int main(void) {
+    build_kernels();
+
+    char directory[] = "/tmp/slang_regalloc_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        perror("regalloc_bench: mkdtemp");
+        return 1;
+    }
+    char assembly[256];
+    snprintf(assembly, sizeof(assembly), "%s/kernels.s", directory);
+    AsmWriter writer;
+    AsmWriter* out = &writer;
+    if (!asm_writer_open(out, assembly)) {
+        perror("regalloc_bench: open");
+        return 1;
+    }
+    asm_text(out, ".intel_syntax noprefix\n.section .text\n");
+
+    Result results[KERNEL_COUNT];
+    memset(results, 0, sizeof(results));
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        asm_text(out, ".global old_");
+        asm_text(out, kernels[i].name);
+        asm_text(out, "\n.global new_");
+        asm_text(out, kernels[i].name);
+        asm_text(out, "\n");
+
+        StackEmitter stack = { out, &kernels[i], 0, 0, 0 };
+        stack_function(&stack);
+        results[i].old_instructions = stack.instructions;
+        results[i].old_memory = stack.memory_accesses;
+
+        char name[64];
+        IrFunction* function = lower_kernel(&kernels[i], name, sizeof(name));
+        RegisterAllocation allocation;
+        X86EmitStats stats = { 0, 0 };
+        if (function == NULL || regalloc_run(function, &allocation) != SLANG_SUCCESS) {
+            fprintf(stderr, "regalloc_bench: %s: register allocation failed\n", kernels[i].name);
+            return 1;
+        }
+        if (x86_emit_function(out, function, &allocation, &stats) != SLANG_SUCCESS) {
+            fprintf(stderr, "regalloc_bench: %s: emission failed\n", kernels[i].name);
+            return 1;
+        }
+        results[i].new_instructions = stats.instructions;
+        results[i].new_memory = stats.memory_accesses;
+        regalloc_free(&allocation);
+        ir_function_destroy(function);
+    }
+    asm_text(out, ".section .note.GNU-stack,\"\",@progbits\n");
+    if (!asm_writer_close(out)) {
+        fprintf(stderr, "regalloc_bench: could not write %s\n", assembly);
+        return 1;
+    }
+
+    run_driver(directory, results);
+
+    printf("[");
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        const Result* r = &results[i];
+        printf("%s{\"benchmark\": \"codegen_%s\", \"stack_instructions\": %zu, \"regalloc_instructions\": %zu, "
+               "\"stack_memory_ops\": %zu, \"regalloc_memory_ops\": %zu",
+               i ? ",\n " : "", kernels[i].name, r->old_instructions, r->new_instructions,
+               r->old_memory, r->new_memory);
+        if (r->timed) {
+            printf(", \"stack_ms\": %.2f, \"regalloc_ms\": %.2f, \"speedup\": %.2f",
+                   r->old_ms, r->new_ms, r->old_ms / r->new_ms);
+        }
+        printf("}");
+    }
+    printf("]\n");
+    return 0;
+}
@@ -0,0 +1,282 @@
+// 優先度つきスケジューラのベンチマーク
+// 低い段階の重いタスクを絶えず積みながら最も高い段階の短い要求を投入し、要求の遅延（投入から待ち終わるまで）の
+// p50・p99を、同じ数のスレッドのFIFOのthread_poolで同じ負荷をかけた場合と比べる。
+// 測る前に、段階を混ぜて入れ子に投入して待つフィボナッチの結果と、高い段階のタスクが積まれた低い段階の
+// タスクを待つとき（優先度の継承）に、その前に積まれた低い段階のタスクを待たないことを確かめる。
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "scheduler.h"
+#include "thread_pool.h"
+
+#define WORKERS 4
+#define RESERVED 1
+#define BACKLOG 64              // 積んでおく低い段階のタスクの数
+#define BACKGROUND_US 500       // 低い段階のタスク1つの重さ
+#define REQUESTS 200
+#define REQUEST_US 20           // 要求1つの重さ
+#define REQUEST_INTERVAL_US 2000
+#define FIB_N 24
+#define FIB_CUTOFF 10
+#define FLOOD 400               // 継承の確認の前に積む低い段階のタスクの数
+#define FLOOD_US 200
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void spin(unsigned microseconds) {
+    double end = now_seconds() + microseconds * 1e-6;
+    while (now_seconds() < end) {
+    }
+}
+
+static void sleep_us(unsigned microseconds) {
+    struct timespec ts = { 0, (long)microseconds * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static long fib_sequential(int n) {
+    return n < 2 ? n : fib_sequential(n - 1) + fib_sequential(n - 2);
+}
+
+// 入れ子の投入と待ち（子の段階はnで変え、継承と古い項目の読み飛ばしも通す）
+typedef struct {
+    Scheduler* scheduler;
+    int n;
+    long result;
+} Fib;
+
+static void fib_task(void* context) {
+    Fib* fib = context;
+    if (fib->n < FIB_CUTOFF) {
+        fib->result = fib_sequential(fib->n);
+        return;
+    }
+    Fib child = { fib->scheduler, fib->n - 1, 0 };
+    SchedulerTask* task = scheduler_spawn(fib->scheduler, (unsigned)fib->n % SCHEDULER_LEVELS, fib_task, &child);
+    Fib other = { fib->scheduler, fib->n - 2, 0 };
+    fib_task(&other);
+    if (task != NULL) {
+        scheduler_wait(fib->scheduler, task);
+    } else {
+        fib_task(&child);
+    }
+    fib->result = child.result + other.result;
+}
+
+static bool check_fib(void) {
+    Scheduler* scheduler = scheduler_create(WORKERS, RESERVED);
+    if (scheduler == NULL) return false;
+    Fib fib = { scheduler, FIB_N, 0 };
+    SchedulerTask* task = scheduler_spawn(scheduler, 0, fib_task, &fib);
+    if (task != NULL) scheduler_wait(scheduler, task);
+    scheduler_destroy(scheduler);
+
+    long expected = fib_sequential(FIB_N);
+    if (task == NULL || fib.result != expected) {
+        fprintf(stderr, "scheduler_bench: fib(%d) = %ld, expected %ld\n", FIB_N, fib.result, expected);
+        return false;
+    }
+    return true;
+}
+
+static void flood_task(void* context) {
+    (void)context;
+    spin(FLOOD_US);
+}
+
+static void flag_task(void* context) {
+    atomic_store((atomic_bool*)context, true);
+}
+
+typedef struct {
+    Scheduler* scheduler;
+    SchedulerTask* target;
+    atomic_bool* flag;
+    bool inherit;
+} Waiter;
+
+// 高い段階から低い段階のタスクを待つ（inheritでなければ終わりを見張るだけで継承させない）
+static void waiter_task(void* context) {
+    Waiter* waiter = context;
+    if (waiter->inherit) {
+        scheduler_wait(waiter->scheduler, waiter->target);
+        return;
+    }
+    while (!atomic_load(waiter->flag)) sched_yield();
+    scheduler_detach(waiter->target);
+}
+
+// 低い段階のタスクを積んだあとに積んだ低い段階のタスクを、最も高い段階のタスクから待つのにかかる時間
+static double measure_wait(bool inherit, double* flood_ms) {
+    Scheduler* scheduler = scheduler_create(2, 0);
+    if (scheduler == NULL) return -1;
+    double start = now_seconds();
+    for (size_t i = 0; i < FLOOD; i++) {
+        SchedulerTask* task = scheduler_spawn(scheduler, 0, flood_task, NULL);
+        if (task != NULL) scheduler_detach(task);
+    }
+    atomic_bool flag = false;
+    SchedulerTask* target = scheduler_spawn(scheduler, 0, flag_task, &flag);
+    Waiter waiter = { scheduler, target, &flag, inherit };
+    SchedulerTask* high = target ? scheduler_spawn(scheduler, SCHEDULER_LEVELS - 1, waiter_task, &waiter) : NULL;
+    double elapsed = -1;
+    if (high != NULL) {
+        scheduler_wait(scheduler, high);
+        elapsed = (now_seconds() - start) * 1e3;
+    }
+    scheduler_destroy(scheduler);
+    *flood_ms = (now_seconds() - start) * 1e3;
+    return elapsed;
+}
+
+static bool bench_inheritance(void) {
+    double flood_ms, polling_flood_ms;
+    double inherit_ms = measure_wait(true, &flood_ms);
+    double polling_ms = measure_wait(false, &polling_flood_ms);
+    if (inherit_ms < 0 || polling_ms < 0) {
+        fprintf(stderr, "scheduler_bench: inheritance setup failed\n");
+        return false;
+    }
+    if (inherit_ms * 4 > flood_ms) {
+        fprintf(stderr, "scheduler_bench: waiting task queued behind background work (%.2f ms of %.2f ms)\n",
+                inherit_ms, flood_ms);
+        return false;
+    }
+    printf("{\"benchmark\": \"priority_inheritance\", \"queued\": %d, \"flood_ms\": %.2f, "
+           "\"inherit_wait_ms\": %.3f, \"polling_wait_ms\": %.2f}",
+           FLOOD, flood_ms, inherit_ms, polling_ms);
+    return true;
+}
+
+// 遅延の測定（同じ負荷をスケジューラとthread_poolにかける）
+typedef struct {
+    Scheduler* scheduler;
+    ThreadPool* pool;
+    ThreadPoolGroup group;
+    atomic_int outstanding;
+    atomic_bool running;
+} Load;
+
+static void background_task(void* context) {
+    Load* load = context;
+    spin(BACKGROUND_US);
+    atomic_fetch_sub(&load->outstanding, 1);
+}
+
+// 低い段階のタスクをBACKLOG個積んだままにする
+static void* feeder_main(void* argument) {
+    Load* load = argument;
+    while (atomic_load(&load->running)) {
+        if (atomic_load(&load->outstanding) >= BACKLOG) {
+            sleep_us(100);
+            continue;
+        }
+        atomic_fetch_add(&load->outstanding, 1);
+        if (load->scheduler != NULL) {
+            SchedulerTask* task = scheduler_spawn(load->scheduler, 0, background_task, load);
+            if (task != NULL) {
+                scheduler_detach(task);
+            } else {
+                atomic_fetch_sub(&load->outstanding, 1);
+            }
+        } else {
+            thread_pool_spawn(load->pool, &load->group, background_task, load);
+        }
+    }
+    return NULL;
+}
+
+static void request_task(void* context) {
+    (void)context;
+    spin(REQUEST_US);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static bool measure_latency(Load* load, double* p50, double* p99) {
+    static double latencies[REQUESTS];
+    atomic_init(&load->outstanding, 0);
+    atomic_init(&load->running, true);
+    pthread_t feeder;
+    if (pthread_create(&feeder, NULL, feeder_main, load) != 0) return false;
+    while (atomic_load(&load->outstanding) < BACKLOG) sleep_us(100);
+
+    bool ok = true;
+    for (size_t i = 0; i < REQUESTS; i++) {
+        sleep_us(REQUEST_INTERVAL_US);
+        double start = now_seconds();
+        if (load->scheduler != NULL) {
+            SchedulerTask* task = scheduler_spawn(load->scheduler, SCHEDULER_LEVELS - 1, request_task, NULL);
+            if (task == NULL) {
+                ok = false;
+                break;
+            }
+            scheduler_wait(load->scheduler, task);
+        } else {
+            ThreadPoolGroup group;
+            thread_pool_group_init(&group);
+            thread_pool_spawn(load->pool, &group, request_task, NULL);
+            thread_pool_wait(load->pool, &group);
+        }
+        latencies[i] = (now_seconds() - start) * 1e3;
+    }
+
+    atomic_store(&load->running, false);
+    pthread_join(feeder, NULL);
+    qsort(latencies, REQUESTS, sizeof(double), compare_doubles);
+    *p50 = latencies[REQUESTS / 2];
+    *p99 = latencies[REQUESTS * 99 / 100];
+    return ok;
+}
+
+static bool bench_latency(void) {
+    Load load;
+    memset(&load, 0, sizeof(load));
+    double scheduler_p50, scheduler_p99, pool_p50, pool_p99;
+
+    load.scheduler = scheduler_create(WORKERS, RESERVED);
+    if (load.scheduler == NULL) return false;
+    bool ok = measure_latency(&load, &scheduler_p50, &scheduler_p99);
+    scheduler_destroy(load.scheduler);
+    load.scheduler = NULL;
+
+    // 呼び出し元を含めて同じ数のスレッドが処理する
+    load.pool = thread_pool_create(WORKERS + 1);
+    if (load.pool == NULL) return false;
+    thread_pool_group_init(&load.group);
+    ok = ok && measure_latency(&load, &pool_p50, &pool_p99);
+    thread_pool_wait(load.pool, &load.group);
+    thread_pool_destroy(load.pool);
+    if (!ok) {
+        fprintf(stderr, "scheduler_bench: latency run failed\n");
+        return false;
+    }
+
+    printf("{\"benchmark\": \"request_latency\", \"workers\": %d, \"reserved\": %d, \"backlog\": %d, "
+           "\"requests\": %d, \"scheduler_p50_ms\": %.3f, \"scheduler_p99_ms\": %.3f, "
+           "\"fifo_pool_p50_ms\": %.3f, \"fifo_pool_p99_ms\": %.3f}",
+           WORKERS, RESERVED, BACKLOG, REQUESTS, scheduler_p50, scheduler_p99, pool_p50, pool_p99);
+    return true;
+}
+
+int main(void) {
+    if (!check_fib()) return 1;
+
+    printf("[");
+    if (!bench_inheritance()) return 1;
+    printf(",\n ");
+    if (!bench_latency()) return 1;
+    printf("]\n");
+    return 0;
+}
@@ -0,0 +1,284 @@
+// コンパイラのサーバーのベンチマーク
+// 一時ディレクトリに関数を多数並べたヘッダ（lib/core.sls）と、それをuseするmain.slを書き、同じプロセスの
+// スレッドでサーバーを動かしてUnixソケットでcheckを送る。最初の要求（すべて読んで検査する）、何も変えずに
+// 送り直した要求、main.slだけを書き換えた要求、ヘッダを書き換えた要求の時間を測り、応答の数から
+// 読み直した単位と検査した成分が期待どおりかを確かめる。型エラーと構文エラーの診断、最初の接続を開いたまま
+// 2つ目の接続が答えを受けること、ソケットが所有者だけのものであることも確かめ、最後に
+// 要求ごとにサーバーを作り直した場合（表は温まったまま、プロセスの起動は含まない）と比べる。
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "source_gen.h"
+#include "intern.h"
+#include "server.h"
+
+#define HEADER_FUNCTIONS 2000
+#define REPEATS 20
+#define CONNECT_ATTEMPTS 200
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char directory[] = "/tmp/server_bench_XXXXXX";
+static char socket_path[64];
+static char header_path[64];
+static char main_path[64];
+
+static bool write_file(const char* path, const char* data, size_t length) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) return false;
+    bool ok = fwrite(data, 1, length, out) == length;
+    return fclose(out) == 0 && ok;
+}
+
+// main.slはヘッダの最後の関数を呼ぶ（extraは後ろに足す関数）
+static bool write_main(const char* extra) {
+    char text[1024];
+    int length = snprintf(text, sizeof(text),
+                          "use lib.core;\n"
+                          "fn entry(n: int) -> int { return f%d(n, 3) + 1; }\n"
+                          "let answer: int = entry(10);\n"
+                          "%s",
+                          HEADER_FUNCTIONS - 1, extra);
+    return length > 0 && (size_t)length < sizeof(text) && write_file(main_path, text, (size_t)length);
+}
+
+static bool write_header(const char* extra) {
+    size_t length;
+    char* source = source_gen_many_functions(HEADER_FUNCTIONS, &length);
+    if (source == NULL) return false;
+    size_t extra_length = strlen(extra);
+    char* text = malloc(length + extra_length);
+    bool ok = text != NULL;
+    if (ok) {
+        memcpy(text, source, length);
+        memcpy(text + length, extra, extra_length);
+        ok = write_file(header_path, text, length + extra_length);
+    }
+    free(text);
+    free(source);
+    return ok;
+}
+
+static void* serve(void* argument) {
+    static SlangError result;
+    result = server_listen(argument, socket_path);
+    return &result;
+}
+
+typedef struct {
+    FILE* in;
+    FILE* out;
+} Client;
+
+static bool client_connect(Client* client) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    // サーバーのスレッドが待ち受けを始めるまで繰り返す
+    for (int attempt = 0; attempt < CONNECT_ATTEMPTS; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        if (connect(fd, (const struct sockaddr*)&address, sizeof(address)) == 0) {
+            client->in = fdopen(fd, "r");
+            client->out = fdopen(dup(fd), "w");
+            return client->in != NULL && client->out != NULL;
+        }
+        close(fd);
+        usleep(5000);
+    }
+    return false;
+}
+
+typedef struct {
+    char status[16];
+    size_t units, parsed, checked, reused;
+    unsigned long long us;           // サーバーが測った時間
+    double round_trip_ms;            // クライアントから見た時間
+    char diagnostics[1024];
+} Reply;
+
+// 要求を送り、終わりの行まで読む（診断はdiagnosticsに集める）
+static bool request(Client* client, const char* line, Reply* reply) {
+    memset(reply, 0, sizeof(Reply));
+    double start = now_seconds();
+    if (fprintf(client->out, "%s\n", line) < 0 || fflush(client->out) != 0) return false;
+    char buffer[SERVER_LINE_MAX];
+    while (fgets(buffer, sizeof(buffer), client->in) != NULL) {
+        if (sscanf(buffer, "%15s units=%zu parsed=%zu checked=%zu reused=%zu us=%llu", reply->status, &reply->units,
+                   &reply->parsed, &reply->checked, &reply->reused, &reply->us) == 6 ||
+            strncmp(buffer, "stats ", 6) == 0 || strcmp(buffer, "bye\n") == 0 || strncmp(buffer, "error ", 6) == 0) {
+            if (reply->status[0] == '\0') sscanf(buffer, "%15s", reply->status);
+            reply->round_trip_ms = (now_seconds() - start) * 1e3;
+            return true;
+        }
+        size_t used = strlen(reply->diagnostics);
+        snprintf(reply->diagnostics + used, sizeof(reply->diagnostics) - used, "%s", buffer);
+    }
+    return false;
+}
+
+static bool expect(const char* name, const Reply* reply, const char* status, size_t parsed, size_t checked,
+                   size_t reused) {
+    if (strcmp(reply->status, status) == 0 && reply->units == 2 && reply->parsed == parsed &&
+        reply->checked == checked && reply->reused == reused) {
+        return true;
+    }
+    fprintf(stderr, "server_bench: %s: %s units=%zu parsed=%zu checked=%zu reused=%zu (expected %s %zu/%zu/%zu)\n%s",
+            name, reply->status, reply->units, reply->parsed, reply->checked, reply->reused, status, parsed, checked,
+            reused, reply->diagnostics);
+    return false;
+}
+
+static void print_reply(const char* name, const Reply* reply) {
+    printf("%-16s %-6s parsed %zu, checked %zu, reused %zu: %8.3f ms in the server, %8.3f ms round trip\n", name,
+           reply->status, reply->parsed, reply->checked, reply->reused, (double)reply->us * 1e-3, reply->round_trip_ms);
+}
+
+// 何も変えずに送り直し、最も速い回を返す
+static bool warm_requests(Client* client, Reply* best) {
+    for (int i = 0; i < REPEATS; i++) {
+        Reply reply;
+        if (!request(client, "check main.sl", &reply) || !expect("warm", &reply, "ok", 0, 0, 2)) return false;
+        if (i == 0 || reply.us < best->us) *best = reply;
+    }
+    return true;
+}
+
+static bool run(Client* client, double* warm_ms) {
+    Reply reply, warm;
+    if (!request(client, "check main.sl", &reply) || !expect("cold", &reply, "ok", 2, 2, 0)) return false;
+    print_reply("cold", &reply);
+    if (!warm_requests(client, &warm)) return false;
+    print_reply("warm", &warm);
+    *warm_ms = warm.round_trip_ms;
+
+    // 使う側だけを変えると、ヘッダは読み直さず検査も使い回す
+    if (!write_main("fn helper(x: int) -> int { return x * 2; }\n") || !request(client, "check main.sl", &reply) ||
+        !expect("edit main", &reply, "ok", 1, 1, 1)) {
+        return false;
+    }
+    print_reply("edit main", &reply);
+
+    // 型エラーと構文エラーは診断を返し、直せばまた通る
+    if (!write_main("fn bad() -> int { return true; }\n") || !request(client, "check main.sl", &reply) ||
+        !expect("type error", &reply, "failed", 1, 1, 1)) {
+        return false;
+    }
+    if (strstr(reply.diagnostics, "main.sl:4:19: Type Error: return type mismatch 'bad'") == NULL) {
+        fprintf(stderr, "server_bench: type error: unexpected diagnostics:\n%s", reply.diagnostics);
+        return false;
+    }
+    print_reply("type error", &reply);
+    if (!write_main("fn broken( {\n") || !request(client, "check main.sl", &reply) ||
+        !expect("syntax error", &reply, "failed", 1, 0, 1)) {
+        return false;
+    }
+    if (strstr(reply.diagnostics, "main.sl:") == NULL || strstr(reply.diagnostics, "Syntax Error") == NULL) {
+        fprintf(stderr, "server_bench: syntax error: unexpected diagnostics:\n%s", reply.diagnostics);
+        return false;
+    }
+    print_reply("syntax error", &reply);
+    if (!write_main("") || !request(client, "check main.sl", &reply) || !expect("fixed", &reply, "ok", 1, 1, 1)) {
+        return false;
+    }
+    print_reply("fixed", &reply);
+
+    // ヘッダを変えると、使う側も（構文解析はそのままで）検査し直す
+    if (!write_header("fn g0() -> int { return 1; }\n") || !request(client, "check main.sl", &reply) ||
+        !expect("edit header", &reply, "ok", 1, 2, 0)) {
+        return false;
+    }
+    print_reply("edit header", &reply);
+    if (!warm_requests(client, &warm)) return false;
+
+    if (!request(client, "check missing.sl", &reply) || strcmp(reply.status, "failed") != 0 ||
+        strstr(reply.diagnostics, "Could not read file 'missing.sl'") == NULL) {
+        fprintf(stderr, "server_bench: missing file: %s\n%s", reply.status, reply.diagnostics);
+        return false;
+    }
+    if (!request(client, "frobnicate", &reply) || strcmp(reply.status, "error") != 0) return false;
+    if (!request(client, "stats", &reply) || strcmp(reply.status, "stats") != 0) return false;
+
+    // 最初の接続を開いたままでもほかの接続に答える（答えなければ待ちきらずに失敗にする）
+    Client other;
+    if (!client_connect(&other)) return false;
+    struct timeval timeout = { 5, 0 };
+    bool answered = setsockopt(fileno(other.in), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0 &&
+                    request(&other, "stats", &reply) && strcmp(reply.status, "stats") == 0;
+    fclose(other.in);
+    fclose(other.out);
+    if (!answered) {
+        fprintf(stderr, "server_bench: a second connection was not served while the first was open\n");
+        return false;
+    }
+    struct stat info;
+    if (stat(socket_path, &info) != 0 || (info.st_mode & 0777) != 0600) {
+        fprintf(stderr, "server_bench: the socket is not private to its owner\n");
+        return false;
+    }
+    return request(client, "shutdown", &reply) && strcmp(reply.status, "bye") == 0;
+}
+
+// 要求ごとにサーバーを作り直す（コマンドラインで1回ずつ検査するのに近い。プロセスの起動は含まない）
+static double one_shot_ms(void) {
+    double best = 1e9;
+    for (int i = 0; i < REPEATS / 4; i++) {
+        double start = now_seconds();
+        Server* server = server_create();
+        SlangError error = server ? server_check(server, "main.sl", NULL) : SLANG_ERROR_INTERNAL;
+        server_destroy(server);
+        double elapsed = (now_seconds() - start) * 1e3;
+        if (error != SLANG_SUCCESS) return -1.0;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(void) {
+    if (mkdtemp(directory) == NULL || chdir(directory) != 0 || mkdir("lib", 0755) != 0) return 1;
+    snprintf(socket_path, sizeof(socket_path), "%s/server.sock", directory);
+    snprintf(header_path, sizeof(header_path), "%s/lib/core.sls", directory);
+    snprintf(main_path, sizeof(main_path), "%s/main.sl", directory);
+    if (!intern_init() || !type_table_init() || !write_header("") || !write_main("")) return 1;
+
+    Server* server = server_create();
+    pthread_t thread;
+    if (server == NULL || pthread_create(&thread, NULL, serve, server) != 0) return 1;
+    Client client;
+    double warm_ms = 0.0;
+    bool ok = client_connect(&client) && run(&client, &warm_ms);
+    if (ok) {
+        fclose(client.in);
+        fclose(client.out);
+        void* result;
+        pthread_join(thread, &result);
+        ok = *(SlangError*)result == SLANG_SUCCESS && access(socket_path, F_OK) != 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "server_bench: the server did not answer as expected\n");
+        return 1;
+    }
+    server_destroy(server);
+
+    double one_shot = one_shot_ms();
+    remove(header_path);
+    remove(main_path);
+    rmdir("lib");
+    if (chdir("/") != 0 || rmdir(directory) != 0 || one_shot < 0.0) return 1;
+    printf("\none-shot check (fresh server per request): %.3f ms, warm round trip: %.3f ms (%.0fx)\n", one_shot, warm_ms,
+           one_shot / warm_ms);
+    intern_shutdown();
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "source_gen.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    uint64_t state;            // 線形合同法の状態
+    bool failed;
+} Gen;
+
+static void gen_init(Gen* gen, size_t capacity) {
+    gen->data = malloc(capacity);
+    gen->length = 0;
+    gen->capacity = capacity;
+    gen->state = 0x2545f4914f6cdd1dull;
+    gen->failed = gen->data == NULL;
+}
+
+static bool gen_reserve(Gen* gen, size_t extra) {
+    if (gen->failed) return false;
+    if (gen->length + extra < gen->capacity) return true;
+    size_t capacity = gen->capacity * 2;
+    while (gen->length + extra >= capacity) capacity *= 2;
+    char* grown = realloc(gen->data, capacity);
+    if (grown == NULL) {
+        gen->failed = true;
+        return false;
+    }
+    gen->data = grown;
+    gen->capacity = capacity;
+    return true;
+}
+
+static void gen_printf(Gen* gen, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (needed >= 0 && gen_reserve(gen, (size_t)needed + 1)) {
+        vsnprintf(gen->data + gen->length, (size_t)needed + 1, format, args);
+        gen->length += (size_t)needed;
+    }
+    va_end(args);
+}
+
+static void gen_char(Gen* gen, char c) {
+    if (gen_reserve(gen, 2)) gen->data[gen->length++] = c;
+}
+
+// 引数の評価順で結果が変わらないように、1つの式では1回だけ引く
+static uint32_t gen_next(Gen* gen) {
+    gen->state = gen->state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(gen->state >> 33);
+}
+
+static char* gen_finish(Gen* gen, size_t* length) {
+    if (gen->failed) {
+        free(gen->data);
+        return NULL;
+    }
+    gen->data[gen->length] = '\0';
+    *length = gen->length;
+    return gen->data;
+}
+
+// 整数だけの演算子（割る数は定数なので0にならない）
+static const char* gen_operator(Gen* gen) {
+    static const char* const operators[] = { "+", "-", "*", "/", "%" };
+    return operators[gen_next(gen) % 5];
+}
+
+static void gen_deep_expression(Gen* gen, size_t index, size_t depth) {
+    const char* base = index == 0 ? "g" : "e";
+    size_t previous = index == 0 ? 0 : index - 1;
+
+    gen_printf(gen, "let e%zu: int = ", index);
+    // 左に入れ子の括弧 ((((e + 1) * 2) - 3) ...)
+    for (size_t d = 0; d < depth; d++) gen_char(gen, '(');
+    gen_printf(gen, "%s%zu", base, previous);
+    for (size_t d = 0; d < depth; d++) {
+        const char* op = gen_operator(gen);
+        gen_printf(gen, " %s %u)", op, gen_next(gen) % 9 + 1);
+    }
+    // 右に入れ子の括弧 1 + (2 * (3 - ...))
+    gen_printf(gen, " + ");
+    for (size_t d = 0; d < depth; d++) {
+        uint32_t value = gen_next(gen) % 9 + 1;
+        gen_printf(gen, "%u %s (", value, gen_operator(gen));
+    }
+    gen_printf(gen, "-g0");
+    for (size_t d = 0; d < depth; d++) gen_char(gen, ')');
+    // 括弧のない長い連鎖（優先順位の解析）
+    for (size_t d = 0; d < depth * 4; d++) {
+        const char* op = gen_operator(gen);
+        if (d % 3 == 0) gen_printf(gen, " %s %s%zu", op, base, previous);
+        else gen_printf(gen, " %s %u", op, gen_next(gen) % 9 + 1);
+    }
+    gen_printf(gen, ";\n");
+}
+
+char* source_gen_deep_expressions(size_t count, size_t depth, size_t* length) {
+    Gen gen;
+    gen_init(&gen, 4096);
+    gen_printf(&gen, "let g0: int = 7;\n");
+    for (size_t i = 0; i < count; i++) gen_deep_expression(&gen, i, depth);
+    return gen_finish(&gen, length);
+}
+
+static void gen_function(Gen* gen, size_t index) {
+    if (index == 0) {
+        gen_printf(gen, "fn f0(a: int, b: int) -> int { return a + b; }\n");
+        return;
+    }
+    uint32_t scale = gen_next(gen) % 7 + 1;
+    gen_printf(gen,
+               "fn f%zu(a: int, b: int) -> int {\n"
+               "    let t: int = f%zu(a - 1, b) * %u;\n"
+               "    if t > %u && b != 0 { t = t - a; } else { t = t + b; }\n"
+               "    while t > 1000 { t = t / 2; }\n"
+               "    return t;\n"
+               "}\n",
+               index, index - 1, scale, gen_next(gen) % 100);
+}
+
+char* source_gen_many_functions(size_t count, size_t* length) {
+    Gen gen;
+    gen_init(&gen, 4096);
+    for (size_t i = 0; i < count; i++) gen_function(&gen, i);
+    return gen_finish(&gen, length);
+}
+
+// 80文字くらいごとに改行を入れる（"は含めない）
+static void gen_string(Gen* gen, size_t index, size_t literal_length) {
+    gen_printf(gen, "let s%zu: string = \"", index);
+    if (!gen_reserve(gen, literal_length + 1)) return;
+    for (size_t i = 0; i < literal_length; i++) {
+        uint32_t r = gen_next(gen);
+        gen->data[gen->length++] = r % 80 == 0 ? '\n' : r % 7 == 0 ? ' ' : (char)('#' + r % 92);
+    }
+    gen_printf(gen, "\";\nfn text%zu() -> string { return s%zu; }\n", index, index);
+}
+
+char* source_gen_long_strings(size_t count, size_t literal_length, size_t* length) {
+    Gen gen;
+    gen_init(&gen, 4096);
+    for (size_t i = 0; i < count; i++) gen_string(&gen, i, literal_length);
+    return gen_finish(&gen, length);
+}
+
+char* source_gen_huge(size_t bytes, size_t* length) {
+    Gen gen;
+    gen_init(&gen, bytes + 4096);
+    gen_printf(&gen, "let g0: int = 7;\n");
+    // 関数16個・式1つ・文字列1つを1組にして繰り返す（名前は通しの番号）
+    size_t functions = 0, expressions = 0, strings = 0;
+    while (!gen.failed && gen.length < bytes) {
+        for (int i = 0; i < 16; i++) gen_function(&gen, functions++);
+        gen_deep_expression(&gen, expressions++, 8);
+        gen_string(&gen, strings++, 256);
+    }
+    return gen_finish(&gen, length);
+}
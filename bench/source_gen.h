@@ -0,0 +1,20 @@
+#ifndef SLANG_BENCH_SOURCE_GEN_H
+#define SLANG_BENCH_SOURCE_GEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ベンチマーク用の合成ソース
+// どれも同じ引数なら同じバイト列を返す（乱数は固定の種から作る）ので、結果を前回と比べられる。
+// 生成したソースは構文エラーも型エラーもなく、最上位の名前は使う前に宣言する。
+
+// 入れ子の深い括弧と長い二項演算の連鎖を初期化子に持つ最上位のlet
+char* source_gen_deep_expressions(size_t count, size_t depth, size_t* length);
+// 直前の関数を呼ぶ小さな関数の並び
+char* source_gen_many_functions(size_t count, size_t* length);
+// 長い文字列リテラル（改行を含む）をlog!に渡す関数とグローバル変数
+char* source_gen_long_strings(size_t count, size_t literal_length, size_t* length);
+// 上の形を混ぜてbytesを超えるまで並べた大きなファイル
+char* source_gen_huge(size_t bytes, size_t* length);
+
+#endif // SLANG_BENCH_SOURCE_GEN_H
@@ -0,0 +1,243 @@
+// テンソルの実行時ライブラリのベンチマーク
+// 512x512の行列積を素朴な3重ループ、ブロック分割（1スレッド）、ブロック分割（全スレッド）、
+// 転置したビューを渡した場合で比べ、要素ごとの演算を1回で評価する場合と1演算ずつ一時テンソルに
+// 書く場合、単一の累積での総和と複数の累積での総和も比べる。結果が合わなければ1を返す。
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tensor.h"
+
+#define GEMM_N 512
+#define MAP_N (1u << 22)
+#define REPEAT 5
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t seed = 88172645463325252ull;
+
+static double random_unit(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (double)(seed >> 11) / (double)(1ull << 53) - 0.5;
+}
+
+static void fill_random(Tensor* tensor) {
+    double* data = tensor->storage->data;
+    for (size_t i = 0; i < tensor->storage->length; i++) data[i] = random_unit();
+}
+
+static bool check(SlangError error, const char* what) {
+    if (error != SLANG_SUCCESS) fprintf(stderr, "tensor_bench: %s failed (%d)\n", what, (int)error);
+    return error == SLANG_SUCCESS;
+}
+
+static void naive_matmul(double* c, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            double sum = 0.0;
+            for (size_t p = 0; p < n; p++) sum += a[i * n + p] * b[p * n + j];
+            c[i * n + j] = sum;
+        }
+    }
+}
+
+static double max_difference(const Tensor* x, const double* y) {
+    double worst = 0.0;
+    for (size_t i = 0; i < GEMM_N; i++) {
+        for (size_t j = 0; j < GEMM_N; j++) {
+            size_t index[2] = {i, j};
+            double d = fabs(*tensor_at(x, index) - y[i * GEMM_N + j]);
+            if (d > worst) worst = d;
+        }
+    }
+    return worst;
+}
+
+static bool bench_matmul(ThreadPool* pool, bool* first) {
+    size_t shape[2] = {GEMM_N, GEMM_N};
+    Tensor a, b, c, stored, at;
+    if (!check(tensor_create(&a, 2, shape), "create") || !check(tensor_create(&b, 2, shape), "create") ||
+        !check(tensor_create(&c, 2, shape), "create") || !check(tensor_create(&stored, 2, shape), "create")) return false;
+    fill_random(&a);
+    fill_random(&b);
+    // storedにaの転置を置き、その転置ビューatはaと同じ値になる
+    for (size_t i = 0; i < GEMM_N; i++) {
+        for (size_t j = 0; j < GEMM_N; j++) stored.storage->data[j * GEMM_N + i] = a.storage->data[i * GEMM_N + j];
+    }
+    if (!check(tensor_transpose(&at, &stored, 0, 1), "transpose")) return false;
+
+    double* reference = malloc(GEMM_N * GEMM_N * sizeof(double));
+    double start = now_seconds();
+    naive_matmul(reference, a.storage->data, b.storage->data, GEMM_N);
+    double naive_seconds = now_seconds() - start;
+
+    struct { const char* name; ThreadPool* pool; const Tensor* a; } cases[] = {
+        {"blocked_1t", NULL, &a},
+        {"blocked_mt", pool, &a},
+        {"blocked_mt_transposed", pool, &at},
+    };
+    double flops = 2.0 * GEMM_N * GEMM_N * GEMM_N;
+    bool ok = true;
+    for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+        double best = 1e30;
+        for (int r = 0; r < REPEAT; r++) {
+            start = now_seconds();
+            if (!check(tensor_matmul(cases[k].pool, &c, cases[k].a, &b), "matmul")) return false;
+            double seconds = now_seconds() - start;
+            if (seconds < best) best = seconds;
+        }
+        double error = max_difference(&c, reference);
+        if (error > 1e-10 * GEMM_N) {
+            fprintf(stderr, "tensor_bench: matmul %s mismatch (%g)\n", cases[k].name, error);
+            ok = false;
+        }
+        printf("%s{\"benchmark\": \"matmul_%s\", \"n\": %d, \"threads\": %zu, \"naive_gflops\": %.2f, "
+               "\"gflops\": %.2f, \"speedup\": %.2f, \"max_error\": %.1e}",
+               *first ? "" : ",\n ", cases[k].name, GEMM_N, thread_pool_size(cases[k].pool),
+               flops / naive_seconds * 1e-9, flops / best * 1e-9, naive_seconds / best, error);
+        *first = false;
+    }
+
+    free(reference);
+    tensor_release(&at);
+    tensor_release(&stored);
+    tensor_release(&c);
+    tensor_release(&b);
+    tensor_release(&a);
+    return ok;
+}
+
+// out = relu(a * b + c) を1回で評価するか、1演算ずつ一時テンソルに書くか
+static bool bench_map(ThreadPool* pool, bool* first) {
+    size_t shape[1] = {MAP_N};
+    Tensor inputs[3], fused, t1, t2, unfused;
+    for (int i = 0; i < 3; i++) {
+        if (!check(tensor_create(&inputs[i], 1, shape), "create")) return false;
+        fill_random(&inputs[i]);
+    }
+    if (!check(tensor_create(&fused, 1, shape), "create") || !check(tensor_create(&t1, 1, shape), "create") ||
+        !check(tensor_create(&t2, 1, shape), "create") || !check(tensor_create(&unfused, 1, shape), "create")) return false;
+
+    const TensorInstruction whole[] = {
+        {TENSOR_OP_INPUT, 0, 0}, {TENSOR_OP_INPUT, 1, 0}, {TENSOR_OP_MUL, 0, 0},
+        {TENSOR_OP_INPUT, 2, 0}, {TENSOR_OP_ADD, 0, 0}, {TENSOR_OP_RELU, 0, 0},
+    };
+    const TensorInstruction mul[] = {{TENSOR_OP_INPUT, 0, 0}, {TENSOR_OP_INPUT, 1, 0}, {TENSOR_OP_MUL, 0, 0}};
+    const TensorInstruction add[] = {{TENSOR_OP_INPUT, 0, 0}, {TENSOR_OP_INPUT, 1, 0}, {TENSOR_OP_ADD, 0, 0}};
+    const TensorInstruction relu[] = {{TENSOR_OP_INPUT, 0, 0}, {TENSOR_OP_RELU, 0, 0}};
+    TensorProgram fused_program = {whole, 6};
+    TensorProgram mul_program = {mul, 3}, add_program = {add, 3}, relu_program = {relu, 2};
+    Tensor add_inputs[2] = {t1, inputs[2]};
+
+    bool ok = true;
+    for (int threaded = 0; threaded < 2; threaded++) {
+        ThreadPool* use = threaded ? pool : NULL;
+        double fused_best = 1e30, unfused_best = 1e30;
+        for (int r = 0; r < REPEAT; r++) {
+            double start = now_seconds();
+            if (!check(tensor_map(use, &fused, &fused_program, inputs, 3), "map")) return false;
+            double seconds = now_seconds() - start;
+            if (seconds < fused_best) fused_best = seconds;
+
+            start = now_seconds();
+            if (!check(tensor_map(use, &t1, &mul_program, inputs, 2), "map") ||
+                !check(tensor_map(use, &t2, &add_program, add_inputs, 2), "map") ||
+                !check(tensor_map(use, &unfused, &relu_program, &t2, 1), "map")) return false;
+            seconds = now_seconds() - start;
+            if (seconds < unfused_best) unfused_best = seconds;
+        }
+        if (memcmp(fused.storage->data, unfused.storage->data, MAP_N * sizeof(double)) != 0) {
+            fprintf(stderr, "tensor_bench: fused map mismatch\n");
+            ok = false;
+        }
+        printf("%s{\"benchmark\": \"map_fused_%s\", \"elements\": %u, \"threads\": %zu, \"fused_ms\": %.2f, "
+               "\"unfused_ms\": %.2f, \"speedup\": %.2f}",
+               *first ? "" : ",\n ", threaded ? "mt" : "1t", MAP_N, thread_pool_size(use),
+               fused_best * 1e3, unfused_best * 1e3, unfused_best / fused_best);
+        *first = false;
+    }
+
+    tensor_release(&unfused);
+    tensor_release(&t2);
+    tensor_release(&t1);
+    tensor_release(&fused);
+    for (int i = 0; i < 3; i++) tensor_release(&inputs[i]);
+    return ok;
+}
+
+// 総和（連続と、2048x2048を転置したビュー）
+static bool bench_reduce(ThreadPool* pool, bool* first) {
+    size_t shape[2] = {2048, MAP_N / 2048};
+    Tensor x, xt;
+    if (!check(tensor_create(&x, 2, shape), "create")) return false;
+    fill_random(&x);
+    if (!check(tensor_transpose(&xt, &x, 0, 1), "transpose")) return false;
+
+    double naive_best = 1e30, naive = 0.0;
+    for (int r = 0; r < REPEAT; r++) {
+        double start = now_seconds();
+        double sum = 0.0;
+        const double* data = x.storage->data;
+        for (size_t i = 0; i < MAP_N; i++) sum += data[i];
+        double seconds = now_seconds() - start;
+        if (seconds < naive_best) naive_best = seconds;
+        naive = sum;
+    }
+
+    struct { const char* name; ThreadPool* pool; const Tensor* t; } cases[] = {
+        {"1t", NULL, &x},
+        {"mt", pool, &x},
+        {"mt_transposed", pool, &xt},
+    };
+    bool ok = true;
+    double expected = 0.0;
+    for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+        double best = 1e30, sum = 0.0;
+        for (int r = 0; r < REPEAT; r++) {
+            double start = now_seconds();
+            if (!check(tensor_reduce(cases[k].pool, cases[k].t, TENSOR_REDUCE_SUM, &sum), "reduce")) return false;
+            double seconds = now_seconds() - start;
+            if (seconds < best) best = seconds;
+        }
+        // 並列度によらず同じ値で、単一の累積の値とは丸め誤差の範囲で合う
+        if (k == 0) expected = sum;
+        if ((k < 2 && sum != expected) || fabs(sum - naive) > 1e-9 * MAP_N) {
+            fprintf(stderr, "tensor_bench: reduce %s mismatch (%.17g vs %.17g)\n", cases[k].name, sum, naive);
+            ok = false;
+        }
+        printf("%s{\"benchmark\": \"reduce_sum_%s\", \"elements\": %u, \"threads\": %zu, \"naive_ms\": %.2f, "
+               "\"ms\": %.2f, \"speedup\": %.2f}",
+               *first ? "" : ",\n ", cases[k].name, MAP_N, thread_pool_size(cases[k].pool),
+               naive_best * 1e3, best * 1e3, naive_best / best);
+        *first = false;
+    }
+
+    tensor_release(&xt);
+    tensor_release(&x);
+    return ok;
+}
+
+int main(void) {
+    ThreadPool* pool = thread_pool_create(0);
+    if (pool == NULL) {
+        fprintf(stderr, "tensor_bench: thread pool failed\n");
+        return 1;
+    }
+
+    bool first = true;
+    printf("[");
+    bool ok = bench_matmul(pool, &first);
+    ok = bench_map(pool, &first) && ok;
+    ok = bench_reduce(pool, &first) && ok;
+    printf("]\n");
+
+    thread_pool_destroy(pool);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+// コンパイルの計測のベンチマーク
+// 手で組んだASTでノードの数え方を確かめてから、生成したソースを複数のスレッドで字句解析・構文解析して
+// ドライバと同じ区間を記録し、名前ごとの合計（回数・トークン・ノード）とトレースのJSONの形と、表の段階の
+// 割合の和が100%になることを確かめる。
+// 最後に計測なしと比べた費用と、1区間を記録する費用を測り、--time-reportと同じ表を出力する。
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+#include "parser.h"
+#include "intern.h"
+
+#define THREADS 4
+#define UNITS 64
+#define FUNCTIONS_PER_UNIT 200
+#define RECORDS 200000
+
+static bool check_count(void) {
+    Arena* arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    if (arena == NULL) return false;
+    // fn f() { let x = 1 + 2 * 3; while x { x = -x; } return g(x, 1.5); } の形
+    ASTNode* product = create_binary_expression_node(arena, create_integer_literal_node(arena, 2), "*",
+                                                     create_integer_literal_node(arena, 3));
+    ASTNode* sum = create_binary_expression_node(arena, create_integer_literal_node(arena, 1), "+", product);
+    ASTNode* negate = create_unary_expression_node(arena, "-", create_variable_reference_node(arena, "x"));
+    ASTNode* assign = create_expression_statement_node(arena, create_assignment_node(arena, "x", negate));
+    ASTNode* loop = create_while_statement_node(arena, create_variable_reference_node(arena, "x"),
+                                                create_block_statement_node(arena, &assign, 1));
+    ASTNode* arguments[] = { create_variable_reference_node(arena, "x"), create_float_literal_node(arena, 1.5) };
+    ASTNode* statements[] = {
+        create_let_statement_node(arena, "x", NULL, sum),
+        loop,
+        create_return_statement_node(arena, create_function_call_node(arena, "g", arguments, 2)),
+    };
+    ASTNode* function = create_function_node(arena, "f", NULL, NULL, 0, create_block_statement_node(arena, statements, 3));
+    size_t count = ast_count_nodes(function);
+    arena_destroy(arena);
+    // function・body・let・5（式）・while・x・block・文・代入・単項・x・return・呼び出し・2（引数）
+    if (count != 19) {
+        fprintf(stderr, "trace_bench: counted %zu nodes, expected 19\n", count);
+        return false;
+    }
+    return ast_count_nodes(NULL) == 0;
+}
+
+typedef struct {
+    const char* path;
+    char* source;
+    size_t length;
+    size_t tokens;
+    size_t nodes;
+} Unit;
+
+static Unit units[UNITS];
+
+static char* generate_unit(int unit, size_t* length) {
+    size_t capacity = FUNCTIONS_PER_UNIT * 160;
+    char* source = malloc(capacity);
+    size_t used = 0;
+    for (int f = 0; f < FUNCTIONS_PER_UNIT; f++) {
+        used += (size_t)snprintf(source + used, capacity - used,
+                                 "fn u%d_f%d(a: int, b: int) -> int {\n"
+                                 "    let t = a * %d + b;\n"
+                                 "    if t > 10 { t = t - 1; } else { t = t + 2; }\n"
+                                 "    return t * (a + b);\n"
+                                 "}\n",
+                                 unit, f, f % 7);
+    }
+    *length = used;
+    return source;
+}
+
+// ドライバのparse_jobと同じ区間を記録する（traceがNULLなら記録しない）
+static bool parse_unit(Trace* trace, Unit* unit) {
+    uint64_t start = trace_begin(trace);
+    Arena* arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    Lexer* lexer = lexer_create(unit->source, unit->length);
+    bool ok = arena != NULL && lexer != NULL && lexer_scan(lexer) == SLANG_SUCCESS;
+    if (ok) {
+        trace_end(trace, "phase", "lex", unit->path, start, lexer->token_capacity * sizeof(Token), lexer->token_count);
+        unit->tokens = lexer->token_count;
+    }
+
+    Parser* parser = NULL;
+    ASTNode* program = NULL;
+    if (ok) {
+        start = trace_begin(trace);
+        ok = (parser = parser_create(lexer, arena)) != NULL && parser_parse(parser, &program) == SLANG_SUCCESS;
+        if (ok && trace != NULL) {
+            uint64_t end = trace_now();
+            unit->nodes = ast_count_nodes(program);
+            trace_add(trace, "phase", "parse", unit->path, start, end, arena->total_allocated, unit->nodes);
+        }
+    }
+    parser_destroy(parser);
+    if (lexer != NULL) lexer_destroy(lexer);
+    arena_destroy(arena);
+    return ok;
+}
+
+typedef struct {
+    Trace* trace;
+    int thread;
+    bool ok;
+} Worker;
+
+static void* parse_units(void* argument) {
+    Worker* worker = argument;
+    worker->ok = true;
+    for (int u = worker->thread; u < UNITS; u += THREADS) {
+        worker->ok = parse_unit(worker->trace, &units[u]) && worker->ok;
+    }
+    return NULL;
+}
+
+static bool parse_all(Trace* trace) {
+    pthread_t threads[THREADS];
+    Worker workers[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        workers[t] = (Worker){ trace, t, false };
+        pthread_create(&threads[t], NULL, parse_units, &workers[t]);
+    }
+    bool ok = true;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        ok = ok && workers[t].ok;
+    }
+    return ok;
+}
+
+// 区間の数と処理した数が単位の合計と合うか
+static bool check_events(const Trace* trace) {
+    size_t lex = 0, parse = 0, tokens = 0, nodes = 0, expected_tokens = 0, expected_nodes = 0;
+    uint32_t seen[THREADS] = { 0 };
+    size_t thread_count = 0;
+    for (size_t i = 0; i < trace->event_count; i++) {
+        const TraceEvent* event = &trace->events[i];
+        bool is_lex = strcmp(event->name, "lex") == 0;
+        lex += is_lex;
+        parse += !is_lex;
+        if (is_lex) tokens += event->items;
+        else nodes += event->items;
+        size_t t = 0;
+        while (t < thread_count && seen[t] != event->thread) t++;
+        if (t == thread_count && thread_count < THREADS) seen[thread_count++] = event->thread;
+        else if (t == thread_count) return false;
+    }
+    for (int u = 0; u < UNITS; u++) {
+        expected_tokens += units[u].tokens;
+        expected_nodes += units[u].nodes;
+    }
+    if (lex != UNITS || parse != UNITS || tokens != expected_tokens || nodes != expected_nodes || trace->failed) {
+        fprintf(stderr, "trace_bench: recorded %zu lex and %zu parse events (%zu tokens, %zu nodes)\n", lex, parse,
+                tokens, nodes);
+        return false;
+    }
+    return true;
+}
+
+// 文字列の外の括弧が釣り合い、区間の数だけ"X"のイベントがあるか
+static bool check_json(const Trace* trace, const char* path) {
+    if (trace_write_json(trace, path) != SLANG_SUCCESS) return false;
+    FILE* in = fopen(path, "r");
+    if (in == NULL) return false;
+    int depth = 0;
+    bool in_string = false, escaped = false, balanced = true;
+    size_t complete = 0;
+    static const char marker[] = "\"ph\":\"X\"";
+    char window[sizeof(marker) - 1] = { 0 };
+    for (int c; (c = fgetc(in)) != EOF;) {
+        memmove(window, window + 1, sizeof(window) - 1);
+        window[sizeof(window) - 1] = (char)c;
+        if (memcmp(window, marker, sizeof(window)) == 0) complete++;
+        if (in_string) {
+            if (escaped) escaped = false;
+            else if (c == '\\') escaped = true;
+            else if (c == '"') in_string = false;
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            balanced = balanced && --depth >= 0;
+        }
+    }
+    fclose(in);
+    remove(path);
+    if (!balanced || depth != 0 || in_string || complete != trace->event_count) {
+        fprintf(stderr, "trace_bench: malformed trace (%zu of %zu events)\n", complete, trace->event_count);
+        return false;
+    }
+    return true;
+}
+
+// 表の割合は種類ごとのスレッド時間の合計に対するものなので、並列に記録しても段階の行の和は100%になる
+static bool check_report(const Trace* trace) {
+    FILE* out = tmpfile();
+    if (out == NULL) return false;
+    trace_report(trace, out);
+    rewind(out);
+    char line[256];
+    double percent = 0.0;
+    size_t rows = 0;
+    while (fgets(line, sizeof(line), out) != NULL) {
+        char kind[16], name[32];
+        size_t count;
+        double ms, share;
+        if (sscanf(line, "%15s %31s %zu %lf %lf%%", kind, name, &count, &ms, &share) == 5 &&
+            strcmp(kind, "phase") == 0) {
+            percent += share;
+            rows++;
+        }
+    }
+    fclose(out);
+    bool ok = rows > 0 && percent > 99.0 && percent < 101.0;
+    if (!ok) fprintf(stderr, "trace_bench: phase shares add up to %.1f%% over %zu rows\n", percent, rows);
+    return ok;
+}
+
+int main(void) {
+    // 型の表は複数のスレッドから引くので、スレッドを起動する前に作っておく
+    if (!intern_init() || !type_table_init()) return 1;
+    if (!check_count()) return 1;
+    for (int u = 0; u < UNITS; u++) {
+        char path[32];
+        snprintf(path, sizeof(path), "unit%d.sl", u);
+        units[u].path = intern_cstr(path);
+        units[u].source = generate_unit(u, &units[u].length);
+    }
+
+    double untraced = 0.0, traced = 0.0;
+    Trace* trace = NULL;
+    bool ok = true;
+    for (int round = 0; round < 3 && ok; round++) {
+        uint64_t start = trace_now();
+        ok = parse_all(NULL);
+        untraced += (double)(trace_now() - start) * 1e-9;
+
+        trace_destroy(trace);
+        trace = trace_create();
+        start = trace_now();
+        ok = ok && trace != NULL && parse_all(trace);
+        traced += (double)(trace_now() - start) * 1e-9;
+    }
+    char path[] = "/tmp/trace_bench_XXXXXX";
+    int fd = mkstemp(path);
+    ok = ok && fd >= 0 && check_events(trace) && check_json(trace, path) && check_report(trace);
+    if (fd >= 0) close(fd);
+    if (!ok) return 1;
+    // 数えた時間を含む（ノードを数えるのは計測するときだけ）
+    printf("parse %d units: %.2f ms untraced, %.2f ms traced and counted\n", UNITS, untraced * 1e3 / 3,
+           traced * 1e3 / 3);
+
+    Trace* empty = trace_create();
+    uint64_t start = trace_now();
+    for (int i = 0; i < RECORDS; i++) {
+        trace_end(empty, "pass", "bench", NULL, trace_begin(empty), 0, (uint64_t)i);
+    }
+    double record = (double)(trace_now() - start) * 1e-9;
+    start = trace_now();
+    for (int i = 0; i < RECORDS; i++) {
+        trace_end(NULL, "pass", "bench", NULL, trace_begin(NULL), 0, (uint64_t)i);
+    }
+    double disabled = (double)(trace_now() - start) * 1e-9;
+    printf("trace_end: %.1f ns/event recorded, %.1f ns/event with no trace\n\n", record * 1e9 / RECORDS,
+           disabled * 1e9 / RECORDS);
+    trace_destroy(empty);
+
+    trace_report(trace, stdout);
+    trace_destroy(trace);
+    for (int u = 0; u < UNITS; u++) free(units[u].source);
+    intern_shutdown();
+    return 0;
+}
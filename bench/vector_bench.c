@@ -0,0 +1,347 @@
+// ベクトル演算のベンチマーク
+// ベクトルの加算と内積（vec4とvec3）、要素ごとの減算・除算、スカラー倍、4x4行列の積、四元数の積を
+// ループで繰り返す関数をIRで組み、レジスタ割り当てとx86_emitterでパックド命令に出力する。
+// ccが使えれば、同じ順序で計算するスカラーのCの関数（自動ベクトル化なし）と結果を比べ、実行時間も測る。
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "regalloc.h"
+#include "x86_emitter.h"
+
+typedef struct {
+    const char* name;
+    IrFunction* (*build)(void);
+} Kernel;
+
+// for (i = 0; i < n; i++) body のループ
+typedef struct {
+    IrFunction* function;
+    IrValue i;
+    IrValue n;
+    uint32_t start;
+    uint32_t exit;
+} Loop;
+
+static void loop_begin(Loop* loop, IrFunction* function, IrValue n) {
+    loop->function = function;
+    loop->n = n;
+    loop->i = ir_new_value(function, IR_INT);
+    loop->start = ir_new_label(function);
+    loop->exit = ir_new_label(function);
+    ir_emit_move(function, loop->i, ir_emit_const_int(function, 0));
+    ir_emit_label(function, loop->start);
+    ir_emit_branch_false(function, ir_emit_binary(function, IR_LT, loop->i, n), loop->exit);
+}
+
+static void loop_end(Loop* loop) {
+    IrFunction* function = loop->function;
+    IrValue next = ir_emit_binary(function, IR_ADD, loop->i, ir_emit_const_int(function, 1));
+    if (!ir_retarget_last(function, next, loop->i)) ir_emit_move(function, loop->i, next);
+    ir_emit_jump(function, loop->start);
+    ir_emit_label(function, loop->exit);
+}
+
+// double dotN(double* acc, const double* step, const double* w, int64_t n)
+//   acc += step; s += acc・w を繰り返してsを返す
+static IrFunction* build_dot(const char* name, uint32_t count) {
+    IrFunction* function = ir_function_create(name);
+    IrValue acc = ir_emit_param(function, 0, IR_INT);
+    IrValue step = ir_emit_param(function, 1, IR_INT);
+    IrValue w = ir_emit_param(function, 2, IR_INT);
+    IrValue n = ir_emit_param(function, 3, IR_INT);
+    IrValue s = ir_new_value(function, IR_FLOAT);
+    ir_emit_move(function, s, ir_emit_const_float(function, 0.0));
+
+    Loop loop;
+    loop_begin(&loop, function, n);
+    ir_emit_vector_binary(function, IR_VEC_ADD, acc, acc, step, count);
+    IrValue sum = ir_emit_binary(function, IR_ADD, s, ir_emit_vector_dot(function, acc, w, count));
+    if (!ir_retarget_last(function, sum, s)) ir_emit_move(function, s, sum);
+    loop_end(&loop);
+    ir_emit_return(function, s);
+    return function;
+}
+
+static IrFunction* build_dot4(void) { return build_dot("vk_dot4", 4); }
+static IrFunction* build_dot3(void) { return build_dot("vk_dot3", 3); }
+
+// int64_t mix(double* acc, double* t, const double* a, const double* b, int64_t n)
+//   t = (a - b) / b; acc += t（6要素）
+static IrFunction* build_mix(void) {
+    IrFunction* function = ir_function_create("vk_mix");
+    IrValue acc = ir_emit_param(function, 0, IR_INT);
+    IrValue t = ir_emit_param(function, 1, IR_INT);
+    IrValue a = ir_emit_param(function, 2, IR_INT);
+    IrValue b = ir_emit_param(function, 3, IR_INT);
+    IrValue n = ir_emit_param(function, 4, IR_INT);
+
+    Loop loop;
+    loop_begin(&loop, function, n);
+    ir_emit_vector_binary(function, IR_VEC_SUB, t, a, b, 6);
+    ir_emit_vector_binary(function, IR_VEC_DIV, t, t, b, 6);
+    ir_emit_vector_binary(function, IR_VEC_ADD, acc, acc, t, 6);
+    loop_end(&loop);
+    return function;
+}
+
+// int64_t scale(double* v, double k, int64_t n)
+//   v *= k（8要素。kはベクトル演算をまたいで生きる）
+static IrFunction* build_scale(void) {
+    IrFunction* function = ir_function_create("vk_scale");
+    IrValue v = ir_emit_param(function, 0, IR_INT);
+    IrValue k = ir_emit_param(function, 1, IR_FLOAT);
+    IrValue n = ir_emit_param(function, 2, IR_INT);
+
+    Loop loop;
+    loop_begin(&loop, function, n);
+    ir_emit_vector_scale(function, v, v, k, 8);
+    loop_end(&loop);
+    return function;
+}
+
+// int64_t mat4(double* m, const double* r, int64_t n)
+//   m = m × r
+static IrFunction* build_mat4(void) {
+    IrFunction* function = ir_function_create("vk_mat4");
+    IrValue m = ir_emit_param(function, 0, IR_INT);
+    IrValue r = ir_emit_param(function, 1, IR_INT);
+    IrValue n = ir_emit_param(function, 2, IR_INT);
+
+    Loop loop;
+    loop_begin(&loop, function, n);
+    ir_emit_mat4_mul(function, m, m, r);
+    loop_end(&loop);
+    return function;
+}
+
+// int64_t quat(double* q, const double* r, int64_t n)
+//   q[j] = q[j] * r（4つの四元数）
+static IrFunction* build_quat(void) {
+    IrFunction* function = ir_function_create("vk_quat");
+    IrValue q = ir_emit_param(function, 0, IR_INT);
+    IrValue r = ir_emit_param(function, 1, IR_INT);
+    IrValue n = ir_emit_param(function, 2, IR_INT);
+    IrValue items[4] = { q };
+    for (int j = 1; j < 4; j++) items[j] = ir_emit_binary(function, IR_ADD, q, ir_emit_const_int(function, 32 * j));
+
+    Loop loop;
+    loop_begin(&loop, function, n);
+    for (int j = 0; j < 4; j++) ir_emit_quat_mul(function, items[j], items[j], r);
+    loop_end(&loop);
+    return function;
+}
+
+static const Kernel kernels[] = {
+    {"dot4", build_dot4},
+    {"dot3", build_dot3},
+    {"mix", build_mix},
+    {"scale", build_scale},
+    {"mat4", build_mat4},
+    {"quat", build_quat},
+};
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+// スカラーの参照実装と計測のドライバ（演算の順序はx86_emitterのパックド命令と同じにしてあり、
+// 結果はビット単位で一致しなければならない）
+static const char* const driver_source =
+    "#include <stdio.h>\n"
+    "#include <stdint.h>\n"
+    "#include <string.h>\n"
+    "#include <time.h>\n"
+    "double vk_dot4(double*, const double*, const double*, int64_t);\n"
+    "double vk_dot3(double*, const double*, const double*, int64_t);\n"
+    "int64_t vk_mix(double*, double*, const double*, const double*, int64_t);\n"
+    "int64_t vk_scale(double*, double, int64_t);\n"
+    "int64_t vk_mat4(double*, const double*, int64_t);\n"
+    "int64_t vk_quat(double*, const double*, int64_t);\n"
+    "static double sc_dot(double* acc, const double* step, const double* w, int64_t n, int count) {\n"
+    "    double s = 0.0;\n"
+    "    for (int64_t i = 0; i < n; i++) {\n"
+    "        for (int k = 0; k < (count + 1) / 2 * 2; k++) acc[k] = acc[k] + step[k];\n"
+    "        double even = 0.0, odd = 0.0, d;\n"
+    "        if (count >= 2) { even = acc[0] * w[0]; odd = acc[1] * w[1]; }\n"
+    "        for (int k = 2; k + 1 < count; k += 2) { even = even + acc[k] * w[k]; odd = odd + acc[k + 1] * w[k + 1]; }\n"
+    "        d = count >= 2 ? even + odd : 0.0;\n"
+    "        if (count % 2) d = d + acc[count - 1] * w[count - 1];\n"
+    "        s = s + d;\n"
+    "    }\n"
+    "    return s;\n"
+    "}\n"
+    "static double sc_dot4(double* acc, const double* step, const double* w, int64_t n) { return sc_dot(acc, step, w, n, 4); }\n"
+    "static double sc_dot3(double* acc, const double* step, const double* w, int64_t n) { return sc_dot(acc, step, w, n, 3); }\n"
+    "static int64_t sc_mix(double* acc, double* t, const double* a, const double* b, int64_t n) {\n"
+    "    for (int64_t i = 0; i < n; i++) for (int k = 0; k < 6; k++) { t[k] = (a[k] - b[k]) / b[k]; acc[k] = acc[k] + t[k]; }\n"
+    "    return 0;\n"
+    "}\n"
+    "static int64_t sc_scale(double* v, double s, int64_t n) {\n"
+    "    for (int64_t i = 0; i < n; i++) for (int k = 0; k < 8; k++) v[k] = v[k] * s;\n"
+    "    return 0;\n"
+    "}\n"
+    "static int64_t sc_mat4(double* m, const double* r, int64_t n) {\n"
+    "    double c[16];\n"
+    "    for (int64_t i = 0; i < n; i++) {\n"
+    "        for (int j = 0; j < 4; j++) for (int row = 0; row < 4; row++) {\n"
+    "            double x = m[row] * r[4 * j];\n"
+    "            for (int k = 1; k < 4; k++) x = x + m[4 * k + row] * r[4 * j + k];\n"
+    "            c[4 * j + row] = x;\n"
+    "        }\n"
+    "        memcpy(m, c, sizeof(c));\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n"
+    "static int64_t sc_quat(double* q, const double* r, int64_t n) {\n"
+    "    for (int64_t i = 0; i < n; i++) for (int j = 0; j < 4; j++, q += 4) {\n"
+    "        double aw = q[0], ax = q[1], ay = q[2], az = q[3], bw = r[0], bx = r[1], by = r[2], bz = r[3];\n"
+    "        q[0] = (aw * bw + -bx * ax) + (-bz * az - by * ay);\n"
+    "        q[1] = (ax * bw + bx * aw) + (bz * ay - by * az);\n"
+    "        q[2] = (ay * bw + by * aw) + (-bz * ax - -bx * az);\n"
+    "        q[3] = (az * bw + by * ax) + (bz * aw - bx * ay);\n"
+    "        if (j == 3) q -= 16;\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n"
+    "static double now(void) { struct timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec * 1e-9; }\n"
+    "static _Alignas(16) double x[2][16], y[16], z[16], u[16], t[2][16];\n"
+    "static void setup(void) {\n"
+    "    memset(x, 0, sizeof(x));\n"
+    "    for (int k = 0; k < 16; k++) { y[k] = 0.001 * (k + 1); z[k] = 1.0 + 0.25 * k; u[k] = 2.0 - 0.0625 * k; }\n"
+    "}\n"
+    "static void init_rotation(void) {\n"
+    "    // x[]はz軸まわりの回転、yは単位行列から回す（列優先）\n"
+    "    memset(x, 0, sizeof(x));\n"
+    "    double c = 0.99995000041666526, s = 0.0099998333341666645;\n"
+    "    for (int v = 0; v < 2; v++) { x[v][0] = 1; x[v][5] = 1; x[v][10] = 1; x[v][15] = 1; }\n"
+    "    memset(y, 0, sizeof(y)); y[0] = c; y[1] = s; y[4] = -s; y[5] = c; y[10] = 1; y[15] = 1;\n"
+    "}\n"
+    "static void init_quaternion(void) {\n"
+    "    memset(x, 0, sizeof(x));\n"
+    "    for (int v = 0; v < 2; v++) for (int k = 0; k < 16; k++) x[v][k] = (k % 4 == k / 4) ? 1.0 : 0.0;\n"
+    "    y[0] = 0.99995000041666526; y[1] = 0.0099998333341666645 * 0.6; y[2] = 0.0; y[3] = 0.0099998333341666645 * 0.8;\n"
+    "}\n"
+    "#define TIME(label, init, call_packed, call_scalar, lanes) do { double best[2] = { 1e9, 1e9 }; double r[2] = { 0, 0 }; \\\n"
+    "    for (int k = 0; k < 3; k++) { init; double t0 = now(); r[0] = (double)(call_packed); double t1 = now(); \\\n"
+    "        r[1] = (double)(call_scalar); double t2 = now(); \\\n"
+    "        if (t1 - t0 < best[0]) best[0] = t1 - t0; if (t2 - t1 < best[1]) best[1] = t2 - t1; } \\\n"
+    "    if (memcmp(&r[0], &r[1], sizeof(double)) != 0 || memcmp(x[0], x[1], (lanes) * sizeof(double)) != 0) { \\\n"
+    "        fprintf(stderr, \"%s mismatch: %.17g %.17g / %.17g %.17g\\n\", label, r[0], r[1], x[0][0], x[1][0]); return 1; } \\\n"
+    "    printf(\"%s %.3f %.3f\\n\", label, best[0] * 1e3, best[1] * 1e3); } while (0)\n"
+    "int main(void) {\n"
+    "    const int64_t n = 10000000;\n"
+    "    TIME(\"dot4\", setup(), vk_dot4(x[0], y, z, n), sc_dot4(x[1], y, z, n), 4);\n"
+    "    TIME(\"dot3\", setup(), vk_dot3(x[0], y, z, n), sc_dot3(x[1], y, z, n), 3);\n"
+    "    TIME(\"mix\", setup(), vk_mix(x[0], t[0], z, u, n), sc_mix(x[1], t[1], z, u, n), 6);\n"
+    "    TIME(\"scale\", (setup(), memcpy(x[0], z, sizeof(z)), memcpy(x[1], z, sizeof(z))), \\\n"
+    "         vk_scale(x[0], 0.9999999, n), sc_scale(x[1], 0.9999999, n), 8);\n"
+    "    TIME(\"mat4\", init_rotation(), vk_mat4(x[0], y, n), sc_mat4(x[1], y, n), 16);\n"
+    "    TIME(\"quat\", init_quaternion(), vk_quat(x[0], y, n), sc_quat(x[1], y, n), 16);\n"
+    "    return 0;\n"
+    "}\n";
+
+typedef struct {
+    size_t ir_instructions;
+    size_t instructions;
+    double packed_ms;
+    double scalar_ms;
+    bool timed;
+} Result;
+
+static bool write_file(const char* path, const char* text) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return false;
+    fputs(text, file);
+    return fclose(file) == 0;
+}
+
+static bool run_driver(const char* directory, Result* results) {
+    char driver[256], program[320], assembly[256], command[1200];
+    snprintf(driver, sizeof(driver), "%s/driver.c", directory);
+    snprintf(assembly, sizeof(assembly), "%s/kernels.s", directory);
+    snprintf(program, sizeof(program), "%s/driver", directory);
+    if (!write_file(driver, driver_source)) return true;
+
+    const char* cc = getenv("CC") ? getenv("CC") : "cc";
+    snprintf(command, sizeof(command), "%s -O2 -fno-tree-vectorize -o %s %s %s 2>&1", cc, program, driver, assembly);
+    if (system(command) != 0) {
+        fprintf(stderr, "vector_bench: could not assemble %s, reporting instruction counts only\n", assembly);
+        return true;
+    }
+
+    FILE* pipe = popen(program, "r");
+    if (pipe == NULL) return true;
+    char name[32];
+    double packed, scalar;
+    while (fscanf(pipe, "%31s %lf %lf", name, &packed, &scalar) == 3) {
+        for (size_t i = 0; i < KERNEL_COUNT; i++) {
+            if (strcmp(name, kernels[i].name) != 0) continue;
+            results[i].packed_ms = packed;
+            results[i].scalar_ms = scalar;
+            results[i].timed = true;
+        }
+    }
+    // 結果が食い違えばドライバが失敗する
+    return pclose(pipe) == 0;
+}
+
+int main(void) {
+    char directory[] = "/tmp/slang_vector_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        perror("vector_bench: mkdtemp");
+        return 1;
+    }
+    char assembly[256];
+    snprintf(assembly, sizeof(assembly), "%s/kernels.s", directory);
+    AsmWriter writer;
+    AsmWriter* out = &writer;
+    if (!asm_writer_open(out, assembly)) {
+        perror("vector_bench: open");
+        return 1;
+    }
+    asm_text(out, ".intel_syntax noprefix\n.section .text\n");
+
+    Result results[KERNEL_COUNT];
+    memset(results, 0, sizeof(results));
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        IrFunction* function = kernels[i].build();
+        if (function == NULL || function->failed) {
+            fprintf(stderr, "vector_bench: %s: building failed\n", kernels[i].name);
+            return 1;
+        }
+        asm_text(out, ".global ");
+        asm_text(out, function->name);
+        asm_text(out, "\n");
+
+        RegisterAllocation allocation;
+        X86EmitStats stats = { 0, 0 };
+        if (regalloc_run(function, &allocation) != SLANG_SUCCESS ||
+            x86_emit_function(out, function, &allocation, &stats) != SLANG_SUCCESS) {
+            fprintf(stderr, "vector_bench: %s: emission failed\n", kernels[i].name);
+            return 1;
+        }
+        results[i].ir_instructions = function->count;
+        results[i].instructions = stats.instructions;
+        regalloc_free(&allocation);
+        ir_function_destroy(function);
+    }
+    asm_text(out, ".section .note.GNU-stack,\"\",@progbits\n");
+    if (!asm_writer_close(out)) {
+        fprintf(stderr, "vector_bench: could not write %s\n", assembly);
+        return 1;
+    }
+
+    if (!run_driver(directory, results)) {
+        fprintf(stderr, "vector_bench: packed code disagrees with the scalar reference\n");
+        return 1;
+    }
+
+    printf("[");
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        const Result* r = &results[i];
+        printf("%s{\"benchmark\": \"vector_%s\", \"ir\": %zu, \"instructions\": %zu", i ? ",\n " : "",
+               kernels[i].name, r->ir_instructions, r->instructions);
+        if (r->timed) printf(", \"packed_ms\": %.2f, \"scalar_ms\": %.2f", r->packed_ms, r->scalar_ms);
+        printf("}");
+    }
+    printf("]\n");
+    return 0;
+}
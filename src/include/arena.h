@@ -0,0 +1,33 @@
+#ifndef SLANG_ARENA_H
+#define SLANG_ARENA_H
+
+#include <stddef.h>
+
+// アリーナのブロック（単方向リスト）
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+// バンプアロケータ
+// コンパイル単位ごとに1つ作成し、AST・識別子文字列・子配列をまとめて所有する。
+// 個別の解放は行わず、arena_destroyで一括して解放する。
+typedef struct {
+    ArenaBlock* head;
+    size_t block_size;
+    size_t total_allocated;
+} Arena;
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+// アリーナの関数
+Arena* arena_create(size_t block_size);
+void arena_destroy(Arena* arena);
+void arena_reset(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_memdup(Arena* arena, const void* data, size_t size);
+char* arena_strdup(Arena* arena, const char* str);
+char* arena_strndup(Arena* arena, const char* str, size_t length);
+
+#endif // SLANG_ARENA_H
@@ -0,0 +1,146 @@
+#ifndef SLANG_ASM_WRITER_H
+#define SLANG_ASM_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "elf_writer.h"
+
+// アセンブリの出力バッファ
+// 命令は書式文字列ではなく命令の種類とオペランドで受け取り、大きなメモリ上のバッファに
+// 直接文字列を組み立てる。バッファが埋まったらwrite(2)でまとめて書き出す（stdioは使わない）。
+// 出力はGASの.intel_syntax noprefix向け。
+// asm_writer_open_objectで開くと同じ呼び出しを機械語にエンコードし、ELFの.oを直接書く
+// （asm_write/asm_textのディレクティブは無視する）。asm_writer_open_memoryはファイルに書かずに
+// ELFObjectをメモリに残すだけで、JIT（jit.h）がasm_writer_elfで取り出して読み込む。
+
+#define ASM_WRITER_BUFFER_SIZE (256 * 1024)
+
+// x86-64のレジスタ番号（エンコーディング順）
+typedef enum {
+    X86_RAX, X86_RCX, X86_RDX, X86_RBX, X86_RSP, X86_RBP, X86_RSI, X86_RDI,
+    X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15
+} X86Register;
+
+typedef enum {
+#define ASM_OP(name, mnemonic) ASM_##name,
+#include "asm_ops.def"
+#undef ASM_OP
+    ASM_OP_COUNT
+} AsmOp;
+
+// 条件コード（ASM_SETE + cc、ASM_JE + cc で命令になる）
+typedef enum {
+    ASM_CC_E, ASM_CC_NE, ASM_CC_L, ASM_CC_LE, ASM_CC_G, ASM_CC_GE,
+    ASM_CC_B, ASM_CC_BE, ASM_CC_A, ASM_CC_AE, ASM_CC_P, ASM_CC_NP
+} AsmCondition;
+
+typedef enum {
+    ASM_OPERAND_NONE,
+    ASM_OPERAND_REG64,
+    ASM_OPERAND_REG32,
+    ASM_OPERAND_REG8,
+    ASM_OPERAND_XMM,
+    ASM_OPERAND_IMM,       // value
+    ASM_OPERAND_FRAME,     // qword ptr [rbp + value]
+    ASM_OPERAND_STACK,     // qword ptr [rsp + value]
+    ASM_OPERAND_BASE,      // [reg + value]（大きさは命令で決まるSSEの命令だけに使う）
+    ASM_OPERAND_GLOBAL,    // qword ptr [rip + symbol]
+    ASM_OPERAND_ADDRESS,   // [rip + symbol]（lea用）
+    ASM_OPERAND_STRING,    // [rip + str_value]（文字列リテラル）
+    ASM_OPERAND_LABEL,     // .L<symbol>_<value>（symbolがNULLなら.L<value>）
+    ASM_OPERAND_SYMBOL     // symbol
+} AsmOperandKind;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t reg;
+    int64_t value;
+    const char* symbol;
+} AsmOperand;
+
+typedef enum {
+    ASM_OUTPUT_ASSEMBLY,   // GASのテキスト（.s）
+    ASM_OUTPUT_OBJECT      // ELF64の再配置可能オブジェクト（.o）
+} AsmOutputFormat;
+
+// オブジェクト出力の状態（asm_writer.c）
+typedef struct AsmObject AsmObject;
+
+typedef struct {
+    int fd;
+    bool owns_fd;
+    char* buffer;
+    size_t length;
+    size_t capacity;
+    unsigned holds;        // asm_writer_markの入れ子（0より大きい間は書き出さずにバッファを伸ばす）
+    bool failed;
+    size_t bytes_written;
+    AsmObject* object;     // NULLならテキスト出力
+} AsmWriter;
+
+// 出力先
+bool asm_writer_init(AsmWriter* writer, int fd);
+bool asm_writer_open(AsmWriter* writer, const char* path);
+bool asm_writer_open_object(AsmWriter* writer, const char* path);
+bool asm_writer_open_memory(AsmWriter* writer);
+bool asm_writer_flush(AsmWriter* writer);
+bool asm_writer_close(AsmWriter* writer);
+// オブジェクト出力の中身（テキスト出力ならNULL。asm_writer_flushでラベルを解決してから読む）
+const ElfObject* asm_writer_elf(const AsmWriter* writer);
+
+// 取り消せる区間（mark以降の出力をrollbackで捨てるかcommitで確定する）
+size_t asm_writer_mark(AsmWriter* writer);
+void asm_writer_commit(AsmWriter* writer);
+void asm_writer_rollback(AsmWriter* writer, size_t mark);
+
+// 生のテキスト
+void asm_write(AsmWriter* writer, const char* text, size_t length);
+void asm_text(AsmWriter* writer, const char* text);
+void asm_decimal(AsmWriter* writer, int64_t value);
+
+// 命令とラベル
+void asm_emit(AsmWriter* writer, AsmOp op, AsmOperand a, AsmOperand b);
+void asm_label(AsmWriter* writer, const char* scope, uint64_t id);
+void asm_symbol(AsmWriter* writer, const char* name);
+
+// 記号とデータ（.dataの文字列リテラルstr_<index>と、初期値のビット列を持つ8バイトのグローバル変数）
+void asm_global_symbol(AsmWriter* writer, const char* name);
+// 同じ名前の定義が複数のオブジェクトにあってもよい外部記号（.weak）
+void asm_weak_symbol(AsmWriter* writer, const char* name);
+void asm_string_literal(AsmWriter* writer, size_t index, const char* text);
+void asm_global_variable(AsmWriter* writer, const char* name, int64_t value);
+// 値だけを持つ局所記号（.set name, value）
+void asm_absolute_symbol(AsmWriter* writer, const char* name, int64_t value);
+
+const char* asm_register_name(X86Register reg);
+const char* asm_mnemonic(AsmOp op);
+
+// オペランドの作成
+static inline AsmOperand asm_none(void) { return (AsmOperand){ ASM_OPERAND_NONE, 0, 0, NULL }; }
+static inline AsmOperand asm_reg(X86Register reg) { return (AsmOperand){ ASM_OPERAND_REG64, (uint8_t)reg, 0, NULL }; }
+static inline AsmOperand asm_reg32(X86Register reg) { return (AsmOperand){ ASM_OPERAND_REG32, (uint8_t)reg, 0, NULL }; }
+static inline AsmOperand asm_reg8(X86Register reg) { return (AsmOperand){ ASM_OPERAND_REG8, (uint8_t)reg, 0, NULL }; }
+static inline AsmOperand asm_xmm(unsigned reg) { return (AsmOperand){ ASM_OPERAND_XMM, (uint8_t)reg, 0, NULL }; }
+static inline AsmOperand asm_imm(int64_t value) { return (AsmOperand){ ASM_OPERAND_IMM, 0, value, NULL }; }
+static inline AsmOperand asm_frame(int64_t displacement) { return (AsmOperand){ ASM_OPERAND_FRAME, 0, displacement, NULL }; }
+static inline AsmOperand asm_stack(int64_t displacement) { return (AsmOperand){ ASM_OPERAND_STACK, 0, displacement, NULL }; }
+static inline AsmOperand asm_base(X86Register reg, int64_t displacement) { return (AsmOperand){ ASM_OPERAND_BASE, (uint8_t)reg, displacement, NULL }; }
+static inline AsmOperand asm_global(const char* symbol) { return (AsmOperand){ ASM_OPERAND_GLOBAL, 0, 0, symbol }; }
+static inline AsmOperand asm_address(const char* symbol) { return (AsmOperand){ ASM_OPERAND_ADDRESS, 0, 0, symbol }; }
+static inline AsmOperand asm_string(size_t index) { return (AsmOperand){ ASM_OPERAND_STRING, 0, (int64_t)index, NULL }; }
+static inline AsmOperand asm_label_ref(const char* scope, uint64_t id) { return (AsmOperand){ ASM_OPERAND_LABEL, 0, (int64_t)id, scope }; }
+static inline AsmOperand asm_symbol_ref(const char* name) { return (AsmOperand){ ASM_OPERAND_SYMBOL, 0, 0, name }; }
+
+static inline bool asm_is_memory(AsmOperand operand) {
+    return operand.kind == ASM_OPERAND_FRAME || operand.kind == ASM_OPERAND_STACK || operand.kind == ASM_OPERAND_BASE ||
+           operand.kind == ASM_OPERAND_GLOBAL || operand.kind == ASM_OPERAND_ADDRESS ||
+           operand.kind == ASM_OPERAND_STRING;
+}
+
+static inline void asm_emit0(AsmWriter* writer, AsmOp op) { asm_emit(writer, op, asm_none(), asm_none()); }
+static inline void asm_emit1(AsmWriter* writer, AsmOp op, AsmOperand a) { asm_emit(writer, op, a, asm_none()); }
+static inline AsmOp asm_set(AsmCondition condition) { return (AsmOp)(ASM_SETE + condition); }
+static inline AsmOp asm_jump(AsmCondition condition) { return (AsmOp)(ASM_JE + condition); }
+
+#endif // SLANG_ASM_WRITER_H
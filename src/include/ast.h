@@ -2,38 +2,37 @@
 #define AST_H
 
 #include "type_system.h"
+#include "arena.h"
 #include <stdbool.h>
 #include <stdint.h>
 
 // Type definitions
 typedef struct {
-    char* name;
+    const char* name;
     Type* type;
 } TypeDefinition;
 
 typedef struct {
-    char* name;
+    const char* name;
     Type* type;
 } Variable;
 
 typedef struct {
-    char* name;
+    const char* name;
     Type* return_type;
     Variable** parameters;
     size_t parameter_count;
     struct ASTNode* body;
-    int priority;
+    int priority;    // Function:type:priority:Nで付けた優先度（なければ0）
+    // Generic functions (fn name<T, ...>) list their type parameters; annotations
+    // that name one are the type_named_of type of that name.
+    const char** type_parameters;
+    size_t type_parameter_count;
+    bool specialization;   // monomorphized copy of a generic function (see monomorph.h)
 } Function;
 
 typedef struct {
-    Function** functions;
-    size_t function_count;
-    TypeDefinition** type_definitions;
-    size_t type_definition_count;
-} AST;
-
-typedef struct {
-    char* name;
+    const char* name;
     Type* type;
     struct ASTNode* initializer;
 } LetStatement;
@@ -53,21 +52,29 @@ typedef struct {
     struct ASTNode* callee;
     struct ASTNode** arguments;
     size_t argument_count;
+    const Type* callee_type;    // set by the type checker when the callee's type is known (see below)
 } CallExpression;
 
 typedef struct {
-    char* name;
+    const char* name;
     struct ASTNode** arguments;
     size_t argument_count;
+    const char* specialization; // set by the type checker when the call uses a specialized copy
+    // Set by the type checker when the callee's signature is known: a type table
+    // function type whose parameter and return types may be NULL (dynamic), so
+    // code generation can pass each argument the way the callee receives it.
+    const Type* callee_type;
+    int log_level;              // set by the type checker for the log macros (log!, info!, ...): the LogLevel, else -1
+    int math_builtin;           // set by the type checker for the math builtins (vec3, dot, ...): the MathBuiltin, else -1
 } FunctionCall;
 
 typedef struct {
-    char* name;
+    const char* name;
     struct ASTNode* value;
 } Assignment;
 
 typedef struct {
-    char* name;
+    const char* name;
 } VariableReference;
 
 typedef struct {
@@ -88,12 +95,12 @@ typedef struct {
 
 typedef struct {
     struct ASTNode* left;
-    char* operator;
+    const char* operator;
     struct ASTNode* right;
 } BinaryExpression;
 
 typedef struct {
-    char* operator;
+    const char* operator;
     struct ASTNode* right;
 } UnaryExpression;
 
@@ -106,6 +113,10 @@ typedef struct {
     size_t statement_count;
 } BlockStatement;
 
+typedef struct {
+    struct ASTNode* value;
+} ReturnStatement;
+
 typedef struct ASTNode {
     enum {
         NODE_VARIABLE,
@@ -124,7 +135,8 @@ typedef struct ASTNode {
         NODE_BINARY_EXPRESSION,
         NODE_UNARY_EXPRESSION,
         NODE_EXPRESSION_STATEMENT,
-        NODE_BLOCK_STATEMENT
+        NODE_BLOCK_STATEMENT,
+        NODE_RETURN_STATEMENT
     } type;
     union {
         Variable variable;
@@ -144,33 +156,50 @@ typedef struct ASTNode {
         UnaryExpression unary_expression;
         ExpressionStatement expression_statement;
         BlockStatement block_statement;
+        ReturnStatement return_statement;
     } data;
+    // Type table type the type checker inferred for an expression node (NULL when
+    // it is dynamic or the node was not checked). Code generation reads it to
+    // keep floats in XMM registers.
+    const Type* resolved_type;
+    // Source position of the token the node starts at (1-based, as in Token).
+    // Line 0 means unknown: nodes rebuilt by flat_ast_expand carry no position.
+    uint32_t line;
+    uint16_t column;
 } ASTNode;
 
 // Function declarations
-AST* create_ast(void);
-void free_ast(AST* ast);
-void ast_add_function(AST* ast, Function* function);
-void ast_add_type_definition(AST* ast, TypeDefinition* type_def);
-
-ASTNode* create_variable_node(const char* name, Type* type);
-ASTNode* create_function_node(const char* name, Type* return_type, Variable** parameters, size_t parameter_count, ASTNode* body);
-ASTNode* create_let_statement_node(const char* name, Type* type, ASTNode* initializer);
-ASTNode* create_if_statement_node(ASTNode* condition, ASTNode* then_branch, ASTNode* else_branch);
-ASTNode* create_while_statement_node(ASTNode* condition, ASTNode* body);
-ASTNode* create_call_expression_node(ASTNode* callee, ASTNode** arguments, size_t argument_count);
-ASTNode* create_function_call_node(const char* name, ASTNode** arguments, size_t argument_count);
-ASTNode* create_assignment_node(const char* name, ASTNode* value);
-ASTNode* create_variable_reference_node(const char* name);
-ASTNode* create_integer_literal_node(int64_t value);
-ASTNode* create_float_literal_node(double value);
-ASTNode* create_string_literal_node(const char* value);
-ASTNode* create_boolean_literal_node(bool value);
-ASTNode* create_binary_expression_node(ASTNode* left, const char* operator, ASTNode* right);
-ASTNode* create_unary_expression_node(const char* operator, ASTNode* right);
-ASTNode* create_expression_statement_node(ASTNode* expression);
-ASTNode* create_block_statement_node(ASTNode** statements, size_t statement_count);
-
-void free_ast_node(ASTNode* node);
+// Nodes, literal strings and child arrays are allocated from the arena passed
+// to the create_*_node helpers and are released together by arena_destroy.
+// Names and operators are interned handles (see intern.h) and compare by pointer.
+ASTNode* create_variable_node(Arena* arena, const char* name, Type* type);
+ASTNode* create_function_node(Arena* arena, const char* name, Type* return_type, Variable** parameters, size_t parameter_count, ASTNode* body);
+ASTNode* create_let_statement_node(Arena* arena, const char* name, Type* type, ASTNode* initializer);
+ASTNode* create_if_statement_node(Arena* arena, ASTNode* condition, ASTNode* then_branch, ASTNode* else_branch);
+ASTNode* create_while_statement_node(Arena* arena, ASTNode* condition, ASTNode* body);
+ASTNode* create_call_expression_node(Arena* arena, ASTNode* callee, ASTNode** arguments, size_t argument_count);
+ASTNode* create_function_call_node(Arena* arena, const char* name, ASTNode** arguments, size_t argument_count);
+ASTNode* create_assignment_node(Arena* arena, const char* name, ASTNode* value);
+ASTNode* create_variable_reference_node(Arena* arena, const char* name);
+ASTNode* create_integer_literal_node(Arena* arena, int64_t value);
+ASTNode* create_float_literal_node(Arena* arena, double value);
+ASTNode* create_string_literal_node(Arena* arena, const char* value);
+ASTNode* create_boolean_literal_node(Arena* arena, bool value);
+ASTNode* create_binary_expression_node(Arena* arena, ASTNode* left, const char* operator, ASTNode* right);
+ASTNode* create_unary_expression_node(Arena* arena, const char* operator, ASTNode* right);
+ASTNode* create_expression_statement_node(Arena* arena, ASTNode* expression);
+ASTNode* create_block_statement_node(Arena* arena, ASTNode** statements, size_t statement_count);
+ASTNode* create_return_statement_node(Arena* arena, ASTNode* value);
+
+// Name a diagnostic about node should quote: the variable, function or callee
+// name, or the operator of a unary or binary expression. NULL when it has none.
+const char* ast_node_name(const ASTNode* node);
+
+// Number of nodes reachable from node (NULL children are skipped).
+size_t ast_count_nodes(const ASTNode* node);
+
+// Deep copy of node into arena. Annotations equal to from[i] become to[i]
+// (pointer comparison, so both sides are type table types).
+ASTNode* ast_clone(Arena* arena, const ASTNode* node, const Type* const* from, const Type* const* to, size_t count);
 
 #endif // AST_H 
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef SLANG_BUILD_CACHE_H
+#define SLANG_BUILD_CACHE_H
+
+#include "common.h"
+#include "symbol_table.h"
+
+// インクリメンタルビルドのキャッシュ
+// コンパイル単位（ソースファイル1つ）ごとに、内容のハッシュ・コンパイラの版と実行ファイルの内容・出力に影響するフラグ・
+// useした単位のキーからキーを求め、出力（.oか.s）をキャッシュのディレクトリに<キー><拡張子>として置く。
+// 依存先のキーを含めるので、変更した単位とそれを（間接的にでも）useする単位だけキーが変わる。
+// useが循環していれば、強連結成分の全員の内容をまとめて1つのキーにする。
+//
+// use宣言は「use a.b.c;」（a/b/c.slかa/b/c.sls）と「use "path";」で、使う側のファイルからの相対パス。
+// 各ソースのパス・更新時刻・大きさ・内容のハッシュ・依存先をディレクトリのindexに記録しておき、
+// 時刻と大きさが変わっていなければ、ソースを読まず字句解析もせずに記録を使う。
+
+#define SLANG_VERSION "0.1.0"
+#define BUILD_CACHE_DEFAULT_DIRECTORY ".slang-cache"
+#define BUILD_CACHE_INDEX_NAME "index"
+
+// 単位（ソースファイル）
+typedef struct {
+    const char* path;          // インターンされたパス
+    int64_t mtime_ns;
+    uint64_t size;
+    uint64_t source_hash;      // 内容のハッシュ（ファイルがなければ0）
+    const char** dependencies; // useした単位のインターンされたパス
+    size_t dependency_count;
+    bool refreshed;            // このプロセスでファイルと照合した
+    bool missing;
+    uint64_t key;
+    bool has_key;
+    uint32_t component;        // 強連結成分の番号（依存先ほど小さい）
+    uint32_t tarjan_index;     // 強連結成分を求めるときの番号（未訪問は0）
+    uint32_t tarjan_low;
+    bool on_stack;
+} BuildUnit;
+
+typedef struct {
+    char* directory;           // NULLならメモリの上だけ
+    uint64_t flags_hash;       // 版・コンパイラの実行ファイルの内容・フラグのハッシュ
+    SymbolTable paths;         // slotはunitsの番号
+    BuildUnit* units;
+    size_t unit_count;
+    size_t unit_capacity;
+    bool dirty;                // indexを書き直す必要がある
+    size_t component_count;    // キーを求めた強連結成分の数（依存先の成分ほど先に数える）
+    uint32_t tarjan_counter;
+    uint32_t* tarjan_stack;
+    size_t tarjan_depth;
+    size_t tarjan_capacity;
+    size_t scanned_count;      // 読み直して字句解析した単位の数
+} BuildCache;
+
+// flagsは出力に影響するオプションを並べた文字列（版と一緒にキーに入る）
+// directoryがNULLならメモリの上だけで依存関係とキーを求める（indexも出力も読み書きしない）
+BuildCache* build_cache_open(const char* directory, const char* flags);
+// indexを書いて閉じる
+SlangError build_cache_close(BuildCache* cache);
+
+// 単位のキー（依存先も必要なだけ読み直す）
+SlangError build_cache_key(BuildCache* cache, const char* path, uint64_t* key);
+// 単位の記録（build_cache_keyの後なら依存先も照合済み。知らないパスならNULL）
+const BuildUnit* build_cache_unit(const BuildCache* cache, const char* path);
+// 照合・キー・強連結成分を忘れる（記録は残す）。同じキャッシュを何度も使うサーバーが要求ごとに呼ぶと、
+// 次のbuild_cache_keyは時刻か大きさの変わったファイルだけを読み直す
+void build_cache_rescan(BuildCache* cache);
+
+// キャッシュにあれば出力の場所へ写してtrueを返す
+bool build_cache_fetch(BuildCache* cache, uint64_t key, const char* extension, const char* output_path);
+// 出力をキャッシュに入れる（一時ファイルに書いてから名前を変える）
+SlangError build_cache_store(BuildCache* cache, uint64_t key, const char* extension, const char* output_path);
+
+// 内容のハッシュ（8バイトずつ混ぜる）
+uint64_t build_cache_hash(const void* data, size_t length, uint64_t seed);
+
+#endif // SLANG_BUILD_CACHE_H
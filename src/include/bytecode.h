@@ -0,0 +1,148 @@
+#ifndef SLANG_BYTECODE_H
+#define SLANG_BYTECODE_H
+
+#include "common.h"
+#include "ast.h"
+#include "symbol_table.h"
+#include <stdio.h>
+
+// レジスタ型バイトコード
+// ASTNodeを関数単位でコンパイルする。ローカル変数はコンパイル時にフレーム内の
+// レジスタ番号へ、グローバル変数はスロット番号へ解決されるので、実行時に名前は引かない。
+
+// 値の種類
+typedef enum {
+    VALUE_NIL,
+    VALUE_BOOL,
+    VALUE_INT,
+    VALUE_FLOAT,
+    VALUE_STRING,
+    VALUE_FUNCTION,
+    VALUE_NATIVE
+} ValueType;
+
+// 値（タグ付き共用体、16バイト）
+typedef struct {
+    uint8_t type;
+    union {
+        bool boolean;
+        int64_t integer;
+        double number;
+        const char* string;  // ASTと同じアリーナが所有する
+        uint32_t function;   // BytecodeProgram内の関数または組み込み関数の番号
+    } as;
+} Value;
+
+static inline Value value_nil(void) { Value v; v.type = VALUE_NIL; v.as.integer = 0; return v; }
+static inline Value value_bool(bool b) { Value v; v.type = VALUE_BOOL; v.as.integer = 0; v.as.boolean = b; return v; }
+static inline Value value_int(int64_t i) { Value v; v.type = VALUE_INT; v.as.integer = i; return v; }
+static inline Value value_float(double d) { Value v; v.type = VALUE_FLOAT; v.as.number = d; return v; }
+static inline Value value_string(const char* s) { Value v; v.type = VALUE_STRING; v.as.string = s; return v; }
+
+// 組み込み関数
+typedef Value (*NativeFunction)(const Value* args, size_t count);
+
+// 命令
+typedef enum {
+#define OPCODE(name, format) OP_##name,
+#include "opcodes.def"
+#undef OPCODE
+    OP_COUNT
+} OpCode;
+
+// 命令の符号化（32ビット: op 8 | A 8 | B 8 | C 8、またはop 8 | A 8 | Bx 16）
+#define BC_MAX_REGISTERS 250
+#define BC_MAX_BX 0xFFFF
+#define BC_SBX_BIAS 0x7FFF
+#define BC_SC_BIAS 0x80
+#define BC_SC_MIN (-BC_SC_BIAS)
+#define BC_SC_MAX (0xFF - BC_SC_BIAS)
+
+#define BC_ENCODE_ABC(op, a, b, c) \
+    ((uint32_t)(op) | ((uint32_t)(a) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 24))
+#define BC_ENCODE_ABX(op, a, bx) \
+    ((uint32_t)(op) | ((uint32_t)(a) << 8) | ((uint32_t)(bx) << 16))
+#define BC_ENCODE_ASBX(op, a, sbx) BC_ENCODE_ABX(op, a, (uint32_t)((sbx) + BC_SBX_BIAS))
+
+#define BC_OP(i) ((i) & 0xFF)
+#define BC_A(i) (((i) >> 8) & 0xFF)
+#define BC_B(i) (((i) >> 16) & 0xFF)
+#define BC_C(i) ((i) >> 24)
+#define BC_BX(i) ((i) >> 16)
+#define BC_SBX(i) ((int32_t)BC_BX(i) - BC_SBX_BIAS)
+#define BC_SC(i) ((int32_t)BC_C(i) - BC_SC_BIAS)
+
+// 関数の実行の段階（jit.h）
+typedef enum {
+    BYTECODE_TIER_INTERPRETED,   // 呼び出しと後ろ向きのジャンプを数えている
+    BYTECODE_TIER_NATIVE,        // 機械語にコンパイルした（nativeから呼ぶ）
+    BYTECODE_TIER_REJECTED       // JITで扱えない、または脱出が続いたので解釈し続ける
+} BytecodeTier;
+
+// コンパイル済みの関数
+typedef struct {
+    const char* name;            // インターンされた名前（スクリプト本体はNULL）
+    const ASTNode* source;       // 元の関数ノード（未コンパイルの間も保持する）
+    uint32_t* code;
+    size_t code_count;
+    size_t code_capacity;
+    Value* constants;
+    size_t constant_count;
+    size_t constant_capacity;
+    uint8_t arity;
+    uint8_t register_count;      // フレームが必要とするレジスタ数
+    bool compiled;
+    int priority;                // 優先度（スケジューラに投入するときの段階の元）
+    uint8_t tier;                // BytecodeTier
+    uint8_t native_result;       // 機械語の戻り値の種類（ValueType）
+    uint32_t hotness;            // 呼び出しと後ろ向きのジャンプの回数
+    uint32_t bailouts;           // 機械語から解釈に戻った回数
+    void* native;                // tierがBYTECODE_TIER_NATIVEのときの入口
+} BytecodeFunction;
+
+// プログラム全体（関数・グローバル変数・組み込み関数）
+typedef struct {
+    BytecodeFunction** functions;
+    size_t function_count;
+    size_t function_capacity;
+    Value* globals;
+    size_t global_count;
+    size_t global_capacity;
+    NativeFunction* natives;
+    size_t native_count;
+    size_t native_capacity;
+    SymbolTable function_index;   // 名前 -> functions / natives の番号（組み込みは最上位ビットが立つ）
+    SymbolTable global_index;     // 名前 -> globals の番号
+    const char* error;            // 最後のコンパイルエラー
+    int log_threshold;            // これより低い段階のlog!などの文は呼び出しごと消す（0なら消さない）
+} BytecodeProgram;
+
+#define BC_NATIVE_FLAG 0x80000000u
+
+// プログラムの関数
+BytecodeProgram* bytecode_program_create(void);
+void bytecode_program_destroy(BytecodeProgram* program);
+bool bytecode_declare_global(BytecodeProgram* program, const char* name, uint32_t* slot);
+bool bytecode_find_global(const BytecodeProgram* program, const char* name, uint32_t* slot);
+bool bytecode_declare_native(BytecodeProgram* program, const char* name, NativeFunction function);
+SlangError bytecode_declare_function(BytecodeProgram* program, const char* name, const ASTNode* node, uint32_t* index);
+BytecodeFunction* bytecode_find_function(const BytecodeProgram* program, const char* name);
+
+// コンパイル
+// 宣言済みで未コンパイルの関数をすべてコンパイルする
+SlangError bytecode_compile_pending(BytecodeProgram* program);
+// 文の並び（スクリプト本体）を引数なしの関数にコンパイルする。呼び出し側がbytecode_function_destroyで解放する
+SlangError bytecode_compile_script(BytecodeProgram* program, ASTNode* const* statements, size_t count, BytecodeFunction** script);
+// 式を、その値を返す引数なしの関数にコンパイルする
+SlangError bytecode_compile_expression(BytecodeProgram* program, const ASTNode* expression, BytecodeFunction** script);
+void bytecode_function_destroy(BytecodeFunction* function);
+
+// 値の関数
+bool value_is_truthy(Value value);
+bool value_equals(Value a, Value b);
+void value_print(FILE* out, Value value);
+
+// デバッグ用の逆アセンブル
+void bytecode_disassemble(FILE* out, const BytecodeFunction* function);
+
+#endif // SLANG_BYTECODE_H
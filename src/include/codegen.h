@@ -4,19 +4,45 @@
 #include "ast.h"
 #include "type_system.h"
 #include "common.h"
+#include "vector.h"
+#include "symbol_table.h"
+#include "resolver.h"
+#include "asm_writer.h"
+#include "ir.h"
+#include "optimizer.h"
+#include "regalloc.h"
+#include "thread_pool.h"
 
 // コード生成のコンテキスト
 typedef struct {
     const char* output_path;
-    FILE* output_file;
+    AsmWriter writer;              // 出力バッファ（codegen_generateの最後に書き出す）
     Vector* string_literals;
-    Vector* global_variables;
-    Vector* functions;
-    size_t label_counter;
+    SymbolTable global_variables;  // 名前 -> 宣言順の番号（resolve_programが登録する）
+    SymbolTable functions;         // 名前 -> 最上位の文の並びの中の位置
+    Resolver resolver;             // スタックマシン方式で出力中の関数のローカル変数
+    bool float_return;             // スタックマシン方式で出力中の関数の戻り値がfloat（xmm0で返す）
+    int64_t* global_values;        // global_variablesと同じ順の初期値（floatはビット列）
+    const char* error;             // SLANG_ERROR_TYPEで失敗した理由
+    const ASTNode* error_node;
+    size_t label_counter;          // .L<番号>のラベルの次の番号
+    Optimizer optimizer;
+    IrFunction** module;           // 最上位の文の並びの中の位置 -> 最適化したIR（変換できない関数はNULL）
+    size_t module_count;
+    RegisterAllocation* allocations; // moduleと同じ位置のレジスタ割り当て
+    bool* allocated;               // 割り当てに成功した
+    ThreadPool* pool;              // 関数ごとの最適化とレジスタ割り当てを並列に行う（NULLなら順に行う）
 } CodeGenContext;
 
 // コード生成の関数
-CodeGenContext* codegen_create(const char* output_path);
+// optionsがNULLなら既定の最適化レベルを使う。ASTの変換と出力は宣言の順に1つのスレッドで行い、
+// その間の関数ごとの最適化とレジスタ割り当てだけをpoolで並列に行うので、出力はスレッド数によらない
+// astはparser_parseの返す最上位の文の並び（NODE_BLOCK_STATEMENT）で、出力するのは関数だけ
+// （最上位のletは初期化式を畳み込んだ定数を.dataに置いたグローバル変数になり、定数でない初期化式は
+// SLANG_ERROR_TYPEでerrorとerror_nodeに理由を残す）。ASTは読むだけなので、複数の単位が同じ関数の
+// ノードを共有していてもよい
+CodeGenContext* codegen_create(const char* output_path, AsmOutputFormat format, const OptOptions* options,
+                               ThreadPool* pool);
 void codegen_destroy(CodeGenContext* context);
 SlangError codegen_generate(CodeGenContext* context, ASTNode* ast);
 
@@ -13,21 +13,8 @@ typedef enum {
     SLANG_ERROR_PARSER = 2,
     SLANG_ERROR_TYPE = 3,
     SLANG_ERROR_RUNTIME = 4,
-    SLANG_ERROR_INTERNAL = 5
+    SLANG_ERROR_INTERNAL = 5,
+    SLANG_ERROR_IO = 6
 } SlangError;
 
-// 動的配列の実装
-typedef struct {
-    void* data;
-    size_t size;
-    size_t capacity;
-    size_t element_size;
-} Vector;
-
-Vector* vector_create(size_t element_size);
-void vector_destroy(Vector* vec);
-bool vector_push(Vector* vec, const void* element);
-void* vector_get(const Vector* vec, size_t index);
-size_t vector_size(const Vector* vec);
-
 #endif // SLANG_COMMON_H 
\ No newline at end of file
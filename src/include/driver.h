@@ -0,0 +1,112 @@
+#ifndef SLANG_DRIVER_H
+#define SLANG_DRIVER_H
+
+#include "common.h"
+#include "ast.h"
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+#include "source.h"
+#include "asm_writer.h"
+#include "optimizer.h"
+#include "type_checker.h"
+#include "monomorph.h"
+#include "build_cache.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+// 複数ファイルのコンパイル
+// 指定したファイルとそこからuseで辿れるファイルをすべてコンパイルし、それぞれ<パス>.o（-Sなら.s）を書く。
+// スレッドプールの上で、字句解析と構文解析はファイルごとに、型検査はuseの強連結成分ごとに（依存先の成分の
+// 検査が終わりしだい）、コード生成はファイルごとに（その中の最適化とレジスタ割り当ては関数ごとに）並列に行う。
+// 字句解析器・構文解析器・コード生成のコンテキスト・エラーの並びはすべて仕事ごとに作る。仕事の間で共有するのは
+// インターン表と型の表（どちらも複数のスレッドから引いてよい）と、成分の検査が公開する型だけ。
+// エラーはすべての仕事が終わってからファイルの順に報告するので、出力はスレッド数によらない。
+// 汎用関数の特殊化はビルド全体で1つのMonoCacheで共有して1回だけ検査し、成分が使った特殊化を
+// その成分の出力する全ての単位の最後の関数として（weakの記号で）出力する。
+//
+// プロジェクトのマニフェストは1行に1つのソースのパス（マニフェストのあるディレクトリからの相対パス）で、
+// 空行と#で始まる行は読み飛ばす。
+//
+// traceを渡すと、単位ごとの読み込み・字句解析・構文解析、成分ごとの型検査、単位ごとのコード生成を区間として
+// 記録する（最適化のパスはoptions.traceに記録する）。
+
+typedef struct {
+    AsmOutputFormat format;
+    OptOptions options;
+    const char* cache_dir;     // NULLならキャッシュを使わない
+    size_t threads;            // 呼び出し元を含めたスレッド数（0ならCPUの数）
+    Trace* trace;              // NULLなら計測しない
+} DriverOptions;
+
+typedef struct Driver Driver;
+
+// コンパイル単位（ソースファイル1つ）
+typedef struct {
+    Driver* driver;
+    const char* path;          // インターンされたパス
+    char* output_path;
+    uint64_t key;
+    size_t component;
+    bool needs_output;         // キャッシュになかった
+    bool needs_parse;          // 出力するか、出力する単位の検査に型が要る
+
+    // 仕事ごとの状態
+    SourceFile* source;
+    Arena* arena;
+    Lexer* lexer;
+    Parser* parser;            // 構文エラーの並びも持つ
+    ASTNode* ast;
+    SlangError error;
+    const char* message;       // コード生成の失敗の理由（定数でないグローバル変数の初期化式など）
+    const ASTNode* error_node;
+} DriverUnit;
+
+// useの強連結成分（依存先の成分ほど番号が小さい）
+typedef struct {
+    Driver* driver;
+    size_t* members;           // unitsの番号
+    size_t member_count;
+    size_t* dependencies;      // 成分の番号
+    size_t dependency_count;
+    size_t* dependents;
+    size_t dependent_count;
+    bool needs_check;
+    atomic_size_t waiting;     // 残りの構文解析と依存先の成分の検査の数
+
+    // 検査の結果（公開する関数とグローバル変数の型。すべて型の表の型）
+    SlangError error;
+    bool blocked;              // 依存先か構文解析が失敗したので検査しなかった
+    const char* message;
+    TypeErrorSite site;
+    size_t error_unit;         // エラーを報告する単位（unitsの番号）
+    TypeSignature* exports;
+    size_t export_count;
+    TypeBinding* globals;
+    size_t global_count;
+} DriverComponent;
+
+struct Driver {
+    DriverOptions options;
+    ThreadPool* pool;
+    const char** requested;    // 指定されたパス（インターンされた文字列）
+    size_t requested_count;
+    size_t requested_capacity;
+    DriverUnit* units;
+    size_t unit_count;
+    DriverComponent* components;
+    size_t component_count;
+    ThreadPoolGroup group;
+    MonoCache* specializations;
+};
+
+Driver* driver_create(const DriverOptions* options);
+void driver_destroy(Driver* driver);
+
+SlangError driver_add_file(Driver* driver, const char* path);
+SlangError driver_add_manifest(Driver* driver, const char* path);
+
+// すべての単位をコンパイルする（最初に失敗した単位のエラーを返す）
+SlangError driver_compile(Driver* driver);
+
+#endif // SLANG_DRIVER_H
@@ -0,0 +1,80 @@
+#ifndef SLANG_ELF_WRITER_H
+#define SLANG_ELF_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ELF64の再配置可能オブジェクト（x86-64）
+// .text・.dataと記号表・.rela.textだけを持つ最小限の.oを組み立てる。
+// 記号は名前で引き、定義される前に参照されたものは未定義のまま外部記号として出力する。
+
+typedef enum {
+    ELF_SECTION_UNDEFINED,
+    ELF_SECTION_TEXT,
+    ELF_SECTION_DATA,
+    ELF_SECTION_ABSOLUTE   // 値そのもの（SHN_ABS）
+} ElfSection;
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} ElfBuffer;
+
+typedef struct {
+    uint32_t name;         // 文字列表の位置
+    uint8_t section;       // ElfSection
+    bool global;
+    bool weak;             // 他のオブジェクトに同じ名前の定義があればそちらを使ってよい（globalも立つ）
+    bool function;
+    uint64_t value;
+} ElfSymbol;
+
+typedef struct {
+    uint64_t offset;       // .textの位置
+    uint32_t symbol;
+    uint32_t type;         // R_X86_64_*
+    int64_t addend;
+} ElfRelocation;
+
+// 名前の索引（ハッシュ値も持ち、違う名前は文字列を比べずに飛ばす）
+typedef struct {
+    uint32_t symbol;       // 0は空き
+    uint32_t hash;
+} ElfSymbolSlot;
+
+typedef struct {
+    ElfBuffer text;
+    ElfBuffer data;
+    ElfBuffer strings;     // .strtab（先頭は空文字列）
+    ElfSymbol* symbols;    // 0番は空の記号
+    size_t symbol_count;
+    size_t symbol_capacity;
+    ElfSymbolSlot* symbol_index;
+    size_t index_capacity;
+    ElfRelocation* relocations;
+    size_t relocation_count;
+    size_t relocation_capacity;
+    bool failed;
+} ElfObject;
+
+ElfObject* elf_object_create(void);
+void elf_object_destroy(ElfObject* object);
+
+bool elf_buffer_append(ElfBuffer* buffer, const void* data, size_t size);
+bool elf_buffer_align(ElfBuffer* buffer, size_t alignment);
+
+// 記号（なければ未定義の記号を作る）。失敗したら0
+uint32_t elf_object_symbol(ElfObject* object, const char* name);
+bool elf_object_define(ElfObject* object, uint32_t symbol, ElfSection section, uint64_t value, bool function);
+void elf_object_set_global(ElfObject* object, uint32_t symbol);
+void elf_object_set_weak(ElfObject* object, uint32_t symbol);
+bool elf_object_relocate(ElfObject* object, uint64_t offset, uint32_t symbol, uint32_t type, int64_t addend);
+
+// .textをsizeまで切り詰める（その先の記号は未定義に戻し、リロケーションは捨てる）
+void elf_object_truncate_text(ElfObject* object, size_t size);
+
+bool elf_object_write(const ElfObject* object, int fd);
+
+#endif // SLANG_ELF_WRITER_H
@@ -0,0 +1,114 @@
+#ifndef SLANG_FLAT_AST_H
+#define SLANG_FLAT_AST_H
+
+#include "common.h"
+#include "ast.h"
+#include "arena.h"
+
+// 平らなAST
+// ASTNodeの木を、ノードの種類と2つの32ビットの値（a, b）の配列に並べ直したもの。子は番号で指す。
+// ノードは後順（子が親より前）に並ぶので、番号の順に1回なめるだけで木全体を子から親へ処理でき、
+// 部分木は連続した範囲になる。3つ目以降の値と子の並びはextraに、名前と文字列リテラルはstringsに
+// （名前は1回だけ）置く。型注釈はtypesの番号で型の表の型を指す。ほかにポインタは持たないので、
+// typesを除く配列はそのまま写せばよい。
+//
+// ノードごとの値（x → {...} はextra[x]から並ぶ値）
+//   NODE_INTEGER_LITERAL, NODE_FLOAT_LITERAL  a, b = 値の下位・上位32ビット
+//   NODE_BOOLEAN_LITERAL         a = 値
+//   NODE_STRING_LITERAL          a = 文字列, b = 長さ
+//   NODE_VARIABLE_REFERENCE      a = 名前
+//   NODE_VARIABLE                a = 名前, b = 型
+//   NODE_ASSIGNMENT              a = 名前, b = 値
+//   NODE_BINARY_EXPRESSION       a = 左辺, b = 右辺
+//   NODE_UNARY_EXPRESSION        a = 被演算子
+//   NODE_EXPRESSION_STATEMENT    a = 式
+//   NODE_RETURN_STATEMENT        a = 値
+//   NODE_WHILE_STATEMENT         a = 条件, b = 本体
+//   NODE_BLOCK_STATEMENT         a = 文の並びの先頭（extraの位置）, b = 文の数
+//   NODE_LET_STATEMENT           a = 名前, b = x → {型, 初期値}
+//   NODE_IF_STATEMENT            a = 条件, b = x → {then, else}
+//   NODE_FUNCTION_CALL           a = 名前, b = x → {引数の数, 引数...}
+//   NODE_CALL_EXPRESSION         a = 呼び出し先, b = x → {引数の数, 引数...}
+//   NODE_FUNCTION                a = 本体, b = x → {名前, 戻り値の型, 優先度, 引数の数, (名前, 型)...,
+//                                                  型引数の数, 型引数の名前...}
+// ない子と型はFLAT_AST_NONE。名前と文字列はstringsの位置（NUL終端）。
+// 演算子はtagsの上位8ビット（FLAT_OPERATOR_*）。
+
+typedef uint32_t FlatNode;
+
+#define FLAT_AST_NONE UINT32_MAX
+
+#define FLAT_AST_KIND(tag) ((tag) & 0xff)
+#define FLAT_AST_OPERATOR(tag) ((tag) >> 8)
+
+typedef enum {
+    FLAT_OPERATOR_NONE,
+    FLAT_OPERATOR_ADD,
+    FLAT_OPERATOR_SUB,
+    FLAT_OPERATOR_MUL,
+    FLAT_OPERATOR_DIV,
+    FLAT_OPERATOR_MOD,
+    FLAT_OPERATOR_EQ,
+    FLAT_OPERATOR_NE,
+    FLAT_OPERATOR_LT,
+    FLAT_OPERATOR_LE,
+    FLAT_OPERATOR_GT,
+    FLAT_OPERATOR_GE,
+    FLAT_OPERATOR_AND,
+    FLAT_OPERATOR_OR,
+    FLAT_OPERATOR_NOT,
+    FLAT_OPERATOR_COUNT
+} FlatOperator;
+
+typedef struct {
+    uint16_t* tags;            // 種類 | 演算子 << 8
+    uint32_t* a;
+    uint32_t* b;
+    uint32_t node_count;
+    uint32_t node_capacity;
+
+    uint32_t* extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+
+    char* strings;
+    uint32_t string_size;
+    uint32_t string_capacity;
+
+    const Type** types;
+    uint32_t type_count;
+    uint32_t type_capacity;
+
+    FlatNode root;
+
+    // 名前（インターンされたポインタ）からstringsの位置への表（構築中の重複除去用）
+    const char** name_keys;
+    uint32_t* name_offsets;
+    uint32_t name_count;
+    uint32_t name_capacity;    // 2の冪
+} FlatAst;
+
+FlatAst* flat_ast_create(void);
+void flat_ast_destroy(FlatAst* ast);
+
+// 木をastに並べる（astは空であること）。rootはastのrootに入る
+SlangError flat_ast_build(FlatAst* ast, const ASTNode* root);
+// 木に戻す（ノード・名前・子の並びはarenaから取る）
+SlangError flat_ast_expand(const FlatAst* ast, Arena* arena, ASTNode** root);
+
+// nodeを根とする部分木の最初のノード（部分木は[first, node]）
+FlatNode flat_ast_subtree_first(const FlatAst* ast, FlatNode node);
+// 演算子の綴り（インターンされていない）
+const char* flat_ast_operator_text(FlatOperator op);
+// 使っている分の大きさ（配列の確保済みの余りは数えない）
+size_t flat_ast_memory(const FlatAst* ast);
+
+static inline int64_t flat_ast_integer(const FlatAst* ast, FlatNode node) {
+    return (int64_t)((uint64_t)ast->b[node] << 32 | ast->a[node]);
+}
+
+static inline const char* flat_ast_string(const FlatAst* ast, uint32_t offset) {
+    return ast->strings + offset;
+}
+
+#endif // SLANG_FLAT_AST_H
@@ -0,0 +1,22 @@
+#ifndef SLANG_INTERN_H
+#define SLANG_INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// 文字列インターン表
+// 同じ内容の文字列には常に同じポインタを返すので、識別子はポインタ比較で等価判定できる。
+// 返されるハンドルはintern_shutdownまで有効で、解放してはならない。
+// internは複数のスレッドから呼んでよい（intern_initとintern_shutdownはスレッドのないところで呼ぶ）。
+
+// インターン表の関数
+bool intern_init(void);
+void intern_shutdown(void);
+const char* intern(const char* str, size_t length);
+const char* intern_cstr(const char* str);
+uint32_t intern_hash(const char* handle);
+size_t intern_length(const char* handle);
+size_t intern_count(void);
+
+#endif // SLANG_INTERN_H
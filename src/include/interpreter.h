@@ -3,31 +3,51 @@
 
 #include "ast.h"
 #include "type_system.h"
+#include "bytecode.h"
+#include "jit.h"
+
+// インタプリタ
+// ASTNodeをbytecode.hのレジスタ型バイトコードにコンパイルし、ディスパッチループで実行する。
+// 文字列の値はASTのアリーナを指すので、実行結果を使い終わるまでアリーナを破棄しないこと。
+// 呼び出しと後ろ向きのジャンプがjit_thresholdに達した関数は、次の呼び出しから機械語で実行する（jit.h）。
+
+#define INTERPRETER_STACK_SIZE (64 * 1024)
+#define INTERPRETER_MAX_FRAMES 1024
+
+// 呼び出しフレーム
+typedef struct {
+    BytecodeFunction* function;
+    const uint32_t* ip;   // 呼び出し先から戻ったときの再開位置
+    Value* base;          // R[0]の位置
+} CallFrame;
 
 typedef struct {
-    struct {
-        char** keys;
-        void** values;
-        size_t count;
-        size_t capacity;
-    } variables;
-    struct {
-        char** keys;
-        ASTNode** values;
-        size_t count;
-        size_t capacity;
-    } functions;
+    BytecodeProgram* program;
+    Value* stack;
+    CallFrame* frames;
+    const char* error;    // 最後のエラー
+    Jit* jit;             // 最初に関数が熱くなったときに作る
+    unsigned jit_threshold;  // 0ならJITを使わない
 } Interpreter;
 
 // Function declarations
+// 名前はインターンしてから表に登録するので、呼び出し側はどんな文字列を渡してもよい
 Interpreter* create_interpreter(void);
 void free_interpreter(Interpreter* interpreter);
-void interpret(Interpreter* interpreter, ASTNode* node);
-void* evaluate_expression(Interpreter* interpreter, ASTNode* node);
-void execute_statement(Interpreter* interpreter, ASTNode* node);
-void declare_variable(Interpreter* interpreter, const char* name, void* value);
-void* get_variable(Interpreter* interpreter, const char* name);
-void declare_function(Interpreter* interpreter, const char* name, ASTNode* function_node);
+// 関数宣言・文・ブロックを実行する。最上位で fn main() を宣言していれば最後に呼ぶ
+SlangError interpret(Interpreter* interpreter, ASTNode* node);
+SlangError evaluate_expression(Interpreter* interpreter, ASTNode* node, Value* result);
+SlangError execute_statement(Interpreter* interpreter, ASTNode* node);
+bool declare_variable(Interpreter* interpreter, const char* name, Value value);
+bool get_variable(Interpreter* interpreter, const char* name, Value* value);
+SlangError declare_function(Interpreter* interpreter, const char* name, ASTNode* function_node);
 ASTNode* get_function(Interpreter* interpreter, const char* name);
+bool interpreter_register_native(Interpreter* interpreter, const char* name, NativeFunction function);
+SlangError interpreter_call(Interpreter* interpreter, const char* name, const Value* args, size_t count, Value* result);
+const char* interpreter_error(const Interpreter* interpreter);
+// 0でJITを止める（すでに機械語にした関数もインタプリタで実行する）
+void interpreter_set_jit_threshold(Interpreter* interpreter, unsigned threshold);
+// JITを使っていなければすべて0
+void interpreter_jit_stats(const Interpreter* interpreter, JitStats* stats);
 
-#endif // INTERPRETER_H 
\ No newline at end of file
+#endif // INTERPRETER_H
@@ -0,0 +1,153 @@
+#ifndef SLANG_IR_H
+#define SLANG_IR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// 線形IR
+// 関数ごとの三番地コードで、値は無制限の仮想レジスタに置く。ローカル変数も仮想レジスタで、
+// 代入はIR_MOVEになる（SSAではない）。物理レジスタへの割り当てはregalloc.hが行う。
+
+typedef uint32_t IrValue;
+#define IR_NO_VALUE UINT32_MAX
+
+// 値の型（GPRとXMMのどちらに置くか）
+typedef enum {
+    IR_INT,
+    IR_FLOAT
+} IrType;
+
+// 命令
+typedef enum {
+    IR_CONST,          // dest = imm
+    IR_ADDRESS,        // dest = &symbol
+    IR_PARAM,          // dest = 引数[imm.integer]
+    IR_MOVE,           // dest = a
+    IR_LOAD_GLOBAL,    // dest = [symbol]
+    IR_STORE_GLOBAL,   // [symbol] = a
+    IR_ADD,            // dest = a + b
+    IR_SUB,            // dest = a - b
+    IR_MUL,            // dest = a * b
+    IR_DIV,            // dest = a / b
+    IR_MOD,            // dest = a % b（整数のみ）
+    IR_NEG,            // dest = -a
+    IR_NOT,            // dest = !a（整数のみ）
+    IR_INT_TO_FLOAT,   // dest = (double)a（aはIR_INT、destはIR_FLOAT）
+    IR_EQ,             // dest = a == b（destは常にIR_INT）
+    IR_NE,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+    IR_LABEL,          // imm.label:
+    IR_JUMP,           // goto imm.label
+    IR_BRANCH_FALSE,   // if a == 0 goto imm.label
+    IR_CALL,           // dest = symbol(args...)（destはIR_NO_VALUEでもよい。imm.integerは借用で渡す引数のビット）
+    IR_RETURN,         // return a（aはIR_NO_VALUEでもよい）
+    // ベクトル・行列・四元数の演算（a・b・args[0]はtype_system.hの配置に従う要素列へのポインタ）
+    // 要素はdoubleで16バイト境界に置き、imm.integerは要素数（列の詰め物を含んでよい）
+    IR_VEC_ADD,        // [args[0]] = [a] + [b]（要素ごと）
+    IR_VEC_SUB,
+    IR_VEC_MUL,
+    IR_VEC_DIV,
+    IR_VEC_SCALE,      // [args[0]] = [a] * b（bはIR_FLOAT）
+    IR_VEC_COPY,       // [args[0]] = [a]
+    IR_VEC_DOT,        // dest = [a]・[b]（destはIR_FLOAT）
+    IR_MAT4_MUL,       // [args[0]] = [a] × [b]（4x4の列優先）
+    IR_QUAT_MUL,       // [args[0]] = [a] * [b]（四元数は(w, x, y, z)の順）
+    // 値の置き場所（ベクトルなどの一時領域。16バイト境界で、sizeはimm.integerバイト）
+    IR_ALLOC,          // dest = ヒープに確保したブロック（mallocの呼び出しになる）
+    IR_STACK_ALLOC,    // dest = フレームに置いた領域（同じ命令は毎回同じ領域を返す。エスケープ解析が作る）
+    IR_DROP,           // aのブロックを解放する（freeの呼び出しになる）
+    IR_LOAD,           // dest = [a + imm.integer]（ブロックの要素を1つ読む。destはIR_FLOAT）
+    IR_STORE,          // [a + imm.integer] = b（bはIR_FLOAT）
+    // 以下はSSA形式（ssa.h）の中でだけ使う
+    IR_PHI,            // dest = φ(args...)（args[i]はi番目の先行ブロックから来る値）
+    IR_NOP             // 削除された命令（ssa_compactが取り除く）
+} IrOpcode;
+
+typedef struct {
+    uint8_t op;
+    uint8_t type;          // 演算の型（比較では被演算子の型）
+    IrValue dest;
+    IrValue a;
+    IrValue b;
+    union {
+        int64_t integer;
+        double number;
+        uint32_t label;
+    } imm;
+    const char* symbol;    // インターンされた名前
+    IrValue* args;         // IR_CALLの引数、IR_PHIの入力、ベクトル演算の書き込み先
+    uint32_t arg_count;
+} IrInstruction;
+
+typedef struct {
+    const char* name;
+    IrInstruction* code;
+    size_t count;
+    size_t capacity;
+    uint8_t* value_types;  // 仮想レジスタごとの型
+    size_t value_count;
+    size_t value_capacity;
+    uint32_t label_count;
+    uint32_t param_count;
+    int priority;          // 関数の優先度（Function:type:priority:N、なければ0）
+    bool failed;           // 割り当てに失敗した（以降の命令は捨てられる）
+} IrFunction;
+
+// IRの関数
+IrFunction* ir_function_create(const char* name);
+void ir_function_destroy(IrFunction* function);
+IrValue ir_new_value(IrFunction* function, IrType type);
+uint32_t ir_new_label(IrFunction* function);
+bool ir_is_comparison(IrOpcode op);
+bool ir_is_vector(IrOpcode op);
+// 呼び出しになる命令（IR_CALL・IR_ALLOC・IR_DROP。caller-savedのレジスタを壊す）
+bool ir_is_call(IrOpcode op);
+
+// 命令の追加（結果の仮想レジスタを返す）
+IrValue ir_emit_const_int(IrFunction* function, int64_t value);
+IrValue ir_emit_const_float(IrFunction* function, double value);
+IrValue ir_emit_address(IrFunction* function, const char* symbol);
+IrValue ir_emit_param(IrFunction* function, uint32_t index, IrType type);
+void ir_emit_move(IrFunction* function, IrValue dest, IrValue src);
+IrValue ir_emit_load_global(IrFunction* function, const char* symbol, IrType type);
+void ir_emit_store_global(IrFunction* function, const char* symbol, IrValue value);
+IrValue ir_emit_binary(IrFunction* function, IrOpcode op, IrValue a, IrValue b);
+IrValue ir_emit_unary(IrFunction* function, IrOpcode op, IrValue a);
+void ir_emit_label(IrFunction* function, uint32_t label);
+void ir_emit_jump(IrFunction* function, uint32_t label);
+void ir_emit_branch_false(IrFunction* function, IrValue condition, uint32_t label);
+IrValue ir_emit_call(IrFunction* function, const char* symbol, IrType type, const IrValue* args, uint32_t arg_count);
+void ir_emit_return(IrFunction* function, IrValue value);
+IrValue ir_emit_alloc(IrFunction* function, uint32_t size);
+void ir_emit_drop(IrFunction* function, IrValue block);
+// ブロックのoffsetバイト目の要素の読み書き
+IrValue ir_emit_load(IrFunction* function, IrValue block, uint32_t offset);
+void ir_emit_store(IrFunction* function, IrValue block, uint32_t offset, IrValue value);
+
+// 直前のIR_CALLのargument番目の引数を借用にする（呼び出し先は引数を持ち続けも解放もしない）
+// コード生成は数学の型の引数に付け（呼び出し先は代入する引数だけを複製する）、エスケープ解析はそれを外へ出ない使い方とみなす
+bool ir_mark_borrowed(IrFunction* function, uint32_t argument);
+
+// ベクトル演算（dst・a・bはIR_INTのポインタ、countは要素数）
+// 書き込み先は読み込み元と同じでも一部だけ重なってはならない
+#define IR_VECTOR_MAX_ELEMENTS 64
+void ir_emit_vector_binary(IrFunction* function, IrOpcode op, IrValue dst, IrValue a, IrValue b, uint32_t count);
+void ir_emit_vector_scale(IrFunction* function, IrValue dst, IrValue a, IrValue scale, uint32_t count);
+void ir_emit_vector_copy(IrFunction* function, IrValue dst, IrValue a, uint32_t count);
+IrValue ir_emit_vector_dot(IrFunction* function, IrValue a, IrValue b, uint32_t count);
+void ir_emit_mat4_mul(IrFunction* function, IrValue dst, IrValue a, IrValue b);
+void ir_emit_quat_mul(IrFunction* function, IrValue dst, IrValue a, IrValue b);
+
+// 直前の命令の結果をdestに直接書かせる（`x = a + b`のMOVEを省く）
+// tempはまだどこからも参照されていない一時値でなければならない
+bool ir_retarget_last(IrFunction* function, IrValue temp, IrValue dest);
+
+// デバッグ用の出力
+void ir_dump(FILE* out, const IrFunction* function);
+
+#endif // SLANG_IR_H
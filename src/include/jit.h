@@ -0,0 +1,50 @@
+#ifndef SLANG_JIT_H
+#define SLANG_JIT_H
+
+#include "common.h"
+#include "bytecode.h"
+
+// 段階的なJIT（インタプリタの熱い関数をプロセスの中で機械語にする）
+// インタプリタは関数ごとに呼び出しと後ろ向きのジャンプを数え、しきい値を超えた関数を次の呼び出しで
+// jit_compileに渡す。バイトコードを線形IR（ir.h）に直し、AOTと同じ最適化・レジスタ割り当て・
+// x86_emitterを通して機械語のエンコーダでメモリ上のELFObjectに書き、実行可能なページに読み込む。
+// codegen.cのASTからの変換を使わないのは、注釈のない値の種類が型検査ではなく実行時にしか決まらず、
+// 入口の種類の確認と解釈への脱出をバイトコードの位置に結び付ける必要があるため（線形IRから先は同じ）。
+// 両方が同じ値を出すことはbench/jit_bench.cで突き合わせる。
+//
+// 扱うのは整数・真偽値・nilだけで計算する関数（引数は整数、グローバル変数と組み込み関数を使わない）で、
+// 呼び出す関数も先にコンパイルする（自分自身の再帰はよく、相互再帰は解釈に残す）。
+// どのレジスタも種類が静的に決まるので、機械語の中で種類を確かめるのは入口の引数だけになる。
+// 機械語では処理できないこと（0での除算・呼び出しの深さの超過）が起きたら呼び出し全体を捨てて
+// 解釈し直す（副作用がないので、解釈すれば同じ結果かエラーになる）。脱出が続く関数は解釈に戻す。
+
+#define JIT_DEFAULT_THRESHOLD 1000     // 呼び出しと後ろ向きのジャンプの回数
+#define JIT_MAX_ARGUMENTS 6            // レジスタ渡しの整数の引数だけ
+#define JIT_MAX_BAILOUTS 16            // これだけ解釈に戻ったら機械語を使わない
+#define JIT_CODE_SIZE ((size_t)16 << 20)   // 機械語の領域（予約するだけで、使った分だけページを割り当てる）
+
+typedef struct Jit Jit;
+
+typedef struct {
+    size_t compiled;
+    size_t rejected;           // 扱えない関数
+    size_t entries;            // インタプリタから機械語に入った回数
+    size_t bailouts;           // 機械語の途中で解釈に戻った回数
+    size_t guard_failures;     // 引数が整数でなかったので入らなかった回数
+    size_t deoptimized;        // 脱出が続いたので解釈に戻した関数
+    size_t code_bytes;
+    double compile_seconds;
+} JitStats;
+
+// x86-64のLinux以外や、領域が取れなかったときはNULL
+Jit* jit_create(BytecodeProgram* program);
+void jit_destroy(Jit* jit);
+
+// functionのtierをBYTECODE_TIER_NATIVEかBYTECODE_TIER_REJECTEDにする
+bool jit_compile(Jit* jit, BytecodeFunction* function);
+// args（function->arity個）で機械語を呼ぶ。framesは残りの呼び出しフレームの数で、これより深くなれば脱出する。
+// 種類の確かめに落ちたか脱出したらfalseを返し、呼び出し側は同じ呼び出しを解釈する
+bool jit_enter(Jit* jit, BytecodeFunction* function, const Value* args, size_t frames, Value* result);
+void jit_stats(const Jit* jit, JitStats* stats);
+
+#endif // SLANG_JIT_H
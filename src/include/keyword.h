@@ -0,0 +1,20 @@
+#ifndef SLANG_KEYWORD_H
+#define SLANG_KEYWORD_H
+
+#include "lexer.h"
+
+// キーワード認識
+// keywords.defから生成した完全ハッシュ表を引く。割り当ては行わず、
+// 1回のハッシュ計算と高々1回の比較で識別子かキーワードかを判定する。
+
+// 完全ハッシュ関数（生成器と字句解析器で共有する）
+static inline uint32_t keyword_hash(const char* text, size_t length, uint32_t k1, uint32_t k2) {
+    return (uint32_t)(unsigned char)text[0] * k1 +
+           (uint32_t)(unsigned char)text[length - 1] * k2 +
+           (uint32_t)length;
+}
+
+// キーワードなら対応するトークンの種類、そうでなければTOKEN_IDENTIFIERを返す
+TokenType keyword_lookup(const char* text, size_t length);
+
+#endif // SLANG_KEYWORD_H
@@ -2,6 +2,7 @@
 #define SLANG_LEXER_H
 
 #include "common.h"
+#include "arena.h"
 
 // トークンの種類
 typedef enum {
@@ -22,12 +23,16 @@ typedef enum {
     TOKEN_GT,        // >
     TOKEN_LE,        // <=
     TOKEN_GE,        // >=
+    TOKEN_BANG,      // !
+    TOKEN_AND,       // &&
+    TOKEN_OR,        // ||
     TOKEN_LPAREN,    // (
     TOKEN_RPAREN,    // )
     TOKEN_LBRACE,    // {
     TOKEN_RBRACE,    // }
     TOKEN_SEMICOLON, // ;
     TOKEN_COMMA,     // ,
+    TOKEN_COLON,     // :
     TOKEN_DOT,       // .
     TOKEN_ARROW,     // ->
     TOKEN_FN,        // fn
@@ -45,32 +50,81 @@ typedef enum {
     TOKEN_USE,       // use
     TOKEN_PUB,       // pub
     TOKEN_PRIV,      // priv
+    TOKEN_TRUE,      // true
+    TOKEN_FALSE,     // false
     TOKEN_ERROR
 } TokenType;
 
+// TOKEN_ERRORの種類
+typedef enum {
+    LEX_ERROR_NONE,
+    LEX_ERROR_INVALID_CHARACTER,
+    LEX_ERROR_UNTERMINATED_STRING,
+    LEX_ERROR_LONE_AMPERSAND,    // &&でない&
+    LEX_ERROR_LONE_PIPE,         // ||でない|
+    LEX_ERROR_INTEGER_TOO_LARGE  // INT64_MAXを超える整数リテラル
+} LexErrorKind;
+
 // トークンの構造体
+// ソースバッファへのスライス（オフセットと長さ）だけを持つPOD値。
+// 文字列はlexer_token_*で必要な時にだけ取り出す。行と列はトークンの先頭の位置。
 typedef struct {
-    TokenType type;
-    char* lexeme;
-    size_t line;
-    size_t column;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t line;
+    uint16_t column;
+    uint8_t type;   // TokenType
+    uint8_t error;  // TOKEN_ERRORならLexErrorKind、ほかはLEX_ERROR_NONE
 } Token;
 
+_Static_assert(sizeof(Token) <= 16, "Token must stay within 16 bytes");
+
+#define TOKEN_MAX_OFFSET UINT32_MAX
+#define TOKEN_MAX_COLUMN UINT16_MAX
+
 // 字句解析器の構造体
+// 一括モードでは全トークンを配列tokensに溜める（パーサはその配列を順に読む）。
+// ストリーミングモードではringを使い、パーサが読み進めるたびに必要な分だけ字句解析する。
 typedef struct {
     const char* source;
+    size_t length;
     size_t start;
     size_t current;
     size_t line;
     size_t column;
-    Vector* tokens;
+    size_t start_line;      // 解析中のトークンの先頭の行と列
+    size_t start_column;
+    Token* tokens;
+    size_t token_count;
+    size_t token_capacity;
+    size_t position;        // 次に返すトークンの位置（一括モード）
+    Token* ring;            // トークンのリングバッファ（ストリーミングモード）
+    size_t ring_capacity;   // 2の冪
+    size_t ring_read;
+    size_t ring_write;
+    bool finished;
+    bool failed;            // トークンの追加に失敗した（lexer_scanはSLANG_ERROR_INTERNALを返す）
 } Lexer;
 
+#define LEXER_DEFAULT_RING_CAPACITY 4096
+// パーサが保持するcurrent/previousを上書きしないために残しておくトークン数
+#define LEXER_RING_RETAIN 2
+
 // 字句解析器の関数
-Lexer* lexer_create(const char* source);
+Lexer* lexer_create(const char* source, size_t length);
+Lexer* lexer_create_streaming(const char* source, size_t length, size_t ring_capacity);
 void lexer_destroy(Lexer* lexer);
 SlangError lexer_scan(Lexer* lexer);
 Token* lexer_next_token(Lexer* lexer);
 Token* lexer_peek_token(Lexer* lexer);
 
+// トークンの文字列の取り出し
+const char* lexer_token_start(const Lexer* lexer, const Token* token);
+const char* lexer_token_intern(const Lexer* lexer, const Token* token);
+char* lexer_token_string(const Lexer* lexer, const Token* token, Arena* arena);
+int64_t lexer_token_integer(const Lexer* lexer, const Token* token);
+double lexer_token_float(const Lexer* lexer, const Token* token);
+// TOKEN_ERRORの診断メッセージ
+const char* lexer_error_message(LexErrorKind kind);
+
 #endif // SLANG_LEXER_H 
\ No newline at end of file
@@ -0,0 +1,138 @@
+#ifndef SLANG_LOGGER_H
+#define SLANG_LOGGER_H
+
+#include "common.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+// 非同期の構造化ログ（log!・info!・debug!・warn!・alert!・error!の実行時）
+// 呼び出し側は書式（文字列のアドレスがそのまま書式のIDになる）と生の引数だけを、スレッドごとのリングバッファに
+// 記録として書き、整形はしない。リングは書くスレッドと読むスレッドが1つずつなのでロックを使わない。
+// 背景のスレッドがすべてのリングを読んで整形し、まとめて出力先に書く。リングが一杯なら記録を捨てて数える
+// （呼び出し側は待たない）。同じスレッドの記録の順は保つが、スレッドをまたいだ順は保たない。
+//
+// 書式の{}は引数で順に置き換え、余った引数は空白で区切って後ろに足す。LOG以外の段階は接頭辞を付ける。
+// logger_writeの書式はロガーより長く生きること（文字列リテラルかインターンされた文字列）。
+// 実行時に作った書式はlogger_write_copiedで渡す。文字列の引数はいつも記録に写す。
+//
+// LOGGER_LOGは段階をthresholdと1回比べるだけで、LOGGER_COMPILE_LEVELより低い段階なら呼び出しごと消える。
+// 段階の順は仕様の優先所有格（[組, 順位]）の辞書順で、低い方からlog・info・debug・warn・alert・error。
+
+typedef enum {
+#define LOG_LEVEL(name, macro, class, rank) LOG_LEVEL_##name,
+#include "log_levels.def"
+#undef LOG_LEVEL
+    LOG_LEVEL_COUNT
+} LogLevel;
+
+// 優先所有格の組（[Log, n]と[Emerg, n]）
+typedef enum {
+    LOG_CLASS_LOG,
+    LOG_CLASS_EMERG
+} LogClass;
+
+#define LOG_CLASS_LEVELS 3
+
+static inline LogClass logger_level_class(LogLevel level) {
+    return (LogClass)(level / LOG_CLASS_LEVELS);
+}
+
+static inline int logger_level_rank(LogLevel level) {
+    return (int)level % LOG_CLASS_LEVELS;
+}
+
+typedef enum {
+    LOG_ARG_NIL,
+    LOG_ARG_INT,
+    LOG_ARG_FLOAT,
+    LOG_ARG_BOOL,
+    LOG_ARG_STRING
+} LogArgType;
+
+typedef struct {
+    uint8_t type;              // LogArgType
+    union {
+        int64_t integer;
+        double number;
+        bool boolean;
+        const char* string;
+    } as;
+} LogArg;
+
+#define LOG_INT(x) ((LogArg){ LOG_ARG_INT, { .integer = (x) } })
+#define LOG_FLOAT(x) ((LogArg){ LOG_ARG_FLOAT, { .number = (x) } })
+#define LOG_BOOL(x) ((LogArg){ LOG_ARG_BOOL, { .boolean = (x) } })
+#define LOG_STRING(x) ((LogArg){ LOG_ARG_STRING, { .string = (x) } })
+
+#define LOGGER_DEFAULT_RING_CAPACITY (64 * 1024)   // スレッドごとのリングの大きさ（2の冪）
+#define LOGGER_MAX_ARGS 16
+#define LOGGER_MAX_STRING 256                      // 文字列の引数はこれより長ければ切り詰める
+#define LOGGER_LINE_MAX 1024                       // 整形した1行の上限（改行を含む）
+#define LOGGER_POLL_US 1000                        // 背景のスレッドが何もないときに待つ時間
+
+typedef struct LogRing LogRing;
+
+typedef struct {
+    FILE* sink;
+    atomic_int threshold;              // これより低い段階は捨てる
+    size_t ring_capacity;
+    uint64_t generation;               // スレッドのリングがどのロガーのものかの確認用
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;               // 書き出しの要求か終了
+    pthread_cond_t drained;            // 書き出しの終わり
+    LogRing* rings;                    // 登録されたリング（lockで守る）
+    uint64_t flush_requested;
+    uint64_t flush_completed;
+    bool stopping;
+    pthread_t thread;
+
+    atomic_size_t dropped;             // リングが一杯で捨てた記録の数
+    atomic_size_t written;             // 出力先に書いた記録の数
+} Logger;
+
+// コンパイル時の下限（これより低い段階のLOGGER_LOGは消える）
+#ifndef LOGGER_COMPILE_LEVEL
+#define LOGGER_COMPILE_LEVEL LOG_LEVEL_LOG
+#endif
+
+// 段階が有効なら引数をログに書く（引数はLOG_INTなどで包む）
+#define LOGGER_LOG(logger, level, format, ...)                                                            \
+    do {                                                                                                  \
+        if ((level) >= LOGGER_COMPILE_LEVEL && logger_enabled((logger), (level))) {                       \
+            LogArg logger_args_[] = { { LOG_ARG_NIL, { 0 } }, ##__VA_ARGS__ };                            \
+            logger_write((logger), (level), (format), logger_args_ + 1,                                   \
+                         sizeof(logger_args_) / sizeof(logger_args_[0]) - 1);                             \
+        }                                                                                                 \
+    } while (0)
+
+// ring_capacityは0なら既定の大きさ（2の冪に切り上げる）。sinkはロガーより長く生きること
+Logger* logger_create(FILE* sink, LogLevel threshold, size_t ring_capacity);
+// 残りの記録を書き出してから破棄する
+void logger_destroy(Logger* logger);
+// このスレッドが呼ぶまでに書いたすべてのスレッドの記録が出力先に書かれるまで待つ
+void logger_flush(Logger* logger);
+void logger_set_threshold(Logger* logger, LogLevel threshold);
+
+static inline bool logger_enabled(const Logger* logger, LogLevel level) {
+    return (int)level >= atomic_load_explicit(&logger->threshold, memory_order_relaxed);
+}
+
+// 記録を書く（捨てたらfalse）。argsはcount個（LOGGER_MAX_ARGSまで）
+bool logger_write(Logger* logger, LogLevel level, const char* format, const LogArg* args, size_t count);
+bool logger_write_copied(Logger* logger, LogLevel level, const char* format, const LogArg* args, size_t count);
+
+// 1行に整形する（改行を含め、capacityに収まるように切り詰める。長さを返す）
+size_t logger_format(char* out, size_t capacity, LogLevel level, const char* format, const LogArg* args,
+                     size_t count);
+
+// 段階の名前（logなど）と、名前から段階（段階の名前でなければ-1）
+const char* logger_level_name(LogLevel level);
+int logger_level_of(const char* name);
+
+// 組み込みのlog!などが書くロガー（NULLなら標準出力にその場で書く）
+void logger_install(Logger* logger);
+Logger* logger_installed(void);
+
+#endif // SLANG_LOGGER_H
@@ -0,0 +1,121 @@
+#ifndef SLANG_MONOMORPH_H
+#define SLANG_MONOMORPH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "common.h"
+#include "ast.h"
+#include "arena.h"
+#include "type_checker.h"
+
+// 汎用関数（fn name<T, ...>）の特殊化のキャッシュ
+// 型検査器は引数の型がすべて分かる呼び出しで型引数を推論し、(汎用関数, 型引数の組)ごとに1つの特殊化
+// （型引数を置き換えた本体の写し）を作る。型引数は型の表の型なので、組はポインタの並びで比べられる。
+// キャッシュはビルド全体で1つ（複数のスレッドの検査器から引いてよい）で、同じ組の特殊化は
+// どの成分から呼ばれても1つになり、検査は1回だけ行う（mono_claim_checkで担当を決める）。
+// 写しの本体は検査の後は読むだけなので、使う単位がそれぞれ自分の出力に加えて並列に生成してよい。
+//
+// 汎用関数ごとの特殊化の数かビルド全体の写しのノード数が上限を超えると、特殊化を作らずNULLを返す。
+// 呼び出しは共有の本体（型引数の型を実行時に決まる型として検査したもの）を使い、値が持つ型の
+// タグが辞書の代わりになる。
+//
+// 特殊化の名前は「名前.型引数.…」（型名の識別子にならない文字は_）で、使う単位がそれぞれ写しを
+// 出力してもリンクできるようにweakで出力する（mono_is_instance_name）。
+
+#define MONO_DEFAULT_MAX_INSTANCES 32
+#define MONO_DEFAULT_BUDGET 65536
+
+typedef struct {
+    size_t max_instances;      // 汎用関数ごとの特殊化の数（0なら既定値）
+    size_t budget;             // 特殊化の本体のノード数の合計（0なら既定値）
+} MonoOptions;
+
+typedef enum {
+    MONO_PENDING,              // まだ誰も検査していない
+    MONO_CHECKING,
+    MONO_CHECKED
+} MonoState;
+
+// 汎用関数を定義した検査器の最上位の名前の型（特殊化の本体はこの中で検査する）
+typedef struct {
+    TypeSignature* signatures; // genericも写す
+    size_t signature_count;
+    TypeBinding* globals;
+    size_t global_count;
+} MonoEnvironment;
+
+typedef struct MonoInstance MonoInstance;
+
+typedef struct MonoGeneric {
+    const ASTNode* function;   // 汎用関数の宣言（キー）
+    const Type** type_parameters;  // type_named_ofの型
+    size_t type_parameter_count;
+    size_t node_count;         // 本体のノード数（写し1つの大きさ）
+    const MonoEnvironment* environment;  // mono_publishするまでNULL
+    MonoInstance* instances;   // 作った順の単方向リスト
+    size_t instance_count;
+} MonoGeneric;
+
+struct MonoInstance {
+    MonoGeneric* generic;
+    MonoInstance* next;
+    const Type** arguments;    // 型引数の型（type_parameter_count個）
+    const char* name;          // インターンされた特殊化の名前
+    ASTNode* function;         // 型引数を置き換えた写し（specializationが立ち、型引数はない）
+    const Type** parameters;   // 写しの引数の型（注釈がなければNULL）
+    const Type* return_type;
+    atomic_int state;          // MonoState
+    SlangError result;         // MONO_CHECKEDのときだけ有効
+    const char* error;
+    TypeErrorSite site;        // エラーの場所（写しの中の位置は汎用関数の宣言の位置と同じ）
+};
+
+typedef struct {
+    size_t generics;
+    size_t instances;          // 作った特殊化の数
+    size_t checks;             // 検査した特殊化の本体の数
+    size_t hits;               // 既にある特殊化を返した数
+    size_t fallbacks;          // 上限や推論できない型引数で共有の本体を使った数
+    size_t nodes;              // 写したノードの数
+} MonoStats;
+
+typedef struct MonoCache {
+    pthread_mutex_t lock;
+    pthread_cond_t checked;    // 特殊化の検査の終わり
+    Arena* arena;              // 写し・環境・特殊化はすべてここに置く
+    MonoGeneric** generics;    // オープンアドレス法（宣言のポインタで引く）
+    size_t generic_capacity;
+    MonoOptions options;
+    MonoStats stats;
+} MonoCache;
+
+// optionsはNULLでよい（既定値）。intern_initとtype_table_initの後で作る
+MonoCache* mono_cache_create(const MonoOptions* options);
+void mono_cache_destroy(MonoCache* cache);
+
+// nodesの中の汎用関数に、それを宣言したcheckerの最上位の名前の型を環境として渡す
+// （型検査の最後に呼ぶ。呼ぶまでその汎用関数の特殊化は検査できない）
+SlangError mono_publish(MonoCache* cache, const TypeChecker* checker, ASTNode* const* nodes, size_t count);
+
+// functionを引数の型argumentsで呼ぶときの特殊化（*instanceには既にあればそれ、なければ作ったもの）。
+// 推論できない型引数があるか、上限を超えるときは*instanceをNULLにして成功を返す
+SlangError mono_instantiate(MonoCache* cache, const ASTNode* function, const Type* const* arguments,
+                            size_t argument_count, MonoInstance** instance);
+
+// 検査の担当を取る（取れたら検査してmono_finish_checkを呼ぶ）。環境がまだなければ取れない
+bool mono_claim_check(MonoCache* cache, MonoInstance* instance);
+void mono_finish_check(MonoCache* cache, MonoInstance* instance, SlangError result, const char* error,
+                       const TypeErrorSite* site);
+// ほかのスレッドが検査中なら終わるまで待ち、検査に成功したかを返す（まだ誰も検査していなければfalse）。
+// 検査中の本体はほかの特殊化を待たないので、自分の検査を終えた検査器から待ってもデッドロックしない
+bool mono_wait_check(MonoCache* cache, MonoInstance* instance);
+
+// 特殊化の名前か（元の名前の識別子には.が入らない）
+static inline bool mono_is_instance_name(const char* name) {
+    return strchr(name, '.') != NULL;
+}
+
+MonoStats mono_stats(MonoCache* cache);
+
+#endif // SLANG_MONOMORPH_H
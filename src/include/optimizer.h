@@ -0,0 +1,64 @@
+#ifndef SLANG_OPTIMIZER_H
+#define SLANG_OPTIMIZER_H
+
+#include <stdio.h>
+#include "common.h"
+#include "ir.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+// 最適化のパス管理
+// 線形IRの関数にインライン展開を行ってからSSA形式（ssa.h）にし、passes.defの順に
+// パスを走らせて線形IRに戻す。レジスタ割り当て（regalloc.h）はその結果を受け取る。
+// -O0は何もしない。-O1は定数伝播・コピー伝播・共通部分式削除・エスケープ解析・不要コード削除、
+// -O2はさらにインライン展開とループ不変式の移動を行う。
+
+#define OPT_DEFAULT_LEVEL 1
+#define OPT_MAX_LEVEL 2
+
+typedef enum {
+#define OPT_PASS(id, name, level) OPT_PASS_##id,
+#include "passes.def"
+#undef OPT_PASS
+    OPT_PASS_COUNT
+} OptPass;
+
+// 集計の項目（パスのほかにSSA形式への変換と戻しも測る）
+enum {
+    OPT_STAT_SSA_BUILD = OPT_PASS_COUNT,
+    OPT_STAT_SSA_LOWER,
+    OPT_STAT_COUNT
+};
+
+typedef struct {
+    int level;                 // 0〜OPT_MAX_LEVEL
+    bool time_passes;          // パスごとの所要時間を集計する
+    Trace* trace;              // NULLでなければ関数ごとのパスの区間を記録する
+} OptOptions;
+
+typedef struct {
+    double seconds;
+    size_t runs;
+    int64_t instructions;      // 増えた命令の数（減れば負）
+} OptPassStats;
+
+typedef struct {
+    OptOptions options;
+    OptPassStats stats[OPT_STAT_COUNT];
+} Optimizer;
+
+void optimizer_init(Optimizer* optimizer, const OptOptions* options);
+
+// functionを最適化する。moduleは同じコンパイル単位の関数で、インライン展開の候補になる
+// （functionを含んでいてよく、NULLの要素は飛ばす）。失敗してもfunctionは正しいIRのまま残る
+SlangError optimizer_run(Optimizer* optimizer, IrFunction* function, IrFunction* const* module, size_t module_count);
+
+// moduleのすべての関数を関数ごとに並列に最適化する（poolがNULLなら呼び出し元のスレッドで順に処理する）
+// インライン展開はどの関数も展開前の本体を展開するので、結果はスレッド数や順序によらない。
+// 失敗した関数は正しいIRのまま残り、戻り値は作業用の領域が取れなかったときだけエラーになる
+SlangError optimizer_run_module(Optimizer* optimizer, ThreadPool* pool, IrFunction** module, size_t count);
+
+// パスごとの所要時間と命令数の増減を出力する（time_passesのとき）
+void optimizer_report(const Optimizer* optimizer, FILE* out);
+
+#endif // SLANG_OPTIMIZER_H
@@ -3,42 +3,52 @@
 
 #include "lexer.h"
 #include "ast.h"
-#include "vector.h"
 #include "error.h"
 #include "type_system.h"
+#include "arena.h"
 #include <stdbool.h>
 
-// Parameter structure
-typedef struct {
-    char* name;
-    Type* type_annotation;
-} Parameter;
+// 構文解析器
+// 字句解析器のトークンを先頭から1回だけ読む再帰下降の解析器で、二項演算子は優先順位で登る
+// （先読みは1トークン、優先度の指定の判別だけ2トークン。後戻りはしない）。ノードと子の並びはすべてarenaから取る。
+// 子の並びは解析中はscratchに積んでおき、並びが閉じたときにちょうどの大きさで1回だけarenaに写す。
+// 構文エラーは記録してから文の境目まで読み飛ばして続けるので、1回の解析ですべてのエラーが集まる。
+// 入れ子が深すぎる入力は再帰で落ちる前に構文エラーにする（後段の木を歩く処理の深さも抑えられる）。
+// 優先度の指定（Function:type:priority:N;）は文として読み、直後のfnのノードに付ける（Functionの次が':'のときだけ）。
+// 汎用関数の型引数（fn name<T, U>）は名前の並びとしてノードに付け、注釈のTはtype_named_ofの型のままにする。
+//
+// プログラムは最上位の文を並べたNODE_BLOCK_STATEMENTになる（bytecode_compile_scriptや
+// type_checker_checkにそのまま渡せる形）。
 
 // Parser structure
 typedef struct {
     Lexer* lexer;
+    Arena* arena;    // ASTノードの所有者（コンパイル単位ごと）
     Token* current;
     Token* previous;
-    Vector* errors;
+    size_t consumed; // 読んだトークンの数（回復で先へ進んだかの確認用）
+
+    // 構文エラー（messageとfileはmallocした文字列）
+    Error* errors;
+    size_t error_count;
+    size_t error_capacity;
+
+    // 組み立て中の子の並び（入れ子の並びは後ろに積み重ねる）
+    ASTNode** scratch;
+    size_t scratch_count;
+    size_t scratch_capacity;
+
+    size_t depth;         // 入れ子の深さ（PARSER_MAX_DEPTHを超えたら構文エラー）
+
+    int pending_priority; // 次のfnに付ける優先度（Function:type:priority:Nで設定）
 } Parser;
 
 // Function declarations
-Parser* parser_create(Lexer* lexer);
+Parser* parser_create(Lexer* lexer, Arena* arena);
 void parser_destroy(Parser* parser);
+// 構文エラーがあればSLANG_ERROR_PARSERを返す（*astにはエラーのなかった文が残る）
 SlangError parser_parse(Parser* parser, ASTNode** ast);
 bool parser_had_error(Parser* parser);
 void parser_synchronize(Parser* parser);
 
-// AST manipulation functions
-void ast_add_function(AST* ast, Function* function);
-void ast_add_type_definition(AST* ast, TypeDefinition* type_def);
-
-// Additional function declarations
-SlangError* parser_parse_function(Parser* parser, Function* function);
-SlangError* parser_parse_type_definition(Parser* parser, TypeDefinition* type_def);
-SlangError* parser_parse_integer(Parser* parser, int* value);
-SlangError* parser_parse_block(Parser* parser, ASTNode** block);
-SlangError* parser_parse_statement(Parser* parser, ASTNode** statement);
-SlangError* parser_parse_expression(Parser* parser, ASTNode** expression);
-
-#endif // SLANG_PARSER_H 
\ No newline at end of file
+#endif // SLANG_PARSER_H
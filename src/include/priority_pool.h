@@ -0,0 +1,112 @@
+#ifndef SLANG_PRIORITY_POOL_H
+#define SLANG_PRIORITY_POOL_H
+
+#include "common.h"
+#include "type_system.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// 優先度の段階ごとのメモリプール（Memory Priority Ownershipの実行時）
+// 段階ごとにチャンク（POOL_CHUNK_SIZEの境界に置いたmmapの領域）を持ち、チャンクは1つの大きさの区分の
+// ブロックに切り分ける。ブロックはスレッドごとのキャッシュ（PoolCache）から取って返すので、普段の確保と
+// 解放はロックを取らない。キャッシュが空か溢れたときだけ、段階のロックを取ってチャンクとやり取りする。
+// 区分より大きい確保はそれだけのチャンクにする。
+//
+// 最も高い段階のチャンクは確保したスレッドが作ってすぐに触る（ファーストタッチでそのスレッドのNUMAノードに
+// 置かれる）。huge_pagesなら透過的ヒュージページを勧める。reserveの分は作成時に前もって作っておく。
+// limitを超えそうなときは低い段階から空のチャンクを返して場所を空け、それでも足りなければ、要求より低い
+// 段階の確保だけを断る（高い段階が低い段階に負けることはない）。
+//
+// 持ち主の段階はブロックごとにチャンクの中の表に置くので、持ち主を移す（priority_pool_transfer）ときは
+// 表と集計を書き換えるだけでブロックは写さない。
+
+#define POOL_TIERS 4                     // 段階の数（0が最も低い）
+#define POOL_SIZE_CLASSES 8              // 16, 32, ..., 2048バイト
+#define POOL_MIN_BLOCK 16
+#define POOL_MAX_BLOCK (POOL_MIN_BLOCK << (POOL_SIZE_CLASSES - 1))
+#define POOL_CHUNK_SIZE (2u << 20)       // チャンクの大きさと境界（ヒュージページ1枚）
+#define POOL_CACHE_LIMIT 128             // キャッシュの区分ごとのブロック数の上限
+
+typedef struct PoolChunk PoolChunk;
+typedef struct PoolCache PoolCache;
+
+typedef struct {
+    size_t limit;              // マップしてよい合計（0なら制限しない）
+    size_t reserve;            // 最も高い段階に前もって作っておく大きさ
+    bool huge_pages;           // 最も高い段階のチャンクに透過的ヒュージページを勧める
+} PriorityPoolOptions;
+
+// 段階の集計
+typedef struct {
+    size_t mapped;             // マップしているチャンクの大きさ
+    size_t chunks;
+    int64_t owned;             // 持ち主がこの段階のブロックの大きさ（生きているキャッシュの分）
+    size_t reclaimed;          // 空けるために返したチャンクの大きさの累計
+    size_t denied;             // limitで断った確保の数
+} PoolTierStats;
+
+typedef struct {
+    pthread_mutex_t lock;
+    PoolChunk* partial[POOL_SIZE_CLASSES];   // 空きのあるチャンク
+    PoolChunk* full[POOL_SIZE_CLASSES];      // 空きのないチャンク（渡したブロックが返ると戻る）
+    PoolChunk* large;                        // 区分より大きい確保
+    size_t chunks;
+    size_t reclaimed;
+    atomic_size_t mapped;
+    atomic_size_t denied;
+} PoolTier;
+
+typedef struct {
+    PriorityPoolOptions options;
+    PoolTier tiers[POOL_TIERS];
+    atomic_size_t mapped;                    // すべての段階の合計（limitと比べる）
+    pthread_mutex_t caches_lock;
+    PoolCache* caches;                       // 生きているキャッシュ（集計用）
+    int64_t retired_owned[POOL_TIERS];       // 破棄したキャッシュの集計（caches_lockで守る）
+} PriorityPool;
+
+typedef struct {
+    void* head;
+    uint32_t count;
+} PoolBin;
+
+// スレッドごとのキャッシュ（作ったスレッドだけが使う）
+struct PoolCache {
+    PriorityPool* pool;
+    PoolBin bins[POOL_TIERS][POOL_SIZE_CLASSES];    // チャンクの段階と区分ごとの空きブロック
+    _Atomic int64_t owned[POOL_TIERS];              // このキャッシュで増減した持ち主の段階ごとの大きさ
+    PoolCache* next;
+    PoolCache* prev;
+};
+
+PriorityPool* priority_pool_create(const PriorityPoolOptions* options);
+// すべてのキャッシュを破棄してから呼ぶ
+void priority_pool_destroy(PriorityPool* pool);
+
+// 変数の優先度（Var:type:priority:N）を段階に丸める
+unsigned priority_pool_tier(int priority);
+
+// キャッシュの作成と破棄（破棄すると持っている空きブロックをチャンクに返す）
+PoolCache* pool_cache_create(PriorityPool* pool);
+void pool_cache_destroy(PoolCache* cache);
+// 持っている空きブロックをすべてチャンクに返す（空になったチャンクを返せるようにする）
+void pool_cache_flush(PoolCache* cache);
+
+// tierの段階から確保する（tierは丸める。ブロックは16バイト境界。確保できないか断ればNULL）
+void* priority_pool_alloc(PoolCache* cache, unsigned tier, size_t size);
+// どのキャッシュから確保したブロックでも、どのスレッドのキャッシュに返してもよい
+void priority_pool_free(PoolCache* cache, void* block);
+// owner_typeの持ち主からnew_typeの持ち主（段階tier）へ持ち主を移す（type_can_ownで許されなければfalse）
+bool priority_pool_transfer(PoolCache* cache, void* block, const Type* owner_type, const Type* new_type,
+                            unsigned tier);
+// ブロックの持ち主の段階
+unsigned priority_pool_owner(const void* block);
+// 確保した大きさ（区分に切り上げた大きさ）
+size_t priority_pool_block_size(const void* block);
+
+// 低い段階から空のチャンクを返して、マップしている合計をbytes以上減らそうとする（減らした大きさを返す）。
+// below_tierより低い段階だけを対象にする
+size_t priority_pool_reclaim(PriorityPool* pool, size_t bytes, unsigned below_tier);
+void priority_pool_stats(PriorityPool* pool, unsigned tier, PoolTierStats* stats);
+
+#endif // SLANG_PRIORITY_POOL_H
@@ -0,0 +1,53 @@
+#ifndef SLANG_PROFILER_H
+#define SLANG_PROFILER_H
+
+#include <stdio.h>
+#include "common.h"
+
+// 実行時の標本化プロファイラ（コンパイルしたS-Langのプログラムに組み込む）
+// ITIMER_PROFのSIGPROFで、消費したCPU時間ごとに走っているスレッドのrip・rbpを取り、フレームポインタの
+// 連鎖（コード生成はどの関数もpush rbp; mov rbp, rspで始める）をたどって呼び出し列を記録する。
+// 標本には、そのときスケジューラで実行中のタスクの実効の段階と投入したときの段階も付ける。
+// 実効の段階が投入時より高い標本は、高い段階のタスクに待たれて継承で上がっている（優先度の逆転）間の時間になる。
+//
+// シグナルハンドラはフレームを読む前にそのページが読めることをprocess_vm_readvで確かめてから読み、
+// 標本はあらかじめ確保したバッファにアトミックに場所を取って書く（いっぱいになったら数えて捨てる）。
+// 関数の入口（push rbpの前）やフレームを作らない葉の関数で取った標本は、呼び出し元を1つ飛ばす。
+// カーネルはCPU時間のタイマーを刻みごとに調べるので、実際の周波数はHZで頭打ちになる（報告とpprofの周期は実測）。
+
+#define PROFILER_MAX_DEPTH 64
+#define PROFILER_DEFAULT_FREQUENCY 997                  // 他の周期と重ならないように素数にする
+#define PROFILER_DEFAULT_BUFFER_WORDS ((size_t)2 << 20)  // 8バイトの語の数（16MB）
+
+// コード生成が関数ごとに残す優先度の局所記号
+// （__slang_priority.<関数名>の値がFunction:type:priority:Nの優先度）
+#define PROFILER_PRIORITY_PREFIX "__slang_priority."
+
+typedef struct {
+    unsigned frequency;        // 1秒（CPU時間）あたりの標本の数（0なら既定）
+    size_t buffer_words;       // 0なら既定
+} ProfilerOptions;
+
+typedef struct {
+    size_t samples;
+    size_t dropped;            // バッファがいっぱいで捨てた標本
+    size_t inverted;           // 継承で段階が上がっていたタスクの標本
+    size_t max_depth;
+} ProfilerStats;
+
+// プロセスに1つだけ（optionsはNULLでよい）。すでに動いていればSLANG_ERROR_INTERNAL
+SlangError profiler_start(const ProfilerOptions* options);
+// タイマーを止め、走っているハンドラが終わるのを待つ。記録した標本は次のprofiler_startまで残る
+void profiler_stop(void);
+void profiler_stats(ProfilerStats* stats);
+
+// 以下は止めてから呼ぶ（動いていればSLANG_ERROR_INTERNAL）
+// gperftoolsのCPUプロファイル形式（pprof --text <実行ファイル> <path> で読める）
+SlangError profiler_write_pprof(const char* path);
+// 1行に1つの呼び出し列（flamegraph.plの入力）。根は標本の段階（継承で上がっていれば元の段階も）で、
+// 優先度を宣言した関数には[priority N]を付ける
+SlangError profiler_write_folded(const char* path);
+// 段階ごとの標本の数、自己時間の多い関数のtop個、逆転の間に走っていた関数
+SlangError profiler_report(FILE* out, size_t top);
+
+#endif // SLANG_PROFILER_H
@@ -0,0 +1,44 @@
+#ifndef SLANG_REGALLOC_H
+#define SLANG_REGALLOC_H
+
+#include "common.h"
+#include "ir.h"
+#include "asm_writer.h"
+
+// レジスタ割り当て
+// IRの基本ブロック上で生存解析を行い、仮想レジスタごとの生存区間に線形走査
+// （Poletto & Sarkar）でGPRとXMMを割り当てる。溢れた値はスタックスロットに置く。
+// 関数呼び出しをまたぐ整数はcallee-savedのGPRにだけ置き、XMMはすべてcaller-savedなので
+// 呼び出しをまたぐ浮動小数点数はスタックに置く。ベクトル演算（ir.h）もXMMをすべて作業用に使うので、
+// それをまたぐ浮動小数点数も同じくスタックに置く。
+
+// 割り当てに使わない作業用レジスタ
+// rax/rdxは除算と戻り値、r11とxmm14/xmm15はメモリ同士の演算に使う
+#define REGALLOC_SCRATCH_GPR X86_R11
+#define REGALLOC_SCRATCH_XMM 15
+#define REGALLOC_SCRATCH_XMM2 14
+
+typedef enum {
+    LOCATION_NONE,     // 一度も定義も使用もされない
+    LOCATION_GPR,
+    LOCATION_XMM,
+    LOCATION_STACK
+} LocationKind;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t reg;       // LOCATION_GPRならX86Register、LOCATION_XMMならxmm番号
+    uint32_t slot;     // LOCATION_STACKのスロット番号
+} Location;
+
+typedef struct {
+    Location* locations;       // 仮想レジスタごとの置き場所
+    size_t count;
+    uint32_t spill_slots;      // 必要なスタックスロット数（各8バイト）
+    uint16_t callee_saved;     // 使ったcallee-savedレジスタ（1 << X86Register）
+} RegisterAllocation;
+
+SlangError regalloc_run(const IrFunction* function, RegisterAllocation* allocation);
+void regalloc_free(RegisterAllocation* allocation);
+
+#endif // SLANG_REGALLOC_H
@@ -0,0 +1,48 @@
+#ifndef SLANG_RESOLVER_H
+#define SLANG_RESOLVER_H
+
+#include "common.h"
+#include "ast.h"
+#include "symbol_table.h"
+
+// 名前解決
+// resolve_programは最上位の関数とグローバル変数をそれぞれの記号表に登録する
+// （グローバル変数のslotは宣言順の番号、関数のslotは最上位の文の並びの中の位置）。
+// 関数本体のローカル変数はResolverが宣言の順にrbpからのオフセットを割り当てる。コード生成は本体を
+// 歩きながら同じ順にresolver_declare/resolver_lookupを呼ぶ（NODE_BLOCK_STATEMENTとif/whileの
+// 枝ごとにスコープを積む）。ASTには書き込まないので、複数の単位が共有する本体（汎用関数の特殊化）も
+// 並列に生成できる。ローカルでない名前はグローバル変数か関数（ほかの単位のものでもよい）とみなす。
+
+#define RESOLVER_SLOT_SIZE 8
+#define RESOLVER_FRAME_ALIGNMENT 16
+
+// 関数1つ分の解決状態
+typedef struct {
+    SymbolTable locals;        // slotはrbpからのオフセット
+    const SymbolTable* globals;
+    const SymbolTable* functions;
+    size_t frame_size;         // 使用中のローカル変数領域
+    size_t max_frame_size;
+    bool failed;               // 記号表の確保に失敗した
+} Resolver;
+
+// programはparser_parseの返すNODE_BLOCK_STATEMENT
+SlangError resolve_program(const ASTNode* program, SymbolTable* globals, SymbolTable* functions);
+
+void resolver_init(Resolver* resolver, const SymbolTable* globals, const SymbolTable* functions);
+void resolver_free(Resolver* resolver);
+// 引数を宣言順に置き、本体の全てのローカル変数が入るフレームの大きさ（16バイト境界）を返す
+SlangError resolver_begin_function(Resolver* resolver, const ASTNode* function, size_t* frame_size);
+bool resolver_push_scope(Resolver* resolver);
+// スコープを抜けるとその中の変数の領域は次の変数に再利用される
+void resolver_pop_scope(Resolver* resolver);
+// 新しいローカル変数のオフセット（失敗したら0）
+size_t resolver_declare(Resolver* resolver, const char* name);
+// ローカル変数ならそのオフセット、そうでなければ0
+size_t resolver_lookup(const Resolver* resolver, const char* name);
+// 引数のオフセット（resolver_begin_functionの後で使う）
+static inline size_t resolver_parameter_offset(size_t index) {
+    return (index + 1) * RESOLVER_SLOT_SIZE;
+}
+
+#endif // SLANG_RESOLVER_H
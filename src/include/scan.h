@@ -0,0 +1,25 @@
+#ifndef SLANG_SCAN_H
+#define SLANG_SCAN_H
+
+#include <stddef.h>
+
+// 字句解析器の高速走査
+// 空白・コメント本体・識別子・文字列本体の連続を16〜32バイト単位で読み飛ばす。
+// 実装（AVX2/SSE2/NEON/スカラー）は最初の呼び出し時にCPUに合わせて選ばれる。
+// いずれの関数も[p, end)の外は読まない。
+
+// 読み飛ばした範囲とその中の改行
+typedef struct {
+    size_t length;        // 読み進めたバイト数
+    size_t newlines;      // 範囲内の'\n'の数
+    size_t last_newline;  // 最後の'\n'の位置（pからのオフセット、newlines > 0のときのみ有効）
+} ScanResult;
+
+// 走査の関数
+ScanResult scan_whitespace(const char* p, const char* end);   // ' ', '\t', '\r', '\n'
+size_t scan_identifier(const char* p, const char* end);       // [A-Za-z0-9_]
+size_t scan_line(const char* p, const char* end);             // '\n'または'\0'の手前まで
+ScanResult scan_string(const char* p, const char* end);       // '"'または'\0'の手前まで
+const char* scan_implementation_name(void);
+
+#endif // SLANG_SCAN_H
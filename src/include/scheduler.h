@@ -0,0 +1,46 @@
+#ifndef SLANG_SCHEDULER_H
+#define SLANG_SCHEDULER_H
+
+#include "common.h"
+
+// 優先度つきのタスクスケジューラ（Function Priority Ownershipの実行時）
+// ワーカーごと・優先度の段階ごとにロックを使わない両端キュー（Chase-Lev）を持つ。ワーカーは高い段階から
+// 順に、自分のキューの末尾、外のスレッドが投入したタスク、他のワーカーのキューの先頭の順に探すので、
+// 低い段階のタスクは高い段階が空のときにしか始まらない。実行中のタスクは横取りしない（協調的）ので、
+// reservedのワーカーは最も高い段階だけを処理し、長い低優先度のタスクで高優先度の経路が塞がらないようにする。
+//
+// 高い段階のタスクが低い段階のタスクを待つときは、待たれる側（と、それがさらに待っている先）に自分の段階を
+// 継承させ、その段階のキューに積み直す（古いほうの項目は取られたときに捨てる）。待つ側は、待たれる側が
+// まだ始まっていなければ自分で実行し、他のワーカーが実行中なら自分の段階以上のタスクを処理しながら待つ。
+
+#define SCHEDULER_LEVELS 4    // 段階の数（0が最も低い）
+
+typedef void (*SchedulerJob)(void* context);
+
+typedef struct Scheduler Scheduler;
+typedef struct SchedulerTask SchedulerTask;
+
+// workersはワーカーの数（0ならオンラインのCPUの数）、reservedはそのうち最も高い段階だけを処理する数
+// （少なくとも1つは全段階を処理するように切り詰める）
+Scheduler* scheduler_create(size_t workers, size_t reserved);
+// まだ終わっていないタスクを処理してから破棄する
+void scheduler_destroy(Scheduler* scheduler);
+size_t scheduler_size(const Scheduler* scheduler);
+
+// 関数の優先度（Function:type:priority:N）を段階に丸める
+unsigned scheduler_level(int priority);
+
+// タスクを投入する（levelは丸める）。返したタスクはscheduler_waitかscheduler_detachにちょうど1回渡す。
+// 確保できなければNULL（jobは呼ばれない）
+SchedulerTask* scheduler_spawn(Scheduler* scheduler, unsigned level, SchedulerJob job, void* context);
+// タスクの終わりを待って手放す（タスクの中から呼べば、その段階を継承させる）
+void scheduler_wait(Scheduler* scheduler, SchedulerTask* task);
+// 待たずに手放す
+void scheduler_detach(SchedulerTask* task);
+
+// このスレッドで実行中のタスクの段階（タスクの外なら0）
+unsigned scheduler_current_level(void);
+// 実行中のタスクの実効の段階と投入したときの段階（タスクの外ならfalse）。シグナルハンドラから呼んでよい
+bool scheduler_current_levels(unsigned* level, unsigned* base_level);
+
+#endif // SLANG_SCHEDULER_H
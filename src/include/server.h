@@ -0,0 +1,77 @@
+#ifndef SLANG_SERVER_H
+#define SLANG_SERVER_H
+
+#include <stdio.h>
+#include "common.h"
+#include "ast.h"
+#include "arena.h"
+#include "parser.h"
+#include "type_checker.h"
+#include "build_cache.h"
+#include "monomorph.h"
+
+// コンパイラのサーバー（slangc --server=SOCKET）
+// プロセスを起動したままUnixソケットで要求を受け、インターン表・型の表・構文解析した単位・成分の型検査を
+// 要求の間で持ち続ける。単位とuseの依存関係はメモリの上のBuildCacheで求め、要求ごとに照合し直す
+// （時刻と大きさが変わったファイルだけを読み直す）。構文解析した単位は内容のハッシュが変わるまで使い、
+// 成分の検査結果は成分のキー（メンバーの内容と依存先の成分のキー）が変わるまで使う。
+// 依存先の成分のキーが同じなら検査器も使い続けるので、成分の中で変えた関数だけが本体を検査し直す。
+// 汎用関数の特殊化のキャッシュは要求ごとに作り直すので、汎用関数を宣言した成分は毎回検査する
+// （検査器は使い続けるので、本体を歩くのは特殊化を使う関数だけ）。
+//
+// 要求は1行に1つで、応答は0行以上の診断（ドライバと同じ形）のあとに終わりの1行が続く。
+//   check <path>   pathとuseで辿れる単位を検査する
+//                  → ok|failed units=N parsed=N checked=N reused=N us=N
+//                    （parsedは読み直した単位、checkedは検査した成分、reusedは結果を使った成分の数）
+//   stats          → stats requests=N units=N interned=N
+//   shutdown       → bye（書き残した応答を書き終えたらすべての接続を閉じ、待ち受けをやめる）
+// 分からない要求には「error <理由>」を返す。
+// 接続はpollで多重化するので、開いたままの接続があってもほかの接続の要求に答える。要求は1つずつ順に
+// 処理し、同じ接続の次の要求は前の応答を書き終えてから読む。ソケットのファイルは所有者だけが読み書きできる。
+
+#define SERVER_LINE_MAX 4096
+#define SERVER_BACKLOG 16
+#define SERVER_MAX_CLIENTS 64      // これより多い接続はバックログで待たせる
+
+// 単位（BuildCacheのunitsと同じ番号）
+typedef struct {
+    uint64_t source_hash;      // 構文解析した内容（0なら未解析）
+    Arena* arena;              // ASTの所有者（字句解析器とソースは解析したら閉じる）
+    Parser* parser;            // 構文エラーの並びも持つ
+    ASTNode* ast;
+    SlangError error;
+
+    // 成分の検査の結果（成分の最初の単位だけが持つ）
+    uint64_t check_key;        // 検査した成分のキー（0なら未検査）
+    uint64_t imports_key;      // 検査器に宣言した依存先の成分のキー
+    TypeChecker* checker;      // 公開する型はhost_*_countより後ろの関数とグローバル変数
+    SlangError check_error;
+    bool blocked;              // 依存先か構文解析が失敗したので検査しなかった
+} ServerUnit;
+
+typedef struct {
+    BuildCache* cache;         // メモリの上だけ
+    ServerUnit* units;
+    size_t unit_capacity;
+    size_t requests;
+    MonoCache* specializations;  // server_checkの間だけ
+
+    // 最後のserver_check
+    size_t unit_count;
+    size_t parsed_count;
+    size_t checked_count;
+    size_t reused_count;
+} Server;
+
+// intern_initとtype_table_initの後で作る
+Server* server_create(void);
+void server_destroy(Server* server);
+
+// pathとuseで辿れる単位を検査し、診断をoutに書く（outはNULLでよい）。最初に失敗した単位のエラーを返す
+SlangError server_check(Server* server, const char* path, FILE* out);
+// 1行の要求を処理して応答をoutに書く（shutdownならfalse）
+bool server_handle(Server* server, const char* request, FILE* out);
+// socket_pathで待ち受け、shutdownを受けるまで接続を多重化して処理する（ソケットのファイルは最後に消す）
+SlangError server_listen(Server* server, const char* socket_path);
+
+#endif // SLANG_SERVER_H
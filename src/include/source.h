@@ -0,0 +1,24 @@
+#ifndef SLANG_SOURCE_H
+#define SLANG_SOURCE_H
+
+#include "common.h"
+
+// ソースファイルの内容
+// 通常ファイルはmmapで読み込み、失敗した場合やパイプなどはチャンク単位で読み込む。
+// どちらの場合もdata[length]は'\0'で、字句解析器は終端を読み越さない。
+typedef struct {
+    const char* path;
+    const char* data;
+    size_t length;
+    size_t mapped_size;  // mmapした領域の大きさ（チャンク読み込みでは0）
+    bool is_mapped;
+} SourceFile;
+
+#define SOURCE_READ_CHUNK_SIZE (1024 * 1024)
+
+// ソースファイルの関数
+SourceFile* source_open(const char* path);
+SourceFile* source_open_buffered(const char* path);
+void source_close(SourceFile* file);
+
+#endif // SLANG_SOURCE_H
@@ -0,0 +1,80 @@
+#ifndef SLANG_SSA_H
+#define SLANG_SSA_H
+
+#include "common.h"
+#include "ir.h"
+
+// SSA形式
+// 線形IRを基本ブロックのグラフに分け、代入が複数ある仮想レジスタ（ローカル変数）を
+// φで分けて、どの値も定義が1つでその定義がすべての使用を支配するようにする。
+// ブロックは必ずjump・branch_false・returnのどれかで終わり、分岐先はsuccessorsに持つ
+// （branch_falseはsuccessors[0]が偽、successors[1]が真のとき）。imm.labelは使わない。
+// φはブロックの先頭にまとまり、args[i]がpredecessors[i]から来る値になる。
+// ssa_lowerはφを先行ブロックの末尾のコピーにして線形IRに戻す。
+
+#define SSA_NO_BLOCK UINT32_MAX
+
+typedef struct {
+    IrInstruction* code;
+    size_t count;
+    size_t capacity;
+    uint32_t* predecessors;
+    uint32_t predecessor_count;
+    uint32_t predecessor_capacity;
+    uint32_t successors[2];
+    uint32_t successor_count;
+    uint32_t idom;             // 直接の支配ブロック（入口はSSA_NO_BLOCK）
+    uint32_t dom_child;        // 支配木の最初の子
+    uint32_t dom_sibling;      // 支配木の次の兄弟
+    uint32_t dom_pre;          // 支配木の前順・後順の番号（支配関係の判定に使う）
+    uint32_t dom_post;
+    uint32_t place_before;     // 後から作ったブロックを出力する位置（元からあるブロックはSSA_NO_BLOCK）
+    bool removed;
+} SsaBlock;
+
+typedef struct {
+    IrFunction* function;      // 名前と値の型（新しい値はir_new_valueで作る）
+    SsaBlock* blocks;          // 0番が入口（先行ブロックを持たない）
+    size_t block_count;
+    size_t block_capacity;
+    uint32_t* order;           // 到達するブロックの逆後順
+    size_t order_count;
+    bool failed;               // 割り当てに失敗した
+} SsaFunction;
+
+// 線形IRからの変換（functionの命令列はそのまま、値だけが増える）
+SlangError ssa_build(SsaFunction* ssa, IrFunction* function);
+// 線形IRへの戻し（functionの命令列を置き換える）
+SlangError ssa_lower(SsaFunction* ssa);
+void ssa_free(SsaFunction* ssa);
+
+// 到達しないブロックを取り除き、逆後順と支配木を求め直す（グラフを変えたら呼ぶ）
+SlangError ssa_analyze(SsaFunction* ssa);
+bool ssa_dominates(const SsaFunction* ssa, uint32_t a, uint32_t b);
+
+// グラフの操作
+uint32_t ssa_new_block(SsaFunction* ssa);
+bool ssa_add_predecessor(SsaFunction* ssa, uint32_t block, uint32_t predecessor);
+// predecessorからの辺を1本除き、φの対応する入力も除く
+void ssa_remove_predecessor(SsaFunction* ssa, uint32_t block, uint32_t predecessor);
+// blockのsuccessor番目の辺の間に空のブロックを挟む（失敗したらSSA_NO_BLOCK）
+uint32_t ssa_split_edge(SsaFunction* ssa, uint32_t block, uint32_t successor);
+// jumpだけのブロックを飛ばし、唯一の先行ブロックからjumpで続くブロックを併合する（変えたらtrue）
+bool ssa_simplify_cfg(SsaFunction* ssa);
+
+// 命令の操作
+// index番目に空の命令を挿入する（失敗したらNULL）
+IrInstruction* ssa_insert(SsaFunction* ssa, uint32_t block, size_t index);
+// φ以外の最初の位置
+size_t ssa_first_non_phi(const SsaBlock* block);
+// 命令をIR_NOPにする（引数の配列も解放する）
+void ssa_delete(IrInstruction* instruction);
+// IR_NOPを取り除く
+void ssa_compact(SsaFunction* ssa);
+// 値を置き換える（replacement[v]がvでなければvの使用をすべて置き換え先にする）
+// replacementの長さはcountで、それ以降の値は置き換えない
+void ssa_replace_values(SsaFunction* ssa, IrValue* replacement, size_t count);
+IrValue ssa_resolve(IrValue* replacement, size_t count, IrValue value);
+size_t ssa_instruction_count(const SsaFunction* ssa);
+
+#endif // SLANG_SSA_H
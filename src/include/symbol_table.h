@@ -0,0 +1,49 @@
+#ifndef SLANG_SYMBOL_TABLE_H
+#define SLANG_SYMBOL_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 記号表
+// キーはインターンされた名前で、ポインタの比較だけで引く（オープンアドレス法、線形探査）。
+// 束縛はスタックに積み、同名の外側の束縛を鎖でたどれるようにしておくので、
+// スコープを抜けるときは積んだ分だけ戻せばよく、内側のスコープが深くても検索はO(1)で済む。
+
+#define SYMBOL_NONE (-1)
+
+// 束縛
+typedef struct {
+    const char* name;    // インターンされた名前
+    uint32_t slot;       // 利用側が決める番号（レジスタ、フレーム内オフセット、グローバルのスロットなど）
+    uint32_t depth;      // 宣言されたスコープの深さ（0が最上位）
+    int32_t shadowed;    // 同名で外側にある束縛（なければSYMBOL_NONE）
+    uint32_t bucket;     // 名前の入っているバケット
+} Symbol;
+
+typedef struct {
+    Symbol* symbols;          // 宣言順の束縛のスタック
+    size_t count;
+    size_t capacity;
+    const char** keys;        // バケット（一度入った名前は消さない）
+    int32_t* heads;           // 各名前の最も内側の束縛（見えていなければSYMBOL_NONE）
+    size_t key_count;
+    size_t bucket_capacity;
+    size_t* scope_marks;      // 各スコープの開始位置
+    size_t depth;
+    size_t scope_capacity;
+} SymbolTable;
+
+// 記号表の関数
+void symbol_table_init(SymbolTable* table);
+void symbol_table_free(SymbolTable* table);
+bool symbol_table_push_scope(SymbolTable* table);
+void symbol_table_pop_scope(SymbolTable* table);
+// 現在のスコープに束縛を追加する（外側の同名の束縛は隠れる）
+bool symbol_table_define(SymbolTable* table, const char* name, uint32_t slot);
+// 最も内側の束縛を返す（なければNULL）
+const Symbol* symbol_table_lookup(const SymbolTable* table, const char* name);
+// 現在のスコープで宣言された束縛だけを返す
+const Symbol* symbol_table_lookup_local(const SymbolTable* table, const char* name);
+
+#endif // SLANG_SYMBOL_TABLE_H
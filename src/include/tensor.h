@@ -0,0 +1,91 @@
+#ifndef SLANG_TENSOR_H
+#define SLANG_TENSOR_H
+
+#include <stddef.h>
+#include "common.h"
+#include "thread_pool.h"
+
+// テンソルの実行時ライブラリ
+// 要素はdoubleで、共有の記憶域（参照数つき）を形とストライドで見る。
+// 切り出し・転置・次元の入れ替え・拡大（ストライド0）は記憶域を共有するビューを作るだけでコピーしない。
+// 行列積はブロック分割（パックしたAとBのパネルと4x4の小さなカーネル）で、
+// 要素ごとの演算は式（TensorProgram）を1回で評価し、途中の結果をメモリに書かない。
+// 大きな演算はThreadPoolで分けて並列に処理する（poolがNULLなら呼び出し元のスレッドだけ）。
+// ビューの作成と解放は1つのスレッドで行う。
+// Cから呼ぶライブラリで、S-Langのプログラムからは呼べない（S-Langにテンソル型の書き方はなく、
+// コード生成もインタプリタもこのライブラリを使わない）。
+
+#define TENSOR_MAX_RANK 8
+#define TENSOR_ALIGNMENT 64
+
+typedef struct {
+    double* data;
+    size_t length;             // 要素数
+    size_t references;
+} TensorStorage;
+
+typedef struct {
+    TensorStorage* storage;
+    size_t offset;                       // 先頭の要素の位置（要素単位）
+    size_t rank;
+    size_t shape[TENSOR_MAX_RANK];
+    ptrdiff_t strides[TENSOR_MAX_RANK];  // 要素単位（0なら拡大）
+} Tensor;
+
+// 作成と解放（すべてのビューを解放すると記憶域も解放される）
+SlangError tensor_create(Tensor* tensor, size_t rank, const size_t* shape);
+void tensor_release(Tensor* tensor);
+
+// ビュー（outはsourceと記憶域を共有する新しい参照）
+SlangError tensor_slice(Tensor* out, const Tensor* source, size_t axis, size_t start, size_t stop, size_t step);
+SlangError tensor_transpose(Tensor* out, const Tensor* source, size_t axis_a, size_t axis_b);
+SlangError tensor_broadcast(Tensor* out, const Tensor* source, size_t rank, const size_t* shape);
+SlangError tensor_reshape(Tensor* out, const Tensor* source, size_t rank, const size_t* shape);
+
+size_t tensor_size(const Tensor* tensor);
+bool tensor_is_contiguous(const Tensor* tensor);
+bool tensor_same_shape(const Tensor* a, const Tensor* b);
+double* tensor_at(const Tensor* tensor, const size_t* index);
+
+SlangError tensor_fill(Tensor* tensor, double value);
+SlangError tensor_copy(Tensor* dst, const Tensor* src);
+
+// 要素ごとの演算
+typedef enum {
+#define TENSOR_OP(name, pops, expression) TENSOR_OP_##name,
+#include "tensor_ops.def"
+#undef TENSOR_OP
+    TENSOR_OP_COUNT
+} TensorOp;
+
+#define TENSOR_PROGRAM_MAX_STACK 8
+
+typedef struct {
+    uint8_t op;
+    uint8_t input;             // TENSOR_OP_INPUTの入力の番号
+    double constant;           // TENSOR_OP_CONSTの値
+} TensorInstruction;
+
+// 後置記法の式（最後にスタックに残った1つが結果）
+typedef struct {
+    const TensorInstruction* code;
+    size_t count;
+} TensorProgram;
+
+// out[i] = program(inputs[0][i], inputs[1][i], ...)（入力はoutと同じ形。outと重なる入力はoutと同じビューに限る）
+SlangError tensor_map(ThreadPool* pool, Tensor* out, const TensorProgram* program, const Tensor* inputs, size_t input_count);
+
+// 行列積 c = a × b（aはm×k、bはk×n、cはm×n。cはaやbと記憶域を共有してはならない）
+SlangError tensor_matmul(ThreadPool* pool, Tensor* c, const Tensor* a, const Tensor* b);
+
+// 全要素の集約（並列度によらず同じ順序で足すので、結果はスレッド数で変わらない）
+typedef enum {
+    TENSOR_REDUCE_SUM,
+    TENSOR_REDUCE_MIN,
+    TENSOR_REDUCE_MAX
+} TensorReduction;
+
+SlangError tensor_reduce(ThreadPool* pool, const Tensor* tensor, TensorReduction kind, double* result);
+SlangError tensor_dot(ThreadPool* pool, const Tensor* a, const Tensor* b, double* result);
+
+#endif // SLANG_TENSOR_H
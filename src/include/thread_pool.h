@@ -0,0 +1,39 @@
+#ifndef SLANG_THREAD_POOL_H
+#define SLANG_THREAD_POOL_H
+
+#include "common.h"
+#include <stdatomic.h>
+
+// スレッドプール（ワークスティーリング）
+// ワーカーごとに両端キューを持ち、ワーカーが投入した仕事は自分のキューの末尾に積んで末尾から取る。
+// 自分のキューが空なら、プールの外のスレッドが投入した仕事のキューと他のワーカーのキューの先頭から盗む。
+// 仕事はグループにまとめて投入し、thread_pool_waitで終わりを待つ。待つスレッドも仕事を取って処理するので、
+// 仕事の中から投入して待ってもよい（thread_pool_forの入れ子も並列に処理する）。
+
+typedef void (*ThreadPoolTask)(void* context, size_t begin, size_t end);
+typedef void (*ThreadPoolJob)(void* context);
+
+typedef struct ThreadPool ThreadPool;
+
+// 仕事のグループ（まだ終わっていない仕事の数）
+typedef struct {
+    atomic_size_t pending;
+} ThreadPoolGroup;
+
+// threadsは呼び出し元を含めたスレッド数（0ならオンラインのCPUの数）
+ThreadPool* thread_pool_create(size_t threads);
+void thread_pool_destroy(ThreadPool* pool);
+size_t thread_pool_size(const ThreadPool* pool);
+
+void thread_pool_group_init(ThreadPoolGroup* group);
+// 仕事を投入する（poolがNULLかワーカーがなければその場で処理する）
+void thread_pool_spawn(ThreadPool* pool, ThreadPoolGroup* group, ThreadPoolJob job, void* context);
+// グループのすべての仕事が終わるまで、仕事を取って処理しながら待つ
+void thread_pool_wait(ThreadPool* pool, ThreadPoolGroup* group);
+
+// 範囲[0, count)をgrain個ずつの区間に分けて呼び出し元のスレッドと一緒に処理する。
+// 区間は共有のカウンタから順に取るので、重さに偏りがあってもよい。
+// すべての区間が終わるまで戻らない（poolがNULLなら呼び出し元のスレッドだけで処理する）
+void thread_pool_for(ThreadPool* pool, size_t count, size_t grain, ThreadPoolTask task, void* context);
+
+#endif // SLANG_THREAD_POOL_H
@@ -0,0 +1,67 @@
+#ifndef SLANG_TRACE_H
+#define SLANG_TRACE_H
+
+#include "common.h"
+#include <pthread.h>
+#include <stdio.h>
+
+// コンパイルの計測（--time-reportと--trace=FILE）
+// 段階（読み込み・字句解析・構文解析・型検査・コード生成）と最適化のパスを、単位や関数ごとに1つの区間として
+// 記録する。区間は開始と長さ（単調な時計のナノ秒）、記録したスレッド、確保した大きさ、処理した数
+// （字句解析はトークン、構文解析はノード、パスは命令）を持つ。複数のスレッドから記録してよい。
+// 報告は名前ごとに合計した表（スレッドをまたいで足した時間とその種類の合計に対する割合・回数・大きさ・
+// 毎秒の処理数）と、壁時計の時間・最大RSSで、
+// trace_write_jsonはChromeのトレースイベントの形式（chrome://tracingやPerfettoで開ける）で書く。
+// traceがNULLなら記録しないので、呼び出し側は計測するかどうかで分けなくてよい。
+
+typedef struct {
+    const char* category;      // "phase"か"pass"（静的な文字列）
+    const char* name;          // 静的な文字列
+    const char* unit;          // ファイルのパスか関数の名前（traceが写して持つ。なければNULL）
+    uint64_t start;            // traceを作ってからのナノ秒
+    uint64_t duration;
+    uint32_t thread;
+    uint64_t bytes;
+    uint64_t items;
+} TraceEvent;
+
+typedef struct {
+    pthread_mutex_t lock;
+    TraceEvent* events;
+    size_t event_count;
+    size_t event_capacity;
+    uint64_t origin;           // 作ったときの時刻
+    bool failed;               // 記録の領域が取れず、いくつか落とした
+} Trace;
+
+Trace* trace_create(void);
+void trace_destroy(Trace* trace);
+
+// 単調な時計の時刻（ナノ秒）
+uint64_t trace_now(void);
+
+// 区間の始まりの時刻（traceがNULLなら時計を読まない）
+static inline uint64_t trace_begin(const Trace* trace) {
+    return trace != NULL ? trace_now() : 0;
+}
+
+// [start, end)を1つの区間として記録する
+void trace_add(Trace* trace, const char* category, const char* name, const char* unit, uint64_t start,
+               uint64_t end, uint64_t bytes, uint64_t items);
+
+// startから今までを1つの区間として記録する
+static inline void trace_end(Trace* trace, const char* category, const char* name, const char* unit,
+                             uint64_t start, uint64_t bytes, uint64_t items) {
+    if (trace != NULL) trace_add(trace, category, name, unit, start, trace_now(), bytes, items);
+}
+
+// 最大RSS（キロバイト）
+size_t trace_peak_rss(void);
+
+// 名前ごとの合計を表にして書く（最初に始まった順）。報告と書き出しは記録がすべて終わってから呼ぶ
+void trace_report(const Trace* trace, FILE* out);
+
+// Chromeのトレースイベントの形式で書く（書けなければSLANG_ERROR_IO）
+SlangError trace_write_json(const Trace* trace, const char* path);
+
+#endif // SLANG_TRACE_H
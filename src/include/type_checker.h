@@ -1,32 +1,117 @@
-#ifndef TYPE_CHECKER_H
-#define TYPE_CHECKER_H
+#ifndef SLANG_TYPE_CHECKER_H
+#define SLANG_TYPE_CHECKER_H
 
+#include "common.h"
 #include "ast.h"
+#include "symbol_table.h"
 #include "type_system.h"
 
+// プログラム全体の型検査
+// 最上位の関数のシグネチャを最初に1回だけ組んで表に置き、最上位の文（letはグローバル変数になる）を
+// 検査してから、各関数の本体を検査する。型はtype_system.hの型の表の型で、比較はポインタで済む。
+// 注釈のない引数・戻り値・呼び出し先の型はNULL（実行時に決まる）で、NULLを含む式は検査しない。
+// 検査した式のノードにはその型（resolved_type）を、シグネチャの分かる呼び出しには呼び出し先の
+// call_typeを書き込む（コード生成が浮動小数点数をXMMに置き、引数をABIどおりに渡すのに使う）。
+// 同じ名前の関数も変数もないlog!からerror!はログのマクロで、呼び出しにその段階（log_level）を書く。
+//
+// 関数ごとの結果は、本体の構造・シグネチャ・本体から参照する最上位の名前の型から求めたハッシュを
+// キーに覚えておく。同じTypeCheckerで検査し直すと、キーの変わらない関数は本体を歩かない。
+//
+// 汎用関数（fn name<T>）は型引数の型を実行時に決まる型として本体を1回検査する（共有の本体）。
+// specializationsを設定すると、引数の型が分かる呼び出しはmonomorph.hの特殊化を使い、呼び出しに
+// その名前を書き込む。特殊化の本体は、汎用関数を宣言した検査器の環境の中でtype_checker_checkの最後に
+// 検査する（担当を取れたものだけ。エラーは「特殊化の名前: 理由」）。特殊化を使った関数はキャッシュを使わない。
+
+#define TYPE_CHECKER_MAX_TYPE_PARAMETERS 16
+
+struct MonoCache;
+struct MonoInstance;
+
+// 関数のシグネチャ（型はすべて型の表の型）
+typedef struct {
+    const char* name;              // インターンされた名前
+    const Type** parameters;       // 注釈がなければNULL
+    size_t parameter_count;
+    const Type* return_type;       // 注釈がなければNULL
+    const Type* type;              // 関数型（すべての型が分かるときだけ）
+    const Type* call_type;         // 分からない型をNULLのまま持つ関数型（type_signature_of）
+    const ASTNode* generic;        // 汎用関数の宣言（型引数の引数と戻り値はNULL）
+} TypeSignature;
+
+typedef struct {
+    const char* name;
+    const Type* type;              // 分からなければNULL
+} TypeBinding;
+
+// 型エラーの場所（ノードの位置と、メッセージに添える名前）。lineが0なら位置は分からない
+// 検査器のキャッシュはASTより長く生きるので、ノードへのポインタでなく値で持つ
+typedef struct {
+    const char* name;              // 変数・関数・演算子の名前（なければNULL）
+    uint32_t line;
+    uint16_t column;
+} TypeErrorSite;
+
+// 関数の検査結果のキャッシュ
 typedef struct {
-    struct {
-        char** keys;
-        Type** values;
-        size_t count;
-        size_t capacity;
-    } variables;
-    struct {
-        char** keys;
-        Type** values;
-        size_t count;
-        size_t capacity;
-    } functions;
+    const char* name;
+    uint64_t key;
+    SlangError result;
+    const char* error;
+    TypeErrorSite site;
+    bool specialized;              // 特殊化を使った（使うたびに本体を検査し直す）
+} TypeCheckEntry;
+
+typedef struct TypeChecker {
+    SymbolTable functions;         // slotはsignaturesの番号
+    TypeSignature* signatures;
+    size_t signature_count;
+    size_t signature_capacity;
+
+    SymbolTable globals;           // slotはglobal_bindingsの番号
+    SymbolTable locals;            // slotはlocal_typesの番号
+    TypeBinding* global_bindings;
+    size_t global_count;
+    size_t global_capacity;
+    size_t host_signature_count;   // type_checker_declare_*で宣言した分（検査し直しても残す）
+    size_t host_global_count;
+    const Type** local_types;
+    size_t local_count;
+    size_t local_capacity;
+
+    TypeCheckEntry* cache;         // オープンアドレス法（名前のポインタで引く）
+    size_t cache_count;
+    size_t cache_capacity;
+
+    struct MonoCache* specializations;  // NULLなら汎用関数はいつも共有の本体を使う
+    struct MonoInstance** instances;    // 最後のtype_checker_checkで使った特殊化（重複なし）
+    size_t instance_count;
+    size_t instance_capacity;
+    const Type* type_parameters[TYPE_CHECKER_MAX_TYPE_PARAMETERS];  // 検査中の汎用関数の型引数
+    size_t type_parameter_count;
+
+    const TypeSignature* current;  // 検査中の関数（最上位の文ならNULL）
+    const char* error;             // 最後のエラー
+    TypeErrorSite error_site;
+    size_t error_statement;        // エラーを含む最上位の文の番号（type_checker_checkの並び。分からなければSIZE_MAX）
+
+    // 最後のtype_checker_checkで本体を検査した関数と、キャッシュを使った関数の数
+    size_t checked_count;
+    size_t reused_count;
 } TypeChecker;
 
-// Function declarations
-TypeChecker* create_type_checker(void);
-void free_type_checker(TypeChecker* type_checker);
-Type* check_expression(TypeChecker* type_checker, ASTNode* node);
-void check_statement(TypeChecker* type_checker, ASTNode* node);
-void declare_variable_type(TypeChecker* type_checker, const char* name, Type* type);
-Type* get_variable_type(TypeChecker* type_checker, const char* name);
-void declare_function_type(TypeChecker* type_checker, const char* name, Type* type);
-Type* get_function_type(TypeChecker* type_checker, const char* name);
-
-#endif // TYPE_CHECKER_H 
\ No newline at end of file
+TypeChecker* type_checker_create(void);
+void type_checker_destroy(TypeChecker* checker);
+
+// 組み込み関数やホストのグローバル変数の宣言（typeがNULLなら型を検査しない）
+bool type_checker_declare_global(TypeChecker* checker, const char* name, const Type* type);
+bool type_checker_declare_function(TypeChecker* checker, const char* name, const Type* const* parameters,
+                                   size_t parameter_count, const Type* return_type);
+// 別の検査器のシグネチャをそのまま宣言する（汎用関数ならその宣言も引き継ぐ）
+bool type_checker_declare_signature(TypeChecker* checker, const TypeSignature* signature);
+
+// 最上位の文の並び（bytecode_compile_scriptと同じ形）を検査する
+SlangError type_checker_check(TypeChecker* checker, ASTNode* const* nodes, size_t count);
+// 式の型（最上位の名前だけが見える）
+SlangError type_checker_infer(TypeChecker* checker, const ASTNode* expression, const Type** type);
+
+#endif // SLANG_TYPE_CHECKER_H
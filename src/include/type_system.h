@@ -2,7 +2,8 @@
 #define SLANG_TYPE_SYSTEM_H
 
 #include "common.h"
-#include "ast.h"
+
+struct ASTNode;
 
 // 型の種類
 typedef enum {
@@ -12,57 +13,145 @@ typedef enum {
     TYPE_BOOLEAN,
     TYPE_STRING,
     TYPE_ARRAY,
-    TYPE_STRUCT,
+    TYPE_TUPLE,
+    TYPE_VECTOR,
+    TYPE_MATRIX,
+    TYPE_TENSOR,
+    TYPE_QUATERNION,
+    TYPE_COMPLEX,
     TYPE_FUNCTION,
-    TYPE_TRAIT,
-    TYPE_GENERIC,
-    TYPE_ERROR
+    TYPE_NAMED                 // 名前だけで区別する型（汎用関数の型引数など）
 } TypeKind;
 
+// ベクトル・行列・四元数・複素数の配置
+// 要素は8バイト（double）で、SSE2の2要素ずつ読み書きできるように16バイト境界に置く。
+// vecNは要素数を偶数に切り上げ（vec3は32バイト）、行列は列優先で列ごとに切り上げる。
+// テンソルは最後の次元が連続で、そこを切り上げる。四元数は(w, x, y, z)で32バイト、複素数は16バイト。
+#define TYPE_ELEMENT_SIZE 8
+#define TYPE_SIMD_ALIGNMENT 16
+
 // 型の構造体
 typedef struct Type {
     TypeKind kind;
     size_t size;
+    size_t alignment;
     bool is_mutable;
+    bool interned;             // 型の表にある（共有されるので変更・解放しない）
     union {
         // 配列型
         struct {
             struct Type* element_type;
-            size_t length;
         } array;
-        
-        // 構造体型
+
+        // タプル型
         struct {
-            char* name;
-            Vector* fields;
-        } structure;
-        
+            struct Type** types;
+            size_t type_count;
+        } tuple;
+
+        // ベクトル型（vecN<T>）
+        struct {
+            struct Type* element_type;
+            size_t dimension;
+        } vector;
+
+        // 行列型（matRxC<T>）
+        struct {
+            struct Type* element_type;
+            size_t rows;
+            size_t columns;
+        } matrix;
+
+        // テンソル型（0の次元は実行時に決まる）
+        struct {
+            struct Type* element_type;
+            size_t* dimensions;
+            size_t dimension_count;
+        } tensor;
+
+        // 四元数型
+        struct {
+            struct Type* element_type;
+        } quaternion;
+
+        // 複素数型
+        struct {
+            struct Type* element_type;
+        } complex;
+
         // 関数型
         struct {
-            Vector* parameter_types;
+            struct Type** parameter_types;
+            size_t parameter_count;
             struct Type* return_type;
         } function;
-        
-        // トレイト型
-        struct {
-            char* name;
-            Vector* methods;
-        } trait;
-        
-        // ジェネリック型
+
+        // 名前の型（名前はインターン済み）
         struct {
             char* name;
-            Vector* type_parameters;
-        } generic;
-    } as;
+        } named;
+    } data;
 } Type;
 
 // 型システムの関数
-Type* type_create(TypeKind kind);
-void type_destroy(Type* type);
+// type_newの型は子の型ごとtype_freeで解放する（表の型は解放しない）
+Type* type_new(TypeKind kind);
+void type_free(Type* type);
 bool type_equals(const Type* a, const Type* b);
-Type* type_infer(ASTNode* node);
-SlangError type_check(ASTNode* node);
+bool type_is_compatible_with(const Type* type1, const Type* type2);
+// ownerの持ち主がvalueの持ち主から持ち主を引き継げるか（どちらも関数型で、引数と戻り値の型が合う）
+bool type_can_own(const Type* owner, const Type* value);
+const Type* type_infer(struct ASTNode* node);     // type_checker.hで最上位の名前だけが見える式の型を求める
+SlangError type_check(struct ASTNode* node);      // type_checker.hで1つの文を検査する
 char* type_to_string(const Type* type);
 
+bool type_is_vector(const Type* type);
+bool type_is_matrix(const Type* type);
+bool type_is_tensor(const Type* type);
+bool type_is_quaternion(const Type* type);
+bool type_is_complex(const Type* type);
+bool type_is_function(const Type* type);
+bool type_is_named(const Type* type);
+size_t type_get_vector_dimension(const Type* type);
+bool type_get_matrix_dimensions(const Type* type, size_t* rows, size_t* cols);
+size_t* type_get_tensor_dimensions(const Type* type, size_t* count);
+bool type_get_function_signature(const Type* type, Type*** params, size_t* param_count, Type** return_type);
+
+// sizeとalignmentを求める（次元と要素型を設定してから呼ぶ）
+void type_compute_layout(Type* type);
+// 要素ごとの演算（ir_emit_vector_binary）に渡す要素数（詰め物を含む。ベクトル型でなければ0）
+size_t type_simd_elements(const Type* type);
+
+// 組み込みの数学関数（vec3(x, y, z)・dot(a, b)・at(v, i)など。math_builtins.defを参照）
+typedef enum {
+#define MATH_BUILTIN(name, function, arguments) MATH_BUILTIN_##name,
+#include "math_builtins.def"
+#undef MATH_BUILTIN
+    MATH_BUILTIN_COUNT
+} MathBuiltin;
+
+// 型の表（hash-consing）
+// 構造が同じ型には常に同じポインタを返すので、表の型どうしはポインタ比較で等価判定できる。
+// プリミティブ型は1つずつで、複合型は子の型（表の型）とパラメータで引く。
+// 返す型はtype_table_shutdownまで有効で、変更・解放してはならない（type_freeは何もしない）。
+// 型は複数のスレッドから作ってよい（type_table_initとtype_table_shutdownはスレッドのないところで呼ぶ）。
+bool type_table_init(void);
+void type_table_shutdown(void);
+size_t type_table_count(void);
+const Type* type_primitive(TypeKind kind);
+const Type* type_array_of(const Type* element);
+const Type* type_tuple_of(const Type* const* types, size_t count);
+const Type* type_vector_of(const Type* element, size_t dimension);
+const Type* type_matrix_of(const Type* element, size_t rows, size_t columns);
+const Type* type_tensor_of(const Type* element, const size_t* dimensions, size_t count);
+const Type* type_quaternion_of(const Type* element);
+const Type* type_complex_of(const Type* element);
+const Type* type_function_of(const Type* const* parameters, size_t count, const Type* return_type);
+// type_function_ofと違い、引数と戻り値の型にNULL（実行時に決まる型）を含んでよい
+// （型検査が呼び出しに書き、コード生成が引数の渡し方を決めるのに使う。値の型としては使わない）
+const Type* type_signature_of(const Type* const* parameters, size_t count, const Type* return_type);
+const Type* type_named_of(const char* name);
+// type_newで組んだ型（子も含めて）と同じ構造の表の型
+const Type* type_canonical(const Type* type);
+
 #endif // SLANG_TYPE_SYSTEM_H 
\ No newline at end of file
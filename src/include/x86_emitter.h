@@ -0,0 +1,23 @@
+#ifndef SLANG_X86_EMITTER_H
+#define SLANG_X86_EMITTER_H
+
+#include "common.h"
+#include "asm_writer.h"
+#include "ir.h"
+#include "regalloc.h"
+
+// x86-64のアセンブリ出力（GAS、.intel_syntax noprefix、AsmWriterへ書く）
+// RegisterAllocationの置き場所に従って命令を選ぶ。整数は呼び出しをまたがなければ
+// caller-savedのGPR、浮動小数点数はXMMに置いたまま計算し、スタックに触れるのは
+// 溢れた値と引数の並列代入、IR_STACK_ALLOCの領域だけになる（ほかに要素の読み書きとベクトル演算が
+// ブロックに触れる）。IR_ALLOCとIR_DROPはmallocとfreeを呼ぶ。
+// 引数はSystem V ABIのレジスタ渡し（整数6個・浮動小数点数8個まで）のみ対応する。
+
+typedef struct {
+    size_t instructions;       // 出力した命令の数（ラベルを除く）
+    size_t memory_accesses;    // メモリを読み書きする命令の数（push/popを含む）
+} X86EmitStats;
+
+SlangError x86_emit_function(AsmWriter* out, const IrFunction* function, const RegisterAllocation* allocation, X86EmitStats* stats);
+
+#endif // SLANG_X86_EMITTER_H
@@ -0,0 +1,30 @@
+#ifndef SLANG_X86_ENCODER_H
+#define SLANG_X86_ENCODER_H
+
+#include "asm_writer.h"
+
+// x86-64の機械語エンコーダ
+// AsmWriterと同じ命令の種類とオペランドを受け取り、1命令分のバイト列を作る。
+// ラベルや記号を参照する32ビットの変位は0で出力し、位置と参照先をX86Encodingで返す
+// （ラベルは呼び出し側が後で書き換え、記号はリロケーションにする）。
+
+#define X86_MAX_INSTRUCTION_LENGTH 16
+
+typedef enum {
+    X86_FIXUP_NONE,
+    X86_FIXUP_LABEL,       // rel32（ラベルへの分岐）
+    X86_FIXUP_PC32,        // RIP相対の変位（データへの参照）
+    X86_FIXUP_PLT32        // 関数呼び出し
+} X86FixupKind;
+
+typedef struct {
+    uint8_t length;
+    uint8_t fixup;         // X86FixupKind
+    uint8_t fixup_offset;  // 命令の先頭からの変位の位置
+    AsmOperand target;     // 参照先（ASM_OPERAND_LABEL/GLOBAL/ADDRESS/STRING/SYMBOL）
+} X86Encoding;
+
+// 対応していない組み合わせならfalse
+bool x86_encode(AsmOp op, AsmOperand a, AsmOperand b, uint8_t* out, X86Encoding* encoding);
+
+#endif // SLANG_X86_ENCODER_H
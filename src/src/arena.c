@@ -0,0 +1,121 @@
+#include "../include/arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// 全ての割り当てをこの境界に揃える
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
+
+static size_t arena_align_up(size_t n) {
+    return (n + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+// ブロックのデータ領域の先頭
+static char* arena_block_data(ArenaBlock* block) {
+    return (char*)block + arena_align_up(sizeof(ArenaBlock));
+}
+
+// 新しいブロックを確保してリストの先頭に繋ぐ
+static ArenaBlock* arena_new_block(Arena* arena, size_t min_size) {
+    size_t size = arena->block_size;
+    if (size < min_size) size = min_size;
+
+    ArenaBlock* block = malloc(arena_align_up(sizeof(ArenaBlock)) + size);
+    if (block == NULL) return NULL;
+
+    block->next = arena->head;
+    block->size = size;
+    block->used = 0;
+    arena->head = block;
+    arena->total_allocated += size;
+    return block;
+}
+
+// アリーナの作成
+Arena* arena_create(size_t block_size) {
+    Arena* arena = malloc(sizeof(Arena));
+    if (arena == NULL) return NULL;
+
+    arena->head = NULL;
+    arena->block_size = block_size > 0 ? arena_align_up(block_size) : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->total_allocated = 0;
+    return arena;
+}
+
+// アリーナの破棄（全ブロックを一括解放）
+void arena_destroy(Arena* arena) {
+    if (arena == NULL) return;
+
+    ArenaBlock* block = arena->head;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+// アリーナの再利用（最後に確保したブロックだけを残す）
+void arena_reset(Arena* arena) {
+    if (arena == NULL || arena->head == NULL) return;
+
+    ArenaBlock* block = arena->head->next;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        arena->total_allocated -= block->size;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+// メモリの割り当て
+void* arena_alloc(Arena* arena, size_t size) {
+    if (arena == NULL) return NULL;
+
+    size = arena_align_up(size > 0 ? size : 1);
+    ArenaBlock* block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        ArenaBlock* current = arena->head;
+        block = arena_new_block(arena, size);
+        if (block == NULL) return NULL;
+
+        // ブロックサイズを超える要求は専用ブロックにし、現在のブロックの残りを使い続ける
+        if (size > arena->block_size && current != NULL) {
+            arena->head = current;
+            block->next = current->next;
+            current->next = block;
+        }
+    }
+
+    void* ptr = arena_block_data(block) + block->used;
+    block->used += size;
+    return ptr;
+}
+
+// メモリの複製
+void* arena_memdup(Arena* arena, const void* data, size_t size) {
+    if (data == NULL || size == 0) return NULL;
+
+    void* ptr = arena_alloc(arena, size);
+    if (ptr == NULL) return NULL;
+    memcpy(ptr, data, size);
+    return ptr;
+}
+
+// 文字列の複製
+char* arena_strndup(Arena* arena, const char* str, size_t length) {
+    if (str == NULL) return NULL;
+
+    char* copy = arena_alloc(arena, length + 1);
+    if (copy == NULL) return NULL;
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+char* arena_strdup(Arena* arena, const char* str) {
+    if (str == NULL) return NULL;
+    return arena_strndup(arena, str, strlen(str));
+}
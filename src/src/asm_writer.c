@@ -0,0 +1,667 @@
+#include "../include/asm_writer.h"
+#include "../include/elf_writer.h"
+#include "../include/x86_encoder.h"
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    const char* text;
+    uint8_t length;
+} AsmName;
+
+#define ASM_NAME(text) { text, sizeof(text) - 1 }
+
+static const AsmName mnemonics[ASM_OP_COUNT] = {
+#define ASM_OP(name, mnemonic) ASM_NAME(mnemonic),
+#include "../include/asm_ops.def"
+#undef ASM_OP
+};
+
+static const AsmName gpr64[16] = {
+    ASM_NAME("rax"), ASM_NAME("rcx"), ASM_NAME("rdx"), ASM_NAME("rbx"),
+    ASM_NAME("rsp"), ASM_NAME("rbp"), ASM_NAME("rsi"), ASM_NAME("rdi"),
+    ASM_NAME("r8"), ASM_NAME("r9"), ASM_NAME("r10"), ASM_NAME("r11"),
+    ASM_NAME("r12"), ASM_NAME("r13"), ASM_NAME("r14"), ASM_NAME("r15")
+};
+static const AsmName gpr32[16] = {
+    ASM_NAME("eax"), ASM_NAME("ecx"), ASM_NAME("edx"), ASM_NAME("ebx"),
+    ASM_NAME("esp"), ASM_NAME("ebp"), ASM_NAME("esi"), ASM_NAME("edi"),
+    ASM_NAME("r8d"), ASM_NAME("r9d"), ASM_NAME("r10d"), ASM_NAME("r11d"),
+    ASM_NAME("r12d"), ASM_NAME("r13d"), ASM_NAME("r14d"), ASM_NAME("r15d")
+};
+static const AsmName gpr8[16] = {
+    ASM_NAME("al"), ASM_NAME("cl"), ASM_NAME("dl"), ASM_NAME("bl"),
+    ASM_NAME("spl"), ASM_NAME("bpl"), ASM_NAME("sil"), ASM_NAME("dil"),
+    ASM_NAME("r8b"), ASM_NAME("r9b"), ASM_NAME("r10b"), ASM_NAME("r11b"),
+    ASM_NAME("r12b"), ASM_NAME("r13b"), ASM_NAME("r14b"), ASM_NAME("r15b")
+};
+
+// 1命令の最大の長さ（これだけの空きがあれば境界の確認なしに組み立てられる）
+#define ASM_MAX_LINE 256
+
+// オブジェクト出力のラベル
+// ラベルは関数の中でだけ参照されるので、関数の区切り（asm_symbol）ごとに解決して表を空にする
+typedef struct {
+    const char* scope;
+    uint64_t id;
+    int64_t offset;        // .textの位置（-1は未定義）
+} AsmLabel;
+
+typedef struct {
+    uint32_t label;
+    size_t position;       // rel32の.textの位置
+} AsmLabelFixup;
+
+struct AsmObject {
+    ElfObject* elf;
+    AsmLabel* labels;
+    size_t label_count;
+    size_t label_capacity;
+    uint32_t* label_index;  // ハッシュ -> ラベル番号 + 1
+    size_t index_capacity;
+    AsmLabelFixup* fixups;
+    size_t fixup_count;
+    size_t fixup_capacity;
+    bool dirty;            // 最後に書き出してから変わった
+};
+
+#define ASM_OBJECT_INITIAL_CAPACITY 64
+
+// 初期化（fdは呼び出し側が所有する）
+bool asm_writer_init(AsmWriter* writer, int fd) {
+    memset(writer, 0, sizeof(AsmWriter));
+    writer->fd = fd;
+    writer->buffer = malloc(ASM_WRITER_BUFFER_SIZE);
+    if (writer->buffer == NULL) {
+        writer->failed = true;
+        return false;
+    }
+    writer->capacity = ASM_WRITER_BUFFER_SIZE;
+    return true;
+}
+
+// ファイルを開いて初期化する
+bool asm_writer_open(AsmWriter* writer, const char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        memset(writer, 0, sizeof(AsmWriter));
+        writer->fd = -1;
+        writer->failed = true;
+        return false;
+    }
+    if (!asm_writer_init(writer, fd)) {
+        close(fd);
+        writer->fd = -1;
+        return false;
+    }
+    writer->owns_fd = true;
+    return true;
+}
+
+static void asm_object_destroy(AsmObject* object) {
+    if (object == NULL) return;
+    elf_object_destroy(object->elf);
+    free(object->labels);
+    free(object->label_index);
+    free(object->fixups);
+    free(object);
+}
+
+// オブジェクト出力の状態を作る（出力先は呼び出し側が決める）
+static bool asm_writer_init_object(AsmWriter* writer) {
+    memset(writer, 0, sizeof(AsmWriter));
+    writer->fd = -1;
+
+    AsmObject* object = calloc(1, sizeof(AsmObject));
+    if (object != NULL) {
+        object->elf = elf_object_create();
+        object->label_index = calloc(ASM_OBJECT_INITIAL_CAPACITY, sizeof(uint32_t));
+        object->index_capacity = ASM_OBJECT_INITIAL_CAPACITY;
+    }
+    if (object == NULL || object->elf == NULL || object->label_index == NULL) {
+        asm_object_destroy(object);
+        writer->failed = true;
+        return false;
+    }
+    writer->object = object;
+    object->dirty = true;
+    return true;
+}
+
+// ELFのオブジェクトファイルとして開く
+bool asm_writer_open_object(AsmWriter* writer, const char* path) {
+    if (!asm_writer_init_object(writer)) return false;
+
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) {
+        asm_object_destroy(writer->object);
+        writer->object = NULL;
+        writer->failed = true;
+        return false;
+    }
+    writer->owns_fd = true;
+    return true;
+}
+
+// メモリ上のオブジェクトとして開く
+bool asm_writer_open_memory(AsmWriter* writer) {
+    return asm_writer_init_object(writer);
+}
+
+const ElfObject* asm_writer_elf(const AsmWriter* writer) {
+    return writer->object != NULL ? writer->object->elf : NULL;
+}
+
+static bool asm_object_resolve_labels(AsmWriter* writer);
+
+// オブジェクト全体を書き直す
+static bool asm_object_flush(AsmWriter* writer) {
+    AsmObject* object = writer->object;
+    if (writer->failed || !asm_object_resolve_labels(writer)) return false;
+    if (!object->dirty || writer->fd < 0) return true;
+
+    if (lseek(writer->fd, 0, SEEK_SET) < 0 || ftruncate(writer->fd, 0) != 0 ||
+        !elf_object_write(object->elf, writer->fd)) {
+        writer->failed = true;
+        return false;
+    }
+    off_t size = lseek(writer->fd, 0, SEEK_CUR);
+    writer->bytes_written = size > 0 ? (size_t)size : 0;
+    object->dirty = false;
+    return true;
+}
+
+// バッファの中身をすべて書き出す
+bool asm_writer_flush(AsmWriter* writer) {
+    if (writer->object != NULL) return asm_object_flush(writer);
+
+    size_t written = 0;
+    while (!writer->failed && written < writer->length) {
+        ssize_t result = write(writer->fd, writer->buffer + written, writer->length - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            writer->failed = true;
+            break;
+        }
+        written += (size_t)result;
+    }
+    writer->bytes_written += written;
+    writer->length = 0;
+    return !writer->failed;
+}
+
+// 書き出して閉じる
+bool asm_writer_close(AsmWriter* writer) {
+    bool ok = (writer->buffer != NULL || writer->object != NULL) && asm_writer_flush(writer);
+    if (writer->owns_fd && writer->fd >= 0 && close(writer->fd) != 0) ok = false;
+    free(writer->buffer);
+    writer->buffer = NULL;
+    asm_object_destroy(writer->object);
+    writer->object = NULL;
+    writer->fd = -1;
+    writer->owns_fd = false;
+    return ok && !writer->failed;
+}
+
+size_t asm_writer_mark(AsmWriter* writer) {
+    writer->holds++;
+    return writer->object != NULL ? writer->object->elf->text.size : writer->length;
+}
+
+void asm_writer_commit(AsmWriter* writer) {
+    if (writer->holds > 0) writer->holds--;
+}
+
+void asm_writer_rollback(AsmWriter* writer, size_t mark) {
+    AsmObject* object = writer->object;
+    if (object != NULL) {
+        // mark以降に定義されたラベル・記号と、そこからの参照を捨てる
+        size_t kept = 0;
+        for (size_t i = 0; i < object->fixup_count; i++) {
+            if (object->fixups[i].position < mark) object->fixups[kept++] = object->fixups[i];
+        }
+        object->fixup_count = kept;
+        for (size_t i = 0; i < object->label_count; i++) {
+            if (object->labels[i].offset >= (int64_t)mark) object->labels[i].offset = -1;
+        }
+        elf_object_truncate_text(object->elf, mark);
+    } else if (mark <= writer->length) {
+        writer->length = mark;
+    }
+    asm_writer_commit(writer);
+}
+
+// 少なくともneededバイトの空きを作る
+static bool asm_reserve(AsmWriter* writer, size_t needed) {
+    if (writer->failed) return false;
+    if (writer->capacity - writer->length >= needed) return true;
+
+    // 取り消せる区間の途中では書き出さずに伸ばす
+    if (writer->holds == 0) {
+        if (!asm_writer_flush(writer)) return false;
+        if (writer->capacity >= needed) return true;
+    }
+
+    size_t capacity = writer->capacity;
+    while (capacity - writer->length < needed) capacity *= 2;
+    char* buffer = realloc(writer->buffer, capacity);
+    if (buffer == NULL) {
+        writer->failed = true;
+        return false;
+    }
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    return true;
+}
+
+void asm_write(AsmWriter* writer, const char* text, size_t length) {
+    if (writer->object != NULL || !asm_reserve(writer, length)) return;
+    memcpy(writer->buffer + writer->length, text, length);
+    writer->length += length;
+}
+
+void asm_text(AsmWriter* writer, const char* text) {
+    asm_write(writer, text, strlen(text));
+}
+
+// 以下は空きを確保済みのバッファへの直接の書き込み
+static char* put_name(char* out, const AsmName* name) {
+    memcpy(out, name->text, name->length);
+    return out + name->length;
+}
+
+static char* put_literal(char* out, const char* text, size_t length) {
+    memcpy(out, text, length);
+    return out + length;
+}
+
+#define PUT_LITERAL(out, text) put_literal(out, text, sizeof(text) - 1)
+
+static char* put_unsigned(char* out, uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count > 0) *out++ = digits[--count];
+    return out;
+}
+
+static char* put_signed(char* out, int64_t value) {
+    if (value < 0) {
+        *out++ = '-';
+        return put_unsigned(out, (uint64_t)0 - (uint64_t)value);
+    }
+    return put_unsigned(out, (uint64_t)value);
+}
+
+// 名前付きの記号はASM_MAX_LINEの余裕を超えうるので長さを制限する
+static char* put_symbol(char* out, const char* symbol) {
+    size_t length = 0;
+    while (length < ASM_MAX_LINE / 2 && symbol[length] != '\0') length++;
+    return put_literal(out, symbol, length);
+}
+
+static char* put_displacement(char* out, int64_t displacement) {
+    if (displacement > 0) {
+        out = PUT_LITERAL(out, " + ");
+        out = put_unsigned(out, (uint64_t)displacement);
+    } else if (displacement < 0) {
+        out = PUT_LITERAL(out, " - ");
+        out = put_unsigned(out, (uint64_t)0 - (uint64_t)displacement);
+    }
+    return out;
+}
+
+static char* put_label(char* out, const char* scope, uint64_t id) {
+    out = PUT_LITERAL(out, ".L");
+    if (scope != NULL) {
+        out = put_symbol(out, scope);
+        *out++ = '_';
+    }
+    return put_unsigned(out, id);
+}
+
+static char* put_operand(char* out, const AsmOperand* operand) {
+    switch (operand->kind) {
+        case ASM_OPERAND_REG64: return put_name(out, &gpr64[operand->reg & 15]);
+        case ASM_OPERAND_REG32: return put_name(out, &gpr32[operand->reg & 15]);
+        case ASM_OPERAND_REG8:  return put_name(out, &gpr8[operand->reg & 15]);
+        case ASM_OPERAND_XMM:
+            out = PUT_LITERAL(out, "xmm");
+            return put_unsigned(out, operand->reg);
+        case ASM_OPERAND_IMM:
+            return put_signed(out, operand->value);
+        case ASM_OPERAND_FRAME:
+            out = PUT_LITERAL(out, "qword ptr [rbp");
+            out = put_displacement(out, operand->value);
+            *out++ = ']';
+            return out;
+        case ASM_OPERAND_STACK:
+            out = PUT_LITERAL(out, "qword ptr [rsp");
+            out = put_displacement(out, operand->value);
+            *out++ = ']';
+            return out;
+        case ASM_OPERAND_BASE:
+            *out++ = '[';
+            out = put_name(out, &gpr64[operand->reg & 15]);
+            out = put_displacement(out, operand->value);
+            *out++ = ']';
+            return out;
+        case ASM_OPERAND_GLOBAL:
+            out = PUT_LITERAL(out, "qword ptr [rip + ");
+            out = put_symbol(out, operand->symbol);
+            *out++ = ']';
+            return out;
+        case ASM_OPERAND_ADDRESS:
+            out = PUT_LITERAL(out, "[rip + ");
+            out = put_symbol(out, operand->symbol);
+            *out++ = ']';
+            return out;
+        case ASM_OPERAND_STRING:
+            out = PUT_LITERAL(out, "[rip + str_");
+            out = put_unsigned(out, (uint64_t)operand->value);
+            *out++ = ']';
+            return out;
+        case ASM_OPERAND_LABEL:
+            return put_label(out, operand->symbol, (uint64_t)operand->value);
+        case ASM_OPERAND_SYMBOL:
+            return put_symbol(out, operand->symbol);
+        default:
+            return out;
+    }
+}
+
+void asm_decimal(AsmWriter* writer, int64_t value) {
+    if (writer->object != NULL || !asm_reserve(writer, 24)) return;
+    char* out = writer->buffer + writer->length;
+    writer->length = (size_t)(put_signed(out, value) - writer->buffer);
+}
+
+// ラベルの検索（なければ未定義のラベルを作る）。失敗したらUINT32_MAX
+static uint32_t asm_object_label(AsmObject* object, const char* scope, uint64_t id) {
+    size_t mask = object->index_capacity - 1;
+    size_t slot = (size_t)(id * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    while (object->label_index[slot] != 0) {
+        const AsmLabel* label = &object->labels[object->label_index[slot] - 1];
+        if (label->id == id && (label->scope == scope ||
+                                (label->scope != NULL && scope != NULL && strcmp(label->scope, scope) == 0))) {
+            return object->label_index[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (object->label_count == object->label_capacity) {
+        size_t capacity = object->label_capacity ? object->label_capacity * 2 : ASM_OBJECT_INITIAL_CAPACITY;
+        AsmLabel* labels = realloc(object->labels, capacity * sizeof(AsmLabel));
+        if (labels == NULL) return UINT32_MAX;
+        object->labels = labels;
+        object->label_capacity = capacity;
+    }
+    uint32_t index = (uint32_t)object->label_count++;
+    object->labels[index] = (AsmLabel){ scope, id, -1 };
+    object->label_index[slot] = index + 1;
+
+    // 埋まり具合を半分以下に保つ
+    if (object->label_count * 2 > object->index_capacity) {
+        size_t capacity = object->index_capacity * 2;
+        uint32_t* table = calloc(capacity, sizeof(uint32_t));
+        if (table == NULL) return UINT32_MAX;
+        for (size_t i = 0; i < object->label_count; i++) {
+            size_t position = (size_t)(object->labels[i].id * 0x9E3779B97F4A7C15ull >> 32) & (capacity - 1);
+            while (table[position] != 0) position = (position + 1) & (capacity - 1);
+            table[position] = (uint32_t)i + 1;
+        }
+        free(object->label_index);
+        object->label_index = table;
+        object->index_capacity = capacity;
+    }
+    return index;
+}
+
+// 関数内の分岐先を書き込み、ラベル表を空にする
+static bool asm_object_resolve_labels(AsmWriter* writer) {
+    AsmObject* object = writer->object;
+    uint8_t* text = object->elf->text.data;
+
+    for (size_t i = 0; i < object->fixup_count; i++) {
+        const AsmLabelFixup* fixup = &object->fixups[i];
+        int64_t target = object->labels[fixup->label].offset;
+        if (target < 0) {
+            writer->failed = true;
+            return false;
+        }
+        uint32_t rel = (uint32_t)(int32_t)(target - (int64_t)(fixup->position + 4));
+        for (int b = 0; b < 4; b++) text[fixup->position + b] = (uint8_t)(rel >> (8 * b));
+    }
+    object->fixup_count = 0;
+    object->label_count = 0;
+    memset(object->label_index, 0, object->index_capacity * sizeof(uint32_t));
+    return true;
+}
+
+// 記号を参照する変位をリロケーションにする
+static bool asm_object_relocate(AsmObject* object, const X86Encoding* encoding, size_t start) {
+    const AsmOperand* target = &encoding->target;
+    char name[32];
+    const char* symbol = target->symbol;
+    if (target->kind == ASM_OPERAND_STRING) {
+        snprintf(name, sizeof(name), "str_%" PRIu64, (uint64_t)target->value);
+        symbol = name;
+    }
+
+    uint32_t index = elf_object_symbol(object->elf, symbol);
+    // 変位はRIP（命令の末尾）からの距離なので、変位の位置から命令末尾までを引く
+    int64_t addend = (int64_t)encoding->fixup_offset - (int64_t)encoding->length;
+    uint32_t type = encoding->fixup == X86_FIXUP_PLT32 ? R_X86_64_PLT32 : R_X86_64_PC32;
+    return index != 0 && elf_object_relocate(object->elf, start + encoding->fixup_offset, index, type, addend);
+}
+
+static void asm_object_emit(AsmWriter* writer, AsmOp op, AsmOperand a, AsmOperand b) {
+    AsmObject* object = writer->object;
+    uint8_t code[X86_MAX_INSTRUCTION_LENGTH];
+    X86Encoding encoding;
+    if (!x86_encode(op, a, b, code, &encoding)) {
+        writer->failed = true;
+        return;
+    }
+
+    size_t start = object->elf->text.size;
+    if (!elf_buffer_append(&object->elf->text, code, encoding.length)) {
+        writer->failed = true;
+        return;
+    }
+    object->dirty = true;
+
+    if (encoding.fixup == X86_FIXUP_LABEL) {
+        uint32_t label = asm_object_label(object, encoding.target.symbol, (uint64_t)encoding.target.value);
+        if (label == UINT32_MAX) {
+            writer->failed = true;
+            return;
+        }
+        if (object->fixup_count == object->fixup_capacity) {
+            size_t capacity = object->fixup_capacity ? object->fixup_capacity * 2 : ASM_OBJECT_INITIAL_CAPACITY;
+            AsmLabelFixup* fixups = realloc(object->fixups, capacity * sizeof(AsmLabelFixup));
+            if (fixups == NULL) {
+                writer->failed = true;
+                return;
+            }
+            object->fixups = fixups;
+            object->fixup_capacity = capacity;
+        }
+        object->fixups[object->fixup_count++] = (AsmLabelFixup){ label, start + encoding.fixup_offset };
+    } else if (encoding.fixup != X86_FIXUP_NONE && !asm_object_relocate(object, &encoding, start)) {
+        writer->failed = true;
+    }
+}
+
+// 命令1つ（"    op a, b\n"）
+void asm_emit(AsmWriter* writer, AsmOp op, AsmOperand a, AsmOperand b) {
+    if (writer->object != NULL) {
+        if (!writer->failed) asm_object_emit(writer, op, a, b);
+        return;
+    }
+    if (op >= ASM_OP_COUNT || !asm_reserve(writer, ASM_MAX_LINE * 2)) return;
+
+    char* out = writer->buffer + writer->length;
+    out = PUT_LITERAL(out, "    ");
+    out = put_name(out, &mnemonics[op]);
+    if (a.kind != ASM_OPERAND_NONE) {
+        *out++ = ' ';
+        out = put_operand(out, &a);
+        if (b.kind != ASM_OPERAND_NONE) {
+            *out++ = ',';
+            *out++ = ' ';
+            out = put_operand(out, &b);
+        }
+    }
+    *out++ = '\n';
+    writer->length = (size_t)(out - writer->buffer);
+}
+
+void asm_label(AsmWriter* writer, const char* scope, uint64_t id) {
+    AsmObject* object = writer->object;
+    if (object != NULL) {
+        if (writer->failed) return;
+        uint32_t label = asm_object_label(object, scope, id);
+        if (label == UINT32_MAX || object->labels[label].offset >= 0) {
+            writer->failed = true;
+            return;
+        }
+        object->labels[label].offset = (int64_t)object->elf->text.size;
+        return;
+    }
+
+    if (!asm_reserve(writer, ASM_MAX_LINE)) return;
+    char* out = put_label(writer->buffer + writer->length, scope, id);
+    *out++ = ':';
+    *out++ = '\n';
+    writer->length = (size_t)(out - writer->buffer);
+}
+
+// 関数の先頭
+void asm_symbol(AsmWriter* writer, const char* name) {
+    AsmObject* object = writer->object;
+    if (object != NULL) {
+        if (writer->failed || !asm_object_resolve_labels(writer)) return;
+        uint32_t symbol = elf_object_symbol(object->elf, name);
+        if (!elf_object_define(object->elf, symbol, ELF_SECTION_TEXT, object->elf->text.size, true)) {
+            writer->failed = true;
+        }
+        object->dirty = true;
+        return;
+    }
+
+    asm_text(writer, name);
+    asm_write(writer, ":\n", 2);
+}
+
+void asm_global_symbol(AsmWriter* writer, const char* name) {
+    if (writer->object != NULL) {
+        uint32_t symbol = elf_object_symbol(writer->object->elf, name);
+        if (symbol == 0) writer->failed = true;
+        elf_object_set_global(writer->object->elf, symbol);
+        return;
+    }
+
+    asm_text(writer, ".global ");
+    asm_text(writer, name);
+    asm_write(writer, "\n", 1);
+}
+
+void asm_weak_symbol(AsmWriter* writer, const char* name) {
+    if (writer->object != NULL) {
+        uint32_t symbol = elf_object_symbol(writer->object->elf, name);
+        if (symbol == 0) writer->failed = true;
+        elf_object_set_weak(writer->object->elf, symbol);
+        return;
+    }
+
+    asm_text(writer, ".weak ");
+    asm_text(writer, name);
+    asm_write(writer, "\n", 1);
+}
+
+void asm_string_literal(AsmWriter* writer, size_t index, const char* text) {
+    AsmObject* object = writer->object;
+    if (object != NULL) {
+        char name[32];
+        snprintf(name, sizeof(name), "str_%zu", index);
+        ElfBuffer* data = &object->elf->data;
+        uint32_t symbol = elf_object_symbol(object->elf, name);
+        if (!elf_object_define(object->elf, symbol, ELF_SECTION_DATA, data->size, false) ||
+            !elf_buffer_append(data, text, strlen(text) + 1)) {
+            writer->failed = true;
+        }
+        object->dirty = true;
+        return;
+    }
+
+    asm_text(writer, "str_");
+    asm_decimal(writer, (int64_t)index);
+    asm_text(writer, ": .asciz \"");
+    // .oと同じバイト列になるように、引用符・バックスラッシュ・制御文字は8進数のエスケープにする
+    for (const unsigned char* p = (const unsigned char*)text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\' || *p < 0x20 || *p == 0x7F) {
+            char escape[4] = { '\\', (char)('0' + (*p >> 6)), (char)('0' + ((*p >> 3) & 7)), (char)('0' + (*p & 7)) };
+            asm_write(writer, escape, sizeof(escape));
+        } else {
+            asm_write(writer, (const char*)p, 1);
+        }
+    }
+    asm_write(writer, "\"\n", 2);
+}
+
+void asm_global_variable(AsmWriter* writer, const char* name, int64_t value) {
+    AsmObject* object = writer->object;
+    if (object != NULL) {
+        // x86-64はリトルエンディアンなので、値のバイト列をそのまま置く
+        ElfBuffer* data = &object->elf->data;
+        uint32_t symbol = elf_object_symbol(object->elf, name);
+        if (!elf_buffer_align(data, 8) ||
+            !elf_object_define(object->elf, symbol, ELF_SECTION_DATA, data->size, false) ||
+            !elf_buffer_append(data, &value, sizeof(value))) {
+            writer->failed = true;
+        }
+        object->dirty = true;
+        return;
+    }
+
+    asm_text(writer, name);
+    asm_text(writer, ": .quad ");
+    asm_decimal(writer, value);
+    asm_write(writer, "\n", 1);
+}
+
+void asm_absolute_symbol(AsmWriter* writer, const char* name, int64_t value) {
+    AsmObject* object = writer->object;
+    if (object != NULL) {
+        uint32_t symbol = elf_object_symbol(object->elf, name);
+        if (!elf_object_define(object->elf, symbol, ELF_SECTION_ABSOLUTE, (uint64_t)value, false)) {
+            writer->failed = true;
+        }
+        object->dirty = true;
+        return;
+    }
+
+    asm_text(writer, ".set ");
+    asm_text(writer, name);
+    asm_text(writer, ", ");
+    asm_decimal(writer, value);
+    asm_write(writer, "\n", 1);
+}
+
+const char* asm_register_name(X86Register reg) {
+    return gpr64[reg & 15].text;
+}
+
+const char* asm_mnemonic(AsmOp op) {
+    return op < ASM_OP_COUNT ? mnemonics[op].text : "";
+}
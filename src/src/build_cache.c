@@ -0,0 +1,574 @@
+#define _GNU_SOURCE
+#include "../include/build_cache.h"
+#include "../include/intern.h"
+#include "../include/lexer.h"
+#include "../include/source.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BUILD_CACHE_INITIAL_CAPACITY 64
+#define BUILD_CACHE_PATH_MAX 4096
+#define BUILD_CACHE_COPY_CHUNK (64 * 1024)
+#define BUILD_CACHE_INDEX_HEADER "slang-build-index 1"
+
+// ハッシュ
+
+static uint64_t hash_word(uint64_t hash, uint64_t word) {
+    word *= 0x9e3779b97f4a7c15ull;
+    word ^= word >> 32;
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    return hash ^ (hash >> 29);
+}
+
+uint64_t build_cache_hash(const void* data, size_t length, uint64_t seed) {
+    const uint8_t* bytes = data;
+    uint64_t hash = hash_word(seed, length);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = hash_word(hash, word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, length - i);
+    return hash_word(hash, tail ^ ((uint64_t)(length - i) << 56));
+}
+
+static uint64_t hash_string(uint64_t hash, const char* text) {
+    return build_cache_hash(text, strlen(text), hash);
+}
+
+// 容量を倍にしながら配列を伸ばす
+static bool grow_array(void** data, size_t* capacity, size_t needed, size_t element_size) {
+    if (needed <= *capacity) return true;
+
+    size_t new_capacity = *capacity ? *capacity : BUILD_CACHE_INITIAL_CAPACITY;
+    while (new_capacity < needed) new_capacity *= 2;
+
+    void* new_data = realloc(*data, new_capacity * element_size);
+    if (new_data == NULL) return false;
+    *data = new_data;
+    *capacity = new_capacity;
+    return true;
+}
+
+// ファイル
+
+static bool write_all(int fd, const char* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = write(fd, data + written, size - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += (size_t)result;
+    }
+    return true;
+}
+
+static bool copy_file(const char* from, const char* to) {
+    int in = open(from, O_RDONLY);
+    if (in < 0) return false;
+    int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    char buffer[BUILD_CACHE_COPY_CHUNK];
+    bool ok = true;
+    for (;;) {
+        ssize_t count = read(in, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            ok = count == 0;
+            break;
+        }
+        if (!write_all(out, buffer, (size_t)count)) {
+            ok = false;
+            break;
+        }
+    }
+    close(in);
+    return close(out) == 0 && ok;
+}
+
+static bool entry_path(const BuildCache* cache, char* buffer, uint64_t key, const char* extension) {
+    int length = snprintf(buffer, BUILD_CACHE_PATH_MAX, "%s/%016" PRIx64 "%s", cache->directory, key, extension);
+    return length > 0 && length < BUILD_CACHE_PATH_MAX;
+}
+
+// 単位
+
+static size_t unit_index(BuildCache* cache, const char* path, bool* created) {
+    *created = false;
+    const char* handle = intern_cstr(path);
+    if (handle == NULL) return SIZE_MAX;
+    const Symbol* symbol = symbol_table_lookup(&cache->paths, handle);
+    if (symbol != NULL) return symbol->slot;
+
+    if (!grow_array((void**)&cache->units, &cache->unit_capacity, cache->unit_count + 1, sizeof(BuildUnit))) {
+        return SIZE_MAX;
+    }
+    BuildUnit* unit = &cache->units[cache->unit_count];
+    memset(unit, 0, sizeof(BuildUnit));
+    unit->path = handle;
+    if (!symbol_table_define(&cache->paths, handle, (uint32_t)cache->unit_count)) return SIZE_MAX;
+    *created = true;
+    return cache->unit_count++;
+}
+
+static void unit_set_dependencies(BuildUnit* unit, const char** dependencies, size_t count) {
+    free(unit->dependencies);
+    unit->dependencies = dependencies;
+    unit->dependency_count = count;
+}
+
+// 同じファイルが1つの単位になるよう、「.」の要素と「要素/..」を取り除く（シンボリックリンクは辿らない）
+static void normalize_path(char* path) {
+    bool absolute = path[0] == '/';
+    char* out = path + absolute;
+    size_t kept = 0;           // 取り除ける（「..」でない）要素の数
+    const char* p = out;
+    while (*p != '\0') {
+        const char* end = strchr(p, '/');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        if (length == 0 || (length == 1 && p[0] == '.')) {
+            // 空の要素と「.」は飛ばす
+        } else if (length == 2 && p[0] == '.' && p[1] == '.' && kept > 0) {
+            // 直前の要素を戻す
+            out--;
+            while (out > path + absolute && out[-1] != '/') out--;
+            kept--;
+        } else if (!(length == 2 && p[0] == '.' && p[1] == '.' && absolute)) {
+            memmove(out, p, length);
+            out += length;
+            if (end != NULL) *out++ = '/';
+            if (!(length == 2 && p[0] == '.' && p[1] == '.')) kept++;
+        }
+        p += length + (end != NULL);
+    }
+    if (out > path + absolute && out[-1] == '/') out--;
+    if (out == path) *out++ = '.';
+    *out = '\0';
+}
+
+// 使う側のファイルのディレクトリからの相対パスにする
+static bool join_relative(char* buffer, const char* from, const char* relative, size_t relative_length) {
+    const char* slash = strrchr(from, '/');
+    size_t prefix = relative[0] == '/' || slash == NULL ? 0 : (size_t)(slash - from) + 1;
+    if (prefix + relative_length + 1 > BUILD_CACHE_PATH_MAX) return false;
+    memcpy(buffer, from, prefix);
+    memcpy(buffer + prefix, relative, relative_length);
+    buffer[prefix + relative_length] = '\0';
+    normalize_path(buffer);
+    return true;
+}
+
+static bool file_exists(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// use宣言を字句解析で集める（文字列やコメントの中のuseは数えない）
+static bool scan_uses(const BuildUnit* unit, const char* data, size_t length, const char*** dependencies, size_t* count) {
+    *dependencies = NULL;
+    *count = 0;
+    size_t capacity = 0;
+    Lexer* lexer = lexer_create_streaming(data, length, LEXER_DEFAULT_RING_CAPACITY);
+    if (lexer == NULL) return false;
+
+    char relative[BUILD_CACHE_PATH_MAX];
+    char path[BUILD_CACHE_PATH_MAX];
+    bool ok = true;
+    for (Token* token = lexer_next_token(lexer); token != NULL && token->type != TOKEN_EOF; token = lexer_next_token(lexer)) {
+        if (token->type != TOKEN_USE) continue;
+        token = lexer_next_token(lexer);
+        if (token == NULL) break;
+
+        size_t used = 0;
+        bool resolved = false;
+        if (token->type == TOKEN_STRING && token->length >= 2) {
+            resolved = join_relative(path, unit->path, lexer_token_start(lexer, token) + 1, token->length - 2);
+        } else if (token->type == TOKEN_IDENTIFIER) {
+            // a.b.c → a/b/c.sl（なければa/b/c.sls）
+            for (;;) {
+                if (used + token->length + 1 >= sizeof(relative) - 4) break;
+                memcpy(relative + used, lexer_token_start(lexer, token), token->length);
+                used += token->length;
+                Token* next = lexer_peek_token(lexer);
+                if (next == NULL || next->type != TOKEN_DOT) break;
+                lexer_next_token(lexer);
+                token = lexer_next_token(lexer);
+                if (token == NULL || token->type != TOKEN_IDENTIFIER) break;
+                relative[used++] = '/';
+            }
+            memcpy(relative + used, ".sl", 4);
+            resolved = join_relative(path, unit->path, relative, used + 3);
+            if (resolved && !file_exists(path)) {
+                memcpy(relative + used, ".sls", 5);
+                char alternative[BUILD_CACHE_PATH_MAX];
+                if (join_relative(alternative, unit->path, relative, used + 4) && file_exists(alternative)) {
+                    memcpy(path, alternative, strlen(alternative) + 1);
+                }
+            }
+        }
+        if (!resolved) continue;
+
+        const char* handle = intern_cstr(path);
+        if (handle == NULL || !grow_array((void**)dependencies, &capacity, *count + 1, sizeof(const char*))) {
+            ok = false;
+            break;
+        }
+        (*dependencies)[(*count)++] = handle;
+    }
+    lexer_destroy(lexer);
+    return ok;
+}
+
+// 時刻と大きさが記録と同じなら記録を使い、違えば読み直す
+static SlangError unit_refresh(BuildCache* cache, size_t index) {
+    BuildUnit* unit = &cache->units[index];
+    if (unit->refreshed) return SLANG_SUCCESS;
+    unit->refreshed = true;
+
+    struct stat info;
+    if (stat(unit->path, &info) != 0 || !S_ISREG(info.st_mode)) {
+        if (!unit->missing || unit->source_hash != 0) cache->dirty = true;
+        unit->missing = true;
+        unit->source_hash = 0;
+        unit_set_dependencies(unit, NULL, 0);
+        return SLANG_SUCCESS;
+    }
+
+    int64_t mtime_ns = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    if (!unit->missing && unit->source_hash != 0 && unit->mtime_ns == mtime_ns && unit->size == (uint64_t)info.st_size) {
+        return SLANG_SUCCESS;
+    }
+
+    SourceFile* source = source_open(unit->path);
+    if (source == NULL) return SLANG_ERROR_IO;
+    uint64_t hash = build_cache_hash(source->data, source->length, 0) | 1;
+    const char** dependencies;
+    size_t count;
+    bool scanned = scan_uses(unit, source->data, source->length, &dependencies, &count);
+    source_close(source);
+    if (!scanned) return SLANG_ERROR_INTERNAL;
+
+    unit->missing = false;
+    unit->mtime_ns = mtime_ns;
+    unit->size = (uint64_t)info.st_size;
+    unit->source_hash = hash;
+    unit_set_dependencies(unit, dependencies, count);
+    cache->dirty = true;
+    cache->scanned_count++;
+    return SLANG_SUCCESS;
+}
+
+// キーと強連結成分（Tarjanの方法）
+// 成分は依存先から順に確定するので、成分のキーには依存先の成分のキーを混ぜられる。
+
+static int compare_units(const void* a, const void* b, void* context) {
+    const BuildUnit* units = context;
+    return strcmp(units[*(const uint32_t*)a].path, units[*(const uint32_t*)b].path);
+}
+
+static int compare_keys(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static SlangError finish_component(BuildCache* cache, uint32_t* members, size_t member_count) {
+    // 辿り始めた単位によらず同じキーになるよう、パスの順に混ぜる
+    qsort_r(members, member_count, sizeof(uint32_t), compare_units, cache->units);
+
+    uint64_t* external = NULL;
+    size_t external_count = 0, external_capacity = 0;
+    uint64_t hash = cache->flags_hash;
+    for (size_t i = 0; i < member_count; i++) {
+        BuildUnit* unit = &cache->units[members[i]];
+        unit->on_stack = false;
+        hash = hash_string(hash, unit->path);
+        hash = hash_word(hash, unit->source_hash);
+        for (size_t d = 0; d < unit->dependency_count; d++) {
+            const BuildUnit* dependency = &cache->units[symbol_table_lookup(&cache->paths, unit->dependencies[d])->slot];
+            if (!dependency->has_key) continue;  // 同じ成分
+            if (!grow_array((void**)&external, &external_capacity, external_count + 1, sizeof(uint64_t))) {
+                free(external);
+                return SLANG_ERROR_INTERNAL;
+            }
+            external[external_count++] = dependency->key;
+        }
+    }
+
+    if (external_count > 1) qsort(external, external_count, sizeof(uint64_t), compare_keys);
+    for (size_t i = 0; i < external_count; i++) {
+        if (i == 0 || external[i] != external[i - 1]) hash = hash_word(hash, external[i]);
+    }
+    free(external);
+
+    uint32_t component = (uint32_t)cache->component_count++;
+    for (size_t i = 0; i < member_count; i++) {
+        BuildUnit* unit = &cache->units[members[i]];
+        unit->key = hash_string(hash, unit->path);
+        unit->has_key = true;
+        unit->component = component;
+    }
+    return SLANG_SUCCESS;
+}
+
+static SlangError strong_connect(BuildCache* cache, size_t index) {
+    SlangError error = unit_refresh(cache, index);
+    if (error != SLANG_SUCCESS) return error;
+
+    if (!grow_array((void**)&cache->tarjan_stack, &cache->tarjan_capacity, cache->tarjan_depth + 1, sizeof(uint32_t))) {
+        return SLANG_ERROR_INTERNAL;
+    }
+    cache->tarjan_stack[cache->tarjan_depth++] = (uint32_t)index;
+    BuildUnit* unit = &cache->units[index];
+    unit->tarjan_index = unit->tarjan_low = ++cache->tarjan_counter;
+    unit->on_stack = true;
+
+    for (size_t d = 0; d < cache->units[index].dependency_count; d++) {
+        bool created;
+        size_t target = unit_index(cache, cache->units[index].dependencies[d], &created);
+        if (target == SIZE_MAX) return SLANG_ERROR_INTERNAL;
+        // unitsは伸びると動くので、番号で引き直す
+        if (cache->units[target].has_key) continue;
+        if (cache->units[target].tarjan_index == 0) {
+            error = strong_connect(cache, target);
+            if (error != SLANG_SUCCESS) return error;
+            if (cache->units[target].tarjan_low < cache->units[index].tarjan_low) {
+                cache->units[index].tarjan_low = cache->units[target].tarjan_low;
+            }
+        } else if (cache->units[target].on_stack && cache->units[target].tarjan_index < cache->units[index].tarjan_low) {
+            cache->units[index].tarjan_low = cache->units[target].tarjan_index;
+        }
+    }
+
+    unit = &cache->units[index];
+    if (unit->tarjan_low != unit->tarjan_index) return SLANG_SUCCESS;
+
+    size_t start = cache->tarjan_depth;
+    while (cache->tarjan_stack[--start] != index) {}
+    error = finish_component(cache, cache->tarjan_stack + start, cache->tarjan_depth - start);
+    cache->tarjan_depth = start;
+    return error;
+}
+
+SlangError build_cache_key(BuildCache* cache, const char* path, uint64_t* key) {
+    char normalized[BUILD_CACHE_PATH_MAX];
+    if (strlen(path) >= sizeof(normalized)) return SLANG_ERROR_IO;
+    strcpy(normalized, path);
+    normalize_path(normalized);
+
+    bool created;
+    size_t index = unit_index(cache, normalized, &created);
+    if (index == SIZE_MAX) return SLANG_ERROR_INTERNAL;
+    if (!cache->units[index].has_key) {
+        SlangError error = strong_connect(cache, index);
+        if (error != SLANG_SUCCESS) return error;
+    }
+    *key = cache->units[index].key;
+    return SLANG_SUCCESS;
+}
+
+const BuildUnit* build_cache_unit(const BuildCache* cache, const char* path) {
+    char normalized[BUILD_CACHE_PATH_MAX];
+    if (strlen(path) >= sizeof(normalized)) return NULL;
+    strcpy(normalized, path);
+    normalize_path(normalized);
+    const char* handle = intern_cstr(normalized);
+    const Symbol* symbol = handle ? symbol_table_lookup(&cache->paths, handle) : NULL;
+    return symbol ? &cache->units[symbol->slot] : NULL;
+}
+
+void build_cache_rescan(BuildCache* cache) {
+    for (size_t i = 0; i < cache->unit_count; i++) {
+        BuildUnit* unit = &cache->units[i];
+        unit->refreshed = false;
+        unit->has_key = false;
+        unit->tarjan_index = unit->tarjan_low = 0;
+        unit->on_stack = false;
+    }
+    cache->component_count = 0;
+    cache->tarjan_counter = 0;
+    cache->tarjan_depth = 0;
+}
+
+// 出力のキャッシュ
+
+bool build_cache_fetch(BuildCache* cache, uint64_t key, const char* extension, const char* output_path) {
+    char path[BUILD_CACHE_PATH_MAX];
+    if (cache->directory == NULL) return false;
+    return entry_path(cache, path, key, extension) && file_exists(path) && copy_file(path, output_path);
+}
+
+SlangError build_cache_store(BuildCache* cache, uint64_t key, const char* extension, const char* output_path) {
+    char path[BUILD_CACHE_PATH_MAX];
+    char temporary[BUILD_CACHE_PATH_MAX];
+    if (cache->directory == NULL) return SLANG_SUCCESS;
+    if (!entry_path(cache, path, key, extension)) return SLANG_ERROR_IO;
+    int length = snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path, (long)getpid());
+    if (length <= 0 || length >= (int)sizeof(temporary)) return SLANG_ERROR_IO;
+
+    // 同じキーを同時に書いても、名前の変更で完成したファイルだけが見える
+    if (!copy_file(output_path, temporary) || rename(temporary, path) != 0) {
+        unlink(temporary);
+        return SLANG_ERROR_IO;
+    }
+    return SLANG_SUCCESS;
+}
+
+// 索引
+// 1行目が見出しで、単位ごとに「時刻 大きさ ハッシュ 依存先の数 パス」の行と、依存先ごとに「\tパス」の行が続く。
+
+static void load_index(BuildCache* cache) {
+    char path[BUILD_CACHE_PATH_MAX];
+    int length = snprintf(path, sizeof(path), "%s/%s", cache->directory, BUILD_CACHE_INDEX_NAME);
+    if (length <= 0 || length >= (int)sizeof(path) || !file_exists(path)) return;
+    SourceFile* file = source_open(path);
+    if (file == NULL) return;
+
+    const char* cursor = file->data;
+    const char* end = file->data + file->length;
+    const char* line_end = memchr(cursor, '\n', (size_t)(end - cursor));
+    if (line_end == NULL || strncmp(cursor, BUILD_CACHE_INDEX_HEADER, (size_t)(line_end - cursor)) != 0) {
+        source_close(file);
+        return;
+    }
+    cursor = line_end + 1;
+
+    while (cursor < end) {
+        line_end = memchr(cursor, '\n', (size_t)(end - cursor));
+        if (line_end == NULL) break;
+        long long mtime_ns;
+        unsigned long long size, hash;
+        size_t count;
+        int consumed = 0;
+        if (sscanf(cursor, "%lld %llu %llx %zu %n", &mtime_ns, &size, &hash, &count, &consumed) != 4 || consumed == 0) break;
+
+        char unit_path[BUILD_CACHE_PATH_MAX];
+        size_t path_length = (size_t)(line_end - cursor) - (size_t)consumed;
+        if (path_length == 0 || path_length >= sizeof(unit_path)) break;
+        memcpy(unit_path, cursor + consumed, path_length);
+        unit_path[path_length] = '\0';
+        cursor = line_end + 1;
+
+        const char** dependencies = count ? calloc(count, sizeof(const char*)) : NULL;
+        if (count && dependencies == NULL) break;
+        size_t loaded = 0;
+        while (loaded < count && cursor < end && *cursor == '\t') {
+            line_end = memchr(cursor, '\n', (size_t)(end - cursor));
+            if (line_end == NULL) break;
+            dependencies[loaded] = intern(cursor + 1, (size_t)(line_end - cursor) - 1);
+            if (dependencies[loaded] == NULL) break;
+            loaded++;
+            cursor = line_end + 1;
+        }
+        if (loaded != count) {
+            free(dependencies);
+            break;
+        }
+
+        bool created;
+        size_t index = unit_index(cache, unit_path, &created);
+        if (index == SIZE_MAX) {
+            free(dependencies);
+            break;
+        }
+        BuildUnit* unit = &cache->units[index];
+        unit->mtime_ns = mtime_ns;
+        unit->size = size;
+        unit->source_hash = hash;
+        unit_set_dependencies(unit, dependencies, count);
+    }
+    source_close(file);
+}
+
+static SlangError write_index(BuildCache* cache) {
+    char path[BUILD_CACHE_PATH_MAX];
+    char temporary[BUILD_CACHE_PATH_MAX];
+    int length = snprintf(path, sizeof(path), "%s/%s", cache->directory, BUILD_CACHE_INDEX_NAME);
+    if (length <= 0 || length >= (int)sizeof(path)) return SLANG_ERROR_IO;
+    length = snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path, (long)getpid());
+    if (length <= 0 || length >= (int)sizeof(temporary)) return SLANG_ERROR_IO;
+
+    FILE* out = fopen(temporary, "w");
+    if (out == NULL) return SLANG_ERROR_IO;
+    fprintf(out, "%s\n", BUILD_CACHE_INDEX_HEADER);
+    for (size_t i = 0; i < cache->unit_count; i++) {
+        const BuildUnit* unit = &cache->units[i];
+        if (unit->missing || unit->source_hash == 0 || strchr(unit->path, '\n') != NULL) continue;
+        fprintf(out, "%lld %llu %016llx %zu %s\n", (long long)unit->mtime_ns, (unsigned long long)unit->size,
+                (unsigned long long)unit->source_hash, unit->dependency_count, unit->path);
+        for (size_t d = 0; d < unit->dependency_count; d++) fprintf(out, "\t%s\n", unit->dependencies[d]);
+    }
+    bool ok = !ferror(out);
+    if (fclose(out) != 0 || !ok || rename(temporary, path) != 0) {
+        unlink(temporary);
+        return SLANG_ERROR_IO;
+    }
+    cache->dirty = false;
+    return SLANG_SUCCESS;
+}
+
+// 作成と破棄
+
+// コンパイラの実行ファイルの内容のハッシュ（プロセスで1回だけ求める）。作り直せば、大きさや時刻が
+// 同じでも別の値になる。実行ファイルを読めなければ、このファイルをコンパイルした日時にする
+static pthread_once_t compiler_id_once = PTHREAD_ONCE_INIT;
+static uint64_t compiler_id;
+
+static void compute_compiler_id(void) {
+    SourceFile* self = source_open("/proc/self/exe");
+    if (self != NULL) {
+        compiler_id = build_cache_hash(self->data, self->length, 1);
+        source_close(self);
+    } else {
+        compiler_id = hash_string(0, __DATE__ " " __TIME__);
+    }
+}
+
+// 版・コンパイラのビルド・フラグのハッシュ
+static uint64_t compiler_hash(const char* flags) {
+    pthread_once(&compiler_id_once, compute_compiler_id);
+    uint64_t hash = hash_string(0, SLANG_VERSION);
+    hash = hash_word(hash, compiler_id);
+    return hash_string(hash, flags ? flags : "");
+}
+
+BuildCache* build_cache_open(const char* directory, const char* flags) {
+    if (directory != NULL && mkdir(directory, 0755) != 0 && errno != EEXIST) return NULL;
+
+    BuildCache* cache = calloc(1, sizeof(BuildCache));
+    if (cache == NULL) return NULL;
+    cache->directory = directory ? strdup(directory) : NULL;
+    if (directory != NULL && cache->directory == NULL) {
+        free(cache);
+        return NULL;
+    }
+    cache->flags_hash = compiler_hash(flags);
+    symbol_table_init(&cache->paths);
+    if (directory != NULL) load_index(cache);
+    cache->dirty = false;
+    return cache;
+}
+
+SlangError build_cache_close(BuildCache* cache) {
+    if (cache == NULL) return SLANG_SUCCESS;
+    SlangError error = cache->dirty && cache->directory ? write_index(cache) : SLANG_SUCCESS;
+    for (size_t i = 0; i < cache->unit_count; i++) free(cache->units[i].dependencies);
+    free(cache->units);
+    free(cache->tarjan_stack);
+    symbol_table_free(&cache->paths);
+    free(cache->directory);
+    free(cache);
+    return error;
+}
@@ -0,0 +1,851 @@
+#include "../include/bytecode.h"
+#include "../include/intern.h"
+#include "../include/logger.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BYTECODE_INITIAL_CAPACITY 16
+
+// 最上位のスコープだけを使う表から番号を引く
+static bool symbol_find(const SymbolTable* table, const char* name, uint32_t* value) {
+    const Symbol* symbol = symbol_table_lookup(table, name);
+    if (symbol == NULL) return false;
+    *value = symbol->slot;
+    return true;
+}
+
+// 容量を倍にしながら配列を伸ばす
+static bool grow_array(void** data, size_t* capacity, size_t needed, size_t element_size) {
+    if (needed <= *capacity) return true;
+
+    size_t new_capacity = *capacity ? *capacity : BYTECODE_INITIAL_CAPACITY;
+    while (new_capacity < needed) new_capacity *= 2;
+
+    void* new_data = realloc(*data, new_capacity * element_size);
+    if (new_data == NULL) return false;
+    *data = new_data;
+    *capacity = new_capacity;
+    return true;
+}
+
+// プログラム
+
+BytecodeProgram* bytecode_program_create(void) {
+    return calloc(1, sizeof(BytecodeProgram));
+}
+
+static BytecodeFunction* bytecode_function_create(const char* name, const ASTNode* source) {
+    BytecodeFunction* function = calloc(1, sizeof(BytecodeFunction));
+    if (function == NULL) return NULL;
+    function->name = name;
+    function->source = source;
+    return function;
+}
+
+void bytecode_function_destroy(BytecodeFunction* function) {
+    if (function == NULL) return;
+    free(function->code);
+    free(function->constants);
+    free(function);
+}
+
+void bytecode_program_destroy(BytecodeProgram* program) {
+    if (program == NULL) return;
+
+    for (size_t i = 0; i < program->function_count; i++) {
+        bytecode_function_destroy(program->functions[i]);
+    }
+    free(program->functions);
+    free(program->globals);
+    free(program->natives);
+    symbol_table_free(&program->function_index);
+    symbol_table_free(&program->global_index);
+    free(program);
+}
+
+bool bytecode_find_global(const BytecodeProgram* program, const char* name, uint32_t* slot) {
+    return symbol_find(&program->global_index, name, slot);
+}
+
+bool bytecode_declare_global(BytecodeProgram* program, const char* name, uint32_t* slot) {
+    if (bytecode_find_global(program, name, slot)) return true;
+
+    if (!grow_array((void**)&program->globals, &program->global_capacity,
+                    program->global_count + 1, sizeof(Value))) {
+        return false;
+    }
+    uint32_t index = (uint32_t)program->global_count;
+    if (!symbol_table_define(&program->global_index, name, index)) return false;
+
+    program->globals[index] = value_nil();
+    program->global_count++;
+    *slot = index;
+    return true;
+}
+
+bool bytecode_declare_native(BytecodeProgram* program, const char* name, NativeFunction function) {
+    if (!grow_array((void**)&program->natives, &program->native_capacity,
+                    program->native_count + 1, sizeof(NativeFunction))) {
+        return false;
+    }
+    uint32_t index = (uint32_t)program->native_count;
+    if (!symbol_table_define(&program->function_index, name, index | BC_NATIVE_FLAG)) return false;
+
+    program->natives[index] = function;
+    program->native_count++;
+    return true;
+}
+
+SlangError bytecode_declare_function(BytecodeProgram* program, const char* name, const ASTNode* node, uint32_t* index) {
+    if (node == NULL || node->type != NODE_FUNCTION || name == NULL) {
+        program->error = "expected a function declaration";
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    uint32_t existing;
+    if (symbol_find(&program->function_index, name, &existing)) {
+        program->error = "duplicate function declaration";
+        return SLANG_ERROR_TYPE;
+    }
+
+    if (!grow_array((void**)&program->functions, &program->function_capacity,
+                    program->function_count + 1, sizeof(BytecodeFunction*))) {
+        return SLANG_ERROR_INTERNAL;
+    }
+    BytecodeFunction* function = bytecode_function_create(name, node);
+    if (function == NULL) return SLANG_ERROR_INTERNAL;
+
+    uint32_t slot = (uint32_t)program->function_count;
+    if (!symbol_table_define(&program->function_index, name, slot)) {
+        bytecode_function_destroy(function);
+        return SLANG_ERROR_INTERNAL;
+    }
+    function->arity = (uint8_t)node->data.function.parameter_count;
+    function->priority = node->data.function.priority;
+    program->functions[slot] = function;
+    program->function_count++;
+    if (index) *index = slot;
+    return SLANG_SUCCESS;
+}
+
+BytecodeFunction* bytecode_find_function(const BytecodeProgram* program, const char* name) {
+    uint32_t index;
+    if (!symbol_find(&program->function_index, name, &index) || (index & BC_NATIVE_FLAG)) {
+        return NULL;
+    }
+    return program->functions[index];
+}
+
+// コンパイラ
+
+// ローカル変数はlocalsに束縛し、その番号がそのままレジスタになる（レジスタ0から順に詰めて置く）
+typedef struct {
+    BytecodeProgram* program;
+    BytecodeFunction* function;
+    SymbolTable locals;
+    size_t free_register;    // 次に使えるレジスタ（文の境界ではlocals.countと等しい）
+    bool is_script;          // スクリプト本体の最上位のletはグローバル変数になる
+} Compiler;
+
+static SlangError compile_error(Compiler* compiler, SlangError code, const char* message) {
+    compiler->program->error = message;
+    return code;
+}
+
+static SlangError emit(Compiler* compiler, uint32_t instruction) {
+    BytecodeFunction* function = compiler->function;
+    if (!grow_array((void**)&function->code, &function->code_capacity,
+                    function->code_count + 1, sizeof(uint32_t))) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "out of memory");
+    }
+    function->code[function->code_count++] = instruction;
+    return SLANG_SUCCESS;
+}
+
+static SlangError add_constant(Compiler* compiler, Value value, uint32_t* index) {
+    BytecodeFunction* function = compiler->function;
+    if (function->constant_count > BC_MAX_BX) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "too many constants in one function");
+    }
+    if (!grow_array((void**)&function->constants, &function->constant_capacity,
+                    function->constant_count + 1, sizeof(Value))) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "out of memory");
+    }
+    *index = (uint32_t)function->constant_count;
+    function->constants[function->constant_count++] = value;
+    return SLANG_SUCCESS;
+}
+
+static SlangError emit_constant(Compiler* compiler, uint8_t target, Value value) {
+    uint32_t index;
+    SlangError error = add_constant(compiler, value, &index);
+    if (error != SLANG_SUCCESS) return error;
+    return emit(compiler, BC_ENCODE_ABX(OP_LOADK, target, index));
+}
+
+static SlangError alloc_register(Compiler* compiler, uint8_t* reg) {
+    if (compiler->free_register >= BC_MAX_REGISTERS) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "expression needs too many registers");
+    }
+    *reg = (uint8_t)compiler->free_register++;
+    if (compiler->free_register > compiler->function->register_count) {
+        compiler->function->register_count = (uint8_t)compiler->free_register;
+    }
+    return SLANG_SUCCESS;
+}
+
+// 前方ジャンプを仮の距離で出力し、後でpatch_jumpで埋める
+static SlangError emit_jump(Compiler* compiler, OpCode op, uint8_t a, size_t* at) {
+    *at = compiler->function->code_count;
+    return emit(compiler, BC_ENCODE_ASBX(op, a, 0));
+}
+
+static SlangError patch_jump(Compiler* compiler, size_t at) {
+    int64_t offset = (int64_t)compiler->function->code_count - (int64_t)(at + 1);
+    if (offset > BC_MAX_BX - BC_SBX_BIAS) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "jump too far");
+    }
+    uint32_t instruction = compiler->function->code[at];
+    compiler->function->code[at] = BC_ENCODE_ASBX(BC_OP(instruction), BC_A(instruction), offset);
+    return SLANG_SUCCESS;
+}
+
+static SlangError emit_loop(Compiler* compiler, size_t start) {
+    int64_t offset = (int64_t)start - (int64_t)(compiler->function->code_count + 1);
+    if (offset < -BC_SBX_BIAS) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "loop body too large");
+    }
+    return emit(compiler, BC_ENCODE_ASBX(OP_JMP, 0, offset));
+}
+
+// ローカル変数のレジスタ（なければ-1）
+static int resolve_local(const Compiler* compiler, const char* name) {
+    const Symbol* symbol = symbol_table_lookup(&compiler->locals, name);
+    return symbol ? (int)symbol->slot : -1;
+}
+
+static SlangError define_local(Compiler* compiler, const char* name, uint8_t reg) {
+    if (!symbol_table_define(&compiler->locals, name, reg)) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "out of memory");
+    }
+    return SLANG_SUCCESS;
+}
+
+static SlangError add_local(Compiler* compiler, const char* name, uint8_t* reg) {
+    SlangError error = alloc_register(compiler, reg);
+    if (error != SLANG_SUCCESS) return error;
+    return define_local(compiler, name, *reg);
+}
+
+static SlangError begin_scope(Compiler* compiler) {
+    if (!symbol_table_push_scope(&compiler->locals)) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "out of memory");
+    }
+    return SLANG_SUCCESS;
+}
+
+static void end_scope(Compiler* compiler) {
+    symbol_table_pop_scope(&compiler->locals);
+    compiler->free_register = compiler->locals.count;
+}
+
+static SlangError compile_expression(Compiler* compiler, const ASTNode* node, uint8_t target);
+static SlangError compile_statement(Compiler* compiler, const ASTNode* node);
+
+// 式の値が入っているレジスタを返す（ローカル変数の参照ならそのレジスタ自体を使い、コピーしない）
+static SlangError compile_operand(Compiler* compiler, const ASTNode* node, uint8_t* reg) {
+    if (node->type == NODE_VARIABLE_REFERENCE) {
+        int local = resolve_local(compiler, node->data.variable_reference.name);
+        if (local >= 0) {
+            *reg = (uint8_t)local;
+            return SLANG_SUCCESS;
+        }
+    }
+
+    SlangError error = alloc_register(compiler, reg);
+    if (error != SLANG_SUCCESS) return error;
+    return compile_expression(compiler, node, *reg);
+}
+
+// 二項演算子と命令の対応（>と>=は被演算子を入れ替えてLT/LEにする）
+// 右辺が小さな整数リテラルなら即値命令を使う（OP_COUNTは即値命令なし）
+typedef struct {
+    const char* text;
+    OpCode op;
+    bool swap;
+    OpCode immediate;
+    int sign;
+} BinaryOperator;
+
+static const BinaryOperator binary_operators[] = {
+    {"+", OP_ADD, false, OP_ADDI, 1},
+    {"-", OP_SUB, false, OP_ADDI, -1},
+    {"*", OP_MUL, false, OP_COUNT, 0},
+    {"/", OP_DIV, false, OP_COUNT, 0},
+    {"%", OP_MOD, false, OP_COUNT, 0},
+    {"==", OP_EQ, false, OP_COUNT, 0},
+    {"!=", OP_NE, false, OP_COUNT, 0},
+    {"<", OP_LT, false, OP_LTI, 1},
+    {"<=", OP_LE, false, OP_LEI, 1},
+    {">", OP_LT, true, OP_GTI, 1},
+    {">=", OP_LE, true, OP_GEI, 1},
+    {NULL, 0, false, OP_COUNT, 0}
+};
+
+static SlangError compile_logical(Compiler* compiler, const BinaryExpression* binary, uint8_t target, OpCode jump) {
+    // 右辺がまだ読むかもしれないので、ローカル変数へは一時レジスタを経由して書く
+    size_t saved = compiler->free_register;
+    uint8_t result = target;
+    SlangError error;
+    if (target < compiler->locals.count) {
+        error = alloc_register(compiler, &result);
+        if (error != SLANG_SUCCESS) return error;
+    }
+
+    // 左辺で結果が決まれば右辺は評価しない
+    error = compile_expression(compiler, binary->left, result);
+    if (error != SLANG_SUCCESS) return error;
+
+    size_t skip;
+    error = emit_jump(compiler, jump, result, &skip);
+    if (error != SLANG_SUCCESS) return error;
+
+    error = compile_expression(compiler, binary->right, result);
+    if (error != SLANG_SUCCESS) return error;
+    error = patch_jump(compiler, skip);
+    if (error != SLANG_SUCCESS) return error;
+
+    compiler->free_register = saved;
+    if (result == target) return SLANG_SUCCESS;
+    return emit(compiler, BC_ENCODE_ABC(OP_MOVE, target, result, 0));
+}
+
+static SlangError compile_binary(Compiler* compiler, const BinaryExpression* binary, uint8_t target) {
+    if (strcmp(binary->operator, "&&") == 0) return compile_logical(compiler, binary, target, OP_JMPIFNOT);
+    if (strcmp(binary->operator, "||") == 0) return compile_logical(compiler, binary, target, OP_JMPIF);
+
+    const BinaryOperator* op = binary_operators;
+    while (op->text != NULL && strcmp(op->text, binary->operator) != 0) op++;
+    if (op->text == NULL) {
+        return compile_error(compiler, SLANG_ERROR_TYPE, "unsupported binary operator");
+    }
+
+    size_t saved = compiler->free_register;
+    uint8_t left, right;
+    SlangError error = compile_operand(compiler, binary->left, &left);
+    if (error != SLANG_SUCCESS) return error;
+
+    if (op->immediate != OP_COUNT && binary->right->type == NODE_INTEGER_LITERAL) {
+        int64_t value = binary->right->data.integer_literal.value * op->sign;
+        if (value >= BC_SC_MIN && value <= BC_SC_MAX) {
+            compiler->free_register = saved;
+            return emit(compiler, BC_ENCODE_ABC(op->immediate, target, left, value + BC_SC_BIAS));
+        }
+    }
+
+    error = compile_operand(compiler, binary->right, &right);
+    if (error != SLANG_SUCCESS) return error;
+    compiler->free_register = saved;
+
+    if (op->swap) return emit(compiler, BC_ENCODE_ABC(op->op, target, right, left));
+    return emit(compiler, BC_ENCODE_ABC(op->op, target, left, right));
+}
+
+static SlangError compile_unary(Compiler* compiler, const UnaryExpression* unary, uint8_t target) {
+    OpCode op;
+    if (strcmp(unary->operator, "-") == 0) {
+        op = OP_NEG;
+    } else if (strcmp(unary->operator, "!") == 0) {
+        op = OP_NOT;
+    } else {
+        return compile_error(compiler, SLANG_ERROR_TYPE, "unsupported unary operator");
+    }
+
+    size_t saved = compiler->free_register;
+    uint8_t operand;
+    SlangError error = compile_operand(compiler, unary->right, &operand);
+    if (error != SLANG_SUCCESS) return error;
+    compiler->free_register = saved;
+    return emit(compiler, BC_ENCODE_ABC(op, target, operand, 0));
+}
+
+// 名前の参照（ローカル変数 → グローバル変数 → 関数の順に解決する）
+static SlangError compile_name(Compiler* compiler, const char* name, uint8_t target) {
+    int local = resolve_local(compiler, name);
+    if (local >= 0) {
+        if (local == target) return SLANG_SUCCESS;
+        return emit(compiler, BC_ENCODE_ABC(OP_MOVE, target, local, 0));
+    }
+
+    uint32_t slot;
+    if (bytecode_find_global(compiler->program, name, &slot)) {
+        return emit(compiler, BC_ENCODE_ABX(OP_GETGLOBAL, target, slot));
+    }
+
+    uint32_t index;
+    if (symbol_find(&compiler->program->function_index, name, &index)) {
+        Value value;
+        value.type = (index & BC_NATIVE_FLAG) ? VALUE_NATIVE : VALUE_FUNCTION;
+        value.as.integer = 0;
+        value.as.function = index & ~BC_NATIVE_FLAG;
+        return emit_constant(compiler, target, value);
+    }
+
+    return compile_error(compiler, SLANG_ERROR_TYPE, "undefined variable");
+}
+
+// 呼び出し: 関数値をR[base]、引数をR[base+1]以降に置き、結果はR[base]に返る
+static SlangError compile_call(Compiler* compiler, const ASTNode* callee, const char* name,
+                               ASTNode* const* arguments, size_t argument_count, uint8_t target) {
+    if (argument_count > BC_MAX_REGISTERS) {
+        return compile_error(compiler, SLANG_ERROR_INTERNAL, "too many arguments");
+    }
+
+    // targetが最上位の一時レジスタならそのまま呼び出しの基点にして、結果のコピーを省く
+    size_t saved = compiler->free_register;
+    uint8_t base = target;
+    SlangError error = SLANG_SUCCESS;
+    if (target < compiler->locals.count || (size_t)target + 1 != compiler->free_register) {
+        error = alloc_register(compiler, &base);
+        if (error != SLANG_SUCCESS) return error;
+    }
+
+    if (callee != NULL) {
+        error = compile_expression(compiler, callee, base);
+    } else {
+        // 名前が関数に解決されるなら引数の数はここで検査できる
+        uint32_t slot;
+        const BytecodeFunction* function = bytecode_find_function(compiler->program, name);
+        if (function != NULL && resolve_local(compiler, name) < 0 &&
+            !bytecode_find_global(compiler->program, name, &slot) && function->arity != argument_count) {
+            return compile_error(compiler, SLANG_ERROR_TYPE, "wrong number of arguments");
+        }
+        error = compile_name(compiler, name, base);
+    }
+    if (error != SLANG_SUCCESS) return error;
+
+    for (size_t i = 0; i < argument_count; i++) {
+        uint8_t reg;
+        error = alloc_register(compiler, &reg);
+        if (error != SLANG_SUCCESS) return error;
+        error = compile_expression(compiler, arguments[i], reg);
+        if (error != SLANG_SUCCESS) return error;
+        compiler->free_register = (size_t)reg + 1;
+    }
+
+    error = emit(compiler, BC_ENCODE_ABC(OP_CALL, base, argument_count, 0));
+    if (error != SLANG_SUCCESS) return error;
+
+    compiler->free_register = saved;
+    if (base == target) return SLANG_SUCCESS;
+    return emit(compiler, BC_ENCODE_ABC(OP_MOVE, target, base, 0));
+}
+
+// 代入（has_targetがfalseなら値は捨てる）
+static SlangError compile_assignment(Compiler* compiler, const Assignment* assignment, bool has_target, uint8_t target) {
+    int local = resolve_local(compiler, assignment->name);
+    if (local >= 0) {
+        SlangError error = compile_expression(compiler, assignment->value, (uint8_t)local);
+        if (error != SLANG_SUCCESS) return error;
+        if (!has_target || local == target) return SLANG_SUCCESS;
+        return emit(compiler, BC_ENCODE_ABC(OP_MOVE, target, local, 0));
+    }
+
+    uint32_t slot;
+    if (!bytecode_find_global(compiler->program, assignment->name, &slot)) {
+        return compile_error(compiler, SLANG_ERROR_TYPE, "assignment to undefined variable");
+    }
+
+    size_t saved = compiler->free_register;
+    uint8_t value = target;
+    SlangError error;
+    if (has_target) {
+        error = compile_expression(compiler, assignment->value, value);
+    } else {
+        error = compile_operand(compiler, assignment->value, &value);
+    }
+    if (error != SLANG_SUCCESS) return error;
+    compiler->free_register = saved;
+    return emit(compiler, BC_ENCODE_ABX(OP_SETGLOBAL, value, slot));
+}
+
+// 式をR[target]に評価する
+static SlangError compile_expression(Compiler* compiler, const ASTNode* node, uint8_t target) {
+    if (node == NULL) {
+        return emit(compiler, BC_ENCODE_ABC(OP_LOADNIL, target, 0, 0));
+    }
+
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL:
+            return emit_constant(compiler, target, value_int(node->data.integer_literal.value));
+        case NODE_FLOAT_LITERAL:
+            return emit_constant(compiler, target, value_float(node->data.float_literal.value));
+        case NODE_STRING_LITERAL:
+            return emit_constant(compiler, target, value_string(node->data.string_literal.value));
+        case NODE_BOOLEAN_LITERAL:
+            return emit(compiler, BC_ENCODE_ABC(OP_LOADBOOL, target, node->data.boolean_literal.value ? 1 : 0, 0));
+        case NODE_VARIABLE_REFERENCE:
+            return compile_name(compiler, node->data.variable_reference.name, target);
+        case NODE_ASSIGNMENT:
+            return compile_assignment(compiler, &node->data.assignment, true, target);
+        case NODE_BINARY_EXPRESSION:
+            return compile_binary(compiler, &node->data.binary_expression, target);
+        case NODE_UNARY_EXPRESSION:
+            return compile_unary(compiler, &node->data.unary_expression, target);
+        case NODE_FUNCTION_CALL:
+            return compile_call(compiler, NULL, node->data.function_call.name,
+                                node->data.function_call.arguments,
+                                node->data.function_call.argument_count, target);
+        case NODE_CALL_EXPRESSION:
+            return compile_call(compiler, node->data.call_expression.callee, NULL,
+                                node->data.call_expression.arguments,
+                                node->data.call_expression.argument_count, target);
+        default:
+            return compile_error(compiler, SLANG_ERROR_TYPE, "unsupported expression");
+    }
+}
+
+static SlangError compile_let(Compiler* compiler, const LetStatement* let) {
+    if (compiler->is_script && compiler->locals.depth == 0) {
+        uint32_t slot;
+        if (!bytecode_declare_global(compiler->program, let->name, &slot)) {
+            return compile_error(compiler, SLANG_ERROR_INTERNAL, "out of memory");
+        }
+        return compile_assignment(compiler, &(Assignment){let->name, let->initializer}, false, 0);
+    }
+
+    // 初期化式の中の同名の参照は外側の変数を指すので、評価してから登録する
+    uint8_t reg;
+    SlangError error = alloc_register(compiler, &reg);
+    if (error != SLANG_SUCCESS) return error;
+    error = compile_expression(compiler, let->initializer, reg);
+    if (error != SLANG_SUCCESS) return error;
+
+    error = define_local(compiler, let->name, reg);
+    compiler->free_register = compiler->locals.count;
+    return error;
+}
+
+static SlangError compile_block(Compiler* compiler, const BlockStatement* block) {
+    SlangError error = begin_scope(compiler);
+    for (size_t i = 0; i < block->statement_count && error == SLANG_SUCCESS; i++) {
+        error = compile_statement(compiler, block->statements[i]);
+    }
+    end_scope(compiler);
+    return error;
+}
+
+// 分岐の中身は専用のスコープで翻訳する
+static SlangError compile_branch(Compiler* compiler, const ASTNode* node) {
+    if (node->type == NODE_BLOCK_STATEMENT) return compile_block(compiler, &node->data.block_statement);
+
+    SlangError error = begin_scope(compiler);
+    if (error == SLANG_SUCCESS) error = compile_statement(compiler, node);
+    end_scope(compiler);
+    return error;
+}
+
+static SlangError compile_if(Compiler* compiler, const IfStatement* statement) {
+    uint8_t condition;
+    SlangError error = compile_operand(compiler, statement->condition, &condition);
+    if (error != SLANG_SUCCESS) return error;
+    compiler->free_register = compiler->locals.count;
+
+    size_t else_jump;
+    error = emit_jump(compiler, OP_JMPIFNOT, condition, &else_jump);
+    if (error != SLANG_SUCCESS) return error;
+
+    error = compile_branch(compiler, statement->then_branch);
+    if (error != SLANG_SUCCESS) return error;
+
+    if (statement->else_branch == NULL) return patch_jump(compiler, else_jump);
+
+    size_t end_jump;
+    error = emit_jump(compiler, OP_JMP, 0, &end_jump);
+    if (error != SLANG_SUCCESS) return error;
+    error = patch_jump(compiler, else_jump);
+    if (error != SLANG_SUCCESS) return error;
+
+    error = compile_branch(compiler, statement->else_branch);
+    if (error != SLANG_SUCCESS) return error;
+    return patch_jump(compiler, end_jump);
+}
+
+static SlangError compile_while(Compiler* compiler, const WhileStatement* statement) {
+    size_t start = compiler->function->code_count;
+
+    uint8_t condition;
+    SlangError error = compile_operand(compiler, statement->condition, &condition);
+    if (error != SLANG_SUCCESS) return error;
+    compiler->free_register = compiler->locals.count;
+
+    size_t exit_jump;
+    error = emit_jump(compiler, OP_JMPIFNOT, condition, &exit_jump);
+    if (error != SLANG_SUCCESS) return error;
+
+    error = compile_branch(compiler, statement->body);
+    if (error != SLANG_SUCCESS) return error;
+
+    error = emit_loop(compiler, start);
+    if (error != SLANG_SUCCESS) return error;
+    return patch_jump(compiler, exit_jump);
+}
+
+static SlangError compile_return(Compiler* compiler, const ReturnStatement* statement) {
+    if (statement->value == NULL) {
+        return emit(compiler, BC_ENCODE_ABC(OP_RETURN, 0, 0, 0));
+    }
+
+    uint8_t value;
+    SlangError error = compile_operand(compiler, statement->value, &value);
+    if (error != SLANG_SUCCESS) return error;
+    compiler->free_register = compiler->locals.count;
+    return emit(compiler, BC_ENCODE_ABC(OP_RETURN, value, 1, 0));
+}
+
+// log_thresholdより低い段階の組み込みのログの呼び出しか（引数も評価しないので副作用ごと消える）
+static bool is_elided_log(const Compiler* compiler, const ASTNode* node) {
+    if (compiler->program->log_threshold <= 0 || node == NULL || node->type != NODE_FUNCTION_CALL) return false;
+
+    const char* name = node->data.function_call.name;
+    int level = logger_level_of(name);
+    uint32_t index;
+    if (level < 0 || level >= compiler->program->log_threshold) return false;
+    if (resolve_local(compiler, name) >= 0 || bytecode_find_global(compiler->program, name, &index)) return false;
+    return symbol_find(&compiler->program->function_index, name, &index) && (index & BC_NATIVE_FLAG);
+}
+
+static SlangError compile_statement(Compiler* compiler, const ASTNode* node) {
+    if (node == NULL) return SLANG_SUCCESS;
+
+    SlangError error;
+    switch (node->type) {
+        case NODE_LET_STATEMENT:
+            return compile_let(compiler, &node->data.let_statement);
+        case NODE_IF_STATEMENT:
+            return compile_if(compiler, &node->data.if_statement);
+        case NODE_WHILE_STATEMENT:
+            return compile_while(compiler, &node->data.while_statement);
+        case NODE_BLOCK_STATEMENT:
+            return compile_block(compiler, &node->data.block_statement);
+        case NODE_RETURN_STATEMENT:
+            return compile_return(compiler, &node->data.return_statement);
+        case NODE_ASSIGNMENT:
+            error = compile_assignment(compiler, &node->data.assignment, false, 0);
+            break;
+        case NODE_EXPRESSION_STATEMENT:
+            if (is_elided_log(compiler, node->data.expression_statement.expression)) return SLANG_SUCCESS;
+            return compile_statement(compiler, node->data.expression_statement.expression);
+        case NODE_FUNCTION:
+            // 関数はスクリプトの最上位で事前に宣言される
+            if (compiler->is_script && compiler->locals.depth == 0) return SLANG_SUCCESS;
+            return compile_error(compiler, SLANG_ERROR_TYPE, "nested functions are not supported");
+        default: {
+            uint8_t reg;
+            error = alloc_register(compiler, &reg);
+            if (error != SLANG_SUCCESS) return error;
+            error = compile_expression(compiler, node, reg);
+            break;
+        }
+    }
+
+    compiler->free_register = compiler->locals.count;
+    return error;
+}
+
+static void compiler_init(Compiler* compiler, BytecodeProgram* program, BytecodeFunction* function, bool is_script) {
+    compiler->program = program;
+    compiler->function = function;
+    symbol_table_init(&compiler->locals);
+    compiler->free_register = 0;
+    compiler->is_script = is_script;
+    program->error = NULL;
+}
+
+static SlangError compile_function(BytecodeProgram* program, BytecodeFunction* function) {
+    const Function* source = &function->source->data.function;
+    if (source->parameter_count > BC_MAX_REGISTERS) {
+        program->error = "too many parameters";
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    Compiler compiler;
+    compiler_init(&compiler, program, function, false);
+
+    // 引数はレジスタ0から順に置かれる
+    SlangError error = SLANG_SUCCESS;
+    for (size_t i = 0; i < source->parameter_count && error == SLANG_SUCCESS; i++) {
+        uint8_t reg;
+        error = add_local(&compiler, source->parameters[i]->name, &reg);
+    }
+    if (error == SLANG_SUCCESS) error = compile_statement(&compiler, source->body);
+    if (error == SLANG_SUCCESS) error = emit(&compiler, BC_ENCODE_ABC(OP_RETURN, 0, 0, 0));
+    symbol_table_free(&compiler.locals);
+    if (error != SLANG_SUCCESS) return error;
+
+    function->compiled = true;
+    return SLANG_SUCCESS;
+}
+
+SlangError bytecode_compile_pending(BytecodeProgram* program) {
+    for (size_t i = 0; i < program->function_count; i++) {
+        BytecodeFunction* function = program->functions[i];
+        if (function->compiled) continue;
+
+        SlangError error = compile_function(program, function);
+        if (error != SLANG_SUCCESS) return error;
+    }
+    return SLANG_SUCCESS;
+}
+
+SlangError bytecode_compile_script(BytecodeProgram* program, ASTNode* const* statements, size_t count, BytecodeFunction** script) {
+    // 前方参照できるよう、最上位の関数とグローバル変数を先に登録する
+    for (size_t i = 0; i < count; i++) {
+        const ASTNode* node = statements[i];
+        if (node == NULL) continue;
+
+        if (node->type == NODE_FUNCTION) {
+            SlangError error = bytecode_declare_function(program, node->data.function.name, node, NULL);
+            if (error != SLANG_SUCCESS) return error;
+        } else if (node->type == NODE_LET_STATEMENT) {
+            uint32_t slot;
+            if (!bytecode_declare_global(program, node->data.let_statement.name, &slot)) {
+                return SLANG_ERROR_INTERNAL;
+            }
+        }
+    }
+
+    SlangError error = bytecode_compile_pending(program);
+    if (error != SLANG_SUCCESS) return error;
+
+    BytecodeFunction* function = bytecode_function_create(NULL, NULL);
+    if (function == NULL) return SLANG_ERROR_INTERNAL;
+
+    Compiler compiler;
+    compiler_init(&compiler, program, function, true);
+    for (size_t i = 0; i < count && error == SLANG_SUCCESS; i++) {
+        error = compile_statement(&compiler, statements[i]);
+    }
+    if (error == SLANG_SUCCESS) {
+        error = emit(&compiler, BC_ENCODE_ABC(OP_RETURN, 0, 0, 0));
+    }
+    symbol_table_free(&compiler.locals);
+    if (error != SLANG_SUCCESS) {
+        bytecode_function_destroy(function);
+        return error;
+    }
+
+    function->compiled = true;
+    *script = function;
+    return SLANG_SUCCESS;
+}
+
+SlangError bytecode_compile_expression(BytecodeProgram* program, const ASTNode* expression, BytecodeFunction** script) {
+    BytecodeFunction* function = bytecode_function_create(NULL, NULL);
+    if (function == NULL) return SLANG_ERROR_INTERNAL;
+
+    Compiler compiler;
+    compiler_init(&compiler, program, function, true);
+
+    uint8_t reg;
+    SlangError error = alloc_register(&compiler, &reg);
+    if (error == SLANG_SUCCESS) error = compile_expression(&compiler, expression, reg);
+    if (error == SLANG_SUCCESS) error = emit(&compiler, BC_ENCODE_ABC(OP_RETURN, reg, 1, 0));
+    symbol_table_free(&compiler.locals);
+    if (error != SLANG_SUCCESS) {
+        bytecode_function_destroy(function);
+        return error;
+    }
+
+    function->compiled = true;
+    *script = function;
+    return SLANG_SUCCESS;
+}
+
+// 値
+
+bool value_is_truthy(Value value) {
+    switch (value.type) {
+        case VALUE_NIL: return false;
+        case VALUE_BOOL: return value.as.boolean;
+        default: return true;
+    }
+}
+
+bool value_equals(Value a, Value b) {
+    if (a.type == VALUE_INT && b.type == VALUE_FLOAT) return (double)a.as.integer == b.as.number;
+    if (a.type == VALUE_FLOAT && b.type == VALUE_INT) return a.as.number == (double)b.as.integer;
+    if (a.type != b.type) return false;
+
+    switch (a.type) {
+        case VALUE_NIL: return true;
+        case VALUE_BOOL: return a.as.boolean == b.as.boolean;
+        case VALUE_INT: return a.as.integer == b.as.integer;
+        case VALUE_FLOAT: return a.as.number == b.as.number;
+        case VALUE_STRING: return a.as.string == b.as.string || strcmp(a.as.string, b.as.string) == 0;
+        default: return a.as.function == b.as.function;
+    }
+}
+
+void value_print(FILE* out, Value value) {
+    switch (value.type) {
+        case VALUE_NIL: fputs("nil", out); break;
+        case VALUE_BOOL: fputs(value.as.boolean ? "true" : "false", out); break;
+        case VALUE_INT: fprintf(out, "%" PRId64, value.as.integer); break;
+        case VALUE_FLOAT: fprintf(out, "%g", value.as.number); break;
+        case VALUE_STRING: fputs(value.as.string, out); break;
+        case VALUE_FUNCTION: fprintf(out, "<fn #%u>", value.as.function); break;
+        case VALUE_NATIVE: fprintf(out, "<native #%u>", value.as.function); break;
+    }
+}
+
+// 逆アセンブル
+
+typedef enum { FORMAT_ABC, FORMAT_ABSC, FORMAT_ABX, FORMAT_ASBX } InstructionFormat;
+
+static const struct {
+    const char* name;
+    InstructionFormat format;
+} opcode_info[] = {
+#define OPCODE(name, format) {#name, FORMAT_##format},
+#include "../include/opcodes.def"
+#undef OPCODE
+};
+
+void bytecode_disassemble(FILE* out, const BytecodeFunction* function) {
+    fprintf(out, "== %s (arity %u, registers %u) ==\n",
+            function->name ? function->name : "<script>", function->arity, function->register_count);
+
+    for (size_t pc = 0; pc < function->code_count; pc++) {
+        uint32_t instruction = function->code[pc];
+        uint32_t op = BC_OP(instruction);
+        if (op >= OP_COUNT) {
+            fprintf(out, "%04zu  <invalid %u>\n", pc, op);
+            continue;
+        }
+
+        fprintf(out, "%04zu  %-10s", pc, opcode_info[op].name);
+        switch (opcode_info[op].format) {
+            case FORMAT_ABC:
+                fprintf(out, " %u %u %u\n", BC_A(instruction), BC_B(instruction), BC_C(instruction));
+                break;
+            case FORMAT_ABSC:
+                fprintf(out, " %u %u %d\n", BC_A(instruction), BC_B(instruction), BC_SC(instruction));
+                break;
+            case FORMAT_ABX:
+                fprintf(out, " %u %u", BC_A(instruction), BC_BX(instruction));
+                if (op == OP_LOADK && BC_BX(instruction) < function->constant_count) {
+                    fputs("    ; ", out);
+                    value_print(out, function->constants[BC_BX(instruction)]);
+                }
+                fputc('\n', out);
+                break;
+            case FORMAT_ASBX:
+                fprintf(out, " %u %d    ; -> %04zu\n", BC_A(instruction), BC_SBX(instruction),
+                        (size_t)((int64_t)pc + 1 + BC_SBX(instruction)));
+                break;
+        }
+    }
+}
@@ -1,28 +1,56 @@
 #include "../include/codegen.h"
-#include <stdio.h>
+#include "../include/resolver.h"
+#include "../include/intern.h"
+#include "../include/ir.h"
+#include "../include/regalloc.h"
+#include "../include/x86_emitter.h"
+#include "../include/optimizer.h"
+#include "../include/monomorph.h"
+#include "../include/logger.h"
 #include <stdlib.h>
 #include <string.h>
 
+// レジスタ渡しの引数の上限（System V ABIの整数とfloatのレジスタ）
+#define CODEGEN_MAX_REGISTER_ARGUMENTS 6
+#define CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS 8
+
+// 数学の型はIRに変換できた関数でだけ扱う（スタックマシン方式に落ちた関数ではこの理由で報告する）
+#define CODEGEN_MATH_UNSUPPORTED "vector math needs register arguments and matching types"
+
 // コード生成コンテキストの作成
-CodeGenContext* codegen_create(const char* output_path) {
+CodeGenContext* codegen_create(const char* output_path, AsmOutputFormat format, const OptOptions* options,
+                               ThreadPool* pool) {
     CodeGenContext* context = malloc(sizeof(CodeGenContext));
     if (context == NULL) return NULL;
 
     context->output_path = output_path;
-    context->output_file = fopen(output_path, "w");
-    if (context->output_file == NULL) {
+    bool opened = format == ASM_OUTPUT_OBJECT
+        ? asm_writer_open_object(&context->writer, output_path)
+        : asm_writer_open(&context->writer, output_path);
+    if (!opened) {
         free(context);
         return NULL;
     }
 
-    context->string_literals = vector_create(sizeof(char*));
-    context->global_variables = vector_create(sizeof(char*));
-    context->functions = vector_create(sizeof(char*));
+    context->string_literals = vector_new(0);
+    symbol_table_init(&context->global_variables);
+    symbol_table_init(&context->functions);
+    resolver_init(&context->resolver, &context->global_variables, &context->functions);
+    context->float_return = false;
+    context->global_values = NULL;
+    context->error = NULL;
+    context->error_node = NULL;
     context->label_counter = 0;
+    context->module = NULL;
+    context->module_count = 0;
+    context->allocations = NULL;
+    context->allocated = NULL;
+    context->pool = pool;
 
-    if (context->string_literals == NULL ||
-        context->global_variables == NULL ||
-        context->functions == NULL) {
+    OptOptions defaults = { OPT_DEFAULT_LEVEL, false, NULL };
+    optimizer_init(&context->optimizer, options != NULL ? options : &defaults);
+
+    if (context->string_literals == NULL) {
         codegen_destroy(context);
         return NULL;
     }
@@ -34,203 +62,1520 @@ CodeGenContext* codegen_create(const char* output_path) {
 void codegen_destroy(CodeGenContext* context) {
     if (context == NULL) return;
 
-    if (context->output_file) {
-        fclose(context->output_file);
-    }
+    asm_writer_close(&context->writer);
 
     // 文字列リテラルの解放
     for (size_t i = 0; i < vector_size(context->string_literals); i++) {
-        char** str = vector_get(context->string_literals, i);
-        free(*str);
+        free(vector_get(context->string_literals, i));
     }
-    vector_destroy(context->string_literals);
+    vector_free(context->string_literals);
 
-    // グローバル変数の解放
-    for (size_t i = 0; i < vector_size(context->global_variables); i++) {
-        char** var = vector_get(context->global_variables, i);
-        free(*var);
-    }
-    vector_destroy(context->global_variables);
+    // グローバル変数名と関数名はインターン表が所有する
+    symbol_table_free(&context->global_variables);
+    symbol_table_free(&context->functions);
+    resolver_free(&context->resolver);
+    free(context->global_values);
 
-    // 関数名の解放
-    for (size_t i = 0; i < vector_size(context->functions); i++) {
-        char** func = vector_get(context->functions, i);
-        free(*func);
+    for (size_t i = 0; i < context->module_count; i++) {
+        if (context->allocated != NULL && context->allocated[i]) regalloc_free(&context->allocations[i]);
+        ir_function_destroy(context->module[i]);
     }
-    vector_destroy(context->functions);
+    free(context->allocations);
+    free(context->allocated);
+    free(context->module);
 
     free(context);
 }
 
-// 新しいラベルの生成
-static char* codegen_new_label(CodeGenContext* context) {
-    char* label = malloc(32);
-    if (label == NULL) return NULL;
-    sprintf(label, "L%zu", context->label_counter++);
-    return label;
+// 新しいラベルの生成（.L<番号>、名前は出力時に組み立てる）
+static size_t codegen_new_label(CodeGenContext* context) {
+    return context->label_counter++;
 }
 
-// プロローグの生成
+// プロローグの生成（関数はすべて外部から参照できるようにする。汎用関数の特殊化は複数の単位が
+// 同じものを出力しうるのでweakにする）
 void codegen_emit_prologue(CodeGenContext* context) {
-    fprintf(context->output_file, ".section .text\n");
-    fprintf(context->output_file, ".global main\n");
-    fprintf(context->output_file, "\n");
+    asm_text(&context->writer, ".intel_syntax noprefix\n");
+    asm_text(&context->writer, ".section .text\n");
+    for (size_t i = 0; i < context->functions.count; i++) {
+        const char* name = context->functions.symbols[i].name;
+        if (mono_is_instance_name(name)) asm_weak_symbol(&context->writer, name);
+        else asm_global_symbol(&context->writer, name);
+    }
+    asm_text(&context->writer, "\n");
 }
 
 // エピローグの生成
 void codegen_emit_epilogue(CodeGenContext* context) {
-    fprintf(context->output_file, "\n.section .data\n");
-    
+    AsmWriter* out = &context->writer;
+    asm_text(out, "\n.section .data\n");
+
     // 文字列リテラルの出力
     for (size_t i = 0; i < vector_size(context->string_literals); i++) {
-        char** str = vector_get(context->string_literals, i);
-        fprintf(context->output_file, "str_%zu: .asciz \"%s\"\n", i, *str);
+        asm_string_literal(out, i, vector_get(context->string_literals, i));
     }
-    
+
     // グローバル変数の出力
-    for (size_t i = 0; i < vector_size(context->global_variables); i++) {
-        char** var = vector_get(context->global_variables, i);
-        fprintf(context->output_file, "%s: .quad 0\n", *var);
+    for (size_t i = 0; i < context->global_variables.count; i++) {
+        asm_global_variable(out, context->global_variables.symbols[i].name,
+                            context->global_values ? context->global_values[i] : 0);
+    }
+    asm_text(out, ".section .note.GNU-stack,\"\",@progbits\n");
+}
+
+
+// 二項演算子ごとの命令
+// IRの命令と、スタックマシン方式の整数・浮動小数点数それぞれの命令
+// 比較はsetの条件（浮動小数点数はcomisdの結果を見る）
+typedef struct {
+    const char* text;
+    IrOpcode ir_op;
+    bool compare;
+    AsmOp int_op;
+    AsmOp float_op;
+    AsmCondition int_condition;
+    AsmCondition float_condition;
+} BinaryOperator;
+
+static const BinaryOperator binary_operators[] = {
+    { "+",  IR_ADD, false, ASM_ADD,  ASM_ADDSD,  ASM_CC_E,  ASM_CC_E  },
+    { "-",  IR_SUB, false, ASM_SUB,  ASM_SUBSD,  ASM_CC_E,  ASM_CC_E  },
+    { "*",  IR_MUL, false, ASM_IMUL, ASM_MULSD,  ASM_CC_E,  ASM_CC_E  },
+    { "/",  IR_DIV, false, ASM_IDIV, ASM_DIVSD,  ASM_CC_E,  ASM_CC_E  },
+    { "%",  IR_MOD, false, ASM_IDIV, ASM_DIVSD,  ASM_CC_E,  ASM_CC_E  },
+    { "==", IR_EQ,  true,  ASM_CMP,  ASM_COMISD, ASM_CC_E,  ASM_CC_E  },
+    { "!=", IR_NE,  true,  ASM_CMP,  ASM_COMISD, ASM_CC_NE, ASM_CC_NE },
+    { "<",  IR_LT,  true,  ASM_CMP,  ASM_COMISD, ASM_CC_L,  ASM_CC_B  },
+    { ">",  IR_GT,  true,  ASM_CMP,  ASM_COMISD, ASM_CC_G,  ASM_CC_A  },
+    { "<=", IR_LE,  true,  ASM_CMP,  ASM_COMISD, ASM_CC_LE, ASM_CC_BE },
+    { ">=", IR_GE,  true,  ASM_CMP,  ASM_COMISD, ASM_CC_GE, ASM_CC_AE },
+};
+
+#define BINARY_OPERATOR_COUNT (sizeof(binary_operators) / sizeof(binary_operators[0]))
+
+static const BinaryOperator* find_binary_operator(const char* text) {
+    for (size_t i = 0; i < BINARY_OPERATOR_COUNT; i++) {
+        if (strcmp(binary_operators[i].text, text) == 0) return &binary_operators[i];
+    }
+    return NULL;
+}
+
+// && と ||（短絡評価で、結果は0か1）
+static bool is_logical_operator(const char* text) {
+    return (text[0] == '&' || text[0] == '|') && text[1] == text[0] && text[2] == '\0';
+}
+
+// グローバル変数の初期値（.dataに置くので、リテラルと演算子だけからなる式を畳み込む）
+typedef struct {
+    bool is_float;
+    int64_t integer;
+    double number;
+} Constant;
+
+static double constant_number(const Constant* value) {
+    return value->is_float ? value->number : (double)value->integer;
+}
+
+static bool evaluate_constant(const ASTNode* node, Constant* value);
+
+static bool evaluate_binary_constant(const BinaryExpression* binary, Constant* value) {
+    Constant left, right;
+    if (!evaluate_constant(binary->left, &left) || !evaluate_constant(binary->right, &right)) return false;
+    if (is_logical_operator(binary->operator)) {
+        if (left.is_float || right.is_float) return false;
+        bool result = binary->operator[0] == '&' ? left.integer != 0 && right.integer != 0
+                                                 : left.integer != 0 || right.integer != 0;
+        *value = (Constant){ false, result, 0.0 };
+        return true;
+    }
+    const BinaryOperator* op = find_binary_operator(binary->operator);
+    if (op == NULL) return false;
+
+    if (left.is_float || right.is_float) {
+        double x = constant_number(&left), y = constant_number(&right);
+        switch (op->ir_op) {
+            case IR_ADD: *value = (Constant){ true, 0, x + y }; return true;
+            case IR_SUB: *value = (Constant){ true, 0, x - y }; return true;
+            case IR_MUL: *value = (Constant){ true, 0, x * y }; return true;
+            case IR_DIV: *value = (Constant){ true, 0, x / y }; return true;
+            case IR_EQ:  *value = (Constant){ false, x == y, 0.0 }; return true;
+            case IR_NE:  *value = (Constant){ false, x != y, 0.0 }; return true;
+            case IR_LT:  *value = (Constant){ false, x < y, 0.0 }; return true;
+            case IR_LE:  *value = (Constant){ false, x <= y, 0.0 }; return true;
+            case IR_GT:  *value = (Constant){ false, x > y, 0.0 }; return true;
+            case IR_GE:  *value = (Constant){ false, x >= y, 0.0 }; return true;
+            default:     return false;
+        }
+    }
+
+    // 整数の算術は2の補数で折り返し、実行時に止まる除算は定数にしない
+    int64_t x = left.integer, y = right.integer;
+    uint64_t ux = (uint64_t)x, uy = (uint64_t)y;
+    switch (op->ir_op) {
+        case IR_ADD: value->integer = (int64_t)(ux + uy); break;
+        case IR_SUB: value->integer = (int64_t)(ux - uy); break;
+        case IR_MUL: value->integer = (int64_t)(ux * uy); break;
+        case IR_DIV:
+        case IR_MOD:
+            if (y == 0 || (x == INT64_MIN && y == -1)) return false;
+            value->integer = op->ir_op == IR_DIV ? x / y : x % y;
+            break;
+        case IR_EQ:  value->integer = x == y; break;
+        case IR_NE:  value->integer = x != y; break;
+        case IR_LT:  value->integer = x < y; break;
+        case IR_LE:  value->integer = x <= y; break;
+        case IR_GT:  value->integer = x > y; break;
+        case IR_GE:  value->integer = x >= y; break;
+        default:     return false;
+    }
+    value->is_float = false;
+    return true;
+}
+
+static bool evaluate_constant(const ASTNode* node, Constant* value) {
+    if (node == NULL) return false;
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL:
+            *value = (Constant){ false, node->data.integer_literal.value, 0.0 };
+            return true;
+        case NODE_FLOAT_LITERAL:
+            *value = (Constant){ true, 0, node->data.float_literal.value };
+            return true;
+        case NODE_BOOLEAN_LITERAL:
+            *value = (Constant){ false, node->data.boolean_literal.value ? 1 : 0, 0.0 };
+            return true;
+        case NODE_UNARY_EXPRESSION: {
+            const UnaryExpression* unary = &node->data.unary_expression;
+            if (!evaluate_constant(unary->right, value)) return false;
+            if (strcmp(unary->operator, "-") == 0) {
+                if (value->is_float) value->number = -value->number;
+                else value->integer = (int64_t)(0 - (uint64_t)value->integer);
+                return true;
+            }
+            if (strcmp(unary->operator, "!") == 0 && !value->is_float) {
+                value->integer = value->integer == 0;
+                return true;
+            }
+            return false;
+        }
+        case NODE_BINARY_EXPRESSION:
+            return evaluate_binary_constant(&node->data.binary_expression, value);
+        default:
+            return false;
+    }
+}
+
+// log!からerror!の呼び出しはlibcのprintfにする（ロガーを組み込まないので、ロガーのないインタプリタと
+// 同じ行をlogger_formatと同じ規則で標準出力に書く）。第1引数が文字列リテラルならそれが書式で、{}を
+// 次の引数の変換指定に置き換え、余った引数は空白で区切って後ろに付ける。引数はint・float・bool・string
+// と型の分かるものだけで、boolは"true"か"false"の文字列にして渡す
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} FormatBuffer;
+
+static void format_append(FormatBuffer* buffer, const char* text, size_t length) {
+    if (buffer->failed) return;
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 64;
+        while (buffer->length + length + 1 > capacity) capacity *= 2;
+        char* grown = realloc(buffer->text, capacity);
+        if (grown == NULL) {
+            buffer->failed = true;
+            return;
+        }
+        buffer->text = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->text + buffer->length, text, length);
+    buffer->length += length;
+    buffer->text[buffer->length] = '\0';
+}
+
+// 引数を書く変換指定（型が分からなければNULL）
+static const char* log_conversion(const ASTNode* argument) {
+    const Type* type = argument->resolved_type;
+    if (type == NULL) return NULL;
+    switch (type->kind) {
+        case TYPE_INTEGER: return "%ld";
+        case TYPE_FLOAT:   return "%g";
+        case TYPE_BOOLEAN:
+        case TYPE_STRING:  return "%s";
+        default:           return NULL;
+    }
+}
+
+// printfの書式（mallocした文字列。作れなければNULLで、reasonに理由を書く）
+// *firstは書式の後に渡す最初の引数の位置
+static char* log_format(const FunctionCall* call, size_t* first, const char** reason) {
+    const char* format = "";
+    *first = 0;
+    if (call->argument_count > 0 && call->arguments[0]->type == NODE_STRING_LITERAL) {
+        format = call->arguments[0]->data.string_literal.value;
+        *first = 1;
+    } else if (call->argument_count > 0 && (call->arguments[0]->resolved_type == NULL ||
+                                            call->arguments[0]->resolved_type->kind == TYPE_STRING)) {
+        // 実行時に文字列になる第1引数は書式になるので、コンパイル時に組めない
+        *reason = "log format must be a string literal";
+        return NULL;
+    }
+    if (call->argument_count - *first > LOGGER_MAX_ARGS) {
+        *reason = "too many log arguments";
+        return NULL;
+    }
+    for (size_t i = *first; i < call->argument_count; i++) {
+        if (log_conversion(call->arguments[i]) == NULL) {
+            *reason = "log argument type is not known at compile time";
+            return NULL;
+        }
+    }
+
+    FormatBuffer buffer = { NULL, 0, 0, false };
+    format_append(&buffer, "", 0);
+    if (call->log_level != LOG_LEVEL_LOG) {
+        const char* name = logger_level_name((LogLevel)call->log_level);
+        format_append(&buffer, "[", 1);
+        format_append(&buffer, name, strlen(name));
+        format_append(&buffer, "] ", 2);
+    }
+    size_t used = *first;
+    for (const char* p = format; *p != '\0'; p++) {
+        if (p[0] == '{' && p[1] == '}' && used < call->argument_count) {
+            const char* conversion = log_conversion(call->arguments[used++]);
+            format_append(&buffer, conversion, strlen(conversion));
+            p++;
+        } else {
+            format_append(&buffer, *p == '%' ? "%%" : p, *p == '%' ? 2 : 1);
+        }
+    }
+    for (; used < call->argument_count; used++) {
+        if (used > *first || *format != '\0') format_append(&buffer, " ", 1);
+        const char* conversion = log_conversion(call->arguments[used]);
+        format_append(&buffer, conversion, strlen(conversion));
+    }
+    format_append(&buffer, "\n", 1);
+    if (buffer.failed) {
+        free(buffer.text);
+        *reason = "out of memory";
+        return NULL;
+    }
+    return buffer.text;
+}
+
+static bool log_is_bool(const ASTNode* argument) {
+    return argument->resolved_type != NULL && argument->resolved_type->kind == TYPE_BOOLEAN;
+}
+
+// 値を置くレジスタの種類（型検査器の型や注釈から。分からない型は整数のレジスタに置く）
+static IrType codegen_value_type(const Type* type) {
+    return type != NULL && type->kind == TYPE_FLOAT ? IR_FLOAT : IR_INT;
+}
+
+// ベクトル・行列・四元数か（値はtype_system.hの配置のブロックへのポインタで、IRに変換する関数だけが扱う）
+static bool codegen_is_math(const Type* type) {
+    return type != NULL && (type->kind == TYPE_VECTOR || type->kind == TYPE_MATRIX || type->kind == TYPE_QUATERNION);
+}
+
+// 静的に整数と分かっている式か（floatの置き場所に入れるときはcvtsi2sdで変換する）
+static bool codegen_is_integer(const ASTNode* node) {
+    return node != NULL && node->resolved_type != NULL && node->resolved_type->kind == TYPE_INTEGER;
+}
+
+// 呼び出しの関数型（型検査器が付ける。呼び出す関数が分からなければNULL）
+static const Type* codegen_callee_type(const ASTNode* node) {
+    return node->type == NODE_FUNCTION_CALL ? node->data.function_call.callee_type
+                                            : node->data.call_expression.callee_type;
+}
+
+// 呼び出す関数のindex番目の引数の型（分からなければNULL）
+// 関数の側は注釈で引数のレジスタを決めるので、呼び出し側も同じ型で渡す
+static const Type* codegen_parameter_type(const Type* callee, size_t index) {
+    if (callee == NULL || callee->kind != TYPE_FUNCTION || index >= callee->data.function.parameter_count) return NULL;
+    return callee->data.function.parameter_types[index];
+}
+
+// 名前で直接呼べるか（ローカル変数でもこの単位のグローバル変数でもなければ関数とみなす）
+static bool codegen_is_direct_callee(const CodeGenContext* context, const Resolver* resolver, const char* name) {
+    return resolver_lookup(resolver, name) == 0 && symbol_table_lookup(&context->global_variables, name) == NULL;
+}
+
+// 文字列リテラルを表に加える（番号はstr_<番号>のラベルになる）
+static bool codegen_add_string(CodeGenContext* context, const char* text) {
+    char* copy = strdup(text);
+    size_t count = vector_size(context->string_literals);
+    if (copy != NULL) vector_push(context->string_literals, copy);
+    // vector_pushは拡張に失敗すると何もしない
+    if (vector_size(context->string_literals) == count) {
+        free(copy);
+        return false;
+    }
+    return true;
+}
+
+// IRへの変換の状態
+// ローカル変数はResolverが決めたオフセットごとに仮想レジスタを持つ。
+// 宣言のたびに新しい仮想レジスタにするので、スロットを再利用する別の変数とは区間が分かれる。
+// 数学の型の値はIR_ALLOCのブロックで、式が作ったブロックは文の終わりに、変数が持つブロックは
+// スコープの終わりか代入で解放する（変数どうしはブロックを共有しない）。引数は借用で、
+// 関数の中で代入する引数だけを入口で複製して持つ。
+typedef struct {
+    CodeGenContext* context;
+    IrFunction* function;
+    Resolver resolver;
+    IrValue* locals;           // オフセット / RESOLVER_SLOT_SIZE -> 仮想レジスタ
+    size_t local_count;
+    IrType return_type;        // 戻り値の注釈の型（floatならxmm0で返す）
+    const Type* return_annotation;
+    IrValue* temporaries;      // 文の中で作り、まだ持ち主のないブロック
+    size_t temporary_count;
+    size_t temporary_capacity;
+    IrValue* owned;            // 変数が持つブロックの仮想レジスタ（宣言の順）
+    size_t owned_count;
+    size_t owned_capacity;
+    bool supported;            // falseならスタックマシン方式に戻す
+} Lowering;
+
+static IrValue lower_expression(Lowering* lowering, const ASTNode* node);
+static void lower_statement(Lowering* lowering, const ASTNode* node);
+
+static IrValue lower_unsupported(Lowering* lowering) {
+    lowering->supported = false;
+    return IR_NO_VALUE;
+}
+
+// 値を置き場所の型に合わせる（静的に整数の式だけをfloatに変換する。型の分からない値は
+// ビット列のまま運ぶスタックマシン方式に任せる）
+static IrValue lower_coerce(Lowering* lowering, const ASTNode* node, IrValue value, IrType target) {
+    if (!lowering->supported || value == IR_NO_VALUE) return lower_unsupported(lowering);
+    if ((IrType)lowering->function->value_types[value] == target) return value;
+    if (target == IR_FLOAT && codegen_is_integer(node)) {
+        return ir_emit_unary(lowering->function, IR_INT_TO_FLOAT, value);
+    }
+    return lower_unsupported(lowering);
+}
+
+static IrValue* lower_local(Lowering* lowering, size_t offset) {
+    size_t index = offset / RESOLVER_SLOT_SIZE;
+    if (offset == 0 || index >= lowering->local_count) {
+        lowering->supported = false;
+        return NULL;
+    }
+    return &lowering->locals[index];
+}
+
+static bool lower_append(Lowering* lowering, IrValue** values, size_t* count, size_t* capacity, IrValue value) {
+    if (*count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 8;
+        IrValue* grown = realloc(*values, new_capacity * sizeof(IrValue));
+        if (grown == NULL) {
+            lowering->supported = false;
+            return false;
+        }
+        *values = grown;
+        *capacity = new_capacity;
+    }
+    (*values)[(*count)++] = value;
+    return true;
+}
+
+// 式の値を置く新しいブロック（文の終わりに解放する）
+static IrValue lower_block(Lowering* lowering, const Type* type) {
+    IrValue block = ir_emit_alloc(lowering->function, (uint32_t)type->size);
+    if (block == IR_NO_VALUE) return lower_unsupported(lowering);
+    if (!lower_append(lowering, &lowering->temporaries, &lowering->temporary_count, &lowering->temporary_capacity,
+                      block)) {
+        return IR_NO_VALUE;
+    }
+    return block;
+}
+
+// 式が作ったブロックを持ち主に渡す（式が作ったものでなければfalse）
+static bool lower_claim(Lowering* lowering, IrValue value) {
+    for (size_t i = lowering->temporary_count; i-- > 0;) {
+        if (lowering->temporaries[i] != value) continue;
+        memmove(&lowering->temporaries[i], &lowering->temporaries[i + 1],
+                (lowering->temporary_count - i - 1) * sizeof(IrValue));
+        lowering->temporary_count--;
+        return true;
+    }
+    return false;
+}
+
+// 演算の書き込み先（intoがなければ新しいブロック）
+static IrValue lower_target(Lowering* lowering, IrValue into, const Type* type) {
+    return into != IR_NO_VALUE ? into : lower_block(lowering, type);
+}
+
+// mark番目より後に作ったブロックを解放する
+static void lower_release(Lowering* lowering, size_t mark) {
+    while (lowering->temporary_count > mark) {
+        ir_emit_drop(lowering->function, lowering->temporaries[--lowering->temporary_count]);
+    }
+}
+
+// mark番目より後に宣言した変数のブロックを解放する（keepは返すので解放しない）
+static void lower_drop_owned(Lowering* lowering, size_t mark, IrValue keep) {
+    for (size_t i = lowering->owned_count; i-- > mark;) {
+        if (lowering->owned[i] != keep) ir_emit_drop(lowering->function, lowering->owned[i]);
+    }
+}
+
+// 持ち主のいるブロックにする（式が作ったブロックでなければ複製する）
+static IrValue lower_owned(Lowering* lowering, const Type* type, IrValue value) {
+    if (!lowering->supported || lower_claim(lowering, value)) return value;
+    IrValue copy = ir_emit_alloc(lowering->function, (uint32_t)type->size);
+    ir_emit_vector_copy(lowering->function, copy, value, (uint32_t)type_simd_elements(type));
+    return copy;
+}
+
+// mark番目より後に宣言した変数のスコープを閉じる
+static void lower_pop_owned(Lowering* lowering, size_t mark) {
+    lower_drop_owned(lowering, mark, IR_NO_VALUE);
+    lowering->owned_count = mark;
+}
+
+static bool lower_is_owned(const Lowering* lowering, IrValue value) {
+    for (size_t i = 0; i < lowering->owned_count; i++) {
+        if (lowering->owned[i] == value) return true;
+    }
+    return false;
+}
+
+// 数学の型の式の値（型検査が数学の型を付けていなければスタックマシン方式に戻し、そちらで報告する）
+static IrValue lower_math_operand(Lowering* lowering, const ASTNode* node) {
+    IrValue value = lower_expression(lowering, node);
+    if (!lowering->supported || !codegen_is_math(node->resolved_type)) return lower_unsupported(lowering);
+    return value;
+}
+
+// 組み込みの数学関数（型検査がFunctionCall.math_builtinに書いたもの。math_builtins.def）
+static IrValue lower_math_builtin(Lowering* lowering, const ASTNode* node) {
+    const FunctionCall* call = &node->data.function_call;
+    const Type* type = node->resolved_type;
+    IrFunction* function = lowering->function;
+    switch ((MathBuiltin)call->math_builtin) {
+        case MATH_BUILTIN_VEC2:
+        case MATH_BUILTIN_VEC3:
+        case MATH_BUILTIN_VEC4:
+        case MATH_BUILTIN_QUAT: {
+            // 要素をすべて計算してから書く（詰め物の要素は0）
+            IrValue elements[4];
+            for (size_t i = 0; i < call->argument_count && i < 4; i++) {
+                const ASTNode* argument = call->arguments[i];
+                elements[i] = lower_coerce(lowering, argument, lower_expression(lowering, argument), IR_FLOAT);
+            }
+            if (!codegen_is_math(type) || call->argument_count > 4) return lower_unsupported(lowering);
+            IrValue block = lower_block(lowering, type);
+            if (!lowering->supported) return IR_NO_VALUE;
+            IrValue zero = IR_NO_VALUE;
+            for (size_t i = 0; i < type_simd_elements(type); i++) {
+                if (i >= call->argument_count && zero == IR_NO_VALUE) zero = ir_emit_const_float(function, 0.0);
+                IrValue element = i < call->argument_count ? elements[i] : zero;
+                ir_emit_store(function, block, (uint32_t)(i * TYPE_ELEMENT_SIZE), element);
+            }
+            return block;
+        }
+        case MATH_BUILTIN_MAT4: {
+            IrValue columns[4];
+            for (size_t i = 0; i < call->argument_count && i < 4; i++) {
+                columns[i] = lower_math_operand(lowering, call->arguments[i]);
+            }
+            if (!codegen_is_math(type) || call->argument_count != 4) return lower_unsupported(lowering);
+            const Type* column = call->arguments[0]->resolved_type;
+            IrValue block = lower_block(lowering, type);
+            if (!lowering->supported) return IR_NO_VALUE;
+            for (size_t i = 0; i < 4; i++) {
+                IrValue target = i == 0 ? block
+                    : ir_emit_binary(function, IR_ADD, block, ir_emit_const_int(function, (int64_t)(i * column->size)));
+                ir_emit_vector_copy(function, target, columns[i], (uint32_t)type_simd_elements(column));
+            }
+            return block;
+        }
+        case MATH_BUILTIN_DOT: {
+            // 詰め物の要素は除算で0でなくなりうるので、次元の数だけ掛ける
+            IrValue a = lower_math_operand(lowering, call->arguments[0]);
+            IrValue b = lower_math_operand(lowering, call->arguments[1]);
+            if (!lowering->supported) return IR_NO_VALUE;
+            const Type* operand = call->arguments[0]->resolved_type;
+            size_t count = operand->kind == TYPE_VECTOR ? operand->data.vector.dimension : 4;
+            return ir_emit_vector_dot(function, a, b, (uint32_t)count);
+        }
+        case MATH_BUILTIN_AT: {
+            // 行列の列は行列のブロックの内側を指す（文の中でだけ使う借用）
+            IrValue value = lower_math_operand(lowering, call->arguments[0]);
+            const ASTNode* index = call->arguments[1];
+            if (!lowering->supported || index->type != NODE_INTEGER_LITERAL) return lower_unsupported(lowering);
+            const Type* operand = call->arguments[0]->resolved_type;
+            size_t i = (size_t)index->data.integer_literal.value;
+            if (operand->kind != TYPE_MATRIX) return ir_emit_load(function, value, (uint32_t)(i * TYPE_ELEMENT_SIZE));
+            if (i == 0) return value;
+            return ir_emit_binary(function, IR_ADD, value, ir_emit_const_int(function, (int64_t)(i * type->size)));
+        }
+        default:
+            return lower_unsupported(lowering);
+    }
+}
+
+// 行列×ベクトル（列をベクトルの要素で倍して足す。ベクトルの要素は先にすべて読む）
+static IrValue lower_matrix_vector(Lowering* lowering, const ASTNode* node, IrValue matrix, IrValue vector,
+                                   IrValue into) {
+    IrFunction* function = lowering->function;
+    const Type* result = node->resolved_type;
+    size_t columns = node->data.binary_expression.left->resolved_type->data.matrix.columns;
+    if (columns > 4) return lower_unsupported(lowering);
+    IrValue elements[4];
+    for (size_t j = 0; j < columns; j++) {
+        elements[j] = ir_emit_load(function, vector, (uint32_t)(j * TYPE_ELEMENT_SIZE));
+    }
+    IrValue block = lower_target(lowering, into, result);
+    if (!lowering->supported) return IR_NO_VALUE;
+    uint32_t count = (uint32_t)type_simd_elements(result);
+    IrValue scratch = columns > 1 ? ir_emit_alloc(function, (uint32_t)result->size) : IR_NO_VALUE;
+    for (size_t j = 0; j < columns; j++) {
+        IrValue column = j == 0 ? matrix
+            : ir_emit_binary(function, IR_ADD, matrix, ir_emit_const_int(function, (int64_t)(j * result->size)));
+        ir_emit_vector_scale(function, j == 0 ? block : scratch, column, elements[j], count);
+        if (j > 0) ir_emit_vector_binary(function, IR_VEC_ADD, block, block, scratch, count);
+    }
+    if (scratch != IR_NO_VALUE) ir_emit_drop(function, scratch);
+    return block;
+}
+
+// 数学の型の四則演算（組み合わせは型検査のmath_arithmeticが決めたもの）
+// intoがあれば結果をそのブロックに書く（どの演算も被演算子をすべて読んでから書き込み先に書く）
+static IrValue lower_math_binary(Lowering* lowering, const ASTNode* node, IrValue into) {
+    const BinaryExpression* binary = &node->data.binary_expression;
+    const Type* left = binary->left->resolved_type;
+    const Type* right = binary->right->resolved_type;
+    const Type* result = node->resolved_type;
+    if (left == NULL || right == NULL || !codegen_is_math(result)) return lower_unsupported(lowering);
+
+    IrFunction* function = lowering->function;
+    IrValue a = lower_expression(lowering, binary->left);
+    IrValue b = lower_expression(lowering, binary->right);
+    if (!lowering->supported) return IR_NO_VALUE;
+    char op = binary->operator[0];
+    uint32_t count = (uint32_t)type_simd_elements(result);
+
+    if (left->kind == TYPE_MATRIX && right->kind == TYPE_VECTOR) return lower_matrix_vector(lowering, node, a, b, into);
+    if (left != right) {
+        // スカラー倍（数の側はfloatにする）
+        bool scalar_left = !codegen_is_math(left);
+        IrValue scale = scalar_left ? lower_coerce(lowering, binary->left, a, IR_FLOAT)
+                                    : lower_coerce(lowering, binary->right, b, IR_FLOAT);
+        IrValue block = lower_target(lowering, into, result);
+        if (lowering->supported) ir_emit_vector_scale(function, block, scalar_left ? b : a, scale, count);
+        return block;
+    }
+
+    IrValue block = lower_target(lowering, into, result);
+    if (!lowering->supported) return IR_NO_VALUE;
+    if (op == '*' && result->kind == TYPE_QUATERNION) {
+        ir_emit_quat_mul(function, block, a, b);
+    } else if (op == '*' && result->kind == TYPE_MATRIX) {
+        if (result->data.matrix.rows != 4 || result->data.matrix.columns != 4) return lower_unsupported(lowering);
+        ir_emit_mat4_mul(function, block, a, b);
+    } else {
+        IrOpcode vector_op = op == '+' ? IR_VEC_ADD : op == '-' ? IR_VEC_SUB : op == '*' ? IR_VEC_MUL : IR_VEC_DIV;
+        ir_emit_vector_binary(function, vector_op, block, a, b, count);
+    }
+    return block;
+}
+
+// 式の値が、その式のために作ったばかりの一時値か（変数の仮想レジスタにそのまま使える）
+static bool lower_yields_temporary(const ASTNode* node) {
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL:
+        case NODE_FLOAT_LITERAL:
+        case NODE_STRING_LITERAL:
+        case NODE_BOOLEAN_LITERAL:
+        case NODE_UNARY_EXPRESSION:
+        case NODE_FUNCTION_CALL:
+        case NODE_CALL_EXPRESSION:
+            return true;
+        case NODE_BINARY_EXPRESSION:
+            return !is_logical_operator(node->data.binary_expression.operator);
+        default:
+            return false;
+    }
+}
+
+static IrValue lower_string(Lowering* lowering, const char* text) {
+    char label[32];
+    snprintf(label, sizeof(label), "str_%zu", vector_size(lowering->context->string_literals));
+    if (!codegen_add_string(lowering->context, text)) return lower_unsupported(lowering);
+    return ir_emit_address(lowering->function, intern_cstr(label));
+}
+
+static IrValue lower_name(Lowering* lowering, const ASTNode* node) {
+    const char* name = node->data.variable_reference.name;
+    size_t offset = resolver_lookup(&lowering->resolver, name);
+    if (offset != 0) {
+        IrValue* local = lower_local(lowering, offset);
+        if (local == NULL || *local == IR_NO_VALUE) return lower_unsupported(lowering);
+        return *local;
+    }
+    // 関数の名前はそのアドレス、それ以外はグローバル変数（ほかの単位のものでもよい）
+    if (symbol_table_lookup(&lowering->context->functions, name) != NULL) {
+        return ir_emit_address(lowering->function, name);
+    }
+    return ir_emit_load_global(lowering->function, name, codegen_value_type(node->resolved_type));
+}
+
+// 条件の値を0か1にする
+static IrValue lower_truth(Lowering* lowering, const ASTNode* node) {
+    IrValue value = lower_expression(lowering, node);
+    if (!lowering->supported) return IR_NO_VALUE;
+    if (lowering->function->value_types[value] != IR_INT || codegen_is_math(node->resolved_type)) {
+        return lower_unsupported(lowering);
+    }
+    return ir_emit_binary(lowering->function, IR_NE, value, ir_emit_const_int(lowering->function, 0));
+}
+
+static IrValue lower_logical(Lowering* lowering, const BinaryExpression* binary) {
+    IrFunction* function = lowering->function;
+    IrValue result = ir_new_value(function, IR_INT);
+    uint32_t right_label = ir_new_label(function);
+    uint32_t end_label = ir_new_label(function);
+
+    IrValue left = lower_truth(lowering, binary->left);
+    if (!lowering->supported) return IR_NO_VALUE;
+    ir_emit_move(function, result, left);
+    if (binary->operator[0] == '&') {
+        ir_emit_branch_false(function, left, end_label);
+    } else {
+        ir_emit_branch_false(function, left, right_label);
+        ir_emit_jump(function, end_label);
+    }
+    // 右辺の一時ブロックは右辺を計算したときだけ作るので、その場で解放する
+    ir_emit_label(function, right_label);
+    size_t mark = lowering->temporary_count;
+    IrValue right = lower_truth(lowering, binary->right);
+    if (!lowering->supported) return IR_NO_VALUE;
+    lower_release(lowering, mark);
+    ir_emit_move(function, result, right);
+    ir_emit_label(function, end_label);
+    return result;
+}
+
+static IrValue lower_binary(Lowering* lowering, const ASTNode* node) {
+    const BinaryExpression* binary = &node->data.binary_expression;
+    if (is_logical_operator(binary->operator)) return lower_logical(lowering, binary);
+    if (codegen_is_math(binary->left->resolved_type) || codegen_is_math(binary->right->resolved_type)) {
+        return lower_math_binary(lowering, node, IR_NO_VALUE);
+    }
+    const BinaryOperator* op = find_binary_operator(binary->operator);
+    if (op == NULL) return lower_unsupported(lowering);
+
+    IrValue left = lower_expression(lowering, binary->left);
+    IrValue right = lower_expression(lowering, binary->right);
+    if (!lowering->supported || left == IR_NO_VALUE || right == IR_NO_VALUE) return lower_unsupported(lowering);
+
+    // 片方がfloatなら、整数の側を変換してからfloatで計算する
+    IrFunction* function = lowering->function;
+    IrType type = function->value_types[left] == IR_FLOAT || function->value_types[right] == IR_FLOAT ? IR_FLOAT : IR_INT;
+    left = lower_coerce(lowering, binary->left, left, type);
+    right = lower_coerce(lowering, binary->right, right, type);
+    if (!lowering->supported || (op->ir_op == IR_MOD && type == IR_FLOAT)) return lower_unsupported(lowering);
+    return ir_emit_binary(function, op->ir_op, left, right);
+}
+
+// boolを"true"か"false"の文字列にする
+static IrValue lower_bool_text(Lowering* lowering, IrValue value) {
+    IrFunction* function = lowering->function;
+    IrValue result = ir_new_value(function, IR_INT);
+    uint32_t false_label = ir_new_label(function);
+    uint32_t end_label = ir_new_label(function);
+    ir_emit_branch_false(function, value, false_label);
+    ir_emit_move(function, result, lower_string(lowering, "true"));
+    ir_emit_jump(function, end_label);
+    ir_emit_label(function, false_label);
+    ir_emit_move(function, result, lower_string(lowering, "false"));
+    ir_emit_label(function, end_label);
+    return result;
+}
+
+// ログのマクロ（書式を組めなければスタックマシン方式に戻し、そちらで理由を報告する）
+static IrValue lower_log(Lowering* lowering, const ASTNode* node) {
+    const FunctionCall* call = &node->data.function_call;
+    size_t first;
+    const char* reason;
+    char* format = log_format(call, &first, &reason);
+    if (format == NULL) return lower_unsupported(lowering);
+    IrValue args[LOGGER_MAX_ARGS + 1];
+    args[0] = lower_string(lowering, format);
+    free(format);
+
+    size_t count = 1, floats = 0;
+    for (size_t i = first; i < call->argument_count && lowering->supported; i++) {
+        IrValue value = lower_expression(lowering, call->arguments[i]);
+        if (!lowering->supported) return IR_NO_VALUE;
+        if (log_is_bool(call->arguments[i])) value = lower_bool_text(lowering, value);
+        if (lowering->function->value_types[value] == IR_FLOAT) floats++;
+        args[count++] = value;
+    }
+    if (!lowering->supported || count - floats > CODEGEN_MAX_REGISTER_ARGUMENTS ||
+        floats > CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS) {
+        return lower_unsupported(lowering);
+    }
+    return ir_emit_call(lowering->function, intern_cstr("printf"), IR_INT, args, (uint32_t)count);
+}
+
+// 数学の型の符号反転（-1倍。intoがあれば結果をそのブロックに書く）
+static IrValue lower_math_negate(Lowering* lowering, const ASTNode* node, IrValue into) {
+    const UnaryExpression* unary = &node->data.unary_expression;
+    const Type* type = unary->right->resolved_type;
+    IrValue operand = lower_math_operand(lowering, unary->right);
+    if (!lowering->supported || strcmp(unary->operator, "-") != 0) return lower_unsupported(lowering);
+    IrValue minus_one = ir_emit_const_float(lowering->function, -1.0);
+    IrValue block = lower_target(lowering, into, type);
+    if (lowering->supported) {
+        ir_emit_vector_scale(lowering->function, block, operand, minus_one, (uint32_t)type_simd_elements(type));
+    }
+    return block;
+}
+
+static IrValue lower_unary(Lowering* lowering, const ASTNode* node) {
+    const UnaryExpression* unary = &node->data.unary_expression;
+    if (codegen_is_math(unary->right->resolved_type)) return lower_math_negate(lowering, node, IR_NO_VALUE);
+    IrValue operand = lower_expression(lowering, unary->right);
+    if (!lowering->supported) return IR_NO_VALUE;
+    if (strcmp(unary->operator, "-") == 0) return ir_emit_unary(lowering->function, IR_NEG, operand);
+    if (strcmp(unary->operator, "!") == 0 && lowering->function->value_types[operand] == IR_INT) {
+        return ir_emit_unary(lowering->function, IR_NOT, operand);
+    }
+    return lower_unsupported(lowering);
+}
+
+static IrValue lower_call(Lowering* lowering, const ASTNode* node, const char* symbol, ASTNode* const* arguments,
+                          size_t count) {
+    // 引数はレジスタ渡しの範囲（整数6個とfloat8個）まで
+    if (count > CODEGEN_MAX_REGISTER_ARGUMENTS + CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS) {
+        return lower_unsupported(lowering);
+    }
+    const Type* callee = codegen_callee_type(node);
+    IrValue args[CODEGEN_MAX_REGISTER_ARGUMENTS + CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS] = { 0 };
+    size_t floats = 0;
+    for (size_t i = 0; i < count; i++) {
+        // 数学の型の引数はブロックへのポインタで、引数の型とちょうど同じでなければならない
+        const Type* parameter = codegen_parameter_type(callee, i);
+        if ((codegen_is_math(parameter) || codegen_is_math(arguments[i]->resolved_type)) &&
+            parameter != arguments[i]->resolved_type) {
+            return lower_unsupported(lowering);
+        }
+        IrType type = codegen_value_type(parameter);
+        args[i] = lower_coerce(lowering, arguments[i], lower_expression(lowering, arguments[i]), type);
+        if (!lowering->supported) return IR_NO_VALUE;
+        if (type == IR_FLOAT) floats++;
+    }
+    if (count - floats > CODEGEN_MAX_REGISTER_ARGUMENTS || floats > CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS) {
+        return lower_unsupported(lowering);
+    }
+    // 戻り値の型が分からなければ整数として受け取る（数学の型なら呼び出し先が作ったブロックを受け取る）
+    IrValue result = ir_emit_call(lowering->function, symbol, codegen_value_type(node->resolved_type), args,
+                                  (uint32_t)count);
+    // 数学の型の引数は借用で渡す（呼び出し先は持ち続けも解放もせず、代入するなら複製する）
+    for (size_t i = 0; i < count; i++) {
+        if (codegen_is_math(arguments[i]->resolved_type)) ir_mark_borrowed(lowering->function, (uint32_t)i);
+    }
+    if (codegen_is_math(node->resolved_type)) {
+        lower_append(lowering, &lowering->temporaries, &lowering->temporary_count, &lowering->temporary_capacity,
+                     result);
+    }
+    return result;
+}
+
+// 数学の型の変数への代入
+// 右辺の最後が四則演算か符号反転なら、変数のブロックに直接書く（`x = x + y`は確保も解放もしない）。
+// それ以外は右辺のブロックを受け取り、古いブロックは同じ文の中でまだ読めるように文の終わりに解放する。
+static IrValue lower_math_assignment(Lowering* lowering, const Assignment* assignment) {
+    IrFunction* function = lowering->function;
+    const ASTNode* node = assignment->value;
+    size_t offset = resolver_lookup(&lowering->resolver, assignment->name);
+    IrValue* local = offset != 0 ? lower_local(lowering, offset) : NULL;
+    if (local == NULL || *local == IR_NO_VALUE || !lower_is_owned(lowering, *local)) return lower_unsupported(lowering);
+    IrValue target = *local;
+    if (node->type == NODE_BINARY_EXPRESSION && !is_logical_operator(node->data.binary_expression.operator)) {
+        return lower_math_binary(lowering, node, target);
+    }
+    if (node->type == NODE_UNARY_EXPRESSION) return lower_math_negate(lowering, node, target);
+
+    IrValue value = lower_owned(lowering, node->resolved_type, lower_math_operand(lowering, node));
+    if (!lowering->supported) return IR_NO_VALUE;
+    IrValue old = ir_new_value(function, IR_INT);
+    ir_emit_move(function, old, *local);
+    lower_append(lowering, &lowering->temporaries, &lowering->temporary_count, &lowering->temporary_capacity, old);
+    ir_emit_move(function, *local, value);
+    return *local;
+}
+
+static IrValue lower_assignment(Lowering* lowering, const ASTNode* node) {
+    const Assignment* assignment = &node->data.assignment;
+    if (codegen_is_math(assignment->value->resolved_type)) return lower_math_assignment(lowering, assignment);
+    IrFunction* function = lowering->function;
+    IrValue initial = lower_expression(lowering, assignment->value);
+    if (!lowering->supported) return IR_NO_VALUE;
+
+    size_t offset = resolver_lookup(&lowering->resolver, assignment->name);
+    if (offset == 0) {
+        IrValue value = lower_coerce(lowering, assignment->value, initial, codegen_value_type(node->resolved_type));
+        if (lowering->supported) ir_emit_store_global(function, assignment->name, value);
+        return value;
+    }
+    IrValue* local = lower_local(lowering, offset);
+    if (local == NULL || *local == IR_NO_VALUE) return lower_unsupported(lowering);
+    IrValue value = lower_coerce(lowering, assignment->value, initial, (IrType)function->value_types[*local]);
+    if (!lowering->supported) return IR_NO_VALUE;
+    // 右辺が作った一時値（変換の結果も）はそのまま変数に書かせる
+    bool temporary = value != initial || lower_yields_temporary(assignment->value);
+    if (!temporary || !ir_retarget_last(function, value, *local)) {
+        ir_emit_move(function, *local, value);
+    }
+    return *local;
+}
+
+static IrValue lower_expression(Lowering* lowering, const ASTNode* node) {
+    if (node == NULL || !lowering->supported) return lower_unsupported(lowering);
+
+    IrFunction* function = lowering->function;
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL:
+            return ir_emit_const_int(function, node->data.integer_literal.value);
+        case NODE_FLOAT_LITERAL:
+            return ir_emit_const_float(function, node->data.float_literal.value);
+        case NODE_BOOLEAN_LITERAL:
+            return ir_emit_const_int(function, node->data.boolean_literal.value ? 1 : 0);
+        case NODE_STRING_LITERAL:
+            return lower_string(lowering, node->data.string_literal.value);
+
+        case NODE_VARIABLE_REFERENCE:
+            return lower_name(lowering, node);
+
+        case NODE_ASSIGNMENT:
+            return lower_assignment(lowering, node);
+
+        case NODE_BINARY_EXPRESSION:
+            return lower_binary(lowering, node);
+
+        case NODE_UNARY_EXPRESSION:
+            return lower_unary(lowering, node);
+
+        case NODE_FUNCTION_CALL: {
+            const FunctionCall* call = &node->data.function_call;
+            if (call->log_level >= 0) return lower_log(lowering, node);
+            if (call->math_builtin >= 0) return lower_math_builtin(lowering, node);
+            if (!codegen_is_direct_callee(lowering->context, &lowering->resolver, call->name)) break;
+            // 汎用関数の呼び出しは型検査が選んだ特殊化を呼ぶ
+            const char* symbol = call->specialization ? call->specialization : call->name;
+            return lower_call(lowering, node, symbol, call->arguments, call->argument_count);
+        }
+
+        case NODE_CALL_EXPRESSION: {
+            const CallExpression* call = &node->data.call_expression;
+            const ASTNode* callee = call->callee;
+            if (callee == NULL || callee->type != NODE_VARIABLE_REFERENCE ||
+                !codegen_is_direct_callee(lowering->context, &lowering->resolver, callee->data.variable_reference.name)) {
+                break;
+            }
+            return lower_call(lowering, node, callee->data.variable_reference.name, call->arguments,
+                              call->argument_count);
+        }
+
+        default:
+            break;
+    }
+    return lower_unsupported(lowering);
+}
+
+// if/whileの枝は、ブロックでなくても自分のスコープを持つ（resolver.hと同じ規則）
+static void lower_scoped(Lowering* lowering, const ASTNode* node) {
+    if (node == NULL) return;
+    if (!resolver_push_scope(&lowering->resolver)) {
+        lowering->supported = false;
+        return;
+    }
+    size_t owned = lowering->owned_count;
+    lower_statement(lowering, node);
+    lower_pop_owned(lowering, owned);
+    resolver_pop_scope(&lowering->resolver);
+}
+
+// 数学の型の変数は、初期化式が作ったブロックか、その複製を持つ（初期化式がなければ0で埋める）
+static void lower_math_let(Lowering* lowering, const LetStatement* let, const Type* type) {
+    IrFunction* function = lowering->function;
+    IrValue value;
+    if (let->initializer != NULL) {
+        value = lower_owned(lowering, type, lower_math_operand(lowering, let->initializer));
+    } else {
+        value = ir_emit_alloc(function, (uint32_t)type->size);
+        IrValue zero = ir_emit_const_float(function, 0.0);
+        for (size_t i = 0; i < type_simd_elements(type); i++) {
+            ir_emit_store(function, value, (uint32_t)(i * TYPE_ELEMENT_SIZE), zero);
+        }
+    }
+    if (!lowering->supported || value == IR_NO_VALUE) {
+        lowering->supported = false;
+        return;
+    }
+
+    IrValue* local = lower_local(lowering, resolver_declare(&lowering->resolver, let->name));
+    if (local == NULL) return;
+    *local = value;
+    lower_append(lowering, &lowering->owned, &lowering->owned_count, &lowering->owned_capacity, value);
+}
+
+static void lower_let(Lowering* lowering, const LetStatement* let) {
+    const Type* math = let->type != NULL ? let->type : let->initializer != NULL ? let->initializer->resolved_type : NULL;
+    if (codegen_is_math(math)) {
+        lower_math_let(lowering, let, math);
+        return;
+    }
+    IrFunction* function = lowering->function;
+    IrValue initial = IR_NO_VALUE;
+    IrValue value;
+    if (let->initializer != NULL) {
+        initial = lower_expression(lowering, let->initializer);
+        // 注釈があればその型に合わせる
+        IrType type = let->type != NULL ? codegen_value_type(let->type)
+                                        : initial != IR_NO_VALUE ? (IrType)function->value_types[initial] : IR_INT;
+        value = lower_coerce(lowering, let->initializer, initial, type);
+    } else if (codegen_value_type(let->type) == IR_FLOAT) {
+        value = ir_emit_const_float(function, 0.0);
+    } else {
+        value = ir_emit_const_int(function, 0);
+    }
+    if (!lowering->supported || value == IR_NO_VALUE) {
+        lowering->supported = false;
+        return;
+    }
+
+    // 初期化式の中の同名の参照は外側の変数を指すので、宣言は初期化式の後
+    IrValue* local = lower_local(lowering, resolver_declare(&lowering->resolver, let->name));
+    if (local == NULL) return;
+
+    // 初期化式が作った一時値（変換の結果も）はそのまま変数の仮想レジスタにする
+    if (let->initializer == NULL || value != initial || lower_yields_temporary(let->initializer)) {
+        *local = value;
+    } else {
+        *local = ir_new_value(function, (IrType)function->value_types[value]);
+        ir_emit_move(function, *local, value);
+    }
+}
+
+// if/whileの条件（条件の中で作ったブロックは分岐の前に解放する）
+static IrValue lower_condition(Lowering* lowering, const ASTNode* node) {
+    size_t mark = lowering->temporary_count;
+    IrValue condition = lower_expression(lowering, node);
+    if (node != NULL && codegen_is_math(node->resolved_type)) return lower_unsupported(lowering);
+    lower_release(lowering, mark);
+    return condition;
+}
+
+// 数学の型の値を返す（変数のブロックはそのまま渡し、それ以外は呼び出し元が持つブロックにする）
+static void lower_math_return(Lowering* lowering, const ASTNode* value) {
+    IrValue result = lower_math_operand(lowering, value);
+    if (!lowering->supported || value->resolved_type != lowering->return_annotation) {
+        lowering->supported = false;
+        return;
+    }
+    IrValue keep = IR_NO_VALUE;
+    if (lower_is_owned(lowering, result)) {
+        keep = result;
+    } else {
+        result = lower_owned(lowering, value->resolved_type, result);
     }
+    lower_release(lowering, 0);
+    lower_drop_owned(lowering, 0, keep);
+    ir_emit_return(lowering->function, result);
+}
+
+static void lower_statement(Lowering* lowering, const ASTNode* node) {
+    if (node == NULL || !lowering->supported) return;
+    IrFunction* function = lowering->function;
+
+    switch (node->type) {
+        case NODE_BLOCK_STATEMENT: {
+            if (!resolver_push_scope(&lowering->resolver)) {
+                lowering->supported = false;
+                return;
+            }
+            const BlockStatement* block = &node->data.block_statement;
+            size_t owned = lowering->owned_count;
+            for (size_t i = 0; i < block->statement_count && lowering->supported; i++) {
+                lower_statement(lowering, block->statements[i]);
+            }
+            lower_pop_owned(lowering, owned);
+            resolver_pop_scope(&lowering->resolver);
+            return;
+        }
+
+        case NODE_IF_STATEMENT: {
+            const IfStatement* statement = &node->data.if_statement;
+            uint32_t else_label = ir_new_label(function);
+            uint32_t end_label = ir_new_label(function);
+            ir_emit_branch_false(function, lower_condition(lowering, statement->condition), else_label);
+            lower_scoped(lowering, statement->then_branch);
+            ir_emit_jump(function, end_label);
+            ir_emit_label(function, else_label);
+            lower_scoped(lowering, statement->else_branch);
+            ir_emit_label(function, end_label);
+            return;
+        }
+
+        case NODE_WHILE_STATEMENT: {
+            const WhileStatement* statement = &node->data.while_statement;
+            uint32_t start_label = ir_new_label(function);
+            uint32_t exit_label = ir_new_label(function);
+            ir_emit_label(function, start_label);
+            ir_emit_branch_false(function, lower_condition(lowering, statement->condition), exit_label);
+            lower_scoped(lowering, statement->body);
+            ir_emit_jump(function, start_label);
+            ir_emit_label(function, exit_label);
+            return;
+        }
+
+        case NODE_LET_STATEMENT: {
+            size_t mark = lowering->temporary_count;
+            lower_let(lowering, &node->data.let_statement);
+            lower_release(lowering, mark);
+            return;
+        }
+
+        case NODE_RETURN_STATEMENT: {
+            // 値は戻り値の注釈の型で返す（変数のブロックは返す前にすべて解放する）
+            const ASTNode* value = node->data.return_statement.value;
+            if (value != NULL && (codegen_is_math(lowering->return_annotation) || codegen_is_math(value->resolved_type))) {
+                lower_math_return(lowering, value);
+                return;
+            }
+            IrValue result = IR_NO_VALUE;
+            if (value != NULL) result = lower_coerce(lowering, value, lower_expression(lowering, value), lowering->return_type);
+            lower_release(lowering, 0);
+            lower_drop_owned(lowering, 0, IR_NO_VALUE);
+            if (lowering->supported) ir_emit_return(function, result);
+            return;
+        }
+
+        case NODE_EXPRESSION_STATEMENT: {
+            size_t mark = lowering->temporary_count;
+            lower_expression(lowering, node->data.expression_statement.expression);
+            lower_release(lowering, mark);
+            return;
+        }
+
+        default:
+            // 入れ子の関数などはスタックマシン方式でも出力しない
+            lowering->supported = false;
+            return;
+    }
+}
+
+// nodeの中に名前nameへの代入があるか（IRに変換できる構文だけを見る）
+static bool codegen_assigns(const ASTNode* node, const char* name) {
+    if (node == NULL) return false;
+    switch (node->type) {
+        case NODE_ASSIGNMENT:
+            return strcmp(node->data.assignment.name, name) == 0 || codegen_assigns(node->data.assignment.value, name);
+        case NODE_BINARY_EXPRESSION:
+            return codegen_assigns(node->data.binary_expression.left, name) ||
+                   codegen_assigns(node->data.binary_expression.right, name);
+        case NODE_UNARY_EXPRESSION:
+            return codegen_assigns(node->data.unary_expression.right, name);
+        case NODE_FUNCTION_CALL:
+            for (size_t i = 0; i < node->data.function_call.argument_count; i++) {
+                if (codegen_assigns(node->data.function_call.arguments[i], name)) return true;
+            }
+            return false;
+        case NODE_CALL_EXPRESSION:
+            for (size_t i = 0; i < node->data.call_expression.argument_count; i++) {
+                if (codegen_assigns(node->data.call_expression.arguments[i], name)) return true;
+            }
+            return codegen_assigns(node->data.call_expression.callee, name);
+        case NODE_BLOCK_STATEMENT:
+            for (size_t i = 0; i < node->data.block_statement.statement_count; i++) {
+                if (codegen_assigns(node->data.block_statement.statements[i], name)) return true;
+            }
+            return false;
+        case NODE_IF_STATEMENT:
+            return codegen_assigns(node->data.if_statement.condition, name) ||
+                   codegen_assigns(node->data.if_statement.then_branch, name) ||
+                   codegen_assigns(node->data.if_statement.else_branch, name);
+        case NODE_WHILE_STATEMENT:
+            return codegen_assigns(node->data.while_statement.condition, name) ||
+                   codegen_assigns(node->data.while_statement.body, name);
+        case NODE_LET_STATEMENT:
+            return codegen_assigns(node->data.let_statement.initializer, name);
+        case NODE_RETURN_STATEMENT:
+            return codegen_assigns(node->data.return_statement.value, name);
+        case NODE_EXPRESSION_STATEMENT:
+            return codegen_assigns(node->data.expression_statement.expression, name);
+        default:
+            return false;
+    }
+}
+
+// 引数がすべてレジスタに載るか
+static bool codegen_registers_fit(const Function* function) {
+    size_t floats = 0;
+    for (size_t i = 0; i < function->parameter_count; i++) {
+        if (codegen_value_type(function->parameters[i]->type) == IR_FLOAT) floats++;
+    }
+    return function->parameter_count - floats <= CODEGEN_MAX_REGISTER_ARGUMENTS &&
+           floats <= CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS;
+}
+
+// 関数をIRに変換する（対応していない構文があればNULL）
+static IrFunction* codegen_lower_function(CodeGenContext* context, const ASTNode* node) {
+    const Function* data = &node->data.function;
+    Lowering lowering;
+    lowering.context = context;
+    resolver_init(&lowering.resolver, &context->global_variables, &context->functions);
+    size_t frame_size = 0;
+    bool resolved = resolver_begin_function(&lowering.resolver, node, &frame_size) == SLANG_SUCCESS;
+    lowering.function = ir_function_create(data->name);
+    if (lowering.function != NULL) lowering.function->priority = data->priority;
+    lowering.local_count = frame_size / RESOLVER_SLOT_SIZE + 1;
+    lowering.locals = malloc(lowering.local_count * sizeof(IrValue));
+    lowering.return_type = codegen_value_type(data->return_type);
+    lowering.return_annotation = data->return_type;
+    lowering.temporaries = NULL;
+    lowering.temporary_count = lowering.temporary_capacity = 0;
+    lowering.owned = NULL;
+    lowering.owned_count = lowering.owned_capacity = 0;
+    lowering.supported = resolved && lowering.function != NULL && lowering.locals != NULL &&
+                         codegen_registers_fit(data);
+
+    for (size_t i = 0; lowering.supported && i < lowering.local_count; i++) {
+        lowering.locals[i] = IR_NO_VALUE;
+    }
+
+    // 引数は注釈の型で受け取る（注釈のない引数は整数のレジスタ）
+    for (size_t i = 0; lowering.supported && i < data->parameter_count; i++) {
+        IrValue* local = lower_local(&lowering, resolver_parameter_offset(i));
+        if (local != NULL) {
+            *local = ir_emit_param(lowering.function, (uint32_t)i, codegen_value_type(data->parameters[i]->type));
+        }
+    }
+    // 数学の型の引数は呼び出し元のブロックを借りるので、代入する引数だけは複製を持つ
+    // （引数はプロローグでまとめて受け取るので、複製はすべてのIR_PARAMの後。mallocが引数のレジスタを壊す）
+    for (size_t i = 0; lowering.supported && i < data->parameter_count; i++) {
+        const Variable* parameter = data->parameters[i];
+        IrValue* local = lower_local(&lowering, resolver_parameter_offset(i));
+        if (local == NULL || !codegen_is_math(parameter->type) || !codegen_assigns(data->body, parameter->name)) continue;
+        *local = lower_owned(&lowering, parameter->type, *local);
+        lower_append(&lowering, &lowering.owned, &lowering.owned_count, &lowering.owned_capacity, *local);
+    }
+
+    lower_statement(&lowering, data->body);
+    lower_pop_owned(&lowering, 0);
+    resolver_free(&lowering.resolver);
+    free(lowering.locals);
+    free(lowering.temporaries);
+    free(lowering.owned);
+
+    if (!lowering.supported || lowering.function == NULL || lowering.function->failed) {
+        ir_function_destroy(lowering.function);
+        return NULL;
+    }
+    return lowering.function;
+}
+
+// 失敗した変換が登録した文字列リテラルを取り消す
+static void codegen_discard_strings(CodeGenContext* context, size_t count) {
+    Vector* literals = context->string_literals;
+    while (vector_size(literals) > count) {
+        free(vector_pop(literals));
+    }
+}
+
+// 最上位のindex番目の文が出力する関数か（同名の関数が複数あれば、記号表に残った最後のものだけ）
+static bool codegen_owns_function(const CodeGenContext* context, const ASTNode* node, size_t index) {
+    if (node == NULL || node->type != NODE_FUNCTION || node->data.function.name == NULL) return false;
+    const Symbol* symbol = symbol_table_lookup(&context->functions, node->data.function.name);
+    return symbol != NULL && symbol->slot == index;
+}
+
+// IRとレジスタ割り当てを経由した関数の生成
+// 出力は取り消せる区間に書き、最後まで生成できたときだけ確定する
+// 変換に成功していた関数の文字列リテラルは、生成に失敗しても使われないまま表に残る
+static bool codegen_emit_function_ir(CodeGenContext* context, ASTNode* node) {
+    const Symbol* symbol = symbol_table_lookup(&context->functions, node->data.function.name);
+    if (symbol == NULL || symbol->slot >= context->module_count) return false;
+    IrFunction* function = context->module[symbol->slot];
+    if (function == NULL || !context->allocated[symbol->slot]) return false;
+
+    size_t mark = asm_writer_mark(&context->writer);
+    bool emitted = x86_emit_function(&context->writer, function, &context->allocations[symbol->slot], NULL) ==
+                   SLANG_SUCCESS;
+    if (emitted) {
+        asm_writer_commit(&context->writer);
+    } else {
+        asm_writer_rollback(&context->writer, mark);
+    }
+    return emitted;
+}
+
+// 関数ごとのレジスタ割り当て（関数どうしは独立）
+static void codegen_allocate_task(void* argument, size_t begin, size_t end) {
+    CodeGenContext* context = argument;
+    for (size_t i = begin; i < end; i++) {
+        if (context->module[i] == NULL) continue;
+        context->allocated[i] = regalloc_run(context->module[i], &context->allocations[i]) == SLANG_SUCCESS;
+    }
+}
+
+// 全関数をIRに変換してから最適化する（インライン展開は同じ単位の関数を参照する）
+// 変換は文字列リテラルの番号を決めるので文の順に行い、最適化とレジスタ割り当ては関数ごとに並列に行う
+static SlangError codegen_optimize_module(CodeGenContext* context, const BlockStatement* program) {
+    size_t count = program->statement_count;
+    context->module = calloc(count ? count : 1, sizeof(IrFunction*));
+    context->allocations = calloc(count ? count : 1, sizeof(RegisterAllocation));
+    context->allocated = calloc(count ? count : 1, sizeof(bool));
+    if (context->module == NULL || context->allocations == NULL || context->allocated == NULL) {
+        return SLANG_ERROR_INTERNAL;
+    }
+    context->module_count = count;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!codegen_owns_function(context, program->statements[i], i)) continue;
+        size_t string_count = vector_size(context->string_literals);
+        context->module[i] = codegen_lower_function(context, program->statements[i]);
+        if (context->module[i] == NULL) codegen_discard_strings(context, string_count);
+    }
+
+    // 最適化に失敗した関数は変換したままのIRを使う
+    SlangError error = optimizer_run_module(&context->optimizer, context->pool, context->module, count);
+    if (error != SLANG_SUCCESS) return error;
+
+    thread_pool_for(context->pool, count, 1, codegen_allocate_task, context);
+    return SLANG_SUCCESS;
+}
+
+// スタックマシン方式で使うオペランド
+// 作業用はcaller-savedで引数にも使わないr11にする（rbxはcallee-savedなので保存が要る）
+#define RAX asm_reg(X86_RAX)
+#define R11 asm_reg(X86_R11)
+
+static const X86Register argument_registers[CODEGEN_MAX_REGISTER_ARGUMENTS] = {
+    X86_RDI, X86_RSI, X86_RDX, X86_RCX, X86_R8, X86_R9
+};
+
+// 生成できない式（理由を残し、codegen_generateはSLANG_ERROR_TYPEを返す）
+static void codegen_fail(CodeGenContext* context, const ASTNode* node, const char* reason) {
+    if (context->error != NULL) return;
+    context->error = reason;
+    context->error_node = node;
+}
+
+static void codegen_emit_frame_exit(AsmWriter* out) {
+    asm_emit(out, ASM_MOV, asm_reg(X86_RSP), asm_reg(X86_RBP));
+    asm_emit1(out, ASM_POP, asm_reg(X86_RBP));
+    asm_emit0(out, ASM_RET);
+}
+
+// スタックマシン方式の演算の型（型検査器の型があればそれを、型の分からない式は浮動小数点数の
+// リテラルから伝わる分を見る）
+static bool codegen_is_float(const ASTNode* node) {
+    if (node == NULL) return false;
+    if (node->resolved_type != NULL) return node->resolved_type->kind == TYPE_FLOAT;
+    switch (node->type) {
+        case NODE_FLOAT_LITERAL:
+            return true;
+        case NODE_BINARY_EXPRESSION: {
+            const BinaryOperator* op = find_binary_operator(node->data.binary_expression.operator);
+            return op != NULL && !op->compare &&
+                   (codegen_is_float(node->data.binary_expression.left) ||
+                    codegen_is_float(node->data.binary_expression.right));
+        }
+        case NODE_UNARY_EXPRESSION:
+            return strcmp(node->data.unary_expression.operator, "-") == 0 &&
+                   codegen_is_float(node->data.unary_expression.right);
+        case NODE_ASSIGNMENT:
+            return codegen_is_float(node->data.assignment.value);
+        default:
+            return false;
+    }
+}
+
+// raxの値を置き場所の型に合わせる（静的に整数の式だけをfloatのビット列に変換する）
+static void codegen_emit_coerce(AsmWriter* out, const ASTNode* node, bool to_float) {
+    if (!to_float || !codegen_is_integer(node)) return;
+    asm_emit(out, ASM_CVTSI2SD, asm_xmm(0), RAX);
+    asm_emit(out, ASM_MOVQ, RAX, asm_xmm(0));
 }
 
 // 関数の生成
 void codegen_emit_function(CodeGenContext* context, ASTNode* node) {
-    if (node == NULL || node->type != NODE_FUNCTION_DECL) return;
-    if (node->as.function.name == NULL) return;
+    if (node == NULL || node->type != NODE_FUNCTION) return;
+    const Function* function = &node->data.function;
+    if (function->name == NULL) return;
 
-    fprintf(context->output_file, "\n%s:\n", node->as.function.name);
-    fprintf(context->output_file, "    push rbp\n");
-    fprintf(context->output_file, "    mov rbp, rsp\n");
+    // まずレジスタ割り当てを試し、対応していない構文を含む関数だけスタックマシン方式で出力する
+    if (codegen_emit_function_ir(context, node)) return;
+
+    AsmWriter* out = &context->writer;
+    size_t frame_size;
+    if (resolver_begin_function(&context->resolver, node, &frame_size) != SLANG_SUCCESS) {
+        out->failed = true;
+        return;
+    }
+
+    asm_text(out, "\n");
+    asm_symbol(out, function->name);
+    asm_emit1(out, ASM_PUSH, asm_reg(X86_RBP));
+    asm_emit(out, ASM_MOV, asm_reg(X86_RBP), asm_reg(X86_RSP));
 
     // ローカル変数のためのスタック領域の確保
-    if (node->as.function.local_size > 0) {
-        fprintf(context->output_file, "    sub rsp, %zu\n", node->as.function.local_size);
-    }
-
-    // パラメータの処理
-    if (node->as.function.parameters) {
-        size_t param_count = vector_size(node->as.function.parameters);
-        for (size_t i = 0; i < param_count; i++) {
-            ASTNode** param = vector_get(node->as.function.parameters, i);
-            if (param == NULL || *param == NULL) continue;
-            
-            ASTNode* param_node = *param;
-            if (param_node->type != NODE_IDENTIFIER) continue;
-            
-            // パラメータをスタックから適切な位置に移動
-            // System V AMD64 ABIに従って、最初の6つのパラメータはレジスタで渡される
-            if (i < 6) {
-                const char* regs[] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
-                fprintf(context->output_file, "    mov [rbp - %zu], %s\n",
-                        param_node->as.identifier.offset, regs[i]);
-            } else {
-                // 7番目以降のパラメータはスタックに積まれている
-                fprintf(context->output_file, "    mov rax, [rbp + %zu]\n",
-                        16 + (i - 6) * 8);  // 16はrbpとreturn addressの分
-                fprintf(context->output_file, "    mov [rbp - %zu], rax\n",
-                        param_node->as.identifier.offset);
-            }
+    if (frame_size > 0) {
+        asm_emit(out, ASM_SUB, asm_reg(X86_RSP), asm_imm((int64_t)frame_size));
+    }
+
+    // パラメータをフレームに移す
+    // System V AMD64 ABIに従って、注釈がfloatの引数は最初の8つがxmm0〜7で、ほかの引数は最初の6つが
+    // 整数のレジスタで渡され、残りは引数の順にスタックで渡される
+    size_t ints = 0, floats = 0, stacked = 0;
+    for (size_t i = 0; i < function->parameter_count; i++) {
+        AsmOperand slot = asm_frame(-(int64_t)resolver_parameter_offset(i));
+        bool is_float = codegen_value_type(function->parameters[i]->type) == IR_FLOAT;
+        if (is_float && floats < CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS) {
+            asm_emit(out, ASM_MOVSD, slot, asm_xmm((uint8_t)floats++));
+        } else if (!is_float && ints < CODEGEN_MAX_REGISTER_ARGUMENTS) {
+            asm_emit(out, ASM_MOV, slot, asm_reg(argument_registers[ints++]));
+        } else {
+            // 16はrbpとreturn addressの分
+            asm_emit(out, ASM_MOV, RAX, asm_frame((int64_t)(16 + stacked++ * 8)));
+            asm_emit(out, ASM_MOV, slot, RAX);
         }
     }
 
     // 関数本体の生成
-    if (node->as.function.body) {
-        codegen_emit_statement(context, node->as.function.body);
-    }
+    context->float_return = codegen_value_type(function->return_type) == IR_FLOAT;
+    codegen_emit_statement(context, function->body);
 
     // スタックフレームのクリーンアップ
-    fprintf(context->output_file, "    mov rsp, rbp\n");
-    fprintf(context->output_file, "    pop rbp\n");
-    fprintf(context->output_file, "    ret\n");
+    codegen_emit_frame_exit(out);
+}
+
+// if/whileの枝（ブロックでなくても自分のスコープを持つ）
+static void codegen_emit_scoped(CodeGenContext* context, ASTNode* node) {
+    if (node == NULL) return;
+    if (!resolver_push_scope(&context->resolver)) {
+        context->writer.failed = true;
+        return;
+    }
+    codegen_emit_statement(context, node);
+    resolver_pop_scope(&context->resolver);
 }
 
 // 文の生成
 void codegen_emit_statement(CodeGenContext* context, ASTNode* node) {
     if (node == NULL) return;
+    AsmWriter* out = &context->writer;
 
     switch (node->type) {
-        case NODE_BLOCK:
-            if (node->as.block.statements) {
-                for (size_t i = 0; i < vector_size(node->as.block.statements); i++) {
-                    ASTNode** stmt = vector_get(node->as.block.statements, i);
-                    if (stmt == NULL || *stmt == NULL) continue;
-                    codegen_emit_statement(context, *stmt);
-                }
+        case NODE_BLOCK_STATEMENT: {
+            if (!resolver_push_scope(&context->resolver)) {
+                out->failed = true;
+                return;
+            }
+            const BlockStatement* block = &node->data.block_statement;
+            for (size_t i = 0; i < block->statement_count; i++) {
+                codegen_emit_statement(context, block->statements[i]);
             }
+            resolver_pop_scope(&context->resolver);
             break;
+        }
+
+        case NODE_IF_STATEMENT: {
+            const IfStatement* statement = &node->data.if_statement;
+            if (statement->condition == NULL) return;
 
-        case NODE_IF:
-            if (node->as.if_stmt.condition == NULL) return;
-            
             // 条件式の評価
-            codegen_emit_expression(context, node->as.if_stmt.condition);
-            
+            codegen_emit_expression(context, statement->condition);
+
             // 条件分岐
-            char* else_label = codegen_new_label(context);
-            char* end_label = codegen_new_label(context);
-            if (else_label == NULL || end_label == NULL) return;
-            
-            fprintf(context->output_file, "    cmp rax, 0\n");
-            fprintf(context->output_file, "    je %s\n", else_label);
-            
+            size_t else_label = codegen_new_label(context);
+            size_t end_label = codegen_new_label(context);
+
+            asm_emit(out, ASM_CMP, RAX, asm_imm(0));
+            asm_emit1(out, ASM_JE, asm_label_ref(NULL, else_label));
+
             // then節の生成
-            if (node->as.if_stmt.then_branch) {
-                codegen_emit_statement(context, node->as.if_stmt.then_branch);
-            }
-            fprintf(context->output_file, "    jmp %s\n", end_label);
-            
+            codegen_emit_scoped(context, statement->then_branch);
+            asm_emit1(out, ASM_JMP, asm_label_ref(NULL, end_label));
+
             // else節の生成
-            fprintf(context->output_file, "%s:\n", else_label);
-            if (node->as.if_stmt.else_branch) {
-                codegen_emit_statement(context, node->as.if_stmt.else_branch);
-            }
-            
-            fprintf(context->output_file, "%s:\n", end_label);
-            free(else_label);
-            free(end_label);
+            asm_label(out, NULL, else_label);
+            codegen_emit_scoped(context, statement->else_branch);
+
+            asm_label(out, NULL, end_label);
             break;
+        }
+
+        case NODE_WHILE_STATEMENT: {
+            const WhileStatement* statement = &node->data.while_statement;
+            if (statement->condition == NULL) return;
 
-        case NODE_WHILE:
-            if (node->as.while_stmt.condition == NULL) return;
-            
             // ラベルの生成
-            char* start_label = codegen_new_label(context);
-            char* exit_label = codegen_new_label(context);
-            if (start_label == NULL || exit_label == NULL) return;
-            
+            size_t start_label = codegen_new_label(context);
+            size_t exit_label = codegen_new_label(context);
+
             // ループ開始
-            fprintf(context->output_file, "%s:\n", start_label);
-            
+            asm_label(out, NULL, start_label);
+
             // 条件式の評価
-            codegen_emit_expression(context, node->as.while_stmt.condition);
-            fprintf(context->output_file, "    cmp rax, 0\n");
-            fprintf(context->output_file, "    je %s\n", exit_label);
-            
+            codegen_emit_expression(context, statement->condition);
+            asm_emit(out, ASM_CMP, RAX, asm_imm(0));
+            asm_emit1(out, ASM_JE, asm_label_ref(NULL, exit_label));
+
             // ループ本体の生成
-            if (node->as.while_stmt.body) {
-                codegen_emit_statement(context, node->as.while_stmt.body);
-            }
-            fprintf(context->output_file, "    jmp %s\n", start_label);
-            
+            codegen_emit_scoped(context, statement->body);
+            asm_emit1(out, ASM_JMP, asm_label_ref(NULL, start_label));
+
             // ループ終了
-            fprintf(context->output_file, "%s:\n", exit_label);
-            free(start_label);
-            free(exit_label);
+            asm_label(out, NULL, exit_label);
             break;
+        }
 
-        case NODE_RETURN:
-            if (node->as.return_stmt.value) {
-                codegen_emit_expression(context, node->as.return_stmt.value);
+        case NODE_LET_STATEMENT: {
+            const LetStatement* let = &node->data.let_statement;
+            if (codegen_is_math(let->type)) {
+                codegen_fail(context, node, CODEGEN_MATH_UNSUPPORTED);
+                return;
             }
-            fprintf(context->output_file, "    mov rsp, rbp\n");
-            fprintf(context->output_file, "    pop rbp\n");
-            fprintf(context->output_file, "    ret\n");
+            if (let->initializer) {
+                codegen_emit_expression(context, let->initializer);
+                codegen_emit_coerce(out, let->initializer, codegen_value_type(let->type) == IR_FLOAT);
+            } else {
+                asm_emit(out, ASM_XOR, RAX, RAX);
+            }
+            // 初期化式の中の同名の参照は外側の変数を指すので、宣言は初期化式の後
+            size_t offset = resolver_declare(&context->resolver, let->name);
+            if (offset == 0) {
+                out->failed = true;
+                return;
+            }
+            asm_emit(out, ASM_MOV, asm_frame(-(int64_t)offset), RAX);
+            break;
+        }
+
+        case NODE_RETURN_STATEMENT:
+            if (node->data.return_statement.value) {
+                codegen_emit_expression(context, node->data.return_statement.value);
+                codegen_emit_coerce(out, node->data.return_statement.value, context->float_return);
+            }
+            // floatの戻り値はxmm0で返す
+            if (context->float_return) asm_emit(out, ASM_MOVQ, asm_xmm(0), RAX);
+            codegen_emit_frame_exit(out);
+            break;
+
+        case NODE_EXPRESSION_STATEMENT:
+            codegen_emit_expression(context, node->data.expression_statement.expression);
             break;
 
         default:
-            // 式文として処理
-            codegen_emit_expression(context, node);
             break;
     }
 }
@@ -238,28 +1583,49 @@ void codegen_emit_statement(CodeGenContext* context, ASTNode* node) {
 // 式の生成
 void codegen_emit_expression(CodeGenContext* context, ASTNode* node) {
     if (node == NULL) return;
+    if (codegen_is_math(node->resolved_type)) {
+        codegen_fail(context, node, CODEGEN_MATH_UNSUPPORTED);
+        return;
+    }
 
     switch (node->type) {
-        case NODE_LITERAL:
+        case NODE_INTEGER_LITERAL:
+        case NODE_FLOAT_LITERAL:
+        case NODE_STRING_LITERAL:
+        case NODE_BOOLEAN_LITERAL:
             codegen_emit_literal(context, node);
             break;
 
-        case NODE_BINARY:
+        case NODE_BINARY_EXPRESSION:
             codegen_emit_binary(context, node);
             break;
 
-        case NODE_UNARY:
+        case NODE_UNARY_EXPRESSION:
             codegen_emit_unary(context, node);
             break;
 
-        case NODE_CALL:
+        case NODE_FUNCTION_CALL:
+        case NODE_CALL_EXPRESSION:
             codegen_emit_call(context, node);
             break;
 
-        case NODE_IDENTIFIER:
+        case NODE_VARIABLE_REFERENCE:
             codegen_emit_variable(context, node);
             break;
 
+        case NODE_ASSIGNMENT: {
+            const Assignment* assignment = &node->data.assignment;
+            codegen_emit_expression(context, assignment->value);
+            codegen_emit_coerce(&context->writer, assignment->value, codegen_is_float(node));
+            size_t offset = resolver_lookup(&context->resolver, assignment->name);
+            if (offset != 0) {
+                asm_emit(&context->writer, ASM_MOV, asm_frame(-(int64_t)offset), RAX);
+            } else {
+                asm_emit(&context->writer, ASM_MOV, asm_global(assignment->name), RAX);
+            }
+            break;
+        }
+
         default:
             break;
     }
@@ -267,269 +1633,407 @@ void codegen_emit_expression(CodeGenContext* context, ASTNode* node) {
 
 // リテラルの生成
 void codegen_emit_literal(CodeGenContext* context, ASTNode* node) {
-    switch (node->as.literal.type) {
-        case LITERAL_INTEGER:
-            fprintf(context->output_file, "    mov rax, %ld\n", node->as.literal.value.integer);
+    AsmWriter* out = &context->writer;
+
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL:
+            asm_emit(out, ASM_MOV, RAX, asm_imm(node->data.integer_literal.value));
             break;
 
-        case LITERAL_FLOAT:
-            // 浮動小数点数をメモリに配置
-            fprintf(context->output_file, "    mov rax, %ld\n", 
-                    *(int64_t*)&node->as.literal.value.float_val);
-            fprintf(context->output_file, "    movq xmm0, rax\n");
+        case NODE_FLOAT_LITERAL: {
+            // 浮動小数点数はビット列のまま即値で読み込む
+            int64_t bits;
+            memcpy(&bits, &node->data.float_literal.value, sizeof(bits));
+            asm_emit(out, ASM_MOV, RAX, asm_imm(bits));
+            asm_emit(out, ASM_MOVQ, asm_xmm(0), RAX);
             break;
+        }
 
-        case LITERAL_STRING:
+        case NODE_STRING_LITERAL:
             // 文字列リテラルをデータセクションに追加
-            vector_push(context->string_literals, &node->as.literal.value.string);
-            fprintf(context->output_file, "    lea rax, [rel str_%zu]\n", 
-                    vector_size(context->string_literals) - 1);
+            if (!codegen_add_string(context, node->data.string_literal.value)) {
+                out->failed = true;
+                return;
+            }
+            asm_emit(out, ASM_LEA, RAX, asm_string(vector_size(context->string_literals) - 1));
             break;
 
-        case LITERAL_BOOLEAN:
-            fprintf(context->output_file, "    mov rax, %d\n", 
-                    node->as.literal.value.boolean ? 1 : 0);
+        case NODE_BOOLEAN_LITERAL:
+            asm_emit(out, ASM_MOV, RAX, asm_imm(node->data.boolean_literal.value ? 1 : 0));
             break;
 
-        case LITERAL_NULL:
-            fprintf(context->output_file, "    xor rax, rax\n");
+        default:
             break;
     }
 }
 
+// 値を0か1にする
+static void codegen_emit_truth(AsmWriter* out) {
+    asm_emit(out, ASM_TEST, RAX, RAX);
+    asm_emit1(out, ASM_SETNE, asm_reg8(X86_RAX));
+    asm_emit(out, ASM_MOVZX, asm_reg32(X86_RAX), asm_reg8(X86_RAX));
+}
+
+// 短絡評価（左辺で結果が決まれば右辺を評価しない）
+static void codegen_emit_logical(CodeGenContext* context, const BinaryExpression* binary) {
+    AsmWriter* out = &context->writer;
+    size_t end_label = codegen_new_label(context);
+
+    codegen_emit_expression(context, binary->left);
+    codegen_emit_truth(out);
+    asm_emit(out, ASM_CMP, RAX, asm_imm(0));
+    asm_emit1(out, binary->operator[0] == '&' ? ASM_JE : ASM_JNE, asm_label_ref(NULL, end_label));
+    codegen_emit_expression(context, binary->right);
+    codegen_emit_truth(out);
+    asm_label(out, NULL, end_label);
+}
+
 // 二項演算の生成
 void codegen_emit_binary(CodeGenContext* context, ASTNode* node) {
+    AsmWriter* out = &context->writer;
+    const BinaryExpression* binary = &node->data.binary_expression;
+    if (is_logical_operator(binary->operator)) {
+        codegen_emit_logical(context, binary);
+        return;
+    }
+    const BinaryOperator* op = find_binary_operator(binary->operator);
+    if (op == NULL) return;
+
     // 右辺の評価
-    codegen_emit_expression(context, node->as.binary.right);
-    fprintf(context->output_file, "    push rax\n");
-    
+    codegen_emit_expression(context, binary->right);
+    asm_emit1(out, ASM_PUSH, RAX);
+
     // 左辺の評価
-    codegen_emit_expression(context, node->as.binary.left);
-    fprintf(context->output_file, "    pop rbx\n");
-    
-    // 演算子に応じた処理
-    switch (node->as.binary.operator) {
-        case TOKEN_PLUS:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    addsd xmm0, xmm1\n");
-                fprintf(context->output_file, "    movq rax, xmm0\n");
-            } else {
-                fprintf(context->output_file, "    add rax, rbx\n");
-            }
-            break;
-            
-        case TOKEN_MINUS:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    subsd xmm0, xmm1\n");
-                fprintf(context->output_file, "    movq rax, xmm0\n");
-            } else {
-                fprintf(context->output_file, "    sub rax, rbx\n");
-            }
-            break;
-            
-        case TOKEN_STAR:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    mulsd xmm0, xmm1\n");
-                fprintf(context->output_file, "    movq rax, xmm0\n");
-            } else {
-                fprintf(context->output_file, "    imul rax, rbx\n");
-            }
-            break;
-            
-        case TOKEN_SLASH:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    divsd xmm0, xmm1\n");
-                fprintf(context->output_file, "    movq rax, xmm0\n");
-            } else {
-                fprintf(context->output_file, "    cqo\n");
-                fprintf(context->output_file, "    idiv rbx\n");
-            }
-            break;
-            
-        case TOKEN_EQ:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    comisd xmm0, xmm1\n");
-                fprintf(context->output_file, "    sete al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            } else {
-                fprintf(context->output_file, "    cmp rax, rbx\n");
-                fprintf(context->output_file, "    sete al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            }
-            break;
-            
-        case TOKEN_NEQ:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    comisd xmm0, xmm1\n");
-                fprintf(context->output_file, "    setne al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            } else {
-                fprintf(context->output_file, "    cmp rax, rbx\n");
-                fprintf(context->output_file, "    setne al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            }
-            break;
-            
-        case TOKEN_LT:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    comisd xmm0, xmm1\n");
-                fprintf(context->output_file, "    setb al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            } else {
-                fprintf(context->output_file, "    cmp rax, rbx\n");
-                fprintf(context->output_file, "    setl al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            }
-            break;
-            
-        case TOKEN_GT:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    comisd xmm0, xmm1\n");
-                fprintf(context->output_file, "    seta al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            } else {
-                fprintf(context->output_file, "    cmp rax, rbx\n");
-                fprintf(context->output_file, "    setg al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            }
-            break;
-            
-        case TOKEN_LE:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    comisd xmm0, xmm1\n");
-                fprintf(context->output_file, "    setbe al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            } else {
-                fprintf(context->output_file, "    cmp rax, rbx\n");
-                fprintf(context->output_file, "    setle al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            }
-            break;
-            
-        case TOKEN_GE:
-            if (node->as.binary.type == TYPE_FLOAT) {
-                fprintf(context->output_file, "    movq xmm0, rax\n");
-                fprintf(context->output_file, "    movq xmm1, rbx\n");
-                fprintf(context->output_file, "    comisd xmm0, xmm1\n");
-                fprintf(context->output_file, "    setae al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            } else {
-                fprintf(context->output_file, "    cmp rax, rbx\n");
-                fprintf(context->output_file, "    setge al\n");
-                fprintf(context->output_file, "    movzx rax, al\n");
-            }
-            break;
-            
-        default:
-            break;
+    codegen_emit_expression(context, binary->left);
+    asm_emit1(out, ASM_POP, R11);
+
+    // 剰余は整数だけ
+    bool is_float = op->ir_op != IR_MOD && (codegen_is_float(binary->left) || codegen_is_float(binary->right));
+    if (is_float) {
+        // 整数の側はcvtsi2sdで変換する
+        asm_emit(out, codegen_is_integer(binary->left) ? ASM_CVTSI2SD : ASM_MOVQ, asm_xmm(0), RAX);
+        asm_emit(out, codegen_is_integer(binary->right) ? ASM_CVTSI2SD : ASM_MOVQ, asm_xmm(1), R11);
+        asm_emit(out, op->float_op, asm_xmm(0), asm_xmm(1));
+        if (op->compare) {
+            asm_emit1(out, asm_set(op->float_condition), asm_reg8(X86_RAX));
+            asm_emit(out, ASM_MOVZX, asm_reg32(X86_RAX), asm_reg8(X86_RAX));
+        } else {
+            asm_emit(out, ASM_MOVQ, RAX, asm_xmm(0));
+        }
+    } else if (op->compare) {
+        asm_emit(out, ASM_CMP, RAX, R11);
+        asm_emit1(out, asm_set(op->int_condition), asm_reg8(X86_RAX));
+        asm_emit(out, ASM_MOVZX, asm_reg32(X86_RAX), asm_reg8(X86_RAX));
+    } else if (op->int_op == ASM_IDIV) {
+        asm_emit0(out, ASM_CQO);
+        asm_emit1(out, ASM_IDIV, R11);
+        if (op->ir_op == IR_MOD) asm_emit(out, ASM_MOV, RAX, asm_reg(X86_RDX));
+    } else {
+        asm_emit(out, op->int_op, RAX, R11);
     }
 }
 
 // 単項演算の生成
 void codegen_emit_unary(CodeGenContext* context, ASTNode* node) {
+    AsmWriter* out = &context->writer;
+    const UnaryExpression* unary = &node->data.unary_expression;
+
     // オペランドの評価
-    codegen_emit_expression(context, node->as.unary.operand);
-    
+    codegen_emit_expression(context, unary->right);
+
     // 演算子に応じた処理
-    switch (node->as.unary.operator) {
-        case TOKEN_MINUS:
-            fprintf(context->output_file, "    neg rax\n");
-            break;
-            
-        case TOKEN_BANG:
-            fprintf(context->output_file, "    test rax, rax\n");
-            fprintf(context->output_file, "    setz al\n");
-            fprintf(context->output_file, "    movzx rax, al\n");
-            break;
-            
-        default:
-            break;
+    if (strcmp(unary->operator, "-") == 0) {
+        if (codegen_is_float(unary->right)) {
+            // 浮動小数点数は符号ビットを反転する
+            asm_emit(out, ASM_MOV, R11, asm_imm(INT64_MIN));
+            asm_emit(out, ASM_XOR, RAX, R11);
+        } else {
+            asm_emit1(out, ASM_NEG, RAX);
+        }
+    } else if (strcmp(unary->operator, "!") == 0) {
+        asm_emit(out, ASM_TEST, RAX, RAX);
+        asm_emit1(out, ASM_SETE, asm_reg8(X86_RAX));
+        asm_emit(out, ASM_MOVZX, asm_reg32(X86_RAX), asm_reg8(X86_RAX));
     }
 }
 
+// 名前の値（ローカル変数 → この単位の関数のアドレス → グローバル変数の順）
+static void codegen_emit_name(CodeGenContext* context, const char* name) {
+    size_t offset = resolver_lookup(&context->resolver, name);
+    if (offset != 0) {
+        asm_emit(&context->writer, ASM_MOV, RAX, asm_frame(-(int64_t)offset));
+    } else if (symbol_table_lookup(&context->functions, name) != NULL) {
+        asm_emit(&context->writer, ASM_LEA, RAX, asm_address(name));
+    } else {
+        asm_emit(&context->writer, ASM_MOV, RAX, asm_global(name));
+    }
+}
+
+// 呼び出し先のindex番目の引数がfloatか
+static bool codegen_argument_is_float(const Type* callee, size_t index) {
+    return codegen_value_type(codegen_parameter_type(callee, index)) == IR_FLOAT;
+}
+
+// 呼び出し先のindex番目の引数がレジスタで渡されるか（前にある同じ種類の引数の数で決まる）
+static bool codegen_argument_in_register(const Type* callee, size_t index) {
+    size_t floats = 0;
+    for (size_t i = 0; i < index; i++) {
+        if (codegen_argument_is_float(callee, i)) floats++;
+    }
+    if (codegen_argument_is_float(callee, index)) return floats < CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS;
+    return index - floats < CODEGEN_MAX_REGISTER_ARGUMENTS;
+}
+
+// 文字列リテラルのアドレスをraxに置く
+static void codegen_emit_string_address(CodeGenContext* context, const char* text) {
+    if (!codegen_add_string(context, text)) {
+        context->writer.failed = true;
+        return;
+    }
+    asm_emit(&context->writer, ASM_LEA, RAX, asm_string(vector_size(context->string_literals) - 1));
+}
+
+// ログのマクロはprintfを呼ぶ（書式の組み方はlog_formatを参照）
+static void codegen_emit_log(CodeGenContext* context, ASTNode* node) {
+    AsmWriter* out = &context->writer;
+    const FunctionCall* call = &node->data.function_call;
+    size_t first;
+    const char* reason;
+    char* format = log_format(call, &first, &reason);
+    if (format == NULL) {
+        codegen_fail(context, node, reason);
+        return;
+    }
+    size_t count = 1 + call->argument_count - first;
+    size_t floats = 0;
+    for (size_t i = first; i < call->argument_count; i++) {
+        if (codegen_is_float(call->arguments[i])) floats++;
+    }
+    if (count - floats > CODEGEN_MAX_REGISTER_ARGUMENTS || floats > CODEGEN_MAX_FLOAT_REGISTER_ARGUMENTS) {
+        free(format);
+        codegen_fail(context, node, "too many log arguments");
+        return;
+    }
+
+    // 値は右から左へ積み、書式を最後に積む（k番目の引数は[rsp + 8k]に置かれる）
+    for (size_t i = call->argument_count; i > first; i--) {
+        codegen_emit_expression(context, call->arguments[i - 1]);
+        if (log_is_bool(call->arguments[i - 1])) {
+            size_t end_label = codegen_new_label(context);
+            asm_emit(out, ASM_TEST, RAX, RAX);
+            codegen_emit_string_address(context, "true");
+            asm_emit1(out, ASM_JNE, asm_label_ref(NULL, end_label));
+            codegen_emit_string_address(context, "false");
+            asm_label(out, NULL, end_label);
+        }
+        asm_emit1(out, ASM_PUSH, RAX);
+    }
+    codegen_emit_string_address(context, format);
+    free(format);
+    asm_emit1(out, ASM_PUSH, RAX);
+
+    size_t ints = 0;
+    floats = 0;
+    for (size_t k = 0; k < count; k++) {
+        AsmOperand argument = asm_stack((int64_t)k * 8);
+        if (k > 0 && codegen_is_float(call->arguments[first + k - 1])) {
+            asm_emit(out, ASM_MOVSD, asm_xmm((uint8_t)floats++), argument);
+        } else {
+            asm_emit(out, ASM_MOV, asm_reg(argument_registers[ints++]), argument);
+        }
+    }
+    asm_emit(out, ASM_ADD, asm_reg(X86_RSP), asm_imm((int64_t)count * 8));
+
+    // printfはrspが16バイト境界にあることを前提にするが、スタックマシン方式は途中の値を積むので
+    // 揃っているとは限らない。元のrspを揃えた位置に積んで呼び、戻ったら取り出す
+    asm_emit(out, ASM_MOV, R11, asm_reg(X86_RSP));
+    asm_emit(out, ASM_AND, asm_reg(X86_RSP), asm_imm(-16));
+    asm_emit(out, ASM_SUB, asm_reg(X86_RSP), asm_imm(8));
+    asm_emit1(out, ASM_PUSH, R11);
+    asm_emit(out, ASM_MOV, RAX, asm_imm((int64_t)floats));
+    asm_emit1(out, ASM_CALL, asm_symbol_ref(intern_cstr("printf")));
+    asm_emit1(out, ASM_POP, asm_reg(X86_RSP));
+}
+
 // 関数呼び出しの生成
+// 名前で呼べる関数はcall 名前で、関数の値（変数や式）は値を引数の下に積んでからcall r11で呼ぶ
 void codegen_emit_call(CodeGenContext* context, ASTNode* node) {
-    // 引数の評価（右から左へ）
-    if (node->as.call.arguments) {
-        for (size_t i = vector_size(node->as.call.arguments); i > 0; i--) {
-            ASTNode** arg = vector_get(node->as.call.arguments, i - 1);
-            codegen_emit_expression(context, *arg);
-            fprintf(context->output_file, "    push rax\n");
-        }
-    }
-    
-    // 関数の呼び出し
-    codegen_emit_expression(context, node->as.call.callee);
-    fprintf(context->output_file, "    call rax\n");
-    
+    AsmWriter* out = &context->writer;
+    const char* symbol = NULL;
+    ASTNode* const* arguments;
+    size_t count;
+    if (node->type == NODE_FUNCTION_CALL && node->data.function_call.log_level >= 0) {
+        codegen_emit_log(context, node);
+        return;
+    }
+    if (node->type == NODE_FUNCTION_CALL && node->data.function_call.math_builtin >= 0) {
+        codegen_fail(context, node, CODEGEN_MATH_UNSUPPORTED);
+        return;
+    }
+    if (node->type == NODE_FUNCTION_CALL) {
+        const FunctionCall* call = &node->data.function_call;
+        arguments = call->arguments;
+        count = call->argument_count;
+        if (codegen_is_direct_callee(context, &context->resolver, call->name)) {
+            symbol = call->specialization ? call->specialization : call->name;
+        } else {
+            codegen_emit_name(context, call->name);
+            asm_emit1(out, ASM_PUSH, RAX);
+        }
+    } else {
+        const CallExpression* call = &node->data.call_expression;
+        arguments = call->arguments;
+        count = call->argument_count;
+        const ASTNode* callee = call->callee;
+        if (callee->type == NODE_VARIABLE_REFERENCE &&
+            codegen_is_direct_callee(context, &context->resolver, callee->data.variable_reference.name)) {
+            symbol = callee->data.variable_reference.name;
+        } else {
+            codegen_emit_expression(context, call->callee);
+            asm_emit1(out, ASM_PUSH, RAX);
+        }
+    }
+
+    // 引数は右から左へ積む（i番目の引数は[rsp + 8i]に置かれる）
+    // 引数の型は呼び出し先の関数型から決め、floatの引数に渡す整数は変換する
+    const Type* callee = codegen_callee_type(node);
+    for (size_t i = count; i > 0; i--) {
+        codegen_emit_expression(context, arguments[i - 1]);
+        codegen_emit_coerce(out, arguments[i - 1], codegen_argument_is_float(callee, i - 1));
+        asm_emit1(out, ASM_PUSH, RAX);
+    }
+
+    // レジスタに載る引数を型ごとのレジスタに移す
+    size_t ints = 0, floats = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!codegen_argument_in_register(callee, i)) continue;
+        AsmOperand argument = asm_stack((int64_t)i * 8);
+        if (codegen_argument_is_float(callee, i)) {
+            asm_emit(out, ASM_MOVSD, asm_xmm((uint8_t)floats++), argument);
+        } else {
+            asm_emit(out, ASM_MOV, asm_reg(argument_registers[ints++]), argument);
+        }
+    }
+
+    // 残りの引数を引数の順にレジスタの引数の跡へ詰める（移す先は元の位置より上なので、後ろの引数から
+    // 移せばまだ移していない引数を壊さない）
+    size_t in_registers = ints + floats;
+    size_t on_stack = count - in_registers;
+    for (size_t i = count, k = on_stack; i > 0 && in_registers > 0; i--) {
+        if (codegen_argument_in_register(callee, i - 1)) continue;
+        k--;
+        asm_emit(out, ASM_MOV, RAX, asm_stack((int64_t)(i - 1) * 8));
+        asm_emit(out, ASM_MOV, asm_stack((int64_t)(in_registers + k) * 8), RAX);
+    }
+    if (in_registers > 0) {
+        asm_emit(out, ASM_ADD, asm_reg(X86_RSP), asm_imm((int64_t)in_registers * 8));
+    }
+
+    // 関数の呼び出し（可変長引数の関数のために、alにXMMで渡した引数の数を入れる）
+    if (floats > 0) asm_emit(out, ASM_MOV, RAX, asm_imm((int64_t)floats));
+    if (symbol != NULL) {
+        asm_emit1(out, ASM_CALL, asm_symbol_ref(symbol));
+    } else {
+        asm_emit(out, ASM_MOV, R11, asm_stack((int64_t)on_stack * 8));
+        asm_emit1(out, ASM_CALL, R11);
+        on_stack++;
+    }
+
     // スタックの調整
-    if (node->as.call.arguments) {
-        fprintf(context->output_file, "    add rsp, %zu\n", 
-                vector_size(node->as.call.arguments) * 8);
+    if (on_stack > 0) {
+        asm_emit(out, ASM_ADD, asm_reg(X86_RSP), asm_imm((int64_t)on_stack * 8));
     }
+
+    // floatの戻り値はxmm0で返る
+    if (codegen_value_type(node->resolved_type) == IR_FLOAT) asm_emit(out, ASM_MOVQ, RAX, asm_xmm(0));
 }
 
 // 変数の生成
 void codegen_emit_variable(CodeGenContext* context, ASTNode* node) {
-    if (node->type != NODE_IDENTIFIER) return;
+    if (node->type != NODE_VARIABLE_REFERENCE) return;
+    codegen_emit_name(context, node->data.variable_reference.name);
+}
 
-    // ローカル変数の場合
-    if (node->as.identifier.is_local) {
-        fprintf(context->output_file, "    mov rax, [rbp - %zu]\n", 
-                node->as.identifier.offset);
-    }
-    // グローバル変数の場合
-    else {
-        fprintf(context->output_file, "    mov rax, [rel %s]\n", 
-                node->as.identifier.name);
+// グローバル変数の初期値を求める（同名のletが複数あれば、記号表に登録した最初のもの）
+// 注釈か初期化式の型がfloatならdoubleのビット列、それ以外は整数の値にする
+static SlangError codegen_evaluate_globals(CodeGenContext* context, const BlockStatement* program) {
+    size_t count = context->global_variables.count;
+    context->global_values = calloc(count ? count : 1, sizeof(int64_t));
+    if (context->global_values == NULL) return SLANG_ERROR_INTERNAL;
+
+    bool* evaluated = calloc(count ? count : 1, sizeof(bool));
+    if (evaluated == NULL) return SLANG_ERROR_INTERNAL;
+    SlangError error = SLANG_SUCCESS;
+    for (size_t i = 0; i < program->statement_count && error == SLANG_SUCCESS; i++) {
+        const ASTNode* statement = program->statements[i];
+        if (statement == NULL || statement->type != NODE_LET_STATEMENT) continue;
+        const LetStatement* let = &statement->data.let_statement;
+        const Symbol* symbol = symbol_table_lookup(&context->global_variables, let->name);
+        if (symbol == NULL || evaluated[symbol->slot]) continue;
+        evaluated[symbol->slot] = true;
+
+        if (codegen_is_math(let->type) || (let->initializer != NULL && codegen_is_math(let->initializer->resolved_type))) {
+            context->error = "vector globals are not supported";
+            context->error_node = statement;
+            error = SLANG_ERROR_TYPE;
+            break;
+        }
+        Constant value = { false, 0, 0.0 };
+        if (let->initializer != NULL && !evaluate_constant(let->initializer, &value)) {
+            context->error = "global initializer is not a constant";
+            context->error_node = statement;
+            error = SLANG_ERROR_TYPE;
+            break;
+        }
+        if (value.is_float || codegen_value_type(let->type) == IR_FLOAT) {
+            double number = constant_number(&value);
+            memcpy(&context->global_values[symbol->slot], &number, sizeof(number));
+        } else {
+            context->global_values[symbol->slot] = value.integer;
+        }
     }
+    free(evaluated);
+    return error;
 }
 
 // コード生成のメイン関数
 SlangError codegen_generate(CodeGenContext* context, ASTNode* ast) {
     if (context == NULL || ast == NULL) return SLANG_ERROR_INTERNAL;
-    if (context->output_file == NULL) return SLANG_ERROR_INTERNAL;
+    if (context->writer.failed) return SLANG_ERROR_IO;
+
+    // 最上位の名前の登録（本体の中の名前は生成しながらResolverで引く）
+    SlangError error = resolve_program(ast, &context->global_variables, &context->functions);
+    if (error != SLANG_SUCCESS) return error;
+    const BlockStatement* program = &ast->data.block_statement;
+
+    // グローバル変数の初期値
+    error = codegen_evaluate_globals(context, program);
+    if (error != SLANG_SUCCESS) return error;
+
+    // IRへの変換と最適化
+    error = codegen_optimize_module(context, program);
+    if (error != SLANG_SUCCESS) return error;
+    if (context->optimizer.options.time_passes) optimizer_report(&context->optimizer, stderr);
 
     // プロローグの生成
     codegen_emit_prologue(context);
 
     // プログラムの生成
-    if (ast->type == NODE_PROGRAM && ast->as.program.declarations) {
-        for (size_t i = 0; i < vector_size(ast->as.program.declarations); i++) {
-            ASTNode** decl = vector_get(ast->as.program.declarations, i);
-            if ((*decl)->type == NODE_FUNCTION_DECL) {
-                codegen_emit_function(context, *decl);
-            }
+    for (size_t i = 0; i < program->statement_count; i++) {
+        if (codegen_owns_function(context, program->statements[i], i)) {
+            codegen_emit_function(context, program->statements[i]);
         }
-    } else {
-        return SLANG_ERROR_INVALID_AST;
     }
 
+    if (context->error != NULL) return SLANG_ERROR_TYPE;
+
     // エピローグの生成
     codegen_emit_epilogue(context);
 
-    // 出力ファイルのフラッシュ
-    if (fflush(context->output_file) != 0) {
+    // 出力バッファの書き出し
+    if (!asm_writer_flush(&context->writer)) {
         return SLANG_ERROR_IO;
     }
 
     return SLANG_SUCCESS;
-} 
\ No newline at end of file
+}
@@ -0,0 +1,524 @@
+#include "../include/driver.h"
+#include "../include/intern.h"
+#include "../include/codegen.h"
+#include "../include/error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// この大きさ以上のソースはトークン列を全て保持せずストリーミングで字句解析する
+#define COMPILE_STREAMING_THRESHOLD (64 * 1024 * 1024)
+#define DRIVER_PATH_MAX 4096
+
+static bool grow_array(void** data, size_t* capacity, size_t needed, size_t element_size) {
+    if (needed <= *capacity) return true;
+    size_t new_capacity = *capacity ? *capacity * 2 : 8;
+    while (new_capacity < needed) new_capacity *= 2;
+    void* grown = realloc(*data, new_capacity * element_size);
+    if (grown == NULL) return false;
+    *data = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+Driver* driver_create(const DriverOptions* options) {
+    Driver* driver = calloc(1, sizeof(Driver));
+    if (driver == NULL) return NULL;
+    driver->options = *options;
+    driver->pool = thread_pool_create(options->threads);
+    if (driver->pool == NULL) {
+        free(driver);
+        return NULL;
+    }
+    driver->specializations = mono_cache_create(NULL);
+    if (driver->specializations == NULL) {
+        thread_pool_destroy(driver->pool);
+        free(driver);
+        return NULL;
+    }
+    thread_pool_group_init(&driver->group);
+    return driver;
+}
+
+static void unit_release(DriverUnit* unit) {
+    parser_destroy(unit->parser);
+    if (unit->lexer != NULL) lexer_destroy(unit->lexer);
+    if (unit->arena != NULL) arena_destroy(unit->arena);
+    if (unit->source != NULL) source_close(unit->source);
+    free(unit->output_path);
+}
+
+void driver_destroy(Driver* driver) {
+    if (driver == NULL) return;
+    for (size_t i = 0; i < driver->unit_count; i++) unit_release(&driver->units[i]);
+    for (size_t i = 0; i < driver->component_count; i++) {
+        DriverComponent* component = &driver->components[i];
+        for (size_t e = 0; e < component->export_count; e++) free(component->exports[e].parameters);
+        free(component->exports);
+        free(component->globals);
+        free(component->members);
+        free(component->dependencies);
+        free(component->dependents);
+    }
+    free(driver->components);
+    free(driver->units);
+    free(driver->requested);
+    thread_pool_destroy(driver->pool);
+    free(driver);
+}
+
+SlangError driver_add_file(Driver* driver, const char* path) {
+    const char* handle = intern_cstr(path);
+    if (handle == NULL) return SLANG_ERROR_INTERNAL;
+    for (size_t i = 0; i < driver->requested_count; i++) {
+        if (driver->requested[i] == handle) return SLANG_SUCCESS;
+    }
+    if (!grow_array((void**)&driver->requested, &driver->requested_capacity, driver->requested_count + 1,
+                    sizeof(const char*))) {
+        return SLANG_ERROR_INTERNAL;
+    }
+    driver->requested[driver->requested_count++] = handle;
+    return SLANG_SUCCESS;
+}
+
+SlangError driver_add_manifest(Driver* driver, const char* path) {
+    SourceFile* manifest = source_open(path);
+    if (manifest == NULL) {
+        fprintf(stderr, "Error: Could not read file '%s'\n", path);
+        return SLANG_ERROR_IO;
+    }
+
+    // ソースのパスはマニフェストのあるディレクトリからの相対パス
+    const char* slash = strrchr(path, '/');
+    size_t directory_length = slash ? (size_t)(slash - path) + 1 : 0;
+
+    SlangError error = SLANG_SUCCESS;
+    const char* p = manifest->data;
+    const char* end = manifest->data + manifest->length;
+    while (p < end && error == SLANG_SUCCESS) {
+        const char* line_end = memchr(p, '\n', (size_t)(end - p));
+        if (line_end == NULL) line_end = end;
+        const char* first = p;
+        const char* last = line_end;
+        while (first < last && (*first == ' ' || *first == '\t')) first++;
+        while (last > first && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r')) last--;
+        p = line_end + 1;
+        if (first == last || *first == '#') continue;
+
+        char source_path[DRIVER_PATH_MAX];
+        size_t prefix = *first == '/' ? 0 : directory_length;
+        if (prefix + (size_t)(last - first) >= sizeof(source_path)) {
+            error = SLANG_ERROR_IO;
+            break;
+        }
+        memcpy(source_path, path, prefix);
+        memcpy(source_path + prefix, first, (size_t)(last - first));
+        source_path[prefix + (size_t)(last - first)] = '\0';
+        error = driver_add_file(driver, source_path);
+    }
+    source_close(manifest);
+    return error;
+}
+
+// ---------------------------------------------------------------------------
+// 仕事
+
+static void check_job(void* argument);
+static void codegen_job(void* argument);
+
+// 構文解析か依存先の検査が1つ終わった（最後の1つなら成分の検査を投入する）
+static void component_ready(DriverComponent* component) {
+    if (atomic_fetch_sub_explicit(&component->waiting, 1, memory_order_acq_rel) == 1) {
+        thread_pool_spawn(component->driver->pool, &component->driver->group, check_job, component);
+    }
+}
+
+// 字句解析と構文解析（単位ごと）
+static void parse_job(void* argument) {
+    DriverUnit* unit = argument;
+    Driver* driver = unit->driver;
+    Trace* trace = driver->options.trace;
+
+    uint64_t start = trace_begin(trace);
+    unit->source = source_open(unit->path);
+    if (unit->source == NULL) {
+        unit->error = SLANG_ERROR_IO;
+        component_ready(&driver->components[unit->component]);
+        return;
+    }
+    trace_end(trace, "phase", "read", unit->path, start, unit->source->length, 0);
+
+    // 単位のアリーナ（AST・識別子・子配列を一括で所有する）
+    // ストリーミングのときは字句解析が構文解析の中で進むので、字句解析の区間は準備だけになる
+    start = trace_begin(trace);
+    unit->arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    const SourceFile* source = unit->source;
+    unit->lexer = source->length >= COMPILE_STREAMING_THRESHOLD
+        ? lexer_create_streaming(source->data, source->length, LEXER_DEFAULT_RING_CAPACITY)
+        : lexer_create(source->data, source->length);
+    if (unit->arena == NULL || unit->lexer == NULL) {
+        unit->error = SLANG_ERROR_INTERNAL;
+    } else {
+        unit->error = lexer_scan(unit->lexer);
+        trace_end(trace, "phase", "lex", unit->path, start,
+                  (unit->lexer->tokens ? unit->lexer->token_capacity : unit->lexer->ring_capacity) * sizeof(Token),
+                  unit->lexer->token_count);
+    }
+    if (unit->error == SLANG_SUCCESS) {
+        start = trace_begin(trace);
+        unit->parser = parser_create(unit->lexer, unit->arena);
+        unit->error = unit->parser ? parser_parse(unit->parser, &unit->ast) : SLANG_ERROR_INTERNAL;
+        if (trace != NULL) {
+            // ノードを数える時間は区間に入れない
+            uint64_t end = trace_now();
+            trace_add(trace, "phase", "parse", unit->path, start, end, unit->arena->total_allocated,
+                      ast_count_nodes(unit->ast));
+        }
+    }
+    component_ready(&driver->components[unit->component]);
+}
+
+// 検査した成分の公開する関数とグローバル変数の型を写しておく（検査器は成分ごとに破棄する）
+static bool component_export(DriverComponent* component, const TypeChecker* checker) {
+    size_t signature_count = checker->signature_count - checker->host_signature_count;
+    size_t global_count = checker->global_count - checker->host_global_count;
+    component->exports = calloc(signature_count ? signature_count : 1, sizeof(TypeSignature));
+    component->globals = malloc((global_count ? global_count : 1) * sizeof(TypeBinding));
+    if (component->exports == NULL || component->globals == NULL) return false;
+
+    for (size_t i = 0; i < signature_count; i++) {
+        const TypeSignature* signature = &checker->signatures[checker->host_signature_count + i];
+        TypeSignature* copy = &component->exports[i];
+        *copy = *signature;
+        copy->parameters = malloc((signature->parameter_count ? signature->parameter_count : 1) * sizeof(Type*));
+        if (copy->parameters == NULL) return false;
+        memcpy(copy->parameters, signature->parameters, signature->parameter_count * sizeof(Type*));
+        component->export_count++;
+    }
+    memcpy(component->globals, &checker->global_bindings[checker->host_global_count], global_count * sizeof(TypeBinding));
+    component->global_count = global_count;
+    return true;
+}
+
+// 成分が使った特殊化（ほかのスレッドが検査中なら終わるのを待つ）を、出力する全ての単位の最後に加える。
+// 特殊化の記号はweakなので単位ごとに写しがあってよく、キャッシュから使った単位の.oも自分の使う特殊化を
+// 持つので、ほかの単位の出力に頼らない。本体のノードは単位の間で共有する（コード生成はASTに書かない）。
+static bool component_emit(DriverComponent* component, const TypeChecker* checker) {
+    Driver* driver = component->driver;
+    if (checker->instance_count == 0) return true;
+    ASTNode** instances = malloc(checker->instance_count * sizeof(ASTNode*));
+    if (instances == NULL) return false;
+    size_t instance_count = 0;
+    for (size_t i = 0; i < checker->instance_count; i++) {
+        if (mono_wait_check(driver->specializations, checker->instances[i])) {
+            instances[instance_count++] = checker->instances[i]->function;
+        }
+    }
+
+    bool ok = true;
+    for (size_t m = 0; m < component->member_count && ok && instance_count > 0; m++) {
+        DriverUnit* unit = &driver->units[component->members[m]];
+        if (!unit->needs_output) continue;
+        BlockStatement* program = &unit->ast->data.block_statement;
+        size_t count = program->statement_count;
+        ASTNode** statements = arena_alloc(unit->arena, (count + instance_count) * sizeof(ASTNode*));
+        ok = statements != NULL;
+        if (!ok) break;
+        if (count > 0) memcpy(statements, program->statements, count * sizeof(ASTNode*));
+        memcpy(statements + count, instances, instance_count * sizeof(ASTNode*));
+        program->statements = statements;
+        program->statement_count = count + instance_count;
+    }
+    free(instances);
+    return ok;
+}
+
+// 成分の全員の最上位の文をまとめて検査する（依存先の成分の型はホストの宣言として見せる）
+static SlangError check_component(DriverComponent* component) {
+    Driver* driver = component->driver;
+    size_t count = 0;
+    for (size_t m = 0; m < component->member_count; m++) {
+        count += driver->units[component->members[m]].ast->data.block_statement.statement_count;
+    }
+    ASTNode** nodes = malloc((count ? count : 1) * sizeof(ASTNode*));
+    TypeChecker* checker = type_checker_create();
+    if (nodes == NULL || checker == NULL) {
+        free(nodes);
+        type_checker_destroy(checker);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    count = 0;
+    for (size_t m = 0; m < component->member_count; m++) {
+        const BlockStatement* program = &driver->units[component->members[m]].ast->data.block_statement;
+        memcpy(nodes + count, program->statements, program->statement_count * sizeof(ASTNode*));
+        count += program->statement_count;
+    }
+
+    bool declared = true;
+    for (size_t d = 0; d < component->dependency_count && declared; d++) {
+        const DriverComponent* dependency = &driver->components[component->dependencies[d]];
+        for (size_t e = 0; e < dependency->export_count && declared; e++) {
+            declared = type_checker_declare_signature(checker, &dependency->exports[e]);
+        }
+        for (size_t g = 0; g < dependency->global_count && declared; g++) {
+            declared = type_checker_declare_global(checker, dependency->globals[g].name, dependency->globals[g].type);
+        }
+    }
+
+    checker->specializations = driver->specializations;
+    SlangError error = declared ? type_checker_check(checker, nodes, count) : SLANG_ERROR_INTERNAL;
+    if (error == SLANG_SUCCESS && !component_export(component, checker)) error = SLANG_ERROR_INTERNAL;
+    if (error == SLANG_SUCCESS && !component_emit(component, checker)) error = SLANG_ERROR_INTERNAL;
+    component->message = checker->error;
+    component->site = checker->error_site;
+    // エラーを含む文の単位で報告する（文が分からなければ最初の単位で、位置は書かない）
+    if (checker->error_statement == SIZE_MAX) component->site.line = 0;
+    for (size_t m = 0, first = 0; m < component->member_count && checker->error_statement != SIZE_MAX; m++) {
+        size_t statements = driver->units[component->members[m]].ast->data.block_statement.statement_count;
+        if (checker->error_statement < first + statements) {
+            component->error_unit = component->members[m];
+            break;
+        }
+        first += statements;
+    }
+    type_checker_destroy(checker);
+    free(nodes);
+    return error;
+}
+
+// 型検査（成分ごと）。終わったら依存する成分に知らせ、出力する単位のコード生成を投入する
+static void check_job(void* argument) {
+    DriverComponent* component = argument;
+    Driver* driver = component->driver;
+
+    component->error = SLANG_SUCCESS;
+    component->error_unit = component->members[0];
+    for (size_t m = 0; m < component->member_count && component->error == SLANG_SUCCESS; m++) {
+        component->error = driver->units[component->members[m]].error;
+    }
+    for (size_t d = 0; d < component->dependency_count && component->error == SLANG_SUCCESS; d++) {
+        component->error = driver->components[component->dependencies[d]].error;
+    }
+    component->blocked = component->error != SLANG_SUCCESS;
+    if (!component->blocked) {
+        uint64_t start = trace_begin(driver->options.trace);
+        component->error = check_component(component);
+        // 成分は最初の単位のパスで表す
+        trace_end(driver->options.trace, "phase", "typecheck", driver->units[component->members[0]].path, start, 0, 0);
+    }
+
+    for (size_t d = 0; d < component->dependent_count; d++) {
+        component_ready(&driver->components[component->dependents[d]]);
+    }
+    if (component->error != SLANG_SUCCESS) return;
+    for (size_t m = 0; m < component->member_count; m++) {
+        DriverUnit* unit = &driver->units[component->members[m]];
+        if (unit->needs_output) thread_pool_spawn(driver->pool, &driver->group, codegen_job, unit);
+    }
+}
+
+// コード生成（単位ごと。既定では.oを直接書き、-Sのときだけアセンブリを出力する）
+static void codegen_job(void* argument) {
+    DriverUnit* unit = argument;
+    Driver* driver = unit->driver;
+    uint64_t start = trace_begin(driver->options.trace);
+    CodeGenContext* codegen = codegen_create(unit->output_path, driver->options.format, &driver->options.options,
+                                             driver->pool);
+    if (codegen == NULL) {
+        unit->error = SLANG_ERROR_IO;
+        return;
+    }
+    unit->error = codegen_generate(codegen, unit->ast);
+    unit->message = codegen->error;
+    unit->error_node = codegen->error_node;
+    codegen_destroy(codegen);
+    trace_end(driver->options.trace, "phase", "codegen", unit->path, start, 0, 0);
+}
+
+// ---------------------------------------------------------------------------
+// 計画
+
+static size_t size_index_of(const size_t* values, size_t count, size_t value) {
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] == value) return i;
+    }
+    return SIZE_MAX;
+}
+
+static bool push_index(size_t** values, size_t* count, size_t value) {
+    if (size_index_of(*values, *count, value) != SIZE_MAX) return true;
+    size_t* grown = realloc(*values, (*count + 1) * sizeof(size_t));
+    if (grown == NULL) return false;
+    grown[(*count)++] = value;
+    *values = grown;
+    return true;
+}
+
+// useで辿れる単位を集め、成分とその依存関係を組む
+static SlangError driver_plan(Driver* driver, BuildCache* cache) {
+    for (size_t i = 0; i < driver->requested_count; i++) {
+        uint64_t key;
+        SlangError error = build_cache_key(cache, driver->requested[i], &key);
+        if (error != SLANG_SUCCESS) return error;
+    }
+
+    // キャッシュの記録には前回の索引だけにあった単位も残っているので、今回キーを求めたものだけを使う
+    size_t* unit_of = malloc((cache->unit_count ? cache->unit_count : 1) * sizeof(size_t));
+    driver->units = calloc(cache->unit_count ? cache->unit_count : 1, sizeof(DriverUnit));
+    driver->components = calloc(cache->component_count ? cache->component_count : 1, sizeof(DriverComponent));
+    if (unit_of == NULL || driver->units == NULL || driver->components == NULL) {
+        free(unit_of);
+        return SLANG_ERROR_INTERNAL;
+    }
+    driver->component_count = cache->component_count;
+    for (size_t c = 0; c < driver->component_count; c++) {
+        driver->components[c].driver = driver;
+        atomic_init(&driver->components[c].waiting, 0);
+    }
+
+    const char* extension = driver->options.format == ASM_OUTPUT_OBJECT ? ".o" : ".s";
+    bool ok = true;
+    for (size_t i = 0; i < cache->unit_count && ok; i++) {
+        const BuildUnit* record = &cache->units[i];
+        unit_of[i] = SIZE_MAX;
+        if (!record->has_key) continue;
+
+        DriverUnit* unit = &driver->units[driver->unit_count];
+        unit_of[i] = driver->unit_count++;
+        unit->driver = driver;
+        unit->path = record->path;
+        unit->key = record->key;
+        unit->component = record->component;
+        unit->output_path = malloc(strlen(record->path) + strlen(extension) + 1);
+        ok = unit->output_path != NULL;
+        if (!ok) break;
+        strcpy(unit->output_path, record->path);
+        strcat(unit->output_path, extension);
+
+        // 読めなかったファイルもここで数え、構文解析の仕事で報告する
+        unit->needs_output = record->missing || !build_cache_fetch(cache, record->key, extension, unit->output_path);
+        DriverComponent* component = &driver->components[unit->component];
+        ok = push_index(&component->members, &component->member_count, unit_of[i]);
+    }
+
+    for (size_t i = 0; i < cache->unit_count && ok; i++) {
+        const BuildUnit* record = &cache->units[i];
+        if (unit_of[i] == SIZE_MAX) continue;
+        DriverComponent* component = &driver->components[record->component];
+        for (size_t d = 0; d < record->dependency_count && ok; d++) {
+            const BuildUnit* dependency = build_cache_unit(cache, record->dependencies[d]);
+            if (dependency == NULL || dependency->component == record->component) continue;
+            ok = push_index(&component->dependencies, &component->dependency_count, dependency->component) &&
+                 push_index(&driver->components[dependency->component].dependents,
+                            &driver->components[dependency->component].dependent_count, record->component);
+        }
+    }
+    free(unit_of);
+    if (!ok) return SLANG_ERROR_INTERNAL;
+
+    // 出力する単位の成分と、その検査に型が要る依存先の成分を（依存される側へ向かって）検査する
+    for (size_t c = driver->component_count; c-- > 0;) {
+        DriverComponent* component = &driver->components[c];
+        for (size_t m = 0; m < component->member_count; m++) {
+            if (driver->units[component->members[m]].needs_output) component->needs_check = true;
+        }
+        if (!component->needs_check) continue;
+        for (size_t d = 0; d < component->dependency_count; d++) {
+            driver->components[component->dependencies[d]].needs_check = true;
+        }
+        for (size_t m = 0; m < component->member_count; m++) driver->units[component->members[m]].needs_parse = true;
+    }
+    return SLANG_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// 報告
+
+static void report_unit(const Driver* driver, const DriverUnit* unit) {
+    if (unit->error == SLANG_ERROR_IO && unit->source == NULL) {
+        fprintf(stderr, "Error: Could not read file '%s'\n", unit->path);
+        return;
+    }
+    if (unit->error == SLANG_ERROR_PARSER || unit->ast == NULL) {
+        for (size_t i = 0; unit->parser != NULL && i < unit->parser->error_count; i++) {
+            Error error = unit->parser->errors[i];
+            error.file = (char*)unit->path;
+            error_report(&error);
+        }
+        return;
+    }
+
+    if (unit->message != NULL) {
+        const ASTNode* node = unit->error_node;
+        const char* name = ast_node_name(node);
+        if (node != NULL && node->line != 0) {
+            fprintf(stderr, "%s:%u:%u: ", unit->path, (unsigned)node->line, (unsigned)node->column);
+        } else {
+            fprintf(stderr, "%s: ", unit->path);
+        }
+        fprintf(stderr, "Error: %s%s%s%s\n", unit->message, name ? " '" : "", name ? name : "", name ? "'" : "");
+        return;
+    }
+
+    // 成分の検査のエラーは、エラーを含む単位で1回だけ報告する
+    const DriverComponent* component = &driver->components[unit->component];
+    if (component->error != SLANG_SUCCESS && !component->blocked && &driver->units[component->error_unit] == unit) {
+        const TypeErrorSite* site = &component->site;
+        const char* message = component->message ? component->message : "type check failed";
+        if (site->line != 0) {
+            fprintf(stderr, "%s:%u:%u: ", unit->path, (unsigned)site->line, (unsigned)site->column);
+        } else {
+            fprintf(stderr, "%s: ", unit->path);
+        }
+        fprintf(stderr, "Type Error: %s%s%s%s\n", message, site->name ? " '" : "", site->name ? site->name : "",
+                site->name ? "'" : "");
+    }
+}
+
+SlangError driver_compile(Driver* driver) {
+    // キーに入れるのは出力に影響するフラグだけ
+    char flags[32];
+    snprintf(flags, sizeof(flags), "-O%d%s", driver->options.options.level,
+             driver->options.format == ASM_OUTPUT_ASSEMBLY ? " -S" : "");
+    const char* extension = driver->options.format == ASM_OUTPUT_OBJECT ? ".o" : ".s";
+
+    // キャッシュのディレクトリが使えなくても、依存関係はメモリの上で求める
+    BuildCache* cache = driver->options.cache_dir ? build_cache_open(driver->options.cache_dir, flags) : NULL;
+    if (cache == NULL) cache = build_cache_open(NULL, flags);
+    if (cache == NULL) return SLANG_ERROR_INTERNAL;
+
+    SlangError error = driver_plan(driver, cache);
+    if (error != SLANG_SUCCESS) {
+        build_cache_close(cache);
+        return error;
+    }
+
+    // 成分は構文解析する全員と、検査する依存先の成分を待つ（依存先の成分はどれも検査する）
+    for (size_t c = 0; c < driver->component_count; c++) {
+        DriverComponent* component = &driver->components[c];
+        if (component->needs_check) {
+            atomic_init(&component->waiting, component->member_count + component->dependency_count);
+        }
+    }
+    for (size_t i = 0; i < driver->unit_count; i++) {
+        if (driver->units[i].needs_parse) thread_pool_spawn(driver->pool, &driver->group, parse_job, &driver->units[i]);
+    }
+    thread_pool_wait(driver->pool, &driver->group);
+
+    // 報告とキャッシュへの格納は単位の順に行う
+    for (size_t i = 0; i < driver->unit_count; i++) {
+        DriverUnit* unit = &driver->units[i];
+        if (!unit->needs_parse) continue;
+        SlangError result = unit->error != SLANG_SUCCESS ? unit->error : driver->components[unit->component].error;
+        if (result != SLANG_SUCCESS) {
+            report_unit(driver, unit);
+            if (error == SLANG_SUCCESS) error = result;
+            continue;
+        }
+        if (unit->needs_output) build_cache_store(cache, unit->key, extension, unit->output_path);
+    }
+
+    SlangError closed = build_cache_close(cache);
+    return error != SLANG_SUCCESS ? error : closed;
+}
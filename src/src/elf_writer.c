@@ -0,0 +1,391 @@
+#include "../include/elf_writer.h"
+#include <elf.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ELF_INITIAL_CAPACITY 64
+
+// 出力するセクションの番号
+enum {
+    SECTION_NULL,
+    SECTION_TEXT,
+    SECTION_DATA,
+    SECTION_RELA_TEXT,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_NOTE_STACK,
+    SECTION_SHSTRTAB,
+    SECTION_COUNT
+};
+
+static const char* const section_names[SECTION_COUNT] = {
+    "", ".text", ".data", ".rela.text", ".symtab", ".strtab", ".note.GNU-stack", ".shstrtab"
+};
+
+bool elf_buffer_append(ElfBuffer* buffer, const void* data, size_t size) {
+    if (buffer->capacity - buffer->size < size) {
+        size_t capacity = buffer->capacity ? buffer->capacity : ELF_INITIAL_CAPACITY;
+        while (capacity - buffer->size < size) capacity *= 2;
+        uint8_t* grown = realloc(buffer->data, capacity);
+        if (grown == NULL) return false;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    if (data != NULL) memcpy(buffer->data + buffer->size, data, size);
+    else memset(buffer->data + buffer->size, 0, size);
+    buffer->size += size;
+    return true;
+}
+
+bool elf_buffer_align(ElfBuffer* buffer, size_t alignment) {
+    size_t padding = (alignment - buffer->size % alignment) % alignment;
+    return elf_buffer_append(buffer, NULL, padding);
+}
+
+ElfObject* elf_object_create(void) {
+    ElfObject* object = calloc(1, sizeof(ElfObject));
+    if (object == NULL) return NULL;
+
+    object->symbols = malloc(ELF_INITIAL_CAPACITY * sizeof(ElfSymbol));
+    object->symbol_index = calloc(ELF_INITIAL_CAPACITY * 2, sizeof(ElfSymbolSlot));
+    if (object->symbols == NULL || object->symbol_index == NULL || !elf_buffer_append(&object->strings, "", 1)) {
+        elf_object_destroy(object);
+        return NULL;
+    }
+    object->symbol_capacity = ELF_INITIAL_CAPACITY;
+    object->index_capacity = ELF_INITIAL_CAPACITY * 2;
+    memset(&object->symbols[0], 0, sizeof(ElfSymbol));
+    object->symbol_count = 1;
+    return object;
+}
+
+void elf_object_destroy(ElfObject* object) {
+    if (object == NULL) return;
+    free(object->text.data);
+    free(object->data.data);
+    free(object->strings.data);
+    free(object->symbols);
+    free(object->symbol_index);
+    free(object->relocations);
+    free(object);
+}
+
+static uint32_t hash_name(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static const char* symbol_name(const ElfObject* object, uint32_t symbol) {
+    return (const char*)object->strings.data + object->symbols[symbol].name;
+}
+
+static size_t find_slot(const ElfObject* object, const char* name, uint32_t hash) {
+    size_t mask = object->index_capacity - 1;
+    size_t slot = hash & mask;
+    while (object->symbol_index[slot].symbol != 0) {
+        const ElfSymbolSlot* entry = &object->symbol_index[slot];
+        if (entry->hash == hash && strcmp(symbol_name(object, entry->symbol), name) == 0) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static bool grow_index(ElfObject* object) {
+    size_t capacity = object->index_capacity * 2;
+    ElfSymbolSlot* index = calloc(capacity, sizeof(ElfSymbolSlot));
+    if (index == NULL) return false;
+
+    // 名前はすべて異なるので空きを探すだけでよい
+    for (size_t i = 0; i < object->index_capacity; i++) {
+        ElfSymbolSlot entry = object->symbol_index[i];
+        if (entry.symbol == 0) continue;
+        size_t slot = entry.hash & (capacity - 1);
+        while (index[slot].symbol != 0) slot = (slot + 1) & (capacity - 1);
+        index[slot] = entry;
+    }
+    free(object->symbol_index);
+    object->symbol_index = index;
+    object->index_capacity = capacity;
+    return true;
+}
+
+uint32_t elf_object_symbol(ElfObject* object, const char* name) {
+    if (object->failed || name == NULL) return 0;
+
+    uint32_t hash = hash_name(name);
+    size_t slot = find_slot(object, name, hash);
+    if (object->symbol_index[slot].symbol != 0) return object->symbol_index[slot].symbol;
+
+    if (object->symbol_count == object->symbol_capacity) {
+        size_t capacity = object->symbol_capacity * 2;
+        ElfSymbol* symbols = realloc(object->symbols, capacity * sizeof(ElfSymbol));
+        if (symbols == NULL) {
+            object->failed = true;
+            return 0;
+        }
+        object->symbols = symbols;
+        object->symbol_capacity = capacity;
+    }
+
+    size_t offset = object->strings.size;
+    if (!elf_buffer_append(&object->strings, name, strlen(name) + 1)) {
+        object->failed = true;
+        return 0;
+    }
+
+    uint32_t symbol = (uint32_t)object->symbol_count++;
+    object->symbols[symbol] = (ElfSymbol){ (uint32_t)offset, ELF_SECTION_UNDEFINED, false, false, false, 0 };
+    object->symbol_index[slot] = (ElfSymbolSlot){ symbol, hash };
+
+    // 埋まり具合を半分以下に保つ
+    if (object->symbol_count * 2 > object->index_capacity && !grow_index(object)) {
+        object->failed = true;
+        return 0;
+    }
+    return symbol;
+}
+
+bool elf_object_define(ElfObject* object, uint32_t symbol, ElfSection section, uint64_t value, bool function) {
+    if (symbol == 0 || symbol >= object->symbol_count) return false;
+    ElfSymbol* entry = &object->symbols[symbol];
+    if (entry->section != ELF_SECTION_UNDEFINED) return false;
+    entry->section = (uint8_t)section;
+    entry->value = value;
+    entry->function = function;
+    return true;
+}
+
+void elf_object_set_global(ElfObject* object, uint32_t symbol) {
+    if (symbol != 0 && symbol < object->symbol_count) object->symbols[symbol].global = true;
+}
+
+void elf_object_set_weak(ElfObject* object, uint32_t symbol) {
+    if (symbol == 0 || symbol >= object->symbol_count) return;
+    object->symbols[symbol].global = true;
+    object->symbols[symbol].weak = true;
+}
+
+bool elf_object_relocate(ElfObject* object, uint64_t offset, uint32_t symbol, uint32_t type, int64_t addend) {
+    if (symbol == 0) return false;
+    if (object->relocation_count == object->relocation_capacity) {
+        size_t capacity = object->relocation_capacity ? object->relocation_capacity * 2 : ELF_INITIAL_CAPACITY;
+        ElfRelocation* relocations = realloc(object->relocations, capacity * sizeof(ElfRelocation));
+        if (relocations == NULL) {
+            object->failed = true;
+            return false;
+        }
+        object->relocations = relocations;
+        object->relocation_capacity = capacity;
+    }
+    object->relocations[object->relocation_count++] = (ElfRelocation){ offset, symbol, type, addend };
+    return true;
+}
+
+void elf_object_truncate_text(ElfObject* object, size_t size) {
+    if (size >= object->text.size) return;
+    object->text.size = size;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < object->relocation_count; i++) {
+        if (object->relocations[i].offset < size) object->relocations[kept++] = object->relocations[i];
+    }
+    object->relocation_count = kept;
+
+    for (size_t i = 1; i < object->symbol_count; i++) {
+        ElfSymbol* symbol = &object->symbols[i];
+        if (symbol->section == ELF_SECTION_TEXT && symbol->value >= size) {
+            symbol->section = ELF_SECTION_UNDEFINED;
+            symbol->value = 0;
+        }
+    }
+}
+
+static Elf64_Shdr section_header(uint32_t name, uint32_t type, uint64_t flags, uint64_t offset, uint64_t size,
+                                 uint32_t link, uint32_t info, uint64_t alignment, uint64_t entry_size) {
+    Elf64_Shdr header;
+    memset(&header, 0, sizeof(header));
+    header.sh_name = name;
+    header.sh_type = type;
+    header.sh_flags = flags;
+    header.sh_offset = offset;
+    header.sh_size = size;
+    header.sh_link = link;
+    header.sh_info = info;
+    header.sh_addralign = alignment;
+    header.sh_entsize = entry_size;
+    return header;
+}
+
+static bool write_all(int fd, const uint8_t* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = write(fd, data + written, size - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += (size_t)result;
+    }
+    return true;
+}
+
+// 記号表の並べ替え（ELFでは局所記号を先に置く）
+// 参照されない未定義の記号は出力しない
+static uint32_t* order_symbols(const ElfObject* object, uint32_t* first_global, uint32_t* output_count) {
+    uint32_t* order = calloc(object->symbol_count, sizeof(uint32_t));
+    bool* referenced = calloc(object->symbol_count, sizeof(bool));
+    if (order == NULL || referenced == NULL) {
+        free(order);
+        free(referenced);
+        return NULL;
+    }
+    for (size_t i = 0; i < object->relocation_count; i++) referenced[object->relocations[i].symbol] = true;
+
+    uint32_t next = 1;
+    for (uint32_t i = 1; i < object->symbol_count; i++) {
+        const ElfSymbol* symbol = &object->symbols[i];
+        if (symbol->section != ELF_SECTION_UNDEFINED && !symbol->global) order[i] = next++;
+    }
+    *first_global = next;
+    for (uint32_t i = 1; i < object->symbol_count; i++) {
+        const ElfSymbol* symbol = &object->symbols[i];
+        if (order[i] != 0) continue;
+        if (symbol->section == ELF_SECTION_UNDEFINED && !referenced[i]) continue;
+        order[i] = next++;
+    }
+    *output_count = next;
+    free(referenced);
+    return order;
+}
+
+bool elf_object_write(const ElfObject* object, int fd) {
+    if (object->failed) return false;
+
+    uint32_t first_global = 0, output_count = 0;
+    uint32_t* order = order_symbols(object, &first_global, &output_count);
+    if (order == NULL) return false;
+
+    ElfBuffer image = { NULL, 0, 0 };
+    ElfBuffer names = { NULL, 0, 0 };
+    uint32_t name_offsets[SECTION_COUNT];
+    uint64_t offsets[SECTION_COUNT];
+    uint64_t sizes[SECTION_COUNT];
+    memset(offsets, 0, sizeof(offsets));
+    memset(sizes, 0, sizeof(sizes));
+
+    bool ok = true;
+    for (size_t i = 0; i < SECTION_COUNT && ok; i++) {
+        name_offsets[i] = (uint32_t)names.size;
+        ok = elf_buffer_append(&names, section_names[i], strlen(section_names[i]) + 1);
+    }
+
+    // ヘッダは最後に埋める
+    ok = ok && elf_buffer_append(&image, NULL, sizeof(Elf64_Ehdr));
+
+    ok = ok && elf_buffer_align(&image, 16);
+    offsets[SECTION_TEXT] = image.size;
+    sizes[SECTION_TEXT] = object->text.size;
+    ok = ok && elf_buffer_append(&image, object->text.data, object->text.size);
+
+    ok = ok && elf_buffer_align(&image, 8);
+    offsets[SECTION_DATA] = image.size;
+    sizes[SECTION_DATA] = object->data.size;
+    ok = ok && elf_buffer_append(&image, object->data.data, object->data.size);
+
+    ok = ok && elf_buffer_align(&image, 8);
+    offsets[SECTION_RELA_TEXT] = image.size;
+    for (size_t i = 0; i < object->relocation_count && ok; i++) {
+        const ElfRelocation* relocation = &object->relocations[i];
+        Elf64_Rela entry;
+        entry.r_offset = relocation->offset;
+        entry.r_info = ELF64_R_INFO(order[relocation->symbol], relocation->type);
+        entry.r_addend = relocation->addend;
+        ok = elf_buffer_append(&image, &entry, sizeof(entry));
+    }
+    sizes[SECTION_RELA_TEXT] = image.size - offsets[SECTION_RELA_TEXT];
+
+    ok = ok && elf_buffer_align(&image, 8);
+    offsets[SECTION_SYMTAB] = image.size;
+    ok = ok && elf_buffer_append(&image, NULL, (size_t)output_count * sizeof(Elf64_Sym));
+    if (ok) {
+        Elf64_Sym* table = (Elf64_Sym*)(image.data + offsets[SECTION_SYMTAB]);
+        for (uint32_t i = 1; i < object->symbol_count; i++) {
+            if (order[i] == 0) continue;
+            const ElfSymbol* symbol = &object->symbols[i];
+            Elf64_Sym* entry = &table[order[i]];
+            unsigned type = symbol->section == ELF_SECTION_UNDEFINED || symbol->section == ELF_SECTION_ABSOLUTE
+                          ? STT_NOTYPE
+                          : symbol->function ? STT_FUNC : STT_OBJECT;
+            entry->st_name = symbol->name;
+            unsigned binding = order[i] < first_global ? STB_LOCAL : symbol->weak ? STB_WEAK : STB_GLOBAL;
+            entry->st_info = ELF64_ST_INFO(binding, type);
+            entry->st_shndx = symbol->section == ELF_SECTION_TEXT ? SECTION_TEXT
+                            : symbol->section == ELF_SECTION_DATA ? SECTION_DATA
+                            : symbol->section == ELF_SECTION_ABSOLUTE ? SHN_ABS : SHN_UNDEF;
+            entry->st_value = symbol->value;
+        }
+    }
+    sizes[SECTION_SYMTAB] = (uint64_t)output_count * sizeof(Elf64_Sym);
+
+    offsets[SECTION_STRTAB] = image.size;
+    sizes[SECTION_STRTAB] = object->strings.size;
+    ok = ok && elf_buffer_append(&image, object->strings.data, object->strings.size);
+
+    offsets[SECTION_NOTE_STACK] = image.size;
+
+    offsets[SECTION_SHSTRTAB] = image.size;
+    sizes[SECTION_SHSTRTAB] = names.size;
+    ok = ok && elf_buffer_append(&image, names.data, names.size);
+
+    ok = ok && elf_buffer_align(&image, 8);
+    uint64_t header_offset = image.size;
+    Elf64_Shdr headers[SECTION_COUNT];
+    headers[SECTION_NULL] = section_header(0, SHT_NULL, 0, 0, 0, 0, 0, 0, 0);
+    headers[SECTION_TEXT] = section_header(name_offsets[SECTION_TEXT], SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                                           offsets[SECTION_TEXT], sizes[SECTION_TEXT], 0, 0, 16, 0);
+    headers[SECTION_DATA] = section_header(name_offsets[SECTION_DATA], SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,
+                                           offsets[SECTION_DATA], sizes[SECTION_DATA], 0, 0, 8, 0);
+    headers[SECTION_RELA_TEXT] = section_header(name_offsets[SECTION_RELA_TEXT], SHT_RELA, SHF_INFO_LINK,
+                                                offsets[SECTION_RELA_TEXT], sizes[SECTION_RELA_TEXT],
+                                                SECTION_SYMTAB, SECTION_TEXT, 8, sizeof(Elf64_Rela));
+    headers[SECTION_SYMTAB] = section_header(name_offsets[SECTION_SYMTAB], SHT_SYMTAB, 0,
+                                             offsets[SECTION_SYMTAB], sizes[SECTION_SYMTAB],
+                                             SECTION_STRTAB, first_global, 8, sizeof(Elf64_Sym));
+    headers[SECTION_STRTAB] = section_header(name_offsets[SECTION_STRTAB], SHT_STRTAB, 0,
+                                             offsets[SECTION_STRTAB], sizes[SECTION_STRTAB], 0, 0, 1, 0);
+    headers[SECTION_NOTE_STACK] = section_header(name_offsets[SECTION_NOTE_STACK], SHT_PROGBITS, 0,
+                                                 offsets[SECTION_NOTE_STACK], 0, 0, 0, 1, 0);
+    headers[SECTION_SHSTRTAB] = section_header(name_offsets[SECTION_SHSTRTAB], SHT_STRTAB, 0,
+                                               offsets[SECTION_SHSTRTAB], sizes[SECTION_SHSTRTAB], 0, 0, 1, 0);
+    ok = ok && elf_buffer_append(&image, headers, sizeof(headers));
+
+    if (ok) {
+        Elf64_Ehdr header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.e_ident, ELFMAG, SELFMAG);
+        header.e_ident[EI_CLASS] = ELFCLASS64;
+        header.e_ident[EI_DATA] = ELFDATA2LSB;
+        header.e_ident[EI_VERSION] = EV_CURRENT;
+        header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+        header.e_type = ET_REL;
+        header.e_machine = EM_X86_64;
+        header.e_version = EV_CURRENT;
+        header.e_shoff = header_offset;
+        header.e_ehsize = sizeof(Elf64_Ehdr);
+        header.e_shentsize = sizeof(Elf64_Shdr);
+        header.e_shnum = SECTION_COUNT;
+        header.e_shstrndx = SECTION_SHSTRTAB;
+        memcpy(image.data, &header, sizeof(header));
+        ok = write_all(fd, image.data, image.size);
+    }
+
+    free(image.data);
+    free(names.data);
+    free(order);
+    return ok;
+}
@@ -131,18 +131,3 @@ char* error_to_string(Error* error) {
 
     return result;
 }
-
-SlangError* slang_error_new(int code, const char* message) {
-    SlangError* error = (SlangError*)malloc(sizeof(SlangError));
-    if (error == NULL) {
-        return NULL;
-    }
-    error->code = code;
-    error->message = message;
-    return error;
-}
-
-void print_error(const SlangError* error) {
-    if (!error) return;
-    fprintf(stderr, "Error[%d]: %s\n", error->code, error->message);
-} 
\ No newline at end of file
@@ -0,0 +1,555 @@
+#include "../include/flat_ast.h"
+#include "../include/intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FLAT_AST_INITIAL_CAPACITY 64
+
+static const char* const operator_texts[FLAT_OPERATOR_COUNT] = {
+    [FLAT_OPERATOR_ADD] = "+", [FLAT_OPERATOR_SUB] = "-", [FLAT_OPERATOR_MUL] = "*",
+    [FLAT_OPERATOR_DIV] = "/", [FLAT_OPERATOR_MOD] = "%", [FLAT_OPERATOR_EQ] = "==",
+    [FLAT_OPERATOR_NE] = "!=", [FLAT_OPERATOR_LT] = "<", [FLAT_OPERATOR_LE] = "<=",
+    [FLAT_OPERATOR_GT] = ">", [FLAT_OPERATOR_GE] = ">=", [FLAT_OPERATOR_AND] = "&&",
+    [FLAT_OPERATOR_OR] = "||", [FLAT_OPERATOR_NOT] = "!",
+};
+
+const char* flat_ast_operator_text(FlatOperator op) {
+    return op > FLAT_OPERATOR_NONE && op < FLAT_OPERATOR_COUNT ? operator_texts[op] : NULL;
+}
+
+static FlatOperator operator_code(const char* text) {
+    for (int op = FLAT_OPERATOR_NONE + 1; op < FLAT_OPERATOR_COUNT; op++) {
+        if (strcmp(operator_texts[op], text) == 0) return (FlatOperator)op;
+    }
+    return FLAT_OPERATOR_NONE;
+}
+
+FlatAst* flat_ast_create(void) {
+    FlatAst* ast = calloc(1, sizeof(FlatAst));
+    if (ast == NULL) return NULL;
+    ast->root = FLAT_AST_NONE;
+    return ast;
+}
+
+void flat_ast_destroy(FlatAst* ast) {
+    if (ast == NULL) return;
+    free(ast->tags);
+    free(ast->a);
+    free(ast->b);
+    free(ast->extra);
+    free(ast->strings);
+    free(ast->types);
+    free(ast->name_keys);
+    free(ast->name_offsets);
+    free(ast);
+}
+
+// 配列をneeded個まで伸ばす（32ビットの番号に収まらなければ失敗）
+static bool grow(void** array, uint32_t* capacity, size_t needed, size_t element_size) {
+    if (needed <= *capacity) return true;
+    if (needed >= FLAT_AST_NONE) return false;
+
+    size_t next = *capacity ? *capacity : FLAT_AST_INITIAL_CAPACITY;
+    while (next < needed) next *= 2;
+    if (next >= FLAT_AST_NONE) next = FLAT_AST_NONE - 1;
+    void* grown = realloc(*array, next * element_size);
+    if (grown == NULL) return false;
+    *array = grown;
+    *capacity = (uint32_t)next;
+    return true;
+}
+
+static bool push_node(FlatAst* ast, int kind, FlatOperator op, uint32_t a, uint32_t b, FlatNode* node) {
+    uint32_t needed = ast->node_count + 1;
+    uint32_t capacity = ast->node_capacity;
+    if (needed > capacity) {
+        // 3本の配列を同じ容量にそろえる
+        uint32_t tags_capacity = capacity, a_capacity = capacity, b_capacity = capacity;
+        if (!grow((void**)&ast->tags, &tags_capacity, needed, sizeof(uint16_t)) ||
+            !grow((void**)&ast->a, &a_capacity, needed, sizeof(uint32_t)) ||
+            !grow((void**)&ast->b, &b_capacity, needed, sizeof(uint32_t))) {
+            return false;
+        }
+        ast->node_capacity = tags_capacity;
+    }
+
+    *node = ast->node_count++;
+    ast->tags[*node] = (uint16_t)(kind | op << 8);
+    ast->a[*node] = a;
+    ast->b[*node] = b;
+    return true;
+}
+
+static bool push_extra(FlatAst* ast, const uint32_t* values, uint32_t count, uint32_t* start) {
+    if (!grow((void**)&ast->extra, &ast->extra_capacity, (size_t)ast->extra_count + count, sizeof(uint32_t))) return false;
+    *start = ast->extra_count;
+    if (count > 0) memcpy(ast->extra + ast->extra_count, values, count * sizeof(uint32_t));
+    ast->extra_count += count;
+    return true;
+}
+
+static bool push_string(FlatAst* ast, const char* text, size_t length, uint32_t* offset) {
+    if (!grow((void**)&ast->strings, &ast->string_capacity, (size_t)ast->string_size + length + 1, 1)) return false;
+    *offset = ast->string_size;
+    memcpy(ast->strings + ast->string_size, text, length);
+    ast->strings[ast->string_size + length] = '\0';
+    ast->string_size += (uint32_t)length + 1;
+    return true;
+}
+
+static uint32_t name_slot(const FlatAst* ast, const char* name) {
+    uintptr_t hash = (uintptr_t)name;
+    hash ^= hash >> 17;
+    hash *= 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(hash >> 32) & (ast->name_capacity - 1);
+}
+
+// 名前（インターンされたポインタ）をstringsに1回だけ置く
+static bool add_name(FlatAst* ast, const char* name, uint32_t* offset) {
+    if (name == NULL) {
+        *offset = FLAT_AST_NONE;
+        return true;
+    }
+
+    if ((ast->name_count + 1) * 2 > ast->name_capacity) {
+        uint32_t capacity = ast->name_capacity ? ast->name_capacity * 2 : FLAT_AST_INITIAL_CAPACITY;
+        const char** keys = calloc(capacity, sizeof(const char*));
+        uint32_t* offsets = malloc(capacity * sizeof(uint32_t));
+        if (keys == NULL || offsets == NULL) {
+            free(keys);
+            free(offsets);
+            return false;
+        }
+        const char** old_keys = ast->name_keys;
+        uint32_t* old_offsets = ast->name_offsets;
+        uint32_t old_capacity = ast->name_capacity;
+        ast->name_keys = keys;
+        ast->name_offsets = offsets;
+        ast->name_capacity = capacity;
+        for (uint32_t i = 0; i < old_capacity; i++) {
+            if (old_keys[i] == NULL) continue;
+            uint32_t slot = name_slot(ast, old_keys[i]);
+            while (keys[slot] != NULL) slot = (slot + 1) & (capacity - 1);
+            keys[slot] = old_keys[i];
+            offsets[slot] = old_offsets[i];
+        }
+        free(old_keys);
+        free(old_offsets);
+    }
+
+    uint32_t slot = name_slot(ast, name);
+    while (ast->name_keys[slot] != NULL) {
+        if (ast->name_keys[slot] == name) {
+            *offset = ast->name_offsets[slot];
+            return true;
+        }
+        slot = (slot + 1) & (ast->name_capacity - 1);
+    }
+    if (!push_string(ast, name, strlen(name), offset)) return false;
+    ast->name_keys[slot] = name;
+    ast->name_offsets[slot] = *offset;
+    ast->name_count++;
+    return true;
+}
+
+// 型注釈（型の表の型はポインタで比べられるので、同じ型は同じ番号になる）
+static bool add_type(FlatAst* ast, const Type* type, uint32_t* index) {
+    *index = FLAT_AST_NONE;
+    if (type == NULL) return true;
+    for (uint32_t i = 0; i < ast->type_count; i++) {
+        if (ast->types[i] == type) {
+            *index = i;
+            return true;
+        }
+    }
+    if (!grow((void**)&ast->types, &ast->type_capacity, (size_t)ast->type_count + 1, sizeof(const Type*))) return false;
+    *index = ast->type_count;
+    ast->types[ast->type_count++] = type;
+    return true;
+}
+
+// 子の番号を集める一時的なスタック（並びの子を並べ終えてからextraに写す）
+typedef struct {
+    FlatAst* ast;
+    uint32_t* stack;
+    uint32_t stack_count;
+    uint32_t stack_capacity;
+} Builder;
+
+static SlangError build_node(Builder* builder, const ASTNode* node, FlatNode* out);
+
+// 子を順に並べ、番号をextraの連続した範囲に置く（headに渡した値を範囲の前に付ける）
+static SlangError build_list(Builder* builder, ASTNode* const* nodes, size_t count,
+                             const uint32_t* head, uint32_t head_count, uint32_t* start) {
+    if (count >= FLAT_AST_NONE) return SLANG_ERROR_INTERNAL;
+    uint32_t base = builder->stack_count;
+    if (!grow((void**)&builder->stack, &builder->stack_capacity, (size_t)base + head_count + count, sizeof(uint32_t))) {
+        return SLANG_ERROR_INTERNAL;
+    }
+    if (head_count > 0) memcpy(builder->stack + base, head, head_count * sizeof(uint32_t));
+    builder->stack_count += head_count;
+
+    for (size_t i = 0; i < count; i++) {
+        FlatNode child;
+        SlangError error = build_node(builder, nodes[i], &child);
+        if (error != SLANG_SUCCESS) return error;
+        // 子を並べる間にスタックが伸びて動くことがあるので、番号で書く
+        builder->stack[builder->stack_count++] = child;
+    }
+
+    bool pushed = push_extra(builder->ast, builder->stack + base, builder->stack_count - base, start);
+    builder->stack_count = base;
+    return pushed ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+}
+
+static SlangError build_node(Builder* builder, const ASTNode* node, FlatNode* out) {
+    FlatAst* ast = builder->ast;
+    *out = FLAT_AST_NONE;
+    if (node == NULL) return SLANG_SUCCESS;
+
+    FlatOperator op = FLAT_OPERATOR_NONE;
+    uint32_t a = FLAT_AST_NONE;
+    uint32_t b = FLAT_AST_NONE;
+    uint32_t values[4];
+    SlangError error = SLANG_SUCCESS;
+    bool ok = true;
+
+    // 子を先に並べる（後順）
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL:
+        case NODE_FLOAT_LITERAL: {
+            uint64_t bits;
+            if (node->type == NODE_INTEGER_LITERAL) {
+                bits = (uint64_t)node->data.integer_literal.value;
+            } else {
+                memcpy(&bits, &node->data.float_literal.value, sizeof(bits));
+            }
+            a = (uint32_t)bits;
+            b = (uint32_t)(bits >> 32);
+            break;
+        }
+
+        case NODE_BOOLEAN_LITERAL:
+            a = node->data.boolean_literal.value;
+            break;
+
+        case NODE_STRING_LITERAL: {
+            const char* value = node->data.string_literal.value;
+            size_t length = value ? strlen(value) : 0;
+            if (length >= FLAT_AST_NONE) return SLANG_ERROR_INTERNAL;
+            ok = push_string(ast, value ? value : "", length, &a);
+            b = (uint32_t)length;
+            break;
+        }
+
+        case NODE_VARIABLE_REFERENCE:
+            ok = add_name(ast, node->data.variable_reference.name, &a);
+            break;
+
+        case NODE_VARIABLE:
+            ok = add_name(ast, node->data.variable.name, &a) && add_type(ast, node->data.variable.type, &b);
+            break;
+
+        case NODE_ASSIGNMENT:
+            error = build_node(builder, node->data.assignment.value, &b);
+            ok = error == SLANG_SUCCESS && add_name(ast, node->data.assignment.name, &a);
+            break;
+
+        case NODE_BINARY_EXPRESSION:
+        case NODE_UNARY_EXPRESSION: {
+            const char* text = node->type == NODE_BINARY_EXPRESSION ? node->data.binary_expression.operator
+                                                                    : node->data.unary_expression.operator;
+            op = text ? operator_code(text) : FLAT_OPERATOR_NONE;
+            if (op == FLAT_OPERATOR_NONE) return SLANG_ERROR_INTERNAL;
+            if (node->type == NODE_UNARY_EXPRESSION) {
+                error = build_node(builder, node->data.unary_expression.right, &a);
+                break;
+            }
+            error = build_node(builder, node->data.binary_expression.left, &a);
+            if (error == SLANG_SUCCESS) error = build_node(builder, node->data.binary_expression.right, &b);
+            break;
+        }
+
+        case NODE_EXPRESSION_STATEMENT:
+            error = build_node(builder, node->data.expression_statement.expression, &a);
+            break;
+
+        case NODE_RETURN_STATEMENT:
+            error = build_node(builder, node->data.return_statement.value, &a);
+            break;
+
+        case NODE_WHILE_STATEMENT:
+            error = build_node(builder, node->data.while_statement.condition, &a);
+            if (error == SLANG_SUCCESS) error = build_node(builder, node->data.while_statement.body, &b);
+            break;
+
+        case NODE_BLOCK_STATEMENT:
+            error = build_list(builder, node->data.block_statement.statements,
+                               node->data.block_statement.statement_count, NULL, 0, &a);
+            b = (uint32_t)node->data.block_statement.statement_count;
+            break;
+
+        case NODE_LET_STATEMENT:
+            error = build_node(builder, node->data.let_statement.initializer, &values[1]);
+            ok = error == SLANG_SUCCESS && add_name(ast, node->data.let_statement.name, &a) &&
+                 add_type(ast, node->data.let_statement.type, &values[0]) && push_extra(ast, values, 2, &b);
+            break;
+
+        case NODE_IF_STATEMENT:
+            error = build_node(builder, node->data.if_statement.condition, &a);
+            if (error == SLANG_SUCCESS) error = build_node(builder, node->data.if_statement.then_branch, &values[0]);
+            if (error == SLANG_SUCCESS) error = build_node(builder, node->data.if_statement.else_branch, &values[1]);
+            ok = error != SLANG_SUCCESS || push_extra(ast, values, 2, &b);
+            break;
+
+        case NODE_FUNCTION_CALL:
+            values[0] = (uint32_t)node->data.function_call.argument_count;
+            error = build_list(builder, node->data.function_call.arguments, node->data.function_call.argument_count,
+                               values, 1, &b);
+            ok = error != SLANG_SUCCESS || add_name(ast, node->data.function_call.name, &a);
+            break;
+
+        case NODE_CALL_EXPRESSION:
+            error = build_node(builder, node->data.call_expression.callee, &a);
+            values[0] = (uint32_t)node->data.call_expression.argument_count;
+            if (error == SLANG_SUCCESS) {
+                error = build_list(builder, node->data.call_expression.arguments,
+                                   node->data.call_expression.argument_count, values, 1, &b);
+            }
+            break;
+
+        case NODE_FUNCTION: {
+            const Function* function = &node->data.function;
+            error = build_node(builder, function->body, &a);
+            if (error != SLANG_SUCCESS) break;
+            if (function->parameter_count >= UINT32_MAX / 2) return SLANG_ERROR_INTERNAL;
+
+            ok = add_name(ast, function->name, &values[0]) && add_type(ast, function->return_type, &values[1]);
+            values[2] = (uint32_t)function->priority;
+            values[3] = (uint32_t)function->parameter_count;
+            ok = ok && push_extra(ast, values, 4, &b);
+            for (size_t i = 0; ok && i < function->parameter_count; i++) {
+                uint32_t parameter[2];
+                uint32_t position;
+                ok = add_name(ast, function->parameters[i]->name, &parameter[0]) &&
+                     add_type(ast, function->parameters[i]->type, &parameter[1]) &&
+                     push_extra(ast, parameter, 2, &position);
+            }
+            uint32_t type_parameter = (uint32_t)function->type_parameter_count;
+            uint32_t position;
+            ok = ok && push_extra(ast, &type_parameter, 1, &position);
+            for (size_t i = 0; ok && i < function->type_parameter_count; i++) {
+                ok = add_name(ast, function->type_parameters[i], &type_parameter) &&
+                     push_extra(ast, &type_parameter, 1, &position);
+            }
+            break;
+        }
+
+        default:
+            return SLANG_ERROR_INTERNAL;
+    }
+    if (error != SLANG_SUCCESS) return error;
+    if (!ok || !push_node(ast, node->type, op, a, b, out)) return SLANG_ERROR_INTERNAL;
+    return SLANG_SUCCESS;
+}
+
+SlangError flat_ast_build(FlatAst* ast, const ASTNode* root) {
+    Builder builder = { ast, NULL, 0, 0 };
+    SlangError error = build_node(&builder, root, &ast->root);
+    free(builder.stack);
+    return error;
+}
+
+// ---------------------------------------------------------------------------
+// 木に戻す
+
+FlatNode flat_ast_subtree_first(const FlatAst* ast, FlatNode node) {
+    // 最初に並べた子をたどる
+    for (;;) {
+        FlatNode child = FLAT_AST_NONE;
+        uint32_t a = ast->a[node];
+        uint32_t b = ast->b[node];
+        switch (FLAT_AST_KIND(ast->tags[node])) {
+            case NODE_ASSIGNMENT: child = b; break;
+            case NODE_BINARY_EXPRESSION:
+            case NODE_UNARY_EXPRESSION:
+            case NODE_EXPRESSION_STATEMENT:
+            case NODE_RETURN_STATEMENT:
+            case NODE_WHILE_STATEMENT:
+            case NODE_IF_STATEMENT:
+            case NODE_CALL_EXPRESSION:
+            case NODE_FUNCTION:
+                child = a;
+                break;
+            case NODE_BLOCK_STATEMENT: child = b > 0 ? ast->extra[a] : FLAT_AST_NONE; break;
+            case NODE_LET_STATEMENT: child = ast->extra[b + 1]; break;
+            case NODE_FUNCTION_CALL: child = ast->extra[b] > 0 ? ast->extra[b + 1] : FLAT_AST_NONE; break;
+            default: break;
+        }
+        if (child == FLAT_AST_NONE) return node;
+        node = child;
+    }
+}
+
+static const char* expand_name(const FlatAst* ast, uint32_t offset, bool* ok) {
+    if (offset == FLAT_AST_NONE) return NULL;
+    const char* name = intern_cstr(ast->strings + offset);
+    if (name == NULL) *ok = false;
+    return name;
+}
+
+static Type* expand_type(const FlatAst* ast, uint32_t index) {
+    return index == FLAT_AST_NONE ? NULL : (Type*)ast->types[index];
+}
+
+SlangError flat_ast_expand(const FlatAst* ast, Arena* arena, ASTNode** root) {
+    *root = NULL;
+    if (ast->root == FLAT_AST_NONE) return SLANG_SUCCESS;
+
+    // 後順なので、番号の順に作れば子はいつも作り終えている
+    ASTNode** nodes = malloc((ast->node_count ? ast->node_count : 1) * sizeof(ASTNode*));
+    ASTNode** list = NULL;
+    size_t list_capacity = 0;
+    if (nodes == NULL) return SLANG_ERROR_INTERNAL;
+
+#define CHILD(index) ((index) == FLAT_AST_NONE ? NULL : nodes[index])
+    SlangError error = SLANG_SUCCESS;
+    for (FlatNode i = 0; i < ast->node_count && error == SLANG_SUCCESS; i++) {
+        uint32_t a = ast->a[i];
+        uint32_t b = ast->b[i];
+        const uint32_t* items = NULL;
+        size_t count = 0;
+        ASTNode* node = NULL;
+        bool ok = true;
+
+        // 子の並びはlistに集めてから作る（create_*_nodeがちょうどの大きさでarenaに写す）
+        int kind = FLAT_AST_KIND(ast->tags[i]);
+        if (kind == NODE_BLOCK_STATEMENT) {
+            items = ast->extra + a;
+            count = b;
+        } else if (kind == NODE_FUNCTION_CALL || kind == NODE_CALL_EXPRESSION) {
+            items = ast->extra + b + 1;
+            count = ast->extra[b];
+        }
+        if (count > list_capacity) {
+            ASTNode** grown = realloc(list, count * sizeof(ASTNode*));
+            if (grown == NULL) {
+                error = SLANG_ERROR_INTERNAL;
+                break;
+            }
+            list = grown;
+            list_capacity = count;
+        }
+        for (size_t j = 0; j < count; j++) list[j] = nodes[items[j]];
+
+        switch (kind) {
+            case NODE_INTEGER_LITERAL:
+                node = create_integer_literal_node(arena, flat_ast_integer(ast, i));
+                break;
+            case NODE_FLOAT_LITERAL: {
+                uint64_t bits = (uint64_t)b << 32 | a;
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                node = create_float_literal_node(arena, value);
+                break;
+            }
+            case NODE_BOOLEAN_LITERAL:
+                node = create_boolean_literal_node(arena, a != 0);
+                break;
+            case NODE_STRING_LITERAL:
+                node = create_string_literal_node(arena, ast->strings + a);
+                break;
+            case NODE_VARIABLE_REFERENCE:
+                node = create_variable_reference_node(arena, expand_name(ast, a, &ok));
+                break;
+            case NODE_VARIABLE:
+                node = create_variable_node(arena, expand_name(ast, a, &ok), expand_type(ast, b));
+                break;
+            case NODE_ASSIGNMENT:
+                node = create_assignment_node(arena, expand_name(ast, a, &ok), CHILD(b));
+                break;
+            case NODE_BINARY_EXPRESSION:
+                node = create_binary_expression_node(arena, CHILD(a), operator_texts[FLAT_AST_OPERATOR(ast->tags[i])], CHILD(b));
+                break;
+            case NODE_UNARY_EXPRESSION:
+                node = create_unary_expression_node(arena, operator_texts[FLAT_AST_OPERATOR(ast->tags[i])], CHILD(a));
+                break;
+            case NODE_EXPRESSION_STATEMENT:
+                node = create_expression_statement_node(arena, CHILD(a));
+                break;
+            case NODE_RETURN_STATEMENT:
+                node = create_return_statement_node(arena, CHILD(a));
+                break;
+            case NODE_WHILE_STATEMENT:
+                node = create_while_statement_node(arena, CHILD(a), CHILD(b));
+                break;
+            case NODE_BLOCK_STATEMENT:
+                node = create_block_statement_node(arena, list, count);
+                break;
+            case NODE_LET_STATEMENT:
+                node = create_let_statement_node(arena, expand_name(ast, a, &ok), expand_type(ast, ast->extra[b]),
+                                                 CHILD(ast->extra[b + 1]));
+                break;
+            case NODE_IF_STATEMENT:
+                node = create_if_statement_node(arena, CHILD(a), CHILD(ast->extra[b]), CHILD(ast->extra[b + 1]));
+                break;
+            case NODE_FUNCTION_CALL:
+                node = create_function_call_node(arena, expand_name(ast, a, &ok), list, count);
+                break;
+            case NODE_CALL_EXPRESSION:
+                node = create_call_expression_node(arena, CHILD(a), list, count);
+                break;
+            case NODE_FUNCTION: {
+                const uint32_t* header = ast->extra + b;
+                size_t parameter_count = header[3];
+                Variable** parameters = parameter_count ? arena_alloc(arena, parameter_count * sizeof(Variable*)) : NULL;
+                Variable* variables = parameter_count ? arena_alloc(arena, parameter_count * sizeof(Variable)) : NULL;
+                if (parameter_count > 0 && (parameters == NULL || variables == NULL)) {
+                    ok = false;
+                    break;
+                }
+                for (size_t p = 0; p < parameter_count; p++) {
+                    variables[p].name = expand_name(ast, header[4 + p * 2], &ok);
+                    variables[p].type = expand_type(ast, header[5 + p * 2]);
+                    parameters[p] = &variables[p];
+                }
+                node = create_function_node(arena, expand_name(ast, header[0], &ok), expand_type(ast, header[1]),
+                                            parameters, parameter_count, CHILD(a));
+                if (node == NULL) break;
+                node->data.function.priority = (int)header[2];
+                const uint32_t* type_parameters = header + 4 + parameter_count * 2;
+                size_t type_parameter_count = type_parameters[0];
+                if (type_parameter_count > 0) {
+                    const char** names = arena_alloc(arena, type_parameter_count * sizeof(const char*));
+                    if (names == NULL) {
+                        ok = false;
+                        break;
+                    }
+                    for (size_t p = 0; p < type_parameter_count; p++) {
+                        names[p] = expand_name(ast, type_parameters[1 + p], &ok);
+                    }
+                    node->data.function.type_parameters = names;
+                    node->data.function.type_parameter_count = type_parameter_count;
+                }
+                break;
+            }
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok || node == NULL) error = SLANG_ERROR_INTERNAL;
+        nodes[i] = node;
+    }
+#undef CHILD
+
+    if (error == SLANG_SUCCESS) *root = nodes[ast->root];
+    free(list);
+    free(nodes);
+    return error;
+}
+
+size_t flat_ast_memory(const FlatAst* ast) {
+    return (size_t)ast->node_count * (sizeof(uint16_t) + 2 * sizeof(uint32_t)) +
+           (size_t)ast->extra_count * sizeof(uint32_t) + ast->string_size +
+           (size_t)ast->type_count * sizeof(const Type*);
+}
@@ -0,0 +1,179 @@
+#include "../include/intern.h"
+#include "../include/arena.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_SHARD_COUNT 16      // 2の冪（ハッシュ値の上位ビットで選ぶ）
+#define INTERN_SHARD_SHIFT 28
+#define INTERN_INITIAL_CAPACITY 64
+#define INTERN_ARENA_BLOCK_SIZE (256 * 1024)
+
+// 各文字列の直前に置くヘッダ（ハッシュ値を再計算せずに済むようにする）
+typedef struct {
+    uint32_t hash;
+    uint32_t length;
+} InternHeader;
+
+// インターン表の断片（オープンアドレス法、線形探査）
+// 複数のスレッドから引けるよう、ハッシュ値で選んだ断片ごとにロックを取る
+typedef struct {
+    pthread_mutex_t lock;
+    Arena* arena;
+    const char** slots;
+    size_t capacity;
+    size_t count;
+} InternShard;
+
+static struct {
+    InternShard shards[INTERN_SHARD_COUNT];
+    bool initialized;
+} interner;
+
+static InternHeader* intern_header(const char* handle) {
+    return (InternHeader*)(handle - sizeof(InternHeader));
+}
+
+// FNV-1a
+static uint32_t intern_compute_hash(const char* str, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 断片の拡張（容量は常に2の冪）
+static bool intern_grow(InternShard* shard) {
+    size_t new_capacity = shard->capacity * 2;
+    const char** new_slots = calloc(new_capacity, sizeof(const char*));
+    if (new_slots == NULL) return false;
+
+    for (size_t i = 0; i < shard->capacity; i++) {
+        const char* handle = shard->slots[i];
+        if (handle == NULL) continue;
+
+        size_t index = intern_header(handle)->hash & (new_capacity - 1);
+        while (new_slots[index] != NULL) {
+            index = (index + 1) & (new_capacity - 1);
+        }
+        new_slots[index] = handle;
+    }
+
+    free(shard->slots);
+    shard->slots = new_slots;
+    shard->capacity = new_capacity;
+    return true;
+}
+
+// インターン表の初期化（スレッドを起動する前に呼ぶ）
+bool intern_init(void) {
+    if (interner.initialized) return true;
+
+    for (size_t i = 0; i < INTERN_SHARD_COUNT; i++) {
+        InternShard* shard = &interner.shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->arena = arena_create(INTERN_ARENA_BLOCK_SIZE / INTERN_SHARD_COUNT);
+        shard->slots = calloc(INTERN_INITIAL_CAPACITY, sizeof(const char*));
+        shard->capacity = INTERN_INITIAL_CAPACITY;
+        shard->count = 0;
+        if (shard->arena == NULL || shard->slots == NULL) {
+            interner.initialized = true;
+            for (size_t j = i + 1; j < INTERN_SHARD_COUNT; j++) pthread_mutex_init(&interner.shards[j].lock, NULL);
+            intern_shutdown();
+            return false;
+        }
+    }
+    interner.initialized = true;
+    return true;
+}
+
+// インターン表の破棄（全てのハンドルが無効になる）
+void intern_shutdown(void) {
+    if (!interner.initialized) return;
+    for (size_t i = 0; i < INTERN_SHARD_COUNT; i++) {
+        InternShard* shard = &interner.shards[i];
+        free(shard->slots);
+        if (shard->arena != NULL) arena_destroy(shard->arena);
+        shard->slots = NULL;
+        shard->arena = NULL;
+        shard->capacity = 0;
+        shard->count = 0;
+        pthread_mutex_destroy(&shard->lock);
+    }
+    interner.initialized = false;
+}
+
+// 文字列のインターン
+const char* intern(const char* str, size_t length) {
+    if (str == NULL) return NULL;
+    if (!interner.initialized && !intern_init()) return NULL;
+
+    uint32_t hash = intern_compute_hash(str, length);
+    InternShard* shard = &interner.shards[hash >> INTERN_SHARD_SHIFT];
+    pthread_mutex_lock(&shard->lock);
+
+    size_t index = hash & (shard->capacity - 1);
+    while (shard->slots[index] != NULL) {
+        const char* handle = shard->slots[index];
+        InternHeader* header = intern_header(handle);
+        if (header->hash == hash && header->length == length &&
+            memcmp(handle, str, length) == 0) {
+            pthread_mutex_unlock(&shard->lock);
+            return handle;
+        }
+        index = (index + 1) & (shard->capacity - 1);
+    }
+
+    // 新しい文字列を断片のアリーナに格納する
+    InternHeader* header = arena_alloc(shard->arena, sizeof(InternHeader) + length + 1);
+    if (header == NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+    header->hash = hash;
+    header->length = (uint32_t)length;
+
+    char* handle = (char*)(header + 1);
+    memcpy(handle, str, length);
+    handle[length] = '\0';
+
+    shard->slots[index] = handle;
+    shard->count++;
+
+    // 負荷率が1/2を超えたら拡張する
+    if (shard->count * 2 > shard->capacity) {
+        intern_grow(shard);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return handle;
+}
+
+const char* intern_cstr(const char* str) {
+    if (str == NULL) return NULL;
+    return intern(str, strlen(str));
+}
+
+// ハンドルのハッシュ値（記号表のキーとして使う）
+uint32_t intern_hash(const char* handle) {
+    return handle ? intern_header(handle)->hash : 0;
+}
+
+// ハンドルの長さ
+size_t intern_length(const char* handle) {
+    return handle ? intern_header(handle)->length : 0;
+}
+
+// 登録済みの文字列数
+size_t intern_count(void) {
+    size_t count = 0;
+    for (size_t i = 0; i < INTERN_SHARD_COUNT; i++) {
+        InternShard* shard = &interner.shards[i];
+        pthread_mutex_lock(&shard->lock);
+        count += shard->count;
+        pthread_mutex_unlock(&shard->lock);
+    }
+    return count;
+}
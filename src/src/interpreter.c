@@ -1,11 +1,542 @@
 #include "../include/interpreter.h"
+#include "../include/intern.h"
+#include "../include/logger.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-Interpreter* create_interpreter(void) { return NULL; }
-void free_interpreter(Interpreter* interpreter) {}
-void interpret(Interpreter* interpreter, ASTNode* node) {}
-void* evaluate_expression(Interpreter* interpreter, ASTNode* node) { return NULL; }
-void execute_statement(Interpreter* interpreter, ASTNode* node) {}
-void declare_variable(Interpreter* interpreter, const char* name, void* value) {}
-void* get_variable(Interpreter* interpreter, const char* name) { return NULL; }
-void declare_function(Interpreter* interpreter, const char* name, ASTNode* function_node) {}
-ASTNode* get_function(Interpreter* interpreter, const char* name) { return NULL; } 
\ No newline at end of file
+// GCC/Clangではラベルのアドレスを使った直接ジャンプでディスパッチする
+// （INTERPRETER_NO_COMPUTED_GOTOを定義するとswitchに戻る）
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(INTERPRETER_NO_COMPUTED_GOTO)
+#define INTERPRETER_COMPUTED_GOTO 1
+#endif
+
+// 組み込み関数: 引数を空白区切りで出力して改行する
+static Value native_println(const Value* args, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) fputc(' ', stdout);
+        value_print(stdout, args[i]);
+    }
+    fputc('\n', stdout);
+    return value_nil();
+}
+
+// 組み込みのログ（log!からerror!）: 最初の引数が文字列なら書式で、インストールされたロガーに書く。
+// ロガーがなければその場で整形して標準出力に書く
+static Value native_log_level(LogLevel level, const Value* args, size_t count) {
+    Logger* logger = logger_installed();
+    if (logger != NULL && !logger_enabled(logger, level)) return value_nil();
+
+    const char* format = "";
+    if (count > 0 && args[0].type == VALUE_STRING) {
+        format = args[0].as.string;
+        args++;
+        count--;
+    }
+    if (count > LOGGER_MAX_ARGS) count = LOGGER_MAX_ARGS;
+
+    LogArg log_args[LOGGER_MAX_ARGS];
+    for (size_t i = 0; i < count; i++) {
+        switch (args[i].type) {
+            case VALUE_BOOL: log_args[i] = LOG_BOOL(args[i].as.boolean); break;
+            case VALUE_INT: log_args[i] = LOG_INT(args[i].as.integer); break;
+            case VALUE_FLOAT: log_args[i] = LOG_FLOAT(args[i].as.number); break;
+            case VALUE_STRING: log_args[i] = LOG_STRING(args[i].as.string); break;
+            case VALUE_FUNCTION:
+            case VALUE_NATIVE: log_args[i] = LOG_STRING("<function>"); break;
+            default: log_args[i] = (LogArg){ LOG_ARG_NIL, { 0 } }; break;
+        }
+    }
+
+    if (logger != NULL) {
+        // 書式はソースの文字列なのでロガーより短く生きることがある
+        logger_write_copied(logger, level, format, log_args, count);
+    } else {
+        char line[LOGGER_LINE_MAX];
+        size_t length = logger_format(line, sizeof(line), level, format, log_args, count);
+        fwrite(line, 1, length, stdout);
+    }
+    return value_nil();
+}
+
+#define LOG_LEVEL(name, macro, class, rank) \
+    static Value native_##name(const Value* args, size_t count) { \
+        return native_log_level(LOG_LEVEL_##name, args, count); \
+    }
+#include "../include/log_levels.def"
+#undef LOG_LEVEL
+
+// インタプリタの作成
+Interpreter* create_interpreter(void) {
+    Interpreter* interpreter = calloc(1, sizeof(Interpreter));
+    if (interpreter == NULL) return NULL;
+
+    interpreter->program = bytecode_program_create();
+    interpreter->stack = malloc(INTERPRETER_STACK_SIZE * sizeof(Value));
+    interpreter->frames = malloc(INTERPRETER_MAX_FRAMES * sizeof(CallFrame));
+    interpreter->jit_threshold = JIT_DEFAULT_THRESHOLD;
+    if (interpreter->program == NULL || interpreter->stack == NULL || interpreter->frames == NULL ||
+        !interpreter_register_native(interpreter, "println", native_println) ||
+        !interpreter_register_native(interpreter, "print", native_println)) {
+        free_interpreter(interpreter);
+        return NULL;
+    }
+#define LOG_LEVEL(name, macro, class, rank) \
+    if (!interpreter_register_native(interpreter, macro, native_##name)) { \
+        free_interpreter(interpreter); \
+        return NULL; \
+    }
+#include "../include/log_levels.def"
+#undef LOG_LEVEL
+    return interpreter;
+}
+
+// インタプリタの破棄
+void free_interpreter(Interpreter* interpreter) {
+    if (interpreter == NULL) return;
+    bytecode_program_destroy(interpreter->program);
+    jit_destroy(interpreter->jit);
+    free(interpreter->stack);
+    free(interpreter->frames);
+    free(interpreter);
+}
+
+static SlangError runtime_error(Interpreter* interpreter, const char* message) {
+    interpreter->error = message;
+    return SLANG_ERROR_RUNTIME;
+}
+
+static bool is_number(const Value* value) {
+    return value->type == VALUE_INT || value->type == VALUE_FLOAT;
+}
+
+static double as_float(const Value* value) {
+    return value->type == VALUE_INT ? (double)value->as.integer : value->as.number;
+}
+
+// 整数同士以外の算術演算（浮動小数点数に揃える）
+static bool arith_slow(OpCode op, const Value* left, const Value* right, Value* result) {
+    if (!is_number(left) || !is_number(right)) return false;
+
+    double a = as_float(left);
+    double b = as_float(right);
+    switch (op) {
+        case OP_ADD: *result = value_float(a + b); break;
+        case OP_SUB: *result = value_float(a - b); break;
+        case OP_MUL: *result = value_float(a * b); break;
+        case OP_DIV: *result = value_float(a / b); break;
+        case OP_MOD: *result = value_float(fmod(a, b)); break;
+        default: return false;
+    }
+    return true;
+}
+
+// 大小比較（数値同士または文字列同士）
+static bool compare_slow(OpCode op, const Value* left, const Value* right, Value* result) {
+    int order;
+    if (is_number(left) && is_number(right)) {
+        double a = as_float(left);
+        double b = as_float(right);
+        order = (a > b) - (a < b);
+    } else if (left->type == VALUE_STRING && right->type == VALUE_STRING) {
+        order = strcmp(left->as.string, right->as.string);
+    } else {
+        return false;
+    }
+    *result = value_bool(op == OP_LT ? order < 0 : order <= 0);
+    return true;
+}
+
+// 熱くなった関数を機械語にする（JITが作れなければ以降は数えない）
+static void promote(Interpreter* interpreter, BytecodeFunction* function) {
+    if (interpreter->jit == NULL) interpreter->jit = jit_create(interpreter->program);
+    if (interpreter->jit == NULL) {
+        interpreter->jit_threshold = 0;
+        return;
+    }
+    jit_compile(interpreter->jit, function);
+}
+
+// 機械語で実行できればtrue（framesは残りの呼び出しフレームの数）
+static inline bool try_native(Interpreter* interpreter, BytecodeFunction* function, const Value* args, size_t frames,
+                              Value* result) {
+    if (interpreter->jit_threshold == 0 || function->tier == BYTECODE_TIER_REJECTED) return false;
+    if (function->tier == BYTECODE_TIER_INTERPRETED && ++function->hotness >= interpreter->jit_threshold) {
+        promote(interpreter, function);
+    }
+    return function->tier == BYTECODE_TIER_NATIVE && jit_enter(interpreter->jit, function, args, frames, result);
+}
+
+// バイトコードの実行
+// entryをbaseの位置から実行する。関数値はbase[-1]、引数はbase[0]以降に置かれている
+static SlangError interpreter_run(Interpreter* interpreter, BytecodeFunction* entry, Value* base, Value* result) {
+    BytecodeFunction* const* functions = interpreter->program->functions;
+    NativeFunction* natives = interpreter->program->natives;
+    Value* globals = interpreter->program->globals;
+    const Value* stack_end = interpreter->stack + INTERPRETER_STACK_SIZE;
+    CallFrame* const frames_begin = interpreter->frames;
+    CallFrame* const frames_end = interpreter->frames + INTERPRETER_MAX_FRAMES;
+
+    if (base + entry->register_count > stack_end) return runtime_error(interpreter, "stack overflow");
+
+    CallFrame* frame = frames_begin;
+    frame->function = entry;
+    frame->base = base;
+
+    const uint32_t* ip = entry->code;
+    const Value* K = entry->constants;
+    Value* R = base;
+    uint32_t instruction;
+
+#ifdef INTERPRETER_COMPUTED_GOTO
+    static const void* const dispatch_table[] = {
+#define OPCODE(name, format) &&op_##name,
+#include "../include/opcodes.def"
+#undef OPCODE
+    };
+#define DISPATCH() do { instruction = *ip++; goto *dispatch_table[BC_OP(instruction)]; } while (0)
+#define CASE(name) op_##name:
+    DISPATCH();
+#else
+#define DISPATCH() break
+#define CASE(name) case OP_##name:
+    for (;;) {
+        instruction = *ip++;
+        switch (BC_OP(instruction)) {
+#endif
+
+    CASE(MOVE) {
+        R[BC_A(instruction)] = R[BC_B(instruction)];
+        DISPATCH();
+    }
+    CASE(LOADK) {
+        R[BC_A(instruction)] = K[BC_BX(instruction)];
+        DISPATCH();
+    }
+    CASE(LOADNIL) {
+        R[BC_A(instruction)] = value_nil();
+        DISPATCH();
+    }
+    CASE(LOADBOOL) {
+        R[BC_A(instruction)] = value_bool(BC_B(instruction) != 0);
+        DISPATCH();
+    }
+    CASE(GETGLOBAL) {
+        R[BC_A(instruction)] = globals[BC_BX(instruction)];
+        DISPATCH();
+    }
+    CASE(SETGLOBAL) {
+        globals[BC_BX(instruction)] = R[BC_A(instruction)];
+        DISPATCH();
+    }
+
+    // 整数同士は高速経路で処理する（オーバーフローは2の補数で折り返す）
+#define ARITH_OP(name, int_expr) \
+    CASE(name) { \
+        const Value* left = &R[BC_B(instruction)]; \
+        const Value* right = &R[BC_C(instruction)]; \
+        if (left->type == VALUE_INT && right->type == VALUE_INT) { \
+            uint64_t a = (uint64_t)left->as.integer; \
+            uint64_t b = (uint64_t)right->as.integer; \
+            R[BC_A(instruction)] = value_int((int64_t)(int_expr)); \
+        } else if (!arith_slow(OP_##name, left, right, &R[BC_A(instruction)])) { \
+            return runtime_error(interpreter, "invalid operands to arithmetic operator"); \
+        } \
+        DISPATCH(); \
+    }
+    ARITH_OP(ADD, a + b)
+    ARITH_OP(SUB, a - b)
+    ARITH_OP(MUL, a * b)
+#undef ARITH_OP
+
+    CASE(DIV)
+    CASE(MOD) {
+        const Value* left = &R[BC_B(instruction)];
+        const Value* right = &R[BC_C(instruction)];
+        OpCode op = (OpCode)BC_OP(instruction);
+        if (left->type == VALUE_INT && right->type == VALUE_INT) {
+            int64_t a = left->as.integer;
+            int64_t b = right->as.integer;
+            if (b == 0) return runtime_error(interpreter, "division by zero");
+            // INT64_MIN / -1 は未定義動作になるので別に扱う
+            if (b == -1) {
+                R[BC_A(instruction)] = value_int(op == OP_DIV ? (int64_t)(0 - (uint64_t)a) : 0);
+            } else {
+                R[BC_A(instruction)] = value_int(op == OP_DIV ? a / b : a % b);
+            }
+        } else if (!arith_slow(op, left, right, &R[BC_A(instruction)])) {
+            return runtime_error(interpreter, "invalid operands to arithmetic operator");
+        }
+        DISPATCH();
+    }
+
+    CASE(EQ) {
+        R[BC_A(instruction)] = value_bool(value_equals(R[BC_B(instruction)], R[BC_C(instruction)]));
+        DISPATCH();
+    }
+    CASE(NE) {
+        R[BC_A(instruction)] = value_bool(!value_equals(R[BC_B(instruction)], R[BC_C(instruction)]));
+        DISPATCH();
+    }
+
+#define COMPARE_OP(name, cmp) \
+    CASE(name) { \
+        const Value* left = &R[BC_B(instruction)]; \
+        const Value* right = &R[BC_C(instruction)]; \
+        if (left->type == VALUE_INT && right->type == VALUE_INT) { \
+            R[BC_A(instruction)] = value_bool(left->as.integer cmp right->as.integer); \
+        } else if (!compare_slow(OP_##name, left, right, &R[BC_A(instruction)])) { \
+            return runtime_error(interpreter, "invalid operands to comparison"); \
+        } \
+        DISPATCH(); \
+    }
+    COMPARE_OP(LT, <)
+    COMPARE_OP(LE, <=)
+#undef COMPARE_OP
+
+    CASE(ADDI) {
+        const Value* left = &R[BC_B(instruction)];
+        Value right = value_int(BC_SC(instruction));
+        if (left->type == VALUE_INT) {
+            R[BC_A(instruction)] = value_int((int64_t)((uint64_t)left->as.integer + (uint64_t)right.as.integer));
+        } else if (!arith_slow(OP_ADD, left, &right, &R[BC_A(instruction)])) {
+            return runtime_error(interpreter, "invalid operands to arithmetic operator");
+        }
+        DISPATCH();
+    }
+
+    // 即値との比較（左右を入れ替えてcompare_slowに渡せるよう演算子を対応させる）
+#define COMPARE_IMMEDIATE_OP(name, cmp, slow_op, swap) \
+    CASE(name) { \
+        const Value* left = &R[BC_B(instruction)]; \
+        if (left->type == VALUE_INT) { \
+            R[BC_A(instruction)] = value_bool(left->as.integer cmp BC_SC(instruction)); \
+        } else { \
+            Value right = value_int(BC_SC(instruction)); \
+            bool ok = swap ? compare_slow(slow_op, &right, left, &R[BC_A(instruction)]) \
+                           : compare_slow(slow_op, left, &right, &R[BC_A(instruction)]); \
+            if (!ok) return runtime_error(interpreter, "invalid operands to comparison"); \
+        } \
+        DISPATCH(); \
+    }
+    COMPARE_IMMEDIATE_OP(LTI, <, OP_LT, false)
+    COMPARE_IMMEDIATE_OP(LEI, <=, OP_LE, false)
+    COMPARE_IMMEDIATE_OP(GTI, >, OP_LT, true)
+    COMPARE_IMMEDIATE_OP(GEI, >=, OP_LE, true)
+#undef COMPARE_IMMEDIATE_OP
+
+    CASE(NEG) {
+        const Value* operand = &R[BC_B(instruction)];
+        if (operand->type == VALUE_INT) {
+            R[BC_A(instruction)] = value_int((int64_t)(0 - (uint64_t)operand->as.integer));
+        } else if (operand->type == VALUE_FLOAT) {
+            R[BC_A(instruction)] = value_float(-operand->as.number);
+        } else {
+            return runtime_error(interpreter, "invalid operand to unary '-'");
+        }
+        DISPATCH();
+    }
+    CASE(NOT) {
+        R[BC_A(instruction)] = value_bool(!value_is_truthy(R[BC_B(instruction)]));
+        DISPATCH();
+    }
+
+    CASE(JMP) {
+        // 後ろ向きのジャンプ（ループ）も関数の熱さに数える
+        if (BC_SBX(instruction) < 0) frame->function->hotness++;
+        ip += BC_SBX(instruction);
+        DISPATCH();
+    }
+    CASE(JMPIF) {
+        if (value_is_truthy(R[BC_A(instruction)])) ip += BC_SBX(instruction);
+        DISPATCH();
+    }
+    CASE(JMPIFNOT) {
+        if (!value_is_truthy(R[BC_A(instruction)])) ip += BC_SBX(instruction);
+        DISPATCH();
+    }
+
+    CASE(CALL) {
+        Value* callee = &R[BC_A(instruction)];
+        size_t argument_count = BC_B(instruction);
+
+        if (callee->type == VALUE_NATIVE) {
+            *callee = natives[callee->as.function](callee + 1, argument_count);
+            DISPATCH();
+        }
+        if (callee->type != VALUE_FUNCTION) return runtime_error(interpreter, "value is not callable");
+
+        // 引数はすでに呼び出し先のR[0]以降に並んでいるのでコピーしない
+        BytecodeFunction* target = functions[callee->as.function];
+        if (argument_count != target->arity) return runtime_error(interpreter, "wrong number of arguments");
+        if (try_native(interpreter, target, callee + 1, (size_t)(frames_end - frame - 1), callee)) DISPATCH();
+        if (frame + 1 == frames_end) return runtime_error(interpreter, "call stack overflow");
+        if (callee + 1 + target->register_count > stack_end) return runtime_error(interpreter, "stack overflow");
+
+        frame->ip = ip;
+        frame++;
+        frame->function = target;
+        frame->base = callee + 1;
+
+        ip = target->code;
+        K = target->constants;
+        R = frame->base;
+        DISPATCH();
+    }
+
+    CASE(RETURN) {
+        Value value = BC_B(instruction) ? R[BC_A(instruction)] : value_nil();
+        if (frame == frames_begin) {
+            if (result) *result = value;
+            return SLANG_SUCCESS;
+        }
+
+        // 戻り値は呼び出し元の関数値のレジスタ（R[-1]）に置く
+        R[-1] = value;
+        frame--;
+        ip = frame->ip;
+        K = frame->function->constants;
+        R = frame->base;
+        DISPATCH();
+    }
+
+#ifndef INTERPRETER_COMPUTED_GOTO
+        default:
+            return runtime_error(interpreter, "invalid instruction");
+        }
+    }
+#endif
+#undef DISPATCH
+#undef CASE
+}
+
+// 一時的な関数（スクリプト本体や式）を実行して破棄する
+static SlangError run_script(Interpreter* interpreter, BytecodeFunction* script, Value* result) {
+    SlangError error = interpreter_run(interpreter, script, interpreter->stack, result);
+    bytecode_function_destroy(script);
+    return error;
+}
+
+static SlangError compile_failed(Interpreter* interpreter, SlangError error) {
+    interpreter->error = interpreter->program->error ? interpreter->program->error : "compilation failed";
+    return error;
+}
+
+// プログラムの実行
+SlangError interpret(Interpreter* interpreter, ASTNode* node) {
+    if (node == NULL) return SLANG_SUCCESS;
+    interpreter->error = NULL;
+
+    ASTNode* const* statements = &node;
+    size_t count = 1;
+    if (node->type == NODE_BLOCK_STATEMENT) {
+        statements = node->data.block_statement.statements;
+        count = node->data.block_statement.statement_count;
+    }
+
+    BytecodeFunction* script;
+    SlangError error = bytecode_compile_script(interpreter->program, statements, count, &script);
+    if (error != SLANG_SUCCESS) return compile_failed(interpreter, error);
+
+    error = run_script(interpreter, script, NULL);
+    if (error != SLANG_SUCCESS) return error;
+
+    // このプログラムでmainを宣言していれば呼び出す
+    const char* main_name = intern_cstr("main");
+    for (size_t i = 0; i < count; i++) {
+        if (statements[i] != NULL && statements[i]->type == NODE_FUNCTION &&
+            statements[i]->data.function.name == main_name) {
+            return interpreter_call(interpreter, main_name, NULL, 0, NULL);
+        }
+    }
+    return SLANG_SUCCESS;
+}
+
+// 式の評価
+SlangError evaluate_expression(Interpreter* interpreter, ASTNode* node, Value* result) {
+    interpreter->error = NULL;
+
+    SlangError error = bytecode_compile_pending(interpreter->program);
+    if (error != SLANG_SUCCESS) return compile_failed(interpreter, error);
+
+    BytecodeFunction* script;
+    error = bytecode_compile_expression(interpreter->program, node, &script);
+    if (error != SLANG_SUCCESS) return compile_failed(interpreter, error);
+    return run_script(interpreter, script, result);
+}
+
+// 文の実行
+SlangError execute_statement(Interpreter* interpreter, ASTNode* node) {
+    return interpret(interpreter, node);
+}
+
+// グローバル変数の宣言（既にあれば値を上書きする）
+bool declare_variable(Interpreter* interpreter, const char* name, Value value) {
+    uint32_t slot;
+    if (!bytecode_declare_global(interpreter->program, intern_cstr(name), &slot)) return false;
+    interpreter->program->globals[slot] = value;
+    return true;
+}
+
+// グローバル変数の取得
+bool get_variable(Interpreter* interpreter, const char* name, Value* value) {
+    uint32_t slot;
+    if (!bytecode_find_global(interpreter->program, intern_cstr(name), &slot)) return false;
+    *value = interpreter->program->globals[slot];
+    return true;
+}
+
+// 関数の宣言（本体は最初の実行前にまとめてコンパイルされる）
+SlangError declare_function(Interpreter* interpreter, const char* name, ASTNode* function_node) {
+    SlangError error = bytecode_declare_function(interpreter->program, intern_cstr(name), function_node, NULL);
+    if (error != SLANG_SUCCESS) return compile_failed(interpreter, error);
+    return SLANG_SUCCESS;
+}
+
+// 関数の取得
+ASTNode* get_function(Interpreter* interpreter, const char* name) {
+    BytecodeFunction* function = bytecode_find_function(interpreter->program, intern_cstr(name));
+    return function ? (ASTNode*)function->source : NULL;
+}
+
+// 組み込み関数の登録
+bool interpreter_register_native(Interpreter* interpreter, const char* name, NativeFunction function) {
+    return bytecode_declare_native(interpreter->program, intern_cstr(name), function);
+}
+
+// 宣言済みの関数を呼び出す
+SlangError interpreter_call(Interpreter* interpreter, const char* name, const Value* args, size_t count, Value* result) {
+    interpreter->error = NULL;
+
+    SlangError error = bytecode_compile_pending(interpreter->program);
+    if (error != SLANG_SUCCESS) return compile_failed(interpreter, error);
+
+    BytecodeFunction* function = bytecode_find_function(interpreter->program, intern_cstr(name));
+    if (function == NULL) return runtime_error(interpreter, "undefined function");
+    if (count != function->arity) return runtime_error(interpreter, "wrong number of arguments");
+
+    // stack[0]は関数値の位置、引数はstack[1]以降
+    Value* base = interpreter->stack + 1;
+    if (count > 0) memcpy(base, args, count * sizeof(Value));
+    Value value;
+    if (try_native(interpreter, function, base, INTERPRETER_MAX_FRAMES, &value)) {
+        if (result) *result = value;
+        return SLANG_SUCCESS;
+    }
+    return interpreter_run(interpreter, function, base, result);
+}
+
+// 最後のエラー
+const char* interpreter_error(const Interpreter* interpreter) {
+    return interpreter->error;
+}
+
+void interpreter_set_jit_threshold(Interpreter* interpreter, unsigned threshold) {
+    interpreter->jit_threshold = threshold;
+}
+
+void interpreter_jit_stats(const Interpreter* interpreter, JitStats* stats) {
+    if (interpreter->jit != NULL) jit_stats(interpreter->jit, stats);
+    else memset(stats, 0, sizeof(JitStats));
+}
@@ -0,0 +1,414 @@
+#include "../include/ir.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IR_INITIAL_CAPACITY 64
+
+// IR関数の作成
+IrFunction* ir_function_create(const char* name) {
+    IrFunction* function = calloc(1, sizeof(IrFunction));
+    if (function == NULL) return NULL;
+    function->name = name;
+    return function;
+}
+
+// IR関数の破棄
+void ir_function_destroy(IrFunction* function) {
+    if (function == NULL) return;
+
+    for (size_t i = 0; i < function->count; i++) {
+        free(function->code[i].args);
+    }
+    free(function->code);
+    free(function->value_types);
+    free(function);
+}
+
+// 新しい仮想レジスタ
+IrValue ir_new_value(IrFunction* function, IrType type) {
+    if (function->failed) return IR_NO_VALUE;
+
+    if (function->value_count == function->value_capacity) {
+        size_t new_capacity = function->value_capacity ? function->value_capacity * 2 : IR_INITIAL_CAPACITY;
+        uint8_t* types = realloc(function->value_types, new_capacity);
+        if (types == NULL) {
+            function->failed = true;
+            return IR_NO_VALUE;
+        }
+        function->value_types = types;
+        function->value_capacity = new_capacity;
+    }
+    function->value_types[function->value_count] = (uint8_t)type;
+    return (IrValue)function->value_count++;
+}
+
+// 新しいラベル
+uint32_t ir_new_label(IrFunction* function) {
+    return function->label_count++;
+}
+
+bool ir_is_comparison(IrOpcode op) {
+    return op >= IR_EQ && op <= IR_GE;
+}
+
+bool ir_is_vector(IrOpcode op) {
+    return op >= IR_VEC_ADD && op <= IR_QUAT_MUL;
+}
+
+bool ir_is_call(IrOpcode op) {
+    return op == IR_CALL || op == IR_ALLOC || op == IR_DROP;
+}
+
+// 命令の追加（失敗したらNULL）
+static IrInstruction* ir_append(IrFunction* function, IrOpcode op, IrType type) {
+    if (function->failed) return NULL;
+
+    if (function->count == function->capacity) {
+        size_t new_capacity = function->capacity ? function->capacity * 2 : IR_INITIAL_CAPACITY;
+        IrInstruction* code = realloc(function->code, new_capacity * sizeof(IrInstruction));
+        if (code == NULL) {
+            function->failed = true;
+            return NULL;
+        }
+        function->code = code;
+        function->capacity = new_capacity;
+    }
+
+    IrInstruction* instruction = &function->code[function->count++];
+    memset(instruction, 0, sizeof(IrInstruction));
+    instruction->op = (uint8_t)op;
+    instruction->type = (uint8_t)type;
+    instruction->dest = IR_NO_VALUE;
+    instruction->a = IR_NO_VALUE;
+    instruction->b = IR_NO_VALUE;
+    return instruction;
+}
+
+// 結果を持つ命令の追加
+static IrValue ir_append_value(IrFunction* function, IrOpcode op, IrType type, IrType result_type, IrInstruction** out) {
+    IrValue dest = ir_new_value(function, result_type);
+    IrInstruction* instruction = ir_append(function, op, type);
+    if (dest == IR_NO_VALUE || instruction == NULL) {
+        *out = NULL;
+        return IR_NO_VALUE;
+    }
+    instruction->dest = dest;
+    *out = instruction;
+    return dest;
+}
+
+static IrType ir_value_type(const IrFunction* function, IrValue value) {
+    return value < function->value_count ? (IrType)function->value_types[value] : IR_INT;
+}
+
+IrValue ir_emit_const_int(IrFunction* function, int64_t value) {
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, IR_CONST, IR_INT, IR_INT, &instruction);
+    if (instruction) instruction->imm.integer = value;
+    return dest;
+}
+
+IrValue ir_emit_const_float(IrFunction* function, double value) {
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, IR_CONST, IR_FLOAT, IR_FLOAT, &instruction);
+    if (instruction) instruction->imm.number = value;
+    return dest;
+}
+
+IrValue ir_emit_address(IrFunction* function, const char* symbol) {
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, IR_ADDRESS, IR_INT, IR_INT, &instruction);
+    if (instruction) instruction->symbol = symbol;
+    return dest;
+}
+
+IrValue ir_emit_param(IrFunction* function, uint32_t index, IrType type) {
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, IR_PARAM, type, type, &instruction);
+    if (instruction) instruction->imm.integer = index;
+    if (index + 1 > function->param_count) function->param_count = index + 1;
+    return dest;
+}
+
+void ir_emit_move(IrFunction* function, IrValue dest, IrValue src) {
+    IrInstruction* instruction = ir_append(function, IR_MOVE, ir_value_type(function, dest));
+    if (instruction == NULL) return;
+    instruction->dest = dest;
+    instruction->a = src;
+}
+
+IrValue ir_emit_load_global(IrFunction* function, const char* symbol, IrType type) {
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, IR_LOAD_GLOBAL, type, type, &instruction);
+    if (instruction) instruction->symbol = symbol;
+    return dest;
+}
+
+void ir_emit_store_global(IrFunction* function, const char* symbol, IrValue value) {
+    IrInstruction* instruction = ir_append(function, IR_STORE_GLOBAL, ir_value_type(function, value));
+    if (instruction == NULL) return;
+    instruction->a = value;
+    instruction->symbol = symbol;
+}
+
+IrValue ir_emit_binary(IrFunction* function, IrOpcode op, IrValue a, IrValue b) {
+    IrType type = ir_value_type(function, a);
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, op, type, ir_is_comparison(op) ? IR_INT : type, &instruction);
+    if (instruction) {
+        instruction->a = a;
+        instruction->b = b;
+    }
+    return dest;
+}
+
+IrValue ir_emit_unary(IrFunction* function, IrOpcode op, IrValue a) {
+    IrType type = ir_value_type(function, a);
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, op, type, op == IR_NOT ? IR_INT : op == IR_INT_TO_FLOAT ? IR_FLOAT : type, &instruction);
+    if (instruction) instruction->a = a;
+    return dest;
+}
+
+void ir_emit_label(IrFunction* function, uint32_t label) {
+    IrInstruction* instruction = ir_append(function, IR_LABEL, IR_INT);
+    if (instruction) instruction->imm.label = label;
+}
+
+void ir_emit_jump(IrFunction* function, uint32_t label) {
+    IrInstruction* instruction = ir_append(function, IR_JUMP, IR_INT);
+    if (instruction) instruction->imm.label = label;
+}
+
+void ir_emit_branch_false(IrFunction* function, IrValue condition, uint32_t label) {
+    IrInstruction* instruction = ir_append(function, IR_BRANCH_FALSE, IR_INT);
+    if (instruction == NULL) return;
+    instruction->a = condition;
+    instruction->imm.label = label;
+}
+
+IrValue ir_emit_call(IrFunction* function, const char* symbol, IrType type, const IrValue* args, uint32_t arg_count) {
+    IrValue* copy = NULL;
+    if (arg_count > 0) {
+        copy = malloc(arg_count * sizeof(IrValue));
+        if (copy == NULL) {
+            function->failed = true;
+            return IR_NO_VALUE;
+        }
+        memcpy(copy, args, arg_count * sizeof(IrValue));
+    }
+
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, IR_CALL, type, type, &instruction);
+    if (instruction == NULL) {
+        free(copy);
+        return IR_NO_VALUE;
+    }
+    instruction->symbol = symbol;
+    instruction->args = copy;
+    instruction->arg_count = arg_count;
+    return dest;
+}
+
+void ir_emit_return(IrFunction* function, IrValue value) {
+    IrType type = value == IR_NO_VALUE ? IR_INT : ir_value_type(function, value);
+    IrInstruction* instruction = ir_append(function, IR_RETURN, type);
+    if (instruction) instruction->a = value;
+}
+
+IrValue ir_emit_alloc(IrFunction* function, uint32_t size) {
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, IR_ALLOC, IR_INT, IR_INT, &instruction);
+    if (instruction) instruction->imm.integer = size;
+    return dest;
+}
+
+void ir_emit_drop(IrFunction* function, IrValue block) {
+    IrInstruction* instruction = ir_append(function, IR_DROP, IR_INT);
+    if (instruction) instruction->a = block;
+}
+
+IrValue ir_emit_load(IrFunction* function, IrValue block, uint32_t offset) {
+    IrInstruction* instruction;
+    IrValue dest = ir_append_value(function, IR_LOAD, IR_FLOAT, IR_FLOAT, &instruction);
+    if (instruction) {
+        instruction->a = block;
+        instruction->imm.integer = offset;
+    }
+    return dest;
+}
+
+void ir_emit_store(IrFunction* function, IrValue block, uint32_t offset, IrValue value) {
+    IrInstruction* instruction = ir_append(function, IR_STORE, IR_FLOAT);
+    if (instruction == NULL) return;
+    instruction->a = block;
+    instruction->b = value;
+    instruction->imm.integer = offset;
+}
+
+bool ir_mark_borrowed(IrFunction* function, uint32_t argument) {
+    if (function->failed || function->count == 0) return false;
+    IrInstruction* last = &function->code[function->count - 1];
+    if (last->op != IR_CALL || argument >= last->arg_count || argument >= 64) return false;
+    last->imm.integer = (int64_t)((uint64_t)last->imm.integer | ((uint64_t)1 << argument));
+    return true;
+}
+
+// ベクトル演算
+static void ir_append_vector(IrFunction* function, IrOpcode op, IrValue dst, IrValue a, IrValue b, uint32_t count) {
+    IrValue* target = malloc(sizeof(IrValue));
+    if (target == NULL) {
+        function->failed = true;
+        return;
+    }
+    IrInstruction* instruction = ir_append(function, op, IR_FLOAT);
+    if (instruction == NULL) {
+        free(target);
+        return;
+    }
+    *target = dst;
+    instruction->a = a;
+    instruction->b = b;
+    instruction->args = target;
+    instruction->arg_count = 1;
+    instruction->imm.integer = count;
+}
+
+// 長いベクトルはIR_VECTOR_MAX_ELEMENTSずつに分ける（区切りは16バイト境界に揃う）
+static IrValue ir_offset(IrFunction* function, IrValue pointer, uint32_t elements) {
+    if (elements == 0) return pointer;
+    return ir_emit_binary(function, IR_ADD, pointer, ir_emit_const_int(function, (int64_t)elements * 8));
+}
+
+void ir_emit_vector_binary(IrFunction* function, IrOpcode op, IrValue dst, IrValue a, IrValue b, uint32_t count) {
+    for (uint32_t done = 0; done < count; done += IR_VECTOR_MAX_ELEMENTS) {
+        uint32_t chunk = count - done < IR_VECTOR_MAX_ELEMENTS ? count - done : IR_VECTOR_MAX_ELEMENTS;
+        ir_append_vector(function, op, ir_offset(function, dst, done), ir_offset(function, a, done),
+                         ir_offset(function, b, done), chunk);
+    }
+}
+
+void ir_emit_vector_scale(IrFunction* function, IrValue dst, IrValue a, IrValue scale, uint32_t count) {
+    for (uint32_t done = 0; done < count; done += IR_VECTOR_MAX_ELEMENTS) {
+        uint32_t chunk = count - done < IR_VECTOR_MAX_ELEMENTS ? count - done : IR_VECTOR_MAX_ELEMENTS;
+        ir_append_vector(function, IR_VEC_SCALE, ir_offset(function, dst, done), ir_offset(function, a, done),
+                         scale, chunk);
+    }
+}
+
+void ir_emit_vector_copy(IrFunction* function, IrValue dst, IrValue a, uint32_t count) {
+    for (uint32_t done = 0; done < count; done += IR_VECTOR_MAX_ELEMENTS) {
+        uint32_t chunk = count - done < IR_VECTOR_MAX_ELEMENTS ? count - done : IR_VECTOR_MAX_ELEMENTS;
+        ir_append_vector(function, IR_VEC_COPY, ir_offset(function, dst, done), ir_offset(function, a, done),
+                         IR_NO_VALUE, chunk);
+    }
+}
+
+IrValue ir_emit_vector_dot(IrFunction* function, IrValue a, IrValue b, uint32_t count) {
+    IrValue sum = IR_NO_VALUE;
+    for (uint32_t done = 0; done < count || sum == IR_NO_VALUE; done += IR_VECTOR_MAX_ELEMENTS) {
+        uint32_t chunk = count - done < IR_VECTOR_MAX_ELEMENTS ? count - done : IR_VECTOR_MAX_ELEMENTS;
+        IrInstruction* instruction;
+        IrValue partial = ir_append_value(function, IR_VEC_DOT, IR_FLOAT, IR_FLOAT, &instruction);
+        if (instruction == NULL) return IR_NO_VALUE;
+        instruction->a = ir_offset(function, a, done);
+        instruction->b = ir_offset(function, b, done);
+        instruction->imm.integer = chunk;
+        sum = sum == IR_NO_VALUE ? partial : ir_emit_binary(function, IR_ADD, sum, partial);
+    }
+    return sum;
+}
+
+void ir_emit_mat4_mul(IrFunction* function, IrValue dst, IrValue a, IrValue b) {
+    ir_append_vector(function, IR_MAT4_MUL, dst, a, b, 16);
+}
+
+void ir_emit_quat_mul(IrFunction* function, IrValue dst, IrValue a, IrValue b) {
+    ir_append_vector(function, IR_QUAT_MUL, dst, a, b, 4);
+}
+
+// 直前の命令が一時値tempを作ったばかりなら、その結果の書き込み先をdestに替える
+bool ir_retarget_last(IrFunction* function, IrValue temp, IrValue dest) {
+    if (function->failed || function->count == 0) return false;
+    if (temp == IR_NO_VALUE || temp + 1 != function->value_count) return false;
+
+    IrInstruction* last = &function->code[function->count - 1];
+    if (last->dest != temp || last->op == IR_PARAM) return false;
+    if (ir_value_type(function, temp) != ir_value_type(function, dest)) return false;
+
+    last->dest = dest;
+    return true;
+}
+
+// デバッグ用の出力
+static const char* const ir_opcode_names[] = {
+    "const", "address", "param", "move", "load_global", "store_global",
+    "add", "sub", "mul", "div", "mod", "neg", "not", "int_to_float",
+    "eq", "ne", "lt", "le", "gt", "ge",
+    "label", "jump", "branch_false", "call", "return",
+    "vec_add", "vec_sub", "vec_mul", "vec_div", "vec_scale", "vec_copy", "vec_dot", "mat4_mul", "quat_mul",
+    "alloc", "stack_alloc", "drop", "load", "store",
+    "phi", "nop",
+};
+
+static void ir_dump_value(FILE* out, const IrFunction* function, IrValue value) {
+    if (value == IR_NO_VALUE) return;
+    fprintf(out, " %c%u", ir_value_type(function, value) == IR_FLOAT ? 'f' : 'v', value);
+}
+
+void ir_dump(FILE* out, const IrFunction* function) {
+    fprintf(out, "ir %s (%u params, %zu values)\n", function->name ? function->name : "<anonymous>",
+            function->param_count, function->value_count);
+
+    for (size_t i = 0; i < function->count; i++) {
+        const IrInstruction* instruction = &function->code[i];
+        if (instruction->op == IR_LABEL) {
+            fprintf(out, ".L%u:\n", instruction->imm.label);
+            continue;
+        }
+
+        fprintf(out, "%4zu  %s", i, ir_opcode_names[instruction->op]);
+        ir_dump_value(out, function, instruction->dest);
+        ir_dump_value(out, function, instruction->a);
+        ir_dump_value(out, function, instruction->b);
+        for (uint32_t j = 0; j < instruction->arg_count; j++) {
+            ir_dump_value(out, function, instruction->args[j]);
+        }
+
+        switch (instruction->op) {
+            case IR_CONST:
+                if (instruction->type == IR_FLOAT) {
+                    fprintf(out, " %g", instruction->imm.number);
+                } else {
+                    fprintf(out, " %" PRId64, instruction->imm.integer);
+                }
+                break;
+            case IR_PARAM:
+            case IR_VEC_ADD:
+            case IR_VEC_SUB:
+            case IR_VEC_MUL:
+            case IR_VEC_DIV:
+            case IR_VEC_SCALE:
+            case IR_VEC_COPY:
+            case IR_VEC_DOT:
+            case IR_ALLOC:
+            case IR_STACK_ALLOC:
+            case IR_LOAD:
+            case IR_STORE:
+                fprintf(out, " #%" PRId64, instruction->imm.integer);
+                break;
+            case IR_CALL:
+                if (instruction->imm.integer != 0) fprintf(out, " borrow=%#" PRIx64, (uint64_t)instruction->imm.integer);
+                break;
+            case IR_JUMP:
+            case IR_BRANCH_FALSE:
+                fprintf(out, " .L%u", instruction->imm.label);
+                break;
+            default:
+                break;
+        }
+        if (instruction->symbol) fprintf(out, " %s", instruction->symbol);
+        fputc('\n', out);
+    }
+}
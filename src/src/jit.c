@@ -0,0 +1,721 @@
+#include "../include/jit.h"
+#include "../include/asm_writer.h"
+#include "../include/ir.h"
+#include "../include/optimizer.h"
+#include "../include/regalloc.h"
+#include "../include/x86_emitter.h"
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED 1
+#endif
+
+// 機械語から読み書きするデータ（領域の最初のページに置く）
+#define JIT_BAILOUT_SYMBOL "__jit_bailout"   // 0以外なら呼び出し全体を捨てる
+#define JIT_DEPTH_SYMBOL "__jit_depth"       // 残りの呼び出しフレームの数
+#define JIT_OPT_LEVEL OPT_MAX_LEVEL
+#define JIT_MAX_NESTING 64                   // 呼び出し先を先にコンパイルする入れ子の深さ
+
+struct Jit {
+    BytecodeProgram* program;
+    uint8_t* region;
+    size_t page_size;
+    size_t used;                     // 領域の先頭からの使用量（最初のページはデータ）
+    volatile int64_t* data;          // [0]が__jit_bailout、[1]が__jit_depth
+    BytecodeFunction* compiling[JIT_MAX_NESTING];
+    size_t compiling_count;
+    JitStats stats;
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+Jit* jit_create(BytecodeProgram* program) {
+#ifdef JIT_SUPPORTED
+    Jit* jit = calloc(1, sizeof(Jit));
+    if (jit == NULL) return NULL;
+    jit->program = program;
+    jit->page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    void* region = mmap(NULL, JIT_CODE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+    jit->region = region;
+    if (mprotect(jit->region, jit->page_size, PROT_READ | PROT_WRITE) != 0) {
+        munmap(region, JIT_CODE_SIZE);
+        free(jit);
+        return NULL;
+    }
+    jit->data = (volatile int64_t*)jit->region;
+    jit->used = jit->page_size;
+    return jit;
+#else
+    (void)program;
+    return NULL;
+#endif
+}
+
+void jit_destroy(Jit* jit) {
+    if (jit == NULL) return;
+    munmap(jit->region, JIT_CODE_SIZE);
+    free(jit);
+}
+
+void jit_stats(const Jit* jit, JitStats* stats) {
+    *stats = jit->stats;
+    stats->code_bytes = jit->used - jit->page_size;
+}
+
+// 種類の解析
+// レジスタごとに命令の前で入っている値の種類を求める。関数はどの関数かまで持つ（呼び出し先を決めるため）。
+// 合流で種類が食い違ったレジスタはKIND_ANYになり、まだ書かれていないもの（KIND_UNSET）と同じく読めば扱えない
+typedef uint32_t JitKind;
+enum { KIND_UNSET, KIND_NIL, KIND_INT, KIND_BOOL, KIND_ANY, KIND_FUNCTION };
+#define KIND_TAG(kind) ((kind) & 7)
+#define KIND_FUNCTION_OF(index) (KIND_FUNCTION | (JitKind)(index) << 3)
+#define KIND_INDEX(kind) ((kind) >> 3)
+
+typedef struct {
+    Jit* jit;
+    BytecodeFunction* function;
+    size_t registers;
+    JitKind* states;           // code_count × registers
+    bool* visited;
+    bool* queued;
+    size_t* worklist;
+    size_t worklist_count;
+    JitKind result;            // 戻り値の種類（KIND_UNSETならまだ戻らない）
+    JitKind self_result;       // 自分自身の呼び出しの戻り値と仮定する種類
+    bool recursive;
+} Analysis;
+
+static bool jit_compile_nested(Jit* jit, BytecodeFunction* function);
+
+static bool readable(JitKind kind) {
+    return KIND_TAG(kind) != KIND_UNSET && KIND_TAG(kind) != KIND_ANY;
+}
+
+static JitKind kind_of_value_type(uint8_t type) {
+    return type == VALUE_INT ? KIND_INT : type == VALUE_BOOL ? KIND_BOOL : KIND_NIL;
+}
+
+// 真偽が静的に決まればtrue（truthyに結果）
+static bool static_truth(JitKind kind, bool* truthy) {
+    if (kind == KIND_BOOL) return false;
+    *truthy = kind != KIND_NIL;
+    return true;
+}
+
+static bool merge_state(Analysis* analysis, size_t target, const JitKind* kinds) {
+    if (target >= analysis->function->code_count) return false;
+    JitKind* state = analysis->states + target * analysis->registers;
+    bool changed = false;
+    if (!analysis->visited[target]) {
+        memcpy(state, kinds, analysis->registers * sizeof(JitKind));
+        analysis->visited[target] = true;
+        changed = true;
+    } else {
+        for (size_t r = 0; r < analysis->registers; r++) {
+            if (state[r] != kinds[r] && state[r] != KIND_ANY) {
+                state[r] = KIND_ANY;
+                changed = true;
+            }
+        }
+    }
+    if (changed && !analysis->queued[target]) {
+        analysis->queued[target] = true;
+        analysis->worklist[analysis->worklist_count++] = target;
+    }
+    return true;
+}
+
+static bool jump_target(const BytecodeFunction* function, size_t index, size_t* target) {
+    int64_t destination = (int64_t)index + 1 + BC_SBX(function->code[index]);
+    if (destination < 0 || (size_t)destination >= function->code_count) return false;
+    *target = (size_t)destination;
+    return true;
+}
+
+// 命令1つの種類の変化。kindsは命令の前の種類で、命令の後の種類に書き換える
+static bool analyze_instruction(Analysis* analysis, size_t index, JitKind* kinds, bool* falls_through,
+                                bool* jumps) {
+    const BytecodeFunction* function = analysis->function;
+    const BytecodeProgram* program = analysis->jit->program;
+    uint32_t instruction = function->code[index];
+    uint32_t a = BC_A(instruction), b = BC_B(instruction), c = BC_C(instruction);
+    size_t registers = analysis->registers;
+    *falls_through = true;
+    *jumps = false;
+
+    if (a >= registers) return false;
+    switch ((OpCode)BC_OP(instruction)) {
+        case OP_MOVE:
+            if (b >= registers || !readable(kinds[b])) return false;
+            kinds[a] = kinds[b];
+            return true;
+        case OP_LOADK: {
+            if (BC_BX(instruction) >= function->constant_count) return false;
+            Value constant = function->constants[BC_BX(instruction)];
+            if (constant.type == VALUE_INT) {
+                kinds[a] = KIND_INT;
+            } else if (constant.type == VALUE_FUNCTION && constant.as.function < program->function_count &&
+                       program->functions[constant.as.function]->compiled) {
+                kinds[a] = KIND_FUNCTION_OF(constant.as.function);
+            } else {
+                return false;
+            }
+            return true;
+        }
+        case OP_LOADNIL: kinds[a] = KIND_NIL; return true;
+        case OP_LOADBOOL: kinds[a] = KIND_BOOL; return true;
+        case OP_GETGLOBAL:
+        case OP_SETGLOBAL:
+            return false;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+            if (b >= registers || c >= registers || kinds[b] != KIND_INT || kinds[c] != KIND_INT) return false;
+            kinds[a] = KIND_INT;
+            return true;
+        case OP_EQ:
+        case OP_NE:
+            if (b >= registers || c >= registers || !readable(kinds[b]) || !readable(kinds[c])) return false;
+            kinds[a] = KIND_BOOL;
+            return true;
+        case OP_LT:
+        case OP_LE:
+            if (b >= registers || c >= registers || kinds[b] != KIND_INT || kinds[c] != KIND_INT) return false;
+            kinds[a] = KIND_BOOL;
+            return true;
+        case OP_ADDI:
+        case OP_LTI:
+        case OP_LEI:
+        case OP_GTI:
+        case OP_GEI:
+            if (b >= registers || kinds[b] != KIND_INT) return false;
+            kinds[a] = BC_OP(instruction) == OP_ADDI ? KIND_INT : KIND_BOOL;
+            return true;
+        case OP_NEG:
+            if (b >= registers || kinds[b] != KIND_INT) return false;
+            kinds[a] = KIND_INT;
+            return true;
+        case OP_NOT:
+            if (b >= registers || !readable(kinds[b])) return false;
+            kinds[a] = KIND_BOOL;
+            return true;
+
+        case OP_JMP:
+            *falls_through = false;
+            *jumps = true;
+            return true;
+        case OP_JMPIF:
+        case OP_JMPIFNOT: {
+            if (!readable(kinds[a])) return false;
+            bool truthy;
+            if (static_truth(kinds[a], &truthy)) {
+                *jumps = truthy == (BC_OP(instruction) == OP_JMPIF);
+                *falls_through = !*jumps;
+            } else {
+                *jumps = true;
+            }
+            return true;
+        }
+
+        case OP_CALL: {
+            if (KIND_TAG(kinds[a]) != KIND_FUNCTION || a + 1 + b > registers) return false;
+            BytecodeFunction* callee = program->functions[KIND_INDEX(kinds[a])];
+            if (callee->arity != b) return false;
+            for (uint32_t i = 0; i < b; i++) {
+                if (kinds[a + 1 + i] != KIND_INT) return false;
+            }
+            JitKind result;
+            if (callee == function) {
+                analysis->recursive = true;
+                result = analysis->self_result;
+            } else {
+                if (!jit_compile_nested(analysis->jit, callee)) return false;
+                result = kind_of_value_type(callee->native_result);
+            }
+            // 呼び出し先のフレームが引数のレジスタから先を使う
+            kinds[a] = result;
+            for (size_t r = a + 1; r < registers; r++) kinds[r] = KIND_UNSET;
+            return true;
+        }
+
+        case OP_RETURN: {
+            JitKind result = KIND_NIL;
+            if (b != 0) {
+                result = kinds[a];
+                if (result != KIND_INT && result != KIND_BOOL && result != KIND_NIL) return false;
+            }
+            if (analysis->result != KIND_UNSET && analysis->result != result) return false;
+            analysis->result = result;
+            *falls_through = false;
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+static bool analyze(Analysis* analysis) {
+    const BytecodeFunction* function = analysis->function;
+    size_t registers = analysis->registers;
+    memset(analysis->visited, 0, function->code_count * sizeof(bool));
+    memset(analysis->queued, 0, function->code_count * sizeof(bool));
+    analysis->worklist_count = 0;
+    analysis->result = KIND_UNSET;
+
+    JitKind kinds[UINT8_MAX + 1];
+    for (size_t r = 0; r < registers; r++) kinds[r] = r < function->arity ? KIND_INT : KIND_UNSET;
+    if (!merge_state(analysis, 0, kinds)) return false;
+
+    while (analysis->worklist_count > 0) {
+        size_t index = analysis->worklist[--analysis->worklist_count];
+        analysis->queued[index] = false;
+        memcpy(kinds, analysis->states + index * registers, registers * sizeof(JitKind));
+
+        bool falls_through, jumps;
+        if (!analyze_instruction(analysis, index, kinds, &falls_through, &jumps)) return false;
+        size_t target;
+        if (jumps && (!jump_target(function, index, &target) || !merge_state(analysis, target, kinds))) return false;
+        if (falls_through && !merge_state(analysis, index + 1, kinds)) return false;
+    }
+    return analysis->result != KIND_UNSET;
+}
+
+// IRへの変換
+// バイトコードのレジスタをそれぞれ1つのIRの値にする（真偽値は0と1、nilと関数は値を持たない）
+typedef struct {
+    const Analysis* analysis;
+    IrFunction* ir;
+    IrValue* registers;
+    uint32_t* labels;          // 命令の前のラベル（UINT32_MAXならなし）
+    uint32_t bail;
+    BytecodeFunction** callees;
+    size_t callee_count;
+    size_t callee_capacity;
+} Lowering;
+
+static void set_register(Lowering* lowering, uint32_t reg, IrValue value) {
+    if (!ir_retarget_last(lowering->ir, value, lowering->registers[reg])) {
+        ir_emit_move(lowering->ir, lowering->registers[reg], value);
+    }
+}
+
+static IrValue constant(Lowering* lowering, int64_t value) {
+    return ir_emit_const_int(lowering->ir, value);
+}
+
+// conditionが0なら脱出する
+static void bail_unless(Lowering* lowering, IrValue condition) {
+    ir_emit_branch_false(lowering->ir, condition, lowering->bail);
+}
+
+static bool add_callee(Lowering* lowering, BytecodeFunction* callee) {
+    for (size_t i = 0; i < lowering->callee_count; i++) {
+        if (lowering->callees[i] == callee) return true;
+    }
+    if (lowering->callee_count == lowering->callee_capacity) {
+        size_t capacity = lowering->callee_capacity ? lowering->callee_capacity * 2 : 8;
+        BytecodeFunction** callees = realloc(lowering->callees, capacity * sizeof(BytecodeFunction*));
+        if (callees == NULL) return false;
+        lowering->callees = callees;
+        lowering->callee_capacity = capacity;
+    }
+    lowering->callees[lowering->callee_count++] = callee;
+    return true;
+}
+
+// 整数の除算（0なら脱出し、INT64_MIN / -1 はインタプリタと同じく折り返す）
+static void lower_division(Lowering* lowering, IrOpcode op, uint32_t a, IrValue left, IrValue right) {
+    IrFunction* ir = lowering->ir;
+    bail_unless(lowering, ir_emit_binary(ir, IR_NE, right, constant(lowering, 0)));
+    uint32_t minus_one = ir_new_label(ir);
+    uint32_t done = ir_new_label(ir);
+    ir_emit_branch_false(ir, ir_emit_binary(ir, IR_NE, right, constant(lowering, -1)), minus_one);
+    set_register(lowering, a, ir_emit_binary(ir, op, left, right));
+    ir_emit_jump(ir, done);
+    ir_emit_label(ir, minus_one);
+    set_register(lowering, a, op == IR_DIV ? ir_emit_unary(ir, IR_NEG, left) : constant(lowering, 0));
+    ir_emit_label(ir, done);
+}
+
+static void lower_equality(Lowering* lowering, uint32_t a, JitKind left_kind, JitKind right_kind, IrValue left,
+                           IrValue right, bool negate) {
+    if (left_kind == right_kind && (left_kind == KIND_INT || left_kind == KIND_BOOL)) {
+        set_register(lowering, a, ir_emit_binary(lowering->ir, negate ? IR_NE : IR_EQ, left, right));
+        return;
+    }
+    // nil同士と同じ関数は等しく、種類の違う値は等しくない
+    bool equal = left_kind == right_kind && KIND_TAG(left_kind) != KIND_INT && KIND_TAG(left_kind) != KIND_BOOL;
+    set_register(lowering, a, constant(lowering, equal != negate));
+}
+
+static bool lower_instruction(Lowering* lowering, size_t index) {
+    const Analysis* analysis = lowering->analysis;
+    const BytecodeFunction* function = analysis->function;
+    const BytecodeProgram* program = analysis->jit->program;
+    const JitKind* kinds = analysis->states + index * analysis->registers;
+    IrFunction* ir = lowering->ir;
+    IrValue* R = lowering->registers;
+    uint32_t instruction = function->code[index];
+    uint32_t a = BC_A(instruction), b = BC_B(instruction), c = BC_C(instruction);
+    size_t target;
+
+    switch ((OpCode)BC_OP(instruction)) {
+        case OP_MOVE:
+            if (a != b && (kinds[b] == KIND_INT || kinds[b] == KIND_BOOL)) ir_emit_move(ir, R[a], R[b]);
+            break;
+        case OP_LOADK: {
+            Value value = function->constants[BC_BX(instruction)];
+            if (value.type == VALUE_INT) set_register(lowering, a, constant(lowering, value.as.integer));
+            break;
+        }
+        case OP_LOADNIL:
+            break;
+        case OP_LOADBOOL:
+            set_register(lowering, a, constant(lowering, b != 0));
+            break;
+
+        case OP_ADD: set_register(lowering, a, ir_emit_binary(ir, IR_ADD, R[b], R[c])); break;
+        case OP_SUB: set_register(lowering, a, ir_emit_binary(ir, IR_SUB, R[b], R[c])); break;
+        case OP_MUL: set_register(lowering, a, ir_emit_binary(ir, IR_MUL, R[b], R[c])); break;
+        case OP_DIV: lower_division(lowering, IR_DIV, a, R[b], R[c]); break;
+        case OP_MOD: lower_division(lowering, IR_MOD, a, R[b], R[c]); break;
+        case OP_EQ: lower_equality(lowering, a, kinds[b], kinds[c], R[b], R[c], false); break;
+        case OP_NE: lower_equality(lowering, a, kinds[b], kinds[c], R[b], R[c], true); break;
+        case OP_LT: set_register(lowering, a, ir_emit_binary(ir, IR_LT, R[b], R[c])); break;
+        case OP_LE: set_register(lowering, a, ir_emit_binary(ir, IR_LE, R[b], R[c])); break;
+
+        case OP_ADDI:
+            set_register(lowering, a, ir_emit_binary(ir, IR_ADD, R[b], constant(lowering, BC_SC(instruction))));
+            break;
+        case OP_LTI:
+        case OP_LEI:
+        case OP_GTI:
+        case OP_GEI: {
+            static const IrOpcode comparisons[] = { IR_LT, IR_LE, IR_GT, IR_GE };
+            IrOpcode op = comparisons[BC_OP(instruction) - OP_LTI];
+            set_register(lowering, a, ir_emit_binary(ir, op, R[b], constant(lowering, BC_SC(instruction))));
+            break;
+        }
+        case OP_NEG:
+            set_register(lowering, a, ir_emit_unary(ir, IR_NEG, R[b]));
+            break;
+        case OP_NOT: {
+            bool truthy;
+            if (static_truth(kinds[b], &truthy)) set_register(lowering, a, constant(lowering, !truthy));
+            else set_register(lowering, a, ir_emit_unary(ir, IR_NOT, R[b]));
+            break;
+        }
+
+        case OP_JMP:
+            if (!jump_target(function, index, &target)) return false;
+            ir_emit_jump(ir, lowering->labels[target]);
+            break;
+        case OP_JMPIF:
+        case OP_JMPIFNOT: {
+            if (!jump_target(function, index, &target)) return false;
+            bool jump_if_true = BC_OP(instruction) == OP_JMPIF;
+            bool truthy;
+            if (static_truth(kinds[a], &truthy)) {
+                if (truthy == jump_if_true) ir_emit_jump(ir, lowering->labels[target]);
+            } else if (jump_if_true) {
+                ir_emit_branch_false(ir, ir_emit_binary(ir, IR_EQ, R[a], constant(lowering, 0)), lowering->labels[target]);
+            } else {
+                ir_emit_branch_false(ir, R[a], lowering->labels[target]);
+            }
+            break;
+        }
+
+        case OP_CALL: {
+            BytecodeFunction* callee = program->functions[KIND_INDEX(kinds[a])];
+            if (callee != function && !add_callee(lowering, callee)) return false;
+            IrValue result = ir_emit_call(ir, callee->name, IR_INT, R + a + 1, b);
+            set_register(lowering, a, result);
+            // 呼び出し先が脱出したらこちらも脱出する
+            IrValue bailout = ir_emit_load_global(ir, JIT_BAILOUT_SYMBOL, IR_INT);
+            bail_unless(lowering, ir_emit_binary(ir, IR_EQ, bailout, constant(lowering, 0)));
+            break;
+        }
+
+        case OP_RETURN: {
+            bool has_value = b != 0 && (kinds[a] == KIND_INT || kinds[a] == KIND_BOOL);
+            IrValue value = has_value ? R[a] : constant(lowering, 0);
+            IrValue depth = ir_emit_load_global(ir, JIT_DEPTH_SYMBOL, IR_INT);
+            ir_emit_store_global(ir, JIT_DEPTH_SYMBOL, ir_emit_binary(ir, IR_ADD, depth, constant(lowering, 1)));
+            ir_emit_return(ir, value);
+            break;
+        }
+
+        default:
+            return false;
+    }
+    return !ir->failed;
+}
+
+static IrFunction* lower(Lowering* lowering) {
+    const Analysis* analysis = lowering->analysis;
+    const BytecodeFunction* function = analysis->function;
+    IrFunction* ir = ir_function_create(function->name);
+    if (ir == NULL) return NULL;
+    ir->priority = function->priority;
+    lowering->ir = ir;
+
+    for (size_t r = 0; r < analysis->registers; r++) {
+        lowering->registers[r] = r < function->arity ? ir_emit_param(ir, (uint32_t)r, IR_INT) : ir_new_value(ir, IR_INT);
+    }
+    for (size_t i = 0; i < function->code_count; i++) lowering->labels[i] = UINT32_MAX;
+    for (size_t i = 0; i < function->code_count; i++) {
+        OpCode op = (OpCode)BC_OP(function->code[i]);
+        size_t target;
+        if (analysis->visited[i] && (op == OP_JMP || op == OP_JMPIF || op == OP_JMPIFNOT) &&
+            jump_target(function, i, &target) && lowering->labels[target] == UINT32_MAX) {
+            lowering->labels[target] = ir_new_label(ir);
+        }
+    }
+    lowering->bail = ir_new_label(ir);
+
+    // 呼び出しフレームを1つ使う（足りなければ脱出する）
+    IrValue depth = ir_emit_load_global(ir, JIT_DEPTH_SYMBOL, IR_INT);
+    IrValue remaining = ir_emit_binary(ir, IR_SUB, depth, constant(lowering, 1));
+    ir_emit_store_global(ir, JIT_DEPTH_SYMBOL, remaining);
+    bail_unless(lowering, ir_emit_binary(ir, IR_GE, remaining, constant(lowering, 0)));
+
+    for (size_t i = 0; i < function->code_count; i++) {
+        if (lowering->labels[i] != UINT32_MAX) ir_emit_label(ir, lowering->labels[i]);
+        if (!analysis->visited[i]) continue;
+        if (!lower_instruction(lowering, i)) {
+            ir_function_destroy(ir);
+            return NULL;
+        }
+    }
+
+    ir_emit_label(ir, lowering->bail);
+    ir_emit_store_global(ir, JIT_BAILOUT_SYMBOL, constant(lowering, 1));
+    ir_emit_return(ir, constant(lowering, 0));
+    if (ir->failed) {
+        ir_function_destroy(ir);
+        return NULL;
+    }
+    return ir;
+}
+
+// 読み込み
+// .textを領域の末尾に写し、リロケーションを解決する。書き込む間だけページを書けるようにする
+static bool set_protection(Jit* jit, size_t start, size_t end, int protection) {
+    size_t first = start & ~(jit->page_size - 1);
+    size_t last = (end + jit->page_size - 1) & ~(jit->page_size - 1);
+    return mprotect(jit->region + first, last - first, protection) == 0;
+}
+
+static uint8_t* resolve_symbol(Jit* jit, const ElfObject* elf, const ElfSymbol* symbol, uint8_t* code,
+                               const Lowering* lowering) {
+    const char* name = (const char*)elf->strings.data + symbol->name;
+    if (symbol->section == ELF_SECTION_TEXT) return code + symbol->value;
+    if (symbol->section != ELF_SECTION_UNDEFINED) return NULL;
+    if (strcmp(name, JIT_BAILOUT_SYMBOL) == 0) return (uint8_t*)&jit->data[0];
+    if (strcmp(name, JIT_DEPTH_SYMBOL) == 0) return (uint8_t*)&jit->data[1];
+    for (size_t i = 0; i < lowering->callee_count; i++) {
+        const BytecodeFunction* callee = lowering->callees[i];
+        if (strcmp(name, callee->name) == 0) return callee->native;
+    }
+    return NULL;
+}
+
+static bool load(Jit* jit, const ElfObject* elf, const Lowering* lowering, BytecodeFunction* function) {
+    size_t start = (jit->used + 15) & ~(size_t)15;
+    size_t size = elf->text.size;
+    if (size == 0 || size > JIT_CODE_SIZE - start) return false;
+    uint8_t* code = jit->region + start;
+
+    uint8_t* entry = NULL;
+    for (size_t i = 1; i < elf->symbol_count; i++) {
+        const ElfSymbol* symbol = &elf->symbols[i];
+        if (symbol->section == ELF_SECTION_TEXT &&
+            strcmp((const char*)elf->strings.data + symbol->name, function->name) == 0) {
+            entry = code + symbol->value;
+        }
+    }
+    if (entry == NULL || !set_protection(jit, start, start + size, PROT_READ | PROT_WRITE)) return false;
+
+    memcpy(code, elf->text.data, size);
+    bool ok = true;
+    for (size_t i = 0; i < elf->relocation_count && ok; i++) {
+        const ElfRelocation* relocation = &elf->relocations[i];
+        uint8_t* target = resolve_symbol(jit, elf, &elf->symbols[relocation->symbol], code, lowering);
+        if (target == NULL || relocation->offset + 4 > size ||
+            (relocation->type != R_X86_64_PC32 && relocation->type != R_X86_64_PLT32)) {
+            ok = false;
+            break;
+        }
+        // S + A - P
+        int64_t value = (int64_t)((intptr_t)target - (intptr_t)(code + relocation->offset)) + relocation->addend;
+        if (value < INT32_MIN || value > INT32_MAX) {
+            ok = false;
+            break;
+        }
+        uint32_t rel = (uint32_t)(int32_t)value;
+        for (int b = 0; b < 4; b++) code[relocation->offset + b] = (uint8_t)(rel >> (8 * b));
+    }
+    // 失敗しても、同じページに先に読み込んだ関数のために実行できるように戻す
+    if (!set_protection(jit, start, start + size, PROT_READ | PROT_EXEC)) ok = false;
+    if (!ok) return false;
+
+    __builtin___clear_cache((char*)code, (char*)code + size);
+    jit->used = start + size;
+    function->native = entry;
+    return true;
+}
+
+// 関数1つを解析・変換・最適化・出力して読み込む
+static bool compile_function(Jit* jit, BytecodeFunction* function) {
+    if (!function->compiled || function->arity > JIT_MAX_ARGUMENTS || function->code_count == 0) return false;
+
+    Analysis analysis = { 0 };
+    analysis.jit = jit;
+    analysis.function = function;
+    analysis.registers = function->register_count > 0 ? function->register_count : 1;
+    analysis.states = malloc(function->code_count * analysis.registers * sizeof(JitKind));
+    analysis.visited = malloc(function->code_count * sizeof(bool));
+    analysis.queued = malloc(function->code_count * sizeof(bool));
+    analysis.worklist = malloc(function->code_count * sizeof(size_t));
+    Lowering lowering = { 0 };
+    lowering.analysis = &analysis;
+    lowering.registers = malloc(analysis.registers * sizeof(IrValue));
+    lowering.labels = malloc(function->code_count * sizeof(uint32_t));
+    bool ok = analysis.states != NULL && analysis.visited != NULL && analysis.queued != NULL &&
+              analysis.worklist != NULL && lowering.registers != NULL && lowering.labels != NULL;
+
+    // 自分自身の呼び出しは整数を返すと仮定し、違えば求めた種類でやり直す
+    analysis.self_result = KIND_INT;
+    ok = ok && analyze(&analysis);
+    if (ok && analysis.recursive && analysis.result != analysis.self_result) {
+        analysis.self_result = analysis.result;
+        ok = analyze(&analysis) && analysis.result == analysis.self_result;
+    }
+
+    IrFunction* ir = ok ? lower(&lowering) : NULL;
+    if (ir != NULL) {
+        Optimizer optimizer;
+        optimizer_init(&optimizer, &(OptOptions){ JIT_OPT_LEVEL, false, NULL });
+        optimizer_run(&optimizer, ir, NULL, 0);
+
+        RegisterAllocation allocation;
+        AsmWriter writer;
+        ok = regalloc_run(ir, &allocation) == SLANG_SUCCESS && asm_writer_open_memory(&writer);
+        if (ok) {
+            ok = x86_emit_function(&writer, ir, &allocation, NULL) == SLANG_SUCCESS && asm_writer_flush(&writer) &&
+                 load(jit, asm_writer_elf(&writer), &lowering, function);
+            asm_writer_close(&writer);
+        }
+        regalloc_free(&allocation);
+        ir_function_destroy(ir);
+    } else {
+        ok = false;
+    }
+    if (ok) function->native_result = analysis.result == KIND_INT ? VALUE_INT : analysis.result == KIND_BOOL ? VALUE_BOOL : VALUE_NIL;
+
+    free(analysis.states);
+    free(analysis.visited);
+    free(analysis.queued);
+    free(analysis.worklist);
+    free(lowering.registers);
+    free(lowering.labels);
+    free(lowering.callees);
+    return ok;
+}
+
+// 呼び出し先を先にコンパイルする（コンパイル中の関数に戻ってくる相互再帰は扱わない）
+static bool jit_compile_nested(Jit* jit, BytecodeFunction* function) {
+    if (function->tier == BYTECODE_TIER_NATIVE) return true;
+    if (function->tier == BYTECODE_TIER_REJECTED) return false;
+    for (size_t i = 0; i < jit->compiling_count; i++) {
+        if (jit->compiling[i] == function) return false;
+    }
+    if (jit->compiling_count == JIT_MAX_NESTING) return false;
+
+    jit->compiling[jit->compiling_count++] = function;
+    bool ok = compile_function(jit, function);
+    jit->compiling_count--;
+
+    function->tier = ok ? BYTECODE_TIER_NATIVE : BYTECODE_TIER_REJECTED;
+    if (ok) jit->stats.compiled++;
+    else jit->stats.rejected++;
+    return ok;
+}
+
+bool jit_compile(Jit* jit, BytecodeFunction* function) {
+    double start = now_seconds();
+    bool ok = jit_compile_nested(jit, function);
+    jit->stats.compile_seconds += now_seconds() - start;
+    return ok;
+}
+
+// 脱出が続く関数はインタプリタから入らないようにする（ほかの機械語からは呼ばれ続ける）
+static void note_bailout(Jit* jit, BytecodeFunction* function) {
+    if (++function->bailouts >= JIT_MAX_BAILOUTS && function->tier == BYTECODE_TIER_NATIVE) {
+        function->tier = BYTECODE_TIER_REJECTED;
+        jit->stats.deoptimized++;
+    }
+}
+
+typedef int64_t (*JitEntry0)(void);
+typedef int64_t (*JitEntry1)(int64_t);
+typedef int64_t (*JitEntry2)(int64_t, int64_t);
+typedef int64_t (*JitEntry3)(int64_t, int64_t, int64_t);
+typedef int64_t (*JitEntry4)(int64_t, int64_t, int64_t, int64_t);
+typedef int64_t (*JitEntry5)(int64_t, int64_t, int64_t, int64_t, int64_t);
+typedef int64_t (*JitEntry6)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t);
+
+bool jit_enter(Jit* jit, BytecodeFunction* function, const Value* args, size_t frames, Value* result) {
+    int64_t x[JIT_MAX_ARGUMENTS];
+    for (size_t i = 0; i < function->arity; i++) {
+        if (args[i].type != VALUE_INT) {
+            jit->stats.guard_failures++;
+            note_bailout(jit, function);
+            return false;
+        }
+        x[i] = args[i].as.integer;
+    }
+
+    jit->data[0] = 0;
+    jit->data[1] = frames > INT32_MAX ? INT32_MAX : (int64_t)frames;
+    jit->stats.entries++;
+    void* entry = function->native;
+    int64_t value;
+    switch (function->arity) {
+        case 0: value = ((JitEntry0)entry)(); break;
+        case 1: value = ((JitEntry1)entry)(x[0]); break;
+        case 2: value = ((JitEntry2)entry)(x[0], x[1]); break;
+        case 3: value = ((JitEntry3)entry)(x[0], x[1], x[2]); break;
+        case 4: value = ((JitEntry4)entry)(x[0], x[1], x[2], x[3]); break;
+        case 5: value = ((JitEntry5)entry)(x[0], x[1], x[2], x[3], x[4]); break;
+        default: value = ((JitEntry6)entry)(x[0], x[1], x[2], x[3], x[4], x[5]); break;
+    }
+    if (jit->data[0] != 0) {
+        jit->stats.bailouts++;
+        note_bailout(jit, function);
+        return false;
+    }
+
+    if (function->native_result == VALUE_INT) *result = value_int(value);
+    else if (function->native_result == VALUE_BOOL) *result = value_bool(value != 0);
+    else *result = value_nil();
+    return true;
+}
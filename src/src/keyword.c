@@ -0,0 +1,26 @@
+#include "../include/keyword.h"
+#include <string.h>
+
+// 完全ハッシュ表の要素
+typedef struct {
+    const char* text;
+    size_t length;
+    TokenType type;
+} KeywordEntry;
+
+// ビルド時に keywords.def から生成される
+#include "keyword_table.h"
+
+// キーワードの判定
+TokenType keyword_lookup(const char* text, size_t length) {
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) {
+        return TOKEN_IDENTIFIER;
+    }
+
+    uint32_t slot = keyword_hash(text, length, KEYWORD_HASH_K1, KEYWORD_HASH_K2) & KEYWORD_TABLE_MASK;
+    const KeywordEntry* entry = &keyword_table[slot];
+    if (entry->length == length && memcmp(entry->text, text, length) == 0) {
+        return entry->type;
+    }
+    return TOKEN_IDENTIFIER;
+}
@@ -1,5 +1,9 @@
 #include "../include/lexer.h"
 #include "../include/common.h"
+#include "../include/intern.h"
+#include "../include/keyword.h"
+#include "../include/arena.h"
+#include "../include/scan.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -7,308 +11,62 @@
 #include <stddef.h>
 #include <stdbool.h>
 
-// Helper functions
-static bool is_whitespace(char c) {
-    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
-}
-
-static bool is_identifier_start(char c) {
-    return isalpha(c) || c == '_';
-}
-
-static bool is_identifier_char(char c) {
-    return isalnum(c) || c == '_';
-}
-
-static bool is_digit(char c) {
-    return isdigit(c);
-}
-
-static bool is_hex_digit(char c) {
-    return isdigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
-}
-
-static bool is_at_end(Lexer* lexer) {
-    return lexer->current >= strlen(lexer->source);
-}
-
-static char advance(Lexer* lexer) {
-    return lexer->source[lexer->current++];
-}
-
-static bool match(Lexer* lexer, char expected) {
-    if (is_at_end(lexer)) return false;
-    if (lexer->source[lexer->current] != expected) return false;
-    lexer->current++;
-    return true;
-}
-
-static char peek(Lexer* lexer) {
-    return lexer->source[lexer->current];
-}
-
-static char peek_next(Lexer* lexer) {
-    if (is_at_end(lexer)) return '\0';
-    return lexer->source[lexer->current + 1];
-}
-
-static void skip_whitespace(Lexer* lexer) {
-    for (;;) {
-        char c = peek(lexer);
-        switch (c) {
-            case ' ':
-            case '\r':
-            case '\t':
-                advance(lexer);
-                break;
-            case '\n':
-                lexer->line++;
-                advance(lexer);
-                break;
-            case '/':
-                if (peek_next(lexer) == '/') {
-                    while (peek(lexer) != '\n' && !is_at_end(lexer)) advance(lexer);
-                } else {
-                    return;
-                }
-                break;
-            default:
-                return;
-        }
-    }
-}
-
-static Token make_token(Lexer* lexer, TokenType type) {
-    Token token;
-    token.type = type;
-    token.start = lexer->source + lexer->start;
-    token.length = lexer->current - lexer->start;
-    token.line = lexer->line;
-    return token;
-}
-
-static Token error_token(Lexer* lexer, const char* message) {
-    Token token;
-    token.type = TOKEN_ERROR;
-    token.start = message;
-    token.length = strlen(message);
-    token.line = lexer->line;
-    return token;
-}
-
-static Token string(Lexer* lexer) {
-    while (peek(lexer) != '"' && !is_at_end(lexer)) {
-        if (peek(lexer) == '\n') lexer->line++;
-        advance(lexer);
-    }
-
-    if (is_at_end(lexer)) {
-        return error_token(lexer, "Unterminated string.");
-    }
-
-    // The closing quote
-    advance(lexer);
-
-    // Trim the surrounding quotes
-    size_t length = lexer->current - lexer->start - 2;
-    char* str = malloc(length + 1);
-    strncpy(str, lexer->source + lexer->start + 1, length);
-    str[length] = '\0';
-
-    Token token = make_token(lexer, TOKEN_STRING);
-    token.value.string = str;
-    return token;
-}
-
-static Token number(Lexer* lexer) {
-    while (isdigit(peek(lexer))) advance(lexer);
-
-    // Look for a fractional part
-    if (peek(lexer) == '.' && isdigit(peek_next(lexer))) {
-        // Consume the "."
-        advance(lexer);
-
-        while (isdigit(peek(lexer))) advance(lexer);
-    }
-
-    Token token = make_token(lexer, TOKEN_NUMBER);
-    char* num_str = malloc(lexer->current - lexer->start + 1);
-    strncpy(num_str, lexer->source + lexer->start, lexer->current - lexer->start);
-    num_str[lexer->current - lexer->start] = '\0';
-    token.value.number = atof(num_str);
-    free(num_str);
-    return token;
-}
-
-static TokenType check_keyword(Lexer* lexer, int start, int length, const char* rest, TokenType type) {
-    if (lexer->current - lexer->start == start + length &&
-        memcmp(lexer->source + lexer->start + start, rest, length) == 0) {
-        return type;
-    }
-    return TOKEN_IDENTIFIER;
-}
-
-static TokenType identifier_type(Lexer* lexer) {
-    switch (lexer->source[lexer->start]) {
-        case 'a': return check_keyword(lexer, 1, 2, "nd", TOKEN_AND);
-        case 'c': return check_keyword(lexer, 1, 4, "lass", TOKEN_CLASS);
-        case 'e': return check_keyword(lexer, 1, 3, "lse", TOKEN_ELSE);
-        case 'f':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->source[lexer->start + 1]) {
-                    case 'a': return check_keyword(lexer, 2, 3, "lse", TOKEN_FALSE);
-                    case 'o': return check_keyword(lexer, 2, 1, "r", TOKEN_FOR);
-                    case 'n': return check_keyword(lexer, 2, 0, "", TOKEN_FUNCTION);
-                }
-            }
-            break;
-        case 'i':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->source[lexer->start + 1]) {
-                    case 'f': return check_keyword(lexer, 2, 0, "", TOKEN_IF);
-                    case 'n': return check_keyword(lexer, 2, 0, "", TOKEN_IN);
-                }
-            }
-            break;
-        case 'm': return check_keyword(lexer, 1, 4, "atch", TOKEN_MATCH);
-        case 'n': return check_keyword(lexer, 1, 3, "ull", TOKEN_NULL);
-        case 'o': return check_keyword(lexer, 1, 1, "r", TOKEN_OR);
-        case 'p': return check_keyword(lexer, 1, 4, "rint", TOKEN_PRINT);
-        case 'r': return check_keyword(lexer, 1, 5, "eturn", TOKEN_RETURN);
-        case 's': return check_keyword(lexer, 1, 4, "uper", TOKEN_SUPER);
-        case 't':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->source[lexer->start + 1]) {
-                    case 'h': return check_keyword(lexer, 2, 2, "is", TOKEN_THIS);
-                    case 'r': return check_keyword(lexer, 2, 2, "ue", TOKEN_TRUE);
-                    case 'y': return check_keyword(lexer, 2, 2, "pe", TOKEN_TYPE);
-                }
-            }
-            break;
-        case 'v': return check_keyword(lexer, 1, 2, "ar", TOKEN_VAR);
-        case 'w': return check_keyword(lexer, 1, 4, "hile", TOKEN_WHILE);
-    }
-    return TOKEN_IDENTIFIER;
-}
-
-static Token identifier(Lexer* lexer) {
-    while (isalnum(peek(lexer)) || peek(lexer) == '_') advance(lexer);
-    Token token = make_token(lexer, identifier_type(lexer));
-    return token;
-}
-
-Token scan_token(Lexer* lexer) {
-    skip_whitespace(lexer);
-    lexer->start = lexer->current;
-    Token token = {0};
-
-    if (is_at_end(lexer)) {
-        token.type = TOKEN_EOF;
-        return token;
-    }
-
-    char c = advance(lexer);
-    if (isalpha(c) || c == '_') {
-        return identifier(lexer);
-    }
-    if (isdigit(c)) {
-        return number(lexer);
-    }
-
-    switch (c) {
-        case '(': token.type = TOKEN_LEFT_PAREN; break;
-        case ')': token.type = TOKEN_RIGHT_PAREN; break;
-        case '{': token.type = TOKEN_LEFT_BRACE; break;
-        case '}': token.type = TOKEN_RIGHT_BRACE; break;
-        case '[': token.type = TOKEN_LEFT_BRACKET; break;
-        case ']': token.type = TOKEN_RIGHT_BRACKET; break;
-        case ';': token.type = TOKEN_SEMICOLON; break;
-        case ',': token.type = TOKEN_COMMA; break;
-        case '.': token.type = TOKEN_DOT; break;
-        case '-': token.type = TOKEN_MINUS; break;
-        case '+': token.type = TOKEN_PLUS; break;
-        case '/': token.type = TOKEN_SLASH; break;
-        case '*': token.type = TOKEN_STAR; break;
-        case '!': token.type = match(lexer, '=') ? TOKEN_BANG_EQUAL : TOKEN_BANG; break;
-        case '=': token.type = match(lexer, '=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL; break;
-        case '<': token.type = match(lexer, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS; break;
-        case '>': token.type = match(lexer, '=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER; break;
-        case '"': return string(lexer);
-        default: token.type = TOKEN_ERROR; break;
-    }
-
-    return token;
-}
-
-Lexer* lexer_init(const char* source) {
+static Lexer* lexer_new(const char* source, size_t length) {
     Lexer* lexer = malloc(sizeof(Lexer));
+    if (lexer == NULL) return NULL;
+
     lexer->source = source;
+    lexer->length = length;
     lexer->start = 0;
     lexer->current = 0;
     lexer->line = 1;
+    lexer->column = 1;
+    lexer->start_line = 1;
+    lexer->start_column = 1;
+    lexer->tokens = NULL;
+    lexer->token_count = 0;
+    lexer->token_capacity = 0;
+    lexer->position = 0;
+    lexer->ring = NULL;
+    lexer->ring_capacity = 0;
+    lexer->ring_read = 0;
+    lexer->ring_write = 0;
+    lexer->finished = false;
+    lexer->failed = false;
     return lexer;
 }
 
-void lexer_free(Lexer* lexer) {
-    free(lexer);
-}
-
-Token lexer_next_token(Lexer* lexer) {
-    return scan_token(lexer);
-}
+// 字句解析器の作成（source[length]は'\0'であること）
+Lexer* lexer_create(const char* source, size_t length) {
+    Lexer* lexer = lexer_new(source, length);
+    if (lexer == NULL) return NULL;
 
-Token lexer_peek_token(Lexer* lexer) {
-    size_t current_position = lexer->current;
-    Token token = lexer_next_token(lexer);
-    lexer->current = current_position;
-    return token;
-}
+    // ソース16バイトあたり1トークンを見込んでおく（足りなければlexer_add_tokenで伸ばす）
+    lexer->token_capacity = length / 16 + 16;
+    lexer->tokens = malloc(lexer->token_capacity * sizeof(Token));
+    if (lexer->tokens == NULL) {
+        free(lexer);
+        return NULL;
+    }
 
-bool lexer_is_at_end(Lexer* lexer) {
-    return lexer->source[lexer->current] == '\0';
+    return lexer;
 }
 
-// キーワードの定義
-typedef struct {
-    const char* keyword;
-    TokenType type;
-} Keyword;
-
-static const Keyword keywords[] = {
-    {"fn", TOKEN_FN},
-    {"let", TOKEN_LET},
-    {"if", TOKEN_IF},
-    {"else", TOKEN_ELSE},
-    {"while", TOKEN_WHILE},
-    {"for", TOKEN_FOR},
-    {"return", TOKEN_RETURN},
-    {"break", TOKEN_BREAK},
-    {"continue", TOKEN_CONTINUE},
-    {"struct", TOKEN_STRUCT},
-    {"impl", TOKEN_IMPL},
-    {"trait", TOKEN_TRAIT},
-    {"use", TOKEN_USE},
-    {"pub", TOKEN_PUB},
-    {"priv", TOKEN_PRIV},
-    {NULL, 0}
-};
-
-// 字句解析器の作成
-Lexer* lexer_create(const char* source) {
-    Lexer* lexer = malloc(sizeof(Lexer));
+// ストリーミングモードの字句解析器の作成
+Lexer* lexer_create_streaming(const char* source, size_t length, size_t ring_capacity) {
+    Lexer* lexer = lexer_new(source, length);
     if (lexer == NULL) return NULL;
 
-    lexer->source = source;
-    lexer->start = 0;
-    lexer->current = 0;
-    lexer->line = 1;
-    lexer->column = 1;
-    lexer->tokens = vector_create(sizeof(Token));
-    
-    if (lexer->tokens == NULL) {
+    // 容量を2の冪に切り上げる
+    size_t capacity = LEXER_RING_RETAIN * 2;
+    while (capacity < ring_capacity) capacity *= 2;
+
+    lexer->ring = malloc(capacity * sizeof(Token));
+    if (lexer->ring == NULL) {
         free(lexer);
         return NULL;
     }
+    lexer->ring_capacity = capacity;
 
     return lexer;
 }
@@ -317,13 +75,9 @@ Lexer* lexer_create(const char* source) {
 void lexer_destroy(Lexer* lexer) {
     if (lexer == NULL) return;
     
-    // トークンの文字列を解放
-    for (size_t i = 0; i < vector_size(lexer->tokens); i++) {
-        Token* token = vector_get(lexer->tokens, i);
-        free(token->lexeme);
-    }
-    
-    vector_destroy(lexer->tokens);
+    // トークンはソースへのスライスなので文字列の解放は不要
+    free(lexer->tokens);
+    free(lexer->ring);
     free(lexer);
 }
 
@@ -347,86 +101,133 @@ static char lexer_peek(const Lexer* lexer) {
 
 // 次の次の文字を確認
 static char lexer_peek_next(const Lexer* lexer) {
-    if (lexer->current + 1 >= strlen(lexer->source)) return '\0';
+    if (lexer->current + 1 >= lexer->length) return '\0';
     return lexer->source[lexer->current + 1];
 }
 
-// 現在のトークンの文字列を取得
-static char* lexer_get_lexeme(const Lexer* lexer) {
-    size_t length = lexer->current - lexer->start;
-    char* lexeme = malloc(length + 1);
-    if (lexeme == NULL) return NULL;
-    
-    strncpy(lexeme, lexer->source + lexer->start, length);
-    lexeme[length] = '\0';
-    return lexeme;
+// ソースの終端
+static const char* lexer_end(const Lexer* lexer) {
+    return lexer->source + lexer->length;
+}
+
+// 読み飛ばした範囲に合わせて位置・行・列を進める
+static void lexer_skip(Lexer* lexer, ScanResult result) {
+    if (result.newlines > 0) {
+        lexer->line += result.newlines;
+        lexer->column = result.length - result.last_newline;
+    } else {
+        lexer->column += result.length;
+    }
+    lexer->current += result.length;
+}
+
+// 改行を含まない範囲を読み飛ばす
+static void lexer_skip_bytes(Lexer* lexer, size_t length) {
+    lexer->current += length;
+    lexer->column += length;
+}
+
+// 次のトークンの先頭をいまの位置にする
+static void lexer_begin_token(Lexer* lexer) {
+    lexer->start = lexer->current;
+    lexer->start_line = lexer->line;
+    lexer->start_column = lexer->column;
 }
 
 // トークンの追加
-static bool lexer_add_token(Lexer* lexer, TokenType type) {
+static bool lexer_push_token(Lexer* lexer, TokenType type, LexErrorKind error) {
+    size_t column = lexer->start_column;
+
     Token token;
-    token.type = type;
-    token.lexeme = lexer_get_lexeme(lexer);
-    token.line = lexer->line;
-    token.column = lexer->column - (lexer->current - lexer->start);
+    token.offset = (uint32_t)lexer->start;
+    token.length = (uint32_t)(lexer->current - lexer->start);
+    token.line = (uint32_t)lexer->start_line;
+    token.column = (uint16_t)(column < TOKEN_MAX_COLUMN ? column : TOKEN_MAX_COLUMN);
+    token.type = (uint8_t)type;
+    token.error = (uint8_t)error;
+
+    if (lexer->ring != NULL) {
+        lexer->ring[lexer->ring_write & (lexer->ring_capacity - 1)] = token;
+        lexer->ring_write++;
+        return true;
+    }
     
-    return vector_push(lexer->tokens, &token);
+    if (lexer->token_count == lexer->token_capacity) {
+        Token* tokens = realloc(lexer->tokens, lexer->token_capacity * 2 * sizeof(Token));
+        if (tokens == NULL) {
+            lexer->failed = true;
+            return false;
+        }
+        lexer->tokens = tokens;
+        lexer->token_capacity *= 2;
+    }
+    lexer->tokens[lexer->token_count++] = token;
+    return true;
+}
+
+static bool lexer_add_token(Lexer* lexer, TokenType type) {
+    return lexer_push_token(lexer, type, LEX_ERROR_NONE);
+}
+
+static bool lexer_add_error(Lexer* lexer, LexErrorKind error) {
+    return lexer_push_token(lexer, TOKEN_ERROR, error);
 }
 
 // 識別子の解析
 static void lexer_identifier(Lexer* lexer) {
-    while (isalnum(lexer_peek(lexer)) || lexer_peek(lexer) == '_') {
-        lexer_advance(lexer);
-    }
+    lexer_skip_bytes(lexer, scan_identifier(lexer->source + lexer->current, lexer_end(lexer)));
 
-    // キーワードの確認
-    char* lexeme = lexer_get_lexeme(lexer);
-    TokenType type = TOKEN_IDENTIFIER;
-    
-    for (const Keyword* kw = keywords; kw->keyword != NULL; kw++) {
-        if (strcmp(lexeme, kw->keyword) == 0) {
-            type = kw->type;
-            break;
-        }
-    }
-    
-    free(lexeme);
+    // キーワードの確認（完全ハッシュなので1回の比較で済む）
+    TokenType type = keyword_lookup(lexer->source + lexer->start, lexer->current - lexer->start);
     lexer_add_token(lexer, type);
 }
 
+// 10進の数字列の値（INT64_MAXを超えるならfalse）
+static bool lexer_parse_integer(const char* p, size_t length, int64_t* value) {
+    int64_t result = 0;
+    for (size_t i = 0; i < length && isdigit((unsigned char)p[i]); i++) {
+        int digit = p[i] - '0';
+        if (result > (INT64_MAX - digit) / 10) return false;
+        result = result * 10 + digit;
+    }
+    *value = result;
+    return true;
+}
+
 // 数値の解析
 static void lexer_number(Lexer* lexer) {
-    while (isdigit(lexer_peek(lexer))) {
+    while (isdigit((unsigned char)lexer_peek(lexer))) {
         lexer_advance(lexer);
     }
 
     // 小数点の確認
-    if (lexer_peek(lexer) == '.' && isdigit(lexer_peek_next(lexer))) {
+    if (lexer_peek(lexer) == '.' && isdigit((unsigned char)lexer_peek_next(lexer))) {
         lexer_advance(lexer); // 小数点を消費
         
-        while (isdigit(lexer_peek(lexer))) {
+        while (isdigit((unsigned char)lexer_peek(lexer))) {
             lexer_advance(lexer);
         }
         
         lexer_add_token(lexer, TOKEN_FLOAT);
-    } else {
-        lexer_add_token(lexer, TOKEN_INTEGER);
+        return;
+    }
+
+    // 値が収まらない整数リテラルはエラーにする（lexer_token_integerは常に収まる値を読む）
+    int64_t value;
+    if (!lexer_parse_integer(lexer->source + lexer->start, lexer->current - lexer->start, &value)) {
+        lexer_add_error(lexer, LEX_ERROR_INTEGER_TOO_LARGE);
+        return;
     }
+    lexer_add_token(lexer, TOKEN_INTEGER);
 }
 
 // 文字列の解析
 static void lexer_string(Lexer* lexer) {
-    while (lexer_peek(lexer) != '"' && lexer_peek(lexer) != '\0') {
-        if (lexer_peek(lexer) == '\n') {
-            lexer->line++;
-            lexer->column = 1;
-        }
-        lexer_advance(lexer);
-    }
+    lexer_skip(lexer, scan_string(lexer->source + lexer->current, lexer_end(lexer)));
 
-    if (lexer_peek(lexer) == '\0') {
-        // エラー: 文字列が終了していない
-        lexer_add_token(lexer, TOKEN_ERROR);
+    if (lexer_peek(lexer) != '"') {
+        // エラー: 文字列が終了していない（位置は開き引用符）
+        lexer_add_error(lexer, LEX_ERROR_UNTERMINATED_STRING);
         return;
     }
 
@@ -439,111 +240,221 @@ static void lexer_string(Lexer* lexer) {
 
 // コメントの解析
 static void lexer_comment(Lexer* lexer) {
-    while (lexer_peek(lexer) != '\n' && lexer_peek(lexer) != '\0') {
-        lexer_advance(lexer);
+    lexer_skip_bytes(lexer, scan_line(lexer->source + lexer->current, lexer_end(lexer)));
+}
+
+// 1文字目から始まる字句を解析する（追加されるトークンは高々1つ）
+static void lexer_scan_lexeme(Lexer* lexer) {
+    // 空白の連続はまとめて読み飛ばす
+    ScanResult ws = scan_whitespace(lexer->source + lexer->current, lexer_end(lexer));
+    if (ws.length > 0) {
+        lexer_skip(lexer, ws);
+        return;
+    }
+
+    lexer_begin_token(lexer);
+    char c = lexer_advance(lexer);
+
+    switch (c) {
+        case '(': lexer_add_token(lexer, TOKEN_LPAREN); break;
+        case ')': lexer_add_token(lexer, TOKEN_RPAREN); break;
+        case '{': lexer_add_token(lexer, TOKEN_LBRACE); break;
+        case '}': lexer_add_token(lexer, TOKEN_RBRACE); break;
+        case ';': lexer_add_token(lexer, TOKEN_SEMICOLON); break;
+        case ',': lexer_add_token(lexer, TOKEN_COMMA); break;
+        case ':': lexer_add_token(lexer, TOKEN_COLON); break;
+        case '.': lexer_add_token(lexer, TOKEN_DOT); break;
+        case '-': 
+            if (lexer_peek(lexer) == '>') {
+                lexer_advance(lexer);
+                lexer_add_token(lexer, TOKEN_ARROW);
+            } else {
+                lexer_add_token(lexer, TOKEN_MINUS);
+            }
+            break;
+        case '+': lexer_add_token(lexer, TOKEN_PLUS); break;
+        case '*': lexer_add_token(lexer, TOKEN_STAR); break;
+        case '/':
+            if (lexer_peek(lexer) == '/') {
+                lexer_comment(lexer);
+            } else {
+                lexer_add_token(lexer, TOKEN_SLASH);
+            }
+            break;
+        case '%': lexer_add_token(lexer, TOKEN_PERCENT); break;
+        case '=':
+            if (lexer_peek(lexer) == '=') {
+                lexer_advance(lexer);
+                lexer_add_token(lexer, TOKEN_EQ);
+            } else {
+                lexer_add_token(lexer, TOKEN_EQUAL);
+            }
+            break;
+        case '!':
+            if (lexer_peek(lexer) == '=') {
+                lexer_advance(lexer);
+                lexer_add_token(lexer, TOKEN_NEQ);
+            } else {
+                lexer_add_token(lexer, TOKEN_BANG);
+            }
+            break;
+        case '&':
+            if (lexer_peek(lexer) == '&') {
+                lexer_advance(lexer);
+                lexer_add_token(lexer, TOKEN_AND);
+            } else {
+                lexer_add_error(lexer, LEX_ERROR_LONE_AMPERSAND);
+            }
+            break;
+        case '|':
+            if (lexer_peek(lexer) == '|') {
+                lexer_advance(lexer);
+                lexer_add_token(lexer, TOKEN_OR);
+            } else {
+                lexer_add_error(lexer, LEX_ERROR_LONE_PIPE);
+            }
+            break;
+        case '<':
+            if (lexer_peek(lexer) == '=') {
+                lexer_advance(lexer);
+                lexer_add_token(lexer, TOKEN_LE);
+            } else {
+                lexer_add_token(lexer, TOKEN_LT);
+            }
+            break;
+        case '>':
+            if (lexer_peek(lexer) == '=') {
+                lexer_advance(lexer);
+                lexer_add_token(lexer, TOKEN_GE);
+            } else {
+                lexer_add_token(lexer, TOKEN_GT);
+            }
+            break;
+        case '"': lexer_string(lexer); break;
+        default:
+            if (isdigit((unsigned char)c)) {
+                lexer_number(lexer);
+            } else if (isalpha((unsigned char)c) || c == '_') {
+                lexer_identifier(lexer);
+            } else {
+                // エラー: 不正な文字
+                lexer_add_error(lexer, LEX_ERROR_INVALID_CHARACTER);
+            }
+            break;
     }
 }
 
-// トークンのスキャン
+// トークンのスキャン（一括モード）
 SlangError lexer_scan(Lexer* lexer) {
-    while (lexer_peek(lexer) != '\0') {
-        lexer->start = lexer->current;
-        char c = lexer_advance(lexer);
-
-        switch (c) {
-            case '(': lexer_add_token(lexer, TOKEN_LPAREN); break;
-            case ')': lexer_add_token(lexer, TOKEN_RPAREN); break;
-            case '{': lexer_add_token(lexer, TOKEN_LBRACE); break;
-            case '}': lexer_add_token(lexer, TOKEN_RBRACE); break;
-            case ';': lexer_add_token(lexer, TOKEN_SEMICOLON); break;
-            case ',': lexer_add_token(lexer, TOKEN_COMMA); break;
-            case '.': lexer_add_token(lexer, TOKEN_DOT); break;
-            case '-': 
-                if (lexer_peek(lexer) == '>') {
-                    lexer_advance(lexer);
-                    lexer_add_token(lexer, TOKEN_ARROW);
-                } else {
-                    lexer_add_token(lexer, TOKEN_MINUS);
-                }
-                break;
-            case '+': lexer_add_token(lexer, TOKEN_PLUS); break;
-            case '*': lexer_add_token(lexer, TOKEN_STAR); break;
-            case '/':
-                if (lexer_peek(lexer) == '/') {
-                    lexer_comment(lexer);
-                } else {
-                    lexer_add_token(lexer, TOKEN_SLASH);
-                }
-                break;
-            case '%': lexer_add_token(lexer, TOKEN_PERCENT); break;
-            case '=':
-                if (lexer_peek(lexer) == '=') {
-                    lexer_advance(lexer);
-                    lexer_add_token(lexer, TOKEN_EQ);
-                } else {
-                    lexer_add_token(lexer, TOKEN_EQUAL);
-                }
-                break;
-            case '!':
-                if (lexer_peek(lexer) == '=') {
-                    lexer_advance(lexer);
-                    lexer_add_token(lexer, TOKEN_NEQ);
-                }
-                break;
-            case '<':
-                if (lexer_peek(lexer) == '=') {
-                    lexer_advance(lexer);
-                    lexer_add_token(lexer, TOKEN_LE);
-                } else {
-                    lexer_add_token(lexer, TOKEN_LT);
-                }
-                break;
-            case '>':
-                if (lexer_peek(lexer) == '=') {
-                    lexer_advance(lexer);
-                    lexer_add_token(lexer, TOKEN_GE);
-                } else {
-                    lexer_add_token(lexer, TOKEN_GT);
-                }
-                break;
-            case '"': lexer_string(lexer); break;
-            case ' ':
-            case '\r':
-            case '\t':
-                // 空白は無視
-                break;
-            case '\n':
-                lexer->line++;
-                lexer->column = 1;
-                break;
-            default:
-                if (isdigit(c)) {
-                    lexer_number(lexer);
-                } else if (isalpha(c) || c == '_') {
-                    lexer_identifier(lexer);
-                } else {
-                    // エラー: 不正な文字
-                    lexer_add_token(lexer, TOKEN_ERROR);
-                }
-                break;
-        }
+    // トークンは32ビットのオフセットでソースを指す
+    if (lexer->length >= TOKEN_MAX_OFFSET) {
+        return SLANG_ERROR_LEXER;
+    }
+
+    // ストリーミングモードではlexer_next_tokenが必要な分だけ解析する
+    if (lexer->ring != NULL) {
+        return SLANG_SUCCESS;
+    }
+
+    // 途中の'\0'も終端とはみなさない（不正な文字として報告して続ける）
+    while (lexer->current < lexer->length && !lexer->failed) {
+        lexer_scan_lexeme(lexer);
     }
 
     // EOFトークンを追加
+    lexer_begin_token(lexer);
     lexer_add_token(lexer, TOKEN_EOF);
-    return SLANG_SUCCESS;
+    lexer->finished = true;
+    return lexer->failed ? SLANG_ERROR_INTERNAL : SLANG_SUCCESS;
+}
+
+// リングバッファの空きをトークンで埋める（ストリーミングモード）
+static void lexer_fill(Lexer* lexer) {
+    while (!lexer->finished &&
+           lexer->ring_write - lexer->ring_read + LEXER_RING_RETAIN < lexer->ring_capacity) {
+        if (lexer->current >= lexer->length) {
+            lexer_begin_token(lexer);
+            lexer_add_token(lexer, TOKEN_EOF);
+            lexer->finished = true;
+        } else {
+            lexer_scan_lexeme(lexer);
+        }
+    }
+}
+
+// 次のトークンを確認
+Token* lexer_peek_token(Lexer* lexer) {
+    if (lexer->ring != NULL) {
+        if (lexer->ring_read == lexer->ring_write) {
+            lexer_fill(lexer);
+            if (lexer->ring_read == lexer->ring_write) return NULL;
+        }
+        return &lexer->ring[lexer->ring_read & (lexer->ring_capacity - 1)];
+    }
+
+    if (lexer->position >= lexer->token_count) return NULL;
+    return &lexer->tokens[lexer->position];
 }
 
 // 次のトークンを取得
 Token* lexer_next_token(Lexer* lexer) {
-    static size_t current = 0;
-    if (current >= vector_size(lexer->tokens)) return NULL;
-    return vector_get(lexer->tokens, current++);
+    Token* token = lexer_peek_token(lexer);
+    if (token == NULL) return NULL;
+
+    if (lexer->ring != NULL) {
+        lexer->ring_read++;
+    } else {
+        lexer->position++;
+    }
+    return token;
 }
 
-// 次のトークンを確認
-Token* lexer_peek_token(Lexer* lexer) {
-    static size_t current = 0;
-    if (current >= vector_size(lexer->tokens)) return NULL;
-    return vector_get(lexer->tokens, current);
-} 
\ No newline at end of file
+// トークンの先頭（ソースバッファ内、NUL終端ではない）
+const char* lexer_token_start(const Lexer* lexer, const Token* token) {
+    return lexer->source + token->offset;
+}
+
+// トークンの文字列をインターンする（識別子用）
+const char* lexer_token_intern(const Lexer* lexer, const Token* token) {
+    return intern(lexer->source + token->offset, token->length);
+}
+
+// 文字列リテラルの中身を取り出す（前後の引用符を除く）
+char* lexer_token_string(const Lexer* lexer, const Token* token, Arena* arena) {
+    const char* start = lexer->source + token->offset;
+    size_t length = token->length;
+
+    if (length >= 2 && start[0] == '"' && start[length - 1] == '"') {
+        start++;
+        length -= 2;
+    }
+    return arena_strndup(arena, start, length);
+}
+
+// 整数リテラルの値
+int64_t lexer_token_integer(const Lexer* lexer, const Token* token) {
+    int64_t value;
+    if (!lexer_parse_integer(lexer->source + token->offset, token->length, &value)) return INT64_MAX;
+    return value;
+}
+
+// 浮動小数点リテラルの値
+double lexer_token_float(const Lexer* lexer, const Token* token) {
+    char buffer[64];
+    size_t length = token->length < sizeof(buffer) - 1 ? token->length : sizeof(buffer) - 1;
+    memcpy(buffer, lexer->source + token->offset, length);
+    buffer[length] = '\0';
+    return strtod(buffer, NULL);
+}
+
+const char* lexer_error_message(LexErrorKind kind) {
+    switch (kind) {
+        case LEX_ERROR_UNTERMINATED_STRING: return "unterminated string literal";
+        case LEX_ERROR_LONE_AMPERSAND:      return "unexpected '&' (did you mean '&&'?)";
+        case LEX_ERROR_LONE_PIPE:           return "unexpected '|' (did you mean '||'?)";
+        case LEX_ERROR_INTEGER_TOO_LARGE:   return "integer literal too large";
+        case LEX_ERROR_INVALID_CHARACTER:
+        case LEX_ERROR_NONE:
+        default:                            return "invalid character";
+    }
+}
@@ -0,0 +1,417 @@
+#include "../include/logger.h"
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#define LOGGER_BATCH_SIZE (64 * 1024)
+#define LOGGER_CACHE_LINE 64
+
+// リングバッファ（容量は2の冪。headとtailは増え続ける位置で、容量で割った余りが置き場所）
+struct LogRing {
+    LogRing* next;
+    pthread_t owner;           // 書くスレッド
+    char* buffer;
+    size_t mask;
+    _Atomic size_t head;       // 背景のスレッドが読んだところ
+    char head_padding[LOGGER_CACHE_LINE - sizeof(size_t)];
+    _Atomic size_t tail;       // 書くスレッドが書いたところ
+};
+
+// 記録の先頭（引数が続き、その後ろに写した書式と文字列の引数をNUL終端で並べる）
+typedef struct {
+    uint32_t size;             // 記録の大きさ（8の倍数。0ならリングの末尾までの詰め物）
+    uint8_t level;
+    uint8_t count;
+    uint16_t reserved;
+    const char* format;        // NULLなら写してある
+} LogRecord;
+
+#define LOGGER_RECORD_ALIGNMENT 8
+
+static const char* const level_names[] = {
+#define LOG_LEVEL(name, macro, class, rank) macro,
+#include "../include/log_levels.def"
+#undef LOG_LEVEL
+};
+
+// 段階の並びが[組, 順位]の辞書順になっていること
+#define LOG_LEVEL(name, macro, class, rank)                                                   \
+    _Static_assert((rank) < LOG_CLASS_LEVELS &&                                               \
+                   LOG_LEVEL_##name == LOG_CLASS_##class * LOG_CLASS_LEVELS + (rank),         \
+                   "log_levels.def must list " macro " at its [class, rank] position");
+#include "../include/log_levels.def"
+#undef LOG_LEVEL
+
+static atomic_uint_fast64_t next_generation = 1;
+static _Atomic(Logger*) installed_logger = NULL;
+
+// このスレッドのリングと、そのロガーの世代
+static _Thread_local LogRing* current_ring = NULL;
+static _Thread_local uint64_t current_generation = 0;
+
+const char* logger_level_name(LogLevel level) {
+    return (unsigned)level < LOG_LEVEL_COUNT ? level_names[level] : "?";
+}
+
+int logger_level_of(const char* name) {
+    for (int level = 0; level < LOG_LEVEL_COUNT; level++) {
+        if (strcmp(name, level_names[level]) == 0) return level;
+    }
+    return -1;
+}
+
+void logger_install(Logger* logger) {
+    atomic_store_explicit(&installed_logger, logger, memory_order_release);
+}
+
+Logger* logger_installed(void) {
+    return atomic_load_explicit(&installed_logger, memory_order_acquire);
+}
+
+// 整形
+
+typedef struct {
+    char* out;
+    size_t length;
+    size_t limit;
+} LineWriter;
+
+static void line_append(LineWriter* writer, const char* text, size_t length) {
+    if (length > writer->limit - writer->length) length = writer->limit - writer->length;
+    memcpy(writer->out + writer->length, text, length);
+    writer->length += length;
+}
+
+static void line_append_arg(LineWriter* writer, const LogArg* arg) {
+    char number[32];
+    int length;
+    switch (arg->type) {
+        case LOG_ARG_INT:
+            length = snprintf(number, sizeof(number), "%" PRId64, arg->as.integer);
+            line_append(writer, number, (size_t)length);
+            break;
+        case LOG_ARG_FLOAT:
+            length = snprintf(number, sizeof(number), "%g", arg->as.number);
+            line_append(writer, number, (size_t)length);
+            break;
+        case LOG_ARG_BOOL:
+            line_append(writer, arg->as.boolean ? "true" : "false", arg->as.boolean ? 4 : 5);
+            break;
+        case LOG_ARG_STRING:
+            line_append(writer, arg->as.string, strlen(arg->as.string));
+            break;
+        default:
+            line_append(writer, "nil", 3);
+            break;
+    }
+}
+
+size_t logger_format(char* out, size_t capacity, LogLevel level, const char* format, const LogArg* args,
+                     size_t count) {
+    if (capacity < 2) return 0;
+    // 改行とNULの分を残す
+    LineWriter writer = { out, 0, capacity - 2 };
+    if (level != LOG_LEVEL_LOG) {
+        line_append(&writer, "[", 1);
+        line_append(&writer, logger_level_name(level), strlen(logger_level_name(level)));
+        line_append(&writer, "] ", 2);
+    }
+
+    size_t used = 0;
+    const char* text = format;
+    for (const char* p = format; *p != '\0'; p++) {
+        if (p[0] == '{' && p[1] == '}' && used < count) {
+            line_append(&writer, text, (size_t)(p - text));
+            line_append_arg(&writer, &args[used++]);
+            text = ++p + 1;
+        }
+    }
+    line_append(&writer, text, strlen(text));
+    for (; used < count; used++) {
+        if (used > 0 || *format != '\0') line_append(&writer, " ", 1);
+        line_append_arg(&writer, &args[used]);
+    }
+
+    out[writer.length++] = '\n';
+    out[writer.length] = '\0';
+    return writer.length;
+}
+
+// リング
+
+static LogRing* ring_create(size_t capacity) {
+    LogRing* ring = calloc(1, sizeof(LogRing));
+    if (ring == NULL) return NULL;
+    ring->buffer = malloc(capacity);
+    if (ring->buffer == NULL) {
+        free(ring);
+        return NULL;
+    }
+    ring->owner = pthread_self();
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ring;
+}
+
+// このスレッドのリング（初めてならロガーに登録する）
+static LogRing* logger_ring(Logger* logger) {
+    if (current_generation == logger->generation) return current_ring;
+
+    pthread_t self = pthread_self();
+    pthread_mutex_lock(&logger->lock);
+    LogRing* ring = logger->rings;
+    while (ring != NULL && !pthread_equal(ring->owner, self)) ring = ring->next;
+    if (ring == NULL && (ring = ring_create(logger->ring_capacity)) != NULL) {
+        ring->next = logger->rings;
+        logger->rings = ring;
+    }
+    pthread_mutex_unlock(&logger->lock);
+
+    if (ring != NULL) {
+        current_ring = ring;
+        current_generation = logger->generation;
+    }
+    return ring;
+}
+
+static size_t align_record(size_t size) {
+    return (size + LOGGER_RECORD_ALIGNMENT - 1) & ~(size_t)(LOGGER_RECORD_ALIGNMENT - 1);
+}
+
+static bool ring_write(Logger* logger, LogLevel level, const char* format, bool copy_format,
+                       const LogArg* args, size_t count) {
+    if (count > LOGGER_MAX_ARGS) count = LOGGER_MAX_ARGS;
+    LogRing* ring = logger_ring(logger);
+    if (ring == NULL) {
+        atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    size_t format_length = copy_format ? strnlen(format, LOGGER_LINE_MAX) : 0;
+    size_t size = sizeof(LogRecord) + count * sizeof(LogArg) + (copy_format ? format_length + 1 : 0);
+    for (size_t i = 0; i < count; i++) {
+        if (args[i].type == LOG_ARG_STRING) size += strnlen(args[i].as.string, LOGGER_MAX_STRING) + 1;
+    }
+    size = align_record(size);
+
+    size_t capacity = ring->mask + 1;
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t offset = tail & ring->mask;
+    size_t contiguous = capacity - offset;
+    size_t needed = size + (contiguous < size ? contiguous : 0);
+    if (size > capacity / 2 || tail + needed - head > capacity) {
+        atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    if (contiguous < size) {
+        // 末尾に収まらないので詰め物を置いて先頭から書く
+        ((LogRecord*)(ring->buffer + offset))->size = 0;
+        tail += contiguous;
+        offset = 0;
+    }
+
+    LogRecord* record = (LogRecord*)(ring->buffer + offset);
+    record->size = (uint32_t)size;
+    record->level = (uint8_t)level;
+    record->count = (uint8_t)count;
+    record->reserved = 0;
+    record->format = copy_format ? NULL : format;
+
+    LogArg* stored = (LogArg*)(record + 1);
+    char* bytes = (char*)(stored + count);
+    if (copy_format) {
+        memcpy(bytes, format, format_length);
+        bytes[format_length] = '\0';
+        bytes += format_length + 1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        stored[i] = args[i];
+        if (args[i].type != LOG_ARG_STRING) continue;
+        size_t length = strnlen(args[i].as.string, LOGGER_MAX_STRING);
+        memcpy(bytes, args[i].as.string, length);
+        bytes[length] = '\0';
+        stored[i].as.integer = (int64_t)length;
+        bytes += length + 1;
+    }
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+    return true;
+}
+
+bool logger_write(Logger* logger, LogLevel level, const char* format, const LogArg* args, size_t count) {
+    return ring_write(logger, level, format, false, args, count);
+}
+
+bool logger_write_copied(Logger* logger, LogLevel level, const char* format, const LogArg* args, size_t count) {
+    return ring_write(logger, level, format, true, args, count);
+}
+
+// 背景のスレッド
+
+typedef struct {
+    Logger* logger;
+    char buffer[LOGGER_BATCH_SIZE];
+    size_t length;
+} Batch;
+
+static void batch_flush(Batch* batch) {
+    if (batch->length == 0) return;
+    fwrite(batch->buffer, 1, batch->length, batch->logger->sink);
+    batch->length = 0;
+}
+
+// 記録を整形してbatchに足す
+static void batch_record(Batch* batch, const LogRecord* record) {
+    const LogArg* stored = (const LogArg*)(record + 1);
+    const char* bytes = (const char*)(stored + record->count);
+    const char* format = record->format;
+    if (format == NULL) {
+        format = bytes;
+        bytes += strlen(bytes) + 1;
+    }
+    LogArg args[LOGGER_MAX_ARGS];
+    for (size_t i = 0; i < record->count; i++) {
+        args[i] = stored[i];
+        if (args[i].type != LOG_ARG_STRING) continue;
+        args[i].as.string = bytes;
+        bytes += (size_t)stored[i].as.integer + 1;
+    }
+
+    if (LOGGER_BATCH_SIZE - batch->length < LOGGER_LINE_MAX) batch_flush(batch);
+    batch->length += logger_format(batch->buffer + batch->length, LOGGER_LINE_MAX, (LogLevel)record->level,
+                                   format, args, record->count);
+}
+
+// すべてのリングを今ある記録まで読む（読んだ記録の数を返す）
+static size_t logger_drain(Logger* logger, Batch* batch) {
+    pthread_mutex_lock(&logger->lock);
+    LogRing* rings = logger->rings;
+    pthread_mutex_unlock(&logger->lock);
+
+    // リングは先頭に足すだけで外さないので、取り出したリストはそのままたどれる
+    size_t records = 0;
+    for (LogRing* ring = rings; ring != NULL; ring = ring->next) {
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        while (head != tail) {
+            size_t offset = head & ring->mask;
+            const LogRecord* record = (const LogRecord*)(ring->buffer + offset);
+            if (record->size == 0) {
+                head += ring->mask + 1 - offset;
+                continue;
+            }
+            batch_record(batch, record);
+            head += record->size;
+            records++;
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+    batch_flush(batch);
+    if (records > 0) atomic_fetch_add_explicit(&logger->written, records, memory_order_relaxed);
+    return records;
+}
+
+static void* logger_main(void* argument) {
+    Logger* logger = argument;
+    Batch* batch = malloc(sizeof(Batch));
+    if (batch == NULL) return NULL;
+    batch->logger = logger;
+    batch->length = 0;
+
+    pthread_mutex_lock(&logger->lock);
+    for (;;) {
+        uint64_t requested = logger->flush_requested;
+        bool stopping = logger->stopping;
+        pthread_mutex_unlock(&logger->lock);
+        size_t records = logger_drain(logger, batch);
+        pthread_mutex_lock(&logger->lock);
+        if (records > 0) continue;
+
+        // 要求より後に読み始めて何もなかったので、要求までの記録はすべて書いてある
+        if (requested != logger->flush_completed) {
+            fflush(logger->sink);
+            logger->flush_completed = requested;
+            pthread_cond_broadcast(&logger->drained);
+        }
+        if (stopping) break;
+        if (logger->flush_requested != requested || logger->stopping) continue;
+
+        // 書く側は起こさない（ロックを取らない）ので、決まった間隔で見に行く
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOGGER_POLL_US * 1000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&logger->wake, &logger->lock, &deadline);
+    }
+    pthread_mutex_unlock(&logger->lock);
+    free(batch);
+    return NULL;
+}
+
+// ロガーの作成
+Logger* logger_create(FILE* sink, LogLevel threshold, size_t ring_capacity) {
+    if (ring_capacity == 0) ring_capacity = LOGGER_DEFAULT_RING_CAPACITY;
+    size_t capacity = 256;
+    while (capacity < ring_capacity) capacity *= 2;
+
+    Logger* logger = calloc(1, sizeof(Logger));
+    if (logger == NULL) return NULL;
+    logger->sink = sink;
+    atomic_init(&logger->threshold, (int)threshold);
+    logger->ring_capacity = capacity;
+    logger->generation = atomic_fetch_add(&next_generation, 1);
+    atomic_init(&logger->dropped, 0);
+    atomic_init(&logger->written, 0);
+    pthread_mutex_init(&logger->lock, NULL);
+    pthread_cond_init(&logger->wake, NULL);
+    pthread_cond_init(&logger->drained, NULL);
+    if (pthread_create(&logger->thread, NULL, logger_main, logger) != 0) {
+        pthread_cond_destroy(&logger->drained);
+        pthread_cond_destroy(&logger->wake);
+        pthread_mutex_destroy(&logger->lock);
+        free(logger);
+        return NULL;
+    }
+    return logger;
+}
+
+// ロガーの破棄（インストールされていれば外す）
+void logger_destroy(Logger* logger) {
+    if (logger == NULL) return;
+
+    Logger* expected = logger;
+    atomic_compare_exchange_strong(&installed_logger, &expected, NULL);
+    logger_flush(logger);
+    pthread_mutex_lock(&logger->lock);
+    logger->stopping = true;
+    pthread_cond_signal(&logger->wake);
+    pthread_mutex_unlock(&logger->lock);
+    pthread_join(logger->thread, NULL);
+
+    while (logger->rings != NULL) {
+        LogRing* ring = logger->rings;
+        logger->rings = ring->next;
+        free(ring->buffer);
+        free(ring);
+    }
+    pthread_cond_destroy(&logger->drained);
+    pthread_cond_destroy(&logger->wake);
+    pthread_mutex_destroy(&logger->lock);
+    free(logger);
+}
+
+void logger_flush(Logger* logger) {
+    pthread_mutex_lock(&logger->lock);
+    uint64_t ticket = ++logger->flush_requested;
+    pthread_cond_signal(&logger->wake);
+    while (logger->flush_completed < ticket) pthread_cond_wait(&logger->drained, &logger->lock);
+    pthread_mutex_unlock(&logger->lock);
+}
+
+void logger_set_threshold(Logger* logger, LogLevel threshold) {
+    atomic_store_explicit(&logger->threshold, (int)threshold, memory_order_relaxed);
+}
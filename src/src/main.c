@@ -2,118 +2,109 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../include/common.h"
-#include "../include/lexer.h"
-#include "../include/parser.h"
-#include "../include/ast.h"
 #include "../include/type_system.h"
-#include "../include/error.h"
-
-// ファイルの内容を読み込む
-char* read_file(const char* path) {
-    FILE* file = fopen(path, "rb");
-    if (file == NULL) {
-        fprintf(stderr, "Error: Could not open file '%s'\n", path);
-        exit(74);
-    }
-
-    fseek(file, 0L, SEEK_END);
-    size_t file_size = ftell(file);
-    rewind(file);
-
-    char* buffer = malloc(file_size + 1);
-    if (buffer == NULL) {
-        fprintf(stderr, "Error: Not enough memory to read '%s'\n", path);
-        exit(74);
-    }
-
-    size_t bytes_read = fread(buffer, sizeof(char), file_size, file);
-    if (bytes_read < file_size) {
-        fprintf(stderr, "Error: Could not read file '%s'\n", path);
-        exit(74);
-    }
-
-    buffer[bytes_read] = '\0';
-    fclose(file);
-    return buffer;
+#include "../include/intern.h"
+#include "../include/driver.h"
+#include "../include/server.h"
+#include "../include/trace.h"
+
+static void usage(void) {
+    fprintf(stderr, "Usage: slangc [-S] [-O0|-O1|-O2] [-jN] [--time-passes] [--time-report] [--trace=FILE] "
+                    "[--cache-dir=DIR] [--project=FILE] <source_file>...\n"
+                    "       slangc --server=SOCKET\n");
 }
 
-// コンパイル処理
-SlangError compile(const char* source, const char* output_path) {
-    // 字句解析
-    Lexer* lexer = lexer_create(source);
-    if (lexer == NULL) {
-        return SLANG_ERROR_INTERNAL;
+int main(int argc, char* argv[]) {
+    DriverOptions options = {
+        ASM_OUTPUT_OBJECT, { OPT_DEFAULT_LEVEL, false, NULL }, getenv("SLANG_CACHE_DIR"), 0, NULL,
+    };
+    const char* project = NULL;
+    const char* trace_path = NULL;
+    const char* server_path = NULL;
+    bool time_report = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        const char* option = argv[arg];
+        if (strcmp(option, "-S") == 0) {
+            options.format = ASM_OUTPUT_ASSEMBLY;
+        } else if (strcmp(option, "--time-passes") == 0) {
+            options.options.time_passes = true;
+        } else if (strcmp(option, "--time-report") == 0) {
+            time_report = true;
+        } else if (strncmp(option, "--trace=", 8) == 0 && option[8] != '\0') {
+            trace_path = option + 8;
+        } else if (strncmp(option, "--cache-dir=", 12) == 0) {
+            options.cache_dir = option[12] ? option + 12 : NULL;
+        } else if (strncmp(option, "--server=", 9) == 0 && option[9] != '\0') {
+            server_path = option + 9;
+        } else if (strncmp(option, "--project=", 10) == 0 && option[10] != '\0') {
+            project = option + 10;
+        } else if (option[1] == 'j' && option[2] >= '1' && option[2] <= '9') {
+            options.threads = strtoul(option + 2, NULL, 10);
+        } else if (option[1] == 'O' && option[2] >= '0' && option[2] <= '0' + OPT_MAX_LEVEL && option[3] == '\0') {
+            options.options.level = option[2] - '0';
+        } else {
+            usage();
+            return 64;
+        }
     }
-
-    SlangError error = lexer_scan(lexer);
-    if (error != SLANG_SUCCESS) {
-        lexer_destroy(lexer);
-        return error;
+    // サーバーにはソースを渡さない（要求ごとに受ける）
+    bool has_sources = arg < argc || project != NULL;
+    if (has_sources == (server_path != NULL)) {
+        usage();
+        return 64;
     }
 
-    // 構文解析
-    Parser* parser = parser_create(lexer);
-    if (parser == NULL) {
-        lexer_destroy(lexer);
-        return SLANG_ERROR_INTERNAL;
+    // 識別子・キーワードのインターン表と型の表（プロセス全体で共有するので、スレッドを起動する前に作る）
+    if (!intern_init() || !type_table_init()) {
+        intern_shutdown();
+        return 74;
     }
 
-    ASTNode* ast = NULL;
-    error = parser_parse(parser, &ast);
-    if (error != SLANG_SUCCESS) {
-        parser_destroy(parser);
-        lexer_destroy(lexer);
-        return error;
+    // サーバーは検査の要求だけを受ける（表・構文解析した単位・型検査の結果を要求の間で持ち続ける）
+    if (server_path != NULL) {
+        Server* server = server_create();
+        SlangError error = server ? server_listen(server, server_path) : SLANG_ERROR_INTERNAL;
+        if (error == SLANG_ERROR_IO) fprintf(stderr, "Error: Could not listen on '%s'\n", server_path);
+        server_destroy(server);
+        type_table_shutdown();
+        intern_shutdown();
+        return error == SLANG_ERROR_IO ? 74 : error != SLANG_SUCCESS ? 65 : 0;
     }
 
-    // 型チェック
-    error = type_check(ast);
-    if (error != SLANG_SUCCESS) {
-        ast_destroy_node(ast);
-        parser_destroy(parser);
-        lexer_destroy(lexer);
-        return error;
+    // 段階とパスの計測（報告とトレースの書き出しはコンパイルが失敗しても行う）
+    if (time_report || trace_path != NULL) {
+        options.trace = trace_create();
+        options.options.trace = options.trace;
     }
 
-    // TODO: コード生成
-
-    // クリーンアップ
-    ast_destroy_node(ast);
-    parser_destroy(parser);
-    lexer_destroy(lexer);
-
-    return SLANG_SUCCESS;
-}
-
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: slangc <source_file>\n");
-        return 64;
+    // 指定した各ファイルとuseで辿れるファイルを並列にコンパイルする
+    // （キャッシュのディレクトリが決まっていれば、変わっていない単位は出力を写すだけ）
+    SlangError error = SLANG_ERROR_INTERNAL;
+    Driver* driver = driver_create(&options);
+    if (driver != NULL) {
+        error = project ? driver_add_manifest(driver, project) : SLANG_SUCCESS;
+        for (; arg < argc && error == SLANG_SUCCESS; arg++) error = driver_add_file(driver, argv[arg]);
+        if (error == SLANG_SUCCESS) error = driver_compile(driver);
+        driver_destroy(driver);
     }
-
-    const char* source_path = argv[1];
-    char* source = read_file(source_path);
-    if (source == NULL) {
-        return 74;
+    if (options.trace != NULL) {
+        if (time_report) trace_report(options.trace, stderr);
+        if (trace_path != NULL && trace_write_json(options.trace, trace_path) != SLANG_SUCCESS) {
+            fprintf(stderr, "Error: Could not write trace '%s'\n", trace_path);
+            if (error == SLANG_SUCCESS) error = SLANG_ERROR_IO;
+        }
+        trace_destroy(options.trace);
     }
+    type_table_shutdown();
+    intern_shutdown();
 
-    // 出力ファイル名を生成
-    char* output_path = malloc(strlen(source_path) + 3);
-    if (output_path == NULL) {
-        free(source);
+    if (error == SLANG_ERROR_IO) {
         return 74;
     }
-    strcpy(output_path, source_path);
-    strcat(output_path, ".o");
-
-    // コンパイル
-    SlangError error = compile(source, output_path);
-    free(source);
-    free(output_path);
-
     if (error != SLANG_SUCCESS) {
         return 65;
     }
 
     return 0;
-} 
\ No newline at end of file
+}
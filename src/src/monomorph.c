@@ -0,0 +1,321 @@
+#include "../include/monomorph.h"
+#include "../include/intern.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+#define MONO_INITIAL_CAPACITY 16
+
+MonoCache* mono_cache_create(const MonoOptions* options) {
+    MonoCache* cache = calloc(1, sizeof(MonoCache));
+    if (cache == NULL) return NULL;
+    if (pthread_mutex_init(&cache->lock, NULL) != 0) {
+        free(cache);
+        return NULL;
+    }
+    if (pthread_cond_init(&cache->checked, NULL) != 0) {
+        pthread_mutex_destroy(&cache->lock);
+        free(cache);
+        return NULL;
+    }
+    cache->arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    cache->generics = calloc(MONO_INITIAL_CAPACITY, sizeof(MonoGeneric*));
+    if (cache->arena == NULL || cache->generics == NULL) {
+        mono_cache_destroy(cache);
+        return NULL;
+    }
+    cache->generic_capacity = MONO_INITIAL_CAPACITY;
+    if (options != NULL) cache->options = *options;
+    if (cache->options.max_instances == 0) cache->options.max_instances = MONO_DEFAULT_MAX_INSTANCES;
+    if (cache->options.budget == 0) cache->options.budget = MONO_DEFAULT_BUDGET;
+    return cache;
+}
+
+void mono_cache_destroy(MonoCache* cache) {
+    if (cache == NULL) return;
+    arena_destroy(cache->arena);
+    free(cache->generics);
+    pthread_cond_destroy(&cache->checked);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+// 汎用関数の表（宣言のポインタで引く。オープンアドレス法、線形探査、容量は2の冪）
+
+static size_t pointer_hash(const void* pointer) {
+    uint64_t value = (uintptr_t)pointer * 0x9e3779b97f4a7c15ull;
+    return (size_t)(value ^ (value >> 32));
+}
+
+static MonoGeneric** generic_slot(MonoGeneric** table, size_t capacity, const ASTNode* function) {
+    size_t mask = capacity - 1;
+    for (size_t index = pointer_hash(function) & mask;; index = (index + 1) & mask) {
+        if (table[index] == NULL || table[index]->function == function) return &table[index];
+    }
+}
+
+static bool grow_generics(MonoCache* cache) {
+    size_t capacity = cache->generic_capacity * 2;
+    MonoGeneric** table = calloc(capacity, sizeof(MonoGeneric*));
+    if (table == NULL) return false;
+    for (size_t i = 0; i < cache->generic_capacity; i++) {
+        MonoGeneric* generic = cache->generics[i];
+        if (generic != NULL) *generic_slot(table, capacity, generic->function) = generic;
+    }
+    free(cache->generics);
+    cache->generics = table;
+    cache->generic_capacity = capacity;
+    return true;
+}
+
+// なければ作る（ロックを取ってから呼ぶ）
+static MonoGeneric* find_generic(MonoCache* cache, const ASTNode* node) {
+    MonoGeneric** slot = generic_slot(cache->generics, cache->generic_capacity, node);
+    if (*slot != NULL) return *slot;
+    if ((cache->stats.generics + 1) * 2 > cache->generic_capacity) {
+        if (!grow_generics(cache)) return NULL;
+        slot = generic_slot(cache->generics, cache->generic_capacity, node);
+    }
+
+    const Function* function = &node->data.function;
+    MonoGeneric* generic = arena_alloc(cache->arena, sizeof(MonoGeneric));
+    const Type** types = arena_alloc(cache->arena, function->type_parameter_count * sizeof(const Type*));
+    if (generic == NULL || types == NULL) return NULL;
+    for (size_t i = 0; i < function->type_parameter_count; i++) {
+        types[i] = type_named_of(function->type_parameters[i]);
+        if (types[i] == NULL) return NULL;
+    }
+    generic->function = node;
+    generic->type_parameters = types;
+    generic->type_parameter_count = function->type_parameter_count;
+    generic->node_count = ast_count_nodes(node);
+    generic->environment = NULL;
+    generic->instances = NULL;
+    generic->instance_count = 0;
+    *slot = generic;
+    cache->stats.generics++;
+    return generic;
+}
+
+// 環境
+
+static bool copy_signatures(Arena* arena, TypeSignature* copies, const TypeSignature* signatures, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        copies[i] = signatures[i];
+        if (signatures[i].parameter_count == 0) continue;
+        copies[i].parameters = arena_memdup(arena, signatures[i].parameters,
+                                            signatures[i].parameter_count * sizeof(const Type*));
+        if (copies[i].parameters == NULL) return false;
+    }
+    return true;
+}
+
+SlangError mono_publish(MonoCache* cache, const TypeChecker* checker, ASTNode* const* nodes, size_t count) {
+    pthread_mutex_lock(&cache->lock);
+    MonoEnvironment* environment = NULL;
+    SlangError error = SLANG_SUCCESS;
+    for (size_t i = 0; i < count && error == SLANG_SUCCESS; i++) {
+        const ASTNode* node = nodes[i];
+        if (node == NULL || node->type != NODE_FUNCTION || node->data.function.type_parameter_count == 0) continue;
+
+        // 環境は検査器ごとに1回だけ写し、その中の汎用関数で共有する
+        if (environment == NULL) {
+            environment = arena_alloc(cache->arena, sizeof(MonoEnvironment));
+            TypeSignature* signatures = arena_alloc(cache->arena, checker->signature_count * sizeof(TypeSignature));
+            TypeBinding* globals = arena_alloc(cache->arena, checker->global_count * sizeof(TypeBinding));
+            if (environment == NULL || signatures == NULL || globals == NULL ||
+                !copy_signatures(cache->arena, signatures, checker->signatures, checker->signature_count)) {
+                error = SLANG_ERROR_INTERNAL;
+                break;
+            }
+            if (checker->global_count > 0) {
+                memcpy(globals, checker->global_bindings, checker->global_count * sizeof(TypeBinding));
+            }
+            environment->signatures = signatures;
+            environment->signature_count = checker->signature_count;
+            environment->globals = globals;
+            environment->global_count = checker->global_count;
+        }
+        MonoGeneric* generic = find_generic(cache, node);
+        if (generic == NULL) error = SLANG_ERROR_INTERNAL;
+        else generic->environment = environment;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return error;
+}
+
+// 特殊化
+
+// 引数の注釈が型引数そのものなら、その位置の引数の型から決まる
+static bool infer_arguments(const MonoGeneric* generic, const Type* const* arguments, size_t argument_count,
+                            const Type** bound) {
+    const Function* function = &generic->function->data.function;
+    if (argument_count != function->parameter_count) return false;
+    for (size_t t = 0; t < generic->type_parameter_count; t++) bound[t] = NULL;
+
+    for (size_t i = 0; i < argument_count; i++) {
+        const Type* annotation = type_canonical(function->parameters[i]->type);
+        for (size_t t = 0; t < generic->type_parameter_count; t++) {
+            if (annotation != generic->type_parameters[t]) continue;
+            if (arguments[i] == NULL) return false;
+            if (bound[t] != NULL && bound[t] != arguments[i]) return false;
+            bound[t] = arguments[i];
+        }
+    }
+    for (size_t t = 0; t < generic->type_parameter_count; t++) {
+        if (bound[t] == NULL) return false;
+    }
+    return true;
+}
+
+static MonoInstance* find_instance(const MonoGeneric* generic, const Type* const* arguments) {
+    for (MonoInstance* instance = generic->instances; instance != NULL; instance = instance->next) {
+        if (memcmp(instance->arguments, arguments, generic->type_parameter_count * sizeof(const Type*)) == 0) {
+            return instance;
+        }
+    }
+    return NULL;
+}
+
+// 名前.型引数.…（型名の識別子にならない文字は_にする）
+static const char* instance_name(const MonoGeneric* generic, const Type* const* arguments) {
+    const char* name = generic->function->data.function.name;
+    char* names[TYPE_CHECKER_MAX_TYPE_PARAMETERS];
+    size_t count = generic->type_parameter_count;
+    if (count > TYPE_CHECKER_MAX_TYPE_PARAMETERS) return NULL;
+
+    size_t length = intern_length(name);
+    bool failed = false;
+    for (size_t t = 0; t < count; t++) {
+        names[t] = type_to_string(arguments[t]);
+        if (names[t] == NULL) failed = true;
+        else length += 1 + strlen(names[t]);
+    }
+    char* buffer = failed ? NULL : malloc(length + 1);
+    const char* handle = NULL;
+    if (buffer != NULL) {
+        size_t offset = intern_length(name);
+        memcpy(buffer, name, offset);
+        for (size_t t = 0; t < count; t++) {
+            buffer[offset++] = '.';
+            for (const char* c = names[t]; *c != '\0'; c++) {
+                buffer[offset++] = isalnum((unsigned char)*c) || *c == '_' ? *c : '_';
+            }
+        }
+        handle = intern(buffer, offset);
+    }
+    for (size_t t = 0; t < count; t++) free(names[t]);
+    free(buffer);
+    return handle;
+}
+
+static MonoInstance* create_instance(MonoCache* cache, MonoGeneric* generic, const Type* const* arguments) {
+    const Function* function = &generic->function->data.function;
+    MonoInstance* instance = arena_alloc(cache->arena, sizeof(MonoInstance));
+    const Type** copies = arena_memdup(cache->arena, arguments, generic->type_parameter_count * sizeof(const Type*));
+    const Type** parameters = arena_alloc(cache->arena, function->parameter_count * sizeof(const Type*));
+    ASTNode* copy = ast_clone(cache->arena, generic->function, generic->type_parameters, arguments,
+                              generic->type_parameter_count);
+    const char* name = instance_name(generic, arguments);
+    if (instance == NULL || copies == NULL || parameters == NULL || copy == NULL || name == NULL) {
+        return NULL;
+    }
+
+    copy->data.function.name = name;
+    copy->data.function.type_parameters = NULL;
+    copy->data.function.type_parameter_count = 0;
+    copy->data.function.specialization = true;
+    for (size_t i = 0; i < function->parameter_count; i++) {
+        parameters[i] = type_canonical(copy->data.function.parameters[i]->type);
+    }
+
+    instance->generic = generic;
+    instance->next = NULL;
+    instance->arguments = copies;
+    instance->name = name;
+    instance->function = copy;
+    instance->parameters = parameters;
+    instance->return_type = type_canonical(copy->data.function.return_type);
+    atomic_init(&instance->state, MONO_PENDING);
+    instance->result = SLANG_SUCCESS;
+    instance->error = NULL;
+    instance->site = (TypeErrorSite){ NULL, 0, 0 };
+    return instance;
+}
+
+SlangError mono_instantiate(MonoCache* cache, const ASTNode* function, const Type* const* arguments,
+                            size_t argument_count, MonoInstance** instance) {
+    *instance = NULL;
+    pthread_mutex_lock(&cache->lock);
+    SlangError error = SLANG_SUCCESS;
+    MonoGeneric* generic = find_generic(cache, function);
+    const Type* bound[TYPE_CHECKER_MAX_TYPE_PARAMETERS];
+    if (generic == NULL) {
+        error = SLANG_ERROR_INTERNAL;
+    } else if (generic->type_parameter_count > TYPE_CHECKER_MAX_TYPE_PARAMETERS ||
+               !infer_arguments(generic, arguments, argument_count, bound)) {
+        cache->stats.fallbacks++;
+    } else if ((*instance = find_instance(generic, bound)) != NULL) {
+        cache->stats.hits++;
+    } else if (generic->instance_count >= cache->options.max_instances ||
+               cache->stats.nodes + generic->node_count > cache->options.budget) {
+        cache->stats.fallbacks++;
+    } else {
+        *instance = create_instance(cache, generic, bound);
+        if (*instance == NULL) {
+            error = SLANG_ERROR_INTERNAL;
+        } else {
+            // 作った順に並べる
+            MonoInstance** tail = &generic->instances;
+            while (*tail != NULL) tail = &(*tail)->next;
+            *tail = *instance;
+            generic->instance_count++;
+            cache->stats.instances++;
+            cache->stats.nodes += generic->node_count;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return error;
+}
+
+bool mono_claim_check(MonoCache* cache, MonoInstance* instance) {
+    pthread_mutex_lock(&cache->lock);
+    bool published = instance->generic->environment != NULL;
+    pthread_mutex_unlock(&cache->lock);
+    if (!published) return false;
+    int expected = MONO_PENDING;
+    if (!atomic_compare_exchange_strong(&instance->state, &expected, MONO_CHECKING)) return false;
+    pthread_mutex_lock(&cache->lock);
+    cache->stats.checks++;
+    pthread_mutex_unlock(&cache->lock);
+    return true;
+}
+
+void mono_finish_check(MonoCache* cache, MonoInstance* instance, SlangError result, const char* error,
+                       const TypeErrorSite* site) {
+    pthread_mutex_lock(&cache->lock);
+    instance->result = result;
+    instance->error = error;
+    instance->site = *site;
+    atomic_store_explicit(&instance->state, MONO_CHECKED, memory_order_release);
+    pthread_cond_broadcast(&cache->checked);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+bool mono_wait_check(MonoCache* cache, MonoInstance* instance) {
+    int state = atomic_load_explicit(&instance->state, memory_order_acquire);
+    if (state == MONO_CHECKING) {
+        pthread_mutex_lock(&cache->lock);
+        while ((state = atomic_load_explicit(&instance->state, memory_order_acquire)) == MONO_CHECKING) {
+            pthread_cond_wait(&cache->checked, &cache->lock);
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+    return state == MONO_CHECKED && instance->result == SLANG_SUCCESS;
+}
+
+MonoStats mono_stats(MonoCache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    MonoStats stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+    return stats;
+}
@@ -0,0 +1,1801 @@
+#include "../include/optimizer.h"
+#include "../include/ssa.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// インライン展開する関数の大きさの上限（命令数）と、展開後の呼び出し元の上限
+#define OPT_INLINE_MAX_INSTRUCTIONS 40
+#define OPT_INLINE_MAX_FUNCTION 2000
+
+typedef struct {
+    const char* name;
+    int level;
+} PassInfo;
+
+static const PassInfo pass_info[OPT_PASS_COUNT] = {
+#define OPT_PASS(id, name, level) { name, level },
+#include "../include/passes.def"
+#undef OPT_PASS
+};
+
+// 値の定義位置（SSA形式では1つ）
+typedef struct {
+    uint32_t block;
+    uint32_t index;
+} Definition;
+
+static Definition* find_definitions(const SsaFunction* ssa) {
+    size_t count = ssa->function->value_count;
+    Definition* definitions = malloc((count ? count : 1) * sizeof(Definition));
+    if (definitions == NULL) return NULL;
+    for (size_t v = 0; v < count; v++) definitions[v] = (Definition){ SSA_NO_BLOCK, 0 };
+
+    for (uint32_t b = 0; b < ssa->block_count; b++) {
+        const SsaBlock* block = &ssa->blocks[b];
+        if (block->removed) continue;
+        for (size_t i = 0; i < block->count; i++) {
+            IrValue dest = block->code[i].dest;
+            if (dest != IR_NO_VALUE) definitions[dest] = (Definition){ b, (uint32_t)i };
+        }
+    }
+    return definitions;
+}
+
+static IrValue* identity_map(size_t count) {
+    IrValue* map = malloc((count ? count : 1) * sizeof(IrValue));
+    if (map == NULL) return NULL;
+    for (size_t v = 0; v < count; v++) map[v] = (IrValue)v;
+    return map;
+}
+
+static bool is_commutative(uint8_t op) {
+    return op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NE;
+}
+
+// 整数の除算と剰余は0除算などで止まりうるので、消したり前に動かしたりしない
+static bool may_trap(const IrInstruction* instruction) {
+    return instruction->type == IR_INT && (instruction->op == IR_DIV || instruction->op == IR_MOD);
+}
+
+// 値を作るだけで副作用のない演算
+static bool is_arithmetic(uint8_t op) {
+    return (op >= IR_ADD && op <= IR_INT_TO_FLOAT) || ir_is_comparison((IrOpcode)op);
+}
+
+// ---------------------------------------------------------------------------
+// 定数伝播（Wegman & Zadeckの疎な条件付き定数伝播）
+// 値ごとに「未定・定数・可変」の束を持ち、実行されうる辺だけをたどって定数を求める。
+// 定数になった値の定義はconstに、定数の条件の分岐はjumpにし、実行されないブロックは消す。
+
+typedef enum {
+    LATTICE_UNKNOWN,
+    LATTICE_CONSTANT,
+    LATTICE_VARYING
+} LatticeState;
+
+typedef struct {
+    uint8_t state;
+    int64_t bits;              // 浮動小数点数はビット列
+} Lattice;
+
+typedef struct {
+    SsaFunction* ssa;
+    Lattice* values;
+    bool* executable;
+    uint32_t* edge_start;      // ブロックごとの辺の実行フラグの位置（先行ブロックの並び順）
+    bool* edge_executable;
+    uint32_t* use_start;       // 値ごとの使用位置（CSR）
+    Definition* uses;
+    uint32_t* block_work;
+    size_t block_work_count;
+    IrValue* value_work;
+    size_t value_work_count;
+    size_t value_work_capacity;
+} Propagation;
+
+static double bits_to_double(int64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int64_t double_to_bits(double value) {
+    int64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// 定数の演算（畳み込めなければfalse）
+static bool fold(uint8_t op, uint8_t type, int64_t x, int64_t y, int64_t* result) {
+    if (type == IR_FLOAT) {
+        double a = bits_to_double(x), b = bits_to_double(y);
+        switch (op) {
+            case IR_ADD: *result = double_to_bits(a + b); return true;
+            case IR_SUB: *result = double_to_bits(a - b); return true;
+            case IR_MUL: *result = double_to_bits(a * b); return true;
+            case IR_DIV: *result = double_to_bits(a / b); return true;
+            case IR_NEG: *result = double_to_bits(-a); return true;
+            case IR_EQ:  *result = a == b; return true;
+            case IR_NE:  *result = a != b; return true;
+            case IR_LT:  *result = a < b; return true;
+            case IR_LE:  *result = a <= b; return true;
+            case IR_GT:  *result = a > b; return true;
+            case IR_GE:  *result = a >= b; return true;
+            default:     return false;
+        }
+    }
+
+    // 整数の算術は2の補数で折り返す
+    uint64_t ua = (uint64_t)x, ub = (uint64_t)y;
+    switch (op) {
+        case IR_ADD: *result = (int64_t)(ua + ub); return true;
+        case IR_SUB: *result = (int64_t)(ua - ub); return true;
+        case IR_MUL: *result = (int64_t)(ua * ub); return true;
+        case IR_DIV:
+        case IR_MOD:
+            // 実行時に止まる演算は残す
+            if (y == 0 || (x == INT64_MIN && y == -1)) return false;
+            *result = op == IR_DIV ? x / y : x % y;
+            return true;
+        case IR_NEG: *result = (int64_t)(0 - ua); return true;
+        case IR_NOT: *result = x == 0; return true;
+        case IR_INT_TO_FLOAT: *result = double_to_bits((double)x); return true;
+        case IR_EQ:  *result = x == y; return true;
+        case IR_NE:  *result = x != y; return true;
+        case IR_LT:  *result = x < y; return true;
+        case IR_LE:  *result = x <= y; return true;
+        case IR_GT:  *result = x > y; return true;
+        case IR_GE:  *result = x >= y; return true;
+        default:     return false;
+    }
+}
+
+static const Lattice varying = { LATTICE_VARYING, 0 };
+static const Lattice unknown = { LATTICE_UNKNOWN, 0 };
+
+static Lattice constant(int64_t bits) {
+    return (Lattice){ LATTICE_CONSTANT, bits };
+}
+
+static Lattice evaluate(const Propagation* propagation, uint32_t block, const IrInstruction* instruction) {
+    const Lattice* values = propagation->values;
+    switch (instruction->op) {
+        case IR_CONST:
+            return constant(instruction->type == IR_FLOAT ? double_to_bits(instruction->imm.number)
+                                                          : instruction->imm.integer);
+        case IR_MOVE:
+            return values[instruction->a];
+        case IR_PHI: {
+            const SsaBlock* target = &propagation->ssa->blocks[block];
+            const bool* edges = &propagation->edge_executable[propagation->edge_start[block]];
+            Lattice result = unknown;
+            for (uint32_t k = 0; k < target->predecessor_count && k < instruction->arg_count; k++) {
+                if (!edges[k]) continue;
+                Lattice input = values[instruction->args[k]];
+                if (input.state == LATTICE_UNKNOWN) continue;
+                if (input.state == LATTICE_VARYING) return varying;
+                if (result.state == LATTICE_CONSTANT && result.bits != input.bits) return varying;
+                result = input;
+            }
+            return result;
+        }
+        default:
+            break;
+    }
+
+    if (!is_arithmetic(instruction->op)) return varying;
+    Lattice a = values[instruction->a];
+    Lattice b = instruction->b != IR_NO_VALUE ? values[instruction->b] : constant(0);
+    if (a.state == LATTICE_VARYING || b.state == LATTICE_VARYING) return varying;
+    if (a.state == LATTICE_UNKNOWN || b.state == LATTICE_UNKNOWN) return unknown;
+
+    int64_t result;
+    return fold(instruction->op, instruction->type, a.bits, b.bits, &result) ? constant(result) : varying;
+}
+
+static bool push_value(Propagation* propagation, IrValue value) {
+    if (propagation->value_work_count == propagation->value_work_capacity) {
+        size_t capacity = propagation->value_work_capacity ? propagation->value_work_capacity * 2 : 64;
+        IrValue* work = realloc(propagation->value_work, capacity * sizeof(IrValue));
+        if (work == NULL) return false;
+        propagation->value_work = work;
+        propagation->value_work_capacity = capacity;
+    }
+    propagation->value_work[propagation->value_work_count++] = value;
+    return true;
+}
+
+// 束の値を下げる（上がることはない）
+static bool update(Propagation* propagation, IrValue value, Lattice next) {
+    Lattice* cell = &propagation->values[value];
+    if (next.state < cell->state) return true;
+    if (next.state == cell->state && (next.state != LATTICE_CONSTANT || next.bits == cell->bits)) return true;
+    if (next.state == LATTICE_CONSTANT && cell->state == LATTICE_CONSTANT) next = varying;
+    *cell = next;
+    return push_value(propagation, value);
+}
+
+static bool visit(Propagation* propagation, uint32_t block, size_t index);
+
+static bool mark_edge(Propagation* propagation, uint32_t from, uint32_t to) {
+    const SsaBlock* target = &propagation->ssa->blocks[to];
+    uint32_t k = 0;
+    while (k < target->predecessor_count && target->predecessors[k] != from) k++;
+    bool* edge = &propagation->edge_executable[propagation->edge_start[to] + k];
+    if (k == target->predecessor_count || *edge) return true;
+    *edge = true;
+
+    if (!propagation->executable[to]) {
+        propagation->executable[to] = true;
+        propagation->block_work[propagation->block_work_count++] = to;
+        return true;
+    }
+    // 新しく実行されうる辺が増えたのでφを評価し直す
+    for (size_t i = 0; i < target->count && target->code[i].op == IR_PHI; i++) {
+        if (!visit(propagation, to, i)) return false;
+    }
+    return true;
+}
+
+static bool visit(Propagation* propagation, uint32_t block, size_t index) {
+    const SsaBlock* current = &propagation->ssa->blocks[block];
+    const IrInstruction* instruction = &current->code[index];
+
+    switch (instruction->op) {
+        case IR_JUMP:
+            return mark_edge(propagation, block, current->successors[0]);
+        case IR_BRANCH_FALSE: {
+            Lattice condition = propagation->values[instruction->a];
+            if (condition.state == LATTICE_UNKNOWN) return true;
+            if (condition.state == LATTICE_VARYING) {
+                return mark_edge(propagation, block, current->successors[0]) &&
+                       mark_edge(propagation, block, current->successors[1]);
+            }
+            bool truth = propagation->ssa->function->value_types[instruction->a] == IR_FLOAT
+                ? bits_to_double(condition.bits) != 0.0
+                : condition.bits != 0;
+            return mark_edge(propagation, block, current->successors[truth ? 1 : 0]);
+        }
+        case IR_RETURN:
+            return true;
+        default:
+            break;
+    }
+    if (instruction->dest == IR_NO_VALUE) return true;
+    return update(propagation, instruction->dest, evaluate(propagation, block, instruction));
+}
+
+// 使用位置の一覧
+static bool build_uses(Propagation* propagation) {
+    SsaFunction* ssa = propagation->ssa;
+    size_t value_count = ssa->function->value_count;
+    propagation->use_start = calloc(value_count + 1, sizeof(uint32_t));
+    if (propagation->use_start == NULL) return false;
+
+    size_t total = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t b = 0; b < ssa->block_count; b++) {
+            const SsaBlock* block = &ssa->blocks[b];
+            if (block->removed) continue;
+            for (size_t i = 0; i < block->count; i++) {
+                const IrInstruction* instruction = &block->code[i];
+                for (uint32_t k = 0; k < instruction->arg_count + 2; k++) {
+                    IrValue use = k == 0 ? instruction->a : k == 1 ? instruction->b : instruction->args[k - 2];
+                    if (use == IR_NO_VALUE) continue;
+                    if (pass == 0) {
+                        propagation->use_start[use + 1]++;
+                        total++;
+                    } else {
+                        propagation->uses[propagation->use_start[use]++] = (Definition){ b, (uint32_t)i };
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (size_t v = 0; v < value_count; v++) propagation->use_start[v + 1] += propagation->use_start[v];
+            propagation->uses = malloc((total ? total : 1) * sizeof(Definition));
+            if (propagation->uses == NULL) return false;
+        }
+    }
+    // 埋めるときに進めた開始位置を戻す
+    for (size_t v = value_count; v > 0; v--) propagation->use_start[v] = propagation->use_start[v - 1];
+    propagation->use_start[0] = 0;
+    return true;
+}
+
+static void free_propagation(Propagation* propagation) {
+    free(propagation->values);
+    free(propagation->executable);
+    free(propagation->edge_start);
+    free(propagation->edge_executable);
+    free(propagation->use_start);
+    free(propagation->uses);
+    free(propagation->block_work);
+    free(propagation->value_work);
+}
+
+// φを先頭にまとめ直す（定数になったφをconstにした後）
+static void gather_phis(SsaBlock* block) {
+    size_t phis = 0;
+    for (size_t i = 0; i < block->count; i++) {
+        if (block->code[i].op != IR_PHI) continue;
+        IrInstruction phi = block->code[i];
+        memmove(&block->code[phis + 1], &block->code[phis], (i - phis) * sizeof(IrInstruction));
+        block->code[phis++] = phi;
+    }
+}
+
+static SlangError run_constprop(SsaFunction* ssa) {
+    size_t value_count = ssa->function->value_count;
+    size_t block_count = ssa->block_count;
+    Propagation propagation;
+    memset(&propagation, 0, sizeof(propagation));
+    propagation.ssa = ssa;
+    propagation.values = calloc(value_count ? value_count : 1, sizeof(Lattice));
+    propagation.executable = calloc(block_count, sizeof(bool));
+    propagation.edge_start = malloc((block_count + 1) * sizeof(uint32_t));
+    // 1つのブロックは一度だけ実行可能になる
+    propagation.block_work = malloc(block_count * sizeof(uint32_t));
+    if (propagation.values == NULL || propagation.executable == NULL || propagation.edge_start == NULL ||
+        propagation.block_work == NULL || !build_uses(&propagation)) {
+        free_propagation(&propagation);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    propagation.edge_start[0] = 0;
+    for (size_t b = 0; b < block_count; b++) {
+        propagation.edge_start[b + 1] = propagation.edge_start[b] + ssa->blocks[b].predecessor_count;
+    }
+    propagation.edge_executable = calloc(propagation.edge_start[block_count] + 1, sizeof(bool));
+    if (propagation.edge_executable == NULL) {
+        free_propagation(&propagation);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    bool ok = true;
+    propagation.executable[0] = true;
+    propagation.block_work[propagation.block_work_count++] = 0;
+    while (ok && (propagation.block_work_count > 0 || propagation.value_work_count > 0)) {
+        while (ok && propagation.value_work_count > 0) {
+            IrValue value = propagation.value_work[--propagation.value_work_count];
+            for (uint32_t u = propagation.use_start[value]; ok && u < propagation.use_start[value + 1]; u++) {
+                Definition use = propagation.uses[u];
+                if (propagation.executable[use.block]) ok = visit(&propagation, use.block, use.index);
+            }
+        }
+        if (ok && propagation.block_work_count > 0) {
+            uint32_t b = propagation.block_work[--propagation.block_work_count];
+            for (size_t i = 0; ok && i < ssa->blocks[b].count; i++) ok = visit(&propagation, b, i);
+        }
+    }
+    if (!ok) {
+        free_propagation(&propagation);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    // 書き換え
+    for (uint32_t b = 0; b < block_count; b++) {
+        SsaBlock* block = &ssa->blocks[b];
+        if (block->removed || !propagation.executable[b]) continue;
+
+        bool phi_folded = false;
+        for (size_t i = 0; i < block->count; i++) {
+            IrInstruction* instruction = &block->code[i];
+            if (instruction->dest == IR_NO_VALUE || instruction->op == IR_CONST) continue;
+            Lattice value = propagation.values[instruction->dest];
+            if (value.state != LATTICE_CONSTANT) continue;
+
+            uint8_t type = ssa->function->value_types[instruction->dest];
+            IrValue dest = instruction->dest;
+            phi_folded = phi_folded || instruction->op == IR_PHI;
+            ssa_delete(instruction);
+            instruction->op = IR_CONST;
+            instruction->type = type;
+            instruction->dest = dest;
+            if (type == IR_FLOAT) {
+                instruction->imm.number = bits_to_double(value.bits);
+            } else {
+                instruction->imm.integer = value.bits;
+            }
+        }
+        if (phi_folded) gather_phis(block);
+
+        IrInstruction* last = &block->code[block->count - 1];
+        if (last->op != IR_BRANCH_FALSE) continue;
+        Lattice condition = propagation.values[last->a];
+        if (condition.state == LATTICE_VARYING) continue;
+
+        // 分岐しない方の辺を消す（条件が未定のままなら偽の側を残す）
+        bool truth = condition.state == LATTICE_CONSTANT &&
+                     (ssa->function->value_types[last->a] == IR_FLOAT ? bits_to_double(condition.bits) != 0.0
+                                                                      : condition.bits != 0);
+        uint32_t kept = block->successors[truth ? 1 : 0];
+        uint32_t dropped = block->successors[truth ? 0 : 1];
+        ssa_remove_predecessor(ssa, dropped, b);
+        last->op = IR_JUMP;
+        last->a = IR_NO_VALUE;
+        block->successors[0] = kept;
+        block->successor_count = 1;
+    }
+
+    // 実行されないブロックへの辺を残さないよう、到達しないブロックとして取り除く
+    for (uint32_t b = 0; b < block_count; b++) {
+        if (!propagation.executable[b]) continue;
+        SsaBlock* block = &ssa->blocks[b];
+        for (uint32_t s = 0; s < block->successor_count; s++) {
+            if (!propagation.executable[block->successors[s]]) {
+                // 実行可能な分岐は両方の辺が実行可能になっているので、ここには来ない
+                free_propagation(&propagation);
+                return SLANG_ERROR_INTERNAL;
+            }
+        }
+    }
+
+    free_propagation(&propagation);
+    ssa_compact(ssa);
+    return ssa_analyze(ssa);
+}
+
+// ---------------------------------------------------------------------------
+// コピー伝播
+// コピーと、入力が自分自身か1つの値だけのφを消し、整数の恒等式（x+0、x-0、x*1、x*0、x-x）を簡約する。
+
+typedef struct {
+    bool* known;
+    int64_t* values;
+} IntConstants;
+
+static void find_int_constants(const SsaFunction* ssa, IntConstants* constants, size_t count) {
+    memset(constants->known, 0, count * sizeof(bool));
+    for (uint32_t b = 0; b < ssa->block_count; b++) {
+        const SsaBlock* block = &ssa->blocks[b];
+        if (block->removed) continue;
+        for (size_t i = 0; i < block->count; i++) {
+            const IrInstruction* instruction = &block->code[i];
+            if (instruction->op != IR_CONST || instruction->type != IR_INT) continue;
+            constants->known[instruction->dest] = true;
+            constants->values[instruction->dest] = instruction->imm.integer;
+        }
+    }
+}
+
+static bool is_int_constant(const IntConstants* constants, IrValue value, int64_t expected) {
+    return value != IR_NO_VALUE && constants->known[value] && constants->values[value] == expected;
+}
+
+// 簡約した結果（置き換え先の値、またはconst 0）
+static bool simplify(const IntConstants* constants, IrInstruction* instruction, IrValue* replacement, bool* zero) {
+    *zero = false;
+    if (instruction->type != IR_INT) return false;
+    IrValue a = instruction->a, b = instruction->b;
+    switch (instruction->op) {
+        case IR_ADD:
+            if (is_int_constant(constants, b, 0)) *replacement = a;
+            else if (is_int_constant(constants, a, 0)) *replacement = b;
+            else return false;
+            return true;
+        case IR_SUB:
+            if (is_int_constant(constants, b, 0)) {
+                *replacement = a;
+                return true;
+            }
+            *zero = a == b;
+            return *zero;
+        case IR_MUL:
+            if (is_int_constant(constants, b, 1)) *replacement = a;
+            else if (is_int_constant(constants, a, 1)) *replacement = b;
+            else *zero = is_int_constant(constants, a, 0) || is_int_constant(constants, b, 0);
+            return *zero || *replacement != IR_NO_VALUE;
+        default:
+            return false;
+    }
+}
+
+static SlangError run_copyprop(SsaFunction* ssa) {
+    size_t count = ssa->function->value_count;
+    IrValue* replacement = identity_map(count);
+    IntConstants constants;
+    constants.known = malloc((count ? count : 1) * sizeof(bool));
+    constants.values = malloc((count ? count : 1) * sizeof(int64_t));
+    if (replacement == NULL || constants.known == NULL || constants.values == NULL) {
+        free(replacement);
+        free(constants.known);
+        free(constants.values);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        find_int_constants(ssa, &constants, count);
+        for (uint32_t b = 0; b < ssa->block_count; b++) {
+            SsaBlock* block = &ssa->blocks[b];
+            if (block->removed) continue;
+            for (size_t i = 0; i < block->count; i++) {
+                IrInstruction* instruction = &block->code[i];
+                IrValue dest = instruction->dest;
+                IrValue target = IR_NO_VALUE;
+                bool zero = false;
+
+                if (instruction->op == IR_MOVE) {
+                    target = ssa_resolve(replacement, count, instruction->a);
+                } else if (instruction->op == IR_PHI) {
+                    bool trivial = true;
+                    for (uint32_t k = 0; k < instruction->arg_count && trivial; k++) {
+                        IrValue input = ssa_resolve(replacement, count, instruction->args[k]);
+                        if (input == dest || input == target) continue;
+                        if (target == IR_NO_VALUE) target = input;
+                        else trivial = false;
+                    }
+                    if (!trivial) target = IR_NO_VALUE;
+                } else if (!simplify(&constants, instruction, &target, &zero)) {
+                    continue;
+                }
+
+                if (zero) {
+                    ssa_delete(instruction);
+                    instruction->op = IR_CONST;
+                    instruction->dest = dest;
+                    changed = true;
+                } else if (target != IR_NO_VALUE && target != dest) {
+                    replacement[dest] = target;
+                    ssa_delete(instruction);
+                    changed = true;
+                }
+            }
+        }
+        ssa_replace_values(ssa, replacement, count);
+    }
+
+    free(replacement);
+    free(constants.known);
+    free(constants.values);
+    ssa_compact(ssa);
+    return SLANG_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// 共通部分式削除
+// 支配木を前順にたどり、支配する位置に同じ演算があれば結果を使い回す。
+// 表はスコープ付きで、子の部分木を抜けるときにそこで登録した式を取り除く。
+// 整数の定数は即値として命令に埋め込まれるので共有しない。
+
+typedef struct {
+    uint8_t op;
+    uint8_t type;
+    IrValue a;
+    IrValue b;
+    int64_t imm;
+    const char* symbol;
+    IrValue value;
+    uint32_t next;             // 同じバケットの次の項目
+    uint32_t bucket;
+} Expression;
+
+typedef struct {
+    SsaFunction* ssa;
+    IrValue* replacement;
+    size_t value_count;
+    uint32_t* heads;
+    size_t mask;
+    Expression* entries;
+    size_t count;
+    size_t capacity;
+    bool failed;
+} ValueNumbering;
+
+static bool is_cse_candidate(const IrInstruction* instruction) {
+    if (instruction->dest == IR_NO_VALUE) return false;
+    if (instruction->op == IR_CONST) return instruction->type == IR_FLOAT;
+    return instruction->op == IR_ADDRESS || is_arithmetic(instruction->op);
+}
+
+static uint64_t expression_hash(const Expression* e) {
+    uint64_t hash = ((uint64_t)e->op << 56) ^ ((uint64_t)e->type << 48);
+    hash ^= (uint64_t)e->a * 0x9E3779B97F4A7C15ull;
+    hash ^= (uint64_t)e->b * 0xC2B2AE3D27D4EB4Full;
+    hash ^= (uint64_t)e->imm * 0x165667B19E3779F9ull;
+    hash ^= (uint64_t)(uintptr_t)e->symbol;
+    return hash ^ (hash >> 29);
+}
+
+static bool same_expression(const Expression* x, const Expression* y) {
+    return x->op == y->op && x->type == y->type && x->a == y->a && x->b == y->b && x->imm == y->imm &&
+           (x->symbol == y->symbol || (x->symbol && y->symbol && strcmp(x->symbol, y->symbol) == 0));
+}
+
+static void number_block(ValueNumbering* numbering, uint32_t index) {
+    SsaFunction* ssa = numbering->ssa;
+    size_t saved = numbering->count;
+
+    SsaBlock* block = &ssa->blocks[index];
+    for (size_t i = 0; i < block->count && !numbering->failed; i++) {
+        IrInstruction* instruction = &block->code[i];
+        instruction->a = ssa_resolve(numbering->replacement, numbering->value_count, instruction->a);
+        instruction->b = ssa_resolve(numbering->replacement, numbering->value_count, instruction->b);
+        if (!is_cse_candidate(instruction)) continue;
+
+        // 可換な演算は表の上でだけ被演算子を並べ替える（定数を右に置いた命令はそのまま即値にできる）
+        Expression key;
+        memset(&key, 0, sizeof(key));
+        key.op = instruction->op;
+        key.type = instruction->type;
+        key.a = instruction->a;
+        key.b = instruction->b;
+        if (is_commutative(instruction->op) && key.a > key.b) {
+            key.a = instruction->b;
+            key.b = instruction->a;
+        }
+        key.symbol = instruction->symbol;
+        if (instruction->op == IR_CONST) key.imm = double_to_bits(instruction->imm.number);
+        uint32_t bucket = (uint32_t)(expression_hash(&key) & numbering->mask);
+
+        uint32_t found = numbering->heads[bucket];
+        while (found != UINT32_MAX && !same_expression(&numbering->entries[found], &key)) {
+            found = numbering->entries[found].next;
+        }
+        if (found != UINT32_MAX) {
+            numbering->replacement[instruction->dest] = numbering->entries[found].value;
+            ssa_delete(instruction);
+            continue;
+        }
+
+        if (numbering->count == numbering->capacity) {
+            size_t capacity = numbering->capacity ? numbering->capacity * 2 : 64;
+            Expression* entries = realloc(numbering->entries, capacity * sizeof(Expression));
+            if (entries == NULL) {
+                numbering->failed = true;
+                break;
+            }
+            numbering->entries = entries;
+            numbering->capacity = capacity;
+        }
+        key.value = instruction->dest;
+        key.bucket = bucket;
+        key.next = numbering->heads[bucket];
+        numbering->entries[numbering->count] = key;
+        numbering->heads[bucket] = (uint32_t)numbering->count++;
+    }
+
+    for (uint32_t child = ssa->blocks[index].dom_child; child != SSA_NO_BLOCK && !numbering->failed;
+         child = ssa->blocks[child].dom_sibling) {
+        number_block(numbering, child);
+    }
+
+    // この部分木で登録した式を新しい順に外す
+    while (numbering->count > saved) {
+        const Expression* entry = &numbering->entries[--numbering->count];
+        numbering->heads[entry->bucket] = entry->next;
+    }
+}
+
+static SlangError run_cse(SsaFunction* ssa) {
+    size_t instructions = ssa_instruction_count(ssa);
+    size_t buckets = 16;
+    while (buckets < instructions * 2) buckets *= 2;
+
+    ValueNumbering numbering;
+    memset(&numbering, 0, sizeof(numbering));
+    numbering.ssa = ssa;
+    numbering.value_count = ssa->function->value_count;
+    numbering.replacement = identity_map(numbering.value_count);
+    numbering.heads = malloc(buckets * sizeof(uint32_t));
+    numbering.mask = buckets - 1;
+    if (numbering.replacement == NULL || numbering.heads == NULL) {
+        free(numbering.replacement);
+        free(numbering.heads);
+        return SLANG_ERROR_INTERNAL;
+    }
+    for (size_t i = 0; i < buckets; i++) numbering.heads[i] = UINT32_MAX;
+
+    number_block(&numbering, 0);
+    // φの入力は支配木の順に現れないので最後にまとめて置き換える
+    ssa_replace_values(ssa, numbering.replacement, numbering.value_count);
+
+    free(numbering.replacement);
+    free(numbering.heads);
+    free(numbering.entries);
+    ssa_compact(ssa);
+    return numbering.failed ? SLANG_ERROR_INTERNAL : SLANG_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// ループ不変式の移動
+// 後退辺（支配するブロックへの辺）から自然ループを求め、各ヘッダに専用の前ブロック
+// （preheader）を用意してから、内側のループから順に、ループの外で定義された値だけを
+// 読む副作用のない演算を前ブロックへ移す。グローバル変数の読み出しは、ループの中に
+// 呼び出しと同じ変数への書き込みがなければ移す。
+
+typedef struct {
+    uint32_t header;
+    uint32_t* blocks;
+    size_t count;
+} Loop;
+
+static void free_loops(Loop* loops, size_t count) {
+    for (size_t i = 0; i < count; i++) free(loops[i].blocks);
+    free(loops);
+}
+
+static int compare_loops(const void* x, const void* y) {
+    const Loop* a = x;
+    const Loop* b = y;
+    if (a->count != b->count) return a->count < b->count ? -1 : 1;
+    return a->header < b->header ? -1 : a->header > b->header;
+}
+
+// 自然ループ（同じヘッダの後退辺はまとめる）。内側のループが先に来るよう大きさの順に並べる
+static bool find_loops(const SsaFunction* ssa, Loop** out_loops, size_t* loop_count) {
+    size_t n = ssa->block_count;
+    uint32_t* mark = malloc(n * sizeof(uint32_t));
+    uint32_t* stack = malloc(n * sizeof(uint32_t));
+    Loop* loops = NULL;
+    size_t count = 0, capacity = 0;
+    bool ok = mark != NULL && stack != NULL;
+    for (size_t b = 0; ok && b < n; b++) mark[b] = UINT32_MAX;
+
+    for (size_t i = 0; ok && i < ssa->order_count; i++) {
+        uint32_t header = ssa->order[i];
+        const SsaBlock* block = &ssa->blocks[header];
+        size_t depth = 0;
+        for (uint32_t k = 0; k < block->predecessor_count; k++) {
+            uint32_t latch = block->predecessors[k];
+            if (!ssa_dominates(ssa, header, latch) || mark[latch] == header) continue;
+            mark[latch] = header;
+            stack[depth++] = latch;
+        }
+        if (depth == 0) continue;
+
+        Loop loop = { header, malloc(n * sizeof(uint32_t)), 0 };
+        if (loop.blocks == NULL) {
+            ok = false;
+            break;
+        }
+        mark[header] = header;
+        loop.blocks[loop.count++] = header;
+        while (depth > 0) {
+            uint32_t b = stack[--depth];
+            if (b != header) loop.blocks[loop.count++] = b;
+            const SsaBlock* body = &ssa->blocks[b];
+            if (b == header) continue;
+            for (uint32_t k = 0; k < body->predecessor_count; k++) {
+                uint32_t p = body->predecessors[k];
+                if (mark[p] == header) continue;
+                mark[p] = header;
+                stack[depth++] = p;
+            }
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            Loop* grown = realloc(loops, capacity * sizeof(Loop));
+            if (grown == NULL) {
+                free(loop.blocks);
+                ok = false;
+                break;
+            }
+            loops = grown;
+        }
+        loops[count++] = loop;
+    }
+
+    free(mark);
+    free(stack);
+    if (!ok) {
+        free_loops(loops, count);
+        return false;
+    }
+    if (count > 0) qsort(loops, count, sizeof(Loop), compare_loops);
+    *out_loops = loops;
+    *loop_count = count;
+    return true;
+}
+
+static bool in_loop(const Loop* loop, uint32_t block) {
+    for (size_t i = 0; i < loop->count; i++) {
+        if (loop->blocks[i] == block) return true;
+    }
+    return false;
+}
+
+// ループの外から入る辺が1本で、その先行ブロックがヘッダにしか進まなければ、それが前ブロック
+static uint32_t find_preheader(const SsaFunction* ssa, const Loop* loop) {
+    const SsaBlock* header = &ssa->blocks[loop->header];
+    uint32_t preheader = SSA_NO_BLOCK;
+    for (uint32_t k = 0; k < header->predecessor_count; k++) {
+        uint32_t p = header->predecessors[k];
+        if (in_loop(loop, p)) continue;
+        if (preheader != SSA_NO_BLOCK) return SSA_NO_BLOCK;
+        preheader = p;
+    }
+    if (preheader == SSA_NO_BLOCK || ssa->blocks[preheader].successor_count != 1) return SSA_NO_BLOCK;
+    return preheader;
+}
+
+// ループの外から入る辺をすべて新しい前ブロックに集める
+static bool insert_preheader(SsaFunction* ssa, const Loop* loop) {
+    uint32_t h = loop->header;
+    uint32_t preheader = ssa_new_block(ssa);
+    if (preheader == SSA_NO_BLOCK) return false;
+    IrInstruction* jump = ssa_insert(ssa, preheader, 0);
+    if (jump == NULL) return false;
+    jump->op = IR_JUMP;
+    ssa->blocks[preheader].successors[0] = h;
+    ssa->blocks[preheader].successor_count = 1;
+    ssa->blocks[preheader].place_before = h;
+
+    // 外から来る辺と中から来る辺に分ける
+    uint32_t predecessor_count = ssa->blocks[h].predecessor_count;
+    bool* outside = malloc(predecessor_count * sizeof(bool));
+    if (outside == NULL) return false;
+    uint32_t outside_count = 0;
+    for (uint32_t k = 0; k < predecessor_count; k++) {
+        uint32_t p = ssa->blocks[h].predecessors[k];
+        outside[k] = !in_loop(loop, p);
+        if (!outside[k]) continue;
+        outside_count++;
+        if (!ssa_add_predecessor(ssa, preheader, p)) {
+            free(outside);
+            return false;
+        }
+        SsaBlock* block = &ssa->blocks[p];
+        for (uint32_t s = 0; s < block->successor_count; s++) {
+            if (block->successors[s] == h) block->successors[s] = preheader;
+        }
+    }
+
+    // ヘッダのφは、外からの入力を前ブロックのφ（入力が1つならその値）にまとめる
+    size_t phi_count = ssa_first_non_phi(&ssa->blocks[h]);
+    for (size_t i = 0; i < phi_count; i++) {
+        IrInstruction* phi = &ssa->blocks[h].code[i];
+        IrValue incoming = IR_NO_VALUE;
+        if (outside_count == 1) {
+            for (uint32_t k = 0; k < predecessor_count; k++) {
+                if (outside[k]) incoming = phi->args[k];
+            }
+        } else {
+            IrValue* args = malloc(outside_count * sizeof(IrValue));
+            IrValue dest = ir_new_value(ssa->function, (IrType)phi->type);
+            IrInstruction* merged = args != NULL && dest != IR_NO_VALUE
+                ? ssa_insert(ssa, preheader, ssa->blocks[preheader].count - 1) : NULL;
+            if (merged == NULL) {
+                free(args);
+                free(outside);
+                return false;
+            }
+            phi = &ssa->blocks[h].code[i];
+            uint32_t j = 0;
+            for (uint32_t k = 0; k < predecessor_count; k++) {
+                if (outside[k]) args[j++] = phi->args[k];
+            }
+            merged->op = IR_PHI;
+            merged->type = phi->type;
+            merged->dest = dest;
+            merged->args = args;
+            merged->arg_count = outside_count;
+            incoming = dest;
+        }
+
+        // 外からの入力を先頭の1つにまとめる（外からの辺は1本以上あるので配列に収まる）
+        uint32_t inside = 0;
+        for (uint32_t k = 0; k < predecessor_count; k++) {
+            if (!outside[k]) phi->args[inside++] = phi->args[k];
+        }
+        memmove(&phi->args[1], &phi->args[0], inside * sizeof(IrValue));
+        phi->args[0] = incoming;
+        phi->arg_count = inside + 1;
+    }
+
+    SsaBlock* header = &ssa->blocks[h];
+    uint32_t inside = 0;
+    for (uint32_t k = 0; k < predecessor_count; k++) {
+        if (!outside[k]) header->predecessors[inside++] = header->predecessors[k];
+    }
+    memmove(&header->predecessors[1], &header->predecessors[0], inside * sizeof(uint32_t));
+    header->predecessors[0] = preheader;
+    header->predecessor_count = inside + 1;
+    free(outside);
+    return true;
+}
+
+static bool is_hoistable(const SsaFunction* ssa, const Definition* definitions, const IrInstruction* instruction) {
+    if (instruction->dest == IR_NO_VALUE) return false;
+    if (instruction->op == IR_CONST || instruction->op == IR_ADDRESS) return true;
+    if (!is_arithmetic(instruction->op)) return false;
+    if (!may_trap(instruction)) return true;
+
+    // 整数の除算は、除数が0でも-1でもない定数のときだけ移す
+    Definition divisor = definitions[instruction->b];
+    if (divisor.block == SSA_NO_BLOCK) return false;
+    const IrInstruction* source = &ssa->blocks[divisor.block].code[divisor.index];
+    return source->op == IR_CONST && source->imm.integer != 0 && source->imm.integer != -1;
+}
+
+// ループの中の呼び出しとグローバル変数への書き込み
+typedef struct {
+    bool has_call;             // 呼び出しか、書き込み先のわからないベクトル演算がある
+    const char** stores;
+    size_t store_count;
+} LoopEffects;
+
+static bool loop_effects(const SsaFunction* ssa, const Loop* loop, LoopEffects* effects) {
+    effects->has_call = false;
+    effects->store_count = 0;
+    size_t capacity = 0;
+    effects->stores = NULL;
+    for (size_t i = 0; i < loop->count; i++) {
+        const SsaBlock* block = &ssa->blocks[loop->blocks[i]];
+        for (size_t j = 0; j < block->count; j++) {
+            const IrInstruction* instruction = &block->code[j];
+            if (instruction->op == IR_CALL || (ir_is_vector((IrOpcode)instruction->op) && instruction->dest == IR_NO_VALUE)) {
+                effects->has_call = true;
+            }
+            if (instruction->op != IR_STORE_GLOBAL) continue;
+            if (effects->store_count == capacity) {
+                capacity = capacity ? capacity * 2 : 4;
+                const char** stores = realloc(effects->stores, capacity * sizeof(const char*));
+                if (stores == NULL) return false;
+                effects->stores = stores;
+            }
+            effects->stores[effects->store_count++] = instruction->symbol;
+        }
+    }
+    return true;
+}
+
+static bool load_is_invariant(const LoopEffects* effects, const char* symbol) {
+    if (effects->has_call) return false;
+    for (size_t i = 0; i < effects->store_count; i++) {
+        if (effects->stores[i] == symbol || strcmp(effects->stores[i], symbol) == 0) return false;
+    }
+    return true;
+}
+
+static bool hoist_loop(SsaFunction* ssa, const Loop* loop, Definition* definitions) {
+    uint32_t preheader = find_preheader(ssa, loop);
+    if (preheader == SSA_NO_BLOCK) return true;
+
+    LoopEffects effects;
+    if (!loop_effects(ssa, loop, &effects)) return false;
+
+    // ループのブロックを逆後順に並べる（定義が使用より先に来る）
+    uint32_t* body = malloc(loop->count * sizeof(uint32_t));
+    if (body == NULL) {
+        free(effects.stores);
+        return false;
+    }
+    size_t body_count = 0;
+    for (size_t i = 0; i < ssa->order_count; i++) {
+        if (in_loop(loop, ssa->order[i])) body[body_count++] = ssa->order[i];
+    }
+
+    bool changed = true;
+    while (changed && !ssa->failed) {
+        changed = false;
+        for (size_t i = 0; i < body_count; i++) {
+            uint32_t b = body[i];
+            for (size_t j = ssa_first_non_phi(&ssa->blocks[b]); j < ssa->blocks[b].count; j++) {
+                IrInstruction instruction = ssa->blocks[b].code[j];
+                bool candidate = instruction.op == IR_LOAD_GLOBAL
+                    ? load_is_invariant(&effects, instruction.symbol)
+                    : is_hoistable(ssa, definitions, &instruction);
+                if (!candidate) continue;
+
+                bool invariant = true;
+                IrValue operands[2] = { instruction.a, instruction.b };
+                for (int k = 0; k < 2 && invariant; k++) {
+                    if (operands[k] == IR_NO_VALUE) continue;
+                    uint32_t def_block = definitions[operands[k]].block;
+                    invariant = def_block != SSA_NO_BLOCK && !in_loop(loop, def_block);
+                }
+                if (!invariant) continue;
+
+                size_t position = ssa->blocks[preheader].count - 1;
+                IrInstruction* moved = ssa_insert(ssa, preheader, position);
+                if (moved == NULL) break;
+                *moved = instruction;
+                definitions[instruction.dest] = (Definition){ preheader, (uint32_t)position };
+                // 元の位置はnopにする（引数の配列は移した）
+                IrInstruction* original = &ssa->blocks[b].code[j];
+                original->args = NULL;
+                ssa_delete(original);
+                changed = true;
+            }
+        }
+    }
+
+    free(body);
+    free(effects.stores);
+    return !ssa->failed;
+}
+
+static SlangError run_licm(SsaFunction* ssa) {
+    // まず前ブロックを用意する
+    Loop* loops = NULL;
+    size_t loop_count = 0;
+    if (!find_loops(ssa, &loops, &loop_count)) return SLANG_ERROR_INTERNAL;
+    bool ok = true;
+    bool inserted = false;
+    for (size_t i = 0; i < loop_count && ok; i++) {
+        if (find_preheader(ssa, &loops[i]) != SSA_NO_BLOCK) continue;
+        ok = insert_preheader(ssa, &loops[i]);
+        inserted = true;
+    }
+    if (!ok) {
+        free_loops(loops, loop_count);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    // 前ブロックは外側のループにも属するので、ループを求め直してから移す
+    if (inserted) {
+        free_loops(loops, loop_count);
+        SlangError error = ssa_analyze(ssa);
+        if (error != SLANG_SUCCESS) return error;
+        if (!find_loops(ssa, &loops, &loop_count)) return SLANG_ERROR_INTERNAL;
+    }
+
+    Definition* definitions = loop_count > 0 ? find_definitions(ssa) : NULL;
+    if (loop_count > 0 && definitions == NULL) {
+        free_loops(loops, loop_count);
+        return SLANG_ERROR_INTERNAL;
+    }
+    for (size_t i = 0; i < loop_count && ok; i++) ok = hoist_loop(ssa, &loops[i], definitions);
+
+    free(definitions);
+    free_loops(loops, loop_count);
+    ssa_compact(ssa);
+    return ok ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+}
+
+// ---------------------------------------------------------------------------
+// エスケープ解析
+// IR_ALLOCのブロックを指す値（IR_ADDで作った内側のポインタを含む）がどこで使われるかを調べる。
+// ベクトル演算の被演算子と書き込み先、要素の読み書き、借用で渡す呼び出しの引数（IR_CALLのimm.integer）、IR_DROPでしか
+// 使われないブロックは関数の外へ出ないので、フレームに置いて（IR_STACK_ALLOC）IR_DROPを消す（中身は
+// doubleだけなので解放のほかにすることがない）。返す・グローバル変数に書く・所有権ごと渡す・φで合流する
+// などのほかの使い方はすべて外へ出るとみなす。φを通らないので、ループの中の同じ命令が毎回同じ領域を
+// 返しても前の回のブロックとは重ならない。
+// その前に、要素ごとの演算（複製を含む）の結果の一時ブロックを、同じブロックの中でその演算が最後に読む
+// 一時ブロックに置き換える（ムーブで置き場所を受け継ぎ、結果のブロックの確保と読んだブロックの解放を省く）。
+
+#define OPT_ESCAPE_MAX_BLOCK 4096           // フレームに置くブロックの大きさの上限
+#define OPT_ESCAPE_MAX_FRAME (64 * 1024)    // 関数ごとにフレームに置く合計の上限
+
+#define ESCAPE_NO_USE UINT32_MAX
+
+typedef struct {
+    uint32_t block;
+    uint32_t index;
+    uint32_t next;             // 同じIR_ALLOCのブロックの次の使用
+} EscapeUse;
+
+typedef struct {
+    SsaFunction* ssa;
+    Definition* definitions;
+    IrValue* roots;            // 値が指すIR_ALLOCの結果（指さなければIR_NO_VALUE）
+    IrValue* merged;           // 置き換えたIR_ALLOCの結果の置き換え先（置き換えていなければ自分）
+    bool* escapes;             // IR_ALLOCの結果ごとに、外へ出るか
+    uint32_t* first_use;       // IR_ALLOCの結果ごとの使用の一覧
+    uint32_t* last_use;
+    EscapeUse* uses;
+    size_t use_count;
+    size_t use_capacity;
+} Escape;
+
+static IrValue escape_root(Escape* escape, IrValue value) {
+    if (value == IR_NO_VALUE || escape->roots[value] == IR_NO_VALUE) return IR_NO_VALUE;
+    IrValue root = escape->roots[value];
+    while (escape->merged[root] != root) root = escape->merged[root];
+    return root;
+}
+
+static IrInstruction* escape_at(const Escape* escape, const EscapeUse* use) {
+    return &escape->ssa->blocks[use->block].code[use->index];
+}
+
+static bool escape_add_use(Escape* escape, IrValue root, uint32_t block, uint32_t index) {
+    if (escape->use_count == escape->use_capacity) {
+        size_t capacity = escape->use_capacity ? escape->use_capacity * 2 : 64;
+        EscapeUse* uses = realloc(escape->uses, capacity * sizeof(EscapeUse));
+        if (uses == NULL) return false;
+        escape->uses = uses;
+        escape->use_capacity = capacity;
+    }
+    uint32_t use = (uint32_t)escape->use_count++;
+    escape->uses[use] = (EscapeUse){ block, index, ESCAPE_NO_USE };
+    if (escape->first_use[root] == ESCAPE_NO_USE) escape->first_use[root] = use;
+    else escape->uses[escape->last_use[root]].next = use;
+    escape->last_use[root] = use;
+    return true;
+}
+
+// k番目の被演算子（0がa、1がb、それ以降がargs）として使ってもブロックが外へ出ないか
+static bool keeps_local(Escape* escape, const IrInstruction* instruction, uint32_t k, IrValue use, IrValue root) {
+    if (ir_is_vector((IrOpcode)instruction->op)) return true;
+    switch (instruction->op) {
+        case IR_DROP:
+            return use == root;
+        case IR_LOAD:
+        case IR_STORE:
+            return k == 0;
+        case IR_CALL:
+            return k >= 2 && k - 2 < 64 && ((uint64_t)instruction->imm.integer >> (k - 2) & 1);
+        case IR_MOVE:
+        case IR_ADD:
+        case IR_SUB:
+            return escape_root(escape, instruction->dest) == root;
+        default:
+            return false;
+    }
+}
+
+// 値が指すブロックを求め、ブロックごとに使用を集めて外へ出るかを決める
+static bool escape_collect(Escape* escape) {
+    SsaFunction* ssa = escape->ssa;
+    // 逆後順なら定義が使用より先に来る（φは合流なので指す先を引き継がない）
+    for (size_t o = 0; o < ssa->order_count; o++) {
+        const SsaBlock* block = &ssa->blocks[ssa->order[o]];
+        for (size_t i = 0; i < block->count; i++) {
+            const IrInstruction* instruction = &block->code[i];
+            if (instruction->dest == IR_NO_VALUE) continue;
+            IrValue a = escape_root(escape, instruction->a);
+            IrValue b = escape_root(escape, instruction->b);
+            if (instruction->op == IR_ALLOC) {
+                escape->roots[instruction->dest] = instruction->dest;
+            } else if (instruction->op == IR_MOVE || (instruction->op == IR_SUB && b == IR_NO_VALUE)) {
+                escape->roots[instruction->dest] = a;
+            } else if (instruction->op == IR_ADD && (a == IR_NO_VALUE || b == IR_NO_VALUE)) {
+                escape->roots[instruction->dest] = a != IR_NO_VALUE ? a : b;
+            }
+        }
+    }
+
+    for (size_t o = 0; o < ssa->order_count; o++) {
+        uint32_t b = ssa->order[o];
+        const SsaBlock* block = &ssa->blocks[b];
+        for (size_t i = 0; i < block->count; i++) {
+            const IrInstruction* instruction = &block->code[i];
+            for (uint32_t k = 0; k < instruction->arg_count + 2; k++) {
+                IrValue use = k == 0 ? instruction->a : k == 1 ? instruction->b : instruction->args[k - 2];
+                IrValue root = escape_root(escape, use);
+                if (root == IR_NO_VALUE) continue;
+                if (!escape_add_use(escape, root, b, (uint32_t)i)) return false;
+                if (!keeps_local(escape, instruction, k, use, root)) escape->escapes[root] = true;
+            }
+        }
+    }
+    return true;
+}
+
+static uint32_t alloc_size(const Escape* escape, IrValue root) {
+    Definition definition = escape->definitions[root];
+    return (uint32_t)escape->ssa->blocks[definition.block].code[definition.index].imm.integer;
+}
+
+// block・index番目の要素ごとの演算の書き込み先のブロックを、読むブロックに置き換えられるか
+static bool can_reuse(Escape* escape, uint32_t block, uint32_t index, IrValue source, IrValue target) {
+    const IrInstruction* instruction = &escape->ssa->blocks[block].code[index];
+    if (source == target || escape_root(escape, source) != source || escape_root(escape, target) != target) {
+        return false;
+    }
+    if (escape->escapes[source] || alloc_size(escape, source) != alloc_size(escape, target)) return false;
+    // 同じブロックの中で確保したものに限る（ループで前の回のブロックを書き換えない）
+    Definition from = escape->definitions[source], to = escape->definitions[target];
+    if (from.block != block || to.block != block || to.index > index) return false;
+    // 一部だけ重なる書き込みにしない
+    if (instruction->b != source && escape_root(escape, instruction->b) == source) return false;
+
+    // 読むブロックはこの演算が最後の使用で、後は解放するだけ
+    for (uint32_t u = escape->first_use[source]; u != ESCAPE_NO_USE; u = escape->uses[u].next) {
+        const EscapeUse* use = &escape->uses[u];
+        const IrInstruction* user = escape_at(escape, use);
+        if (user->op == IR_NOP) continue;
+        if (use->block != block) return false;
+        if (use->index > index && user->op != IR_DROP) return false;
+    }
+    // 書き込み先のブロックはこの演算より前に使われていない
+    for (uint32_t u = escape->first_use[target]; u != ESCAPE_NO_USE; u = escape->uses[u].next) {
+        const EscapeUse* use = &escape->uses[u];
+        if (use->block == block && use->index < index && escape_at(escape, use)->op != IR_NOP) return false;
+    }
+    return true;
+}
+
+static void reuse_storage(Escape* escape, uint32_t index, IrValue source, IrValue target) {
+    // 読んだブロックの解放を消す（置き場所は書き込み先のブロックの解放で返る）
+    for (uint32_t u = escape->first_use[source]; u != ESCAPE_NO_USE; u = escape->uses[u].next) {
+        IrInstruction* user = escape_at(escape, &escape->uses[u]);
+        if (user->op == IR_DROP && (size_t)escape->uses[u].index > index) ssa_delete(user);
+    }
+    // 書き込み先のブロックの使用をすべて読んだブロックにする
+    for (uint32_t u = escape->first_use[target]; u != ESCAPE_NO_USE; u = escape->uses[u].next) {
+        IrInstruction* user = escape_at(escape, &escape->uses[u]);
+        if (user->a == target) user->a = source;
+        if (user->b == target) user->b = source;
+        for (uint32_t k = 0; k < user->arg_count; k++) {
+            if (user->args[k] == target) user->args[k] = source;
+        }
+    }
+    Definition definition = escape->definitions[target];
+    ssa_delete(&escape->ssa->blocks[definition.block].code[definition.index]);
+
+    escape->merged[target] = source;
+    escape->escapes[source] = escape->escapes[target];
+    escape->uses[escape->last_use[source]].next = escape->first_use[target];
+    if (escape->first_use[target] != ESCAPE_NO_USE) escape->last_use[source] = escape->last_use[target];
+}
+
+static SlangError run_escape(SsaFunction* ssa) {
+    size_t count = ssa->function->value_count ? ssa->function->value_count : 1;
+    Escape escape = { ssa, find_definitions(ssa), malloc(count * sizeof(IrValue)), identity_map(count),
+                      calloc(count, sizeof(bool)), malloc(count * sizeof(uint32_t)),
+                      malloc(count * sizeof(uint32_t)), NULL, 0, 0 };
+    bool ok = escape.definitions != NULL && escape.roots != NULL && escape.merged != NULL &&
+              escape.escapes != NULL && escape.first_use != NULL && escape.last_use != NULL;
+    if (ok) {
+        for (size_t v = 0; v < count; v++) {
+            escape.roots[v] = IR_NO_VALUE;
+            escape.first_use[v] = ESCAPE_NO_USE;
+        }
+        ok = escape_collect(&escape);
+    }
+
+    if (ok) {
+        // 要素ごとの演算の書き込み先を受け継ぐ
+        for (size_t o = 0; o < ssa->order_count; o++) {
+            uint32_t b = ssa->order[o];
+            SsaBlock* block = &ssa->blocks[b];
+            for (size_t i = 0; i < block->count; i++) {
+                IrInstruction* instruction = &block->code[i];
+                if (instruction->op < IR_VEC_ADD || instruction->op > IR_VEC_COPY) continue;
+                IrValue source = instruction->a, target = instruction->args[0];
+                if (can_reuse(&escape, b, (uint32_t)i, source, target)) {
+                    reuse_storage(&escape, (uint32_t)i, source, target);
+                    // 複製は置き場所を受け継げば要らない
+                    if (instruction->op == IR_VEC_COPY) ssa_delete(instruction);
+                }
+            }
+        }
+
+        // 外へ出ないブロックをフレームに置く
+        uint32_t frame = 0;
+        for (size_t o = 0; o < ssa->order_count; o++) {
+            SsaBlock* block = &ssa->blocks[ssa->order[o]];
+            for (size_t i = 0; i < block->count; i++) {
+                IrInstruction* instruction = &block->code[i];
+                if (instruction->op != IR_ALLOC || escape.escapes[instruction->dest]) continue;
+                uint32_t size = ((uint32_t)instruction->imm.integer + 15) & ~15u;
+                if (size > OPT_ESCAPE_MAX_BLOCK || frame + size > OPT_ESCAPE_MAX_FRAME) continue;
+                frame += size;
+                instruction->op = IR_STACK_ALLOC;
+                for (uint32_t u = escape.first_use[instruction->dest]; u != ESCAPE_NO_USE; u = escape.uses[u].next) {
+                    IrInstruction* user = escape_at(&escape, &escape.uses[u]);
+                    if (user->op == IR_DROP) ssa_delete(user);
+                }
+            }
+        }
+    }
+
+    free(escape.definitions);
+    free(escape.roots);
+    free(escape.merged);
+    free(escape.escapes);
+    free(escape.first_use);
+    free(escape.last_use);
+    free(escape.uses);
+    if (!ok) return SLANG_ERROR_INTERNAL;
+    ssa_compact(ssa);
+    return SLANG_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// 不要コード削除
+// 副作用のある命令（書き込み・呼び出し・分岐・return・引数・止まりうる除算・ベクトル演算の書き込み）から
+// 使われている値をたどり、届かなかった命令を消す。最後にブロックをつなぎ直す。
+
+static bool is_root(const IrInstruction* instruction) {
+    switch (instruction->op) {
+        case IR_STORE_GLOBAL:
+        case IR_CALL:
+        case IR_JUMP:
+        case IR_BRANCH_FALSE:
+        case IR_RETURN:
+        case IR_PARAM:
+        case IR_VEC_ADD:
+        case IR_VEC_SUB:
+        case IR_VEC_MUL:
+        case IR_VEC_DIV:
+        case IR_VEC_SCALE:
+        case IR_VEC_COPY:
+        case IR_MAT4_MUL:
+        case IR_QUAT_MUL:
+        case IR_DROP:
+        case IR_STORE:
+            return true;
+        default:
+            return may_trap(instruction);
+    }
+}
+
+static SlangError run_dce(SsaFunction* ssa) {
+    size_t value_count = ssa->function->value_count;
+    size_t block_count = ssa->block_count;
+    Definition* definitions = find_definitions(ssa);
+    uint32_t* start = malloc((block_count + 1) * sizeof(uint32_t));
+    IrValue* work = malloc((value_count ? value_count : 1) * sizeof(IrValue));
+    bool* value_live = calloc(value_count ? value_count : 1, sizeof(bool));
+    bool* live = NULL;
+    if (definitions != NULL && start != NULL) {
+        start[0] = 0;
+        for (size_t b = 0; b < block_count; b++) {
+            start[b + 1] = start[b] + (ssa->blocks[b].removed ? 0 : (uint32_t)ssa->blocks[b].count);
+        }
+        live = calloc(start[block_count] + 1, sizeof(bool));
+    }
+    if (definitions == NULL || start == NULL || work == NULL || value_live == NULL || live == NULL) {
+        free(definitions);
+        free(start);
+        free(work);
+        free(value_live);
+        free(live);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    // 根の命令が読む値から、定義をたどって生きている命令に印を付ける
+    size_t work_count = 0;
+    for (uint32_t b = 0; b < block_count; b++) {
+        const SsaBlock* block = &ssa->blocks[b];
+        if (block->removed) continue;
+        for (size_t i = 0; i < block->count; i++) {
+            const IrInstruction* instruction = &block->code[i];
+            if (!is_root(instruction)) continue;
+            live[start[b] + i] = true;
+            for (uint32_t k = 0; k < instruction->arg_count + 2; k++) {
+                IrValue use = k == 0 ? instruction->a : k == 1 ? instruction->b : instruction->args[k - 2];
+                if (use == IR_NO_VALUE || value_live[use]) continue;
+                value_live[use] = true;
+                work[work_count++] = use;
+            }
+        }
+    }
+    while (work_count > 0) {
+        IrValue value = work[--work_count];
+        Definition definition = definitions[value];
+        if (definition.block == SSA_NO_BLOCK) continue;
+        live[start[definition.block] + definition.index] = true;
+        const IrInstruction* instruction = &ssa->blocks[definition.block].code[definition.index];
+        for (uint32_t k = 0; k < instruction->arg_count + 2; k++) {
+            IrValue use = k == 0 ? instruction->a : k == 1 ? instruction->b : instruction->args[k - 2];
+            if (use == IR_NO_VALUE || value_live[use]) continue;
+            value_live[use] = true;
+            work[work_count++] = use;
+        }
+    }
+
+    for (uint32_t b = 0; b < block_count; b++) {
+        SsaBlock* block = &ssa->blocks[b];
+        if (block->removed) continue;
+        for (size_t i = 0; i < block->count; i++) {
+            if (!live[start[b] + i]) ssa_delete(&block->code[i]);
+        }
+    }
+
+    free(definitions);
+    free(start);
+    free(work);
+    free(value_live);
+    free(live);
+    ssa_compact(ssa);
+
+    if (ssa_simplify_cfg(ssa)) return ssa_analyze(ssa);
+    return ssa->failed ? SLANG_ERROR_INTERNAL : SLANG_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// インライン展開（線形IRのまま行う）
+// 小さな関数の呼び出しを本体の写しで置き換える。引数はコピー、returnは結果へのコピーと
+// 続きへのjumpになる。結果の値は代入が複数になるが、後のSSA形式への変換で分けられる。
+
+typedef struct {
+    IrInstruction* code;
+    size_t count;
+    size_t capacity;
+} CodeBuffer;
+
+static IrInstruction* code_push(CodeBuffer* buffer, IrOpcode op, uint8_t type) {
+    if (buffer->count == buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 64;
+        IrInstruction* code = realloc(buffer->code, capacity * sizeof(IrInstruction));
+        if (code == NULL) return NULL;
+        buffer->code = code;
+        buffer->capacity = capacity;
+    }
+    IrInstruction* instruction = &buffer->code[buffer->count++];
+    memset(instruction, 0, sizeof(IrInstruction));
+    instruction->op = (uint8_t)op;
+    instruction->type = type;
+    instruction->dest = IR_NO_VALUE;
+    instruction->a = IR_NO_VALUE;
+    instruction->b = IR_NO_VALUE;
+    return instruction;
+}
+
+static const IrFunction* find_callee(IrFunction* const* module, size_t count, const char* name) {
+    for (size_t i = 0; i < count; i++) {
+        const IrFunction* function = module[i];
+        if (function == NULL || function->name == NULL) continue;
+        if (function->name == name || strcmp(function->name, name) == 0) return function;
+    }
+    return NULL;
+}
+
+// 引数と戻り値の型が呼び出しと合う小さな関数だけを展開する
+static bool can_inline(const IrFunction* caller, const IrFunction* callee, const IrInstruction* call) {
+    // 並列に展開するときのcalleeは複製なので、自分自身の呼び出しは名前でも見分ける
+    if (callee == NULL || callee == caller || callee->name == caller->name || callee->failed) return false;
+    if (callee->count > OPT_INLINE_MAX_INSTRUCTIONS || callee->param_count != call->arg_count) return false;
+
+    for (size_t i = 0; i < callee->count; i++) {
+        const IrInstruction* instruction = &callee->code[i];
+        if (instruction->op == IR_PARAM) {
+            uint32_t index = (uint32_t)instruction->imm.integer;
+            if (index >= call->arg_count || caller->value_types[call->args[index]] != instruction->type) return false;
+        }
+        if (instruction->op == IR_RETURN && instruction->a != IR_NO_VALUE && call->dest != IR_NO_VALUE &&
+            callee->value_types[instruction->a] != caller->value_types[call->dest]) {
+            return false;
+        }
+        if (instruction->op == IR_PHI || instruction->op == IR_NOP) return false;
+    }
+    return true;
+}
+
+static bool inline_body(IrFunction* caller, const IrFunction* callee, const IrInstruction* call, CodeBuffer* out) {
+    IrValue* map = malloc((callee->value_count ? callee->value_count : 1) * sizeof(IrValue));
+    if (map == NULL) return false;
+    for (size_t v = 0; v < callee->value_count; v++) {
+        map[v] = ir_new_value(caller, (IrType)callee->value_types[v]);
+        if (map[v] == IR_NO_VALUE) {
+            free(map);
+            return false;
+        }
+    }
+    uint32_t label_base = caller->label_count;
+    uint32_t resume = label_base + callee->label_count;
+    caller->label_count = resume + 1;
+
+    bool ok = true;
+    for (size_t i = 0; i < callee->count && ok; i++) {
+        const IrInstruction* source = &callee->code[i];
+        IrInstruction* instruction;
+        switch (source->op) {
+            case IR_PARAM:
+                instruction = code_push(out, IR_MOVE, source->type);
+                if ((ok = instruction != NULL)) {
+                    instruction->dest = map[source->dest];
+                    instruction->a = call->args[source->imm.integer];
+                }
+                continue;
+            case IR_RETURN:
+                if (call->dest != IR_NO_VALUE) {
+                    instruction = code_push(out, source->a != IR_NO_VALUE ? IR_MOVE : IR_CONST,
+                                            caller->value_types[call->dest]);
+                    if (!(ok = instruction != NULL)) break;
+                    instruction->dest = call->dest;
+                    if (source->a != IR_NO_VALUE) instruction->a = map[source->a];
+                }
+                instruction = code_push(out, IR_JUMP, IR_INT);
+                if ((ok = instruction != NULL)) instruction->imm.label = resume;
+                continue;
+            default:
+                break;
+        }
+
+        instruction = code_push(out, (IrOpcode)source->op, source->type);
+        if (!(ok = instruction != NULL)) break;
+        *instruction = *source;
+        if (source->dest != IR_NO_VALUE) instruction->dest = map[source->dest];
+        if (source->a != IR_NO_VALUE) instruction->a = map[source->a];
+        if (source->b != IR_NO_VALUE) instruction->b = map[source->b];
+        if (source->op == IR_LABEL || source->op == IR_JUMP || source->op == IR_BRANCH_FALSE) {
+            instruction->imm.label = label_base + source->imm.label;
+        }
+        if (source->arg_count > 0) {
+            instruction->args = malloc(source->arg_count * sizeof(IrValue));
+            if (!(ok = instruction->args != NULL)) {
+                instruction->arg_count = 0;
+                break;
+            }
+            for (uint32_t j = 0; j < source->arg_count; j++) instruction->args[j] = map[source->args[j]];
+        }
+    }
+
+    // 本体の末尾から落ちるときはvoidのreturnと同じく0を返す
+    const IrInstruction* last = callee->count > 0 ? &callee->code[callee->count - 1] : NULL;
+    bool falls_through = last == NULL || (last->op != IR_RETURN && last->op != IR_JUMP);
+    if (ok && falls_through && call->dest != IR_NO_VALUE) {
+        IrInstruction* zero = code_push(out, IR_CONST, caller->value_types[call->dest]);
+        if ((ok = zero != NULL)) zero->dest = call->dest;
+    }
+
+    IrInstruction* label = ok ? code_push(out, IR_LABEL, IR_INT) : NULL;
+    if (label != NULL) label->imm.label = resume;
+    free(map);
+    return label != NULL;
+}
+
+static void free_code(IrInstruction* code, size_t count) {
+    for (size_t i = 0; i < count; i++) free(code[i].args);
+    free(code);
+}
+
+// 展開した命令列をoutに組み立てる（functionの命令列はまだ入れ替えない）
+// functionには展開した本体の値とラベルが加わる。展開しなければ*inlinedはfalseで、outは空のまま
+static SlangError inline_collect(IrFunction* function, IrFunction* const* module, size_t module_count,
+                                 CodeBuffer* out, bool* inlined) {
+    *out = (CodeBuffer){ NULL, 0, 0 };
+    *inlined = false;
+    bool ok = true;
+
+    // 新しい命令列は引数の配列も自前で持ち、展開できたときだけ元と入れ替える
+    for (size_t i = 0; i < function->count && ok; i++) {
+        const IrInstruction* instruction = &function->code[i];
+        if (instruction->op == IR_CALL) {
+            const IrFunction* callee = find_callee(module, module_count, instruction->symbol);
+            size_t projected = out->count + (function->count - i) + (callee ? callee->count + 2 : 0);
+            if (can_inline(function, callee, instruction) && projected <= OPT_INLINE_MAX_FUNCTION) {
+                ok = inline_body(function, callee, instruction, out);
+                *inlined = true;
+                continue;
+            }
+        }
+        IrInstruction* copy = code_push(out, (IrOpcode)instruction->op, instruction->type);
+        if (!(ok = copy != NULL)) break;
+        *copy = *instruction;
+        copy->args = NULL;
+        if (instruction->arg_count > 0) {
+            copy->args = malloc(instruction->arg_count * sizeof(IrValue));
+            if (!(ok = copy->args != NULL)) {
+                copy->arg_count = 0;
+                break;
+            }
+            memcpy(copy->args, instruction->args, instruction->arg_count * sizeof(IrValue));
+        }
+    }
+
+    if (!ok || !*inlined) {
+        free_code(out->code, out->count);
+        *out = (CodeBuffer){ NULL, 0, 0 };
+        *inlined = false;
+        return ok ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+    }
+    return SLANG_SUCCESS;
+}
+
+static void inline_commit(IrFunction* function, CodeBuffer* out) {
+    free_code(function->code, function->count);
+    function->code = out->code;
+    function->count = out->count;
+    function->capacity = out->capacity;
+}
+
+static SlangError run_inline(IrFunction* function, IrFunction* const* module, size_t module_count) {
+    CodeBuffer out;
+    bool inlined;
+    SlangError error = inline_collect(function, module, module_count, &out, &inlined);
+    if (error == SLANG_SUCCESS && inlined) inline_commit(function, &out);
+    return error;
+}
+
+// ---------------------------------------------------------------------------
+// パスの管理
+
+void optimizer_init(Optimizer* optimizer, const OptOptions* options) {
+    memset(optimizer, 0, sizeof(Optimizer));
+    if (options != NULL) optimizer->options = *options;
+    if (optimizer->options.level < 0) optimizer->options.level = 0;
+    if (optimizer->options.level > OPT_MAX_LEVEL) optimizer->options.level = OPT_MAX_LEVEL;
+}
+
+static const char* stat_name(int stat) {
+    return stat == OPT_STAT_SSA_BUILD ? "ssa" : stat == OPT_STAT_SSA_LOWER ? "out-of-ssa" : pass_info[stat].name;
+}
+
+// 計るときだけ時計を読む
+static uint64_t stat_start(const Optimizer* optimizer) {
+    return optimizer->options.time_passes || optimizer->options.trace != NULL ? trace_now() : 0;
+}
+
+static void record(Optimizer* optimizer, int stat, const IrFunction* function, uint64_t start, size_t before,
+                   size_t after) {
+    OptPassStats* stats = &optimizer->stats[stat];
+    stats->runs++;
+    stats->instructions += (int64_t)after - (int64_t)before;
+    if (optimizer->options.time_passes) stats->seconds += (double)(trace_now() - start) * 1e-9;
+    trace_end(optimizer->options.trace, "pass", stat_name(stat), function->name, start, 0, after);
+}
+
+static SlangError run_ssa_pass(OptPass pass, SsaFunction* ssa) {
+    switch (pass) {
+        case OPT_PASS_CONSTPROP: return run_constprop(ssa);
+        case OPT_PASS_COPYPROP:  return run_copyprop(ssa);
+        case OPT_PASS_CSE:       return run_cse(ssa);
+        case OPT_PASS_LICM:      return run_licm(ssa);
+        case OPT_PASS_ESCAPE:    return run_escape(ssa);
+        case OPT_PASS_DCE:       return run_dce(ssa);
+        default:                 return SLANG_SUCCESS;
+    }
+}
+
+// SSA形式にしてパスを走らせ、線形IRに戻す
+static SlangError run_ssa_passes(Optimizer* optimizer, IrFunction* function) {
+    int level = optimizer->options.level;
+
+    uint64_t start = stat_start(optimizer);
+    size_t before = function->count;
+    SsaFunction ssa;
+    SlangError error = ssa_build(&ssa, function);
+    if (error != SLANG_SUCCESS) return error;
+    record(optimizer, OPT_STAT_SSA_BUILD, function, start, before, ssa_instruction_count(&ssa));
+
+    for (int pass = 0; pass < OPT_PASS_COUNT && error == SLANG_SUCCESS; pass++) {
+        if (pass == OPT_PASS_INLINE || level < pass_info[pass].level) continue;
+        start = stat_start(optimizer);
+        before = ssa_instruction_count(&ssa);
+        error = run_ssa_pass((OptPass)pass, &ssa);
+        if (error == SLANG_SUCCESS && ssa.failed) error = SLANG_ERROR_INTERNAL;
+        record(optimizer, pass, function, start, before, ssa_instruction_count(&ssa));
+    }
+
+    if (error == SLANG_SUCCESS) {
+        start = stat_start(optimizer);
+        before = ssa_instruction_count(&ssa);
+        error = ssa_lower(&ssa);
+        if (error == SLANG_SUCCESS) record(optimizer, OPT_STAT_SSA_LOWER, function, start, before, function->count);
+    }
+    ssa_free(&ssa);
+    return error;
+}
+
+SlangError optimizer_run(Optimizer* optimizer, IrFunction* function, IrFunction* const* module, size_t module_count) {
+    if (function == NULL || function->failed) return SLANG_ERROR_INTERNAL;
+    int level = optimizer->options.level;
+    if (level <= 0) return SLANG_SUCCESS;
+
+    if (level >= pass_info[OPT_PASS_INLINE].level) {
+        uint64_t start = stat_start(optimizer);
+        size_t before = function->count;
+        SlangError error = run_inline(function, module, module_count);
+        record(optimizer, OPT_PASS_INLINE, function, start, before, function->count);
+        if (error != SLANG_SUCCESS) return error;
+    }
+    return run_ssa_passes(optimizer, function);
+}
+
+// 関数ごとの並列な最適化の状態
+typedef struct {
+    IrFunction** module;
+    IrFunction** snapshots;    // 展開の元にする、展開前の関数の複製（命令列は元と共有する）
+    size_t count;
+    CodeBuffer* inlined;
+    bool* replaced;
+    SlangError* errors;
+    Optimizer* optimizers;     // 関数ごとの集計（最後にまとめる）
+} ModuleRun;
+
+static void module_inline_task(void* context, size_t begin, size_t end) {
+    ModuleRun* run = context;
+    for (size_t i = begin; i < end; i++) {
+        IrFunction* function = run->module[i];
+        if (function == NULL || function->failed) continue;
+        Optimizer* optimizer = &run->optimizers[i];
+        uint64_t start = stat_start(optimizer);
+        size_t before = function->count;
+        run->errors[i] = inline_collect(function, run->snapshots, run->count, &run->inlined[i], &run->replaced[i]);
+        record(optimizer, OPT_PASS_INLINE, function, start, before,
+               run->replaced[i] ? run->inlined[i].count : function->count);
+    }
+}
+
+static void module_ssa_task(void* context, size_t begin, size_t end) {
+    ModuleRun* run = context;
+    for (size_t i = begin; i < end; i++) {
+        IrFunction* function = run->module[i];
+        if (function == NULL || function->failed || run->errors[i] != SLANG_SUCCESS) continue;
+        run->errors[i] = run_ssa_passes(&run->optimizers[i], function);
+    }
+}
+
+static void module_run_free(ModuleRun* run) {
+    for (size_t i = 0; run->snapshots != NULL && i < run->count; i++) {
+        if (run->snapshots[i] != NULL) free(run->snapshots[i]->value_types);
+        free(run->snapshots[i]);
+    }
+    free(run->snapshots);
+    free(run->inlined);
+    free(run->replaced);
+    free(run->errors);
+    free(run->optimizers);
+}
+
+// 展開の間に呼び出し元の値の型の表は伸びるので、呼び出される側としては複製を読む
+static bool module_snapshot(ModuleRun* run) {
+    for (size_t i = 0; i < run->count; i++) {
+        const IrFunction* function = run->module[i];
+        if (function == NULL) continue;
+        IrFunction* copy = malloc(sizeof(IrFunction));
+        if (copy == NULL) return false;
+        *copy = *function;
+        copy->value_types = malloc(function->value_count ? function->value_count : 1);
+        run->snapshots[i] = copy;
+        if (copy->value_types == NULL) return false;
+        memcpy(copy->value_types, function->value_types, function->value_count);
+        copy->value_capacity = function->value_count;
+    }
+    return true;
+}
+
+SlangError optimizer_run_module(Optimizer* optimizer, ThreadPool* pool, IrFunction** module, size_t count) {
+    if (optimizer->options.level <= 0 || count == 0) return SLANG_SUCCESS;
+
+    ModuleRun run = { module, NULL, count, NULL, NULL, NULL, NULL };
+    run.snapshots = calloc(count, sizeof(IrFunction*));
+    run.inlined = calloc(count, sizeof(CodeBuffer));
+    run.replaced = calloc(count, sizeof(bool));
+    run.errors = calloc(count, sizeof(SlangError));
+    run.optimizers = malloc(count * sizeof(Optimizer));
+    if (run.snapshots == NULL || run.inlined == NULL || run.replaced == NULL || run.errors == NULL ||
+        run.optimizers == NULL) {
+        module_run_free(&run);
+        return SLANG_ERROR_INTERNAL;
+    }
+    for (size_t i = 0; i < count; i++) optimizer_init(&run.optimizers[i], &optimizer->options);
+
+    // 1. インライン展開（どの関数も展開前の本体を展開するので、結果はスレッド数によらない）
+    if (optimizer->options.level >= pass_info[OPT_PASS_INLINE].level) {
+        if (!module_snapshot(&run)) {
+            module_run_free(&run);
+            return SLANG_ERROR_INTERNAL;
+        }
+        thread_pool_for(pool, count, 1, module_inline_task, &run);
+        for (size_t i = 0; i < count; i++) {
+            if (run.replaced[i]) inline_commit(module[i], &run.inlined[i]);
+        }
+    }
+
+    // 2. SSA形式のパス（関数ごとに独立）
+    thread_pool_for(pool, count, 1, module_ssa_task, &run);
+
+    // 集計は関数の順に足す
+    for (size_t i = 0; i < count; i++) {
+        for (int stat = 0; stat < OPT_STAT_COUNT; stat++) {
+            optimizer->stats[stat].seconds += run.optimizers[i].stats[stat].seconds;
+            optimizer->stats[stat].runs += run.optimizers[i].stats[stat].runs;
+            optimizer->stats[stat].instructions += run.optimizers[i].stats[stat].instructions;
+        }
+    }
+    module_run_free(&run);
+    return SLANG_SUCCESS;
+}
+
+void optimizer_report(const Optimizer* optimizer, FILE* out) {
+    static const int rows[] = {
+        OPT_PASS_INLINE, OPT_STAT_SSA_BUILD, OPT_PASS_CONSTPROP, OPT_PASS_COPYPROP,
+        OPT_PASS_CSE, OPT_PASS_LICM, OPT_PASS_ESCAPE, OPT_PASS_DCE, OPT_STAT_SSA_LOWER,
+    };
+
+    fprintf(out, "pass          runs    time (ms)  instructions\n");
+    double total = 0.0;
+    for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+        int stat = rows[i];
+        const OptPassStats* stats = &optimizer->stats[stat];
+        const char* name = stat_name(stat);
+        if (stat < OPT_PASS_COUNT && optimizer->options.level < pass_info[stat].level) continue;
+        fprintf(out, "%-12s %5zu %12.3f %+13" PRId64 "\n", name, stats->runs, stats->seconds * 1e3,
+                stats->instructions);
+        total += stats->seconds;
+    }
+    fprintf(out, "%-12s %5s %12.3f\n", "total", "", total * 1e3);
+}
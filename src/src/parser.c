@@ -1,660 +1,763 @@
 #include "../include/parser.h"
 #include "../include/ast.h"
-#include "../include/vector.h"
 #include "../include/error.h"
+#include "../include/intern.h"
+#include "../include/scheduler.h"
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define PARSER_SCRATCH_INITIAL_CAPACITY 64
+// 関数の引数の上限（型検査器と同じ）
+#define PARSER_MAX_PARAMETERS 256
+#define PARSER_MAX_TYPE_PARAMETERS 16
+// 括弧・単項演算子・代入・実引数・ブロック・else ifの入れ子の上限（再帰でスタックを使い切らないように）
+#define PARSER_MAX_DEPTH 1024
+
+// 二項演算子の優先順位（大きいほど強く結びつく）
+typedef enum {
+    PRECEDENCE_NONE,
+    PRECEDENCE_OR,          // ||
+    PRECEDENCE_AND,         // &&
+    PRECEDENCE_EQUALITY,    // == !=
+    PRECEDENCE_COMPARISON,  // < > <= >=
+    PRECEDENCE_TERM,        // + -
+    PRECEDENCE_FACTOR       // * / %
+} Precedence;
+
+typedef struct {
+    Precedence precedence;
+    const char* text;
+} BinaryRule;
+
+// トークンの種類で引く（二項演算子でなければPRECEDENCE_NONE）
+static const BinaryRule binary_rules[TOKEN_ERROR + 1] = {
+    [TOKEN_OR]      = { PRECEDENCE_OR, "||" },
+    [TOKEN_AND]     = { PRECEDENCE_AND, "&&" },
+    [TOKEN_EQ]      = { PRECEDENCE_EQUALITY, "==" },
+    [TOKEN_NEQ]     = { PRECEDENCE_EQUALITY, "!=" },
+    [TOKEN_LT]      = { PRECEDENCE_COMPARISON, "<" },
+    [TOKEN_GT]      = { PRECEDENCE_COMPARISON, ">" },
+    [TOKEN_LE]      = { PRECEDENCE_COMPARISON, "<=" },
+    [TOKEN_GE]      = { PRECEDENCE_COMPARISON, ">=" },
+    [TOKEN_PLUS]    = { PRECEDENCE_TERM, "+" },
+    [TOKEN_MINUS]   = { PRECEDENCE_TERM, "-" },
+    [TOKEN_STAR]    = { PRECEDENCE_FACTOR, "*" },
+    [TOKEN_SLASH]   = { PRECEDENCE_FACTOR, "/" },
+    [TOKEN_PERCENT] = { PRECEDENCE_FACTOR, "%" },
+};
+
 // 構文解析器の作成
-Parser* parser_create(Lexer* lexer) {
-    Parser* parser = malloc(sizeof(Parser));
+Parser* parser_create(Lexer* lexer, Arena* arena) {
+    Parser* parser = calloc(1, sizeof(Parser));
     if (parser == NULL) return NULL;
 
     parser->lexer = lexer;
-    parser->current = NULL;
-    parser->previous = NULL;
-    parser->errors = vector_create(sizeof(Error));
-    
-    if (parser->errors == NULL) {
+    parser->arena = arena;
+    parser->scratch = malloc(PARSER_SCRATCH_INITIAL_CAPACITY * sizeof(ASTNode*));
+    if (parser->scratch == NULL) {
         free(parser);
         return NULL;
     }
-
+    parser->scratch_capacity = PARSER_SCRATCH_INITIAL_CAPACITY;
     return parser;
 }
 
 // 構文解析器の破棄
 void parser_destroy(Parser* parser) {
     if (parser == NULL) return;
-    
-    // エラーメッセージを解放
-    for (size_t i = 0; i < vector_size(parser->errors); i++) {
-        Error* error = vector_get(parser->errors, i);
-        free(error->message);
-        free(error->file);
-    }
-    
-    vector_destroy(parser->errors);
+
+    for (size_t i = 0; i < parser->error_count; i++) {
+        free(parser->errors[i].message);
+        free(parser->errors[i].file);
+    }
+    free(parser->errors);
+    free(parser->scratch);
     free(parser);
 }
 
-// エラーの追加
-static void parser_error(Parser* parser, ErrorType type, const char* message) {
-    Error error;
-    error.type = type;
-    error.message = strdup(message);
-    error.line = parser->current->line;
-    error.column = parser->current->column;
-    error.file = NULL; // TODO: ファイル名を設定
-    
-    vector_push(parser->errors, &error);
+// 現在のトークンの位置に構文エラーを記録する（記録できなければSLANG_ERROR_INTERNAL）
+static SlangError parser_fail(Parser* parser, const char* message) {
+    if (parser->error_count == parser->error_capacity) {
+        size_t capacity = parser->error_capacity ? parser->error_capacity * 2 : 8;
+        Error* errors = realloc(parser->errors, capacity * sizeof(Error));
+        if (errors == NULL) return SLANG_ERROR_INTERNAL;
+        parser->errors = errors;
+        parser->error_capacity = capacity;
+    }
+
+    const Token* token = parser->current ? parser->current : parser->previous;
+    // 字句エラーのトークンで止まったなら、その種類を診断にする
+    if (token != NULL && token == parser->current && token->type == TOKEN_ERROR) {
+        message = lexer_error_message((LexErrorKind)token->error);
+    }
+    Error* error = &parser->errors[parser->error_count];
+    error->type = ERROR_SYNTAX;
+    error->message = strdup(message);
+    error->line = token ? token->line : 0;
+    error->column = token ? token->column : 0;
+    error->file = NULL;
+    if (error->message == NULL) return SLANG_ERROR_INTERNAL;
+    parser->error_count++;
+    return SLANG_ERROR_PARSER;
 }
 
 // 次のトークンを消費
-static bool parser_advance(Parser* parser) {
+static void parser_advance(Parser* parser) {
     parser->previous = parser->current;
     parser->current = lexer_next_token(parser->lexer);
-    return parser->current != NULL;
+    parser->consumed++;
+}
+
+// 現在のトークンの次のトークンの種類を確認（消費しない）
+static bool parser_peek_is(const Parser* parser, TokenType type) {
+    const Token* next = lexer_peek_token(parser->lexer);
+    return next != NULL && next->type == type;
+}
+
+static bool parser_at_end(const Parser* parser) {
+    return parser->current == NULL || parser->current->type == TOKEN_EOF;
 }
 
 // 現在のトークンの種類を確認
-static bool parser_check(Parser* parser, TokenType type) {
-    if (parser->current == NULL) return false;
-    return parser->current->type == type;
+static bool parser_check(const Parser* parser, TokenType type) {
+    return parser->current != NULL && parser->current->type == type;
 }
 
 // 現在のトークンの種類を確認して消費
 static bool parser_match(Parser* parser, TokenType type) {
-    if (parser_check(parser, type)) {
-        parser_advance(parser);
-        return true;
-    }
-    return false;
-}
-
-// 現在のトークンの種類を確認して消費（エラー処理付き）
-static bool parser_consume(Parser* parser, TokenType type, const char* message) {
-    if (parser_check(parser, type)) {
-        parser_advance(parser);
-        return true;
-    }
-    
-    parser_error(parser, ERROR_SYNTAX, message);
-    return false;
+    if (!parser_check(parser, type)) return false;
+    parser_advance(parser);
+    return true;
 }
 
-// 式の解析
-static SlangError parser_expression(Parser* parser, ASTNode** expr) {
-    // TODO: 式の解析を実装
-    return SLANG_SUCCESS;
+// 現在のトークンの種類を確認して消費（違えば構文エラー）
+static SlangError parser_consume(Parser* parser, TokenType type, const char* message) {
+    if (parser_match(parser, type)) return SLANG_SUCCESS;
+    return parser_fail(parser, message);
 }
 
-// 文の解析
-static SlangError parser_statement(Parser* parser, ASTNode** stmt) {
-    if (parser_match(parser, TOKEN_LET)) {
-        // 変数宣言
-        // TODO: 変数宣言の解析を実装
-    } else if (parser_match(parser, TOKEN_IF)) {
-        // if文
-        // TODO: if文の解析を実装
-    } else if (parser_match(parser, TOKEN_WHILE)) {
-        // while文
-        // TODO: while文の解析を実装
-    } else if (parser_match(parser, TOKEN_FOR)) {
-        // for文
-        // TODO: for文の解析を実装
-    } else if (parser_match(parser, TOKEN_RETURN)) {
-        // return文
-        // TODO: return文の解析を実装
-    } else if (parser_match(parser, TOKEN_BREAK)) {
-        // break文
-        // TODO: break文の解析を実装
-    } else if (parser_match(parser, TOKEN_CONTINUE)) {
-        // continue文
-        // TODO: continue文の解析を実装
-    } else {
-        // 式文
-        // TODO: 式文の解析を実装
+// 入れ子を1段深くする（成功したら抜けるときにparser_leave）
+// 深すぎれば構文エラーにし、外側の括弧かブロックが閉じる手前まで読み飛ばす（段ごとにエラーが続かないように）
+static SlangError parser_enter(Parser* parser) {
+    if (parser->depth < PARSER_MAX_DEPTH) {
+        parser->depth++;
+        return SLANG_SUCCESS;
+    }
+
+    SlangError error = parser_fail(parser, "nesting too deep");
+    size_t open = 0;
+    while (!parser_at_end(parser)) {
+        TokenType type = (TokenType)parser->current->type;
+        if (type == TOKEN_LPAREN || type == TOKEN_LBRACE) {
+            open++;
+        } else if (type == TOKEN_RPAREN || type == TOKEN_RBRACE) {
+            if (open == 0) break;
+            open--;
+        }
+        parser_advance(parser);
     }
-    
-    return SLANG_SUCCESS;
+    return error;
 }
 
-// 関数宣言の解析
-static SlangError parser_function(Parser* parser, ASTNode** func) {
-    // TODO: 関数宣言の解析を実装
-    return SLANG_SUCCESS;
+static void parser_leave(Parser* parser) {
+    parser->depth--;
 }
 
-// 構造体宣言の解析
-static SlangError parser_struct(Parser* parser, ASTNode** struct_decl) {
-    // TODO: 構造体宣言の解析を実装
+static SlangError parser_identifier(Parser* parser, const char** name, const char* message) {
+    if (!parser_check(parser, TOKEN_IDENTIFIER)) return parser_fail(parser, message);
+    *name = lexer_token_intern(parser->lexer, parser->current);
+    if (*name == NULL) return SLANG_ERROR_INTERNAL;
+    parser_advance(parser);
     return SLANG_SUCCESS;
 }
 
-// 実装宣言の解析
-static SlangError parser_impl(Parser* parser, ASTNode** impl_decl) {
-    // TODO: 実装宣言の解析を実装
-    return SLANG_SUCCESS;
+// ノードにトークンの位置を付ける（ノードを作れなかったならNULLのまま返す）
+// ストリーミングモードではトークンのポインタが読み進めると上書きされるので、先頭のトークンは写しを渡す
+static ASTNode* parser_locate(ASTNode* node, const Token* token) {
+    if (node != NULL) {
+        node->line = token->line;
+        node->column = token->column;
+    }
+    return node;
 }
 
-// トレイト宣言の解析
-static SlangError parser_trait(Parser* parser, ASTNode** trait_decl) {
-    // TODO: トレイト宣言の解析を実装
-    return SLANG_SUCCESS;
+// 子の並びの組み立て
+static bool scratch_push(Parser* parser, ASTNode* node) {
+    if (parser->scratch_count == parser->scratch_capacity) {
+        ASTNode** scratch = realloc(parser->scratch, parser->scratch_capacity * 2 * sizeof(ASTNode*));
+        if (scratch == NULL) return false;
+        parser->scratch = scratch;
+        parser->scratch_capacity *= 2;
+    }
+    parser->scratch[parser->scratch_count++] = node;
+    return true;
 }
 
-// 宣言の解析
-static SlangError parser_declaration(Parser* parser, ASTNode** decl) {
-    if (parser_match(parser, TOKEN_FN)) {
-        return parser_function(parser, decl);
-    } else if (parser_match(parser, TOKEN_STRUCT)) {
-        return parser_struct(parser, decl);
-    } else if (parser_match(parser, TOKEN_IMPL)) {
-        return parser_impl(parser, decl);
-    } else if (parser_match(parser, TOKEN_TRAIT)) {
-        return parser_trait(parser, decl);
+static SlangError parser_expression(Parser* parser, ASTNode** expr);
+static SlangError parser_statement(Parser* parser, ASTNode** stmt);
+
+// 型注釈の解析（型の表の型にする）
+static SlangError parser_type(Parser* parser, Type** type) {
+    const char* name;
+    SlangError error = parser_identifier(parser, &name, "expected type name");
+    if (error != SLANG_SUCCESS) return error;
+
+    static const struct {
+        const char* name;
+        TypeKind kind;
+    } primitives[] = {
+        {"int", TYPE_INTEGER}, {"float", TYPE_FLOAT}, {"bool", TYPE_BOOLEAN},
+        {"string", TYPE_STRING}, {"void", TYPE_VOID},
+    };
+    for (size_t i = 0; i < sizeof(primitives) / sizeof(primitives[0]); i++) {
+        if (strcmp(name, primitives[i].name) == 0) {
+            *type = (Type*)type_primitive(primitives[i].kind);
+            return *type ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+        }
+    }
+
+    // 数学の型（要素はfloat）
+    const Type* element = type_primitive(TYPE_FLOAT);
+    if (strncmp(name, "vec", 3) == 0 && name[3] >= '2' && name[3] <= '4' && name[4] == '\0') {
+        *type = (Type*)type_vector_of(element, (size_t)(name[3] - '0'));
+    } else if (strcmp(name, "mat4") == 0) {
+        *type = (Type*)type_matrix_of(element, 4, 4);
+    } else if (strcmp(name, "quat") == 0) {
+        *type = (Type*)type_quaternion_of(element);
     } else {
-        return parser_statement(parser, decl);
+        *type = (Type*)type_named_of(name);
     }
+    return *type ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
 }
 
-// プログラムの解析
-SlangError parser_parse(Parser* parser, ASTNode** ast) {
-    // 最初のトークンを取得
-    parser_advance(parser);
-    
-    // プログラムノードを作成
-    *ast = ast_create_node(NODE_PROGRAM, 1, 1);
-    if (*ast == NULL) {
-        return SLANG_ERROR_INTERNAL;
-    }
-    
-    // 宣言を解析
-    Vector* declarations = vector_create(sizeof(ASTNode*));
-    if (declarations == NULL) {
-        ast_destroy_node(*ast);
-        return SLANG_ERROR_INTERNAL;
-    }
-    
-    while (!parser_check(parser, TOKEN_EOF)) {
-        ASTNode* decl = NULL;
-        SlangError error = parser_declaration(parser, &decl);
-        
-        if (error != SLANG_SUCCESS) {
-            vector_destroy(declarations);
-            ast_destroy_node(*ast);
-            return error;
+// 実引数の並び（'('は消費済み）
+static SlangError parser_arguments(Parser* parser, size_t* base) {
+    *base = parser->scratch_count;
+    if (parser_match(parser, TOKEN_RPAREN)) return SLANG_SUCCESS;
+
+    do {
+        ASTNode* argument;
+        SlangError error = parser_enter(parser);
+        if (error != SLANG_SUCCESS) return error;
+        error = parser_expression(parser, &argument);
+        parser_leave(parser);
+        if (error != SLANG_SUCCESS) return error;
+        if (!scratch_push(parser, argument)) return SLANG_ERROR_INTERNAL;
+    } while (parser_match(parser, TOKEN_COMMA));
+
+    return parser_consume(parser, TOKEN_RPAREN, "expected ')' after arguments");
+}
+
+// 一次式と、その後に続く呼び出し
+static SlangError parser_primary(Parser* parser, ASTNode** expr) {
+    if (parser_at_end(parser)) return parser_fail(parser, "expected expression");
+
+    Token* token = parser->current;
+    const Token start = *token;
+    SlangError error;
+    switch (token->type) {
+        case TOKEN_INTEGER:
+            *expr = parser_locate(create_integer_literal_node(parser->arena, lexer_token_integer(parser->lexer, token)), &start);
+            parser_advance(parser);
+            break;
+
+        case TOKEN_FLOAT:
+            *expr = parser_locate(create_float_literal_node(parser->arena, lexer_token_float(parser->lexer, token)), &start);
+            parser_advance(parser);
+            break;
+
+        case TOKEN_STRING: {
+            char* value = lexer_token_string(parser->lexer, token, parser->arena);
+            if (value == NULL) return SLANG_ERROR_INTERNAL;
+            *expr = parser_locate(create_string_literal_node(parser->arena, value), &start);
+            parser_advance(parser);
+            break;
+        }
+
+        case TOKEN_TRUE:
+        case TOKEN_FALSE:
+            *expr = parser_locate(create_boolean_literal_node(parser->arena, token->type == TOKEN_TRUE), &start);
+            parser_advance(parser);
+            break;
+
+        case TOKEN_IDENTIFIER: {
+            const char* name = lexer_token_intern(parser->lexer, token);
+            if (name == NULL) return SLANG_ERROR_INTERNAL;
+            parser_advance(parser);
+
+            // log!(...)のようなマクロ呼び出しは同じ名前の関数の呼び出しにする
+            bool macro = parser_match(parser, TOKEN_BANG);
+            if (macro && !parser_check(parser, TOKEN_LPAREN)) {
+                return parser_fail(parser, "expected '(' after macro name");
+            }
+            if (!parser_match(parser, TOKEN_LPAREN)) {
+                *expr = parser_locate(create_variable_reference_node(parser->arena, name), &start);
+                break;
+            }
+
+            size_t base;
+            error = parser_arguments(parser, &base);
+            if (error != SLANG_SUCCESS) return error;
+            *expr = parser_locate(create_function_call_node(parser->arena, name, parser->scratch + base,
+                                                            parser->scratch_count - base), &start);
+            parser->scratch_count = base;
+            break;
         }
-        
-        if (decl != NULL) {
-            vector_push(declarations, &decl);
+
+        case TOKEN_LPAREN:
+            parser_advance(parser);
+            error = parser_enter(parser);
+            if (error != SLANG_SUCCESS) return error;
+            error = parser_expression(parser, expr);
+            parser_leave(parser);
+            if (error != SLANG_SUCCESS) return error;
+            error = parser_consume(parser, TOKEN_RPAREN, "expected ')' after expression");
+            if (error != SLANG_SUCCESS) return error;
+            break;
+
+        default:
+            return parser_fail(parser, "expected expression");
+    }
+    if (*expr == NULL) return SLANG_ERROR_INTERNAL;
+
+    // 式の値の呼び出し（f(x)(y)や(g)(x)）。位置は呼び出し先の式の位置
+    while (parser_match(parser, TOKEN_LPAREN)) {
+        size_t base;
+        error = parser_arguments(parser, &base);
+        if (error != SLANG_SUCCESS) return error;
+        ASTNode* callee = *expr;
+        *expr = create_call_expression_node(parser->arena, callee, parser->scratch + base, parser->scratch_count - base);
+        if (*expr != NULL) {
+            (*expr)->line = callee->line;
+            (*expr)->column = callee->column;
         }
+        parser->scratch_count = base;
+        if (*expr == NULL) return SLANG_ERROR_INTERNAL;
     }
-    
-    (*ast)->as.program.declarations = declarations;
     return SLANG_SUCCESS;
 }
 
-// エラーの有無を確認
-bool parser_had_error(Parser* parser) {
-    return vector_size(parser->errors) > 0;
+// 前置の単項演算子（- !）
+static SlangError parser_unary(Parser* parser, ASTNode** expr) {
+    const char* operator = parser_check(parser, TOKEN_MINUS) ? "-" : parser_check(parser, TOKEN_BANG) ? "!" : NULL;
+    if (operator == NULL) return parser_primary(parser, expr);
+
+    const Token start = *parser->current;
+    parser_advance(parser);
+    ASTNode* operand;
+    SlangError error = parser_enter(parser);
+    if (error != SLANG_SUCCESS) return error;
+    error = parser_unary(parser, &operand);
+    parser_leave(parser);
+    if (error != SLANG_SUCCESS) return error;
+    *expr = parser_locate(create_unary_expression_node(parser->arena, operator, operand), &start);
+    return *expr ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
 }
 
-// エラーからの回復
-void parser_synchronize(Parser* parser) {
-    while (!parser_check(parser, TOKEN_EOF)) {
-        if (parser->previous->type == TOKEN_SEMICOLON) return;
-        
-        switch (parser->current->type) {
-            case TOKEN_FN:
-            case TOKEN_STRUCT:
-            case TOKEN_IMPL:
-            case TOKEN_TRAIT:
-            case TOKEN_LET:
-            case TOKEN_IF:
-            case TOKEN_WHILE:
-            case TOKEN_FOR:
-            case TOKEN_RETURN:
-                return;
-            default:
-                break;
-        }
-        
+// minimum以上の優先順位の二項演算子だけを取り込む（すべて左結合）
+static SlangError parser_binary(Parser* parser, Precedence minimum, ASTNode** expr) {
+    SlangError error = parser_unary(parser, expr);
+    if (error != SLANG_SUCCESS) return error;
+
+    for (;;) {
+        const BinaryRule* rule = &binary_rules[parser->current ? parser->current->type : TOKEN_EOF];
+        if (rule->precedence == PRECEDENCE_NONE || rule->precedence < minimum) return SLANG_SUCCESS;
+        // 位置は演算子のトークン
+        const Token start = *parser->current;
         parser_advance(parser);
+
+        ASTNode* right;
+        error = parser_binary(parser, rule->precedence + 1, &right);
+        if (error != SLANG_SUCCESS) return error;
+        *expr = parser_locate(create_binary_expression_node(parser->arena, *expr, rule->text, right), &start);
+        if (*expr == NULL) return SLANG_ERROR_INTERNAL;
     }
 }
 
-Parser* create_parser(Lexer* lexer) {
-    Parser* parser = (Parser*)malloc(sizeof(Parser));
-    if (parser == NULL) {
-        return NULL;
-    }
-    parser->lexer = lexer;
-    parser->had_error = false;
-    parser->panic_mode = false;
-    return parser;
+// 式の解析（代入がいちばん弱く、右結合）
+static SlangError parser_expression(Parser* parser, ASTNode** expr) {
+    SlangError error = parser_binary(parser, PRECEDENCE_OR, expr);
+    if (error != SLANG_SUCCESS || !parser_check(parser, TOKEN_EQUAL)) return error;
+
+    if ((*expr)->type != NODE_VARIABLE_REFERENCE) return parser_fail(parser, "invalid assignment target");
+    const ASTNode* target = *expr;
+    parser_advance(parser);
+    ASTNode* value;
+    error = parser_enter(parser);
+    if (error != SLANG_SUCCESS) return error;
+    error = parser_expression(parser, &value);
+    parser_leave(parser);
+    if (error != SLANG_SUCCESS) return error;
+    *expr = create_assignment_node(parser->arena, target->data.variable_reference.name, value);
+    if (*expr == NULL) return SLANG_ERROR_INTERNAL;
+    (*expr)->line = target->line;
+    (*expr)->column = target->column;
+    return SLANG_SUCCESS;
 }
 
-void free_parser(Parser* parser) {
-    if (parser != NULL) {
-        free(parser);
+// 文の並び（ブロックの中なら'}'の手前で止まる）
+// エラーになった文は捨てて文の境目から続ける。子の並びはここで1回だけarenaに写す。
+static SlangError parser_statements(Parser* parser, bool in_block, ASTNode** block) {
+    size_t base = parser->scratch_count;
+    while (!parser_at_end(parser) && !(in_block && parser_check(parser, TOKEN_RBRACE))) {
+        size_t mark = parser->scratch_count;
+        size_t consumed = parser->consumed;
+        ASTNode* statement = NULL;
+        SlangError error = parser_statement(parser, &statement);
+        if (error == SLANG_SUCCESS && statement != NULL && !scratch_push(parser, statement)) {
+            error = SLANG_ERROR_INTERNAL;
+        }
+        if (error == SLANG_ERROR_PARSER) {
+            // 解析し始めたトークンで失敗したなら、少なくともそれは読み飛ばす
+            parser->scratch_count = mark;
+            if (parser->consumed == consumed) parser_advance(parser);
+            parser_synchronize(parser);
+        } else if (error != SLANG_SUCCESS) {
+            parser->scratch_count = base;
+            return error;
+        }
     }
+
+    *block = create_block_statement_node(parser->arena, parser->scratch + base, parser->scratch_count - base);
+    parser->scratch_count = base;
+    return *block ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
 }
 
-ASTNode* parse_program(Parser* parser) {
-    AST* ast = (AST*)malloc(sizeof(AST));
-    if (ast == NULL) {
-        return NULL;
-    }
-    ast->functions = NULL;
-    ast->function_count = 0;
-    ast->type_definitions = NULL;
-    ast->type_definition_count = 0;
-
-    while (!lexer_is_at_end(parser->lexer)) {
-        Token token = lexer_peek_token(parser->lexer);
-        
-        if (token.type == TOKEN_FUNCTION) {
-            Function function;
-            SlangError* error = parser_parse_function(parser, &function);
-            if (error != NULL) {
-                free(ast);
-                return NULL;
-            }
-            ast_add_function(ast, &function);
-        } else if (token.type == TOKEN_TYPE) {
-            TypeDefinition type_def;
-            SlangError* error = parser_parse_type_definition(parser, &type_def);
-            if (error != NULL) {
-                free(ast);
-                return NULL;
-            }
-            ast_add_type_definition(ast, &type_def);
-        } else {
-            free(ast);
-            return NULL;
-        }
+// ブロックの解析
+static SlangError parser_block(Parser* parser, ASTNode** block) {
+    if (!parser_check(parser, TOKEN_LBRACE)) return parser_fail(parser, "expected '{'");
+    const Token start = *parser->current;
+    // '{'の手前で入るので、深すぎたブロックは閉じの'}'ごと読み飛ばされる
+    SlangError error = parser_enter(parser);
+    if (error != SLANG_SUCCESS) return error;
+    parser_advance(parser);
+    error = parser_statements(parser, true, block);
+    if (error == SLANG_SUCCESS) {
+        parser_locate(*block, &start);
+        error = parser_consume(parser, TOKEN_RBRACE, "expected '}' after block");
     }
-    return create_block_statement_node(NULL, 0);
+    parser_leave(parser);
+    return error;
 }
 
-SlangError* parser_parse_function(Parser* parser, Function* function) {
-    Token token = lexer_next_token(parser->lexer);
-    if (token.type != TOKEN_FUNCTION) {
-        return slang_error_new(SLANG_ERROR_SYNTAX, "Expected 'fn' keyword");
+// 変数宣言の解析（letは消費済み）
+static SlangError parser_let(Parser* parser, ASTNode** stmt) {
+    const Token start = *parser->previous;
+    const char* name;
+    SlangError error = parser_identifier(parser, &name, "expected variable name");
+    if (error != SLANG_SUCCESS) return error;
+
+    Type* type = NULL;
+    if (parser_match(parser, TOKEN_COLON)) {
+        error = parser_type(parser, &type);
+        if (error != SLANG_SUCCESS) return error;
     }
 
-    char* name;
-    SlangError* error = parser_parse_identifier(parser, &name);
-    if (error != NULL) {
-        return error;
+    ASTNode* initializer = NULL;
+    if (parser_match(parser, TOKEN_EQUAL)) {
+        error = parser_expression(parser, &initializer);
+        if (error != SLANG_SUCCESS) return error;
     }
-    function->name = name;
 
-    error = parser_expect(parser, TOKEN_LEFT_PAREN);
-    if (error != NULL) {
-        return error;
+    error = parser_consume(parser, TOKEN_SEMICOLON, "expected ';' after variable declaration");
+    if (error != SLANG_SUCCESS) return error;
+    *stmt = parser_locate(create_let_statement_node(parser->arena, name, type, initializer), &start);
+    return *stmt ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+}
+
+// if文の解析（ifは消費済み）
+static SlangError parser_if(Parser* parser, ASTNode** stmt) {
+    const Token start = *parser->previous;
+    ASTNode* condition;
+    ASTNode* then_branch;
+    ASTNode* else_branch = NULL;
+    SlangError error = parser_expression(parser, &condition);
+    if (error != SLANG_SUCCESS) return error;
+    error = parser_block(parser, &then_branch);
+    if (error != SLANG_SUCCESS) return error;
+
+    if (parser_match(parser, TOKEN_ELSE)) {
+        if (parser_match(parser, TOKEN_IF)) {
+            error = parser_enter(parser);
+            if (error != SLANG_SUCCESS) return error;
+            error = parser_if(parser, &else_branch);
+            parser_leave(parser);
+        } else {
+            error = parser_block(parser, &else_branch);
+        }
+        if (error != SLANG_SUCCESS) return error;
     }
 
-    // Parse parameters
-    Vector* parameters = vector_new(sizeof(Parameter));
-    token = lexer_peek_token(parser->lexer);
-    
-    if (token.type != TOKEN_RIGHT_PAREN) {
-        while (1) {
-            Parameter param;
-            error = parser_parse_identifier(parser, &param.name);
-            if (error != NULL) {
-                vector_free(parameters);
-                return error;
-            }
+    *stmt = parser_locate(create_if_statement_node(parser->arena, condition, then_branch, else_branch), &start);
+    return *stmt ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+}
 
-            error = parser_expect(parser, TOKEN_COLON);
-            if (error != NULL) {
-                vector_free(parameters);
-                return error;
-            }
+// while文の解析（whileは消費済み）
+static SlangError parser_while(Parser* parser, ASTNode** stmt) {
+    const Token start = *parser->previous;
+    ASTNode* condition;
+    ASTNode* body;
+    SlangError error = parser_expression(parser, &condition);
+    if (error != SLANG_SUCCESS) return error;
+    error = parser_block(parser, &body);
+    if (error != SLANG_SUCCESS) return error;
+
+    *stmt = parser_locate(create_while_statement_node(parser->arena, condition, body), &start);
+    return *stmt ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+}
 
-            error = parser_parse_type(parser, param.type_annotation);
-            if (error != NULL) {
-                vector_free(parameters);
-                return error;
-            }
+// return文の解析（returnは消費済み）
+static SlangError parser_return(Parser* parser, ASTNode** stmt) {
+    const Token start = *parser->previous;
+    ASTNode* value = NULL;
+    if (!parser_check(parser, TOKEN_SEMICOLON)) {
+        SlangError error = parser_expression(parser, &value);
+        if (error != SLANG_SUCCESS) return error;
+    }
 
-            vector_push(parameters, &param);
+    SlangError error = parser_consume(parser, TOKEN_SEMICOLON, "expected ';' after return value");
+    if (error != SLANG_SUCCESS) return error;
+    *stmt = parser_locate(create_return_statement_node(parser->arena, value), &start);
+    return *stmt ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+}
 
-            token = lexer_peek_token(parser->lexer);
-            if (token.type == TOKEN_RIGHT_PAREN) {
-                break;
+// 関数宣言の解析（fnは消費済み）
+static SlangError parser_function(Parser* parser, ASTNode** func) {
+    const Token start = *parser->previous;
+    int priority = parser->pending_priority;
+    parser->pending_priority = 0;
+
+    const char* name;
+    SlangError error = parser_identifier(parser, &name, "expected function name");
+    if (error != SLANG_SUCCESS) return error;
+
+    // 型引数（fn name<T, U>）。注釈のTはtype_named_ofの型になり、型検査が呼び出しごとに置き換える
+    const char* type_parameters[PARSER_MAX_TYPE_PARAMETERS];
+    size_t type_parameter_count = 0;
+    if (parser_match(parser, TOKEN_LT)) {
+        do {
+            if (type_parameter_count == PARSER_MAX_TYPE_PARAMETERS) return parser_fail(parser, "too many type parameters");
+            const char* type_parameter;
+            error = parser_identifier(parser, &type_parameter, "expected type parameter name");
+            if (error != SLANG_SUCCESS) return error;
+            for (size_t i = 0; i < type_parameter_count; i++) {
+                if (type_parameters[i] == type_parameter) return parser_fail(parser, "duplicate type parameter");
             }
-
-            error = parser_expect(parser, TOKEN_COMMA);
-            if (error != NULL) {
-                vector_free(parameters);
-                return error;
+            type_parameters[type_parameter_count++] = type_parameter;
+        } while (parser_match(parser, TOKEN_COMMA));
+        error = parser_consume(parser, TOKEN_GT, "expected '>' after type parameters");
+        if (error != SLANG_SUCCESS) return error;
+    }
+    error = parser_consume(parser, TOKEN_LPAREN, "expected '(' after function name");
+    if (error != SLANG_SUCCESS) return error;
+
+    Variable* parameters[PARSER_MAX_PARAMETERS];
+    size_t parameter_count = 0;
+    if (!parser_check(parser, TOKEN_RPAREN)) {
+        do {
+            if (parameter_count == PARSER_MAX_PARAMETERS) return parser_fail(parser, "too many parameters");
+            Variable* parameter = arena_alloc(parser->arena, sizeof(Variable));
+            if (parameter == NULL) return SLANG_ERROR_INTERNAL;
+            parameter->type = NULL;
+            error = parser_identifier(parser, &parameter->name, "expected parameter name");
+            if (error != SLANG_SUCCESS) return error;
+            if (parser_match(parser, TOKEN_COLON)) {
+                error = parser_type(parser, &parameter->type);
+                if (error != SLANG_SUCCESS) return error;
             }
-        }
+            parameters[parameter_count++] = parameter;
+        } while (parser_match(parser, TOKEN_COMMA));
     }
+    error = parser_consume(parser, TOKEN_RPAREN, "expected ')' after parameters");
+    if (error != SLANG_SUCCESS) return error;
 
-    error = parser_expect(parser, TOKEN_RIGHT_PAREN);
-    if (error != NULL) {
-        vector_free(parameters);
-        return error;
+    Type* return_type = NULL;
+    if (parser_match(parser, TOKEN_ARROW)) {
+        error = parser_type(parser, &return_type);
+        if (error != SLANG_SUCCESS) return error;
     }
 
-    error = parser_expect(parser, TOKEN_ARROW);
-    if (error != NULL) {
-        vector_free(parameters);
-        return error;
-    }
+    ASTNode* body;
+    error = parser_block(parser, &body);
+    if (error != SLANG_SUCCESS) return error;
 
-    error = parser_parse_type(parser, function->return_type);
-    if (error != NULL) {
-        vector_free(parameters);
-        return error;
+    Variable** list = arena_memdup(parser->arena, parameters, parameter_count * sizeof(Variable*));
+    if (parameter_count > 0 && list == NULL) return SLANG_ERROR_INTERNAL;
+    *func = parser_locate(create_function_node(parser->arena, name, return_type, list, parameter_count, body), &start);
+    if (*func == NULL) return SLANG_ERROR_INTERNAL;
+    (*func)->data.function.priority = priority;
+    if (type_parameter_count > 0) {
+        const char** list = arena_memdup(parser->arena, type_parameters, type_parameter_count * sizeof(const char*));
+        if (list == NULL) return SLANG_ERROR_INTERNAL;
+        (*func)->data.function.type_parameters = list;
+        (*func)->data.function.type_parameter_count = type_parameter_count;
     }
+    return SLANG_SUCCESS;
+}
 
-    // Parse priority
-    token = lexer_peek_token(parser->lexer);
-    if (token.type == TOKEN_PRIORITY) {
-        lexer_next_token(parser->lexer);
-        error = parser_parse_integer(parser, &function->priority);
-        if (error != NULL) {
-            vector_free(parameters);
-            return error;
-        }
+// 優先度の指定の解析（Function:type:priority:N; のFunctionは消費済み）
+// Nは整数か、スケジューラの最も低い段階・最も高い段階を表すmost_low・most_high。
+// 値は直後のfnが持っていくので、続くのはfnでなければならない
+static SlangError parser_priority(Parser* parser) {
+    static const char* const words[] = {"type", "priority"};
+    SlangError error;
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        error = parser_consume(parser, TOKEN_COLON, "expected ':' in priority pragma");
+        if (error != SLANG_SUCCESS) return error;
+        const char* word;
+        error = parser_identifier(parser, &word, "expected 'type' or 'priority' in priority pragma");
+        if (error != SLANG_SUCCESS) return error;
+        if (strcmp(word, words[i]) != 0) return parser_fail(parser, "expected 'Function:type:priority:'");
+    }
+    error = parser_consume(parser, TOKEN_COLON, "expected ':' before priority");
+    if (error != SLANG_SUCCESS) return error;
+
+    int64_t value;
+    if (parser_check(parser, TOKEN_IDENTIFIER)) {
+        const char* word;
+        error = parser_identifier(parser, &word, "expected priority value");
+        if (error != SLANG_SUCCESS) return error;
+        if (strcmp(word, "most_low") == 0) value = 0;
+        else if (strcmp(word, "most_high") == 0) value = SCHEDULER_LEVELS - 1;
+        else return parser_fail(parser, "expected priority value, 'most_low' or 'most_high'");
     } else {
-        function->priority = 0;
+        bool negative = parser_match(parser, TOKEN_MINUS);
+        if (!parser_check(parser, TOKEN_INTEGER)) return parser_fail(parser, "expected priority value");
+        value = lexer_token_integer(parser->lexer, parser->current);
+        if (negative) value = -value;
+        if (value < INT_MIN || value > INT_MAX) return parser_fail(parser, "priority out of range");
+        parser_advance(parser);
     }
 
-    // Parse body
-    error = parser_parse_block(parser, &function->body);
-    if (error != NULL) {
-        vector_free(parameters);
-        return error;
+    error = parser_consume(parser, TOKEN_SEMICOLON, "expected ';' after priority");
+    if (error != SLANG_SUCCESS) return error;
+    if (!parser_check(parser, TOKEN_FN) && !parser_check(parser, TOKEN_PUB) && !parser_check(parser, TOKEN_PRIV)) {
+        return parser_fail(parser, "expected 'fn' after priority pragma");
     }
-
-    function->parameters = (Variable**)parameters;
-    return NULL;
+    parser->pending_priority = (int)value;
+    return SLANG_SUCCESS;
 }
 
-SlangError* parser_parse_type(Parser* parser, Type* type) {
-    Token token = lexer_peek_token(parser->lexer);
-    
-    if (token.type == TOKEN_IDENTIFIER) {
-        type->kind = TYPE_NAMED;
-        type->data.named.name = strdup(token.value.string);
-        lexer_next_token(parser->lexer);
-        return NULL;
+// use宣言の解析（useは消費済み）
+// 依存関係はビルドキャッシュが字句解析で集めるので、ここでは読み飛ばすだけでノードは作らない
+static SlangError parser_use(Parser* parser) {
+    if (!parser_match(parser, TOKEN_STRING)) {
+        do {
+            if (!parser_match(parser, TOKEN_IDENTIFIER)) return parser_fail(parser, "expected module path after 'use'");
+        } while (parser_match(parser, TOKEN_DOT));
     }
-    
-    if (token.type == TOKEN_LEFT_BRACKET) {
-        lexer_next_token(parser->lexer);
-        type->kind = TYPE_ARRAY;
-        type->data.array.element_type = (Type*)malloc(sizeof(Type));
-        SlangError* error = parser_parse_type(parser, type->data.array.element_type);
-        if (error != NULL) {
-            return error;
-        }
-        return parser_expect(parser, TOKEN_RIGHT_BRACKET);
-    }
-    
-    if (token.type == TOKEN_LEFT_PAREN) {
-        lexer_next_token(parser->lexer);
-        type->kind = TYPE_TUPLE;
-        Vector* types = vector_new(sizeof(Type));
-        
-        token = lexer_peek_token(parser->lexer);
-        if (token.type != TOKEN_RIGHT_PAREN) {
-            while (1) {
-                Type element_type;
-                SlangError* error = parser_parse_type(parser, &element_type);
-                if (error != NULL) {
-                    vector_free(types);
-                    return error;
-                }
-                vector_push(types, &element_type);
-                
-                token = lexer_peek_token(parser->lexer);
-                if (token.type == TOKEN_RIGHT_PAREN) {
-                    break;
-                }
-                
-                error = parser_expect(parser, TOKEN_COMMA);
-                if (error != NULL) {
-                    vector_free(types);
-                    return error;
-                }
-            }
-        }
-        
-        type->data.tuple.types = (Type**)types;
-        type->data.tuple.type_count = types->size;
-        return parser_expect(parser, TOKEN_RIGHT_PAREN);
-    }
-    
-    return slang_error_new(SLANG_ERROR_SYNTAX, "Expected type");
+    parser_match(parser, TOKEN_SEMICOLON);
+    return SLANG_SUCCESS;
 }
 
-SlangError* parser_parse_type_definition(Parser* parser, TypeDefinition* type_def) {
-    Token token = lexer_next_token(parser->lexer);
-    if (token.type != TOKEN_TYPE) {
-        return slang_error_new(SLANG_ERROR_SYNTAX, "Expected 'type' keyword");
-    }
-
-    SlangError* error = parser_parse_identifier(parser, &type_def->name);
-    if (error != NULL) {
-        return error;
+// 文の解析（宣言もここで扱う。ノードを作らない文なら*stmtはNULLのまま）
+static SlangError parser_statement(Parser* parser, ASTNode** stmt) {
+    // Function:で始まる文は優先度の指定（Functionという名前の関数の呼び出しや代入は式文）
+    if (parser_check(parser, TOKEN_IDENTIFIER) && parser->current->length == 8 &&
+        memcmp(lexer_token_start(parser->lexer, parser->current), "Function", 8) == 0 &&
+        parser_peek_is(parser, TOKEN_COLON)) {
+        parser_advance(parser);
+        return parser_priority(parser);
     }
 
-    error = parser_expect(parser, TOKEN_EQUAL);
-    if (error != NULL) {
-        return error;
+    // 公開範囲の指定は今のところ読み飛ばす
+    if (parser_match(parser, TOKEN_PUB) || parser_match(parser, TOKEN_PRIV)) {
+        if (!parser_check(parser, TOKEN_FN) && !parser_check(parser, TOKEN_LET)) {
+            return parser_fail(parser, "expected 'fn' or 'let' after visibility");
+        }
     }
 
-    error = parser_parse_type(parser, type_def->type);
-    if (error != NULL) {
-        return error;
+    switch (parser->current->type) {
+        case TOKEN_FN:
+            parser_advance(parser);
+            return parser_function(parser, stmt);
+        case TOKEN_LET:
+            parser_advance(parser);
+            return parser_let(parser, stmt);
+        case TOKEN_IF:
+            parser_advance(parser);
+            return parser_if(parser, stmt);
+        case TOKEN_WHILE:
+            parser_advance(parser);
+            return parser_while(parser, stmt);
+        case TOKEN_RETURN:
+            parser_advance(parser);
+            return parser_return(parser, stmt);
+        case TOKEN_USE:
+            parser_advance(parser);
+            return parser_use(parser);
+        case TOKEN_LBRACE:
+            return parser_block(parser, stmt);
+        case TOKEN_SEMICOLON:
+            parser_advance(parser);
+            return SLANG_SUCCESS;
+        case TOKEN_FOR:
+        case TOKEN_BREAK:
+        case TOKEN_CONTINUE:
+        case TOKEN_STRUCT:
+        case TOKEN_IMPL:
+        case TOKEN_TRAIT:
+            // まだASTにノードがない
+            return parser_fail(parser, "unsupported statement");
+        default:
+            break;
     }
 
-    return NULL;
+    // 式文
+    const Token start = *parser->current;
+    ASTNode* expr;
+    SlangError error = parser_expression(parser, &expr);
+    if (error != SLANG_SUCCESS) return error;
+    error = parser_consume(parser, TOKEN_SEMICOLON, "expected ';' after expression");
+    if (error != SLANG_SUCCESS) return error;
+    *stmt = parser_locate(create_expression_statement_node(parser->arena, expr), &start);
+    return *stmt ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
 }
 
-SlangError* parser_parse_identifier(Parser* parser, char** name) {
-    Token token = lexer_next_token(parser->lexer);
-    if (token.type != TOKEN_IDENTIFIER) {
-        return slang_error_new(SLANG_ERROR_SYNTAX, "Expected identifier");
-    }
-    *name = strdup(token.value.string);
-    return NULL;
-}
+// プログラムの解析
+SlangError parser_parse(Parser* parser, ASTNode** ast) {
+    *ast = NULL;
+    parser_advance(parser);
 
-SlangError* parser_parse_integer(Parser* parser, int* value) {
-    Token token = lexer_next_token(parser->lexer);
-    if (token.type != TOKEN_NUMBER) {
-        return slang_error_new(SLANG_ERROR_SYNTAX, "Expected number");
+    SlangError error = parser_statements(parser, false, ast);
+    if (error != SLANG_SUCCESS) {
+        *ast = NULL;
+        return error;
     }
-    *value = (int)token.value.number;
-    return NULL;
+    return parser->error_count > 0 ? SLANG_ERROR_PARSER : SLANG_SUCCESS;
 }
 
-SlangError* parser_parse_block(Parser* parser, ASTNode** block) {
-    Token token = lexer_next_token(parser->lexer);
-    if (token.type != TOKEN_LEFT_BRACE) {
-        return slang_error_new(SLANG_ERROR_SYNTAX, "Expected '{'");
-    }
+// エラーの有無を確認
+bool parser_had_error(Parser* parser) {
+    return parser->error_count > 0;
+}
 
-    Vector* statements = vector_new(sizeof(ASTNode*));
-    while (1) {
-        token = lexer_peek_token(parser->lexer);
-        if (token.type == TOKEN_RIGHT_BRACE) {
-            lexer_next_token(parser->lexer);
-            break;
-        }
+// エラーからの回復
+// 読み済みのトークンを文の境目（;の直後か文の始まりか'}'）まで進めるだけで、字句解析はやり直さない
+void parser_synchronize(Parser* parser) {
+    while (!parser_at_end(parser)) {
+        if (parser->previous != NULL && parser->previous->type == TOKEN_SEMICOLON) return;
 
-        ASTNode* statement;
-        SlangError* error = parser_parse_statement(parser, &statement);
-        if (error != NULL) {
-            vector_free(statements);
-            return error;
+        switch (parser->current->type) {
+            case TOKEN_FN:
+            case TOKEN_STRUCT:
+            case TOKEN_IMPL:
+            case TOKEN_TRAIT:
+            case TOKEN_LET:
+            case TOKEN_IF:
+            case TOKEN_WHILE:
+            case TOKEN_FOR:
+            case TOKEN_RETURN:
+            case TOKEN_USE:
+            case TOKEN_PUB:
+            case TOKEN_PRIV:
+            case TOKEN_RBRACE:
+                return;
+            default:
+                break;
         }
 
-        vector_push(statements, &statement);
-    }
-
-    *block = create_block_statement_node((ASTNode**)statements->data, statements->size);
-    vector_free(statements);
-    return NULL;
-}
-
-SlangError* parser_expect(Parser* parser, TokenType expected) {
-    Token token = lexer_next_token(parser->lexer);
-    if (token.type != expected) {
-        return slang_error_new(SLANG_ERROR_SYNTAX, "Unexpected token");
+        parser_advance(parser);
     }
-    return NULL;
 }
-
-SlangError* parser_parse_statement(Parser* parser, ASTNode** statement) {
-    SlangError* error = NULL;
-    Token token = lexer_peek_token(parser->lexer);
-    
-    if (token.type == TOKEN_VAR) {
-        lexer_next_token(parser->lexer);
-        
-        char* name;
-        error = parser_parse_identifier(parser, &name);
-        if (error != NULL) {
-            return error;
-        }
-        
-        Type* type = NULL;
-        token = lexer_peek_token(parser->lexer);
-        if (token.type == TOKEN_COLON) {
-            lexer_next_token(parser->lexer);
-            type = (Type*)malloc(sizeof(Type));
-            error = parser_parse_type(parser, type);
-            if (error != NULL) {
-                free(name);
-                return error;
-            }
-        }
-        
-        error = parser_expect(parser, TOKEN_EQUAL);
-        if (error != NULL) {
-            free(name);
-            if (type) free_type(type);
-            return error;
-        }
-        
-        ASTNode* initializer;
-        error = parser_parse_expression(parser, &initializer);
-        if (error != NULL) {
-            free(name);
-            if (type) free_type(type);
-            return error;
-        }
-        
-        *statement = create_let_statement_node(name, type, initializer);
-        return NULL;
-    }
-    
-    if (token.type == TOKEN_RETURN) {
-        lexer_next_token(parser->lexer);
-        
-        ASTNode* value = NULL;
-        token = lexer_peek_token(parser->lexer);
-        if (token.type != TOKEN_SEMICOLON) {
-            error = parser_parse_expression(parser, &value);
-            if (error != NULL) {
-                return error;
-            }
-        }
-        
-        *statement = create_expression_statement_node(value);
-        return NULL;
-    }
-    
-    // Expression statement
-    error = parser_parse_expression(parser, statement);
-    if (error != NULL) {
-        return error;
-    }
-    
-    return parser_expect(parser, TOKEN_SEMICOLON);
-}
-
-SlangError* parser_parse_expression(Parser* parser, ASTNode** expression) {
-    Token token = lexer_peek_token(parser->lexer);
-    
-    if (token.type == TOKEN_IDENTIFIER) {
-        char* name = strdup(token.value.string);
-        lexer_next_token(parser->lexer);
-        
-        token = lexer_peek_token(parser->lexer);
-        if (token.type == TOKEN_LEFT_PAREN) {
-            lexer_next_token(parser->lexer);
-            
-            Vector* arguments = vector_new(sizeof(ASTNode*));
-            token = lexer_peek_token(parser->lexer);
-            
-            if (token.type != TOKEN_RIGHT_PAREN) {
-                while (1) {
-                    ASTNode* argument;
-                    SlangError* error = parser_parse_expression(parser, &argument);
-                    if (error != NULL) {
-                        vector_free(arguments);
-                        free(name);
-                        return error;
-                    }
-                    
-                    vector_push(arguments, &argument);
-                    
-                    token = lexer_peek_token(parser->lexer);
-                    if (token.type == TOKEN_RIGHT_PAREN) {
-                        break;
-                    }
-                    
-                    error = parser_expect(parser, TOKEN_COMMA);
-                    if (error != NULL) {
-                        vector_free(arguments);
-                        free(name);
-                        return error;
-                    }
-                }
-            }
-            
-            lexer_next_token(parser->lexer);
-            *expression = create_function_call_node(name, (ASTNode**)arguments->data, arguments->size);
-            vector_free(arguments);
-            return NULL;
-        }
-        
-        *expression = create_variable_reference_node(name);
-        return NULL;
-    }
-    
-    if (token.type == TOKEN_NUMBER) {
-        int value = (int)token.value.number;
-        lexer_next_token(parser->lexer);
-        *expression = create_integer_literal_node(value);
-        return NULL;
-    }
-    
-    if (token.type == TOKEN_STRING) {
-        char* value = strdup(token.value.string);
-        lexer_next_token(parser->lexer);
-        *expression = create_string_literal_node(value);
-        return NULL;
-    }
-    
-    if (token.type == TOKEN_TRUE || token.type == TOKEN_FALSE) {
-        bool value = token.type == TOKEN_TRUE;
-        lexer_next_token(parser->lexer);
-        *expression = create_boolean_literal_node(value);
-        return NULL;
-    }
-    
-    return slang_error_new(SLANG_ERROR_SYNTAX, "Expected expression");
-} 
\ No newline at end of file
@@ -0,0 +1,447 @@
+#include "../include/priority_pool.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define POOL_LARGE_CLASS 0xff
+#define POOL_HEADER_ALIGNMENT 64
+
+// チャンク（POOL_CHUNK_SIZEの境界に置くので、ブロックのアドレスを切り下げれば見つかる）
+// 空きブロックの先頭には次の空きブロックへのポインタを置く
+struct PoolChunk {
+    PoolChunk* next;
+    PoolChunk* prev;
+    PoolChunk** list;          // 今つながっているリスト（段階のロックで守る）
+    size_t size;               // マップした大きさ
+    char* blocks;
+    void* free;                // 返ってきたブロック
+    uint32_t block_size;       // 区分より大きい確保ならその大きさ（ページに切り上げる前）
+    uint32_t block_count;
+    uint32_t used;             // チャンクの外に出ているブロックの数（キャッシュにあるものも含む）
+    uint32_t bump;             // まだ切り出していない最初のブロック
+    uint8_t tier;
+    uint8_t size_class;
+    uint8_t owners[];          // ブロックごとの持ち主の段階
+};
+
+static size_t page_size(void) {
+    static size_t cached = 0;
+    if (cached == 0) cached = (size_t)sysconf(_SC_PAGESIZE);
+    return cached;
+}
+
+static PoolChunk* chunk_of(const void* block) {
+    return (PoolChunk*)((uintptr_t)block & ~((uintptr_t)POOL_CHUNK_SIZE - 1));
+}
+
+static uint32_t block_index(const PoolChunk* chunk, const void* block) {
+    return (uint32_t)(((const char*)block - chunk->blocks) / chunk->block_size);
+}
+
+static unsigned size_class_of(size_t size) {
+    if (size <= POOL_MIN_BLOCK) return 0;
+    return (unsigned)(64 - __builtin_clzll((unsigned long long)size - 1)) - 4;
+}
+
+static void list_push(PoolChunk** list, PoolChunk* chunk) {
+    chunk->prev = NULL;
+    chunk->next = *list;
+    if (*list != NULL) (*list)->prev = chunk;
+    *list = chunk;
+    chunk->list = list;
+}
+
+static void list_remove(PoolChunk* chunk) {
+    if (chunk->prev != NULL) {
+        chunk->prev->next = chunk->next;
+    } else {
+        *chunk->list = chunk->next;
+    }
+    if (chunk->next != NULL) chunk->next->prev = chunk->prev;
+    chunk->list = NULL;
+}
+
+// マップしてよい合計からsizeを取る（limitを超えるなら、tierより低い段階から空けてみる）
+static bool pool_charge(PriorityPool* pool, unsigned tier, size_t size) {
+    size_t limit = pool->options.limit;
+    for (bool reclaimed = false;; reclaimed = true) {
+        size_t mapped = atomic_load_explicit(&pool->mapped, memory_order_relaxed);
+        while (limit == 0 || mapped + size <= limit) {
+            if (atomic_compare_exchange_weak_explicit(&pool->mapped, &mapped, mapped + size,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                atomic_fetch_add_explicit(&pool->tiers[tier].mapped, size, memory_order_relaxed);
+                return true;
+            }
+        }
+        if (reclaimed || tier == 0 || priority_pool_reclaim(pool, mapped + size - limit, tier) == 0) break;
+    }
+    atomic_fetch_add_explicit(&pool->tiers[tier].denied, 1, memory_order_relaxed);
+    return false;
+}
+
+static void pool_uncharge(PriorityPool* pool, unsigned tier, size_t size) {
+    atomic_fetch_sub_explicit(&pool->mapped, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&pool->tiers[tier].mapped, size, memory_order_relaxed);
+}
+
+// POOL_CHUNK_SIZEの境界に置いた領域をマップする（余分にマップして前後を返す）
+static void* map_aligned(size_t size) {
+    size_t span = size + POOL_CHUNK_SIZE;
+    char* region = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) return NULL;
+    char* aligned = (char*)(((uintptr_t)region + POOL_CHUNK_SIZE - 1) & ~((uintptr_t)POOL_CHUNK_SIZE - 1));
+    if (aligned > region) munmap(region, (size_t)(aligned - region));
+    size_t tail = (size_t)(region + span - (aligned + size));
+    if (tail > 0) munmap(aligned + size, tail);
+    return aligned;
+}
+
+// チャンクを作る（段階のロックを持って呼ぶ。block_sizeが0なら区分より大きいlarge_sizeの確保1つ分）
+static PoolChunk* chunk_create(PriorityPool* pool, unsigned tier, unsigned size_class, size_t large_size) {
+    size_t size = POOL_CHUNK_SIZE;
+    size_t block_size = POOL_MIN_BLOCK << size_class;
+    uint32_t block_count;
+    size_t header;
+    if (size_class == POOL_LARGE_CLASS) {
+        header = (sizeof(PoolChunk) + 1 + POOL_HEADER_ALIGNMENT - 1) & ~(size_t)(POOL_HEADER_ALIGNMENT - 1);
+        if (large_size > UINT32_MAX - header) return NULL;
+        size = (header + large_size + page_size() - 1) & ~(page_size() - 1);
+        block_size = large_size;
+        block_count = 1;
+    } else {
+        // 表の分を引いて、残りに入るだけ並べる
+        block_count = (uint32_t)((size - sizeof(PoolChunk) - POOL_HEADER_ALIGNMENT) / (block_size + 1));
+        header = (sizeof(PoolChunk) + block_count + POOL_HEADER_ALIGNMENT - 1) & ~(size_t)(POOL_HEADER_ALIGNMENT - 1);
+    }
+    if (!pool_charge(pool, tier, size)) return NULL;
+
+    PoolChunk* chunk = map_aligned(size);
+    if (chunk == NULL) {
+        pool_uncharge(pool, tier, size);
+        return NULL;
+    }
+    if (tier == POOL_TIERS - 1) {
+#ifdef MADV_HUGEPAGE
+        if (pool->options.huge_pages && size == POOL_CHUNK_SIZE) madvise(chunk, size, MADV_HUGEPAGE);
+#endif
+        // 確保したスレッドが全体に触っておく（あとで確保するときにページフォールトを起こさない）
+        for (size_t offset = 0; offset < size; offset += page_size()) ((volatile char*)chunk)[offset] = 0;
+    }
+
+    chunk->next = NULL;
+    chunk->prev = NULL;
+    chunk->list = NULL;
+    chunk->size = size;
+    chunk->blocks = (char*)chunk + header;
+    chunk->free = NULL;
+    chunk->block_size = (uint32_t)block_size;
+    chunk->block_count = block_count;
+    chunk->used = 0;
+    chunk->bump = 0;
+    chunk->tier = (uint8_t)tier;
+    chunk->size_class = (uint8_t)size_class;
+    pool->tiers[tier].chunks++;
+    return chunk;
+}
+
+// チャンクを返す（段階のロックを持って呼ぶ。リストからは外しておく）
+static void chunk_release(PriorityPool* pool, PoolChunk* chunk) {
+    unsigned tier = chunk->tier;
+    size_t size = chunk->size;
+    pool->tiers[tier].chunks--;
+    munmap(chunk, size);
+    pool_uncharge(pool, tier, size);
+}
+
+static bool chunk_exhausted(const PoolChunk* chunk) {
+    return chunk->free == NULL && chunk->bump == chunk->block_count;
+}
+
+// 段階のチャンクからcount個までのブロックを取ってbinに積む（取れた数を返す）
+static uint32_t bin_refill(PriorityPool* pool, PoolBin* bin, unsigned tier, unsigned size_class, uint32_t count) {
+    PoolTier* state = &pool->tiers[tier];
+    uint32_t taken = 0;
+    pthread_mutex_lock(&state->lock);
+    while (taken < count) {
+        PoolChunk* chunk = state->partial[size_class];
+        if (chunk == NULL) {
+            chunk = chunk_create(pool, tier, size_class, 0);
+            if (chunk == NULL) break;
+            list_push(&state->partial[size_class], chunk);
+        }
+        while (taken < count && !chunk_exhausted(chunk)) {
+            void* block = chunk->free;
+            if (block != NULL) {
+                chunk->free = *(void**)block;
+            } else {
+                block = chunk->blocks + (size_t)chunk->bump++ * chunk->block_size;
+            }
+            *(void**)block = bin->head;
+            bin->head = block;
+            chunk->used++;
+            taken++;
+        }
+        if (chunk_exhausted(chunk)) {
+            list_remove(chunk);
+            list_push(&state->full[size_class], chunk);
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+    bin->count += taken;
+    return taken;
+}
+
+// binの先頭からcount個をチャンクに返す
+static void bin_drain(PriorityPool* pool, PoolBin* bin, unsigned tier, unsigned size_class, uint32_t count) {
+    if (count == 0) return;
+    PoolTier* state = &pool->tiers[tier];
+    pthread_mutex_lock(&state->lock);
+    for (uint32_t i = 0; i < count && bin->head != NULL; i++) {
+        void* block = bin->head;
+        bin->head = *(void**)block;
+        bin->count--;
+
+        PoolChunk* chunk = chunk_of(block);
+        if (chunk_exhausted(chunk)) {
+            list_remove(chunk);
+            list_push(&state->partial[size_class], chunk);
+        }
+        *(void**)block = chunk->free;
+        chunk->free = block;
+        chunk->used--;
+    }
+    pthread_mutex_unlock(&state->lock);
+}
+
+static void owned_add(PoolCache* cache, unsigned tier, int64_t size) {
+    int64_t owned = atomic_load_explicit(&cache->owned[tier], memory_order_relaxed);
+    atomic_store_explicit(&cache->owned[tier], owned + size, memory_order_relaxed);
+}
+
+// プールの作成
+PriorityPool* priority_pool_create(const PriorityPoolOptions* options) {
+    PriorityPool* pool = calloc(1, sizeof(PriorityPool));
+    if (pool == NULL) return NULL;
+    if (options != NULL) pool->options = *options;
+    for (unsigned tier = 0; tier < POOL_TIERS; tier++) {
+        pthread_mutex_init(&pool->tiers[tier].lock, NULL);
+        atomic_init(&pool->tiers[tier].mapped, 0);
+        atomic_init(&pool->tiers[tier].denied, 0);
+    }
+    atomic_init(&pool->mapped, 0);
+    pthread_mutex_init(&pool->caches_lock, NULL);
+
+    // 最も高い段階のチャンクを区分ごとに順に作っておく
+    PoolTier* top = &pool->tiers[POOL_TIERS - 1];
+    pthread_mutex_lock(&top->lock);
+    for (size_t i = 0; i * POOL_CHUNK_SIZE < pool->options.reserve; i++) {
+        unsigned size_class = (unsigned)(i % POOL_SIZE_CLASSES);
+        PoolChunk* chunk = chunk_create(pool, POOL_TIERS - 1, size_class, 0);
+        if (chunk == NULL) break;
+        list_push(&top->partial[size_class], chunk);
+    }
+    pthread_mutex_unlock(&top->lock);
+    return pool;
+}
+
+static void release_list(PriorityPool* pool, PoolChunk** list) {
+    while (*list != NULL) {
+        PoolChunk* chunk = *list;
+        list_remove(chunk);
+        chunk_release(pool, chunk);
+    }
+}
+
+// プールの破棄
+void priority_pool_destroy(PriorityPool* pool) {
+    if (pool == NULL) return;
+
+    for (unsigned tier = 0; tier < POOL_TIERS; tier++) {
+        PoolTier* state = &pool->tiers[tier];
+        pthread_mutex_lock(&state->lock);
+        for (unsigned size_class = 0; size_class < POOL_SIZE_CLASSES; size_class++) {
+            release_list(pool, &state->partial[size_class]);
+            release_list(pool, &state->full[size_class]);
+        }
+        release_list(pool, &state->large);
+        pthread_mutex_unlock(&state->lock);
+        pthread_mutex_destroy(&state->lock);
+    }
+    pthread_mutex_destroy(&pool->caches_lock);
+    free(pool);
+}
+
+unsigned priority_pool_tier(int priority) {
+    if (priority < 0) return 0;
+    if (priority >= POOL_TIERS) return POOL_TIERS - 1;
+    return (unsigned)priority;
+}
+
+// キャッシュの作成
+PoolCache* pool_cache_create(PriorityPool* pool) {
+    PoolCache* cache = calloc(1, sizeof(PoolCache));
+    if (cache == NULL) return NULL;
+    cache->pool = pool;
+    for (unsigned tier = 0; tier < POOL_TIERS; tier++) atomic_init(&cache->owned[tier], 0);
+
+    pthread_mutex_lock(&pool->caches_lock);
+    cache->next = pool->caches;
+    if (pool->caches != NULL) pool->caches->prev = cache;
+    pool->caches = cache;
+    pthread_mutex_unlock(&pool->caches_lock);
+    return cache;
+}
+
+void pool_cache_flush(PoolCache* cache) {
+    for (unsigned tier = 0; tier < POOL_TIERS; tier++) {
+        for (unsigned size_class = 0; size_class < POOL_SIZE_CLASSES; size_class++) {
+            PoolBin* bin = &cache->bins[tier][size_class];
+            bin_drain(cache->pool, bin, tier, size_class, bin->count);
+        }
+    }
+}
+
+// キャッシュの破棄
+void pool_cache_destroy(PoolCache* cache) {
+    if (cache == NULL) return;
+    pool_cache_flush(cache);
+
+    PriorityPool* pool = cache->pool;
+    pthread_mutex_lock(&pool->caches_lock);
+    if (cache->prev != NULL) {
+        cache->prev->next = cache->next;
+    } else {
+        pool->caches = cache->next;
+    }
+    if (cache->next != NULL) cache->next->prev = cache->prev;
+    for (unsigned tier = 0; tier < POOL_TIERS; tier++) {
+        pool->retired_owned[tier] += atomic_load_explicit(&cache->owned[tier], memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&pool->caches_lock);
+    free(cache);
+}
+
+// 区分より大きい確保
+static void* large_alloc(PoolCache* cache, unsigned tier, size_t size) {
+    PoolTier* state = &cache->pool->tiers[tier];
+    size = (size + POOL_MIN_BLOCK - 1) & ~(size_t)(POOL_MIN_BLOCK - 1);
+    pthread_mutex_lock(&state->lock);
+    PoolChunk* chunk = chunk_create(cache->pool, tier, POOL_LARGE_CLASS, size);
+    if (chunk != NULL) {
+        chunk->used = 1;
+        chunk->bump = 1;
+        list_push(&state->large, chunk);
+    }
+    pthread_mutex_unlock(&state->lock);
+    if (chunk == NULL) return NULL;
+
+    chunk->owners[0] = (uint8_t)tier;
+    owned_add(cache, tier, (int64_t)size);
+    return chunk->blocks;
+}
+
+void* priority_pool_alloc(PoolCache* cache, unsigned tier, size_t size) {
+    if (tier >= POOL_TIERS) tier = POOL_TIERS - 1;
+    if (size > POOL_MAX_BLOCK) return large_alloc(cache, tier, size);
+
+    unsigned size_class = size_class_of(size);
+    PoolBin* bin = &cache->bins[tier][size_class];
+    if (bin->head == NULL && bin_refill(cache->pool, bin, tier, size_class, POOL_CACHE_LIMIT / 2) == 0) return NULL;
+
+    void* block = bin->head;
+    bin->head = *(void**)block;
+    bin->count--;
+
+    PoolChunk* chunk = chunk_of(block);
+    chunk->owners[block_index(chunk, block)] = (uint8_t)tier;
+    owned_add(cache, tier, chunk->block_size);
+    return block;
+}
+
+void priority_pool_free(PoolCache* cache, void* block) {
+    if (block == NULL) return;
+
+    PoolChunk* chunk = chunk_of(block);
+    if (chunk->size_class == POOL_LARGE_CLASS) {
+        PoolTier* state = &cache->pool->tiers[chunk->tier];
+        owned_add(cache, chunk->owners[0], -(int64_t)chunk->block_size);
+        pthread_mutex_lock(&state->lock);
+        list_remove(chunk);
+        chunk_release(cache->pool, chunk);
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+
+    owned_add(cache, chunk->owners[block_index(chunk, block)], -(int64_t)chunk->block_size);
+    PoolBin* bin = &cache->bins[chunk->tier][chunk->size_class];
+    *(void**)block = bin->head;
+    bin->head = block;
+    bin->count++;
+    // 溢れたら半分をチャンクに返す
+    if (bin->count > POOL_CACHE_LIMIT) bin_drain(cache->pool, bin, chunk->tier, chunk->size_class, POOL_CACHE_LIMIT / 2);
+}
+
+bool priority_pool_transfer(PoolCache* cache, void* block, const Type* owner_type, const Type* new_type,
+                            unsigned tier) {
+    if (!type_can_own(new_type, owner_type)) return false;
+    if (tier >= POOL_TIERS) tier = POOL_TIERS - 1;
+
+    PoolChunk* chunk = chunk_of(block);
+    uint8_t* owner = &chunk->owners[chunk->size_class == POOL_LARGE_CLASS ? 0 : block_index(chunk, block)];
+    owned_add(cache, *owner, -(int64_t)chunk->block_size);
+    owned_add(cache, tier, chunk->block_size);
+    *owner = (uint8_t)tier;
+    return true;
+}
+
+unsigned priority_pool_owner(const void* block) {
+    const PoolChunk* chunk = chunk_of(block);
+    return chunk->owners[chunk->size_class == POOL_LARGE_CLASS ? 0 : block_index(chunk, block)];
+}
+
+size_t priority_pool_block_size(const void* block) {
+    return chunk_of(block)->block_size;
+}
+
+size_t priority_pool_reclaim(PriorityPool* pool, size_t bytes, unsigned below_tier) {
+    size_t released = 0;
+    if (below_tier > POOL_TIERS) below_tier = POOL_TIERS;
+    for (unsigned tier = 0; tier < below_tier && released < bytes; tier++) {
+        PoolTier* state = &pool->tiers[tier];
+        pthread_mutex_lock(&state->lock);
+        for (unsigned size_class = 0; size_class < POOL_SIZE_CLASSES && released < bytes; size_class++) {
+            PoolChunk* chunk = state->partial[size_class];
+            while (chunk != NULL && released < bytes) {
+                PoolChunk* next = chunk->next;
+                if (chunk->used == 0) {
+                    released += chunk->size;
+                    state->reclaimed += chunk->size;
+                    list_remove(chunk);
+                    chunk_release(pool, chunk);
+                }
+                chunk = next;
+            }
+        }
+        pthread_mutex_unlock(&state->lock);
+    }
+    return released;
+}
+
+void priority_pool_stats(PriorityPool* pool, unsigned tier, PoolTierStats* stats) {
+    if (tier >= POOL_TIERS) tier = POOL_TIERS - 1;
+    PoolTier* state = &pool->tiers[tier];
+
+    pthread_mutex_lock(&state->lock);
+    stats->chunks = state->chunks;
+    stats->reclaimed = state->reclaimed;
+    pthread_mutex_unlock(&state->lock);
+    stats->mapped = atomic_load_explicit(&state->mapped, memory_order_relaxed);
+    stats->denied = atomic_load_explicit(&state->denied, memory_order_relaxed);
+
+    pthread_mutex_lock(&pool->caches_lock);
+    stats->owned = pool->retired_owned[tier];
+    for (PoolCache* cache = pool->caches; cache != NULL; cache = cache->next) {
+        stats->owned += atomic_load_explicit(&cache->owned[tier], memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&pool->caches_lock);
+}
@@ -0,0 +1,608 @@
+#define _GNU_SOURCE
+#include "../include/profiler.h"
+#include "../include/scheduler.h"
+#include <elf.h>
+#include <errno.h>
+#include <link.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#define FRAME_PAGE_SIZE 4096u           // 実際のページがもっと大きくても、この単位で読めれば読める
+#define MAX_FRAME_SIZE ((uintptr_t)1 << 20)
+
+static uint64_t process_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// 標本の先頭の語: 深さ、実効の段階、投入したときの段階、タスクの中か（深さは1以上なので0なら終わり）
+#define HEADER_DEPTH(header) ((unsigned)((header) & 0xff))
+#define HEADER_LEVEL(header) ((unsigned)(((header) >> 8) & 0xff))
+#define HEADER_BASE(header) ((unsigned)(((header) >> 16) & 0xff))
+#define HEADER_IN_TASK(header) ((((header) >> 24) & 1) != 0)
+
+// シグナルハンドラと共有する状態（プロセスに1つ）
+static uintptr_t* buffer = NULL;
+static size_t buffer_capacity = 0;
+static atomic_size_t buffer_used = 0;
+static atomic_bool running = false;
+static atomic_int active_handlers = 0;
+static atomic_size_t sample_count = 0;
+static atomic_size_t dropped_count = 0;
+static atomic_size_t inverted_count = 0;
+static atomic_size_t deepest = 0;
+static pid_t self_pid = 0;
+static unsigned sample_frequency = 0;
+static uint64_t started_cpu_ns = 0;
+static uint64_t profiled_cpu_ns = 0;      // 動かしていた間のプロセスのCPU時間
+static struct sigaction previous_action;
+
+// fpのフレーム（保存したrbpと戻り番地）を読む。readable_pageは最後に読めると確かめたページ
+static bool read_frame(uintptr_t fp, uintptr_t frame[2], uintptr_t* readable_page) {
+    uintptr_t first = fp & ~(uintptr_t)(FRAME_PAGE_SIZE - 1);
+    uintptr_t last = (fp + 2 * sizeof(uintptr_t) - 1) & ~(uintptr_t)(FRAME_PAGE_SIZE - 1);
+    if (first == *readable_page && last == first) {
+        memcpy(frame, (const void*)fp, 2 * sizeof(uintptr_t));
+        return true;
+    }
+    // 読めないページならEFAULTが返るだけで、シグナルにはならない
+    struct iovec local = { frame, 2 * sizeof(uintptr_t) };
+    struct iovec remote = { (void*)fp, 2 * sizeof(uintptr_t) };
+    if (process_vm_readv(self_pid, &local, 1, &remote, 1, 0) != (ssize_t)(2 * sizeof(uintptr_t))) return false;
+    *readable_page = last;
+    return true;
+}
+
+static void profiler_handler(int signal_number, siginfo_t* info, void* context) {
+    (void)signal_number;
+    (void)info;
+    int saved_errno = errno;
+    atomic_fetch_add_explicit(&active_handlers, 1, memory_order_seq_cst);
+    if (!atomic_load_explicit(&running, memory_order_seq_cst)) {
+        atomic_fetch_sub_explicit(&active_handlers, 1, memory_order_seq_cst);
+        errno = saved_errno;
+        return;
+    }
+
+    uintptr_t pcs[PROFILER_MAX_DEPTH];
+    size_t depth = 0;
+#if defined(__x86_64__)
+    const ucontext_t* uc = context;
+    pcs[depth++] = (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+    uintptr_t sp = (uintptr_t)uc->uc_mcontext.gregs[REG_RSP];
+    uintptr_t fp = (uintptr_t)uc->uc_mcontext.gregs[REG_RBP];
+    // フレームはスタックの上（番地の大きいほう）へ順に並ぶ。そうでなければrbpはフレームポインタではない
+    uintptr_t previous = sp, readable_page = 0, frame[2];
+    while (depth < PROFILER_MAX_DEPTH && fp >= previous && fp - previous < MAX_FRAME_SIZE &&
+           fp % sizeof(uintptr_t) == 0 && read_frame(fp, frame, &readable_page) && frame[1] != 0) {
+        pcs[depth++] = frame[1];
+        previous = fp + 2 * sizeof(uintptr_t);
+        fp = frame[0];
+    }
+#else
+    (void)context;
+    pcs[depth++] = 0;
+#endif
+
+    unsigned level = 0, base = 0;
+    bool in_task = scheduler_current_levels(&level, &base);
+    size_t words = depth + 1;
+    size_t at = atomic_fetch_add_explicit(&buffer_used, words, memory_order_relaxed);
+    if (at + words <= buffer_capacity) {
+        memcpy(buffer + at + 1, pcs, depth * sizeof(uintptr_t));
+        buffer[at] = (uintptr_t)depth | (uintptr_t)level << 8 | (uintptr_t)base << 16 | (uintptr_t)in_task << 24;
+        atomic_fetch_add_explicit(&sample_count, 1, memory_order_relaxed);
+        if (in_task && level > base) atomic_fetch_add_explicit(&inverted_count, 1, memory_order_relaxed);
+        size_t known = atomic_load_explicit(&deepest, memory_order_relaxed);
+        while (depth > known && !atomic_compare_exchange_weak_explicit(&deepest, &known, depth,
+                                                                      memory_order_relaxed, memory_order_relaxed)) {
+        }
+    } else {
+        atomic_fetch_add_explicit(&dropped_count, 1, memory_order_relaxed);
+    }
+
+    atomic_fetch_sub_explicit(&active_handlers, 1, memory_order_seq_cst);
+    errno = saved_errno;
+}
+
+SlangError profiler_start(const ProfilerOptions* options) {
+#if !defined(__x86_64__)
+    (void)options;
+    return SLANG_ERROR_INTERNAL;
+#else
+    if (atomic_load(&running)) return SLANG_ERROR_INTERNAL;
+    unsigned frequency = options && options->frequency ? options->frequency : PROFILER_DEFAULT_FREQUENCY;
+    size_t words = options && options->buffer_words ? options->buffer_words : PROFILER_DEFAULT_BUFFER_WORDS;
+    if (frequency > 1000000) frequency = 1000000;
+
+    // 前回の標本を捨てる（ハンドラはprofiler_stopで終わっている）
+    free(buffer);
+    buffer = calloc(words, sizeof(uintptr_t));
+    if (buffer == NULL) {
+        buffer_capacity = 0;
+        return SLANG_ERROR_INTERNAL;
+    }
+    buffer_capacity = words;
+    atomic_store(&buffer_used, 0);
+    atomic_store(&sample_count, 0);
+    atomic_store(&dropped_count, 0);
+    atomic_store(&inverted_count, 0);
+    atomic_store(&deepest, 0);
+    self_pid = getpid();
+    sample_frequency = frequency;
+    profiled_cpu_ns = 0;
+    started_cpu_ns = process_cpu_ns();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = profiler_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previous_action) != 0) return SLANG_ERROR_INTERNAL;
+
+    atomic_store(&running, true);
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = (suseconds_t)(1000000 / frequency);
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+        atomic_store(&running, false);
+        sigaction(SIGPROF, &previous_action, NULL);
+        return SLANG_ERROR_INTERNAL;
+    }
+    return SLANG_SUCCESS;
+#endif
+}
+
+void profiler_stop(void) {
+    if (!atomic_load(&running)) return;
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    atomic_store(&running, false);
+    while (atomic_load(&active_handlers) > 0) sched_yield();
+    profiled_cpu_ns = process_cpu_ns() - started_cpu_ns;
+
+    // 止める前に生じて届いていないSIGPROFが既定の動作（終了）にならないように、元が既定なら無視にしておく
+    if (!(previous_action.sa_flags & SA_SIGINFO) && previous_action.sa_handler == SIG_DFL) {
+        previous_action.sa_handler = SIG_IGN;
+    }
+    sigaction(SIGPROF, &previous_action, NULL);
+}
+
+void profiler_stats(ProfilerStats* stats) {
+    stats->samples = atomic_load(&sample_count);
+    stats->dropped = atomic_load(&dropped_count);
+    stats->inverted = atomic_load(&inverted_count);
+    stats->max_depth = atomic_load(&deepest);
+}
+
+// ---------------------------------------------------------------------------
+// 標本を読む（止めてから）
+
+typedef struct {
+    const uintptr_t* pcs;      // pcs[0]は割り込まれた番地、残りは戻り番地
+    unsigned depth;
+    unsigned level;
+    unsigned base_level;
+    bool in_task;
+} Sample;
+
+static bool next_sample(size_t* offset, Sample* sample) {
+    size_t used = atomic_load(&buffer_used);
+    size_t limit = used < buffer_capacity ? used : buffer_capacity;
+    if (*offset >= limit || buffer[*offset] == 0) return false;
+    uintptr_t header = buffer[*offset];
+    sample->depth = HEADER_DEPTH(header);
+    if (*offset + 1 + sample->depth > limit) return false;
+    sample->pcs = buffer + *offset + 1;
+    sample->level = HEADER_LEVEL(header);
+    sample->base_level = HEADER_BASE(header);
+    sample->in_task = HEADER_IN_TASK(header);
+    *offset += 1 + sample->depth;
+    return true;
+}
+
+static bool sample_inverted(const Sample* sample) {
+    return sample->in_task && sample->level > sample->base_level;
+}
+
+// カーネルはCPU時間のタイマーを刻みごとにしか調べないので、頼んだ周波数より少なくしか取れないことがある。
+// 周期は動かしていた間のCPU時間を標本の数で割って求める
+static double sample_period(void) {
+    size_t samples = atomic_load(&sample_count) + atomic_load(&dropped_count);
+    if (samples == 0 || profiled_cpu_ns == 0) return 1.0 / sample_frequency;
+    return (double)profiled_cpu_ns * 1e-9 / (double)samples;
+}
+
+SlangError profiler_write_pprof(const char* path) {
+    if (atomic_load(&running) || buffer == NULL) return SLANG_ERROR_INTERNAL;
+    FILE* out = fopen(path, "wb");
+    if (out == NULL) return SLANG_ERROR_IO;
+
+    // 見出し（0, 見出しの残りの語数, 版, 周期（マイクロ秒）, 0）、標本（数, 深さ, 番地...）、終わり（0, 1, 0）
+    uintptr_t period_us = (uintptr_t)(sample_period() * 1e6 + 0.5);
+    uintptr_t header[] = { 0, 3, 0, period_us ? period_us : 1, 0 };
+    fwrite(header, sizeof(uintptr_t), 5, out);
+    Sample sample;
+    for (size_t offset = 0; next_sample(&offset, &sample);) {
+        uintptr_t record[2] = { 1, sample.depth };
+        fwrite(record, sizeof(uintptr_t), 2, out);
+        fwrite(sample.pcs, sizeof(uintptr_t), sample.depth, out);
+    }
+    uintptr_t trailer[] = { 0, 1, 0 };
+    fwrite(trailer, sizeof(uintptr_t), 3, out);
+
+    // pprofは番地を対応表で実行ファイルと共有ライブラリに振り分ける
+    FILE* maps = fopen("/proc/self/maps", "r");
+    if (maps != NULL) {
+        char chunk[4096];
+        for (size_t n; (n = fread(chunk, 1, sizeof(chunk), maps)) > 0;) fwrite(chunk, 1, n, out);
+        fclose(maps);
+    }
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok ? SLANG_SUCCESS : SLANG_ERROR_IO;
+}
+
+// ---------------------------------------------------------------------------
+// 記号の解決（/proc/self/exeの記号表と、読み込まれているモジュールの範囲）
+
+typedef struct {
+    uintptr_t address;
+    size_t size;               // 0なら次の記号まで（コード生成の記号は大きさを持たない）
+    const char* name;
+    int priority;              // 宣言された優先度（なければ0）
+} ProfilerSymbol;
+
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+    const char* name;
+    bool main;
+} ProfilerModule;
+
+typedef struct {
+    char* image;               // 実行ファイルの中身（記号の名前はここを指す）
+    ProfilerSymbol* symbols;   // 番地の順
+    size_t symbol_count;
+    ProfilerModule* modules;
+    size_t module_count;
+    size_t module_capacity;
+    uintptr_t main_base;
+} Symbolizer;
+
+typedef struct {
+    const ProfilerSymbol* symbol;
+    const ProfilerModule* module;
+} ProfilerFrame;
+
+typedef struct {
+    const char* name;          // PROFILER_PRIORITY_PREFIXを除いた関数の名前
+    int priority;
+} PriorityEntry;
+
+static int module_callback(struct dl_phdr_info* info, size_t size, void* data) {
+    (void)size;
+    Symbolizer* symbolizer = data;
+    bool main = symbolizer->module_count == 0 && (info->dlpi_name == NULL || info->dlpi_name[0] == '\0');
+    if (main) symbolizer->main_base = (uintptr_t)info->dlpi_addr;
+    for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* header = &info->dlpi_phdr[i];
+        if (header->p_type != PT_LOAD || !(header->p_flags & PF_X)) continue;
+        if (symbolizer->module_count == symbolizer->module_capacity) {
+            size_t capacity = symbolizer->module_capacity ? symbolizer->module_capacity * 2 : 16;
+            ProfilerModule* grown = realloc(symbolizer->modules, capacity * sizeof(ProfilerModule));
+            if (grown == NULL) return 1;
+            symbolizer->modules = grown;
+            symbolizer->module_capacity = capacity;
+        }
+        const char* name = main ? program_invocation_short_name : info->dlpi_name;
+        const char* slash = strrchr(name, '/');
+        uintptr_t start = (uintptr_t)info->dlpi_addr + header->p_vaddr;
+        symbolizer->modules[symbolizer->module_count++] =
+            (ProfilerModule){ start, start + header->p_memsz, slash ? slash + 1 : name, main };
+    }
+    return 0;
+}
+
+static char* read_file(const char* path, size_t* length) {
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) return NULL;
+    size_t capacity = 1 << 20, used = 0;
+    char* data = malloc(capacity);
+    for (size_t n; data != NULL && (n = fread(data + used, 1, capacity - used, in)) > 0;) {
+        used += n;
+        if (used == capacity) {
+            char* grown = realloc(data, capacity * 2);
+            if (grown == NULL) free(data);
+            data = grown;
+            capacity *= 2;
+        }
+    }
+    fclose(in);
+    *length = used;
+    return data;
+}
+
+static int compare_symbols(const void* a, const void* b) {
+    const ProfilerSymbol* left = a;
+    const ProfilerSymbol* right = b;
+    return (left->address > right->address) - (left->address < right->address);
+}
+
+static int compare_priorities(const void* a, const void* b) {
+    return strcmp(((const PriorityEntry*)a)->name, ((const PriorityEntry*)b)->name);
+}
+
+// 記号表（なければ動的記号表）から関数と優先度の記号を拾う
+static bool load_symbols(Symbolizer* symbolizer) {
+    size_t length = 0;
+    symbolizer->image = read_file("/proc/self/exe", &length);
+    const char* image = symbolizer->image;
+    if (image == NULL || length < sizeof(Elf64_Ehdr) || memcmp(image, ELFMAG, SELFMAG) != 0) return true;
+    const Elf64_Ehdr* elf = (const Elf64_Ehdr*)image;
+    if (elf->e_ident[EI_CLASS] != ELFCLASS64 || elf->e_shoff == 0 ||
+        elf->e_shoff + (size_t)elf->e_shnum * sizeof(Elf64_Shdr) > length) {
+        return true;
+    }
+    const Elf64_Shdr* sections = (const Elf64_Shdr*)(image + elf->e_shoff);
+    const Elf64_Shdr* table = NULL;
+    for (int pass = 0; pass < 2 && table == NULL; pass++) {
+        for (Elf64_Half i = 0; i < elf->e_shnum; i++) {
+            if (sections[i].sh_type == (pass == 0 ? SHT_SYMTAB : SHT_DYNSYM)) table = &sections[i];
+        }
+    }
+    if (table == NULL || table->sh_link >= elf->e_shnum) return true;
+    const Elf64_Shdr* strings = &sections[table->sh_link];
+    if (table->sh_offset + table->sh_size > length || strings->sh_offset + strings->sh_size > length) return true;
+
+    const Elf64_Sym* entries = (const Elf64_Sym*)(image + table->sh_offset);
+    size_t entry_count = table->sh_size / sizeof(Elf64_Sym);
+    symbolizer->symbols = malloc((entry_count ? entry_count : 1) * sizeof(ProfilerSymbol));
+    PriorityEntry* priorities = malloc((entry_count ? entry_count : 1) * sizeof(PriorityEntry));
+    if (symbolizer->symbols == NULL || priorities == NULL) {
+        free(priorities);
+        return false;
+    }
+    size_t priority_count = 0;
+    size_t prefix_length = strlen(PROFILER_PRIORITY_PREFIX);
+    for (size_t i = 0; i < entry_count; i++) {
+        const Elf64_Sym* entry = &entries[i];
+        if (entry->st_name >= strings->sh_size) continue;
+        const char* name = image + strings->sh_offset + entry->st_name;
+        unsigned type = ELF64_ST_TYPE(entry->st_info);
+        if (entry->st_shndx == SHN_ABS) {
+            if (strncmp(name, PROFILER_PRIORITY_PREFIX, prefix_length) == 0) {
+                priorities[priority_count++] = (PriorityEntry){ name + prefix_length, (int)(int64_t)entry->st_value };
+            }
+            continue;
+        }
+        // アセンブラで書いた記号は型を持たないことがある（.Lで始まる局所ラベルは除く）
+        if (entry->st_shndx == SHN_UNDEF || entry->st_value == 0 || name[0] == '\0' ||
+            (type != STT_FUNC && type != STT_NOTYPE) || strncmp(name, ".L", 2) == 0) {
+            continue;
+        }
+        symbolizer->symbols[symbolizer->symbol_count++] =
+            (ProfilerSymbol){ symbolizer->main_base + entry->st_value, entry->st_size, name, 0 };
+    }
+    qsort(symbolizer->symbols, symbolizer->symbol_count, sizeof(ProfilerSymbol), compare_symbols);
+
+    qsort(priorities, priority_count, sizeof(PriorityEntry), compare_priorities);
+    for (size_t i = 0; priority_count > 0 && i < symbolizer->symbol_count; i++) {
+        PriorityEntry key = { symbolizer->symbols[i].name, 0 };
+        const PriorityEntry* found = bsearch(&key, priorities, priority_count, sizeof(PriorityEntry), compare_priorities);
+        if (found != NULL) symbolizer->symbols[i].priority = found->priority;
+    }
+    free(priorities);
+    return true;
+}
+
+static bool symbolizer_init(Symbolizer* symbolizer) {
+    memset(symbolizer, 0, sizeof(Symbolizer));
+    dl_iterate_phdr(module_callback, symbolizer);
+    return load_symbols(symbolizer);
+}
+
+static void symbolizer_free(Symbolizer* symbolizer) {
+    free(symbolizer->image);
+    free(symbolizer->symbols);
+    free(symbolizer->modules);
+}
+
+static ProfilerFrame symbolizer_lookup(const Symbolizer* symbolizer, uintptr_t pc) {
+    ProfilerFrame frame = { NULL, NULL };
+    for (size_t i = 0; i < symbolizer->module_count; i++) {
+        const ProfilerModule* module = &symbolizer->modules[i];
+        if (pc >= module->start && pc < module->end) {
+            frame.module = module;
+            break;
+        }
+    }
+    if (frame.module == NULL || !frame.module->main) return frame;
+
+    // pc以下で最も大きい番地の記号
+    size_t low = 0, high = symbolizer->symbol_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (symbolizer->symbols[middle].address <= pc) low = middle + 1;
+        else high = middle;
+    }
+    if (low > 0) {
+        const ProfilerSymbol* symbol = &symbolizer->symbols[low - 1];
+        if (symbol->size == 0 || pc < symbol->address + symbol->size) frame.symbol = symbol;
+    }
+    return frame;
+}
+
+// 戻り番地は呼び出し命令の次を指すので、1つ前の番地で引く（末尾で呼ぶ関数が次の関数に見えないように）
+static ProfilerFrame sample_frame(const Symbolizer* symbolizer, const Sample* sample, unsigned index) {
+    return symbolizer_lookup(symbolizer, index == 0 ? sample->pcs[0] : sample->pcs[index] - 1);
+}
+
+static void write_frame(FILE* out, ProfilerFrame frame) {
+    if (frame.symbol != NULL) {
+        fputs(frame.symbol->name, out);
+        if (frame.symbol->priority != 0) fprintf(out, " [priority %d]", frame.symbol->priority);
+    } else {
+        fprintf(out, "[%s]", frame.module != NULL ? frame.module->name : "unknown");
+    }
+}
+
+static void write_root(FILE* out, const Sample* sample) {
+    if (!sample->in_task) fputs("no task", out);
+    else if (sample_inverted(sample)) fprintf(out, "priority %u (inherited from %u)", sample->level, sample->base_level);
+    else fprintf(out, "priority %u", sample->level);
+}
+
+static int compare_lines(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+SlangError profiler_write_folded(const char* path) {
+    if (atomic_load(&running) || buffer == NULL) return SLANG_ERROR_INTERNAL;
+    Symbolizer symbolizer;
+    size_t count = atomic_load(&sample_count);
+    char** lines = calloc(count ? count : 1, sizeof(char*));
+    if (lines == NULL || !symbolizer_init(&symbolizer)) {
+        free(lines);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    // 標本ごとに根から葉への列を作り、並べてから同じ列を数える
+    size_t line_count = 0;
+    bool ok = true;
+    Sample sample;
+    for (size_t offset = 0; ok && line_count < count && next_sample(&offset, &sample);) {
+        size_t size = 0;
+        FILE* line = open_memstream(&lines[line_count], &size);
+        if (line == NULL) {
+            ok = false;
+            break;
+        }
+        write_root(line, &sample);
+        for (unsigned i = sample.depth; i-- > 0;) {
+            fputc(';', line);
+            write_frame(line, sample_frame(&symbolizer, &sample, i));
+        }
+        ok = fclose(line) == 0;
+        line_count++;
+    }
+    qsort(lines, line_count, sizeof(char*), compare_lines);
+
+    FILE* out = ok ? fopen(path, "w") : NULL;
+    for (size_t i = 0; out != NULL && i < line_count;) {
+        size_t j = i + 1;
+        while (j < line_count && strcmp(lines[i], lines[j]) == 0) j++;
+        fprintf(out, "%s %zu\n", lines[i], j - i);
+        i = j;
+    }
+    for (size_t i = 0; i < line_count; i++) free(lines[i]);
+    free(lines);
+    symbolizer_free(&symbolizer);
+    if (!ok) return SLANG_ERROR_INTERNAL;
+    if (out == NULL) return SLANG_ERROR_IO;
+    ok = !ferror(out);
+    return fclose(out) == 0 && ok ? SLANG_SUCCESS : SLANG_ERROR_IO;
+}
+
+// ---------------------------------------------------------------------------
+// 報告
+
+typedef struct {
+    ProfilerFrame frame;
+    size_t count;
+} FrameTotal;
+
+static int compare_frames(const void* a, const void* b) {
+    const ProfilerFrame* left = a;
+    const ProfilerFrame* right = b;
+    uintptr_t l = (uintptr_t)left->symbol, r = (uintptr_t)right->symbol;
+    if (l == r) l = (uintptr_t)left->module, r = (uintptr_t)right->module;
+    return (l > r) - (l < r);
+}
+
+static int compare_totals(const void* a, const void* b) {
+    const FrameTotal* left = a;
+    const FrameTotal* right = b;
+    return (left->count < right->count) - (left->count > right->count);
+}
+
+// 葉の関数ごとの標本の数（framesは並べ替える）
+static void report_functions(FILE* out, ProfilerFrame* frames, size_t count, size_t top, size_t total) {
+    qsort(frames, count, sizeof(ProfilerFrame), compare_frames);
+    FrameTotal* totals = malloc((count ? count : 1) * sizeof(FrameTotal));
+    if (totals == NULL) return;
+    size_t total_count = 0;
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && compare_frames(&frames[i], &frames[j]) == 0) j++;
+        totals[total_count++] = (FrameTotal){ frames[i], j - i };
+        i = j;
+    }
+    qsort(totals, total_count, sizeof(FrameTotal), compare_totals);
+    for (size_t i = 0; i < total_count && i < top; i++) {
+        fprintf(out, "  %8zu %6.1f%%  ", totals[i].count, total ? 100.0 * (double)totals[i].count / (double)total : 0.0);
+        write_frame(out, totals[i].frame);
+        fputc('\n', out);
+    }
+    free(totals);
+}
+
+SlangError profiler_report(FILE* out, size_t top) {
+    if (atomic_load(&running) || buffer == NULL) return SLANG_ERROR_INTERNAL;
+    Symbolizer symbolizer;
+    size_t count = atomic_load(&sample_count);
+    ProfilerFrame* leaves = malloc((count ? count : 1) * sizeof(ProfilerFrame));
+    ProfilerFrame* inverted = malloc((count ? count : 1) * sizeof(ProfilerFrame));
+    if (leaves == NULL || inverted == NULL || !symbolizer_init(&symbolizer)) {
+        free(leaves);
+        free(inverted);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    size_t levels[SCHEDULER_LEVELS] = { 0 };
+    size_t outside = 0, leaf_count = 0, inverted_samples = 0;
+    Sample sample;
+    for (size_t offset = 0; leaf_count < count && next_sample(&offset, &sample);) {
+        ProfilerFrame leaf = sample_frame(&symbolizer, &sample, 0);
+        leaves[leaf_count++] = leaf;
+        if (!sample.in_task) outside++;
+        else if (sample.level < SCHEDULER_LEVELS) levels[sample.level]++;
+        if (sample_inverted(&sample)) inverted[inverted_samples++] = leaf;
+    }
+
+    ProfilerStats stats;
+    profiler_stats(&stats);
+    double period = sample_period();
+    fprintf(out, "%zu samples at %.0f Hz (%u requested) over %.3f s CPU, %zu dropped, max depth %zu\n", leaf_count,
+            1.0 / period, sample_frequency, (double)profiled_cpu_ns * 1e-9, stats.dropped, stats.max_depth);
+    fprintf(out, "  %-8s %8s %7s\n", "level", "samples", "%");
+    for (unsigned level = SCHEDULER_LEVELS; level-- > 0;) {
+        fprintf(out, "  %-8u %8zu %6.1f%%\n", level, levels[level],
+                leaf_count ? 100.0 * (double)levels[level] / (double)leaf_count : 0.0);
+    }
+    fprintf(out, "  %-8s %8zu %6.1f%%\n", "no task", outside,
+            leaf_count ? 100.0 * (double)outside / (double)leaf_count : 0.0);
+
+    fprintf(out, "self time:\n");
+    report_functions(out, leaves, leaf_count, top, leaf_count);
+    // 継承で上がったタスクの時間は、高い段階のタスクが低い段階のタスクを待っていた時間
+    fprintf(out, "priority inversion: %zu samples (%.1f%%) in tasks running above their spawned level\n",
+            inverted_samples, leaf_count ? 100.0 * (double)inverted_samples / (double)leaf_count : 0.0);
+    report_functions(out, inverted, inverted_samples, top, leaf_count);
+
+    free(leaves);
+    free(inverted);
+    symbolizer_free(&symbolizer);
+    return ferror(out) ? SLANG_ERROR_IO : SLANG_SUCCESS;
+}
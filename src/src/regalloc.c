@@ -0,0 +1,422 @@
+#include "../include/regalloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 割り当て順（呼び出しをまたがない値はcaller-savedを先に使い、退避を減らす）
+static const uint8_t caller_saved_gprs[] = { X86_RSI, X86_RDI, X86_RCX, X86_R8, X86_R9, X86_R10 };
+static const uint8_t callee_saved_gprs[] = { X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15 };
+#define REGALLOC_XMM_COUNT 14   // xmm0〜xmm13
+
+#define CALLER_SAVED_COUNT (sizeof(caller_saved_gprs) / sizeof(caller_saved_gprs[0]))
+#define CALLEE_SAVED_COUNT (sizeof(callee_saved_gprs) / sizeof(callee_saved_gprs[0]))
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t successors[2];
+    uint32_t successor_count;
+} Block;
+
+typedef struct {
+    IrValue value;
+    uint32_t start;
+    uint32_t end;
+    bool crosses_call;
+    bool crosses_xmm_clobber;  // 呼び出しかベクトル演算（XMMをすべて使う）をまたぐ
+} Interval;
+
+// 生存解析用のビット集合（1ブロックあたりwords語）
+typedef struct {
+    uint64_t* bits;
+    size_t words;
+} BitSets;
+
+static uint64_t* bitset_row(BitSets* sets, size_t row) {
+    return sets->bits + row * sets->words;
+}
+
+static bool bitset_test(const uint64_t* row, IrValue value) {
+    return (row[value >> 6] >> (value & 63)) & 1;
+}
+
+static void bitset_set(uint64_t* row, IrValue value) {
+    row[value >> 6] |= (uint64_t)1 << (value & 63);
+}
+
+static bool is_terminator(IrOpcode op) {
+    return op == IR_JUMP || op == IR_BRANCH_FALSE || op == IR_RETURN;
+}
+
+// 命令が読む仮想レジスタを列挙する
+static uint32_t instruction_uses(const IrInstruction* instruction, const IrValue** extra, IrValue uses[2]) {
+    uint32_t count = 0;
+    if (instruction->a != IR_NO_VALUE) uses[count++] = instruction->a;
+    if (instruction->b != IR_NO_VALUE) uses[count++] = instruction->b;
+    *extra = instruction->args;
+    return count;
+}
+
+// 基本ブロックへの分割
+static Block* build_blocks(const IrFunction* function, size_t* block_count) {
+    size_t n = function->count;
+    uint32_t* label_block = calloc(function->label_count + 1, sizeof(uint32_t));
+    bool* leader = calloc(n + 1, sizeof(bool));
+    Block* blocks = malloc((n + 1) * sizeof(Block));
+    if (label_block == NULL || leader == NULL || blocks == NULL) {
+        free(label_block);
+        free(leader);
+        free(blocks);
+        return NULL;
+    }
+
+    leader[0] = true;
+    for (size_t i = 0; i < n; i++) {
+        if (function->code[i].op == IR_LABEL) leader[i] = true;
+        if (is_terminator(function->code[i].op)) leader[i + 1] = true;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (leader[i]) {
+            if (count > 0) blocks[count - 1].end = (uint32_t)i - 1;
+            blocks[count].start = (uint32_t)i;
+            blocks[count].successor_count = 0;
+            count++;
+        }
+        if (function->code[i].op == IR_LABEL) {
+            label_block[function->code[i].imm.label] = (uint32_t)(count - 1);
+        }
+    }
+    if (count > 0) blocks[count - 1].end = (uint32_t)n - 1;
+
+    // 後続ブロック
+    for (size_t b = 0; b < count; b++) {
+        const IrInstruction* last = &function->code[blocks[b].end];
+        bool falls_through = last->op != IR_JUMP && last->op != IR_RETURN;
+        if (last->op == IR_JUMP || last->op == IR_BRANCH_FALSE) {
+            blocks[b].successors[blocks[b].successor_count++] = label_block[last->imm.label];
+        }
+        if (falls_through && b + 1 < count) {
+            blocks[b].successors[blocks[b].successor_count++] = (uint32_t)b + 1;
+        }
+    }
+
+    free(label_block);
+    free(leader);
+    *block_count = count;
+    return blocks;
+}
+
+// ブロックごとのuse/defから生存区間を求める
+static SlangError compute_intervals(const IrFunction* function, Interval* intervals) {
+    size_t value_count = function->value_count;
+    for (size_t v = 0; v < value_count; v++) {
+        intervals[v].value = (IrValue)v;
+        intervals[v].start = UINT32_MAX;
+        intervals[v].end = 0;
+        intervals[v].crosses_call = false;
+        intervals[v].crosses_xmm_clobber = false;
+    }
+    if (function->count == 0) return SLANG_SUCCESS;
+
+    size_t block_count;
+    Block* blocks = build_blocks(function, &block_count);
+    if (blocks == NULL) return SLANG_ERROR_INTERNAL;
+
+    BitSets sets;
+    sets.words = (value_count + 63) / 64;
+    // use, def, live_in, live_outの4行ずつ
+    sets.bits = calloc(block_count * 4 * (sets.words ? sets.words : 1), sizeof(uint64_t));
+    if (sets.bits == NULL) {
+        free(blocks);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    for (size_t b = 0; b < block_count; b++) {
+        uint64_t* use = bitset_row(&sets, b * 4);
+        uint64_t* def = bitset_row(&sets, b * 4 + 1);
+        for (uint32_t i = blocks[b].start; i <= blocks[b].end; i++) {
+            const IrInstruction* instruction = &function->code[i];
+            IrValue uses[2];
+            const IrValue* args;
+            uint32_t count = instruction_uses(instruction, &args, uses);
+            for (uint32_t j = 0; j < count; j++) {
+                if (!bitset_test(def, uses[j])) bitset_set(use, uses[j]);
+            }
+            for (uint32_t j = 0; j < instruction->arg_count; j++) {
+                if (!bitset_test(def, args[j])) bitset_set(use, args[j]);
+            }
+            if (instruction->dest != IR_NO_VALUE) bitset_set(def, instruction->dest);
+        }
+    }
+
+    // live_in = use ∪ (live_out − def) を不動点まで繰り返す
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = block_count; b-- > 0;) {
+            uint64_t* use = bitset_row(&sets, b * 4);
+            uint64_t* def = bitset_row(&sets, b * 4 + 1);
+            uint64_t* live_in = bitset_row(&sets, b * 4 + 2);
+            uint64_t* live_out = bitset_row(&sets, b * 4 + 3);
+
+            for (uint32_t s = 0; s < blocks[b].successor_count; s++) {
+                const uint64_t* succ_in = bitset_row(&sets, blocks[b].successors[s] * 4 + 2);
+                for (size_t w = 0; w < sets.words; w++) live_out[w] |= succ_in[w];
+            }
+            for (size_t w = 0; w < sets.words; w++) {
+                uint64_t in = use[w] | (live_out[w] & ~def[w]);
+                if (in != live_in[w]) {
+                    live_in[w] = in;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // 区間は定義・使用位置と、生存しているブロックの範囲を覆う
+    for (size_t b = 0; b < block_count; b++) {
+        const uint64_t* live_in = bitset_row(&sets, b * 4 + 2);
+        const uint64_t* live_out = bitset_row(&sets, b * 4 + 3);
+        for (size_t v = 0; v < value_count; v++) {
+            if (bitset_test(live_in, (IrValue)v) && blocks[b].start < intervals[v].start) {
+                intervals[v].start = blocks[b].start;
+            }
+            if (bitset_test(live_out, (IrValue)v) && blocks[b].end > intervals[v].end) {
+                intervals[v].end = blocks[b].end;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < function->count; i++) {
+        const IrInstruction* instruction = &function->code[i];
+        IrValue values[2];
+        const IrValue* args;
+        uint32_t count = instruction_uses(instruction, &args, values);
+        for (uint32_t j = 0; j < count + instruction->arg_count + 1; j++) {
+            IrValue v = j < count ? values[j] : j < count + instruction->arg_count ? args[j - count] : instruction->dest;
+            if (v == IR_NO_VALUE) continue;
+            if (i < intervals[v].start) intervals[v].start = i;
+            if (i > intervals[v].end) intervals[v].end = i;
+        }
+    }
+
+    free(sets.bits);
+    free(blocks);
+    return SLANG_SUCCESS;
+}
+
+static int compare_intervals(const void* a, const void* b) {
+    const Interval* x = a;
+    const Interval* y = b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    return x->value < y->value ? -1 : x->value > y->value;
+}
+
+static bool is_callee_saved(uint8_t reg) {
+    for (size_t i = 0; i < CALLEE_SAVED_COUNT; i++) {
+        if (callee_saved_gprs[i] == reg) return true;
+    }
+    return false;
+}
+
+// 線形走査の状態
+typedef struct {
+    Location* locations;
+    Interval** active;         // レジスタを持っている区間
+    size_t active_count;
+    bool gpr_free[16];
+    bool xmm_free[16];
+    uint32_t* slot_ends;       // スロットを最後に使う区間の終わり
+    uint32_t slot_count;
+    uint32_t slot_capacity;
+} LinearScan;
+
+static bool assign_slot(LinearScan* scan, const Interval* interval) {
+    for (uint32_t s = 0; s < scan->slot_count; s++) {
+        if (scan->slot_ends[s] < interval->start) {
+            scan->slot_ends[s] = interval->end;
+            scan->locations[interval->value] = (Location){ LOCATION_STACK, 0, s };
+            return true;
+        }
+    }
+    if (scan->slot_count == scan->slot_capacity) {
+        uint32_t new_capacity = scan->slot_capacity ? scan->slot_capacity * 2 : 16;
+        uint32_t* ends = realloc(scan->slot_ends, new_capacity * sizeof(uint32_t));
+        if (ends == NULL) return false;
+        scan->slot_ends = ends;
+        scan->slot_capacity = new_capacity;
+    }
+    scan->slot_ends[scan->slot_count] = interval->end;
+    scan->locations[interval->value] = (Location){ LOCATION_STACK, 0, scan->slot_count };
+    scan->slot_count++;
+    return true;
+}
+
+static void release(LinearScan* scan, const Location* location) {
+    if (location->kind == LOCATION_GPR) scan->gpr_free[location->reg] = true;
+    if (location->kind == LOCATION_XMM) scan->xmm_free[location->reg] = true;
+}
+
+// 終わった区間のレジスタを返す（同じ位置の定義と最後の使用はレジスタを共有できる）
+static void expire(LinearScan* scan, uint32_t position) {
+    size_t kept = 0;
+    for (size_t i = 0; i < scan->active_count; i++) {
+        Interval* interval = scan->active[i];
+        if (interval->end <= position) {
+            release(scan, &scan->locations[interval->value]);
+        } else {
+            scan->active[kept++] = interval;
+        }
+    }
+    scan->active_count = kept;
+}
+
+static int take_gpr(LinearScan* scan, bool crosses_call) {
+    if (!crosses_call) {
+        for (size_t i = 0; i < CALLER_SAVED_COUNT; i++) {
+            if (scan->gpr_free[caller_saved_gprs[i]]) return caller_saved_gprs[i];
+        }
+    }
+    for (size_t i = 0; i < CALLEE_SAVED_COUNT; i++) {
+        if (scan->gpr_free[callee_saved_gprs[i]]) return callee_saved_gprs[i];
+    }
+    return -1;
+}
+
+static int take_xmm(LinearScan* scan) {
+    for (int i = 0; i < REGALLOC_XMM_COUNT; i++) {
+        if (scan->xmm_free[i]) return i;
+    }
+    return -1;
+}
+
+// 空きがなければ、終わりが最も遠い区間と比べて遠い方をスタックに置く
+static bool spill_at(LinearScan* scan, Interval* interval, bool is_float) {
+    size_t victim = SIZE_MAX;
+    for (size_t i = 0; i < scan->active_count; i++) {
+        const Location* location = &scan->locations[scan->active[i]->value];
+        if (location->kind != (is_float ? LOCATION_XMM : LOCATION_GPR)) continue;
+        if (interval->crosses_call && !is_callee_saved(location->reg)) continue;
+        if (victim == SIZE_MAX || scan->active[i]->end > scan->active[victim]->end) victim = i;
+    }
+
+    if (victim == SIZE_MAX || scan->active[victim]->end <= interval->end) {
+        return assign_slot(scan, interval);
+    }
+
+    Interval* spilled = scan->active[victim];
+    scan->locations[interval->value] = scan->locations[spilled->value];
+    scan->active[victim] = interval;
+    return assign_slot(scan, spilled);
+}
+
+static SlangError linear_scan(const IrFunction* function, Interval* intervals, size_t count, RegisterAllocation* allocation) {
+    LinearScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.locations = allocation->locations;
+    scan.active = malloc((count ? count : 1) * sizeof(Interval*));
+    if (scan.active == NULL) return SLANG_ERROR_INTERNAL;
+
+    for (size_t i = 0; i < CALLER_SAVED_COUNT; i++) scan.gpr_free[caller_saved_gprs[i]] = true;
+    for (size_t i = 0; i < CALLEE_SAVED_COUNT; i++) scan.gpr_free[callee_saved_gprs[i]] = true;
+    for (int i = 0; i < REGALLOC_XMM_COUNT; i++) scan.xmm_free[i] = true;
+
+    SlangError error = SLANG_SUCCESS;
+    for (size_t i = 0; i < count && error == SLANG_SUCCESS; i++) {
+        Interval* interval = &intervals[i];
+        bool is_float = function->value_types[interval->value] == IR_FLOAT;
+        expire(&scan, interval->start);
+
+        // XMMはすべてcaller-savedなので、呼び出しやベクトル演算をまたぐ浮動小数点数は最初からスタックに置く
+        if (is_float && interval->crosses_xmm_clobber) {
+            if (!assign_slot(&scan, interval)) error = SLANG_ERROR_INTERNAL;
+            continue;
+        }
+
+        int reg = is_float ? take_xmm(&scan) : take_gpr(&scan, interval->crosses_call);
+        if (reg < 0) {
+            if (!spill_at(&scan, interval, is_float)) error = SLANG_ERROR_INTERNAL;
+            continue;
+        }
+
+        if (is_float) {
+            scan.xmm_free[reg] = false;
+            allocation->locations[interval->value] = (Location){ LOCATION_XMM, (uint8_t)reg, 0 };
+        } else {
+            scan.gpr_free[reg] = false;
+            allocation->locations[interval->value] = (Location){ LOCATION_GPR, (uint8_t)reg, 0 };
+        }
+        scan.active[scan.active_count++] = interval;
+    }
+
+    allocation->spill_slots = scan.slot_count;
+    free(scan.active);
+    free(scan.slot_ends);
+    return error;
+}
+
+// レジスタ割り当ての実行
+SlangError regalloc_run(const IrFunction* function, RegisterAllocation* allocation) {
+    memset(allocation, 0, sizeof(RegisterAllocation));
+    if (function == NULL || function->failed) return SLANG_ERROR_INTERNAL;
+
+    size_t value_count = function->value_count;
+    allocation->locations = calloc(value_count ? value_count : 1, sizeof(Location));
+    Interval* intervals = malloc((value_count ? value_count : 1) * sizeof(Interval));
+    uint32_t* calls_before = malloc((function->count + 1) * sizeof(uint32_t));
+    uint32_t* clobbers_before = malloc((function->count + 1) * sizeof(uint32_t));
+    if (allocation->locations == NULL || intervals == NULL || calls_before == NULL || clobbers_before == NULL) {
+        free(intervals);
+        free(calls_before);
+        free(clobbers_before);
+        regalloc_free(allocation);
+        return SLANG_ERROR_INTERNAL;
+    }
+    allocation->count = value_count;
+
+    SlangError error = compute_intervals(function, intervals);
+
+    // calls_before[i]は位置iより前の呼び出しの数、clobbers_before[i]はそれにベクトル演算を加えた数
+    calls_before[0] = 0;
+    clobbers_before[0] = 0;
+    for (size_t i = 0; i < function->count; i++) {
+        IrOpcode op = (IrOpcode)function->code[i].op;
+        calls_before[i + 1] = calls_before[i] + ir_is_call(op);
+        clobbers_before[i + 1] = clobbers_before[i] + (ir_is_call(op) || ir_is_vector(op));
+    }
+
+    // 使われない値を除き、開始位置の順に並べる
+    size_t live = 0;
+    for (size_t v = 0; v < value_count && error == SLANG_SUCCESS; v++) {
+        Interval interval = intervals[v];
+        if (interval.start == UINT32_MAX) continue;
+        // 区間の内側（両端を除く）に呼び出しがあるか
+        interval.crosses_call = interval.end > interval.start + 1 &&
+                                calls_before[interval.end] - calls_before[interval.start + 1] > 0;
+        interval.crosses_xmm_clobber = interval.end > interval.start + 1 &&
+                                       clobbers_before[interval.end] - clobbers_before[interval.start + 1] > 0;
+        intervals[live++] = interval;
+    }
+    qsort(intervals, live, sizeof(Interval), compare_intervals);
+
+    if (error == SLANG_SUCCESS) {
+        error = linear_scan(function, intervals, live, allocation);
+    }
+    for (size_t v = 0; v < value_count && error == SLANG_SUCCESS; v++) {
+        const Location* location = &allocation->locations[v];
+        if (location->kind == LOCATION_GPR && is_callee_saved(location->reg)) {
+            allocation->callee_saved |= (uint16_t)(1u << location->reg);
+        }
+    }
+
+    free(intervals);
+    free(calls_before);
+    free(clobbers_before);
+    if (error != SLANG_SUCCESS) regalloc_free(allocation);
+    return error;
+}
+
+void regalloc_free(RegisterAllocation* allocation) {
+    free(allocation->locations);
+    memset(allocation, 0, sizeof(RegisterAllocation));
+}
@@ -0,0 +1,132 @@
+#include "../include/resolver.h"
+#include <stdlib.h>
+
+void resolver_init(Resolver* resolver, const SymbolTable* globals, const SymbolTable* functions) {
+    symbol_table_init(&resolver->locals);
+    resolver->globals = globals;
+    resolver->functions = functions;
+    resolver->frame_size = 0;
+    resolver->max_frame_size = 0;
+    resolver->failed = false;
+}
+
+void resolver_free(Resolver* resolver) {
+    symbol_table_free(&resolver->locals);
+}
+
+bool resolver_push_scope(Resolver* resolver) {
+    if (!symbol_table_push_scope(&resolver->locals)) {
+        resolver->failed = true;
+        return false;
+    }
+    return true;
+}
+
+void resolver_pop_scope(Resolver* resolver) {
+    // スコープの最初の変数の手前まで戻す（変数がなければ大きさは変わっていない）
+    if (resolver->locals.depth == 0) return;
+    size_t mark = resolver->locals.scope_marks[resolver->locals.depth - 1];
+    if (mark < resolver->locals.count) resolver->frame_size = resolver->locals.symbols[mark].slot - RESOLVER_SLOT_SIZE;
+    symbol_table_pop_scope(&resolver->locals);
+}
+
+// 新しいローカル変数にフレーム内のオフセットを割り当てる
+size_t resolver_declare(Resolver* resolver, const char* name) {
+    resolver->frame_size += RESOLVER_SLOT_SIZE;
+    if (resolver->frame_size > resolver->max_frame_size) {
+        resolver->max_frame_size = resolver->frame_size;
+    }
+    if (!symbol_table_define(&resolver->locals, name, (uint32_t)resolver->frame_size)) {
+        resolver->failed = true;
+        return 0;
+    }
+    return resolver->frame_size;
+}
+
+size_t resolver_lookup(const Resolver* resolver, const char* name) {
+    const Symbol* symbol = symbol_table_lookup(&resolver->locals, name);
+    return symbol != NULL ? symbol->slot : 0;
+}
+
+// フレームの大きさだけを求める（コード生成と同じ順に宣言し、スコープを積む）
+static void measure_node(Resolver* resolver, const ASTNode* node);
+
+static void measure_scoped(Resolver* resolver, const ASTNode* node) {
+    if (node == NULL || !resolver_push_scope(resolver)) return;
+    measure_node(resolver, node);
+    resolver_pop_scope(resolver);
+}
+
+static void measure_node(Resolver* resolver, const ASTNode* node) {
+    if (node == NULL || resolver->failed) return;
+
+    switch (node->type) {
+        case NODE_LET_STATEMENT:
+            resolver_declare(resolver, node->data.let_statement.name);
+            return;
+
+        case NODE_BLOCK_STATEMENT: {
+            if (!resolver_push_scope(resolver)) return;
+            const BlockStatement* block = &node->data.block_statement;
+            for (size_t i = 0; i < block->statement_count; i++) measure_node(resolver, block->statements[i]);
+            resolver_pop_scope(resolver);
+            return;
+        }
+
+        case NODE_IF_STATEMENT:
+            measure_scoped(resolver, node->data.if_statement.then_branch);
+            measure_scoped(resolver, node->data.if_statement.else_branch);
+            return;
+
+        case NODE_WHILE_STATEMENT:
+            measure_scoped(resolver, node->data.while_statement.body);
+            return;
+
+        default:
+            // 式の中では変数を宣言しない
+            return;
+    }
+}
+
+// 関数本体の解決の準備（引数は宣言順にフレームへ置く）
+SlangError resolver_begin_function(Resolver* resolver, const ASTNode* function, size_t* frame_size) {
+    if (function == NULL || function->type != NODE_FUNCTION) return SLANG_ERROR_INTERNAL;
+
+    symbol_table_free(&resolver->locals);
+    symbol_table_init(&resolver->locals);
+    resolver->frame_size = 0;
+    resolver->max_frame_size = 0;
+    resolver->failed = false;
+
+    const Function* data = &function->data.function;
+    for (size_t i = 0; i < data->parameter_count; i++) {
+        resolver_declare(resolver, data->parameters[i]->name);
+    }
+    measure_node(resolver, data->body);
+    if (resolver->failed) return SLANG_ERROR_INTERNAL;
+
+    // System V ABIに合わせてスタックフレームを16バイト境界に揃える
+    size_t size = resolver->max_frame_size;
+    *frame_size = (size + RESOLVER_FRAME_ALIGNMENT - 1) & ~(size_t)(RESOLVER_FRAME_ALIGNMENT - 1);
+    return SLANG_SUCCESS;
+}
+
+// プログラム全体の解決（前方参照できるよう、最上位の名前を先に登録する）
+SlangError resolve_program(const ASTNode* program, SymbolTable* globals, SymbolTable* functions) {
+    if (program == NULL || program->type != NODE_BLOCK_STATEMENT) return SLANG_ERROR_INTERNAL;
+
+    const BlockStatement* block = &program->data.block_statement;
+    for (size_t i = 0; i < block->statement_count; i++) {
+        const ASTNode* statement = block->statements[i];
+        if (statement == NULL) continue;
+        bool defined = true;
+        if (statement->type == NODE_FUNCTION && statement->data.function.name != NULL) {
+            defined = symbol_table_define(functions, statement->data.function.name, (uint32_t)i);
+        } else if (statement->type == NODE_LET_STATEMENT &&
+                   symbol_table_lookup(globals, statement->data.let_statement.name) == NULL) {
+            defined = symbol_table_define(globals, statement->data.let_statement.name, (uint32_t)globals->count);
+        }
+        if (!defined) return SLANG_ERROR_INTERNAL;
+    }
+    return SLANG_SUCCESS;
+}
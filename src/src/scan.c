@@ -0,0 +1,335 @@
+#include "../include/scan.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_HAVE_SSE2 1
+#define SCAN_HAVE_AVX2 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SCAN_HAVE_NEON 1
+#endif
+
+// 実装の関数表
+typedef struct {
+    const char* name;
+    ScanResult (*whitespace)(const char* p, const char* end);
+    size_t (*identifier)(const char* p, const char* end);
+    size_t (*line)(const char* p, const char* end);
+    ScanResult (*string)(const char* p, const char* end);
+} ScanOps;
+
+// ----------------------------------------------------------------------------
+// スカラー実装（ベクトル実装の端数処理にも使う）
+// ----------------------------------------------------------------------------
+
+static bool scalar_is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool scalar_is_identifier(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+static ScanResult scalar_whitespace(const char* p, const char* end) {
+    ScanResult result = {0, 0, 0};
+    const char* start = p;
+    while (p < end && scalar_is_whitespace(*p)) {
+        if (*p == '\n') {
+            result.newlines++;
+            result.last_newline = (size_t)(p - start);
+        }
+        p++;
+    }
+    result.length = (size_t)(p - start);
+    return result;
+}
+
+static size_t scalar_identifier(const char* p, const char* end) {
+    const char* start = p;
+    while (p < end && scalar_is_identifier(*p)) p++;
+    return (size_t)(p - start);
+}
+
+static size_t scalar_line(const char* p, const char* end) {
+    const char* start = p;
+    while (p < end && *p != '\n' && *p != '\0') p++;
+    return (size_t)(p - start);
+}
+
+static ScanResult scalar_string(const char* p, const char* end) {
+    ScanResult result = {0, 0, 0};
+    const char* start = p;
+    while (p < end && *p != '"' && *p != '\0') {
+        if (*p == '\n') {
+            result.newlines++;
+            result.last_newline = (size_t)(p - start);
+        }
+        p++;
+    }
+    result.length = (size_t)(p - start);
+    return result;
+}
+
+static const ScanOps scalar_ops = {
+    "scalar", scalar_whitespace, scalar_identifier, scalar_line, scalar_string
+};
+
+// ----------------------------------------------------------------------------
+// ベクトル実装の共通部
+// 各実装は1ブロック（WIDTHバイト）ごとに、1バイトあたりBITSビットのマスクを返す
+// 関数を用意し、SCAN_DEFINE_VECTOR_OPSで走査ループを生成する。
+// ----------------------------------------------------------------------------
+
+static inline uint64_t scan_low_bits(unsigned count) {
+    return count >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << count) - 1);
+}
+
+// 改行マスクを結果に加える（popcountで数え、最上位ビットで最後の位置を得る）
+static inline void scan_account_newlines(ScanResult* result, uint64_t newline_mask,
+                                         size_t block_offset, unsigned bits) {
+    if (newline_mask == 0) return;
+    result->newlines += (size_t)__builtin_popcountll(newline_mask) / bits;
+    result->last_newline = block_offset + (size_t)(63 - __builtin_clzll(newline_mask)) / bits;
+}
+
+// 端数をスカラー実装で処理して結果を繋ぐ
+static inline ScanResult scan_finish(ScanResult result, const char* start, const char* p,
+                                     ScanResult (*tail)(const char*, const char*), const char* end) {
+    ScanResult rest = tail(p, end);
+    if (rest.newlines > 0) {
+        result.newlines += rest.newlines;
+        result.last_newline = (size_t)(p - start) + rest.last_newline;
+    }
+    result.length = (size_t)(p - start) + rest.length;
+    return result;
+}
+
+#define SCAN_DEFINE_VECTOR_OPS(isa, ATTR, WIDTH, BITS)                                      \
+    static ATTR ScanResult isa##_whitespace(const char* p, const char* end) {                \
+        const uint64_t full = scan_low_bits((WIDTH) * (BITS));                               \
+        ScanResult result = {0, 0, 0};                                                       \
+        const char* start = p;                                                               \
+        while (end - p >= (WIDTH)) {                                                         \
+            uint64_t stop = ~isa##_mask_whitespace(p) & full;                                \
+            uint64_t newlines = isa##_mask_eq(p, '\n');                                      \
+            if (stop != 0) {                                                                 \
+                unsigned n = (unsigned)__builtin_ctzll(stop) / (BITS);                       \
+                scan_account_newlines(&result, newlines & scan_low_bits(n * (BITS)),         \
+                                      (size_t)(p - start), (BITS));                          \
+                result.length = (size_t)(p - start) + n;                                     \
+                return result;                                                               \
+            }                                                                                \
+            scan_account_newlines(&result, newlines, (size_t)(p - start), (BITS));           \
+            p += (WIDTH);                                                                    \
+        }                                                                                    \
+        return scan_finish(result, start, p, scalar_whitespace, end);                        \
+    }                                                                                        \
+                                                                                             \
+    static ATTR size_t isa##_identifier(const char* p, const char* end) {                    \
+        const uint64_t full = scan_low_bits((WIDTH) * (BITS));                               \
+        const char* start = p;                                                               \
+        while (end - p >= (WIDTH)) {                                                         \
+            uint64_t stop = ~isa##_mask_identifier(p) & full;                                \
+            if (stop != 0) {                                                                 \
+                return (size_t)(p - start) + (unsigned)__builtin_ctzll(stop) / (BITS);       \
+            }                                                                                \
+            p += (WIDTH);                                                                    \
+        }                                                                                    \
+        return (size_t)(p - start) + scalar_identifier(p, end);                              \
+    }                                                                                        \
+                                                                                             \
+    static ATTR size_t isa##_line(const char* p, const char* end) {                          \
+        const char* start = p;                                                               \
+        while (end - p >= (WIDTH)) {                                                         \
+            uint64_t stop = isa##_mask_eq(p, '\n') | isa##_mask_eq(p, '\0');                 \
+            if (stop != 0) {                                                                 \
+                return (size_t)(p - start) + (unsigned)__builtin_ctzll(stop) / (BITS);       \
+            }                                                                                \
+            p += (WIDTH);                                                                    \
+        }                                                                                    \
+        return (size_t)(p - start) + scalar_line(p, end);                                    \
+    }                                                                                        \
+                                                                                             \
+    static ATTR ScanResult isa##_string(const char* p, const char* end) {                    \
+        ScanResult result = {0, 0, 0};                                                       \
+        const char* start = p;                                                               \
+        while (end - p >= (WIDTH)) {                                                         \
+            uint64_t stop = isa##_mask_eq(p, '"') | isa##_mask_eq(p, '\0');                  \
+            uint64_t newlines = isa##_mask_eq(p, '\n');                                      \
+            if (stop != 0) {                                                                 \
+                unsigned n = (unsigned)__builtin_ctzll(stop) / (BITS);                       \
+                scan_account_newlines(&result, newlines & scan_low_bits(n * (BITS)),         \
+                                      (size_t)(p - start), (BITS));                          \
+                result.length = (size_t)(p - start) + n;                                     \
+                return result;                                                               \
+            }                                                                                \
+            scan_account_newlines(&result, newlines, (size_t)(p - start), (BITS));           \
+            p += (WIDTH);                                                                    \
+        }                                                                                    \
+        return scan_finish(result, start, p, scalar_string, end);                            \
+    }                                                                                        \
+                                                                                             \
+    static const ScanOps isa##_ops = {                                                       \
+        #isa, isa##_whitespace, isa##_identifier, isa##_line, isa##_string                   \
+    };
+
+// ----------------------------------------------------------------------------
+// SSE2（16バイト）
+// ----------------------------------------------------------------------------
+#ifdef SCAN_HAVE_SSE2
+
+#define SSE2_ATTR __attribute__((target("sse2")))
+
+static inline SSE2_ATTR uint64_t sse2_mask_eq(const char* p, char c) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    return (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+static inline SSE2_ATTR uint64_t sse2_mask_whitespace(const char* p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                          _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                                          _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+    return (uint64_t)(uint32_t)_mm_movemask_epi8(m);
+}
+
+// 0x80以上のバイトは符号付き比較で負になるので、どの範囲にも入らない
+static inline SSE2_ATTR uint64_t sse2_mask_identifier(const char* p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), v));
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+}
+
+SCAN_DEFINE_VECTOR_OPS(sse2, SSE2_ATTR, 16, 1)
+
+#endif // SCAN_HAVE_SSE2
+
+// ----------------------------------------------------------------------------
+// AVX2（32バイト）
+// ----------------------------------------------------------------------------
+#ifdef SCAN_HAVE_AVX2
+
+#define AVX2_ATTR __attribute__((target("avx2")))
+
+static inline AVX2_ATTR uint64_t avx2_mask_eq(const char* p, char c) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+}
+
+static inline AVX2_ATTR uint64_t avx2_mask_whitespace(const char* p) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+                                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(m);
+}
+
+static inline AVX2_ATTR uint64_t avx2_mask_identifier(const char* p) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_or_si256(alpha, digit), under));
+}
+
+SCAN_DEFINE_VECTOR_OPS(avx2, AVX2_ATTR, 32, 1)
+
+#endif // SCAN_HAVE_AVX2
+
+// ----------------------------------------------------------------------------
+// NEON（16バイト、movemaskの代わりにshrnで1バイトあたり4ビットのマスクを作る）
+// ----------------------------------------------------------------------------
+#ifdef SCAN_HAVE_NEON
+
+#define NEON_ATTR
+
+static inline uint64_t neon_movemask(uint8x16_t m) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+static inline uint64_t neon_mask_eq(const char* p, char c) {
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    return neon_movemask(vceqq_u8(v, vdupq_n_u8((uint8_t)c)));
+}
+
+static inline uint64_t neon_mask_whitespace(const char* p) {
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+                            vorrq_u8(vceqq_u8(v, vdupq_n_u8('\r')), vceqq_u8(v, vdupq_n_u8('\n'))));
+    return neon_movemask(m);
+}
+
+// 符号なしの引き算で範囲判定を1回の比較にする
+static inline uint64_t neon_mask_identifier(const char* p) {
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+    uint8x16_t alpha = vcleq_u8(vsubq_u8(lower, vdupq_n_u8('a')), vdupq_n_u8('z' - 'a'));
+    uint8x16_t digit = vcleq_u8(vsubq_u8(v, vdupq_n_u8('0')), vdupq_n_u8('9' - '0'));
+    uint8x16_t under = vceqq_u8(v, vdupq_n_u8('_'));
+    return neon_movemask(vorrq_u8(vorrq_u8(alpha, digit), under));
+}
+
+SCAN_DEFINE_VECTOR_OPS(neon, NEON_ATTR, 16, 4)
+
+#endif // SCAN_HAVE_NEON
+
+// ----------------------------------------------------------------------------
+// 実装の選択
+// ----------------------------------------------------------------------------
+
+// 複数のスレッドの字句解析器から引くのでアトミックに読み書きする
+static _Atomic(const ScanOps*) scan_ops = NULL;
+
+static const ScanOps* scan_select(void) {
+    const ScanOps* ops = &scalar_ops;
+#if defined(SCAN_HAVE_AVX2)
+    __builtin_cpu_init();
+    ops = __builtin_cpu_supports("avx2") ? &avx2_ops : &sse2_ops;
+#elif defined(SCAN_HAVE_NEON)
+    ops = &neon_ops;
+#endif
+    // 何度選んでも同じ結果になるので競合しても問題ない
+    atomic_store_explicit(&scan_ops, ops, memory_order_relaxed);
+    return ops;
+}
+
+static inline const ScanOps* scan_get_ops(void) {
+    const ScanOps* ops = atomic_load_explicit(&scan_ops, memory_order_relaxed);
+    return ops != NULL ? ops : scan_select();
+}
+
+ScanResult scan_whitespace(const char* p, const char* end) {
+    return scan_get_ops()->whitespace(p, end);
+}
+
+size_t scan_identifier(const char* p, const char* end) {
+    return scan_get_ops()->identifier(p, end);
+}
+
+size_t scan_line(const char* p, const char* end) {
+    return scan_get_ops()->line(p, end);
+}
+
+ScanResult scan_string(const char* p, const char* end) {
+    return scan_get_ops()->string(p, end);
+}
+
+const char* scan_implementation_name(void) {
+    return scan_get_ops()->name;
+}
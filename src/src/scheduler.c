@@ -0,0 +1,513 @@
+#include "../include/scheduler.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define SCHEDULER_DEQUE_INITIAL_CAPACITY 256
+#define SCHEDULER_INJECTOR_INITIAL_CAPACITY 64
+#define SCHEDULER_CACHE_LINE 64
+
+enum {
+    TASK_QUEUED,
+    TASK_RUNNING,
+    TASK_DONE
+};
+
+struct SchedulerTask {
+    SchedulerJob job;
+    void* context;
+    atomic_uint level;          // 実効の段階（継承で上がる）
+    unsigned base_level;        // 投入したときの段階
+    atomic_int state;
+    atomic_uint references;     // 投入した側の1つと、キューの項目ごとに1つ
+    SchedulerTask* waiting_on;  // このタスクが待っているタスク（inherit_lockで守る）
+};
+
+// 両端キューのバッファ（容量は2の冪）
+// 大きくしたあとも盗む側が古いバッファを読んでいるかもしれないので、古いものは破棄までつないで残す
+typedef struct DequeBuffer {
+    size_t mask;
+    struct DequeBuffer* retired;
+    _Atomic(SchedulerTask*) slots[];
+} DequeBuffer;
+
+// Chase-Levの両端キュー
+// 持ち主だけがbottomの側で積んで取り、他のスレッドはtopの側からCASで盗む
+typedef struct {
+    _Atomic int64_t top;
+    char top_padding[SCHEDULER_CACHE_LINE - sizeof(int64_t)];
+    _Atomic int64_t bottom;
+    _Atomic(DequeBuffer*) buffer;
+    char bottom_padding[SCHEDULER_CACHE_LINE - sizeof(int64_t) - sizeof(DequeBuffer*)];
+} TaskDeque;
+
+// 外のスレッドが投入したタスクのキュー（リングバッファ、先頭から取る）
+typedef struct {
+    pthread_mutex_t lock;
+    SchedulerTask** tasks;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} Injector;
+
+typedef struct {
+    TaskDeque deques[SCHEDULER_LEVELS];
+    Scheduler* scheduler;
+    size_t index;
+    pthread_t thread;
+} Worker;
+
+struct Scheduler {
+    Worker* workers;
+    size_t worker_count;
+    size_t reserved;                          // 先頭のreserved個のワーカーは最も高い段階だけを処理する
+    Injector injectors[SCHEDULER_LEVELS];
+    atomic_long queued[SCHEDULER_LEVELS];     // 段階ごとのキューの項目の数（古い項目も数える）
+    atomic_long unfinished;                   // 投入してまだ終わっていないタスクの数
+    pthread_mutex_t inherit_lock;             // 継承とwaiting_onの付け替え
+    pthread_mutex_t lock;
+    pthread_cond_t wake;                      // 新しいタスクか、タスクの終わりか、終了
+    atomic_size_t sleeping;                   // wakeを待っているスレッドの数
+    bool stopping;
+};
+
+// このスレッドのワーカーと、実行中のタスク
+static _Thread_local Worker* current_worker = NULL;
+static _Thread_local SchedulerTask* current_task = NULL;
+
+static void task_release(SchedulerTask* task) {
+    if (atomic_fetch_sub_explicit(&task->references, 1, memory_order_acq_rel) == 1) free(task);
+}
+
+static bool deque_init(TaskDeque* deque) {
+    DequeBuffer* buffer = malloc(sizeof(DequeBuffer) + SCHEDULER_DEQUE_INITIAL_CAPACITY * sizeof(_Atomic(SchedulerTask*)));
+    if (buffer == NULL) return false;
+    buffer->mask = SCHEDULER_DEQUE_INITIAL_CAPACITY - 1;
+    buffer->retired = NULL;
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->buffer, buffer);
+    return true;
+}
+
+// 残っている項目を手放してバッファを解放する（もう誰も触らないこと）
+static void deque_free(TaskDeque* deque) {
+    DequeBuffer* buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    for (int64_t i = top; i < bottom; i++) {
+        task_release(atomic_load_explicit(&buffer->slots[i & buffer->mask], memory_order_relaxed));
+    }
+    while (buffer != NULL) {
+        DequeBuffer* retired = buffer->retired;
+        free(buffer);
+        buffer = retired;
+    }
+}
+
+static DequeBuffer* deque_grow(TaskDeque* deque, DequeBuffer* old, int64_t top, int64_t bottom) {
+    size_t capacity = (old->mask + 1) * 2;
+    DequeBuffer* buffer = malloc(sizeof(DequeBuffer) + capacity * sizeof(_Atomic(SchedulerTask*)));
+    if (buffer == NULL) return NULL;
+    buffer->mask = capacity - 1;
+    buffer->retired = old;
+    for (int64_t i = top; i < bottom; i++) {
+        SchedulerTask* task = atomic_load_explicit(&old->slots[i & old->mask], memory_order_relaxed);
+        atomic_store_explicit(&buffer->slots[i & buffer->mask], task, memory_order_relaxed);
+    }
+    atomic_store_explicit(&deque->buffer, buffer, memory_order_release);
+    return buffer;
+}
+
+// 持ち主が末尾に積む
+static bool deque_push(TaskDeque* deque, SchedulerTask* task) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    DequeBuffer* buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    if (bottom - top > (int64_t)buffer->mask) {
+        buffer = deque_grow(deque, buffer, top, bottom);
+        if (buffer == NULL) return false;
+    }
+    atomic_store_explicit(&buffer->slots[bottom & buffer->mask], task, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+    return true;
+}
+
+// 持ち主が末尾から取る（最後の1つは盗む側とCASで取り合う）
+static SchedulerTask* deque_take(TaskDeque* deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    DequeBuffer* buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_seq_cst);
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    SchedulerTask* task = atomic_load_explicit(&buffer->slots[bottom & buffer->mask], memory_order_relaxed);
+    if (top == bottom) {
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// 他のスレッドが先頭から盗む（取り合いに負けたら*contendedを立ててNULL）
+static SchedulerTask* deque_steal(TaskDeque* deque, bool* contended) {
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_seq_cst);
+    if (top >= bottom) return NULL;
+
+    DequeBuffer* buffer = atomic_load_explicit(&deque->buffer, memory_order_acquire);
+    SchedulerTask* task = atomic_load_explicit(&buffer->slots[top & buffer->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        *contended = true;
+        return NULL;
+    }
+    return task;
+}
+
+static bool injector_init(Injector* injector) {
+    injector->tasks = malloc(SCHEDULER_INJECTOR_INITIAL_CAPACITY * sizeof(SchedulerTask*));
+    if (injector->tasks == NULL) return false;
+    injector->head = 0;
+    injector->tail = 0;
+    injector->capacity = SCHEDULER_INJECTOR_INITIAL_CAPACITY;
+    pthread_mutex_init(&injector->lock, NULL);
+    return true;
+}
+
+static void injector_free(Injector* injector) {
+    for (size_t i = injector->head; i != injector->tail; i++) {
+        task_release(injector->tasks[i & (injector->capacity - 1)]);
+    }
+    pthread_mutex_destroy(&injector->lock);
+    free(injector->tasks);
+}
+
+static bool injector_push(Injector* injector, SchedulerTask* task) {
+    pthread_mutex_lock(&injector->lock);
+    if (injector->tail - injector->head == injector->capacity) {
+        SchedulerTask** tasks = malloc(injector->capacity * 2 * sizeof(SchedulerTask*));
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&injector->lock);
+            return false;
+        }
+        for (size_t i = injector->head; i != injector->tail; i++) {
+            tasks[i - injector->head] = injector->tasks[i & (injector->capacity - 1)];
+        }
+        free(injector->tasks);
+        injector->tasks = tasks;
+        injector->tail -= injector->head;
+        injector->head = 0;
+        injector->capacity *= 2;
+    }
+    injector->tasks[injector->tail++ & (injector->capacity - 1)] = task;
+    pthread_mutex_unlock(&injector->lock);
+    return true;
+}
+
+static SchedulerTask* injector_take(Injector* injector) {
+    pthread_mutex_lock(&injector->lock);
+    SchedulerTask* task = NULL;
+    if (injector->head != injector->tail) task = injector->tasks[injector->head++ & (injector->capacity - 1)];
+    pthread_mutex_unlock(&injector->lock);
+    return task;
+}
+
+// 眠っているスレッドを起こす（起こす側は先に数を進めておくので、眠る側が条件を見落とすことはない）
+static void scheduler_notify(Scheduler* scheduler) {
+    if (atomic_load_explicit(&scheduler->sleeping, memory_order_seq_cst) == 0) return;
+    pthread_mutex_lock(&scheduler->lock);
+    pthread_cond_broadcast(&scheduler->wake);
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+// 段階levelのキューにタスクの項目を1つ積む（参照は呼び出し元が足しておく）
+static bool enqueue(Scheduler* scheduler, SchedulerTask* task, unsigned level) {
+    Worker* self = current_worker;
+    bool pushed = self != NULL && self->scheduler == scheduler
+                      ? deque_push(&self->deques[level], task)
+                      : injector_push(&scheduler->injectors[level], task);
+    if (!pushed) return false;
+    atomic_fetch_add_explicit(&scheduler->queued[level], 1, memory_order_seq_cst);
+    scheduler_notify(scheduler);
+    return true;
+}
+
+// 段階minimum以上のキューに項目があるか
+static bool has_work(Scheduler* scheduler, unsigned minimum) {
+    for (unsigned level = minimum; level < SCHEDULER_LEVELS; level++) {
+        if (atomic_load_explicit(&scheduler->queued[level], memory_order_seq_cst) > 0) return true;
+    }
+    return false;
+}
+
+// 自分のキューの末尾、外から投入されたタスク、他のワーカーのキューの先頭の順に探す
+static SchedulerTask* find_task(Scheduler* scheduler, Worker* self, unsigned level) {
+    SchedulerTask* task;
+    if (self != NULL && (task = deque_take(&self->deques[level])) != NULL) return task;
+    if ((task = injector_take(&scheduler->injectors[level])) != NULL) return task;
+
+    size_t start = self != NULL ? self->index + 1 : 0;
+    bool contended;
+    do {
+        contended = false;
+        for (size_t i = 0; i < scheduler->worker_count; i++) {
+            Worker* victim = &scheduler->workers[(start + i) % scheduler->worker_count];
+            if (victim == self) continue;
+            if ((task = deque_steal(&victim->deques[level], &contended)) != NULL) return task;
+        }
+    } while (contended);
+    return NULL;
+}
+
+static void execute(Scheduler* scheduler, SchedulerTask* task) {
+    SchedulerTask* outer = current_task;
+    current_task = task;
+    task->job(task->context);
+    current_task = outer;
+
+    atomic_store_explicit(&task->state, TASK_DONE, memory_order_seq_cst);
+    atomic_fetch_sub_explicit(&scheduler->unfinished, 1, memory_order_seq_cst);
+    scheduler_notify(scheduler);
+}
+
+// 段階minimum以上のタスクを1つ高い段階から探して実行する。
+// 項目のタスクがもう始まっていれば（継承で積み直した古い項目なら）捨てて探し続ける
+static bool run_one(Scheduler* scheduler, unsigned minimum) {
+    Worker* self = current_worker != NULL && current_worker->scheduler == scheduler ? current_worker : NULL;
+    for (unsigned level = SCHEDULER_LEVELS; level-- > minimum;) {
+        if (atomic_load_explicit(&scheduler->queued[level], memory_order_relaxed) <= 0) continue;
+
+        SchedulerTask* task;
+        while ((task = find_task(scheduler, self, level)) != NULL) {
+            atomic_fetch_sub_explicit(&scheduler->queued[level], 1, memory_order_relaxed);
+            int expected = TASK_QUEUED;
+            bool claimed = atomic_compare_exchange_strong_explicit(&task->state, &expected, TASK_RUNNING,
+                                                                   memory_order_acquire, memory_order_relaxed);
+            if (claimed) execute(scheduler, task);
+            task_release(task);
+            if (claimed) return true;
+        }
+    }
+    return false;
+}
+
+// 眠ってよいか（lockを持って呼ぶ）。waitingを待つスレッドはその終わりでも起き、
+// ワーカーでないスレッド（scheduler_destroy）はすべてのタスクの終わりで起きる
+static bool should_sleep(Scheduler* scheduler, const SchedulerTask* waiting, unsigned minimum) {
+    if (scheduler->stopping || has_work(scheduler, minimum)) return false;
+    if (waiting != NULL) return atomic_load_explicit(&waiting->state, memory_order_seq_cst) != TASK_DONE;
+    if (current_worker != NULL) return true;
+    return atomic_load_explicit(&scheduler->unfinished, memory_order_seq_cst) > 0;
+}
+
+static void scheduler_sleep(Scheduler* scheduler, const SchedulerTask* waiting, unsigned minimum) {
+    pthread_mutex_lock(&scheduler->lock);
+    atomic_fetch_add_explicit(&scheduler->sleeping, 1, memory_order_seq_cst);
+    while (should_sleep(scheduler, waiting, minimum)) pthread_cond_wait(&scheduler->wake, &scheduler->lock);
+    atomic_fetch_sub_explicit(&scheduler->sleeping, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+static void* worker_main(void* argument) {
+    Worker* worker = argument;
+    Scheduler* scheduler = worker->scheduler;
+    current_worker = worker;
+    unsigned minimum = worker->index < scheduler->reserved ? SCHEDULER_LEVELS - 1 : 0;
+
+    for (;;) {
+        if (run_one(scheduler, minimum)) continue;
+        scheduler_sleep(scheduler, NULL, minimum);
+        pthread_mutex_lock(&scheduler->lock);
+        bool stopping = scheduler->stopping;
+        pthread_mutex_unlock(&scheduler->lock);
+        if (stopping) break;
+    }
+    return NULL;
+}
+
+// ワーカーを止めて、キューと一緒に破棄する（started個のワーカーが起動済み）
+static void scheduler_free(Scheduler* scheduler, size_t started) {
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->stopping = true;
+    pthread_cond_broadcast(&scheduler->wake);
+    pthread_mutex_unlock(&scheduler->lock);
+    for (size_t i = 0; i < started; i++) pthread_join(scheduler->workers[i].thread, NULL);
+
+    for (size_t i = 0; i < scheduler->worker_count; i++) {
+        for (unsigned level = 0; level < SCHEDULER_LEVELS; level++) deque_free(&scheduler->workers[i].deques[level]);
+    }
+    for (unsigned level = 0; level < SCHEDULER_LEVELS; level++) injector_free(&scheduler->injectors[level]);
+    pthread_cond_destroy(&scheduler->wake);
+    pthread_mutex_destroy(&scheduler->lock);
+    pthread_mutex_destroy(&scheduler->inherit_lock);
+    free(scheduler->workers);
+    free(scheduler);
+}
+
+// スケジューラの作成
+Scheduler* scheduler_create(size_t workers, size_t reserved) {
+    if (workers == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = online > 0 ? (size_t)online : 1;
+    }
+    if (reserved >= workers) reserved = workers - 1;
+
+    Scheduler* scheduler = calloc(1, sizeof(Scheduler));
+    if (scheduler == NULL) return NULL;
+    scheduler->workers = calloc(workers, sizeof(Worker));
+    if (scheduler->workers == NULL) {
+        free(scheduler);
+        return NULL;
+    }
+
+    // キューをすべて作ってからワーカーを起動する（途中で失敗したら作った分だけ戻す）
+    size_t deques = 0;
+    unsigned injectors = 0;
+    bool ok = true;
+    for (; ok && deques < workers * SCHEDULER_LEVELS; deques++) {
+        ok = deque_init(&scheduler->workers[deques / SCHEDULER_LEVELS].deques[deques % SCHEDULER_LEVELS]);
+    }
+    if (!ok) deques--;
+    for (; ok && injectors < SCHEDULER_LEVELS; injectors++) ok = injector_init(&scheduler->injectors[injectors]);
+    if (!ok) injectors--;
+    if (!ok) {
+        for (size_t i = 0; i < deques; i++) {
+            deque_free(&scheduler->workers[i / SCHEDULER_LEVELS].deques[i % SCHEDULER_LEVELS]);
+        }
+        for (unsigned i = 0; i < injectors; i++) injector_free(&scheduler->injectors[i]);
+        free(scheduler->workers);
+        free(scheduler);
+        return NULL;
+    }
+
+    scheduler->worker_count = workers;
+    scheduler->reserved = reserved;
+    for (unsigned level = 0; level < SCHEDULER_LEVELS; level++) atomic_init(&scheduler->queued[level], 0);
+    atomic_init(&scheduler->unfinished, 0);
+    atomic_init(&scheduler->sleeping, 0);
+    pthread_mutex_init(&scheduler->inherit_lock, NULL);
+    pthread_mutex_init(&scheduler->lock, NULL);
+    pthread_cond_init(&scheduler->wake, NULL);
+
+    for (size_t i = 0; i < workers; i++) {
+        Worker* worker = &scheduler->workers[i];
+        worker->scheduler = scheduler;
+        worker->index = i;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            scheduler_free(scheduler, i);
+            return NULL;
+        }
+    }
+    return scheduler;
+}
+
+// スケジューラの破棄（呼び出し元も残りのタスクを処理する）
+void scheduler_destroy(Scheduler* scheduler) {
+    if (scheduler == NULL) return;
+
+    while (atomic_load_explicit(&scheduler->unfinished, memory_order_seq_cst) > 0) {
+        if (!run_one(scheduler, 0)) scheduler_sleep(scheduler, NULL, 0);
+    }
+    scheduler_free(scheduler, scheduler->worker_count);
+}
+
+size_t scheduler_size(const Scheduler* scheduler) {
+    return scheduler ? scheduler->worker_count : 0;
+}
+
+unsigned scheduler_level(int priority) {
+    if (priority < 0) return 0;
+    if (priority >= SCHEDULER_LEVELS) return SCHEDULER_LEVELS - 1;
+    return (unsigned)priority;
+}
+
+SchedulerTask* scheduler_spawn(Scheduler* scheduler, unsigned level, SchedulerJob job, void* context) {
+    if (level >= SCHEDULER_LEVELS) level = SCHEDULER_LEVELS - 1;
+
+    SchedulerTask* task = malloc(sizeof(SchedulerTask));
+    if (task == NULL) return NULL;
+    task->job = job;
+    task->context = context;
+    atomic_init(&task->level, level);
+    task->base_level = level;
+    atomic_init(&task->state, TASK_QUEUED);
+    atomic_init(&task->references, 2);
+    task->waiting_on = NULL;
+
+    atomic_fetch_add_explicit(&scheduler->unfinished, 1, memory_order_relaxed);
+    if (!enqueue(scheduler, task, level)) {
+        atomic_fetch_sub_explicit(&scheduler->unfinished, 1, memory_order_relaxed);
+        free(task);
+        return NULL;
+    }
+    return task;
+}
+
+// 待たれるタスクと、それが待っている先にlevelを継承させる（inherit_lockを持って呼ぶ）。
+// まだ始まっていなければlevelのキューに積み直す（積めなければ元の段階のまま待つ）
+static void inherit(Scheduler* scheduler, SchedulerTask* task, unsigned level) {
+    for (; task != NULL; task = task->waiting_on) {
+        if (atomic_load_explicit(&task->level, memory_order_relaxed) >= level) break;
+        atomic_store_explicit(&task->level, level, memory_order_relaxed);
+        if (atomic_load_explicit(&task->state, memory_order_acquire) != TASK_QUEUED) continue;
+
+        atomic_fetch_add_explicit(&task->references, 1, memory_order_relaxed);
+        if (!enqueue(scheduler, task, level)) task_release(task);
+    }
+}
+
+void scheduler_wait(Scheduler* scheduler, SchedulerTask* task) {
+    if (atomic_load_explicit(&task->state, memory_order_acquire) != TASK_DONE) {
+        SchedulerTask* self = current_task;
+        unsigned level = atomic_load_explicit(self != NULL ? &self->level : &task->level, memory_order_relaxed);
+        pthread_mutex_lock(&scheduler->inherit_lock);
+        if (self != NULL) self->waiting_on = task;
+        inherit(scheduler, task, level);
+        pthread_mutex_unlock(&scheduler->inherit_lock);
+
+        while (atomic_load_explicit(&task->state, memory_order_seq_cst) != TASK_DONE) {
+            // まだ始まっていなければ自分で実行する
+            int expected = TASK_QUEUED;
+            if (atomic_compare_exchange_strong_explicit(&task->state, &expected, TASK_RUNNING,
+                                                        memory_order_acquire, memory_order_relaxed)) {
+                execute(scheduler, task);
+                break;
+            }
+            // 待っている間に自分も継承で上がることがある
+            if (self != NULL) level = atomic_load_explicit(&self->level, memory_order_relaxed);
+            if (!run_one(scheduler, level)) scheduler_sleep(scheduler, task, level);
+        }
+
+        if (self != NULL) {
+            pthread_mutex_lock(&scheduler->inherit_lock);
+            self->waiting_on = NULL;
+            pthread_mutex_unlock(&scheduler->inherit_lock);
+        }
+    }
+    task_release(task);
+}
+
+void scheduler_detach(SchedulerTask* task) {
+    task_release(task);
+}
+
+unsigned scheduler_current_level(void) {
+    return current_task ? atomic_load_explicit(&current_task->level, memory_order_relaxed) : 0;
+}
+
+bool scheduler_current_levels(unsigned* level, unsigned* base_level) {
+    // シグナルハンドラから呼ばれるので、スレッドローカルとアトミックの読み出しだけにする
+    SchedulerTask* task = current_task;
+    if (task == NULL) return false;
+    *level = atomic_load_explicit(&task->level, memory_order_relaxed);
+    *base_level = task->base_level;
+    return true;
+}
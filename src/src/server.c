@@ -0,0 +1,563 @@
+#include "../include/server.h"
+#include "../include/intern.h"
+#include "../include/lexer.h"
+#include "../include/source.h"
+#include "../include/trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// 検査だけなので、キーに入れるフラグはドライバの出力のフラグと重ならないものにする
+#define SERVER_CACHE_FLAGS "--server"
+
+Server* server_create(void) {
+    Server* server = calloc(1, sizeof(Server));
+    if (server == NULL) return NULL;
+    server->cache = build_cache_open(NULL, SERVER_CACHE_FLAGS);
+    if (server->cache == NULL) {
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+static void unit_release_parse(ServerUnit* unit) {
+    parser_destroy(unit->parser);
+    if (unit->arena != NULL) arena_destroy(unit->arena);
+    unit->parser = NULL;
+    unit->arena = NULL;
+    unit->ast = NULL;
+    unit->source_hash = 0;
+}
+
+static void unit_release_check(ServerUnit* unit) {
+    type_checker_destroy(unit->checker);
+    unit->checker = NULL;
+    unit->check_key = 0;
+    unit->imports_key = 0;
+}
+
+void server_destroy(Server* server) {
+    if (server == NULL) return;
+    for (size_t i = 0; i < server->unit_capacity; i++) {
+        unit_release_parse(&server->units[i]);
+        unit_release_check(&server->units[i]);
+    }
+    free(server->units);
+    build_cache_close(server->cache);
+    free(server);
+}
+
+// BuildCacheの単位が増えた分を空の状態で足す
+static bool grow_units(Server* server) {
+    size_t needed = server->cache->unit_count;
+    if (needed <= server->unit_capacity) return true;
+    size_t capacity = server->unit_capacity ? server->unit_capacity * 2 : 16;
+    while (capacity < needed) capacity *= 2;
+    ServerUnit* grown = realloc(server->units, capacity * sizeof(ServerUnit));
+    if (grown == NULL) return false;
+    memset(grown + server->unit_capacity, 0, (capacity - server->unit_capacity) * sizeof(ServerUnit));
+    server->units = grown;
+    server->unit_capacity = capacity;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// 検査
+
+// 内容のハッシュが前回の構文解析と同じならASTをそのまま使う
+static void unit_parse(Server* server, ServerUnit* unit, const BuildUnit* record) {
+    if (record->missing) {
+        unit_release_parse(unit);
+        unit->error = SLANG_ERROR_IO;
+        return;
+    }
+    if (unit->source_hash != 0 && unit->source_hash == record->source_hash) return;
+
+    unit_release_parse(unit);
+    SourceFile* source = source_open(record->path);
+    if (source == NULL) {
+        unit->error = SLANG_ERROR_IO;
+        return;
+    }
+    // ASTは識別子も文字列もアリーナかインターン表にあるので、字句解析器とソースは解析したら閉じる
+    unit->arena = arena_create(ARENA_DEFAULT_BLOCK_SIZE);
+    Lexer* lexer = lexer_create(source->data, source->length);
+    if (unit->arena == NULL || lexer == NULL) {
+        unit->error = SLANG_ERROR_INTERNAL;
+    } else {
+        unit->error = lexer_scan(lexer);
+        if (unit->error == SLANG_SUCCESS) {
+            unit->parser = parser_create(lexer, unit->arena);
+            unit->error = unit->parser ? parser_parse(unit->parser, &unit->ast) : SLANG_ERROR_INTERNAL;
+        }
+    }
+    // 照合の後に書き換わっていれば、次の要求でハッシュが違って読み直す
+    if (unit->error != SLANG_ERROR_INTERNAL) unit->source_hash = build_cache_hash(source->data, source->length, 0) | 1;
+    if (lexer != NULL) lexer_destroy(lexer);
+    source_close(source);
+    server->parsed_count++;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 依存先の成分の代表（成分ごとに1回だけ数える）
+static bool push_owner(size_t** owners, size_t* count, size_t owner) {
+    for (size_t i = 0; i < *count; i++) {
+        if ((*owners)[i] == owner) return true;
+    }
+    size_t* grown = realloc(*owners, (*count + 1) * sizeof(size_t));
+    if (grown == NULL) return false;
+    grown[(*count)++] = owner;
+    *owners = grown;
+    return true;
+}
+
+// 依存先の成分の公開する型をホストの宣言として見せる
+static bool declare_imports(TypeChecker* checker, const TypeChecker* dependency) {
+    for (size_t i = dependency->host_signature_count; i < dependency->signature_count; i++) {
+        const TypeSignature* signature = &dependency->signatures[i];
+        if (!type_checker_declare_signature(checker, signature)) return false;
+    }
+    for (size_t i = dependency->host_global_count; i < dependency->global_count; i++) {
+        const TypeBinding* binding = &dependency->global_bindings[i];
+        if (!type_checker_declare_global(checker, binding->name, binding->type)) return false;
+    }
+    return true;
+}
+
+// 汎用関数の環境は要求ごとのキャッシュに渡し直す必要がある
+static bool declares_generics(const TypeChecker* checker) {
+    for (size_t i = checker->host_signature_count; i < checker->signature_count; i++) {
+        if (checker->signatures[i].generic != NULL) return true;
+    }
+    return false;
+}
+
+// 成分の全員の最上位の文をまとめて検査する（ownersは成分ごとの代表の単位の番号）
+static SlangError check_component(Server* server, const size_t* owners, size_t component) {
+    BuildCache* cache = server->cache;
+    ServerUnit* owner = &server->units[owners[component]];
+    const BuildUnit* owner_record = &cache->units[owners[component]];
+
+    size_t* imports = NULL;
+    size_t import_count = 0;
+    size_t statement_count = 0;
+    SlangError blocked = SLANG_SUCCESS;
+    for (size_t i = owners[component]; i < cache->unit_count; i++) {
+        const BuildUnit* record = &cache->units[i];
+        if (!record->has_key || record->component != component) continue;
+        if (server->units[i].error != SLANG_SUCCESS && blocked == SLANG_SUCCESS) blocked = server->units[i].error;
+        if (server->units[i].ast != NULL) statement_count += server->units[i].ast->data.block_statement.statement_count;
+        for (size_t d = 0; d < record->dependency_count; d++) {
+            const BuildUnit* dependency = build_cache_unit(cache, record->dependencies[d]);
+            if (dependency == NULL || dependency->component == component) continue;
+            if (!push_owner(&imports, &import_count, owners[dependency->component])) {
+                free(imports);
+                return SLANG_ERROR_INTERNAL;
+            }
+        }
+    }
+    for (size_t d = 0; d < import_count && blocked == SLANG_SUCCESS; d++) {
+        blocked = server->units[imports[d]].check_error;
+    }
+    owner->blocked = blocked != SLANG_SUCCESS;
+    if (owner->blocked) {
+        // 検査器は残し、次に検査できるようになったら検査し直す
+        owner->check_error = blocked;
+        owner->check_key = 0;
+        free(imports);
+        return blocked;
+    }
+    if (owner->checker != NULL && owner->check_key == owner_record->key && !declares_generics(owner->checker)) {
+        server->reused_count++;
+        free(imports);
+        return owner->check_error;
+    }
+
+    // 依存先の成分のキーが前回と同じなら、検査器（関数ごとの結果のキャッシュ）を使い続ける
+    uint64_t* keys = malloc((import_count ? import_count : 1) * sizeof(uint64_t));
+    ASTNode** nodes = malloc((statement_count ? statement_count : 1) * sizeof(ASTNode*));
+    SlangError error = keys != NULL && nodes != NULL ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+    uint64_t imports_key = 0;
+    if (error == SLANG_SUCCESS) {
+        for (size_t d = 0; d < import_count; d++) keys[d] = server->units[imports[d]].check_key;
+        if (import_count > 1) qsort(keys, import_count, sizeof(uint64_t), compare_keys);
+        imports_key = build_cache_hash(keys, import_count * sizeof(uint64_t), import_count) | 1;
+    }
+    if (error == SLANG_SUCCESS && (owner->checker == NULL || owner->imports_key != imports_key)) {
+        unit_release_check(owner);
+        owner->checker = type_checker_create();
+        bool declared = owner->checker != NULL;
+        for (size_t d = 0; d < import_count && declared; d++) {
+            declared = declare_imports(owner->checker, server->units[imports[d]].checker);
+        }
+        if (declared) owner->imports_key = imports_key;
+        else error = SLANG_ERROR_INTERNAL;
+    }
+
+    if (error == SLANG_SUCCESS) {
+        statement_count = 0;
+        for (size_t i = owners[component]; i < cache->unit_count; i++) {
+            const BuildUnit* record = &cache->units[i];
+            if (!record->has_key || record->component != component) continue;
+            const BlockStatement* program = &server->units[i].ast->data.block_statement;
+            memcpy(nodes + statement_count, program->statements, program->statement_count * sizeof(ASTNode*));
+            statement_count += program->statement_count;
+        }
+        owner->checker->specializations = server->specializations;
+        error = type_checker_check(owner->checker, nodes, statement_count);
+        server->checked_count++;
+    }
+    if (error == SLANG_ERROR_INTERNAL) {
+        unit_release_check(owner);
+    } else {
+        owner->check_key = owner_record->key;
+    }
+    owner->check_error = error;
+    free(keys);
+    free(nodes);
+    free(imports);
+    return error;
+}
+
+// 成分の検査のエラーを含む単位のパス（check_componentと同じ順に文を数える）。分からなければNULL
+static const char* error_path(const Server* server, size_t owner, size_t statement) {
+    const BuildCache* cache = server->cache;
+    size_t component = cache->units[owner].component;
+    for (size_t i = owner, first = 0; i < cache->unit_count && statement != SIZE_MAX; i++) {
+        const BuildUnit* record = &cache->units[i];
+        if (!record->has_key || record->component != component || server->units[i].ast == NULL) continue;
+        size_t statements = server->units[i].ast->data.block_statement.statement_count;
+        if (statement < first + statements) return record->path;
+        first += statements;
+    }
+    return NULL;
+}
+
+// ドライバと同じ形で、単位の読み込み・構文解析のエラーと、成分の検査のエラー（成分の代表で1回だけ）を書く
+// 検査のエラーはエラーを含む単位のパスと位置で書く（単位が分からなければ代表のパスで、位置は書かない）
+static void report_unit(const Server* server, size_t index, bool is_owner, FILE* out) {
+    const ServerUnit* unit = &server->units[index];
+    const char* path = server->cache->units[index].path;
+    if (unit->error == SLANG_ERROR_IO && unit->ast == NULL) {
+        fprintf(out, "Error: Could not read file '%s'\n", path);
+        return;
+    }
+    if (unit->error != SLANG_SUCCESS) {
+        for (size_t i = 0; unit->parser != NULL && i < unit->parser->error_count; i++) {
+            const Error* error = &unit->parser->errors[i];
+            fprintf(out, "%s:%zu:%zu: %s: %s\n", path, error->line, error->column,
+                    error->type == ERROR_SYNTAX ? "Syntax Error" : "Error", error->message);
+        }
+        return;
+    }
+    if (is_owner && !unit->blocked && unit->check_error != SLANG_SUCCESS) {
+        const TypeChecker* checker = unit->checker;
+        const char* message = checker != NULL && checker->error ? checker->error : "type check failed";
+        const char* located = checker != NULL ? error_path(server, index, checker->error_statement) : NULL;
+        if (located != NULL && checker->error_site.line != 0) {
+            fprintf(out, "%s:%u:%u: ", located, (unsigned)checker->error_site.line,
+                    (unsigned)checker->error_site.column);
+        } else {
+            fprintf(out, "%s: ", path);
+        }
+        const char* name = checker != NULL ? checker->error_site.name : NULL;
+        fprintf(out, "Type Error: %s%s%s%s\n", message, name ? " '" : "", name ? name : "", name ? "'" : "");
+    }
+}
+
+SlangError server_check(Server* server, const char* path, FILE* out) {
+    server->unit_count = 0;
+    server->parsed_count = 0;
+    server->checked_count = 0;
+    server->reused_count = 0;
+
+    // 依存関係とキーは毎回求め直す（変わっていないファイルはstatだけで済む）
+    BuildCache* cache = server->cache;
+    build_cache_rescan(cache);
+    uint64_t key;
+    SlangError error = build_cache_key(cache, path, &key);
+    if (error != SLANG_SUCCESS) {
+        if (out != NULL && error == SLANG_ERROR_IO) fprintf(out, "Error: Could not read file '%s'\n", path);
+        return error;
+    }
+    size_t* owners = malloc((cache->component_count ? cache->component_count : 1) * sizeof(size_t));
+    server->specializations = mono_cache_create(NULL);
+    if (owners == NULL || server->specializations == NULL || !grow_units(server)) {
+        free(owners);
+        mono_cache_destroy(server->specializations);
+        server->specializations = NULL;
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    // 成分の代表は番号の最も小さい単位（代表でなくなった単位の検査器は捨てる）
+    for (size_t c = 0; c < cache->component_count; c++) owners[c] = SIZE_MAX;
+    for (size_t i = 0; i < cache->unit_count; i++) {
+        const BuildUnit* record = &cache->units[i];
+        if (!record->has_key) continue;
+        server->unit_count++;
+        if (owners[record->component] == SIZE_MAX) owners[record->component] = i;
+        else unit_release_check(&server->units[i]);
+        unit_parse(server, &server->units[i], record);
+    }
+
+    // 成分は依存先ほど番号が小さいので、番号の順に検査すれば依存先の結果が揃っている
+    for (size_t c = 0; c < cache->component_count; c++) {
+        if (check_component(server, owners, c) == SLANG_ERROR_INTERNAL) error = SLANG_ERROR_INTERNAL;
+    }
+
+    for (size_t i = 0; i < cache->unit_count && error != SLANG_ERROR_INTERNAL; i++) {
+        const BuildUnit* record = &cache->units[i];
+        if (!record->has_key) continue;
+        const ServerUnit* unit = &server->units[i];
+        SlangError result = unit->error != SLANG_SUCCESS ? unit->error : server->units[owners[record->component]].check_error;
+        if (result == SLANG_SUCCESS) continue;
+        if (out != NULL) report_unit(server, i, owners[record->component] == i, out);
+        if (error == SLANG_SUCCESS) error = result;
+    }
+    mono_cache_destroy(server->specializations);
+    server->specializations = NULL;
+    free(owners);
+    return error;
+}
+
+// ---------------------------------------------------------------------------
+// 要求
+
+bool server_handle(Server* server, const char* request, FILE* out) {
+    server->requests++;
+    if (strncmp(request, "check ", 6) == 0 && request[6] != '\0') {
+        uint64_t start = trace_now();
+        SlangError error = server_check(server, request + 6, out);
+        uint64_t elapsed = (trace_now() - start) / 1000;
+        if (error == SLANG_ERROR_INTERNAL) {
+            fprintf(out, "error internal error\n");
+        } else {
+            fprintf(out, "%s units=%zu parsed=%zu checked=%zu reused=%zu us=%llu\n",
+                    error == SLANG_SUCCESS ? "ok" : "failed", server->unit_count, server->parsed_count,
+                    server->checked_count, server->reused_count, (unsigned long long)elapsed);
+        }
+        return true;
+    }
+    if (strcmp(request, "stats") == 0) {
+        fprintf(out, "stats requests=%zu units=%zu interned=%zu\n", server->requests, server->cache->unit_count,
+                intern_count());
+        return true;
+    }
+    if (strcmp(request, "shutdown") == 0) {
+        fprintf(out, "bye\n");
+        return false;
+    }
+    fprintf(out, "error unknown request\n");
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// 待ち受け
+
+// 接続（ソケットはノンブロッキング）
+// 同じ接続の次の要求は前の応答を書き終えてから処理するので、応答を読まない相手が溜め込むのは1つ分だけ
+typedef struct {
+    int fd;
+    char input[SERVER_LINE_MAX];
+    size_t input_length;
+    bool discarding;           // 長すぎる行の残りを読み捨てている
+    bool closed;               // 相手が書く側を閉じた（残りの要求と応答を済ませたら閉じる）
+    char* output;              // 書き残した応答（open_memstreamで作ったもの）
+    size_t output_length;
+    size_t output_sent;
+} ServerClient;
+
+static void client_close(ServerClient* client) {
+    close(client->fd);
+    free(client->output);
+}
+
+// 1行の要求を処理して応答を溜める（lineがNULLなら長すぎた行。shutdownならfalse）
+static bool client_respond(Server* server, ServerClient* client, const char* line) {
+    char* output = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&output, &length);
+    bool running = true;
+    if (out != NULL) {
+        if (line != NULL) running = server_handle(server, line, out);
+        else fprintf(out, "error request too long\n");
+        fclose(out);
+    }
+    client->output = output;
+    client->output_length = output != NULL ? length : 0;
+    client->output_sent = 0;
+    return running;
+}
+
+// 溜めた入力に行が揃っていれば1つだけ処理する（shutdownならfalse）
+static bool client_next_request(Server* server, ServerClient* client) {
+    while (client->output == NULL) {
+        char* newline = memchr(client->input, '\n', client->input_length);
+        size_t length;
+        size_t consumed;
+        if (newline != NULL) {
+            length = (size_t)(newline - client->input);
+            consumed = length + 1;
+        } else if (client->input_length == sizeof(client->input)) {
+            // 長すぎる行は改行まで読み捨てる（応答は最初の1回だけ）
+            client->input_length = 0;
+            if (client->discarding) return true;
+            client->discarding = true;
+            return client_respond(server, client, NULL);
+        } else if (client->closed && client->input_length > 0) {
+            // 改行のない最後の行
+            length = client->input_length;
+            consumed = length;
+        } else {
+            return true;
+        }
+
+        bool discarded = client->discarding;
+        client->discarding = false;
+        if (length > 0 && client->input[length - 1] == '\r') length--;
+        client->input[length] = '\0';
+        bool running = discarded || length == 0 || client_respond(server, client, client->input);
+        memmove(client->input, client->input + consumed, client->input_length - consumed);
+        client->input_length -= consumed;
+        if (!running) return false;
+    }
+    return true;
+}
+
+// 読めるだけ読む（相手が閉じたか読めなくなったらclosed）
+static void client_read(ServerClient* client) {
+    while (!client->closed && client->input_length < sizeof(client->input)) {
+        ssize_t count = read(client->fd, client->input + client->input_length, sizeof(client->input) - client->input_length);
+        if (count > 0) {
+            client->input_length += (size_t)count;
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) client->closed = true;
+            return;
+        }
+    }
+}
+
+// 書けるだけ書く（書けなくなったらfalse）
+static bool client_write(ServerClient* client) {
+    while (client->output_sent < client->output_length) {
+        ssize_t count = write(client->fd, client->output + client->output_sent, client->output_length - client->output_sent);
+        if (count > 0) {
+            client->output_sent += (size_t)count;
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    free(client->output);
+    client->output = NULL;
+    client->output_length = 0;
+    client->output_sent = 0;
+    return true;
+}
+
+static bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+SlangError server_listen(Server* server, const char* socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) return SLANG_ERROR_IO;
+    strcpy(address.sun_path, socket_path);
+
+    // 前のサーバーが残したソケットだけを消す（同じ名前の通常ファイルは消さない）
+    struct stat info;
+    if (lstat(socket_path, &info) == 0 && S_ISSOCK(info.st_mode)) unlink(socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) return SLANG_ERROR_IO;
+    // ソケットのファイルは作った時から所有者だけが読み書きできるようにする
+    mode_t mask = umask(0177);
+    int bound = bind(listener, (const struct sockaddr*)&address, sizeof(address));
+    umask(mask);
+    if (bound != 0 || listen(listener, SERVER_BACKLOG) != 0 || !set_nonblocking(listener)) {
+        if (bound == 0) unlink(socket_path);
+        close(listener);
+        return SLANG_ERROR_IO;
+    }
+    // 応答を書く前に相手が閉じても終わらないようにする
+    signal(SIGPIPE, SIG_IGN);
+
+    ServerClient* clients = calloc(SERVER_MAX_CLIENTS, sizeof(ServerClient));
+    struct pollfd* fds = calloc(SERVER_MAX_CLIENTS + 1, sizeof(struct pollfd));
+    SlangError error = clients != NULL && fds != NULL ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+    size_t count = 0;
+    bool running = true;
+    // shutdownの後は新しい要求を読まず、書き残した応答だけを書き終える
+    while (error == SLANG_SUCCESS) {
+        bool pending = false;
+        for (size_t i = 0; i < count; i++) pending = pending || clients[i].output != NULL;
+        if (!running && !pending) break;
+
+        // 接続が一杯のうちは新しい接続をバックログに待たせる
+        fds[0].fd = running && count < SERVER_MAX_CLIENTS ? listener : -1;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < count; i++) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = clients[i].output != NULL ? POLLOUT : running ? POLLIN : 0;
+        }
+        if (poll(fds, count + 1, -1) < 0) {
+            if (errno != EINTR) error = SLANG_ERROR_IO;
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            ServerClient* client = &clients[i];
+            bool alive = true;
+            if (client->output != NULL && (fds[i + 1].revents & (POLLOUT | POLLERR | POLLHUP))) {
+                alive = client_write(client);
+            } else if (running && client->output == NULL && (fds[i + 1].revents & (POLLIN | POLLERR | POLLHUP))) {
+                client_read(client);
+            }
+            if (alive && running && client->output == NULL) running = client_next_request(server, client);
+            if (!alive || (client->closed && client->output == NULL &&
+                           (client->input_length == 0 || client->discarding))) {
+                client_close(client);
+                clients[i] = clients[--count];
+                fds[i + 1] = fds[count + 1];
+                i--;
+            }
+        }
+
+        if (running && (fds[0].revents & POLLIN)) {
+            int connection = accept(listener, NULL, NULL);
+            if (connection >= 0 && set_nonblocking(connection)) {
+                memset(&clients[count], 0, sizeof(ServerClient));
+                clients[count++].fd = connection;
+            } else if (connection >= 0) {
+                close(connection);
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) {
+                error = SLANG_ERROR_IO;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) client_close(&clients[i]);
+    free(clients);
+    free(fds);
+    close(listener);
+    unlink(socket_path);
+    return error;
+}
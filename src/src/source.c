@@ -0,0 +1,141 @@
+#include "../include/source.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// ファイルをmmapする
+// ファイル末尾の直後に'\0'を置くため、1ページ多い匿名領域を予約してから
+// その先頭にファイルを重ねてマップする（余ったページはゼロで埋まっている）。
+static bool source_map(SourceFile* file, int fd, size_t length) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapped_size = (length / page_size + 1) * page_size;
+
+    char* region = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) return false;
+
+    if (length > 0) {
+        void* data = mmap(region, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (data == MAP_FAILED) {
+            munmap(region, mapped_size);
+            return false;
+        }
+#ifdef MADV_SEQUENTIAL
+        // 字句解析は先頭から順に一度だけ読む
+        madvise(region, length, MADV_SEQUENTIAL);
+#endif
+    }
+
+    file->data = region;
+    file->length = length;
+    file->mapped_size = mapped_size;
+    file->is_mapped = true;
+    return true;
+}
+
+// ファイルをチャンク単位で読み込む（サイズが分からない入力にも対応する）
+static bool source_read_chunked(SourceFile* file, FILE* stream) {
+    size_t capacity = SOURCE_READ_CHUNK_SIZE;
+    size_t length = 0;
+    char* buffer = malloc(capacity + 1);
+    if (buffer == NULL) return false;
+
+    for (;;) {
+        if (capacity - length < SOURCE_READ_CHUNK_SIZE) {
+            char* grown = realloc(buffer, capacity * 2 + 1);
+            if (grown == NULL) {
+                free(buffer);
+                return false;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+
+        size_t bytes_read = fread(buffer + length, 1, SOURCE_READ_CHUNK_SIZE, stream);
+        length += bytes_read;
+        if (bytes_read < SOURCE_READ_CHUNK_SIZE) break;
+    }
+
+    if (ferror(stream)) {
+        free(buffer);
+        return false;
+    }
+
+    buffer[length] = '\0';
+    file->data = buffer;
+    file->length = length;
+    file->mapped_size = 0;
+    file->is_mapped = false;
+    return true;
+}
+
+static SourceFile* source_new(const char* path) {
+    SourceFile* file = malloc(sizeof(SourceFile));
+    if (file == NULL) return NULL;
+
+    file->path = path;
+    file->data = NULL;
+    file->length = 0;
+    file->mapped_size = 0;
+    file->is_mapped = false;
+    return file;
+}
+
+// チャンク読み込みだけでソースファイルを開く
+SourceFile* source_open_buffered(const char* path) {
+    FILE* stream = fopen(path, "rb");
+    if (stream == NULL) return NULL;
+
+    SourceFile* file = source_new(path);
+    if (file == NULL || !source_read_chunked(file, stream)) {
+        free(file);
+        fclose(stream);
+        return NULL;
+    }
+
+    fclose(stream);
+    return file;
+}
+
+// ソースファイルを開く（通常ファイルはmmap、それ以外はチャンク読み込み）
+SourceFile* source_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return source_open_buffered(path);
+    }
+
+    SourceFile* file = source_new(path);
+    if (file == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    bool mapped = source_map(file, fd, (size_t)st.st_size);
+    close(fd);
+
+    if (!mapped) {
+        free(file);
+        return source_open_buffered(path);
+    }
+
+    return file;
+}
+
+// ソースファイルを閉じる
+void source_close(SourceFile* file) {
+    if (file == NULL) return;
+
+    if (file->is_mapped) {
+        munmap((void*)file->data, file->mapped_size);
+    } else {
+        free((void*)file->data);
+    }
+    free(file);
+}
@@ -0,0 +1,1215 @@
+#include "../include/ssa.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SSA_INITIAL_CAPACITY 8
+
+static bool is_terminator(uint8_t op) {
+    return op == IR_JUMP || op == IR_BRANCH_FALSE || op == IR_RETURN;
+}
+
+static void clear_instruction(IrInstruction* instruction, IrOpcode op, uint8_t type) {
+    memset(instruction, 0, sizeof(IrInstruction));
+    instruction->op = (uint8_t)op;
+    instruction->type = type;
+    instruction->dest = IR_NO_VALUE;
+    instruction->a = IR_NO_VALUE;
+    instruction->b = IR_NO_VALUE;
+}
+
+// ブロックの追加
+uint32_t ssa_new_block(SsaFunction* ssa) {
+    if (ssa->failed) return SSA_NO_BLOCK;
+
+    if (ssa->block_count == ssa->block_capacity) {
+        size_t capacity = ssa->block_capacity ? ssa->block_capacity * 2 : SSA_INITIAL_CAPACITY;
+        SsaBlock* blocks = realloc(ssa->blocks, capacity * sizeof(SsaBlock));
+        if (blocks == NULL) {
+            ssa->failed = true;
+            return SSA_NO_BLOCK;
+        }
+        ssa->blocks = blocks;
+        ssa->block_capacity = capacity;
+    }
+
+    SsaBlock* block = &ssa->blocks[ssa->block_count];
+    memset(block, 0, sizeof(SsaBlock));
+    block->idom = SSA_NO_BLOCK;
+    block->dom_child = SSA_NO_BLOCK;
+    block->dom_sibling = SSA_NO_BLOCK;
+    block->place_before = SSA_NO_BLOCK;
+    return (uint32_t)ssa->block_count++;
+}
+
+bool ssa_add_predecessor(SsaFunction* ssa, uint32_t index, uint32_t predecessor) {
+    SsaBlock* block = &ssa->blocks[index];
+    if (block->predecessor_count == block->predecessor_capacity) {
+        uint32_t capacity = block->predecessor_capacity ? block->predecessor_capacity * 2 : 2;
+        uint32_t* predecessors = realloc(block->predecessors, capacity * sizeof(uint32_t));
+        if (predecessors == NULL) {
+            ssa->failed = true;
+            return false;
+        }
+        block->predecessors = predecessors;
+        block->predecessor_capacity = capacity;
+    }
+    block->predecessors[block->predecessor_count++] = predecessor;
+    return true;
+}
+
+void ssa_remove_predecessor(SsaFunction* ssa, uint32_t index, uint32_t predecessor) {
+    SsaBlock* block = &ssa->blocks[index];
+    uint32_t k = 0;
+    while (k < block->predecessor_count && block->predecessors[k] != predecessor) k++;
+    if (k == block->predecessor_count) return;
+
+    uint32_t tail = block->predecessor_count - k - 1;
+    memmove(&block->predecessors[k], &block->predecessors[k + 1], tail * sizeof(uint32_t));
+    block->predecessor_count--;
+
+    for (size_t i = 0; i < block->count && block->code[i].op == IR_PHI; i++) {
+        IrInstruction* phi = &block->code[i];
+        memmove(&phi->args[k], &phi->args[k + 1], tail * sizeof(IrValue));
+        phi->arg_count--;
+    }
+}
+
+uint32_t ssa_split_edge(SsaFunction* ssa, uint32_t index, uint32_t successor) {
+    uint32_t target = ssa->blocks[index].successors[successor];
+    uint32_t edge = ssa_new_block(ssa);
+    if (edge == SSA_NO_BLOCK) return SSA_NO_BLOCK;
+
+    IrInstruction* jump = ssa_insert(ssa, edge, 0);
+    if (jump == NULL || !ssa_add_predecessor(ssa, edge, index)) return SSA_NO_BLOCK;
+    jump->op = IR_JUMP;
+
+    SsaBlock* block = &ssa->blocks[edge];
+    block->successors[0] = target;
+    block->successor_count = 1;
+    block->place_before = target;
+    ssa->blocks[index].successors[successor] = edge;
+
+    // φの入力の位置を保つため、先行ブロックの並びの同じ場所を置き換える
+    SsaBlock* next = &ssa->blocks[target];
+    for (uint32_t k = 0; k < next->predecessor_count; k++) {
+        if (next->predecessors[k] == index) {
+            next->predecessors[k] = edge;
+            break;
+        }
+    }
+    return edge;
+}
+
+IrInstruction* ssa_insert(SsaFunction* ssa, uint32_t index, size_t position) {
+    if (ssa->failed) return NULL;
+
+    SsaBlock* block = &ssa->blocks[index];
+    if (block->count == block->capacity) {
+        size_t capacity = block->capacity ? block->capacity * 2 : SSA_INITIAL_CAPACITY;
+        IrInstruction* code = realloc(block->code, capacity * sizeof(IrInstruction));
+        if (code == NULL) {
+            ssa->failed = true;
+            return NULL;
+        }
+        block->code = code;
+        block->capacity = capacity;
+    }
+    memmove(&block->code[position + 1], &block->code[position], (block->count - position) * sizeof(IrInstruction));
+    block->count++;
+
+    IrInstruction* instruction = &block->code[position];
+    clear_instruction(instruction, IR_NOP, IR_INT);
+    return instruction;
+}
+
+size_t ssa_first_non_phi(const SsaBlock* block) {
+    size_t i = 0;
+    while (i < block->count && block->code[i].op == IR_PHI) i++;
+    return i;
+}
+
+void ssa_delete(IrInstruction* instruction) {
+    free(instruction->args);
+    clear_instruction(instruction, IR_NOP, IR_INT);
+}
+
+void ssa_compact(SsaFunction* ssa) {
+    for (size_t b = 0; b < ssa->block_count; b++) {
+        SsaBlock* block = &ssa->blocks[b];
+        size_t kept = 0;
+        for (size_t i = 0; i < block->count; i++) {
+            if (block->code[i].op != IR_NOP) block->code[kept++] = block->code[i];
+        }
+        block->count = kept;
+    }
+}
+
+// 置き換えの鎖をたどる（途中の値も最後の置き換え先を指すようにする）
+IrValue ssa_resolve(IrValue* replacement, size_t count, IrValue value) {
+    if (value == IR_NO_VALUE || value >= count) return value;
+    IrValue root = value;
+    while (replacement[root] != root) root = replacement[root];
+    while (replacement[value] != root) {
+        IrValue next = replacement[value];
+        replacement[value] = root;
+        value = next;
+    }
+    return root;
+}
+
+void ssa_replace_values(SsaFunction* ssa, IrValue* replacement, size_t count) {
+    for (size_t b = 0; b < ssa->block_count; b++) {
+        SsaBlock* block = &ssa->blocks[b];
+        if (block->removed) continue;
+        for (size_t i = 0; i < block->count; i++) {
+            IrInstruction* instruction = &block->code[i];
+            instruction->a = ssa_resolve(replacement, count, instruction->a);
+            instruction->b = ssa_resolve(replacement, count, instruction->b);
+            for (uint32_t j = 0; j < instruction->arg_count; j++) {
+                instruction->args[j] = ssa_resolve(replacement, count, instruction->args[j]);
+            }
+        }
+    }
+}
+
+size_t ssa_instruction_count(const SsaFunction* ssa) {
+    size_t count = 0;
+    for (size_t b = 0; b < ssa->block_count; b++) {
+        if (!ssa->blocks[b].removed) count += ssa->blocks[b].count;
+    }
+    return count;
+}
+
+static void free_block(SsaBlock* block) {
+    for (size_t i = 0; i < block->count; i++) free(block->code[i].args);
+    free(block->code);
+    free(block->predecessors);
+    block->code = NULL;
+    block->predecessors = NULL;
+    block->count = 0;
+    block->capacity = 0;
+    block->predecessor_count = 0;
+    block->predecessor_capacity = 0;
+    block->successor_count = 0;
+}
+
+void ssa_free(SsaFunction* ssa) {
+    for (size_t b = 0; b < ssa->block_count; b++) free_block(&ssa->blocks[b]);
+    free(ssa->blocks);
+    free(ssa->order);
+    memset(ssa, 0, sizeof(SsaFunction));
+}
+
+// jumpだけのブロックへの辺を、その先へ直接つなぎ替える
+// 先がφを持つとき、または分岐の両方の行き先が同じになるときはつなぎ替えない
+static bool thread_jumps(SsaFunction* ssa) {
+    bool changed = false;
+    for (uint32_t e = 1; e < ssa->block_count && !ssa->failed; e++) {
+        SsaBlock* empty = &ssa->blocks[e];
+        if (empty->removed || empty->count != 1 || empty->code[0].op != IR_JUMP) continue;
+        uint32_t target = empty->successors[0];
+        if (target == e || ssa_first_non_phi(&ssa->blocks[target]) != 0) continue;
+
+        for (uint32_t k = 0; k < ssa->blocks[e].predecessor_count;) {
+            uint32_t p = ssa->blocks[e].predecessors[k];
+            SsaBlock* predecessor = &ssa->blocks[p];
+            bool duplicate = false;
+            for (uint32_t s = 0; s < predecessor->successor_count; s++) {
+                duplicate = duplicate || predecessor->successors[s] == target;
+            }
+            if (duplicate || p == e) {
+                k++;
+                continue;
+            }
+            for (uint32_t s = 0; s < predecessor->successor_count; s++) {
+                if (predecessor->successors[s] == e) predecessor->successors[s] = target;
+            }
+            if (!ssa_add_predecessor(ssa, target, p)) return changed;
+            ssa_remove_predecessor(ssa, e, p);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// 唯一の先行ブロックからjumpで続くブロックを先行ブロックの末尾に併合する
+static bool merge_blocks(SsaFunction* ssa) {
+    bool changed = false;
+    for (uint32_t b = 0; b < ssa->block_count && !ssa->failed; b++) {
+        while (!ssa->failed) {
+            SsaBlock* block = &ssa->blocks[b];
+            if (block->removed || block->count == 0 || block->code[block->count - 1].op != IR_JUMP) break;
+            uint32_t s = block->successors[0];
+            SsaBlock* next = &ssa->blocks[s];
+            if (s == 0 || s == b || next->predecessor_count != 1) break;
+
+            // 入力が1つのφはコピーになる
+            for (size_t i = 0; i < next->count && next->code[i].op == IR_PHI; i++) {
+                IrInstruction* phi = &next->code[i];
+                IrValue value = phi->args[0];
+                free(phi->args);
+                phi->args = NULL;
+                phi->arg_count = 0;
+                phi->op = IR_MOVE;
+                phi->a = value;
+            }
+
+            block->count--;
+            for (size_t i = 0; i < next->count; i++) {
+                IrInstruction* slot = ssa_insert(ssa, b, ssa->blocks[b].count);
+                if (slot == NULL) return changed;
+                *slot = ssa->blocks[s].code[i];
+            }
+            block = &ssa->blocks[b];
+            next = &ssa->blocks[s];
+            block->successor_count = next->successor_count;
+            for (uint32_t k = 0; k < next->successor_count; k++) {
+                uint32_t t = next->successors[k];
+                block->successors[k] = t;
+                SsaBlock* after = &ssa->blocks[t];
+                for (uint32_t j = 0; j < after->predecessor_count; j++) {
+                    if (after->predecessors[j] == s) {
+                        after->predecessors[j] = b;
+                        break;
+                    }
+                }
+            }
+            // 命令は併合先に移した
+            next->count = 0;
+            free_block(next);
+            next->removed = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool ssa_simplify_cfg(SsaFunction* ssa) {
+    bool threaded = thread_jumps(ssa);
+    bool merged = merge_blocks(ssa);
+    return threaded || merged;
+}
+
+bool ssa_dominates(const SsaFunction* ssa, uint32_t a, uint32_t b) {
+    const SsaBlock* x = &ssa->blocks[a];
+    const SsaBlock* y = &ssa->blocks[b];
+    return x->dom_pre <= y->dom_pre && y->dom_post <= x->dom_post;
+}
+
+// 支配木の共通の祖先（Cooper, Harvey & Kennedy）
+static uint32_t intersect(const SsaBlock* blocks, const uint32_t* rpo, uint32_t a, uint32_t b) {
+    while (a != b) {
+        while (rpo[a] > rpo[b]) a = blocks[a].idom;
+        while (rpo[b] > rpo[a]) b = blocks[b].idom;
+    }
+    return a;
+}
+
+SlangError ssa_analyze(SsaFunction* ssa) {
+    if (ssa->failed) return SLANG_ERROR_INTERNAL;
+
+    size_t n = ssa->block_count;
+    uint32_t* stack = malloc(n * sizeof(uint32_t));
+    uint32_t* next_successor = calloc(n, sizeof(uint32_t));
+    uint32_t* rpo = malloc(n * sizeof(uint32_t));
+    bool* visited = calloc(n, sizeof(bool));
+    uint32_t* order = realloc(ssa->order, n * sizeof(uint32_t));
+    if (order != NULL) ssa->order = order;
+    if (stack == NULL || next_successor == NULL || rpo == NULL || visited == NULL || order == NULL) {
+        free(stack);
+        free(next_successor);
+        free(rpo);
+        free(visited);
+        ssa->failed = true;
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    // 深さ優先探索の後順（逆順に並べると逆後順になる）
+    size_t post_count = 0;
+    size_t depth = 0;
+    stack[depth++] = 0;
+    visited[0] = true;
+    while (depth > 0) {
+        uint32_t b = stack[depth - 1];
+        SsaBlock* block = &ssa->blocks[b];
+        if (next_successor[b] < block->successor_count) {
+            uint32_t s = block->successors[next_successor[b]++];
+            if (!visited[s]) {
+                visited[s] = true;
+                stack[depth++] = s;
+            }
+            continue;
+        }
+        order[n - 1 - post_count++] = b;
+        depth--;
+    }
+    memmove(order, order + (n - post_count), post_count * sizeof(uint32_t));
+    ssa->order_count = post_count;
+
+    // 到達しないブロックを取り除く
+    for (uint32_t b = 0; b < n; b++) {
+        SsaBlock* block = &ssa->blocks[b];
+        if (visited[b] || block->removed) continue;
+        for (uint32_t s = 0; s < block->successor_count; s++) {
+            ssa_remove_predecessor(ssa, block->successors[s], b);
+        }
+        free_block(block);
+        block->removed = true;
+    }
+
+    // 支配木
+    for (uint32_t b = 0; b < n; b++) {
+        SsaBlock* block = &ssa->blocks[b];
+        block->idom = SSA_NO_BLOCK;
+        block->dom_child = SSA_NO_BLOCK;
+        block->dom_sibling = SSA_NO_BLOCK;
+    }
+    for (size_t i = 0; i < post_count; i++) rpo[order[i]] = (uint32_t)i;
+
+    SsaBlock* blocks = ssa->blocks;
+    blocks[0].idom = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < post_count; i++) {
+            uint32_t b = order[i];
+            uint32_t idom = SSA_NO_BLOCK;
+            for (uint32_t k = 0; k < blocks[b].predecessor_count; k++) {
+                uint32_t p = blocks[b].predecessors[k];
+                if (blocks[p].idom == SSA_NO_BLOCK) continue;
+                idom = idom == SSA_NO_BLOCK ? p : intersect(blocks, rpo, p, idom);
+            }
+            if (idom != blocks[b].idom) {
+                blocks[b].idom = idom;
+                changed = true;
+            }
+        }
+    }
+    blocks[0].idom = SSA_NO_BLOCK;
+
+    // 子は逆後順に並べる
+    for (size_t i = post_count; i-- > 1;) {
+        uint32_t b = order[i];
+        uint32_t parent = blocks[b].idom;
+        blocks[b].dom_sibling = blocks[parent].dom_child;
+        blocks[parent].dom_child = b;
+    }
+
+    // 前順・後順の番号（next_successorを次に訪れる子として使い直す）
+    uint32_t* cursor = next_successor;
+    uint32_t pre = 0, post = 0;
+    depth = 0;
+    stack[depth++] = 0;
+    blocks[0].dom_pre = pre++;
+    cursor[0] = blocks[0].dom_child;
+    while (depth > 0) {
+        uint32_t b = stack[depth - 1];
+        uint32_t child = cursor[b];
+        if (child != SSA_NO_BLOCK) {
+            cursor[b] = blocks[child].dom_sibling;
+            blocks[child].dom_pre = pre++;
+            cursor[child] = blocks[child].dom_child;
+            stack[depth++] = child;
+        } else {
+            blocks[b].dom_post = post++;
+            depth--;
+        }
+    }
+
+    free(stack);
+    free(next_successor);
+    free(rpo);
+    free(visited);
+    return SLANG_SUCCESS;
+}
+
+// 線形IRからブロックへの分割
+static SlangError split_blocks(SsaFunction* ssa, const IrFunction* function) {
+    size_t n = function->count;
+    uint32_t* label_block = malloc((function->label_count + 1) * sizeof(uint32_t));
+    bool* leader = calloc(n + 1, sizeof(bool));
+    uint32_t* block_of = malloc((n + 1) * sizeof(uint32_t));
+    if (label_block == NULL || leader == NULL || block_of == NULL) {
+        free(label_block);
+        free(leader);
+        free(block_of);
+        return SLANG_ERROR_INTERNAL;
+    }
+    for (uint32_t l = 0; l <= function->label_count; l++) label_block[l] = SSA_NO_BLOCK;
+
+    uint32_t entry = ssa_new_block(ssa);
+    leader[0] = true;
+    for (size_t i = 0; i < n; i++) {
+        if (function->code[i].op == IR_LABEL) leader[i] = true;
+        if (is_terminator(function->code[i].op)) leader[i + 1] = true;
+    }
+
+    // 線形のブロックをそのままの順に作る
+    uint32_t current = SSA_NO_BLOCK;
+    for (size_t i = 0; i < n && !ssa->failed; i++) {
+        if (leader[i]) current = ssa_new_block(ssa);
+        block_of[i] = current;
+        const IrInstruction* source = &function->code[i];
+        if (source->op == IR_LABEL) {
+            if (source->imm.label < function->label_count) label_block[source->imm.label] = current;
+            continue;
+        }
+
+        IrInstruction* copy = ssa_insert(ssa, current, ssa->blocks[current].count);
+        if (copy == NULL) break;
+        *copy = *source;
+        copy->args = NULL;
+        if (source->arg_count > 0) {
+            copy->args = malloc(source->arg_count * sizeof(IrValue));
+            if (copy->args == NULL) {
+                copy->arg_count = 0;
+                ssa->failed = true;
+                break;
+            }
+            memcpy(copy->args, source->args, source->arg_count * sizeof(IrValue));
+        }
+    }
+
+    // 関数の末尾から落ちる流れは値のないreturnにする
+    uint32_t exit = SSA_NO_BLOCK;
+    size_t linear_count = ssa->block_count;
+    for (uint32_t b = entry; b < linear_count && !ssa->failed; b++) {
+        uint32_t next = b + 1 < linear_count ? b + 1 : SSA_NO_BLOCK;
+        SsaBlock* block = &ssa->blocks[b];
+        IrInstruction* last = block->count > 0 ? &block->code[block->count - 1] : NULL;
+        uint8_t op = last != NULL ? last->op : IR_NOP;
+
+        if (op == IR_JUMP || op == IR_BRANCH_FALSE) {
+            uint32_t target = last->imm.label < function->label_count ? label_block[last->imm.label] : SSA_NO_BLOCK;
+            if (target == SSA_NO_BLOCK) ssa->failed = true;
+            block->successors[block->successor_count++] = target;
+        }
+        if (op == IR_RETURN || op == IR_JUMP) continue;
+
+        if (next == SSA_NO_BLOCK) {
+            if (exit == SSA_NO_BLOCK) {
+                exit = ssa_new_block(ssa);
+                IrInstruction* ret = ssa_insert(ssa, exit, 0);
+                if (ret == NULL) break;
+                ret->op = IR_RETURN;
+            }
+            next = exit;
+            block = &ssa->blocks[b];
+        }
+        if (op == IR_BRANCH_FALSE) {
+            block->successors[block->successor_count++] = next;
+            // 両方の分岐先が同じならjumpにする
+            if (block->successors[0] == next) {
+                last = &block->code[block->count - 1];
+                last->op = IR_JUMP;
+                last->a = IR_NO_VALUE;
+                block->successor_count = 1;
+            }
+        } else {
+            IrInstruction* jump = ssa_insert(ssa, b, ssa->blocks[b].count);
+            if (jump == NULL) break;
+            jump->op = IR_JUMP;
+            block = &ssa->blocks[b];
+            block->successors[block->successor_count++] = next;
+        }
+    }
+
+    for (uint32_t b = 0; b < ssa->block_count && !ssa->failed; b++) {
+        const SsaBlock* block = &ssa->blocks[b];
+        for (uint32_t s = 0; s < block->successor_count; s++) {
+            ssa_add_predecessor(ssa, block->successors[s], b);
+        }
+    }
+
+    free(label_block);
+    free(leader);
+    free(block_of);
+    return ssa->failed ? SLANG_ERROR_INTERNAL : SLANG_SUCCESS;
+}
+
+// 名前の付け替えの状態
+typedef struct {
+    SsaFunction* ssa;
+    size_t original_count;     // 変換前の値の数（これ以降の値は変数ではない）
+    const bool* variable;
+    IrValue* current;          // 変数ごとの現在の定義
+    IrValue* undefined;        // 定義が届かないときに使う0（変数ごと、必要になったら作る）
+    IrValue* log;              // 戻すための（変数, 以前の定義）の組
+    size_t log_count;
+    size_t log_capacity;
+} Renaming;
+
+static bool is_variable(const Renaming* renaming, IrValue value) {
+    return value != IR_NO_VALUE && value < renaming->original_count && renaming->variable[value];
+}
+
+static IrValue current_definition(Renaming* renaming, IrValue variable) {
+    if (renaming->current[variable] != IR_NO_VALUE) return renaming->current[variable];
+    if (renaming->undefined[variable] == IR_NO_VALUE) {
+        IrFunction* function = renaming->ssa->function;
+        renaming->undefined[variable] = ir_new_value(function, (IrType)function->value_types[variable]);
+        if (renaming->undefined[variable] == IR_NO_VALUE) renaming->ssa->failed = true;
+    }
+    return renaming->undefined[variable];
+}
+
+static bool push_definition(Renaming* renaming, IrValue variable, IrValue value) {
+    if (renaming->log_count + 2 > renaming->log_capacity) {
+        size_t capacity = renaming->log_capacity ? renaming->log_capacity * 2 : 64;
+        IrValue* log = realloc(renaming->log, capacity * sizeof(IrValue));
+        if (log == NULL) {
+            renaming->ssa->failed = true;
+            return false;
+        }
+        renaming->log = log;
+        renaming->log_capacity = capacity;
+    }
+    renaming->log[renaming->log_count++] = variable;
+    renaming->log[renaming->log_count++] = renaming->current[variable];
+    renaming->current[variable] = value;
+    return true;
+}
+
+// 支配木を前順にたどって、変数の使用を届いている定義に、定義を新しい値に付け替える
+static void rename_block(Renaming* renaming, uint32_t index) {
+    SsaFunction* ssa = renaming->ssa;
+    size_t saved = renaming->log_count;
+
+    for (size_t i = 0; i < ssa->blocks[index].count && !ssa->failed; i++) {
+        IrInstruction* instruction = &ssa->blocks[index].code[i];
+        if (instruction->op != IR_PHI) {
+            if (is_variable(renaming, instruction->a)) instruction->a = current_definition(renaming, instruction->a);
+            if (is_variable(renaming, instruction->b)) instruction->b = current_definition(renaming, instruction->b);
+            for (uint32_t j = 0; j < instruction->arg_count; j++) {
+                if (is_variable(renaming, instruction->args[j])) {
+                    instruction->args[j] = current_definition(renaming, instruction->args[j]);
+                }
+            }
+        }
+        if (is_variable(renaming, instruction->dest)) {
+            IrValue variable = instruction->dest;
+            IrValue value = ir_new_value(ssa->function, (IrType)ssa->function->value_types[variable]);
+            if (value == IR_NO_VALUE || !push_definition(renaming, variable, value)) {
+                ssa->failed = true;
+                return;
+            }
+            // ir_new_valueの後も命令の位置は変わらない（ブロックの配列は別）
+            ssa->blocks[index].code[i].dest = value;
+        }
+    }
+
+    // 後続ブロックのφに、この辺から届く定義を入れる（φのaに元の変数を置いてある）
+    const SsaBlock* block = &ssa->blocks[index];
+    for (uint32_t s = 0; s < block->successor_count; s++) {
+        SsaBlock* successor = &ssa->blocks[block->successors[s]];
+        uint32_t k = 0;
+        while (k < successor->predecessor_count && successor->predecessors[k] != index) k++;
+        for (size_t i = 0; i < successor->count && successor->code[i].op == IR_PHI; i++) {
+            IrInstruction* phi = &successor->code[i];
+            phi->args[k] = current_definition(renaming, phi->a);
+        }
+    }
+
+    for (uint32_t child = block->dom_child; child != SSA_NO_BLOCK && !ssa->failed;
+         child = ssa->blocks[child].dom_sibling) {
+        rename_block(renaming, child);
+    }
+
+    while (renaming->log_count > saved) {
+        IrValue previous = renaming->log[--renaming->log_count];
+        IrValue variable = renaming->log[--renaming->log_count];
+        renaming->current[variable] = previous;
+    }
+}
+
+// 支配辺境（Cooper, Harvey & Kennedy）を(ブロック, 辺境)の組で集める
+static uint32_t* dominance_frontiers(const SsaFunction* ssa, size_t* pair_count) {
+    size_t count = 0, capacity = 64;
+    uint32_t* pairs = malloc(capacity * sizeof(uint32_t));
+    if (pairs == NULL) return NULL;
+
+    for (size_t i = 0; i < ssa->order_count; i++) {
+        uint32_t b = ssa->order[i];
+        const SsaBlock* block = &ssa->blocks[b];
+        if (block->predecessor_count < 2) continue;
+        for (uint32_t k = 0; k < block->predecessor_count; k++) {
+            uint32_t runner = block->predecessors[k];
+            while (runner != block->idom && runner != SSA_NO_BLOCK) {
+                if (count + 2 > capacity) {
+                    capacity *= 2;
+                    uint32_t* grown = realloc(pairs, capacity * sizeof(uint32_t));
+                    if (grown == NULL) {
+                        free(pairs);
+                        return NULL;
+                    }
+                    pairs = grown;
+                }
+                pairs[count++] = runner;
+                pairs[count++] = b;
+                runner = ssa->blocks[runner].idom;
+            }
+        }
+    }
+    *pair_count = count / 2;
+    return pairs;
+}
+
+// (キー, 値)の組をキーごとの並び（CSR）にする
+static bool group_pairs(const uint32_t* pairs, size_t pair_count, size_t key_count, uint32_t** out_start,
+                        uint32_t** out_items) {
+    uint32_t* start = calloc(key_count + 1, sizeof(uint32_t));
+    uint32_t* items = malloc((pair_count ? pair_count : 1) * sizeof(uint32_t));
+    if (start == NULL || items == NULL) {
+        free(start);
+        free(items);
+        return false;
+    }
+    for (size_t i = 0; i < pair_count; i++) start[pairs[i * 2] + 1]++;
+    for (size_t k = 0; k < key_count; k++) start[k + 1] += start[k];
+    uint32_t* fill = malloc((key_count ? key_count : 1) * sizeof(uint32_t));
+    if (fill == NULL) {
+        free(start);
+        free(items);
+        return false;
+    }
+    memcpy(fill, start, key_count * sizeof(uint32_t));
+    for (size_t i = 0; i < pair_count; i++) items[fill[pairs[i * 2]]++] = pairs[i * 2 + 1];
+    free(fill);
+    *out_start = start;
+    *out_items = items;
+    return true;
+}
+
+// 変数の判定
+// 定義が複数ある値と、定義がすべての使用を支配しない値（未初期化で読まれるものを含む）が変数になる。
+// ブロックの中で定義より前に読まれる変数だけにφを置く（semi-pruned SSA）。
+static SlangError find_variables(SsaFunction* ssa, bool* variable, bool* global) {
+    size_t value_count = ssa->function->value_count;
+    uint32_t* def_count = calloc(value_count, sizeof(uint32_t));
+    uint32_t* def_block = malloc(value_count * sizeof(uint32_t));
+    uint32_t* def_position = malloc(value_count * sizeof(uint32_t));
+    uint32_t* seen = malloc(value_count * sizeof(uint32_t));
+    if (def_count == NULL || def_block == NULL || def_position == NULL || seen == NULL) {
+        free(def_count);
+        free(def_block);
+        free(def_position);
+        free(seen);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    for (size_t i = 0; i < ssa->order_count; i++) {
+        const SsaBlock* block = &ssa->blocks[ssa->order[i]];
+        for (size_t j = 0; j < block->count; j++) {
+            IrValue dest = block->code[j].dest;
+            if (dest == IR_NO_VALUE) continue;
+            def_count[dest]++;
+            def_block[dest] = ssa->order[i];
+            def_position[dest] = (uint32_t)j;
+        }
+    }
+    for (size_t v = 0; v < value_count; v++) {
+        variable[v] = def_count[v] > 1;
+        seen[v] = SSA_NO_BLOCK;
+    }
+
+    for (size_t i = 0; i < ssa->order_count; i++) {
+        uint32_t b = ssa->order[i];
+        const SsaBlock* block = &ssa->blocks[b];
+        for (size_t j = 0; j < block->count; j++) {
+            const IrInstruction* instruction = &block->code[j];
+            for (uint32_t k = 0; k < instruction->arg_count + 2; k++) {
+                IrValue use = k == 0 ? instruction->a : k == 1 ? instruction->b : instruction->args[k - 2];
+                if (use == IR_NO_VALUE || variable[use]) continue;
+                bool dominated = def_count[use] == 1 &&
+                                 (def_block[use] == b ? def_position[use] < j : ssa_dominates(ssa, def_block[use], b));
+                if (!dominated) variable[use] = true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < ssa->order_count; i++) {
+        uint32_t b = ssa->order[i];
+        const SsaBlock* block = &ssa->blocks[b];
+        for (size_t j = 0; j < block->count; j++) {
+            const IrInstruction* instruction = &block->code[j];
+            for (uint32_t k = 0; k < instruction->arg_count + 2; k++) {
+                IrValue use = k == 0 ? instruction->a : k == 1 ? instruction->b : instruction->args[k - 2];
+                if (use != IR_NO_VALUE && variable[use] && seen[use] != b) global[use] = true;
+            }
+            if (instruction->dest != IR_NO_VALUE) seen[instruction->dest] = b;
+        }
+    }
+
+    free(def_count);
+    free(def_block);
+    free(def_position);
+    free(seen);
+    return SLANG_SUCCESS;
+}
+
+// 反復支配辺境にφを置く（φのaに元の変数を入れておく）
+static SlangError place_phis(SsaFunction* ssa, const bool* variable, const bool* global) {
+    size_t value_count = ssa->function->value_count;
+    size_t block_count = ssa->block_count;
+
+    size_t frontier_count = 0;
+    uint32_t* frontier_pairs = dominance_frontiers(ssa, &frontier_count);
+    if (frontier_pairs == NULL) return SLANG_ERROR_INTERNAL;
+
+    // 変数ごとの定義ブロック
+    size_t def_count = 0;
+    for (size_t i = 0; i < ssa->order_count; i++) {
+        const SsaBlock* block = &ssa->blocks[ssa->order[i]];
+        for (size_t j = 0; j < block->count; j++) {
+            IrValue dest = block->code[j].dest;
+            if (dest != IR_NO_VALUE && global[dest]) def_count++;
+        }
+    }
+    uint32_t* def_pairs = malloc((def_count ? def_count : 1) * 2 * sizeof(uint32_t));
+    uint32_t *frontier_start = NULL, *frontiers = NULL, *def_start = NULL, *defs = NULL;
+    uint32_t* has_phi = malloc(block_count * sizeof(uint32_t));
+    uint32_t* queued = malloc(block_count * sizeof(uint32_t));
+    uint32_t* worklist = malloc((block_count + def_count + 1) * sizeof(uint32_t));
+    bool ok = def_pairs != NULL && has_phi != NULL && queued != NULL && worklist != NULL &&
+              group_pairs(frontier_pairs, frontier_count, block_count, &frontier_start, &frontiers);
+
+    if (ok) {
+        size_t k = 0;
+        for (size_t i = 0; i < ssa->order_count; i++) {
+            const SsaBlock* block = &ssa->blocks[ssa->order[i]];
+            for (size_t j = 0; j < block->count; j++) {
+                IrValue dest = block->code[j].dest;
+                if (dest == IR_NO_VALUE || !global[dest]) continue;
+                def_pairs[k++] = dest;
+                def_pairs[k++] = ssa->order[i];
+            }
+        }
+        ok = group_pairs(def_pairs, def_count, value_count, &def_start, &defs);
+    }
+
+    if (ok) {
+        for (size_t b = 0; b < block_count; b++) {
+            has_phi[b] = UINT32_MAX;
+            queued[b] = UINT32_MAX;
+        }
+        for (IrValue v = 0; v < value_count && ok; v++) {
+            if (!variable[v] || !global[v]) continue;
+
+            size_t work = 0;
+            for (uint32_t d = def_start[v]; d < def_start[v + 1]; d++) {
+                if (queued[defs[d]] == v) continue;
+                queued[defs[d]] = v;
+                worklist[work++] = defs[d];
+            }
+            while (work > 0 && ok) {
+                uint32_t b = worklist[--work];
+                for (uint32_t f = frontier_start[b]; f < frontier_start[b + 1]; f++) {
+                    uint32_t join = frontiers[f];
+                    if (has_phi[join] == v) continue;
+                    has_phi[join] = v;
+
+                    uint32_t arg_count = ssa->blocks[join].predecessor_count;
+                    IrValue* args = malloc(arg_count * sizeof(IrValue));
+                    IrInstruction* phi = args != NULL ? ssa_insert(ssa, join, 0) : NULL;
+                    if (phi == NULL) {
+                        free(args);
+                        ok = false;
+                        break;
+                    }
+                    phi->op = IR_PHI;
+                    phi->type = ssa->function->value_types[v];
+                    phi->dest = v;
+                    phi->a = v;
+                    phi->args = args;
+                    phi->arg_count = arg_count;
+                    for (uint32_t k = 0; k < arg_count; k++) args[k] = v;
+
+                    if (queued[join] != v) {
+                        queued[join] = v;
+                        worklist[work++] = join;
+                    }
+                }
+            }
+        }
+    }
+
+    free(frontier_pairs);
+    free(frontier_start);
+    free(frontiers);
+    free(def_pairs);
+    free(def_start);
+    free(defs);
+    free(has_phi);
+    free(queued);
+    free(worklist);
+    return ok ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+}
+
+SlangError ssa_build(SsaFunction* ssa, IrFunction* function) {
+    memset(ssa, 0, sizeof(SsaFunction));
+    ssa->function = function;
+    if (function == NULL || function->failed) return SLANG_ERROR_INTERNAL;
+
+    SlangError error = split_blocks(ssa, function);
+    if (error == SLANG_SUCCESS) error = ssa_analyze(ssa);
+    if (error != SLANG_SUCCESS) {
+        ssa_free(ssa);
+        return error;
+    }
+
+    size_t value_count = function->value_count;
+    Renaming renaming;
+    memset(&renaming, 0, sizeof(renaming));
+    bool* variable = calloc(value_count ? value_count : 1, sizeof(bool));
+    bool* global = calloc(value_count ? value_count : 1, sizeof(bool));
+    renaming.current = malloc((value_count ? value_count : 1) * sizeof(IrValue));
+    renaming.undefined = malloc((value_count ? value_count : 1) * sizeof(IrValue));
+    if (variable == NULL || global == NULL || renaming.current == NULL || renaming.undefined == NULL) {
+        error = SLANG_ERROR_INTERNAL;
+    }
+
+    if (error == SLANG_SUCCESS) error = find_variables(ssa, variable, global);
+    if (error == SLANG_SUCCESS) error = place_phis(ssa, variable, global);
+    if (error == SLANG_SUCCESS) {
+        renaming.ssa = ssa;
+        renaming.original_count = value_count;
+        renaming.variable = variable;
+        for (size_t v = 0; v < value_count; v++) {
+            renaming.current[v] = IR_NO_VALUE;
+            renaming.undefined[v] = IR_NO_VALUE;
+        }
+        rename_block(&renaming, 0);
+
+        // φに入れておいた元の変数を消し、届かない定義の0を入口に置く
+        for (size_t b = 0; b < ssa->block_count; b++) {
+            SsaBlock* block = &ssa->blocks[b];
+            for (size_t i = 0; i < block->count && block->code[i].op == IR_PHI; i++) block->code[i].a = IR_NO_VALUE;
+        }
+        for (size_t v = 0; v < value_count && !ssa->failed; v++) {
+            if (renaming.undefined[v] == IR_NO_VALUE) continue;
+            IrInstruction* zero = ssa_insert(ssa, 0, 0);
+            if (zero == NULL) break;
+            zero->op = IR_CONST;
+            zero->type = function->value_types[v];
+            zero->dest = renaming.undefined[v];
+            if (zero->type == IR_FLOAT) zero->imm.number = 0.0;
+        }
+        if (ssa->failed) error = SLANG_ERROR_INTERNAL;
+    }
+
+    free(variable);
+    free(global);
+    free(renaming.current);
+    free(renaming.undefined);
+    free(renaming.log);
+    if (error != SLANG_SUCCESS) ssa_free(ssa);
+    return error;
+}
+
+// 並列コピーを順に並べる
+// 他のコピーが読む値を先に上書きしないように並べ、循環は一時値で断つ
+static bool emit_parallel_copies(SsaFunction* ssa, uint32_t block, size_t position, IrValue* dests,
+                                 IrValue* sources, size_t count) {
+    size_t pending = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (dests[i] == sources[i]) continue;
+        dests[pending] = dests[i];
+        sources[pending] = sources[i];
+        pending++;
+    }
+
+    while (pending > 0) {
+        size_t ready = pending;
+        for (size_t i = 0; i < pending && ready == pending; i++) {
+            bool read = false;
+            for (size_t j = 0; j < pending && !read; j++) read = j != i && sources[j] == dests[i];
+            if (!read) ready = i;
+        }
+
+        IrValue dest, source;
+        if (ready < pending) {
+            dest = dests[ready];
+            source = sources[ready];
+            dests[ready] = dests[pending - 1];
+            sources[ready] = sources[pending - 1];
+            pending--;
+        } else {
+            // 循環：先頭のコピー先を一時値に逃がし、それを読むコピーの読み元にする
+            IrValue saved = dests[0];
+            dest = ir_new_value(ssa->function, (IrType)ssa->function->value_types[saved]);
+            if (dest == IR_NO_VALUE) return false;
+            source = saved;
+            for (size_t j = 0; j < pending; j++) {
+                if (sources[j] == saved) sources[j] = dest;
+            }
+        }
+
+        IrInstruction* move = ssa_insert(ssa, block, position++);
+        if (move == NULL) return false;
+        move->op = IR_MOVE;
+        move->type = ssa->function->value_types[dest];
+        move->dest = dest;
+        move->a = source;
+    }
+    return true;
+}
+
+// φを先行ブロックの末尾のコピーにする（分岐から来る辺は分割して、そこにコピーを置く）
+static SlangError eliminate_phis(SsaFunction* ssa) {
+    size_t block_count = ssa->block_count;
+    IrValue* dests = NULL;
+    IrValue* sources = NULL;
+    size_t capacity = 0;
+
+    for (uint32_t b = 0; b < block_count && !ssa->failed; b++) {
+        if (ssa->blocks[b].removed) continue;
+        size_t phi_count = ssa_first_non_phi(&ssa->blocks[b]);
+        if (phi_count == 0) continue;
+
+        if (phi_count > capacity) {
+            capacity = phi_count;
+            IrValue* grown_dests = realloc(dests, capacity * sizeof(IrValue));
+            if (grown_dests != NULL) dests = grown_dests;
+            IrValue* grown_sources = realloc(sources, capacity * sizeof(IrValue));
+            if (grown_sources != NULL) sources = grown_sources;
+            if (grown_dests == NULL || grown_sources == NULL) {
+                ssa->failed = true;
+                break;
+            }
+        }
+
+        for (uint32_t k = 0; k < ssa->blocks[b].predecessor_count && !ssa->failed; k++) {
+            for (size_t i = 0; i < phi_count; i++) {
+                dests[i] = ssa->blocks[b].code[i].dest;
+                sources[i] = ssa->blocks[b].code[i].args[k];
+            }
+
+            uint32_t predecessor = ssa->blocks[b].predecessors[k];
+            uint32_t target = predecessor;
+            if (ssa->blocks[predecessor].successor_count > 1) {
+                uint32_t s = ssa->blocks[predecessor].successors[0] == b ? 0 : 1;
+                target = ssa_split_edge(ssa, predecessor, s);
+                if (target == SSA_NO_BLOCK) break;
+            }
+            size_t position = ssa->blocks[target].count - 1;
+            if (!emit_parallel_copies(ssa, target, position, dests, sources, phi_count)) ssa->failed = true;
+        }
+
+        for (size_t i = 0; i < phi_count; i++) ssa_delete(&ssa->blocks[b].code[i]);
+    }
+
+    free(dests);
+    free(sources);
+    ssa_compact(ssa);
+    return ssa->failed ? SLANG_ERROR_INTERNAL : SLANG_SUCCESS;
+}
+
+// φを消した後のコピーを、読み元の定義に直接書かせて省く
+// 読み元がそのコピーでしか使われず、同じブロックの前で定義されていて、その間に
+// コピー先を読み書きする命令がなければ、定義の書き込み先をコピー先に替えられる
+static SlangError coalesce_copies(SsaFunction* ssa) {
+    size_t value_count = ssa->function->value_count;
+    uint32_t* uses = calloc(value_count ? value_count : 1, sizeof(uint32_t));
+    uint32_t* defs = calloc(value_count ? value_count : 1, sizeof(uint32_t));
+    // ブロック内の位置（stampが今のブロックでなければ未設定）
+    uint32_t* def_position = malloc((value_count ? value_count : 1) * sizeof(uint32_t));
+    uint32_t* touch_position = malloc((value_count ? value_count : 1) * sizeof(uint32_t));
+    uint32_t* def_stamp = malloc((value_count ? value_count : 1) * sizeof(uint32_t));
+    uint32_t* touch_stamp = malloc((value_count ? value_count : 1) * sizeof(uint32_t));
+    SlangError error = SLANG_SUCCESS;
+    if (uses == NULL || defs == NULL || def_position == NULL || touch_position == NULL || def_stamp == NULL ||
+        touch_stamp == NULL) {
+        error = SLANG_ERROR_INTERNAL;
+        goto done;
+    }
+    for (size_t v = 0; v < value_count; v++) def_stamp[v] = touch_stamp[v] = SSA_NO_BLOCK;
+
+    for (uint32_t b = 0; b < ssa->block_count; b++) {
+        const SsaBlock* block = &ssa->blocks[b];
+        if (block->removed) continue;
+        for (size_t i = 0; i < block->count; i++) {
+            const IrInstruction* instruction = &block->code[i];
+            if (instruction->dest != IR_NO_VALUE) defs[instruction->dest]++;
+            if (instruction->a != IR_NO_VALUE) uses[instruction->a]++;
+            if (instruction->b != IR_NO_VALUE) uses[instruction->b]++;
+            for (uint32_t k = 0; k < instruction->arg_count; k++) uses[instruction->args[k]]++;
+        }
+    }
+
+    for (uint32_t b = 0; b < ssa->block_count; b++) {
+        SsaBlock* block = &ssa->blocks[b];
+        if (block->removed) continue;
+        for (size_t i = 0; i < block->count; i++) {
+            IrInstruction* instruction = &block->code[i];
+            IrValue source = instruction->a;
+            IrValue dest = instruction->dest;
+            if (instruction->op == IR_MOVE && uses[source] == 1 && defs[source] == 1 && def_stamp[source] == b &&
+                (touch_stamp[dest] != b || touch_position[dest] <= def_position[source])) {
+                IrInstruction* definition = &block->code[def_position[source]];
+                if (definition->op != IR_PARAM) {
+                    definition->dest = dest;
+                    ssa_delete(instruction);
+                    def_stamp[dest] = b;
+                    def_position[dest] = def_position[source];
+                    touch_stamp[dest] = b;
+                    touch_position[dest] = (uint32_t)i;
+                    continue;
+                }
+            }
+
+            IrValue operands[2] = { instruction->a, instruction->b };
+            for (int k = 0; k < 2; k++) {
+                if (operands[k] == IR_NO_VALUE) continue;
+                touch_stamp[operands[k]] = b;
+                touch_position[operands[k]] = (uint32_t)i;
+            }
+            for (uint32_t k = 0; k < instruction->arg_count; k++) {
+                touch_stamp[instruction->args[k]] = b;
+                touch_position[instruction->args[k]] = (uint32_t)i;
+            }
+            if (dest != IR_NO_VALUE) {
+                touch_stamp[dest] = b;
+                touch_position[dest] = (uint32_t)i;
+                def_stamp[dest] = b;
+                def_position[dest] = (uint32_t)i;
+            }
+        }
+    }
+    ssa_compact(ssa);
+
+done:
+    free(uses);
+    free(defs);
+    free(def_position);
+    free(touch_position);
+    free(def_stamp);
+    free(touch_stamp);
+    return error;
+}
+
+// 出力の順序
+// 元のブロックは配列の順に、後から作ったブロックはplace_beforeのブロックの直前に置く
+typedef struct {
+    const SsaFunction* ssa;
+    uint32_t* first_before;    // 直前に置くブロックの鎖
+    uint32_t* last_before;
+    uint32_t* next_before;
+    uint32_t* order;
+    size_t count;
+} Layout;
+
+static void layout_block(Layout* layout, uint32_t b) {
+    for (uint32_t before = layout->first_before[b]; before != SSA_NO_BLOCK; before = layout->next_before[before]) {
+        layout_block(layout, before);
+    }
+    layout->order[layout->count++] = b;
+}
+
+static bool is_anchored(const SsaFunction* ssa, uint32_t b) {
+    uint32_t target = ssa->blocks[b].place_before;
+    return target != SSA_NO_BLOCK && target != b && !ssa->blocks[target].removed;
+}
+
+SlangError ssa_lower(SsaFunction* ssa) {
+    SlangError error = eliminate_phis(ssa);
+    if (error == SLANG_SUCCESS) error = coalesce_copies(ssa);
+    if (error != SLANG_SUCCESS) return error;
+
+    size_t n = ssa->block_count;
+    Layout layout;
+    layout.ssa = ssa;
+    layout.first_before = malloc(n * sizeof(uint32_t));
+    layout.last_before = malloc(n * sizeof(uint32_t));
+    layout.next_before = malloc(n * sizeof(uint32_t));
+    layout.order = malloc(n * sizeof(uint32_t));
+    layout.count = 0;
+    uint32_t* position = malloc(n * sizeof(uint32_t));
+    bool* targeted = calloc(n, sizeof(bool));
+    if (layout.first_before == NULL || layout.last_before == NULL || layout.next_before == NULL ||
+        layout.order == NULL || position == NULL || targeted == NULL) {
+        error = SLANG_ERROR_INTERNAL;
+        goto done;
+    }
+
+    for (uint32_t b = 0; b < n; b++) {
+        layout.first_before[b] = SSA_NO_BLOCK;
+        layout.last_before[b] = SSA_NO_BLOCK;
+        layout.next_before[b] = SSA_NO_BLOCK;
+    }
+    for (uint32_t b = 0; b < n; b++) {
+        if (ssa->blocks[b].removed || !is_anchored(ssa, b)) continue;
+        uint32_t target = ssa->blocks[b].place_before;
+        if (layout.last_before[target] == SSA_NO_BLOCK) {
+            layout.first_before[target] = b;
+        } else {
+            layout.next_before[layout.last_before[target]] = b;
+        }
+        layout.last_before[target] = b;
+    }
+    for (uint32_t b = 0; b < n; b++) {
+        if (!ssa->blocks[b].removed && !is_anchored(ssa, b)) layout_block(&layout, b);
+    }
+    for (uint32_t b = 0; b < n; b++) position[b] = UINT32_MAX;
+    for (size_t i = 0; i < layout.count; i++) position[layout.order[i]] = (uint32_t)i;
+
+    // 次に並ぶブロックへの分岐は省くので、実際に分岐先になるブロックにだけラベルを置く
+    size_t total = 0;
+    for (size_t i = 0; i < layout.count; i++) {
+        const SsaBlock* block = &ssa->blocks[layout.order[i]];
+        total += block->count + 2;
+        uint8_t op = block->count > 0 ? block->code[block->count - 1].op : IR_NOP;
+        if (op == IR_JUMP && position[block->successors[0]] != i + 1) targeted[block->successors[0]] = true;
+        if (op == IR_BRANCH_FALSE) {
+            targeted[block->successors[0]] = true;
+            if (position[block->successors[1]] != i + 1) targeted[block->successors[1]] = true;
+        }
+    }
+
+    IrInstruction* code = malloc((total ? total : 1) * sizeof(IrInstruction));
+    if (code == NULL) {
+        error = SLANG_ERROR_INTERNAL;
+        goto done;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < layout.count; i++) {
+        uint32_t b = layout.order[i];
+        SsaBlock* block = &ssa->blocks[b];
+        if (targeted[b]) {
+            clear_instruction(&code[count], IR_LABEL, IR_INT);
+            code[count++].imm.label = b;
+        }
+        for (size_t j = 0; j < block->count; j++) {
+            IrInstruction instruction = block->code[j];
+            if (instruction.op == IR_JUMP) {
+                if (position[block->successors[0]] == i + 1) continue;
+                instruction.imm.label = block->successors[0];
+            } else if (instruction.op == IR_BRANCH_FALSE) {
+                instruction.imm.label = block->successors[0];
+                code[count++] = instruction;
+                if (position[block->successors[1]] == i + 1) continue;
+                clear_instruction(&instruction, IR_JUMP, IR_INT);
+                instruction.imm.label = block->successors[1];
+            }
+            code[count++] = instruction;
+        }
+        // 命令（引数の配列を含む）は新しい命令列に移した
+        block->count = 0;
+    }
+
+    IrFunction* function = ssa->function;
+    for (size_t i = 0; i < function->count; i++) free(function->code[i].args);
+    free(function->code);
+    function->code = code;
+    function->count = count;
+    function->capacity = total ? total : 1;
+    function->label_count = (uint32_t)n;
+
+done:
+    free(layout.first_before);
+    free(layout.last_before);
+    free(layout.next_before);
+    free(layout.order);
+    free(position);
+    free(targeted);
+    return error;
+}
@@ -0,0 +1,133 @@
+#include "../include/symbol_table.h"
+#include "../include/intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SYMBOL_TABLE_INITIAL_CAPACITY 64
+#define SYMBOL_TABLE_INITIAL_SCOPES 8
+
+// 記号表の初期化
+void symbol_table_init(SymbolTable* table) {
+    memset(table, 0, sizeof(SymbolTable));
+}
+
+// 記号表の解放
+void symbol_table_free(SymbolTable* table) {
+    free(table->symbols);
+    free(table->keys);
+    free(table->heads);
+    free(table->scope_marks);
+    symbol_table_init(table);
+}
+
+// 名前の入っている（または入るべき）バケット
+static size_t symbol_table_find_bucket(const char* const* keys, size_t capacity, const char* name) {
+    size_t index = intern_hash(name) & (capacity - 1);
+    while (keys[index] != NULL && keys[index] != name) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return index;
+}
+
+// バケットの拡張（容量は常に2の冪、負荷率は1/2以下）
+static bool symbol_table_grow_buckets(SymbolTable* table) {
+    size_t new_capacity = table->bucket_capacity ? table->bucket_capacity * 2 : SYMBOL_TABLE_INITIAL_CAPACITY;
+    const char** keys = calloc(new_capacity, sizeof(const char*));
+    int32_t* heads = malloc(new_capacity * sizeof(int32_t));
+    if (keys == NULL || heads == NULL) {
+        free(keys);
+        free(heads);
+        return false;
+    }
+
+    for (size_t i = 0; i < table->bucket_capacity; i++) {
+        if (table->keys[i] == NULL) continue;
+
+        size_t index = symbol_table_find_bucket(keys, new_capacity, table->keys[i]);
+        keys[index] = table->keys[i];
+        heads[index] = table->heads[i];
+    }
+
+    // 束縛が覚えているバケットの番号を付け直す
+    for (size_t i = 0; i < table->count; i++) {
+        table->symbols[i].bucket = (uint32_t)symbol_table_find_bucket(keys, new_capacity, table->symbols[i].name);
+    }
+
+    free(table->keys);
+    free(table->heads);
+    table->keys = keys;
+    table->heads = heads;
+    table->bucket_capacity = new_capacity;
+    return true;
+}
+
+// スコープに入る
+bool symbol_table_push_scope(SymbolTable* table) {
+    if (table->depth == table->scope_capacity) {
+        size_t new_capacity = table->scope_capacity ? table->scope_capacity * 2 : SYMBOL_TABLE_INITIAL_SCOPES;
+        size_t* marks = realloc(table->scope_marks, new_capacity * sizeof(size_t));
+        if (marks == NULL) return false;
+        table->scope_marks = marks;
+        table->scope_capacity = new_capacity;
+    }
+    table->scope_marks[table->depth++] = table->count;
+    return true;
+}
+
+// スコープを抜ける（そのスコープの束縛を捨て、隠れていた束縛を戻す）
+void symbol_table_pop_scope(SymbolTable* table) {
+    if (table->depth == 0) return;
+
+    size_t mark = table->scope_marks[--table->depth];
+    while (table->count > mark) {
+        const Symbol* symbol = &table->symbols[--table->count];
+        table->heads[symbol->bucket] = symbol->shadowed;
+    }
+}
+
+// 束縛の追加
+bool symbol_table_define(SymbolTable* table, const char* name, uint32_t slot) {
+    if ((table->key_count + 1) * 2 > table->bucket_capacity && !symbol_table_grow_buckets(table)) {
+        return false;
+    }
+    if (table->count == table->capacity) {
+        size_t new_capacity = table->capacity ? table->capacity * 2 : SYMBOL_TABLE_INITIAL_CAPACITY;
+        Symbol* symbols = realloc(table->symbols, new_capacity * sizeof(Symbol));
+        if (symbols == NULL) return false;
+        table->symbols = symbols;
+        table->capacity = new_capacity;
+    }
+
+    size_t bucket = symbol_table_find_bucket(table->keys, table->bucket_capacity, name);
+    if (table->keys[bucket] == NULL) {
+        table->keys[bucket] = name;
+        table->heads[bucket] = SYMBOL_NONE;
+        table->key_count++;
+    }
+
+    Symbol* symbol = &table->symbols[table->count];
+    symbol->name = name;
+    symbol->slot = slot;
+    symbol->depth = (uint32_t)table->depth;
+    symbol->shadowed = table->heads[bucket];
+    symbol->bucket = (uint32_t)bucket;
+    table->heads[bucket] = (int32_t)table->count;
+    table->count++;
+    return true;
+}
+
+// 束縛の検索
+const Symbol* symbol_table_lookup(const SymbolTable* table, const char* name) {
+    if (table->bucket_capacity == 0) return NULL;
+
+    size_t bucket = symbol_table_find_bucket(table->keys, table->bucket_capacity, name);
+    if (table->keys[bucket] == NULL || table->heads[bucket] == SYMBOL_NONE) return NULL;
+    return &table->symbols[table->heads[bucket]];
+}
+
+// 現在のスコープ内の束縛の検索
+const Symbol* symbol_table_lookup_local(const SymbolTable* table, const char* name) {
+    const Symbol* symbol = symbol_table_lookup(table, name);
+    if (symbol == NULL || symbol->depth != table->depth) return NULL;
+    return symbol;
+}
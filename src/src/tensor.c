@@ -0,0 +1,667 @@
+#include "../include/tensor.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define TENSOR_TILE 256                 // 要素ごとの演算で一度に評価する要素数
+#define TENSOR_CHUNK (16 * TENSOR_TILE) // 並列に分けるときの区間（要素数）
+#define TENSOR_PARALLEL_MIN (1u << 15)  // これより要素の少ない演算は分けない
+
+// 行列積のブロック（KC×NCのBとMC×KCのAがL2に乗る大きさ）
+#define GEMM_MR 4
+#define GEMM_NR 4
+#define GEMM_KC 256
+#define GEMM_MC 64
+#define GEMM_NC 1024
+#define GEMM_PARALLEL_MIN (1u << 18)    // m*n*kがこれより小さい積は分けない
+
+// ---------------------------------------------------------------------------
+// 記憶域とビュー
+
+static size_t round_up(size_t value, size_t unit) {
+    return (value + unit - 1) / unit * unit;
+}
+
+static double* aligned_doubles(size_t count) {
+    size_t bytes = round_up(count ? count * sizeof(double) : 1, TENSOR_ALIGNMENT);
+    return aligned_alloc(TENSOR_ALIGNMENT, bytes);
+}
+
+static void retain(Tensor* out, const Tensor* source) {
+    *out = *source;
+    if (out->storage) out->storage->references++;
+}
+
+// テンソルの作成（要素は0で、最後の次元が連続する）
+SlangError tensor_create(Tensor* tensor, size_t rank, const size_t* shape) {
+    memset(tensor, 0, sizeof(Tensor));
+    if (rank > TENSOR_MAX_RANK) return SLANG_ERROR_RUNTIME;
+
+    size_t length = 1;
+    for (size_t i = 0; i < rank; i++) {
+        if (shape[i] != 0 && length > SIZE_MAX / sizeof(double) / shape[i]) return SLANG_ERROR_RUNTIME;
+        length *= shape[i];
+    }
+
+    TensorStorage* storage = malloc(sizeof(TensorStorage));
+    double* data = aligned_doubles(length);
+    if (storage == NULL || data == NULL) {
+        free(storage);
+        free(data);
+        return SLANG_ERROR_INTERNAL;
+    }
+    memset(data, 0, length * sizeof(double));
+    storage->data = data;
+    storage->length = length;
+    storage->references = 1;
+
+    tensor->storage = storage;
+    tensor->rank = rank;
+    ptrdiff_t stride = 1;
+    for (size_t i = rank; i-- > 0;) {
+        tensor->shape[i] = shape[i];
+        tensor->strides[i] = stride;
+        stride *= (ptrdiff_t)shape[i];
+    }
+    return SLANG_SUCCESS;
+}
+
+// 参照の解放
+void tensor_release(Tensor* tensor) {
+    if (tensor == NULL) return;
+    TensorStorage* storage = tensor->storage;
+    if (storage != NULL && --storage->references == 0) {
+        free(storage->data);
+        free(storage);
+    }
+    memset(tensor, 0, sizeof(Tensor));
+}
+
+SlangError tensor_slice(Tensor* out, const Tensor* source, size_t axis, size_t start, size_t stop, size_t step) {
+    if (axis >= source->rank || step == 0 || start > stop || stop > source->shape[axis]) return SLANG_ERROR_RUNTIME;
+    Tensor view = *source;
+    view.offset += start * (size_t)source->strides[axis];
+    view.shape[axis] = (stop - start + step - 1) / step;
+    view.strides[axis] *= (ptrdiff_t)step;
+    retain(out, &view);
+    return SLANG_SUCCESS;
+}
+
+SlangError tensor_transpose(Tensor* out, const Tensor* source, size_t axis_a, size_t axis_b) {
+    if (axis_a >= source->rank || axis_b >= source->rank) return SLANG_ERROR_RUNTIME;
+    Tensor view = *source;
+    view.shape[axis_a] = source->shape[axis_b];
+    view.shape[axis_b] = source->shape[axis_a];
+    view.strides[axis_a] = source->strides[axis_b];
+    view.strides[axis_b] = source->strides[axis_a];
+    retain(out, &view);
+    return SLANG_SUCCESS;
+}
+
+// 末尾の次元から揃え、大きさ1の次元と足りない次元はストライド0で拡大する
+SlangError tensor_broadcast(Tensor* out, const Tensor* source, size_t rank, const size_t* shape) {
+    if (rank > TENSOR_MAX_RANK || rank < source->rank) return SLANG_ERROR_RUNTIME;
+    Tensor view = *source;
+    view.rank = rank;
+    for (size_t i = 0; i < rank; i++) {
+        size_t from_end = rank - 1 - i;
+        view.shape[i] = shape[i];
+        view.strides[i] = 0;
+        if (from_end >= source->rank) continue;
+        size_t axis = source->rank - 1 - from_end;
+        if (source->shape[axis] == shape[i]) {
+            view.strides[i] = source->strides[axis];
+        } else if (source->shape[axis] != 1) {
+            return SLANG_ERROR_RUNTIME;
+        }
+    }
+    retain(out, &view);
+    return SLANG_SUCCESS;
+}
+
+// 連続したテンソルだけを組み替えられる（それ以外はtensor_copyで詰めてから）
+SlangError tensor_reshape(Tensor* out, const Tensor* source, size_t rank, const size_t* shape) {
+    if (rank > TENSOR_MAX_RANK || !tensor_is_contiguous(source)) return SLANG_ERROR_RUNTIME;
+    size_t length = 1;
+    for (size_t i = 0; i < rank; i++) length *= shape[i];
+    if (length != tensor_size(source)) return SLANG_ERROR_RUNTIME;
+
+    Tensor view = *source;
+    view.rank = rank;
+    ptrdiff_t stride = 1;
+    for (size_t i = rank; i-- > 0;) {
+        view.shape[i] = shape[i];
+        view.strides[i] = stride;
+        stride *= (ptrdiff_t)shape[i];
+    }
+    retain(out, &view);
+    return SLANG_SUCCESS;
+}
+
+size_t tensor_size(const Tensor* tensor) {
+    size_t length = 1;
+    for (size_t i = 0; i < tensor->rank; i++) length *= tensor->shape[i];
+    return length;
+}
+
+bool tensor_is_contiguous(const Tensor* tensor) {
+    ptrdiff_t expected = 1;
+    for (size_t i = tensor->rank; i-- > 0;) {
+        if (tensor->shape[i] == 1) continue;
+        if (tensor->strides[i] != expected) return false;
+        expected *= (ptrdiff_t)tensor->shape[i];
+    }
+    return true;
+}
+
+bool tensor_same_shape(const Tensor* a, const Tensor* b) {
+    if (a->rank != b->rank) return false;
+    for (size_t i = 0; i < a->rank; i++) {
+        if (a->shape[i] != b->shape[i]) return false;
+    }
+    return true;
+}
+
+double* tensor_at(const Tensor* tensor, const size_t* index) {
+    ptrdiff_t position = (ptrdiff_t)tensor->offset;
+    for (size_t i = 0; i < tensor->rank; i++) position += (ptrdiff_t)index[i] * tensor->strides[i];
+    return tensor->storage->data + position;
+}
+
+// ---------------------------------------------------------------------------
+// 行ごとの走査（最後の次元を行とし、それより前の次元をまとめて行番号にする）
+
+static size_t row_count(const Tensor* tensor) {
+    size_t rows = 1;
+    for (size_t i = 0; i + 1 < tensor->rank; i++) rows *= tensor->shape[i];
+    return rows;
+}
+
+static size_t row_length(const Tensor* tensor) {
+    return tensor->rank ? tensor->shape[tensor->rank - 1] : 1;
+}
+
+static ptrdiff_t row_stride(const Tensor* tensor) {
+    return tensor->rank ? tensor->strides[tensor->rank - 1] : 1;
+}
+
+static double* row_start(const Tensor* tensor, size_t row) {
+    ptrdiff_t position = (ptrdiff_t)tensor->offset;
+    for (size_t i = tensor->rank - (tensor->rank ? 1 : 0); i-- > 0;) {
+        position += (ptrdiff_t)(row % tensor->shape[i]) * tensor->strides[i];
+        row /= tensor->shape[i];
+    }
+    return tensor->storage->data + position;
+}
+
+SlangError tensor_fill(Tensor* tensor, double value) {
+    if (tensor->storage == NULL) return SLANG_ERROR_RUNTIME;
+    size_t rows = row_count(tensor), length = row_length(tensor);
+    ptrdiff_t stride = row_stride(tensor);
+    for (size_t r = 0; r < rows; r++) {
+        double* row = row_start(tensor, r);
+        for (size_t i = 0; i < length; i++) row[(ptrdiff_t)i * stride] = value;
+    }
+    return SLANG_SUCCESS;
+}
+
+// dstとsrcは重なってはならない（同じビューなら何もしない）
+SlangError tensor_copy(Tensor* dst, const Tensor* src) {
+    if (dst->storage == NULL || src->storage == NULL || !tensor_same_shape(dst, src)) return SLANG_ERROR_RUNTIME;
+    size_t rows = row_count(dst), length = row_length(dst);
+    ptrdiff_t to_stride = row_stride(dst), from_stride = row_stride(src);
+    for (size_t r = 0; r < rows; r++) {
+        double* to = row_start(dst, r);
+        const double* from = row_start(src, r);
+        if (to == from && to_stride == from_stride) continue;
+        if (to_stride == 1 && from_stride == 1) {
+            memcpy(to, from, length * sizeof(double));
+        } else {
+            for (size_t i = 0; i < length; i++) to[(ptrdiff_t)i * to_stride] = from[(ptrdiff_t)i * from_stride];
+        }
+    }
+    return SLANG_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// 要素ごとの演算
+// 行をTENSOR_TILE個ずつに分け、式の命令ごとにタイル全体を計算する。途中の値はスタック上の
+// タイル（L1に乗る）にだけ置き、連続した入力はコピーせずにそのまま読む。
+
+static const uint8_t tensor_op_pops[TENSOR_OP_COUNT] = {
+#define TENSOR_OP(name, pops, expression) pops,
+#include "../include/tensor_ops.def"
+#undef TENSOR_OP
+};
+
+static SlangError check_program(const TensorProgram* program, size_t input_count) {
+    size_t depth = 0;
+    for (size_t i = 0; i < program->count; i++) {
+        const TensorInstruction* instruction = &program->code[i];
+        if (instruction->op >= TENSOR_OP_COUNT) return SLANG_ERROR_RUNTIME;
+        if (instruction->op == TENSOR_OP_INPUT && instruction->input >= input_count) return SLANG_ERROR_RUNTIME;
+        size_t pops = tensor_op_pops[instruction->op];
+        if (depth < pops) return SLANG_ERROR_RUNTIME;
+        depth = depth - pops + 1;
+        if (depth > TENSOR_PROGRAM_MAX_STACK) return SLANG_ERROR_RUNTIME;
+    }
+    return depth == 1 ? SLANG_SUCCESS : SLANG_ERROR_RUNTIME;
+}
+
+typedef struct {
+    Tensor* out;
+    const TensorProgram* program;
+    const Tensor* inputs;
+    size_t chunks_per_row;
+    size_t length;
+} MapJob;
+
+static void evaluate_tile(const MapJob* job, size_t row, size_t column, size_t n) {
+    double tiles[TENSOR_PROGRAM_MAX_STACK][TENSOR_TILE];
+    const double* values[TENSOR_PROGRAM_MAX_STACK];
+    size_t depth = 0;
+
+    for (size_t k = 0; k < job->program->count; k++) {
+        const TensorInstruction* instruction = &job->program->code[k];
+        if (instruction->op == TENSOR_OP_INPUT) {
+            const Tensor* input = &job->inputs[instruction->input];
+            ptrdiff_t stride = row_stride(input);
+            const double* source = row_start(input, row) + (ptrdiff_t)column * stride;
+            if (stride == 1) {
+                values[depth] = source;
+            } else {
+                for (size_t i = 0; i < n; i++) tiles[depth][i] = source[(ptrdiff_t)i * stride];
+                values[depth] = tiles[depth];
+            }
+            depth++;
+            continue;
+        }
+        if (instruction->op == TENSOR_OP_CONST) {
+            for (size_t i = 0; i < n; i++) tiles[depth][i] = instruction->constant;
+            values[depth] = tiles[depth];
+            depth++;
+            continue;
+        }
+
+        size_t pops = tensor_op_pops[instruction->op];
+        const double* xs = values[depth - pops];
+        const double* ys = values[depth - 1];
+        double* result = tiles[depth - pops];
+        switch (instruction->op) {
+#define TENSOR_OP(name, pops, expression) \
+            case TENSOR_OP_##name: \
+                for (size_t i = 0; i < n; i++) { \
+                    double x = xs[i], y = ys[i]; \
+                    (void)x; (void)y; \
+                    result[i] = (expression); \
+                } \
+                break;
+#include "../include/tensor_ops.def"
+#undef TENSOR_OP
+            default:
+                break;
+        }
+        depth -= pops;
+        values[depth++] = result;
+    }
+
+    ptrdiff_t stride = row_stride(job->out);
+    double* target = row_start(job->out, row) + (ptrdiff_t)column * stride;
+    const double* result = values[0];
+    if (stride == 1) {
+        if (target != result) memmove(target, result, n * sizeof(double));
+    } else {
+        for (size_t i = 0; i < n; i++) target[(ptrdiff_t)i * stride] = result[i];
+    }
+}
+
+static void map_task(void* context, size_t begin, size_t end) {
+    const MapJob* job = context;
+    for (size_t item = begin; item < end; item++) {
+        size_t row = item / job->chunks_per_row;
+        size_t start = item % job->chunks_per_row * TENSOR_CHUNK;
+        size_t stop = job->length - start < TENSOR_CHUNK ? job->length : start + TENSOR_CHUNK;
+        for (size_t column = start; column < stop; column += TENSOR_TILE) {
+            evaluate_tile(job, row, column, stop - column < TENSOR_TILE ? stop - column : TENSOR_TILE);
+        }
+    }
+}
+
+// 形を確かめた後の本体
+static SlangError map_run(ThreadPool* pool, Tensor* out, const TensorProgram* program, const Tensor* inputs, size_t input_count) {
+    SlangError error = check_program(program, input_count);
+    if (error != SLANG_SUCCESS) return error;
+
+    MapJob job = { out, program, inputs, 0, row_length(out) };
+    size_t rows = row_count(out);
+    if (job.length == 0 || rows == 0) return SLANG_SUCCESS;
+    job.chunks_per_row = (job.length + TENSOR_CHUNK - 1) / TENSOR_CHUNK;
+    if (tensor_size(out) < TENSOR_PARALLEL_MIN) pool = NULL;
+    thread_pool_for(pool, rows * job.chunks_per_row, 1, map_task, &job);
+    return SLANG_SUCCESS;
+}
+
+SlangError tensor_map(ThreadPool* pool, Tensor* out, const TensorProgram* program, const Tensor* inputs, size_t input_count) {
+    if (out->storage == NULL) return SLANG_ERROR_RUNTIME;
+    for (size_t i = 0; i < input_count; i++) {
+        if (inputs[i].storage == NULL || !tensor_same_shape(out, &inputs[i])) return SLANG_ERROR_RUNTIME;
+    }
+    return map_run(pool, out, program, inputs, input_count);
+}
+
+// ---------------------------------------------------------------------------
+// 行列積
+// Goto/van de Geijnの方式。BのKC×NCのブロックをNR列ずつ、AのKC列分をMR行ずつのパネルに詰め、
+// MR×NRの小さなカーネルでCのタイルを計算する。詰めるときにストライドを読むので、転置したビューも
+// コピーなしで渡せる。Bのパネル・Aのパネル・Cのタイルの列ごとに分けて並列に処理する。
+
+typedef struct {
+    Tensor* c;
+    const Tensor* a;
+    const Tensor* b;
+    size_t m, n, k;
+    double* packed_a;          // round_up(m, MR) × KC
+    double* packed_b;          // KC × round_up(NC, NR)
+    size_t jc, nc, pc, kc;
+} GemmJob;
+
+static void pack_b_task(void* context, size_t begin, size_t end) {
+    const GemmJob* job = context;
+    const Tensor* b = job->b;
+    const double* base = b->storage->data + b->offset;
+    for (size_t panel = begin; panel < end; panel++) {
+        double* out = job->packed_b + panel * GEMM_NR * job->kc;
+        size_t column = job->jc + panel * GEMM_NR;
+        size_t width = job->jc + job->nc - column < GEMM_NR ? job->jc + job->nc - column : GEMM_NR;
+        for (size_t p = 0; p < job->kc; p++) {
+            const double* row = base + (ptrdiff_t)(job->pc + p) * b->strides[0] + (ptrdiff_t)column * b->strides[1];
+            for (size_t j = 0; j < GEMM_NR; j++) out[p * GEMM_NR + j] = j < width ? row[(ptrdiff_t)j * b->strides[1]] : 0.0;
+        }
+    }
+}
+
+static void pack_a_task(void* context, size_t begin, size_t end) {
+    const GemmJob* job = context;
+    const Tensor* a = job->a;
+    const double* base = a->storage->data + a->offset;
+    for (size_t panel = begin; panel < end; panel++) {
+        double* out = job->packed_a + panel * GEMM_MR * job->kc;
+        size_t row = panel * GEMM_MR;
+        size_t height = job->m - row < GEMM_MR ? job->m - row : GEMM_MR;
+        for (size_t p = 0; p < job->kc; p++) {
+            const double* column = base + (ptrdiff_t)row * a->strides[0] + (ptrdiff_t)(job->pc + p) * a->strides[1];
+            for (size_t i = 0; i < GEMM_MR; i++) out[p * GEMM_MR + i] = i < height ? column[(ptrdiff_t)i * a->strides[0]] : 0.0;
+        }
+    }
+}
+
+// tile[i][j] = Σp a[p][i] * b[p][j]
+static void gemm_kernel(size_t kc, const double* a, const double* b, double tile[GEMM_MR][GEMM_NR]) {
+#if defined(__SSE2__)
+    __m128d acc[GEMM_MR][2];
+    for (size_t i = 0; i < GEMM_MR; i++) acc[i][0] = acc[i][1] = _mm_setzero_pd();
+    for (size_t p = 0; p < kc; p++) {
+        __m128d b0 = _mm_load_pd(b + p * GEMM_NR);
+        __m128d b1 = _mm_load_pd(b + p * GEMM_NR + 2);
+        for (size_t i = 0; i < GEMM_MR; i++) {
+            __m128d x = _mm_set1_pd(a[p * GEMM_MR + i]);
+            acc[i][0] = _mm_add_pd(acc[i][0], _mm_mul_pd(x, b0));
+            acc[i][1] = _mm_add_pd(acc[i][1], _mm_mul_pd(x, b1));
+        }
+    }
+    for (size_t i = 0; i < GEMM_MR; i++) {
+        _mm_storeu_pd(&tile[i][0], acc[i][0]);
+        _mm_storeu_pd(&tile[i][2], acc[i][1]);
+    }
+#else
+    double acc[GEMM_MR][GEMM_NR] = {{0}};
+    for (size_t p = 0; p < kc; p++) {
+        for (size_t i = 0; i < GEMM_MR; i++) {
+            for (size_t j = 0; j < GEMM_NR; j++) acc[i][j] += a[p * GEMM_MR + i] * b[p * GEMM_NR + j];
+        }
+    }
+    memcpy(tile, acc, sizeof(acc));
+#endif
+}
+
+// MC行×NR列の帯ごとに計算する（item = 行のブロック × Bのパネル）
+static void compute_task(void* context, size_t begin, size_t end) {
+    const GemmJob* job = context;
+    Tensor* c = job->c;
+    double* base = c->storage->data + c->offset;
+    size_t panels = (job->nc + GEMM_NR - 1) / GEMM_NR;
+    double tile[GEMM_MR][GEMM_NR];
+
+    for (size_t item = begin; item < end; item++) {
+        size_t ic = item / panels * GEMM_MC;
+        size_t panel = item % panels;
+        size_t column = job->jc + panel * GEMM_NR;
+        size_t width = job->jc + job->nc - column < GEMM_NR ? job->jc + job->nc - column : GEMM_NR;
+        const double* b = job->packed_b + panel * GEMM_NR * job->kc;
+        size_t stop = job->m - ic < GEMM_MC ? job->m : ic + GEMM_MC;
+
+        for (size_t row = ic; row < stop; row += GEMM_MR) {
+            gemm_kernel(job->kc, job->packed_a + row * job->kc, b, tile);
+            size_t height = stop - row < GEMM_MR ? stop - row : GEMM_MR;
+            for (size_t i = 0; i < height; i++) {
+                double* out = base + (ptrdiff_t)(row + i) * c->strides[0] + (ptrdiff_t)column * c->strides[1];
+                for (size_t j = 0; j < width; j++) {
+                    double* target = out + (ptrdiff_t)j * c->strides[1];
+                    *target = job->pc == 0 ? tile[i][j] : *target + tile[i][j];
+                }
+            }
+        }
+    }
+}
+
+// 形を確かめた後の本体
+static SlangError matmul_run(ThreadPool* pool, Tensor* c, const Tensor* a, const Tensor* b) {
+    GemmJob job;
+    memset(&job, 0, sizeof(job));
+    job.c = c;
+    job.a = a;
+    job.b = b;
+    job.m = a->shape[0];
+    job.k = a->shape[1];
+    job.n = b->shape[1];
+    if (job.m == 0 || job.n == 0) return SLANG_SUCCESS;
+    if (job.k == 0) return tensor_fill(c, 0.0);
+
+    size_t kc_max = job.k < GEMM_KC ? job.k : GEMM_KC;
+    size_t nc_max = job.n < GEMM_NC ? job.n : GEMM_NC;
+    job.packed_a = aligned_doubles(round_up(job.m, GEMM_MR) * kc_max);
+    job.packed_b = aligned_doubles(kc_max * round_up(nc_max, GEMM_NR));
+    if (job.packed_a == NULL || job.packed_b == NULL) {
+        free(job.packed_a);
+        free(job.packed_b);
+        return SLANG_ERROR_INTERNAL;
+    }
+    if ((double)job.m * (double)job.n * (double)job.k < GEMM_PARALLEL_MIN) pool = NULL;
+
+    size_t row_blocks = (job.m + GEMM_MC - 1) / GEMM_MC;
+    for (job.jc = 0; job.jc < job.n; job.jc += GEMM_NC) {
+        job.nc = job.n - job.jc < GEMM_NC ? job.n - job.jc : GEMM_NC;
+        size_t panels = (job.nc + GEMM_NR - 1) / GEMM_NR;
+        for (job.pc = 0; job.pc < job.k; job.pc += GEMM_KC) {
+            job.kc = job.k - job.pc < GEMM_KC ? job.k - job.pc : GEMM_KC;
+            thread_pool_for(pool, panels, 8, pack_b_task, &job);
+            thread_pool_for(pool, (job.m + GEMM_MR - 1) / GEMM_MR, 8, pack_a_task, &job);
+            thread_pool_for(pool, row_blocks * panels, 4, compute_task, &job);
+        }
+    }
+
+    free(job.packed_a);
+    free(job.packed_b);
+    return SLANG_SUCCESS;
+}
+
+SlangError tensor_matmul(ThreadPool* pool, Tensor* c, const Tensor* a, const Tensor* b) {
+    if (a->storage == NULL || b->storage == NULL || c->storage == NULL) return SLANG_ERROR_RUNTIME;
+    if (a->rank != 2 || b->rank != 2 || c->rank != 2) return SLANG_ERROR_RUNTIME;
+    if (a->shape[1] != b->shape[0] || c->shape[0] != a->shape[0] || c->shape[1] != b->shape[1]) return SLANG_ERROR_RUNTIME;
+    if (c->storage == a->storage || c->storage == b->storage) return SLANG_ERROR_RUNTIME;
+    return matmul_run(pool, c, a, b);
+}
+
+// ---------------------------------------------------------------------------
+// 集約
+// 要素の並びをTENSOR_CHUNK個ずつ（行をまたがない）に固定して区切り、区間ごとの部分和を
+// 複数の独立した累積（SSE2なら2要素のレジスタ4本）で求めてから、区間の順に足し合わせる。
+
+typedef struct {
+    const Tensor* a;
+    const Tensor* b;           // 内積のときだけ
+    TensorReduction kind;
+    size_t chunks_per_row;
+    size_t length;
+    double* partials;
+} ReduceJob;
+
+static double identity(TensorReduction kind) {
+    switch (kind) {
+        case TENSOR_REDUCE_MIN: return INFINITY;
+        case TENSOR_REDUCE_MAX: return -INFINITY;
+        default:                return 0.0;
+    }
+}
+
+static double combine(TensorReduction kind, double x, double y) {
+    switch (kind) {
+        case TENSOR_REDUCE_MIN: return y < x ? y : x;
+        case TENSOR_REDUCE_MAX: return y > x ? y : x;
+        default:                return x + y;
+    }
+}
+
+#define REDUCE_LANES 8
+
+static double reduce_contiguous(TensorReduction kind, const double* x, const double* y, size_t n) {
+    size_t i = 0;
+    double lanes[REDUCE_LANES];
+#if defined(__SSE2__)
+    __m128d acc[REDUCE_LANES / 2];
+    for (size_t l = 0; l < REDUCE_LANES / 2; l++) acc[l] = _mm_set1_pd(identity(kind));
+    for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+        for (size_t l = 0; l < REDUCE_LANES / 2; l++) {
+            __m128d v = _mm_loadu_pd(x + i + 2 * l);
+            if (y != NULL) v = _mm_mul_pd(v, _mm_loadu_pd(y + i + 2 * l));
+            switch (kind) {
+                case TENSOR_REDUCE_MIN: acc[l] = _mm_min_pd(v, acc[l]); break;
+                case TENSOR_REDUCE_MAX: acc[l] = _mm_max_pd(v, acc[l]); break;
+                default:                acc[l] = _mm_add_pd(acc[l], v); break;
+            }
+        }
+    }
+    for (size_t l = 0; l < REDUCE_LANES / 2; l++) _mm_storeu_pd(&lanes[2 * l], acc[l]);
+#else
+    for (size_t l = 0; l < REDUCE_LANES; l++) lanes[l] = identity(kind);
+    for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+        for (size_t l = 0; l < REDUCE_LANES; l++) {
+            double v = y != NULL ? x[i + l] * y[i + l] : x[i + l];
+            lanes[l] = combine(kind, lanes[l], v);
+        }
+    }
+#endif
+    for (size_t width = REDUCE_LANES / 2; width > 0; width /= 2) {
+        for (size_t l = 0; l < width; l++) lanes[l] = combine(kind, lanes[l], lanes[l + width]);
+    }
+    double result = lanes[0];
+    for (; i < n; i++) result = combine(kind, result, y != NULL ? x[i] * y[i] : x[i]);
+    return result;
+}
+
+static double reduce_strided(TensorReduction kind, const double* x, ptrdiff_t x_stride, const double* y, ptrdiff_t y_stride, size_t n) {
+    double lanes[REDUCE_LANES];
+    for (size_t l = 0; l < REDUCE_LANES; l++) lanes[l] = identity(kind);
+    size_t i = 0;
+    for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+        for (size_t l = 0; l < REDUCE_LANES; l++) {
+            double v = x[(ptrdiff_t)(i + l) * x_stride];
+            if (y != NULL) v *= y[(ptrdiff_t)(i + l) * y_stride];
+            lanes[l] = combine(kind, lanes[l], v);
+        }
+    }
+    for (size_t width = REDUCE_LANES / 2; width > 0; width /= 2) {
+        for (size_t l = 0; l < width; l++) lanes[l] = combine(kind, lanes[l], lanes[l + width]);
+    }
+    double result = lanes[0];
+    for (; i < n; i++) {
+        double v = x[(ptrdiff_t)i * x_stride];
+        if (y != NULL) v *= y[(ptrdiff_t)i * y_stride];
+        result = combine(kind, result, v);
+    }
+    return result;
+}
+
+static void reduce_task(void* context, size_t begin, size_t end) {
+    const ReduceJob* job = context;
+    for (size_t item = begin; item < end; item++) {
+        size_t row = item / job->chunks_per_row;
+        size_t start = item % job->chunks_per_row * TENSOR_CHUNK;
+        size_t n = job->length - start < TENSOR_CHUNK ? job->length - start : TENSOR_CHUNK;
+        ptrdiff_t x_stride = row_stride(job->a);
+        const double* x = row_start(job->a, row) + (ptrdiff_t)start * x_stride;
+        ptrdiff_t y_stride = job->b ? row_stride(job->b) : 1;
+        const double* y = job->b ? row_start(job->b, row) + (ptrdiff_t)start * y_stride : NULL;
+        job->partials[item] = x_stride == 1 && y_stride == 1
+            ? reduce_contiguous(job->kind, x, y, n)
+            : reduce_strided(job->kind, x, x_stride, y, y_stride, n);
+    }
+}
+
+// 集約は要素の順序によらないので、aのストライドの小さい次元が内側になるように並べ替える
+static void order_axes(Tensor* a, Tensor* b) {
+    for (size_t i = 1; i < a->rank; i++) {
+        for (size_t j = i; j > 0 && labs(a->strides[j - 1]) < labs(a->strides[j]); j--) {
+            size_t shape = a->shape[j];
+            ptrdiff_t stride = a->strides[j];
+            a->shape[j] = a->shape[j - 1];
+            a->strides[j] = a->strides[j - 1];
+            a->shape[j - 1] = shape;
+            a->strides[j - 1] = stride;
+            if (b == NULL) continue;
+            stride = b->strides[j];
+            b->shape[j] = b->shape[j - 1];
+            b->strides[j] = b->strides[j - 1];
+            b->shape[j - 1] = shape;
+            b->strides[j - 1] = stride;
+        }
+    }
+}
+
+static SlangError run_reduce(ThreadPool* pool, const Tensor* a_view, const Tensor* b_view, TensorReduction kind, double* result) {
+    Tensor a = *a_view, b;
+    if (b_view != NULL) b = *b_view;
+    order_axes(&a, b_view ? &b : NULL);
+
+    ReduceJob job = { &a, b_view ? &b : NULL, kind, 0, row_length(&a), NULL };
+    size_t rows = row_count(&a);
+    *result = identity(kind);
+    if (rows == 0 || job.length == 0) return SLANG_SUCCESS;
+
+    job.chunks_per_row = (job.length + TENSOR_CHUNK - 1) / TENSOR_CHUNK;
+    size_t items = rows * job.chunks_per_row;
+    job.partials = malloc(items * sizeof(double));
+    if (job.partials == NULL) return SLANG_ERROR_INTERNAL;
+    if (tensor_size(&a) < TENSOR_PARALLEL_MIN) pool = NULL;
+    thread_pool_for(pool, items, 1, reduce_task, &job);
+
+    double total = identity(kind);
+    for (size_t i = 0; i < items; i++) total = combine(kind, total, job.partials[i]);
+    free(job.partials);
+    *result = total;
+    return SLANG_SUCCESS;
+}
+
+SlangError tensor_reduce(ThreadPool* pool, const Tensor* tensor, TensorReduction kind, double* result) {
+    if (tensor->storage == NULL) return SLANG_ERROR_RUNTIME;
+    return run_reduce(pool, tensor, NULL, kind, result);
+}
+
+SlangError tensor_dot(ThreadPool* pool, const Tensor* a, const Tensor* b, double* result) {
+    if (a->storage == NULL || b->storage == NULL || !tensor_same_shape(a, b)) return SLANG_ERROR_RUNTIME;
+    return run_reduce(pool, a, b, TENSOR_REDUCE_SUM, result);
+}
@@ -0,0 +1,300 @@
+#include "../include/thread_pool.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define THREAD_POOL_DEQUE_INITIAL_CAPACITY 64
+
+typedef struct {
+    ThreadPoolJob job;
+    void* context;
+    ThreadPoolGroup* group;
+} PoolJob;
+
+// 両端キュー（容量は常に2の冪のリングバッファ）
+// 持ち主はtailの側で積んで取り、他のスレッドはheadの側から盗む
+typedef struct {
+    pthread_mutex_t lock;
+    PoolJob* jobs;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} JobDeque;
+
+struct ThreadPool {
+    pthread_t* workers;
+    size_t worker_count;
+    JobDeque* deques;          // ワーカーごと（worker_count番目はプールの外のスレッドが投入した仕事）
+    size_t deque_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;       // 新しい仕事か、グループの終わりか、終了
+    size_t sleeping;           // wakeを待っているスレッドの数
+    bool stopping;
+    atomic_size_t queued;      // キューに積まれてまだ誰も取っていない仕事の数
+};
+
+// このスレッドが属するプールと、そのワーカーの番号
+static _Thread_local ThreadPool* current_pool = NULL;
+static _Thread_local size_t current_worker = 0;
+
+static bool deque_init(JobDeque* deque) {
+    deque->jobs = malloc(THREAD_POOL_DEQUE_INITIAL_CAPACITY * sizeof(PoolJob));
+    if (deque->jobs == NULL) return false;
+    deque->head = 0;
+    deque->tail = 0;
+    deque->capacity = THREAD_POOL_DEQUE_INITIAL_CAPACITY;
+    pthread_mutex_init(&deque->lock, NULL);
+    return true;
+}
+
+static void deque_free(JobDeque* deque) {
+    pthread_mutex_destroy(&deque->lock);
+    free(deque->jobs);
+}
+
+static bool deque_push(JobDeque* deque, PoolJob job) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail - deque->head == deque->capacity) {
+        PoolJob* jobs = malloc(deque->capacity * 2 * sizeof(PoolJob));
+        if (jobs == NULL) {
+            pthread_mutex_unlock(&deque->lock);
+            return false;
+        }
+        for (size_t i = deque->head; i != deque->tail; i++) {
+            jobs[(i - deque->head)] = deque->jobs[i & (deque->capacity - 1)];
+        }
+        free(deque->jobs);
+        deque->jobs = jobs;
+        deque->tail -= deque->head;
+        deque->head = 0;
+        deque->capacity *= 2;
+    }
+    deque->jobs[deque->tail++ & (deque->capacity - 1)] = job;
+    pthread_mutex_unlock(&deque->lock);
+    return true;
+}
+
+// lifoなら末尾（持ち主）から、そうでなければ先頭（盗む側）から取る
+static bool deque_take(ThreadPool* pool, JobDeque* deque, bool lifo, PoolJob* job) {
+    pthread_mutex_lock(&deque->lock);
+    bool taken = deque->head != deque->tail;
+    if (taken) {
+        *job = lifo ? deque->jobs[--deque->tail & (deque->capacity - 1)]
+                    : deque->jobs[deque->head++ & (deque->capacity - 1)];
+        atomic_fetch_sub_explicit(&pool->queued, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return taken;
+}
+
+// 自分のキュー、外から投入された仕事、他のワーカーのキューの順に探す
+static bool take_job(ThreadPool* pool, PoolJob* job) {
+    if (atomic_load_explicit(&pool->queued, memory_order_relaxed) == 0) return false;
+
+    size_t self = current_pool == pool ? current_worker : pool->worker_count;
+    if (self < pool->worker_count && deque_take(pool, &pool->deques[self], true, job)) return true;
+    if (deque_take(pool, &pool->deques[pool->worker_count], false, job)) return true;
+    for (size_t i = 1; i <= pool->worker_count; i++) {
+        size_t victim = (self + i) % pool->worker_count;
+        if (victim != self && deque_take(pool, &pool->deques[victim], false, job)) return true;
+    }
+    return false;
+}
+
+static void run_job(ThreadPool* pool, PoolJob job) {
+    job.job(job.context);
+    if (job.group != NULL && atomic_fetch_sub_explicit(&job.group->pending, 1, memory_order_acq_rel) == 1) {
+        if (pool == NULL) return;
+        pthread_mutex_lock(&pool->lock);
+        if (pool->sleeping > 0) pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+typedef struct {
+    ThreadPool* pool;
+    size_t index;
+} WorkerStart;
+
+static void* worker_main(void* argument) {
+    WorkerStart* start = argument;
+    ThreadPool* pool = start->pool;
+    current_pool = pool;
+    current_worker = start->index;
+    free(start);
+
+    for (;;) {
+        PoolJob job;
+        if (take_job(pool, &job)) {
+            run_job(pool, job);
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stopping && atomic_load_explicit(&pool->queued, memory_order_relaxed) == 0) {
+            pool->sleeping++;
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            pool->sleeping--;
+        }
+        bool stopping = pool->stopping;
+        pthread_mutex_unlock(&pool->lock);
+        if (stopping) break;
+    }
+    return NULL;
+}
+
+// スレッドプールの作成
+ThreadPool* thread_pool_create(size_t threads) {
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (size_t)online : 1;
+    }
+
+    ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+    if (pool == NULL) return NULL;
+    pool->workers = calloc(threads, sizeof(pthread_t));
+    pool->deques = calloc(threads, sizeof(JobDeque));
+    if (pool->workers == NULL || pool->deques == NULL) {
+        free(pool->deques);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    // 呼び出し元も処理するので、ワーカーは1つ少なく起動する（キューは外から投入する分を足して同じ数）
+    for (size_t i = 0; i < threads; i++) {
+        if (!deque_init(&pool->deques[i])) {
+            while (i-- > 0) deque_free(&pool->deques[i]);
+            free(pool->deques);
+            free(pool->workers);
+            free(pool);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    atomic_init(&pool->queued, 0);
+
+    // ワーカーはキューの数を見るので、先に数を決めてから起動する（1つでも起動できなければ使わない）
+    pool->deque_count = threads;
+    pool->worker_count = threads - 1;
+    for (size_t i = 0; i < pool->worker_count; i++) {
+        WorkerStart* start = malloc(sizeof(WorkerStart));
+        if (start != NULL) *start = (WorkerStart){ pool, i };
+        if (start == NULL || pthread_create(&pool->workers[i], NULL, worker_main, start) != 0) {
+            free(start);
+            pthread_mutex_lock(&pool->lock);
+            pool->stopping = true;
+            pthread_cond_broadcast(&pool->wake);
+            pthread_mutex_unlock(&pool->lock);
+            for (size_t j = 0; j < i; j++) pthread_join(pool->workers[j], NULL);
+            pool->stopping = false;
+            pool->worker_count = 0;
+            break;
+        }
+    }
+    return pool;
+}
+
+// スレッドプールの破棄（投入した仕事はすべて待ち終えていること）
+void thread_pool_destroy(ThreadPool* pool) {
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->worker_count; i++) pthread_join(pool->workers[i], NULL);
+
+    for (size_t i = 0; i < pool->deque_count; i++) deque_free(&pool->deques[i]);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+size_t thread_pool_size(const ThreadPool* pool) {
+    return pool ? pool->worker_count + 1 : 1;
+}
+
+void thread_pool_group_init(ThreadPoolGroup* group) {
+    atomic_init(&group->pending, 0);
+}
+
+void thread_pool_spawn(ThreadPool* pool, ThreadPoolGroup* group, ThreadPoolJob job, void* context) {
+    PoolJob entry = { job, context, group };
+    if (group != NULL) atomic_fetch_add_explicit(&group->pending, 1, memory_order_relaxed);
+
+    // ワーカーがなければ（キューに積めなければ）その場で処理する
+    size_t target = pool && current_pool == pool ? current_worker : pool ? pool->worker_count : 0;
+    if (pool == NULL || pool->worker_count == 0 || !deque_push(&pool->deques[target], entry)) {
+        run_job(pool, entry);
+        return;
+    }
+
+    atomic_fetch_add_explicit(&pool->queued, 1, memory_order_relaxed);
+    pthread_mutex_lock(&pool->lock);
+    if (pool->sleeping > 0) pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(ThreadPool* pool, ThreadPoolGroup* group) {
+    while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0) {
+        PoolJob job;
+        if (pool != NULL && take_job(pool, &job)) {
+            run_job(pool, job);
+            continue;
+        }
+        if (pool == NULL) break;
+
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0 &&
+               atomic_load_explicit(&pool->queued, memory_order_relaxed) == 0) {
+            pool->sleeping++;
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            pool->sleeping--;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// thread_pool_forの状態（呼び出し元のスタックに置く）
+typedef struct {
+    ThreadPoolTask task;
+    void* context;
+    size_t count;
+    size_t grain;
+    atomic_size_t next;        // まだ誰も取っていない最初の位置
+} ForState;
+
+// 区間を取り合って処理する
+static void run_ranges(void* argument) {
+    ForState* state = argument;
+    for (;;) {
+        size_t begin = atomic_fetch_add_explicit(&state->next, state->grain, memory_order_relaxed);
+        if (begin >= state->count) return;
+        size_t end = state->count - begin < state->grain ? state->count : begin + state->grain;
+        state->task(state->context, begin, end);
+    }
+}
+
+void thread_pool_for(ThreadPool* pool, size_t count, size_t grain, ThreadPoolTask task, void* context) {
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+
+    // 区間が1つしかないとき、ワーカーがないときは呼び出し元で順に処理する
+    size_t ranges = (count - 1) / grain + 1;
+    if (pool == NULL || pool->worker_count == 0 || ranges == 1) {
+        for (size_t begin = 0; begin < count; begin += grain) {
+            task(context, begin, count - begin < grain ? count : begin + grain);
+        }
+        return;
+    }
+
+    // 手伝いの仕事を区間の数より多くは積まない（遅れて始まった手伝いは何もせずに終わる）
+    ForState state = { task, context, count, grain, 0 };
+    ThreadPoolGroup group;
+    thread_pool_group_init(&group);
+    size_t helpers = ranges - 1 < pool->worker_count ? ranges - 1 : pool->worker_count;
+    for (size_t i = 0; i < helpers; i++) thread_pool_spawn(pool, &group, run_ranges, &state);
+    run_ranges(&state);
+    thread_pool_wait(pool, &group);
+}
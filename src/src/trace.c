@@ -0,0 +1,190 @@
+#include "../include/trace.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// スレッドの番号はプロセスで通しに振る（トレースの表示で行を分けるだけ）
+static atomic_uint next_thread = 1;
+static _Thread_local uint32_t current_thread = 0;
+
+static uint32_t thread_number(void) {
+    if (current_thread == 0) current_thread = atomic_fetch_add_explicit(&next_thread, 1, memory_order_relaxed);
+    return current_thread;
+}
+
+uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+Trace* trace_create(void) {
+    Trace* trace = calloc(1, sizeof(Trace));
+    if (trace == NULL) return NULL;
+    if (pthread_mutex_init(&trace->lock, NULL) != 0) {
+        free(trace);
+        return NULL;
+    }
+    trace->origin = trace_now();
+    return trace;
+}
+
+void trace_destroy(Trace* trace) {
+    if (trace == NULL) return;
+    for (size_t i = 0; i < trace->event_count; i++) free((char*)trace->events[i].unit);
+    free(trace->events);
+    pthread_mutex_destroy(&trace->lock);
+    free(trace);
+}
+
+void trace_add(Trace* trace, const char* category, const char* name, const char* unit, uint64_t start,
+               uint64_t end, uint64_t bytes, uint64_t items) {
+    if (trace == NULL) return;
+    // 関数の名前などはコード生成と一緒に消えるので写しておく
+    char* copy = NULL;
+    if (unit != NULL && (copy = malloc(strlen(unit) + 1)) != NULL) strcpy(copy, unit);
+    TraceEvent event = {
+        category, name, copy, start > trace->origin ? start - trace->origin : 0, end > start ? end - start : 0,
+        thread_number(), bytes, items,
+    };
+
+    pthread_mutex_lock(&trace->lock);
+    if (trace->event_count == trace->event_capacity) {
+        size_t capacity = trace->event_capacity ? trace->event_capacity * 2 : 256;
+        TraceEvent* grown = realloc(trace->events, capacity * sizeof(TraceEvent));
+        if (grown == NULL) {
+            trace->failed = true;
+            pthread_mutex_unlock(&trace->lock);
+            free(copy);
+            return;
+        }
+        trace->events = grown;
+        trace->event_capacity = capacity;
+    }
+    trace->events[trace->event_count++] = event;
+    pthread_mutex_unlock(&trace->lock);
+}
+
+size_t trace_peak_rss(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (size_t)usage.ru_maxrss;    // Linuxではキロバイト
+}
+
+// ---------------------------------------------------------------------------
+// 報告
+
+typedef struct {
+    const char* category;
+    const char* name;
+    uint64_t first;            // 最初の区間の開始
+    size_t count;
+    uint64_t duration;
+    uint64_t bytes;
+    uint64_t items;
+} TraceTotal;
+
+void trace_report(const Trace* trace, FILE* out) {
+    // 名前の種類は段階とパスの数くらいしかないので、線形に探す
+    TraceTotal* totals = malloc((trace->event_count ? trace->event_count : 1) * sizeof(TraceTotal));
+    if (totals == NULL) return;
+    size_t total_count = 0;
+    uint64_t wall = trace_now() - trace->origin;
+    for (size_t i = 0; i < trace->event_count; i++) {
+        const TraceEvent* event = &trace->events[i];
+        size_t t = 0;
+        while (t < total_count && (totals[t].name != event->name && strcmp(totals[t].name, event->name) != 0)) t++;
+        if (t == total_count) {
+            totals[total_count++] = (TraceTotal){ event->category, event->name, event->start, 0, 0, 0, 0 };
+        }
+        TraceTotal* total = &totals[t];
+        if (event->start < total->first) total->first = event->start;
+        total->count++;
+        total->duration += event->duration;
+        total->bytes += event->bytes;
+        total->items += event->items;
+    }
+    // 最初に始まった順（段階はパイプラインの順、パスは走らせる順になる）
+    for (size_t i = 1; i < total_count; i++) {
+        TraceTotal moved = totals[i];
+        size_t j = i;
+        for (; j > 0 && totals[j - 1].first > moved.first; j--) totals[j] = totals[j - 1];
+        totals[j] = moved;
+    }
+
+    // 時間はスレッドをまたいで足した区間の長さなので、割合は同じ種類の合計に対して求める
+    // （壁時計の時間で割ると、並列に走れば100%を超える。パスはコード生成の段階の内側なので種類ごとに分ける）
+    uint64_t phase_time = 0;
+    uint64_t pass_time = 0;
+    for (size_t t = 0; t < total_count; t++) {
+        if (strcmp(totals[t].category, "phase") == 0) phase_time += totals[t].duration;
+        else pass_time += totals[t].duration;
+    }
+
+    fprintf(out, "%-6s %-12s %6s %13s %8s %12s %12s %14s\n", "kind", "name", "count", "thread (ms)", "% kind",
+            "bytes", "items", "items/s");
+    for (size_t t = 0; t < total_count; t++) {
+        const TraceTotal* total = &totals[t];
+        double seconds = (double)total->duration * 1e-9;
+        uint64_t kind_time = strcmp(total->category, "phase") == 0 ? phase_time : pass_time;
+        fprintf(out, "%-6s %-12s %6zu %13.3f %7.1f%% %12" PRIu64 " %12" PRIu64, total->category, total->name,
+                total->count, seconds * 1e3, kind_time ? 100.0 * (double)total->duration / (double)kind_time : 0.0,
+                total->bytes, total->items);
+        if (total->items != 0 && seconds > 0.0) {
+            fprintf(out, " %14.0f\n", (double)total->items / seconds);
+        } else {
+            fprintf(out, " %14s\n", "-");
+        }
+    }
+    // 段階を並列に走らせれば、段階のスレッド時間の合計は壁時計の時間を超える
+    fprintf(out, "wall %.3f ms, phase thread time %.3f ms, peak RSS %zu KB%s\n", (double)wall * 1e-6,
+            (double)phase_time * 1e-6, trace_peak_rss(), trace->failed ? " (some events were dropped)" : "");
+    free(totals);
+}
+
+static void write_json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*)text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', out);
+            fputc(*p, out);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+SlangError trace_write_json(const Trace* trace, const char* path) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) return SLANG_ERROR_IO;
+
+    // 時刻はマイクロ秒
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"slangc\"}}");
+    uint64_t last = 0;
+    for (size_t i = 0; i < trace->event_count; i++) {
+        const TraceEvent* event = &trace->events[i];
+        fprintf(out, ",\n{\"name\":");
+        write_json_string(out, event->name);
+        fprintf(out, ",\"cat\":");
+        write_json_string(out, event->category);
+        fprintf(out, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%" PRIu32 ",\"args\":{",
+                (double)event->start * 1e-3, (double)event->duration * 1e-3, event->thread);
+        if (event->unit != NULL) {
+            fprintf(out, "\"unit\":");
+            write_json_string(out, event->unit);
+            fputc(',', out);
+        }
+        fprintf(out, "\"bytes\":%" PRIu64 ",\"items\":%" PRIu64 "}}", event->bytes, event->items);
+        if (event->start + event->duration > last) last = event->start + event->duration;
+    }
+    fprintf(out, ",\n{\"name\":\"peak RSS\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"KB\":%zu}}\n]}\n",
+            (double)last * 1e-3, trace_peak_rss());
+
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok ? SLANG_SUCCESS : SLANG_ERROR_IO;
+}
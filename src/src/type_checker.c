@@ -0,0 +1,1087 @@
+#include "../include/type_checker.h"
+#include "../include/intern.h"
+#include "../include/monomorph.h"
+#include "../include/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TYPE_CHECKER_INITIAL_CAPACITY 16
+
+// 容量を倍にしながら配列を伸ばす
+static bool grow_array(void** data, size_t* capacity, size_t needed, size_t element_size) {
+    if (needed <= *capacity) return true;
+
+    size_t new_capacity = *capacity ? *capacity : TYPE_CHECKER_INITIAL_CAPACITY;
+    while (new_capacity < needed) new_capacity *= 2;
+
+    void* new_data = realloc(*data, new_capacity * element_size);
+    if (new_data == NULL) return false;
+    *data = new_data;
+    *capacity = new_capacity;
+    return true;
+}
+
+// エラーをnodeの位置にし、nameをメッセージに添える名前にする
+static SlangError check_error_named(TypeChecker* checker, const ASTNode* node, const char* name, const char* message) {
+    checker->error = message;
+    checker->error_site.name = name;
+    checker->error_site.line = node ? node->line : 0;
+    checker->error_site.column = node ? node->column : 0;
+    return SLANG_ERROR_TYPE;
+}
+
+// 名前はノードの名前（return文なら検査中の関数の名前）
+static SlangError check_error(TypeChecker* checker, const ASTNode* node, const char* message) {
+    const char* name = ast_node_name(node);
+    if (name == NULL && node != NULL && node->type == NODE_RETURN_STATEMENT && checker->current != NULL) {
+        name = checker->current->name;
+    }
+    return check_error_named(checker, node, name, message);
+}
+
+// 型の規則（NULLは実行時に決まる型で、何とでも合う）
+
+static bool is_numeric(const Type* type) {
+    return type->kind == TYPE_INTEGER || type->kind == TYPE_FLOAT;
+}
+
+// ベクトル・行列・四元数（要素はfloat。コード生成は値を領域へのポインタで運ぶので、型は静的に決まっていなければならない）
+static bool is_math(const Type* type) {
+    return type != NULL && (type->kind == TYPE_VECTOR || type->kind == TYPE_MATRIX || type->kind == TYPE_QUATERNION);
+}
+
+static bool is_assignable(const Type* target, const Type* value) {
+    if (target == value) return true;
+    if (is_math(target) || is_math(value)) return false;
+    if (target == NULL || value == NULL) return true;
+    return target->kind == TYPE_FLOAT && value->kind == TYPE_INTEGER;
+}
+
+// 注釈の型を型の表の型にする
+static const Type* annotation(const Type* type) {
+    return type ? type_canonical(type) : NULL;
+}
+
+// 注釈の型（汎用関数の共有の本体では、型引数は実行時に決まる型）
+static const Type* declared_type(const TypeChecker* checker, const Type* type) {
+    const Type* canonical = annotation(type);
+    for (size_t i = 0; i < checker->type_parameter_count; i++) {
+        if (canonical == checker->type_parameters[i]) return NULL;
+    }
+    return canonical;
+}
+
+// 汎用関数の型引数を見えるようにする（汎用関数でなければ何もしない）
+static SlangError bind_type_parameters(TypeChecker* checker, const ASTNode* node) {
+    const Function* function = &node->data.function;
+    if (function->type_parameter_count > TYPE_CHECKER_MAX_TYPE_PARAMETERS) {
+        return check_error(checker, node, "too many type parameters");
+    }
+    for (size_t i = 0; i < function->type_parameter_count; i++) {
+        checker->type_parameters[i] = type_named_of(function->type_parameters[i]);
+        if (checker->type_parameters[i] == NULL) return SLANG_ERROR_INTERNAL;
+    }
+    checker->type_parameter_count = function->type_parameter_count;
+    return SLANG_SUCCESS;
+}
+
+// 演算子の分類
+typedef enum {
+    OPERATOR_ARITHMETIC,   // + - * /
+    OPERATOR_MODULO,
+    OPERATOR_EQUALITY,     // == !=
+    OPERATOR_ORDER,        // < <= > >=
+    OPERATOR_LOGICAL,      // && ||
+    OPERATOR_UNKNOWN
+} OperatorClass;
+
+static OperatorClass classify_binary(const char* op) {
+    switch (op[0]) {
+        case '+': case '-': case '*': case '/':
+            return op[1] == '\0' ? OPERATOR_ARITHMETIC : OPERATOR_UNKNOWN;
+        case '%':
+            return op[1] == '\0' ? OPERATOR_MODULO : OPERATOR_UNKNOWN;
+        case '=': case '!':
+            return op[1] == '=' && op[2] == '\0' ? OPERATOR_EQUALITY : OPERATOR_UNKNOWN;
+        case '<': case '>':
+            return op[1] == '\0' || (op[1] == '=' && op[2] == '\0') ? OPERATOR_ORDER : OPERATOR_UNKNOWN;
+        case '&': case '|':
+            return op[1] == op[0] && op[2] == '\0' ? OPERATOR_LOGICAL : OPERATOR_UNKNOWN;
+        default:
+            return OPERATOR_UNKNOWN;
+    }
+}
+
+// 表への登録
+
+static bool define_global(TypeChecker* checker, const char* name, const Type* type) {
+    const Symbol* symbol = symbol_table_lookup(&checker->globals, name);
+    if (symbol != NULL) {
+        checker->global_bindings[symbol->slot].type = type;
+        return true;
+    }
+    if (!grow_array((void**)&checker->global_bindings, &checker->global_capacity,
+                    checker->global_count + 1, sizeof(TypeBinding))) {
+        return false;
+    }
+    TypeBinding* binding = &checker->global_bindings[checker->global_count];
+    binding->name = name;
+    binding->type = type;
+    if (!symbol_table_define(&checker->globals, name, (uint32_t)checker->global_count)) return false;
+    checker->global_count++;
+    return true;
+}
+
+static SlangError define_function(TypeChecker* checker, const char* name, const Type* const* parameters,
+                                  size_t parameter_count, const Type* return_type) {
+    if (symbol_table_lookup(&checker->functions, name) != NULL) return SLANG_ERROR_TYPE;
+    if (!grow_array((void**)&checker->signatures, &checker->signature_capacity,
+                    checker->signature_count + 1, sizeof(TypeSignature))) {
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    TypeSignature* signature = &checker->signatures[checker->signature_count];
+    memset(signature, 0, sizeof(TypeSignature));
+    signature->name = name;
+    signature->parameter_count = parameter_count;
+    signature->return_type = return_type;
+    if (parameter_count > 0) {
+        signature->parameters = malloc(parameter_count * sizeof(const Type*));
+        if (signature->parameters == NULL) return SLANG_ERROR_INTERNAL;
+        memcpy(signature->parameters, parameters, parameter_count * sizeof(const Type*));
+    }
+
+    // すべての型が分かれば関数型を作っておく（関数を値として使うとき）
+    bool known = return_type != NULL;
+    for (size_t i = 0; i < parameter_count && known; i++) known = parameters[i] != NULL;
+    if (known) signature->type = type_function_of(parameters, parameter_count, return_type);
+    signature->call_type = type_signature_of(parameters, parameter_count, return_type);
+    if (signature->call_type == NULL) {
+        free(signature->parameters);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    if (!symbol_table_define(&checker->functions, name, (uint32_t)checker->signature_count)) {
+        free(signature->parameters);
+        return SLANG_ERROR_INTERNAL;
+    }
+    checker->signature_count++;
+    return SLANG_SUCCESS;
+}
+
+static const TypeSignature* find_function(const TypeChecker* checker, const char* name) {
+    const Symbol* symbol = symbol_table_lookup(&checker->functions, name);
+    return symbol ? &checker->signatures[symbol->slot] : NULL;
+}
+
+static bool define_local(TypeChecker* checker, const char* name, const Type* type) {
+    if (!grow_array((void**)&checker->local_types, &checker->local_capacity,
+                    checker->local_count + 1, sizeof(const Type*))) {
+        return false;
+    }
+    checker->local_types[checker->local_count] = type;
+    if (!symbol_table_define(&checker->locals, name, (uint32_t)checker->local_count)) return false;
+    checker->local_count++;
+    return true;
+}
+
+// 作成と破棄
+
+TypeChecker* type_checker_create(void) {
+    if (!type_table_init()) return NULL;
+    TypeChecker* checker = calloc(1, sizeof(TypeChecker));
+    if (checker == NULL) return NULL;
+    symbol_table_init(&checker->functions);
+    symbol_table_init(&checker->globals);
+    symbol_table_init(&checker->locals);
+    checker->error_statement = SIZE_MAX;
+    return checker;
+}
+
+void type_checker_destroy(TypeChecker* checker) {
+    if (checker == NULL) return;
+    for (size_t i = 0; i < checker->signature_count; i++) free(checker->signatures[i].parameters);
+    free(checker->signatures);
+    free(checker->global_bindings);
+    free(checker->local_types);
+    free(checker->cache);
+    free(checker->instances);
+    symbol_table_free(&checker->functions);
+    symbol_table_free(&checker->globals);
+    symbol_table_free(&checker->locals);
+    free(checker);
+}
+
+bool type_checker_declare_global(TypeChecker* checker, const char* name, const Type* type) {
+    const char* handle = intern_cstr(name);
+    if (handle == NULL || !define_global(checker, handle, type)) return false;
+    checker->host_global_count = checker->global_count;
+    return true;
+}
+
+bool type_checker_declare_function(TypeChecker* checker, const char* name, const Type* const* parameters,
+                                   size_t parameter_count, const Type* return_type) {
+    const char* handle = intern_cstr(name);
+    if (handle == NULL || define_function(checker, handle, parameters, parameter_count, return_type) != SLANG_SUCCESS) {
+        return false;
+    }
+    checker->host_signature_count = checker->signature_count;
+    return true;
+}
+
+bool type_checker_declare_signature(TypeChecker* checker, const TypeSignature* signature) {
+    if (!type_checker_declare_function(checker, signature->name, signature->parameters, signature->parameter_count,
+                                       signature->return_type)) {
+        return false;
+    }
+    checker->signatures[checker->signature_count - 1].generic = signature->generic;
+    return true;
+}
+
+// 前回のプログラムの関数とグローバル変数を外し、ホストの宣言だけを残す
+static bool reset_program(TypeChecker* checker) {
+    for (size_t i = checker->host_signature_count; i < checker->signature_count; i++) {
+        free(checker->signatures[i].parameters);
+    }
+    checker->signature_count = checker->host_signature_count;
+    checker->global_count = checker->host_global_count;
+    checker->local_count = 0;
+    checker->instance_count = 0;
+    checker->type_parameter_count = 0;
+
+    symbol_table_free(&checker->functions);
+    symbol_table_free(&checker->globals);
+    symbol_table_free(&checker->locals);
+    symbol_table_init(&checker->functions);
+    symbol_table_init(&checker->globals);
+    symbol_table_init(&checker->locals);
+    for (size_t i = 0; i < checker->signature_count; i++) {
+        if (!symbol_table_define(&checker->functions, checker->signatures[i].name, (uint32_t)i)) return false;
+    }
+    for (size_t i = 0; i < checker->global_count; i++) {
+        if (!symbol_table_define(&checker->globals, checker->global_bindings[i].name, (uint32_t)i)) return false;
+    }
+    return true;
+}
+
+// 式
+
+static SlangError infer(TypeChecker* checker, const ASTNode* node, const Type** type);
+static SlangError check_statement(TypeChecker* checker, const ASTNode* node);
+
+// 名前の参照（ローカル変数 → グローバル変数 → 関数の順）
+static SlangError infer_name(TypeChecker* checker, const ASTNode* node, const char* name, const Type** type) {
+    const Symbol* symbol = symbol_table_lookup(&checker->locals, name);
+    if (symbol != NULL) {
+        *type = checker->local_types[symbol->slot];
+        return SLANG_SUCCESS;
+    }
+    symbol = symbol_table_lookup(&checker->globals, name);
+    if (symbol != NULL) {
+        *type = checker->global_bindings[symbol->slot].type;
+        return SLANG_SUCCESS;
+    }
+    const TypeSignature* signature = find_function(checker, name);
+    if (signature != NULL) {
+        *type = signature->type;
+        return SLANG_SUCCESS;
+    }
+    return check_error(checker, node, "undefined variable");
+}
+
+// 呼び出しに呼び出し先の引数と戻り値の型を書く（コード生成が引数をGPRとXMMのどちらで渡すかを決める）
+// ノードに書くのはこれと特殊化の名前、式の型だけ（検査する単位のASTは検査器のもの）
+static void set_callee_type(const ASTNode* node, const Type* callee_type) {
+    if (node->type == NODE_FUNCTION_CALL) {
+        ((ASTNode*)node)->data.function_call.callee_type = callee_type;
+    } else {
+        ((ASTNode*)node)->data.call_expression.callee_type = callee_type;
+    }
+}
+
+// callee_typeは呼び出し先の関数型（シグネチャのcall_typeか関数の値の型。分からなければNULL）
+static SlangError check_arguments(TypeChecker* checker, const ASTNode* node, const Type* callee_type,
+                                  ASTNode* const* arguments, size_t argument_count, const Type** type) {
+    if (callee_type != NULL && argument_count != callee_type->data.function.parameter_count) {
+        return check_error(checker, node, "wrong number of arguments");
+    }
+    for (size_t i = 0; i < argument_count; i++) {
+        const Type* argument;
+        SlangError error = infer(checker, arguments[i], &argument);
+        if (error != SLANG_SUCCESS) return error;
+        if (callee_type != NULL && !is_assignable(callee_type->data.function.parameter_types[i], argument)) {
+            return check_error_named(checker, arguments[i], ast_node_name(node), "argument type mismatch");
+        }
+    }
+    set_callee_type(node, callee_type);
+    *type = callee_type ? callee_type->data.function.return_type : NULL;
+    return SLANG_SUCCESS;
+}
+
+// 変数に入っていない名前の呼び出しだけがシグネチャで検査できる
+static const TypeSignature* direct_callee(const TypeChecker* checker, const char* name) {
+    if (symbol_table_lookup(&checker->locals, name) != NULL || symbol_table_lookup(&checker->globals, name) != NULL) {
+        return NULL;
+    }
+    return find_function(checker, name);
+}
+
+static bool push_instance(TypeChecker* checker, struct MonoInstance* instance) {
+    for (size_t i = 0; i < checker->instance_count; i++) {
+        if (checker->instances[i] == instance) return true;
+    }
+    if (!grow_array((void**)&checker->instances, &checker->instance_capacity, checker->instance_count + 1,
+                    sizeof(struct MonoInstance*))) {
+        return false;
+    }
+    checker->instances[checker->instance_count++] = instance;
+    return true;
+}
+
+// 汎用関数の呼び出し（引数の型から型引数が決まれば特殊化を使い、呼び出しにその名前を書く）
+// 特殊化を作れなければ共有の本体のシグネチャで検査する
+static SlangError infer_generic_call(TypeChecker* checker, const ASTNode* node, const TypeSignature* signature,
+                                     const Type** type) {
+    const FunctionCall* call = &node->data.function_call;
+    if (call->argument_count != signature->parameter_count) return check_error(checker, node, "wrong number of arguments");
+
+    const Type* arguments[UINT8_MAX + 1];
+    for (size_t i = 0; i < call->argument_count; i++) {
+        SlangError error = infer(checker, call->arguments[i], &arguments[i]);
+        if (error != SLANG_SUCCESS) return error;
+    }
+    struct MonoInstance* instance;
+    SlangError error = mono_instantiate(checker->specializations, signature->generic, arguments, call->argument_count,
+                                        &instance);
+    if (error != SLANG_SUCCESS) return error;
+    if (instance != NULL && !push_instance(checker, instance)) return SLANG_ERROR_INTERNAL;
+
+    const Type* const* parameters = instance ? instance->parameters : signature->parameters;
+    for (size_t i = 0; i < call->argument_count; i++) {
+        if (!is_assignable(parameters[i], arguments[i])) {
+            return check_error_named(checker, call->arguments[i], call->name, "argument type mismatch");
+        }
+    }
+    ((ASTNode*)node)->data.function_call.specialization = instance ? instance->name : NULL;
+    set_callee_type(node, instance ? type_signature_of(instance->parameters, call->argument_count, instance->return_type)
+                                   : signature->call_type);
+    *type = instance ? instance->return_type : signature->return_type;
+    return SLANG_SUCCESS;
+}
+
+// ログのマクロ（log!からerror!）の段階（マクロの名前でなければ-1）
+static int log_macro_level(const char* name) {
+#define LOG_LEVEL(level, macro, class, rank) \
+    if (strcmp(name, macro) == 0) return LOG_LEVEL_##level;
+#include "../include/log_levels.def"
+#undef LOG_LEVEL
+    return -1;
+}
+
+// 組み込みの数学関数（math_builtins.def。名前でなければ-1）
+static int math_builtin(const char* name) {
+#define MATH_BUILTIN(id, function, arguments) \
+    if (strcmp(name, function) == 0) return MATH_BUILTIN_##id;
+#include "../include/math_builtins.def"
+#undef MATH_BUILTIN
+    return -1;
+}
+
+static const size_t math_builtin_arguments[MATH_BUILTIN_COUNT] = {
+#define MATH_BUILTIN(name, function, arguments) arguments,
+#include "../include/math_builtins.def"
+#undef MATH_BUILTIN
+};
+
+// 組み込みの数学関数の呼び出し（引数の型は静的に決まっていなければならない）
+//   vec2/vec3/vec4(x, ...)・quat(w, x, y, z): 数の要素から作る  mat4(c0, c1, c2, c3): vec4の列から作る
+//   dot(a, b): 同じ型のベクトルか四元数の内積（float）
+//   at(v, i): iは整数のリテラルで、ベクトルと四元数ならi番目の要素（float）、行列ならi番目の列
+static SlangError infer_math_builtin(TypeChecker* checker, const ASTNode* node, MathBuiltin builtin,
+                                     const Type** type) {
+    const FunctionCall* call = &node->data.function_call;
+    if (call->argument_count != math_builtin_arguments[builtin]) {
+        return check_error(checker, node, "wrong number of arguments");
+    }
+    const Type* arguments[4];
+    for (size_t i = 0; i < call->argument_count; i++) {
+        SlangError error = infer(checker, call->arguments[i], &arguments[i]);
+        if (error != SLANG_SUCCESS) return error;
+        if (arguments[i] == NULL) return check_error_named(checker, call->arguments[i], call->name, "argument type mismatch");
+    }
+
+    const Type* element = type_primitive(TYPE_FLOAT);
+    const Type* result = NULL;
+    bool ok = true;
+    switch (builtin) {
+        case MATH_BUILTIN_VEC2:
+        case MATH_BUILTIN_VEC3:
+        case MATH_BUILTIN_VEC4:
+        case MATH_BUILTIN_QUAT:
+            for (size_t i = 0; i < call->argument_count && ok; i++) ok = is_numeric(arguments[i]);
+            result = builtin == MATH_BUILTIN_QUAT ? type_quaternion_of(element)
+                                                  : type_vector_of(element, call->argument_count);
+            break;
+        case MATH_BUILTIN_MAT4: {
+            const Type* column = type_vector_of(element, 4);
+            for (size_t i = 0; i < call->argument_count && ok; i++) ok = arguments[i] == column;
+            result = type_matrix_of(element, 4, 4);
+            break;
+        }
+        case MATH_BUILTIN_DOT:
+            ok = arguments[0] == arguments[1] &&
+                 (arguments[0]->kind == TYPE_VECTOR || arguments[0]->kind == TYPE_QUATERNION);
+            result = element;
+            break;
+        case MATH_BUILTIN_AT: {
+            const ASTNode* index = call->arguments[1];
+            size_t count = 0;
+            if (arguments[0]->kind == TYPE_VECTOR) {
+                count = arguments[0]->data.vector.dimension;
+                result = element;
+            } else if (arguments[0]->kind == TYPE_QUATERNION) {
+                count = 4;
+                result = element;
+            } else if (arguments[0]->kind == TYPE_MATRIX) {
+                count = arguments[0]->data.matrix.columns;
+                result = type_vector_of(element, arguments[0]->data.matrix.rows);
+            }
+            if (count == 0) {
+                ok = false;
+            } else if (index->type != NODE_INTEGER_LITERAL) {
+                return check_error_named(checker, index, call->name, "index must be an integer literal");
+            } else if (index->data.integer_literal.value < 0 || (uint64_t)index->data.integer_literal.value >= count) {
+                return check_error_named(checker, index, call->name, "index out of range");
+            }
+            break;
+        }
+        default:
+            ok = false;
+            break;
+    }
+    if (!ok) return check_error(checker, node, "argument type mismatch");
+    if (result == NULL) return SLANG_ERROR_INTERNAL;
+    ((ASTNode*)node)->data.function_call.math_builtin = (int)builtin;
+    *type = result;
+    return SLANG_SUCCESS;
+}
+
+static SlangError infer_call(TypeChecker* checker, const ASTNode* node, const Type** type) {
+    if (node->type == NODE_FUNCTION_CALL) {
+        const FunctionCall* call = &node->data.function_call;
+        const TypeSignature* signature = direct_callee(checker, call->name);
+        // 同じ名前の関数も変数もなければログのマクロ（引数は何でもよく、値はnil）か組み込みの数学関数
+        bool unbound = signature == NULL && symbol_table_lookup(&checker->locals, call->name) == NULL &&
+                       symbol_table_lookup(&checker->globals, call->name) == NULL;
+        int level = unbound ? log_macro_level(call->name) : -1;
+        if (level >= 0) {
+            ((ASTNode*)node)->data.function_call.log_level = level;
+            return check_arguments(checker, node, NULL, call->arguments, call->argument_count, type);
+        }
+        int builtin = unbound ? math_builtin(call->name) : -1;
+        if (builtin >= 0) return infer_math_builtin(checker, node, (MathBuiltin)builtin, type);
+        if (signature != NULL && signature->generic != NULL && checker->specializations != NULL &&
+            call->argument_count <= UINT8_MAX + 1) {
+            return infer_generic_call(checker, node, signature, type);
+        }
+        const Type* callee = signature ? signature->call_type : NULL;
+        if (signature == NULL) {
+            SlangError error = infer_name(checker, node, call->name, &callee);
+            if (error != SLANG_SUCCESS) return error;
+            if (callee != NULL && callee->kind != TYPE_FUNCTION) return check_error(checker, node, "not callable");
+        }
+        return check_arguments(checker, node, callee, call->arguments, call->argument_count, type);
+    }
+
+    const CallExpression* call = &node->data.call_expression;
+    const TypeSignature* signature = NULL;
+    if (call->callee->type == NODE_VARIABLE_REFERENCE) {
+        signature = direct_callee(checker, call->callee->data.variable_reference.name);
+    }
+    const Type* callee = signature ? signature->call_type : NULL;
+    if (signature == NULL) {
+        SlangError error = infer(checker, call->callee, &callee);
+        if (error != SLANG_SUCCESS) return error;
+        if (callee != NULL && callee->kind != TYPE_FUNCTION) return check_error(checker, node, "not callable");
+    }
+    return check_arguments(checker, node, callee, call->arguments, call->argument_count, type);
+}
+
+// 数学の型の四則演算の結果の型（合わなければNULL）
+//   同じ型どうしの+と-、ベクトルどうしの要素ごとの*と/、行列の積と四元数の積、行列×vec4、数とのスカラー倍
+static const Type* math_arithmetic(char op, const Type* left, const Type* right) {
+    if (left == right) {
+        if (op == '+' || op == '-' || op == '*') return left;
+        return op == '/' && left->kind == TYPE_VECTOR ? left : NULL;
+    }
+    if (op != '*') return NULL;
+    if (is_math(left) && is_numeric(right)) return left;
+    if (is_numeric(left) && is_math(right)) return right;
+    if (left->kind == TYPE_MATRIX && right->kind == TYPE_VECTOR &&
+        left->data.matrix.columns == right->data.vector.dimension) {
+        return type_vector_of(type_primitive(TYPE_FLOAT), left->data.matrix.rows);
+    }
+    return NULL;
+}
+
+static SlangError infer_binary(TypeChecker* checker, const ASTNode* node, const Type** type) {
+    const BinaryExpression* binary = &node->data.binary_expression;
+    const Type* left;
+    const Type* right;
+    SlangError error = infer(checker, binary->left, &left);
+    if (error != SLANG_SUCCESS) return error;
+    error = infer(checker, binary->right, &right);
+    if (error != SLANG_SUCCESS) return error;
+
+    bool known = left != NULL && right != NULL;
+    OperatorClass operator = classify_binary(binary->operator);
+    if (is_math(left) || is_math(right)) {
+        if (!known || operator != OPERATOR_ARITHMETIC) return check_error(checker, node, "invalid operand types");
+        const Type* result = math_arithmetic(binary->operator[0], left, right);
+        if (result == NULL) return check_error(checker, node, "invalid operand types");
+        *type = result;
+        return SLANG_SUCCESS;
+    }
+    switch (operator) {
+        case OPERATOR_ARITHMETIC:
+            if (!known) {
+                *type = NULL;
+                return SLANG_SUCCESS;
+            }
+            if (!is_numeric(left) || !is_numeric(right)) break;
+            *type = left->kind == TYPE_INTEGER && right->kind == TYPE_INTEGER ? left : type_primitive(TYPE_FLOAT);
+            return SLANG_SUCCESS;
+
+        case OPERATOR_MODULO:
+            if (known && (left->kind != TYPE_INTEGER || right->kind != TYPE_INTEGER)) break;
+            *type = type_primitive(TYPE_INTEGER);
+            return SLANG_SUCCESS;
+
+        case OPERATOR_EQUALITY:
+            if (known && left != right && !(is_numeric(left) && is_numeric(right))) break;
+            *type = type_primitive(TYPE_BOOLEAN);
+            return SLANG_SUCCESS;
+
+        case OPERATOR_ORDER:
+            if ((left != NULL && !is_numeric(left)) || (right != NULL && !is_numeric(right))) break;
+            *type = type_primitive(TYPE_BOOLEAN);
+            return SLANG_SUCCESS;
+
+        case OPERATOR_LOGICAL:
+            if ((left != NULL && left->kind != TYPE_BOOLEAN) || (right != NULL && right->kind != TYPE_BOOLEAN)) break;
+            *type = type_primitive(TYPE_BOOLEAN);
+            return SLANG_SUCCESS;
+
+        default:
+            return check_error(checker, node, "unsupported binary operator");
+    }
+    return check_error(checker, node, "invalid operand types");
+}
+
+static SlangError infer_unary(TypeChecker* checker, const ASTNode* node, const Type** type) {
+    const UnaryExpression* unary = &node->data.unary_expression;
+    const Type* operand;
+    SlangError error = infer(checker, unary->right, &operand);
+    if (error != SLANG_SUCCESS) return error;
+
+    if (strcmp(unary->operator, "-") == 0) {
+        if (operand != NULL && !is_numeric(operand) && !is_math(operand)) {
+            return check_error(checker, node, "invalid operand type");
+        }
+        *type = operand;
+        return SLANG_SUCCESS;
+    }
+    if (strcmp(unary->operator, "!") == 0) {
+        if (operand != NULL && operand->kind != TYPE_BOOLEAN) return check_error(checker, node, "invalid operand type");
+        *type = type_primitive(TYPE_BOOLEAN);
+        return SLANG_SUCCESS;
+    }
+    return check_error(checker, node, "unsupported unary operator");
+}
+
+static SlangError infer_assignment(TypeChecker* checker, const ASTNode* node, const Type** type) {
+    const Assignment* assignment = &node->data.assignment;
+    const Type* target;
+    SlangError error = infer_name(checker, node, assignment->name, &target);
+    if (error != SLANG_SUCCESS) return error;
+    if (symbol_table_lookup(&checker->locals, assignment->name) == NULL &&
+        symbol_table_lookup(&checker->globals, assignment->name) == NULL) {
+        return check_error(checker, node, "cannot assign to a function");
+    }
+
+    const Type* value;
+    error = infer(checker, assignment->value, &value);
+    if (error != SLANG_SUCCESS) return error;
+    if (!is_assignable(target, value)) return check_error(checker, node, "assignment type mismatch");
+    *type = target ? target : value;
+    return SLANG_SUCCESS;
+}
+
+static SlangError infer_expression(TypeChecker* checker, const ASTNode* node, const Type** type) {
+    if (node == NULL) return check_error(checker, node, "missing expression");
+
+    switch (node->type) {
+        case NODE_INTEGER_LITERAL:
+            *type = type_primitive(TYPE_INTEGER);
+            return SLANG_SUCCESS;
+        case NODE_FLOAT_LITERAL:
+            *type = type_primitive(TYPE_FLOAT);
+            return SLANG_SUCCESS;
+        case NODE_STRING_LITERAL:
+            *type = type_primitive(TYPE_STRING);
+            return SLANG_SUCCESS;
+        case NODE_BOOLEAN_LITERAL:
+            *type = type_primitive(TYPE_BOOLEAN);
+            return SLANG_SUCCESS;
+        case NODE_VARIABLE_REFERENCE:
+            return infer_name(checker, node, node->data.variable_reference.name, type);
+        case NODE_ASSIGNMENT:
+            return infer_assignment(checker, node, type);
+        case NODE_BINARY_EXPRESSION:
+            return infer_binary(checker, node, type);
+        case NODE_UNARY_EXPRESSION:
+            return infer_unary(checker, node, type);
+        case NODE_FUNCTION_CALL:
+        case NODE_CALL_EXPRESSION:
+            return infer_call(checker, node, type);
+        default:
+            return check_error(checker, node, "unsupported expression");
+    }
+}
+
+// 式の型を求めてノードに書く（コード生成は浮動小数点数の式をXMMで計算する）
+static SlangError infer(TypeChecker* checker, const ASTNode* node, const Type** type) {
+    SlangError error = infer_expression(checker, node, type);
+    if (error == SLANG_SUCCESS) ((ASTNode*)node)->resolved_type = *type;
+    return error;
+}
+
+// 文
+
+static SlangError check_condition(TypeChecker* checker, const ASTNode* condition) {
+    const Type* type;
+    SlangError error = infer(checker, condition, &type);
+    if (error != SLANG_SUCCESS) return error;
+    if (type != NULL && type->kind != TYPE_BOOLEAN) return check_error(checker, condition, "condition must be bool");
+    return SLANG_SUCCESS;
+}
+
+// ブロックを抜けるとその中の変数は見えなくなる
+static SlangError check_scoped(TypeChecker* checker, const ASTNode* node) {
+    if (node == NULL) return SLANG_SUCCESS;
+    if (!symbol_table_push_scope(&checker->locals)) return SLANG_ERROR_INTERNAL;
+    size_t saved = checker->local_count;
+    SlangError error = check_statement(checker, node);
+    symbol_table_pop_scope(&checker->locals);
+    checker->local_count = saved;
+    return error;
+}
+
+static SlangError check_let(TypeChecker* checker, const ASTNode* node) {
+    const LetStatement* let = &node->data.let_statement;
+    const Type* declared = declared_type(checker, let->type);
+    const Type* value = NULL;
+    if (let->initializer != NULL) {
+        SlangError error = infer(checker, let->initializer, &value);
+        if (error != SLANG_SUCCESS) return error;
+        if (declared != NULL && !is_assignable(declared, value)) {
+            return check_error(checker, node, "initializer type mismatch");
+        }
+    }
+    const Type* type = declared ? declared : value;
+
+    // スクリプトの最上位のletはグローバル変数になる
+    bool defined = checker->current == NULL && checker->locals.depth == 0
+        ? define_global(checker, let->name, type)
+        : define_local(checker, let->name, type);
+    return defined ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+}
+
+static SlangError check_return(TypeChecker* checker, const ASTNode* node) {
+    const ASTNode* value = node->data.return_statement.value;
+    const Type* expected = checker->current ? checker->current->return_type : NULL;
+    if (value == NULL) {
+        if (expected != NULL && expected->kind != TYPE_VOID) return check_error(checker, node, "missing return value");
+        return SLANG_SUCCESS;
+    }
+    const Type* type;
+    SlangError error = infer(checker, value, &type);
+    if (error != SLANG_SUCCESS) return error;
+    if (!is_assignable(expected, type)) return check_error(checker, node, "return type mismatch");
+    return SLANG_SUCCESS;
+}
+
+static SlangError check_statement(TypeChecker* checker, const ASTNode* node) {
+    if (node == NULL) return SLANG_SUCCESS;
+
+    const Type* type;
+    switch (node->type) {
+        case NODE_LET_STATEMENT:
+            return check_let(checker, node);
+
+        case NODE_BLOCK_STATEMENT: {
+            if (!symbol_table_push_scope(&checker->locals)) return SLANG_ERROR_INTERNAL;
+            size_t saved = checker->local_count;
+            SlangError error = SLANG_SUCCESS;
+            const BlockStatement* block = &node->data.block_statement;
+            for (size_t i = 0; i < block->statement_count && error == SLANG_SUCCESS; i++) {
+                error = check_statement(checker, block->statements[i]);
+            }
+            symbol_table_pop_scope(&checker->locals);
+            checker->local_count = saved;
+            return error;
+        }
+
+        case NODE_IF_STATEMENT: {
+            const IfStatement* statement = &node->data.if_statement;
+            SlangError error = check_condition(checker, statement->condition);
+            if (error != SLANG_SUCCESS) return error;
+            error = check_scoped(checker, statement->then_branch);
+            if (error != SLANG_SUCCESS) return error;
+            return check_scoped(checker, statement->else_branch);
+        }
+
+        case NODE_WHILE_STATEMENT: {
+            SlangError error = check_condition(checker, node->data.while_statement.condition);
+            if (error != SLANG_SUCCESS) return error;
+            return check_scoped(checker, node->data.while_statement.body);
+        }
+
+        case NODE_RETURN_STATEMENT:
+            return check_return(checker, node);
+
+        case NODE_EXPRESSION_STATEMENT:
+            return infer(checker, node->data.expression_statement.expression, &type);
+
+        case NODE_FUNCTION:
+            // 関数はスクリプトの最上位で事前に宣言される
+            if (checker->current == NULL && checker->locals.depth == 0) return SLANG_SUCCESS;
+            return check_error(checker, node, "nested functions are not supported");
+
+        default:
+            return infer(checker, node, &type);
+    }
+}
+
+// 関数の検査結果のキーとキャッシュ
+// 型に関わる構造（ノードの種類、名前、演算子、注釈）だけを混ぜ、リテラルの値は混ぜない。
+// 最上位の名前を参照していれば、その時点の型（型の表のポインタ）も混ぜるので、
+// 呼び出し先のシグネチャやグローバル変数の型が変われば呼び出し側もキーが変わる。
+
+static uint64_t hash_mix(uint64_t hash, uint64_t value) {
+    hash = (hash ^ value) * 0x100000001b3ull;
+    return hash ^ (hash >> 32);
+}
+
+static uint64_t hash_name(const TypeChecker* checker, uint64_t hash, const char* name) {
+    hash = hash_mix(hash, (uintptr_t)name);
+    const Symbol* symbol = symbol_table_lookup(&checker->globals, name);
+    if (symbol != NULL) return hash_mix(hash, (uintptr_t)checker->global_bindings[symbol->slot].type);
+    const TypeSignature* signature = find_function(checker, name);
+    if (signature == NULL) return hash_mix(hash, 0);
+
+    hash = hash_mix(hash, signature->parameter_count);
+    for (size_t i = 0; i < signature->parameter_count; i++) {
+        hash = hash_mix(hash, (uintptr_t)signature->parameters[i]);
+    }
+    return hash_mix(hash, (uintptr_t)signature->return_type);
+}
+
+static uint64_t hash_node(const TypeChecker* checker, uint64_t hash, const ASTNode* node);
+
+static uint64_t hash_nodes(const TypeChecker* checker, uint64_t hash, ASTNode* const* nodes, size_t count) {
+    hash = hash_mix(hash, count);
+    for (size_t i = 0; i < count; i++) hash = hash_node(checker, hash, nodes[i]);
+    return hash;
+}
+
+static uint64_t hash_node(const TypeChecker* checker, uint64_t hash, const ASTNode* node) {
+    if (node == NULL) return hash_mix(hash, UINT64_MAX);
+
+    hash = hash_mix(hash, (uint64_t)node->type);
+    switch (node->type) {
+        case NODE_LET_STATEMENT:
+            hash = hash_mix(hash, (uintptr_t)node->data.let_statement.name);
+            hash = hash_mix(hash, (uintptr_t)annotation(node->data.let_statement.type));
+            return hash_node(checker, hash, node->data.let_statement.initializer);
+        case NODE_IF_STATEMENT:
+            hash = hash_node(checker, hash, node->data.if_statement.condition);
+            hash = hash_node(checker, hash, node->data.if_statement.then_branch);
+            return hash_node(checker, hash, node->data.if_statement.else_branch);
+        case NODE_WHILE_STATEMENT:
+            hash = hash_node(checker, hash, node->data.while_statement.condition);
+            return hash_node(checker, hash, node->data.while_statement.body);
+        case NODE_CALL_EXPRESSION:
+            hash = hash_node(checker, hash, node->data.call_expression.callee);
+            return hash_nodes(checker, hash, node->data.call_expression.arguments, node->data.call_expression.argument_count);
+        case NODE_FUNCTION_CALL:
+            hash = hash_name(checker, hash, node->data.function_call.name);
+            return hash_nodes(checker, hash, node->data.function_call.arguments, node->data.function_call.argument_count);
+        case NODE_ASSIGNMENT:
+            hash = hash_name(checker, hash, node->data.assignment.name);
+            return hash_node(checker, hash, node->data.assignment.value);
+        case NODE_VARIABLE_REFERENCE:
+            return hash_name(checker, hash, node->data.variable_reference.name);
+        case NODE_BINARY_EXPRESSION:
+            hash = hash_mix(hash, (uintptr_t)node->data.binary_expression.operator);
+            hash = hash_node(checker, hash, node->data.binary_expression.left);
+            return hash_node(checker, hash, node->data.binary_expression.right);
+        case NODE_UNARY_EXPRESSION:
+            hash = hash_mix(hash, (uintptr_t)node->data.unary_expression.operator);
+            return hash_node(checker, hash, node->data.unary_expression.right);
+        case NODE_EXPRESSION_STATEMENT:
+            return hash_node(checker, hash, node->data.expression_statement.expression);
+        case NODE_BLOCK_STATEMENT:
+            return hash_nodes(checker, hash, node->data.block_statement.statements, node->data.block_statement.statement_count);
+        case NODE_RETURN_STATEMENT:
+            return hash_node(checker, hash, node->data.return_statement.value);
+        default:
+            return hash;
+    }
+}
+
+static uint64_t function_key(const TypeChecker* checker, const Function* function, const TypeSignature* signature) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hash_mix(hash, signature->parameter_count);
+    for (size_t i = 0; i < signature->parameter_count; i++) {
+        hash = hash_mix(hash, (uintptr_t)function->parameters[i]->name);
+        hash = hash_mix(hash, (uintptr_t)signature->parameters[i]);
+    }
+    hash = hash_mix(hash, (uintptr_t)signature->return_type);
+    return hash_node(checker, hash, function->body);
+}
+
+// キャッシュは名前のポインタで引く（オープンアドレス法、線形探査、容量は2の冪）
+static TypeCheckEntry* cache_find(TypeChecker* checker, const char* name) {
+    if (checker->cache_capacity == 0) return NULL;
+    size_t mask = checker->cache_capacity - 1;
+    for (size_t index = intern_hash(name) & mask;; index = (index + 1) & mask) {
+        TypeCheckEntry* entry = &checker->cache[index];
+        if (entry->name == name) return entry;
+        if (entry->name == NULL) return NULL;
+    }
+}
+
+// 結果とエラー（checkerの最後のエラー）を覚える
+static bool cache_store(TypeChecker* checker, const char* name, uint64_t key, SlangError result) {
+    TypeCheckEntry* entry = cache_find(checker, name);
+    if (entry == NULL) {
+        if ((checker->cache_count + 1) * 2 > checker->cache_capacity) {
+            size_t capacity = checker->cache_capacity ? checker->cache_capacity * 2 : TYPE_CHECKER_INITIAL_CAPACITY;
+            TypeCheckEntry* entries = calloc(capacity, sizeof(TypeCheckEntry));
+            if (entries == NULL) return false;
+            for (size_t i = 0; i < checker->cache_capacity; i++) {
+                TypeCheckEntry* old = &checker->cache[i];
+                if (old->name == NULL) continue;
+                size_t index = intern_hash(old->name) & (capacity - 1);
+                while (entries[index].name != NULL) index = (index + 1) & (capacity - 1);
+                entries[index] = *old;
+            }
+            free(checker->cache);
+            checker->cache = entries;
+            checker->cache_capacity = capacity;
+        }
+        size_t index = intern_hash(name) & (checker->cache_capacity - 1);
+        while (checker->cache[index].name != NULL) index = (index + 1) & (checker->cache_capacity - 1);
+        entry = &checker->cache[index];
+        entry->name = name;
+        checker->cache_count++;
+    }
+    entry->key = key;
+    entry->result = result;
+    entry->error = checker->error;
+    entry->site = checker->error_site;
+    return true;
+}
+
+// 関数本体の検査（引数は本体の外側のスコープに置く）
+static SlangError check_function(TypeChecker* checker, const ASTNode* node, const TypeSignature* signature) {
+    const Function* function = &node->data.function;
+    checker->current = signature;
+    checker->local_count = 0;
+
+    SlangError error = symbol_table_push_scope(&checker->locals) ? SLANG_SUCCESS : SLANG_ERROR_INTERNAL;
+    for (size_t i = 0; i < function->parameter_count && error == SLANG_SUCCESS; i++) {
+        if (!define_local(checker, function->parameters[i]->name, signature->parameters[i])) error = SLANG_ERROR_INTERNAL;
+    }
+    if (error == SLANG_SUCCESS) error = check_statement(checker, function->body);
+    symbol_table_pop_scope(&checker->locals);
+
+    checker->current = NULL;
+    checker->local_count = 0;
+    return error;
+}
+
+static SlangError declare_program(TypeChecker* checker, ASTNode* const* nodes, size_t count) {
+    const Type* parameters[UINT8_MAX + 1];
+    for (size_t i = 0; i < count; i++) {
+        const ASTNode* node = nodes[i];
+        if (node == NULL) continue;
+
+        checker->error_statement = i;
+        if (node->type == NODE_FUNCTION) {
+            const Function* function = &node->data.function;
+            if (function->parameter_count > UINT8_MAX + 1) return check_error(checker, node, "too many parameters");
+            SlangError error = bind_type_parameters(checker, node);
+            if (error != SLANG_SUCCESS) return error;
+            for (size_t p = 0; p < function->parameter_count; p++) {
+                parameters[p] = declared_type(checker, function->parameters[p]->type);
+            }
+            error = define_function(checker, function->name, parameters, function->parameter_count,
+                                    declared_type(checker, function->return_type));
+            checker->type_parameter_count = 0;
+            if (error == SLANG_ERROR_TYPE) return check_error(checker, node, "duplicate function");
+            if (error != SLANG_SUCCESS) return error;
+            if (function->type_parameter_count > 0) checker->signatures[checker->signature_count - 1].generic = node;
+        } else if (node->type == NODE_LET_STATEMENT) {
+            // 型は最上位の文を検査するときに初期化式から決まる（注釈があればそれ）
+            if (!define_global(checker, node->data.let_statement.name, annotation(node->data.let_statement.type))) {
+                return SLANG_ERROR_INTERNAL;
+            }
+        }
+    }
+    checker->error_statement = SIZE_MAX;
+    return SLANG_SUCCESS;
+}
+
+// 特殊化の本体を、汎用関数を宣言した検査器の環境を写した検査器で検査する
+// （特殊化の中で使った特殊化はcheckerの並びに移す）
+static SlangError check_instance(TypeChecker* checker, struct MonoInstance* instance) {
+    const MonoEnvironment* environment = instance->generic->environment;
+    const Function* function = &instance->function->data.function;
+    TypeChecker* scratch = type_checker_create();
+    bool declared = scratch != NULL;
+    for (size_t i = 0; i < environment->signature_count && declared; i++) {
+        declared = type_checker_declare_signature(scratch, &environment->signatures[i]);
+    }
+    for (size_t i = 0; i < environment->global_count && declared; i++) {
+        declared = define_global(scratch, environment->globals[i].name, environment->globals[i].type);
+    }
+    SlangError result = SLANG_ERROR_INTERNAL;
+    if (declared) {
+        scratch->specializations = checker->specializations;
+        result = define_function(scratch, instance->name, instance->parameters, function->parameter_count,
+                                 instance->return_type);
+    }
+    if (result == SLANG_SUCCESS) result = check_function(scratch, instance->function, find_function(scratch, instance->name));
+    for (size_t i = 0; scratch != NULL && i < scratch->instance_count && result != SLANG_ERROR_INTERNAL; i++) {
+        if (!push_instance(checker, scratch->instances[i])) result = SLANG_ERROR_INTERNAL;
+    }
+
+    const char* error = NULL;
+    if (result == SLANG_ERROR_TYPE) {
+        const char* reason = scratch->error ? scratch->error : "type check failed";
+        size_t length = intern_length(instance->name) + 2 + strlen(reason);
+        char* buffer = malloc(length + 1);
+        if (buffer == NULL) {
+            result = SLANG_ERROR_INTERNAL;
+        } else {
+            snprintf(buffer, length + 1, "%s: %s", instance->name, reason);
+            error = intern(buffer, length);
+            free(buffer);
+            if (error == NULL) result = SLANG_ERROR_INTERNAL;
+        }
+    }
+    TypeErrorSite site = { NULL, 0, 0 };
+    if (error != NULL && scratch->error_site.line != 0) site = scratch->error_site;
+    else if (error != NULL) site = (TypeErrorSite){ instance->name, instance->function->line, instance->function->column };
+    type_checker_destroy(scratch);
+    mono_finish_check(checker->specializations, instance, result, error, &site);
+    return result;
+}
+
+SlangError type_checker_check(TypeChecker* checker, ASTNode* const* nodes, size_t count) {
+    checker->error = NULL;
+    checker->error_site = (TypeErrorSite){ NULL, 0, 0 };
+    checker->error_statement = SIZE_MAX;
+    checker->checked_count = 0;
+    checker->reused_count = 0;
+    if (!reset_program(checker)) return SLANG_ERROR_INTERNAL;
+
+    // 1. 最上位の関数のシグネチャとグローバル変数を登録する
+    SlangError error = declare_program(checker, nodes, count);
+    if (error != SLANG_SUCCESS) return error;
+
+    // 2. 最上位の文（グローバル変数の型が決まる）
+    for (size_t i = 0; i < count; i++) {
+        error = check_statement(checker, nodes[i]);
+        if (error != SLANG_SUCCESS) {
+            checker->error_statement = i;
+            return error;
+        }
+    }
+
+    // 3. 関数の本体（キーが前回と同じならキャッシュの結果を使う）
+    SlangError first = SLANG_SUCCESS;
+    const char* message = NULL;
+    TypeErrorSite site = { NULL, 0, 0 };
+    size_t statement = SIZE_MAX;
+    for (size_t i = 0; i < count; i++) {
+        const ASTNode* node = nodes[i];
+        if (node == NULL || node->type != NODE_FUNCTION) continue;
+
+        const TypeSignature* signature = find_function(checker, node->data.function.name);
+        uint64_t key = function_key(checker, &node->data.function, signature);
+        TypeCheckEntry* entry = cache_find(checker, signature->name);
+        SlangError result;
+        if (entry != NULL && entry->key == key && !entry->specialized) {
+            result = entry->result;
+            checker->error = entry->error;
+            checker->error_site = entry->site;
+            checker->reused_count++;
+        } else {
+            checker->error = NULL;
+            checker->error_site = (TypeErrorSite){ NULL, 0, 0 };
+            size_t instances = checker->instance_count;
+            result = bind_type_parameters(checker, node);
+            if (result == SLANG_SUCCESS) result = check_function(checker, node, signature);
+            checker->type_parameter_count = 0;
+            if (result == SLANG_ERROR_INTERNAL) return result;
+            if (!cache_store(checker, signature->name, key, result)) return SLANG_ERROR_INTERNAL;
+            cache_find(checker, signature->name)->specialized = checker->instance_count != instances;
+            checker->checked_count++;
+        }
+
+        // 残りの関数もキャッシュに入れるため、最初のエラーを覚えて続ける
+        if (result != SLANG_SUCCESS && first == SLANG_SUCCESS) {
+            first = result;
+            message = checker->error;
+            site = checker->error_site;
+            statement = i;
+        }
+    }
+
+    // 4. 特殊化の本体（検査の途中で使った特殊化も並びの後ろに加わる）
+    if (checker->specializations != NULL) {
+        error = mono_publish(checker->specializations, checker, nodes, count);
+        if (error != SLANG_SUCCESS) return error;
+        for (size_t i = 0; i < checker->instance_count; i++) {
+            struct MonoInstance* instance = checker->instances[i];
+            if (!mono_claim_check(checker->specializations, instance)) continue;
+            SlangError result = check_instance(checker, instance);
+            if (result == SLANG_ERROR_INTERNAL) return result;
+            if (result != SLANG_SUCCESS && first == SLANG_SUCCESS) {
+                first = result;
+                message = instance->error;
+                site = instance->site;
+                // 汎用関数の宣言がこの並びになければ（ほかの成分の汎用関数なら）文は分からない
+                for (size_t s = 0; s < count && statement == SIZE_MAX; s++) {
+                    if (nodes[s] == instance->generic->function) statement = s;
+                }
+            }
+        }
+    }
+
+    checker->error = message;
+    checker->error_site = site;
+    checker->error_statement = statement;
+    return first;
+}
+
+SlangError type_checker_infer(TypeChecker* checker, const ASTNode* expression, const Type** type) {
+    checker->error = NULL;
+    checker->error_site = (TypeErrorSite){ NULL, 0, 0 };
+    checker->error_statement = SIZE_MAX;
+    return infer(checker, expression, type);
+}
@@ -1,6 +1,11 @@
+#define _GNU_SOURCE
 #include "../include/type_system.h"
 #include "../include/ast.h"
+#include "../include/type_checker.h"
 #include "../include/common.h"
+#include "../include/arena.h"
+#include "../include/intern.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -11,7 +16,9 @@ Type* type_new(TypeKind kind) {
     if (!type) return NULL;
     type->kind = kind;
     type->size = 0;
+    type->alignment = 1;
     type->is_mutable = false;
+    type->interned = false;
     switch (kind) {
         case TYPE_ARRAY:
             type->data.array.element_type = NULL;
@@ -55,7 +62,7 @@ Type* type_new(TypeKind kind) {
 }
 
 void type_free(Type* type) {
-    if (!type) return;
+    if (!type || type->interned) return;
     switch (type->kind) {
         case TYPE_ARRAY:
             type_free(type->data.array.element_type);
@@ -96,7 +103,7 @@ void type_free(Type* type) {
             type_free(type->data.function.return_type);
             break;
         case TYPE_NAMED:
-            free(type->data.named.name);
+            // 名前はインターン済みなので解放しない
             break;
         default:
             break;
@@ -106,6 +113,396 @@ void type_free(Type* type) {
 
 void free_type(Type* type) { type_free(type); } // wrapper for compatibility
 
+// 型の表
+#define TYPE_TABLE_INITIAL_CAPACITY 256
+#define TYPE_TABLE_ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct {
+    uint32_t hash;
+    Type* type;
+} TypeSlot;
+
+// オープンアドレス法、線形探査（容量は常に2の冪）
+static struct {
+    Arena* arena;
+    TypeSlot* slots;
+    size_t capacity;
+    size_t count;
+    const Type* integer_type;
+    const Type* float_type;
+    const Type* boolean_type;
+    const Type* string_type;
+    const Type* void_type;
+} type_table;
+
+static pthread_mutex_t type_table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1aで値を1つずつ混ぜる
+static uint32_t type_hash_mix(uint32_t hash, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        hash ^= (uint32_t)(value & 0xff);
+        hash *= 16777619u;
+        value >>= 8;
+    }
+    return hash;
+}
+
+// 子の型は表の型なので、ポインタをそのまま混ぜればよい（is_mutableは束縛の性質なので型に含めない）
+static uint32_t type_key_hash(const Type* key) {
+    uint32_t hash = type_hash_mix(2166136261u, (uint64_t)key->kind);
+    switch (key->kind) {
+        case TYPE_ARRAY:
+            hash = type_hash_mix(hash, (uintptr_t)key->data.array.element_type);
+            break;
+        case TYPE_TUPLE:
+            for (size_t i = 0; i < key->data.tuple.type_count; i++) {
+                hash = type_hash_mix(hash, (uintptr_t)key->data.tuple.types[i]);
+            }
+            break;
+        case TYPE_VECTOR:
+            hash = type_hash_mix(hash, (uintptr_t)key->data.vector.element_type);
+            hash = type_hash_mix(hash, key->data.vector.dimension);
+            break;
+        case TYPE_MATRIX:
+            hash = type_hash_mix(hash, (uintptr_t)key->data.matrix.element_type);
+            hash = type_hash_mix(hash, key->data.matrix.rows);
+            hash = type_hash_mix(hash, key->data.matrix.columns);
+            break;
+        case TYPE_TENSOR:
+            hash = type_hash_mix(hash, (uintptr_t)key->data.tensor.element_type);
+            for (size_t i = 0; i < key->data.tensor.dimension_count; i++) {
+                hash = type_hash_mix(hash, key->data.tensor.dimensions[i]);
+            }
+            break;
+        case TYPE_QUATERNION:
+            hash = type_hash_mix(hash, (uintptr_t)key->data.quaternion.element_type);
+            break;
+        case TYPE_COMPLEX:
+            hash = type_hash_mix(hash, (uintptr_t)key->data.complex.element_type);
+            break;
+        case TYPE_FUNCTION:
+            for (size_t i = 0; i < key->data.function.parameter_count; i++) {
+                hash = type_hash_mix(hash, (uintptr_t)key->data.function.parameter_types[i]);
+            }
+            hash = type_hash_mix(hash, (uintptr_t)key->data.function.return_type);
+            break;
+        case TYPE_NAMED:
+            hash = type_hash_mix(hash, (uintptr_t)key->data.named.name);
+            break;
+        default:
+            break;
+    }
+    return hash;
+}
+
+// 1段だけの比較（子はポインタで比べる）
+static bool type_key_equals(const Type* a, const Type* b) {
+    if (a->kind != b->kind) return false;
+    switch (a->kind) {
+        case TYPE_ARRAY:
+            return a->data.array.element_type == b->data.array.element_type;
+        case TYPE_TUPLE:
+            return a->data.tuple.type_count == b->data.tuple.type_count &&
+                   memcmp(a->data.tuple.types, b->data.tuple.types, a->data.tuple.type_count * sizeof(Type*)) == 0;
+        case TYPE_VECTOR:
+            return a->data.vector.element_type == b->data.vector.element_type &&
+                   a->data.vector.dimension == b->data.vector.dimension;
+        case TYPE_MATRIX:
+            return a->data.matrix.element_type == b->data.matrix.element_type &&
+                   a->data.matrix.rows == b->data.matrix.rows &&
+                   a->data.matrix.columns == b->data.matrix.columns;
+        case TYPE_TENSOR:
+            return a->data.tensor.element_type == b->data.tensor.element_type &&
+                   a->data.tensor.dimension_count == b->data.tensor.dimension_count &&
+                   memcmp(a->data.tensor.dimensions, b->data.tensor.dimensions,
+                          a->data.tensor.dimension_count * sizeof(size_t)) == 0;
+        case TYPE_QUATERNION:
+            return a->data.quaternion.element_type == b->data.quaternion.element_type;
+        case TYPE_COMPLEX:
+            return a->data.complex.element_type == b->data.complex.element_type;
+        case TYPE_FUNCTION:
+            return a->data.function.return_type == b->data.function.return_type &&
+                   a->data.function.parameter_count == b->data.function.parameter_count &&
+                   memcmp(a->data.function.parameter_types, b->data.function.parameter_types,
+                          a->data.function.parameter_count * sizeof(Type*)) == 0;
+        case TYPE_NAMED:
+            return a->data.named.name == b->data.named.name;
+        default:
+            return true;
+    }
+}
+
+static bool type_table_grow(void) {
+    size_t new_capacity = type_table.capacity * 2;
+    TypeSlot* new_slots = calloc(new_capacity, sizeof(TypeSlot));
+    if (new_slots == NULL) return false;
+
+    for (size_t i = 0; i < type_table.capacity; i++) {
+        TypeSlot slot = type_table.slots[i];
+        if (slot.type == NULL) continue;
+        size_t index = slot.hash & (new_capacity - 1);
+        while (new_slots[index].type != NULL) index = (index + 1) & (new_capacity - 1);
+        new_slots[index] = slot;
+    }
+
+    free(type_table.slots);
+    type_table.slots = new_slots;
+    type_table.capacity = new_capacity;
+    return true;
+}
+
+// keyと同じ構造の型を返す（なければ配列ごとアリーナに複製して加える）
+static const Type* type_intern_locked(const Type* key) {
+    uint32_t hash = type_key_hash(key);
+    size_t index = hash & (type_table.capacity - 1);
+    while (type_table.slots[index].type != NULL) {
+        TypeSlot* slot = &type_table.slots[index];
+        if (slot->hash == hash && type_key_equals(slot->type, key)) return slot->type;
+        index = (index + 1) & (type_table.capacity - 1);
+    }
+
+    Type* type = arena_memdup(type_table.arena, key, sizeof(Type));
+    if (type == NULL) return NULL;
+    switch (key->kind) {
+        case TYPE_TUPLE:
+            type->data.tuple.types = arena_memdup(type_table.arena, key->data.tuple.types,
+                                                  key->data.tuple.type_count * sizeof(Type*));
+            break;
+        case TYPE_TENSOR:
+            type->data.tensor.dimensions = arena_memdup(type_table.arena, key->data.tensor.dimensions,
+                                                        key->data.tensor.dimension_count * sizeof(size_t));
+            break;
+        case TYPE_FUNCTION:
+            type->data.function.parameter_types = arena_memdup(type_table.arena, key->data.function.parameter_types,
+                                                               key->data.function.parameter_count * sizeof(Type*));
+            break;
+        default:
+            break;
+    }
+    type->interned = true;
+    type_compute_layout(type);
+
+    type_table.slots[index].hash = hash;
+    type_table.slots[index].type = type;
+    type_table.count++;
+
+    // 負荷率が1/2を超えたら拡張する
+    if (type_table.count * 2 > type_table.capacity && !type_table_grow()) return NULL;
+    return type;
+}
+
+// 複数のスレッドから型を作れるよう、表を引くあいだはロックを取る
+static const Type* type_intern(const Type* key) {
+    if (type_table.slots == NULL && !type_table_init()) return NULL;
+
+    pthread_mutex_lock(&type_table_lock);
+    const Type* type = type_intern_locked(key);
+    pthread_mutex_unlock(&type_table_lock);
+    return type;
+}
+
+static void type_key_init(Type* key, TypeKind kind) {
+    memset(key, 0, sizeof(Type));
+    key->kind = kind;
+    key->alignment = 1;
+}
+
+static const Type* type_intern_primitive(TypeKind kind) {
+    Type key;
+    type_key_init(&key, kind);
+    return type_intern(&key);
+}
+
+// 型の表の初期化
+bool type_table_init(void) {
+    if (type_table.slots != NULL) return true;
+
+    type_table.arena = arena_create(TYPE_TABLE_ARENA_BLOCK_SIZE);
+    if (type_table.arena == NULL) return false;
+    type_table.slots = calloc(TYPE_TABLE_INITIAL_CAPACITY, sizeof(TypeSlot));
+    if (type_table.slots == NULL) {
+        arena_destroy(type_table.arena);
+        type_table.arena = NULL;
+        return false;
+    }
+    type_table.capacity = TYPE_TABLE_INITIAL_CAPACITY;
+    type_table.count = 0;
+
+    type_table.integer_type = type_intern_primitive(TYPE_INTEGER);
+    type_table.float_type = type_intern_primitive(TYPE_FLOAT);
+    type_table.boolean_type = type_intern_primitive(TYPE_BOOLEAN);
+    type_table.string_type = type_intern_primitive(TYPE_STRING);
+    type_table.void_type = type_intern_primitive(TYPE_VOID);
+    return true;
+}
+
+// 型の表の破棄（全ての表の型が無効になる）
+void type_table_shutdown(void) {
+    free(type_table.slots);
+    arena_destroy(type_table.arena);
+    memset(&type_table, 0, sizeof(type_table));
+}
+
+size_t type_table_count(void) {
+    pthread_mutex_lock(&type_table_lock);
+    size_t count = type_table.count;
+    pthread_mutex_unlock(&type_table_lock);
+    return count;
+}
+
+// プリミティブ型は表を引かずに返す
+const Type* type_primitive(TypeKind kind) {
+    if (type_table.slots == NULL && !type_table_init()) return NULL;
+    switch (kind) {
+        case TYPE_INTEGER: return type_table.integer_type;
+        case TYPE_FLOAT:   return type_table.float_type;
+        case TYPE_BOOLEAN: return type_table.boolean_type;
+        case TYPE_STRING:  return type_table.string_type;
+        case TYPE_VOID:    return type_table.void_type;
+        default:           return type_intern_primitive(kind);
+    }
+}
+
+const Type* type_array_of(const Type* element) {
+    if (!element) return NULL;
+    Type key;
+    type_key_init(&key, TYPE_ARRAY);
+    key.data.array.element_type = (Type*)element;
+    return type_intern(&key);
+}
+
+const Type* type_tuple_of(const Type* const* types, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!types[i]) return NULL;
+    }
+    Type key;
+    type_key_init(&key, TYPE_TUPLE);
+    key.data.tuple.types = (Type**)types;
+    key.data.tuple.type_count = count;
+    return type_intern(&key);
+}
+
+const Type* type_vector_of(const Type* element, size_t dimension) {
+    if (!element) return NULL;
+    Type key;
+    type_key_init(&key, TYPE_VECTOR);
+    key.data.vector.element_type = (Type*)element;
+    key.data.vector.dimension = dimension;
+    return type_intern(&key);
+}
+
+const Type* type_matrix_of(const Type* element, size_t rows, size_t columns) {
+    if (!element) return NULL;
+    Type key;
+    type_key_init(&key, TYPE_MATRIX);
+    key.data.matrix.element_type = (Type*)element;
+    key.data.matrix.rows = rows;
+    key.data.matrix.columns = columns;
+    return type_intern(&key);
+}
+
+const Type* type_tensor_of(const Type* element, const size_t* dimensions, size_t count) {
+    if (!element) return NULL;
+    Type key;
+    type_key_init(&key, TYPE_TENSOR);
+    key.data.tensor.element_type = (Type*)element;
+    key.data.tensor.dimensions = (size_t*)dimensions;
+    key.data.tensor.dimension_count = count;
+    return type_intern(&key);
+}
+
+const Type* type_quaternion_of(const Type* element) {
+    if (!element) return NULL;
+    Type key;
+    type_key_init(&key, TYPE_QUATERNION);
+    key.data.quaternion.element_type = (Type*)element;
+    return type_intern(&key);
+}
+
+const Type* type_complex_of(const Type* element) {
+    if (!element) return NULL;
+    Type key;
+    type_key_init(&key, TYPE_COMPLEX);
+    key.data.complex.element_type = (Type*)element;
+    return type_intern(&key);
+}
+
+const Type* type_function_of(const Type* const* parameters, size_t count, const Type* return_type) {
+    if (!return_type) return NULL;
+    for (size_t i = 0; i < count; i++) {
+        if (!parameters[i]) return NULL;
+    }
+    Type key;
+    type_key_init(&key, TYPE_FUNCTION);
+    key.data.function.parameter_types = (Type**)parameters;
+    key.data.function.parameter_count = count;
+    key.data.function.return_type = (Type*)return_type;
+    return type_intern(&key);
+}
+
+// 注釈のない（実行時に決まる）引数や戻り値をNULLのまま持つ関数型
+const Type* type_signature_of(const Type* const* parameters, size_t count, const Type* return_type) {
+    Type key;
+    type_key_init(&key, TYPE_FUNCTION);
+    key.data.function.parameter_types = (Type**)parameters;
+    key.data.function.parameter_count = count;
+    key.data.function.return_type = (Type*)return_type;
+    return type_intern(&key);
+}
+
+// 名前はインターンしてから引く
+const Type* type_named_of(const char* name) {
+    const char* handle = intern_cstr(name);
+    if (!handle) return NULL;
+    Type key;
+    type_key_init(&key, TYPE_NAMED);
+    key.data.named.name = (char*)handle;
+    return type_intern(&key);
+}
+
+const Type* type_canonical(const Type* type) {
+    if (!type) return NULL;
+    if (type->interned) return type;
+    switch (type->kind) {
+        case TYPE_ARRAY:
+            return type_array_of(type_canonical(type->data.array.element_type));
+        case TYPE_TUPLE: {
+            size_t count = type->data.tuple.type_count;
+            const Type** types = malloc((count ? count : 1) * sizeof(const Type*));
+            if (!types) return NULL;
+            for (size_t i = 0; i < count; i++) types[i] = type_canonical(type->data.tuple.types[i]);
+            const Type* result = type_tuple_of(types, count);
+            free(types);
+            return result;
+        }
+        case TYPE_VECTOR:
+            return type_vector_of(type_canonical(type->data.vector.element_type), type->data.vector.dimension);
+        case TYPE_MATRIX:
+            return type_matrix_of(type_canonical(type->data.matrix.element_type),
+                                  type->data.matrix.rows, type->data.matrix.columns);
+        case TYPE_TENSOR:
+            return type_tensor_of(type_canonical(type->data.tensor.element_type),
+                                  type->data.tensor.dimensions, type->data.tensor.dimension_count);
+        case TYPE_QUATERNION:
+            return type_quaternion_of(type_canonical(type->data.quaternion.element_type));
+        case TYPE_COMPLEX:
+            return type_complex_of(type_canonical(type->data.complex.element_type));
+        case TYPE_FUNCTION: {
+            size_t count = type->data.function.parameter_count;
+            const Type** parameters = malloc((count ? count : 1) * sizeof(const Type*));
+            if (!parameters) return NULL;
+            for (size_t i = 0; i < count; i++) parameters[i] = type_canonical(type->data.function.parameter_types[i]);
+            const Type* result = type_function_of(parameters, count, type_canonical(type->data.function.return_type));
+            free(parameters);
+            return result;
+        }
+        case TYPE_NAMED:
+            return type_named_of(type->data.named.name);
+        default:
+            return type_primitive(type->kind);
+    }
+}
+
 // Type kind checks
 bool type_is_vector(const Type* type) {
     return type && type->kind == TYPE_VECTOR;
@@ -135,6 +532,65 @@ bool type_is_named(const Type* type) {
     return type && type->kind == TYPE_NAMED;
 }
 
+// Memory layout (see type_system.h)
+static size_t simd_round(size_t elements) {
+    return (elements + 1) & ~(size_t)1;
+}
+
+void type_compute_layout(Type* type) {
+    if (!type) return;
+    size_t elements = 0;
+    switch (type->kind) {
+        case TYPE_INTEGER:
+        case TYPE_FLOAT:
+        case TYPE_STRING:
+            type->size = TYPE_ELEMENT_SIZE;
+            type->alignment = TYPE_ELEMENT_SIZE;
+            return;
+        case TYPE_BOOLEAN:
+            type->size = 1;
+            type->alignment = 1;
+            return;
+        case TYPE_VECTOR:
+            elements = simd_round(type->data.vector.dimension);
+            break;
+        case TYPE_MATRIX:
+            // column-major, each column padded to a whole register
+            elements = type->data.matrix.columns * simd_round(type->data.matrix.rows);
+            break;
+        case TYPE_TENSOR: {
+            size_t count = type->data.tensor.dimension_count;
+            elements = count > 0 ? simd_round(type->data.tensor.dimensions[count - 1]) : 0;
+            for (size_t i = 0; i + 1 < count; i++) elements *= type->data.tensor.dimensions[i];
+            break;
+        }
+        case TYPE_QUATERNION:
+            elements = 4;
+            break;
+        case TYPE_COMPLEX:
+            elements = 2;
+            break;
+        default:
+            return;
+    }
+    type->size = elements * TYPE_ELEMENT_SIZE;
+    type->alignment = TYPE_SIMD_ALIGNMENT;
+}
+
+size_t type_simd_elements(const Type* type) {
+    if (!type) return 0;
+    switch (type->kind) {
+        case TYPE_VECTOR:
+        case TYPE_MATRIX:
+        case TYPE_TENSOR:
+        case TYPE_QUATERNION:
+        case TYPE_COMPLEX:
+            return type->size / TYPE_ELEMENT_SIZE;
+        default:
+            return 0;
+    }
+}
+
 // Type information getters
 size_t type_get_vector_dimension(const Type* type) {
     return type_is_vector(type) ? type->data.vector.dimension : 0;
@@ -169,8 +625,11 @@ bool type_get_function_signature(const Type* type, Type*** params, size_t* param
 }
 
 // Type compatibility
+// 表の型どうしは構造が同じなら同じポインタなので、比較は1回で済む
 bool type_is_compatible_with(const Type* type1, const Type* type2) {
+    if (type1 == type2) return type1 != NULL;
     if (!type1 || !type2) return false;
+    if (type1->interned && type2->interned) return false;
     
     if (type1->kind != type2->kind) return false;
     
@@ -230,13 +689,17 @@ bool type_is_compatible_with(const Type* type1, const Type* type2) {
             return true;
             
         case TYPE_NAMED:
-            return strcmp(type1->data.named.name, type2->data.named.name) == 0;
+            return type1->data.named.name == type2->data.named.name;
             
         default:
             return false;
     }
 }
 
+bool type_equals(const Type* a, const Type* b) {
+    return type_is_compatible_with(a, b);
+}
+
 bool type_can_own(const Type* type1, const Type* type2) {
     if (!type1 || !type2) return false;
     
@@ -332,13 +795,14 @@ char* type_to_string(const Type* type) {
             
         case TYPE_TENSOR: {
             char* element_str = type_to_string(type->data.tensor.element_type);
-            char* dims = malloc(type->data.tensor.dimension_count * 4 + 1); // Each dimension can be up to 3 digits + 'x'
+            char* dims = malloc(type->data.tensor.dimension_count * 21 + 1); // up to 20 digits + 'x' per dimension
             char* ptr = dims;
+            *ptr = '\0';
             
             for (size_t i = 0; i < type->data.tensor.dimension_count; i++) {
                 ptr += sprintf(ptr, "%zux", type->data.tensor.dimensions[i]);
             }
-            *(ptr - 1) = '\0'; // Remove last 'x'
+            if (ptr != dims) *(ptr - 1) = '\0'; // Remove last 'x'
             
             asprintf(&result, "tensor<%s><%s>", dims, element_str);
             free(dims);
@@ -370,7 +834,7 @@ char* type_to_string(const Type* type) {
             }
             
             char* return_str = type_to_string(type->data.function.return_type);
-            total_len += strlen(return_str) + 4; // +4 for " -> "
+            total_len += strlen(return_str) + 5; // +5 for ") -> " and the terminator
             
             result = malloc(total_len);
             char* ptr = result;
@@ -387,7 +851,7 @@ char* type_to_string(const Type* type) {
             }
             
             strcpy(ptr, ") -> ");
-            ptr += 6;
+            ptr += 5;
             strcpy(ptr, return_str);
             free(return_str);
             break;
@@ -406,111 +870,25 @@ char* type_to_string(const Type* type) {
 }
 
 // Type inference
-Type* type_infer(ASTNode* node) {
+// 結果は表の型なので、推論中に型を作ったり解放したりしない（型の規則はtype_checker.cにまとめてある）
+const Type* type_infer(ASTNode* node) {
     if (node == NULL) return NULL;
 
-    switch (node->type) {
-        case NODE_LITERAL:
-            switch (node->as.literal.type) {
-                case LITERAL_INTEGER:
-                    return type_new(TYPE_INTEGER);
-                case LITERAL_FLOAT:
-                    return type_new(TYPE_FLOAT);
-                case LITERAL_STRING:
-                    return type_new(TYPE_STRING);
-                case LITERAL_BOOLEAN:
-                    return type_new(TYPE_BOOLEAN);
-                case LITERAL_NULL:
-                    return type_new(TYPE_VOID);
-            }
-            break;
-
-        case NODE_BINARY: {
-            Type* left_type = type_infer(node->as.binary.left);
-            Type* right_type = type_infer(node->as.binary.right);
-            
-            if (left_type == NULL || right_type == NULL) {
-                type_free(left_type);
-                type_free(right_type);
-                return NULL;
-            }
-
-            // Check operator type
-            switch (node->as.binary.operator) {
-                case TOKEN_PLUS:
-                case TOKEN_MINUS:
-                case TOKEN_STAR:
-                case TOKEN_SLASH:
-                    if (left_type->kind == TYPE_INTEGER && right_type->kind == TYPE_INTEGER) {
-                        type_free(right_type);
-                        return left_type;
-                    }
-                    if ((left_type->kind == TYPE_FLOAT || left_type->kind == TYPE_INTEGER) &&
-                        (right_type->kind == TYPE_FLOAT || right_type->kind == TYPE_INTEGER)) {
-                        type_free(left_type);
-                        return right_type;
-                    }
-                    break;
-
-                case TOKEN_EQ:
-                case TOKEN_NEQ:
-                case TOKEN_LT:
-                case TOKEN_GT:
-                case TOKEN_LE:
-                case TOKEN_GE:
-                    if (type_is_compatible_with(left_type, right_type)) {
-                        type_free(left_type);
-                        type_free(right_type);
-                        return type_new(TYPE_BOOLEAN);
-                    }
-                    break;
-            }
-
-            type_free(left_type);
-            type_free(right_type);
-            return NULL;
-        }
-
-        case NODE_UNARY: {
-            Type* operand_type = type_infer(node->as.unary.operand);
-            if (operand_type == NULL) return NULL;
-
-            switch (node->as.unary.operator) {
-                case TOKEN_MINUS:
-                    if (operand_type->kind == TYPE_INTEGER || operand_type->kind == TYPE_FLOAT) {
-                        return operand_type;
-                    }
-                    break;
-                case TOKEN_BANG:
-                    if (operand_type->kind == TYPE_BOOLEAN) {
-                        type_free(operand_type);
-                        return type_new(TYPE_BOOLEAN);
-                    }
-                    break;
-            }
-
-            type_free(operand_type);
-            return NULL;
-        }
-
-        // TODO: Implement type inference for other node types
-
-        default:
-            return NULL;
-    }
-
-    return NULL;
+    TypeChecker* checker = type_checker_create();
+    if (checker == NULL) return NULL;
+    const Type* type = NULL;
+    if (type_checker_infer(checker, node, &type) != SLANG_SUCCESS) type = NULL;
+    type_checker_destroy(checker);
+    return type;
 }
 
 // Type checking
 SlangError type_check(ASTNode* node) {
     if (node == NULL) return SLANG_SUCCESS;
 
-    Type* inferred_type = type_infer(node);
-    if (inferred_type == NULL) {
-        return SLANG_ERROR_TYPE;
-    }
-
-    type_free(inferred_type);
-    return SLANG_SUCCESS;
+    TypeChecker* checker = type_checker_create();
+    if (checker == NULL) return SLANG_ERROR_INTERNAL;
+    SlangError error = type_checker_check(checker, &node, 1);
+    type_checker_destroy(checker);
+    return error;
 } 
\ No newline at end of file
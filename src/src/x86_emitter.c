@@ -0,0 +1,944 @@
+#include "../include/x86_emitter.h"
+#include "../include/profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// System V ABIの引数レジスタ
+static const uint8_t int_argument_registers[] = { X86_RDI, X86_RSI, X86_RDX, X86_RCX, X86_R8, X86_R9 };
+#define INT_ARGUMENT_COUNT 6
+#define FLOAT_ARGUMENT_COUNT 8
+
+// 退避するcallee-savedレジスタ（この順にpushする）
+static const uint8_t saved_registers[] = { X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15 };
+#define SAVED_REGISTER_COUNT (sizeof(saved_registers) / sizeof(saved_registers[0]))
+
+typedef struct {
+    AsmWriter* out;
+    const IrFunction* function;
+    const RegisterAllocation* allocation;
+    X86EmitStats* stats;
+    uint32_t frame_base;       // 退避レジスタの分（スピルスロットはこの下に並ぶ）
+    uint32_t* stack_offsets;   // IR_STACK_ALLOCの領域の先頭のrbpからの距離（命令ごと）
+    uint32_t* use_counts;
+    uint32_t* def_counts;
+    bool* immediate;           // 即値として使う定数（IR_CONSTを出力しない）
+    int64_t* immediate_values;
+} X86Emitter;
+
+typedef struct {
+    Location to;
+    Location from;
+} ParallelMove;
+
+// 命令の出力
+static void emit(X86Emitter* emitter, AsmOp op, AsmOperand a, AsmOperand b) {
+    asm_emit(emitter->out, op, a, b);
+    emitter->stats->instructions++;
+    if (asm_is_memory(a) || asm_is_memory(b) || op == ASM_PUSH || op == ASM_POP) {
+        emitter->stats->memory_accesses++;
+    }
+}
+
+static void emit1(X86Emitter* emitter, AsmOp op, AsmOperand a) {
+    emit(emitter, op, a, asm_none());
+}
+
+static void emit0(X86Emitter* emitter, AsmOp op) {
+    emit(emitter, op, asm_none(), asm_none());
+}
+
+// ラベル（番号はIRのラベル、その後ろに出口と内部用のラベルを並べる）
+static AsmOperand label_ref(X86Emitter* emitter, uint64_t label) {
+    return asm_label_ref(emitter->function->name, label);
+}
+
+static uint64_t exit_label(X86Emitter* emitter) {
+    return emitter->function->label_count;
+}
+
+static uint64_t local_label(X86Emitter* emitter, size_t index) {
+    return (uint64_t)emitter->function->label_count + 1 + index;
+}
+
+static const Location* location_of(X86Emitter* emitter, IrValue value) {
+    return &emitter->allocation->locations[value];
+}
+
+static Location gpr_location(uint8_t reg) {
+    return (Location){ LOCATION_GPR, reg, 0 };
+}
+
+static Location xmm_location(uint8_t reg) {
+    return (Location){ LOCATION_XMM, reg, 0 };
+}
+
+static bool same_location(const Location* a, const Location* b) {
+    if (a->kind != b->kind) return false;
+    return a->kind == LOCATION_STACK ? a->slot == b->slot : a->reg == b->reg;
+}
+
+static AsmOperand location_operand(X86Emitter* emitter, const Location* location) {
+    switch (location->kind) {
+        case LOCATION_GPR: return asm_reg((X86Register)location->reg);
+        case LOCATION_XMM: return asm_xmm(location->reg);
+        default:           return asm_frame(-(int64_t)(emitter->frame_base + 8 * (location->slot + 1)));
+    }
+}
+
+// 値のオペランド（即値にした定数はその値）
+static AsmOperand operand(X86Emitter* emitter, IrValue value) {
+    if (emitter->immediate[value]) return asm_imm(emitter->immediate_values[value]);
+    return location_operand(emitter, location_of(emitter, value));
+}
+
+static AsmOperand scratch_gpr(void) {
+    return asm_reg(REGALLOC_SCRATCH_GPR);
+}
+
+// 置き場所同士の転送
+static void move_location(X86Emitter* emitter, const Location* to, const Location* from) {
+    if (same_location(to, from) || to->kind == LOCATION_NONE || from->kind == LOCATION_NONE) return;
+
+    AsmOperand dst = location_operand(emitter, to);
+    AsmOperand src = location_operand(emitter, from);
+
+    if (to->kind == LOCATION_STACK && from->kind == LOCATION_STACK) {
+        emit(emitter, ASM_MOV, scratch_gpr(), src);
+        emit(emitter, ASM_MOV, dst, scratch_gpr());
+    } else if (to->kind == LOCATION_XMM && from->kind == LOCATION_XMM) {
+        emit(emitter, ASM_MOVAPD, dst, src);
+    } else if (to->kind == LOCATION_XMM || from->kind == LOCATION_XMM) {
+        // XMMとGPRの間はmovq、XMMとメモリの間はmovsd
+        bool via_gpr = to->kind == LOCATION_GPR || from->kind == LOCATION_GPR;
+        emit(emitter, via_gpr ? ASM_MOVQ : ASM_MOVSD, dst, src);
+    } else {
+        emit(emitter, ASM_MOV, dst, src);
+    }
+}
+
+static void load_gpr(X86Emitter* emitter, uint8_t reg, IrValue value) {
+    if (emitter->immediate[value]) {
+        emit(emitter, ASM_MOV, asm_reg((X86Register)reg), operand(emitter, value));
+        return;
+    }
+    Location to = gpr_location(reg);
+    move_location(emitter, &to, location_of(emitter, value));
+}
+
+static void store_gpr(X86Emitter* emitter, IrValue value, uint8_t reg) {
+    Location from = gpr_location(reg);
+    move_location(emitter, location_of(emitter, value), &from);
+}
+
+static void load_xmm(X86Emitter* emitter, uint8_t reg, IrValue value) {
+    Location to = xmm_location(reg);
+    move_location(emitter, &to, location_of(emitter, value));
+}
+
+static void store_xmm(X86Emitter* emitter, IrValue value, uint8_t reg) {
+    Location from = xmm_location(reg);
+    move_location(emitter, location_of(emitter, value), &from);
+}
+
+// 結果を計算するレジスタ（結果がスタックなら作業用レジスタ）
+static uint8_t int_target(X86Emitter* emitter, IrValue value) {
+    const Location* location = location_of(emitter, value);
+    return location->kind == LOCATION_GPR ? location->reg : REGALLOC_SCRATCH_GPR;
+}
+
+static uint8_t float_target(X86Emitter* emitter, IrValue value) {
+    const Location* location = location_of(emitter, value);
+    return location->kind == LOCATION_XMM ? location->reg : REGALLOC_SCRATCH_XMM;
+}
+
+static bool in_register(X86Emitter* emitter, IrValue value, LocationKind kind, uint8_t reg) {
+    const Location* location = location_of(emitter, value);
+    return !emitter->immediate[value] && location->kind == kind && location->reg == reg;
+}
+
+// 並列代入（後の転送元を先に壊さなければ順に、そうでなければスタック経由で入れ替える）
+static void emit_parallel_move(X86Emitter* emitter, const ParallelMove* moves, size_t count) {
+    bool direct = true;
+    for (size_t i = 0; i < count && direct; i++) {
+        for (size_t j = i + 1; j < count; j++) {
+            if (moves[i].to.kind != LOCATION_STACK && same_location(&moves[i].to, &moves[j].from)) {
+                direct = false;
+                break;
+            }
+        }
+    }
+
+    if (direct) {
+        for (size_t i = 0; i < count; i++) move_location(emitter, &moves[i].to, &moves[i].from);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const Location* from = &moves[i].from;
+        if (from->kind == LOCATION_XMM) {
+            emit(emitter, ASM_SUB, asm_reg(X86_RSP), asm_imm(8));
+            emit(emitter, ASM_MOVSD, asm_stack(0), asm_xmm(from->reg));
+        } else {
+            emit1(emitter, ASM_PUSH, location_operand(emitter, from));
+        }
+    }
+    for (size_t i = count; i-- > 0;) {
+        const Location* to = &moves[i].to;
+        if (to->kind == LOCATION_XMM) {
+            emit(emitter, ASM_MOVSD, asm_xmm(to->reg), asm_stack(0));
+            emit(emitter, ASM_ADD, asm_reg(X86_RSP), asm_imm(8));
+        } else {
+            emit1(emitter, ASM_POP, location_operand(emitter, to));
+        }
+    }
+}
+
+// 引数をABIのレジスタへ割り振る
+static SlangError abi_locations(const uint8_t* types, size_t count, Location* locations) {
+    size_t ints = 0, floats = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (types[i] == IR_FLOAT) {
+            if (floats == FLOAT_ARGUMENT_COUNT) return SLANG_ERROR_INTERNAL;
+            locations[i] = xmm_location((uint8_t)floats++);
+        } else {
+            if (ints == INT_ARGUMENT_COUNT) return SLANG_ERROR_INTERNAL;
+            locations[i] = gpr_location(int_argument_registers[ints++]);
+        }
+    }
+    return SLANG_SUCCESS;
+}
+
+// 整数の二項演算（add/sub/imul）
+static void emit_int_arithmetic(X86Emitter* emitter, const IrInstruction* instruction, AsmOp op, bool commutative) {
+    IrValue a = instruction->a, b = instruction->b;
+    uint8_t target = int_target(emitter, instruction->dest);
+
+    // 結果がbのレジスタに重なるなら、可換なら入れ替え、そうでなければ作業用レジスタで計算する
+    if (in_register(emitter, b, LOCATION_GPR, target) && !in_register(emitter, a, LOCATION_GPR, target)) {
+        if (commutative && !emitter->immediate[a]) {
+            IrValue swap = a;
+            a = b;
+            b = swap;
+        } else {
+            target = REGALLOC_SCRATCH_GPR;
+        }
+    }
+
+    load_gpr(emitter, target, a);
+    emit(emitter, op, asm_reg((X86Register)target), operand(emitter, b));
+    store_gpr(emitter, instruction->dest, target);
+}
+
+static void emit_int_division(X86Emitter* emitter, const IrInstruction* instruction) {
+    load_gpr(emitter, X86_RAX, instruction->a);
+    emit0(emitter, ASM_CQO);
+    emit1(emitter, ASM_IDIV, operand(emitter, instruction->b));
+    store_gpr(emitter, instruction->dest, instruction->op == IR_MOD ? X86_RDX : X86_RAX);
+}
+
+static void emit_float_arithmetic(X86Emitter* emitter, const IrInstruction* instruction, AsmOp op, bool commutative) {
+    IrValue a = instruction->a, b = instruction->b;
+    uint8_t target = float_target(emitter, instruction->dest);
+
+    if (in_register(emitter, b, LOCATION_XMM, target) && !in_register(emitter, a, LOCATION_XMM, target)) {
+        if (commutative) {
+            IrValue swap = a;
+            a = b;
+            b = swap;
+        } else {
+            target = REGALLOC_SCRATCH_XMM;
+        }
+    }
+
+    load_xmm(emitter, target, a);
+    emit(emitter, op, asm_xmm(target), operand(emitter, b));
+    store_xmm(emitter, instruction->dest, target);
+}
+
+// 比較してフラグを立てる
+static void emit_compare_flags(X86Emitter* emitter, const IrInstruction* instruction) {
+    if (instruction->type == IR_FLOAT) {
+        // a < b は b > a として比べ、NaNのとき偽になる条件（above系）だけを使う
+        bool swap = instruction->op == IR_LT || instruction->op == IR_LE;
+        IrValue x = swap ? instruction->b : instruction->a;
+        IrValue y = swap ? instruction->a : instruction->b;
+        uint8_t reg = location_of(emitter, x)->kind == LOCATION_XMM ? location_of(emitter, x)->reg : REGALLOC_SCRATCH_XMM;
+        load_xmm(emitter, reg, x);
+        emit(emitter, ASM_UCOMISD, asm_xmm(reg), operand(emitter, y));
+        return;
+    }
+
+    const Location* a = location_of(emitter, instruction->a);
+    AsmOperand lhs = operand(emitter, instruction->a);
+    if (a->kind != LOCATION_GPR && (emitter->immediate[instruction->a] || location_of(emitter, instruction->b)->kind == LOCATION_STACK)) {
+        load_gpr(emitter, REGALLOC_SCRATCH_GPR, instruction->a);
+        lhs = scratch_gpr();
+    }
+    emit(emitter, ASM_CMP, lhs, operand(emitter, instruction->b));
+}
+
+// 比較結果が真になる条件
+static AsmCondition int_condition(IrOpcode op) {
+    switch (op) {
+        case IR_EQ: return ASM_CC_E;
+        case IR_NE: return ASM_CC_NE;
+        case IR_LT: return ASM_CC_L;
+        case IR_LE: return ASM_CC_LE;
+        case IR_GT: return ASM_CC_G;
+        default:    return ASM_CC_GE;
+    }
+}
+
+static AsmCondition int_inverse_condition(IrOpcode op) {
+    switch (op) {
+        case IR_EQ: return ASM_CC_NE;
+        case IR_NE: return ASM_CC_E;
+        case IR_LT: return ASM_CC_GE;
+        case IR_LE: return ASM_CC_G;
+        case IR_GT: return ASM_CC_LE;
+        default:    return ASM_CC_L;
+    }
+}
+
+static void emit_compare(X86Emitter* emitter, const IrInstruction* instruction) {
+    emit_compare_flags(emitter, instruction);
+    X86Register target = (X86Register)int_target(emitter, instruction->dest);
+    IrOpcode op = (IrOpcode)instruction->op;
+
+    if (instruction->type == IR_FLOAT && (op == IR_EQ || op == IR_NE)) {
+        // 順序なし（NaN）ではPFが立つ
+        emit1(emitter, op == IR_EQ ? ASM_SETE : ASM_SETNE, asm_reg8(X86_RAX));
+        emit1(emitter, op == IR_EQ ? ASM_SETNP : ASM_SETP, asm_reg8(X86_RDX));
+        emit(emitter, op == IR_EQ ? ASM_AND : ASM_OR, asm_reg8(X86_RAX), asm_reg8(X86_RDX));
+        emit(emitter, ASM_MOVZX, asm_reg32(target), asm_reg8(X86_RAX));
+    } else {
+        AsmCondition condition = instruction->type == IR_FLOAT
+            ? (op == IR_LT || op == IR_GT ? ASM_CC_A : ASM_CC_AE)
+            : int_condition(op);
+        emit1(emitter, asm_set(condition), asm_reg8(target));
+        emit(emitter, ASM_MOVZX, asm_reg32(target), asm_reg8(target));
+    }
+    store_gpr(emitter, instruction->dest, target);
+}
+
+// 比較と条件分岐をまとめて出力する（偽のときlabelへ飛ぶ）
+static void emit_compare_branch(X86Emitter* emitter, const IrInstruction* compare, size_t index, uint32_t label) {
+    emit_compare_flags(emitter, compare);
+    IrOpcode op = (IrOpcode)compare->op;
+
+    if (compare->type != IR_FLOAT) {
+        emit1(emitter, asm_jump(int_inverse_condition(op)), label_ref(emitter, label));
+    } else if (op == IR_EQ) {
+        emit1(emitter, ASM_JNE, label_ref(emitter, label));
+        emit1(emitter, ASM_JP, label_ref(emitter, label));
+    } else if (op == IR_NE) {
+        // 偽になるのは等しく、かつ順序ありのときだけ
+        emit1(emitter, ASM_JP, label_ref(emitter, local_label(emitter, index)));
+        emit1(emitter, ASM_JE, label_ref(emitter, label));
+        asm_label(emitter->out, emitter->function->name, local_label(emitter, index));
+    } else {
+        emit1(emitter, op == IR_LT || op == IR_GT ? ASM_JBE : ASM_JB, label_ref(emitter, label));
+    }
+}
+
+// ベクトル演算（SSE2のパックドdouble、2要素ずつ）
+// ポインタがスタックにあればr11・rax・rdxに読み、XMMはすべて作業用に使う（regalloc.hを参照）
+#define VECTOR_GROUP 4         // 要素ごとの演算で同時に読むXMMの数
+
+static X86Register vector_pointer(X86Emitter* emitter, IrValue value, X86Register scratch) {
+    const Location* location = location_of(emitter, value);
+    if (location->kind == LOCATION_GPR) return (X86Register)location->reg;
+    load_gpr(emitter, scratch, value);
+    return scratch;
+}
+
+// 要素ごとの演算（要素数が奇数なら最後の詰め物の要素まで計算する。複製ではopを使わない）
+static void emit_vector_elementwise(X86Emitter* emitter, const IrInstruction* instruction, AsmOp op) {
+    X86Register dst = vector_pointer(emitter, instruction->args[0], REGALLOC_SCRATCH_GPR);
+    X86Register a = vector_pointer(emitter, instruction->a, X86_RAX);
+    bool scale = instruction->op == IR_VEC_SCALE;
+    bool copy = instruction->op == IR_VEC_COPY;
+    X86Register b = X86_RDX;
+    if (scale) {
+        load_xmm(emitter, REGALLOC_SCRATCH_XMM, instruction->b);
+        emit(emitter, ASM_UNPCKLPD, asm_xmm(REGALLOC_SCRATCH_XMM), asm_xmm(REGALLOC_SCRATCH_XMM));
+    } else if (!copy) {
+        b = vector_pointer(emitter, instruction->b, X86_RDX);
+    }
+
+    int64_t pairs = (instruction->imm.integer + 1) / 2;
+    for (int64_t i = 0; i < pairs; i += VECTOR_GROUP) {
+        int64_t group = pairs - i < VECTOR_GROUP ? pairs - i : VECTOR_GROUP;
+        for (int64_t k = 0; k < group; k++) {
+            emit(emitter, ASM_MOVAPD, asm_xmm((unsigned)k), asm_base(a, 16 * (i + k)));
+        }
+        for (int64_t k = 0; k < group && !copy; k++) {
+            emit(emitter, op, asm_xmm((unsigned)k), scale ? asm_xmm(REGALLOC_SCRATCH_XMM) : asm_base(b, 16 * (i + k)));
+        }
+        for (int64_t k = 0; k < group; k++) {
+            emit(emitter, ASM_MOVAPD, asm_base(dst, 16 * (i + k)), asm_xmm((unsigned)k));
+        }
+    }
+}
+
+// 内積（偶数番と奇数番の要素の和を別々に求めてから足す）
+static void emit_vector_dot(X86Emitter* emitter, const IrInstruction* instruction) {
+    X86Register a = vector_pointer(emitter, instruction->a, X86_RAX);
+    X86Register b = vector_pointer(emitter, instruction->b, X86_RDX);
+    int64_t count = instruction->imm.integer;
+    int64_t pairs = count / 2;
+
+    if (pairs == 0) {
+        emit(emitter, ASM_XORPD, asm_xmm(0), asm_xmm(0));
+    } else {
+        emit(emitter, ASM_MOVAPD, asm_xmm(0), asm_base(a, 0));
+        emit(emitter, ASM_MULPD, asm_xmm(0), asm_base(b, 0));
+        for (int64_t i = 1; i < pairs; i++) {
+            emit(emitter, ASM_MOVAPD, asm_xmm(1), asm_base(a, 16 * i));
+            emit(emitter, ASM_MULPD, asm_xmm(1), asm_base(b, 16 * i));
+            emit(emitter, ASM_ADDPD, asm_xmm(0), asm_xmm(1));
+        }
+        emit(emitter, ASM_MOVAPD, asm_xmm(1), asm_xmm(0));
+        emit(emitter, ASM_UNPCKHPD, asm_xmm(1), asm_xmm(1));
+        emit(emitter, ASM_ADDSD, asm_xmm(0), asm_xmm(1));
+    }
+    if (count % 2 != 0) {
+        emit(emitter, ASM_MOVSD, asm_xmm(1), asm_base(a, 8 * (count - 1)));
+        emit(emitter, ASM_MULSD, asm_xmm(1), asm_base(b, 8 * (count - 1)));
+        emit(emitter, ASM_ADDSD, asm_xmm(0), asm_xmm(1));
+    }
+    store_xmm(emitter, instruction->dest, 0);
+}
+
+// 1要素をxmmの両側に読む
+static void emit_broadcast(X86Emitter* emitter, unsigned xmm, X86Register base, int64_t displacement) {
+    emit(emitter, ASM_MOVSD, asm_xmm(xmm), asm_base(base, displacement));
+    emit(emitter, ASM_UNPCKLPD, asm_xmm(xmm), asm_xmm(xmm));
+}
+
+// target = x * y（xは壊さない）
+static void emit_product(X86Emitter* emitter, unsigned target, unsigned x, unsigned y) {
+    emit(emitter, ASM_MOVAPD, asm_xmm(target), asm_xmm(x));
+    emit(emitter, ASM_MULPD, asm_xmm(target), asm_xmm(y));
+}
+
+// 4x4行列の積（列優先）。Aの4列をxmm0〜7に読み、Cのj列 = Σk A[k列] * B[k][j]
+// Aを先に読み切り、Bのj列はCのj列を書く前に読むので、書き込み先はaかbと同じでよい
+static void emit_mat4_mul(X86Emitter* emitter, const IrInstruction* instruction) {
+    X86Register dst = vector_pointer(emitter, instruction->args[0], REGALLOC_SCRATCH_GPR);
+    X86Register a = vector_pointer(emitter, instruction->a, X86_RAX);
+    X86Register b = vector_pointer(emitter, instruction->b, X86_RDX);
+
+    for (unsigned k = 0; k < 8; k++) emit(emitter, ASM_MOVAPD, asm_xmm(k), asm_base(a, 16 * k));
+    for (int64_t j = 0; j < 4; j++) {
+        for (unsigned k = 0; k < 4; k++) {
+            emit_broadcast(emitter, 11, b, 32 * j + 8 * k);
+            emit_product(emitter, k == 0 ? 8 : 12, 2 * k, 11);
+            emit_product(emitter, k == 0 ? 9 : 13, 2 * k + 1, 11);
+            if (k == 0) continue;
+            emit(emitter, ASM_ADDPD, asm_xmm(8), asm_xmm(12));
+            emit(emitter, ASM_ADDPD, asm_xmm(9), asm_xmm(13));
+        }
+        emit(emitter, ASM_MOVAPD, asm_base(dst, 32 * j), asm_xmm(8));
+        emit(emitter, ASM_MOVAPD, asm_base(dst, 32 * j + 16), asm_xmm(9));
+    }
+}
+
+// 四元数の積（Hamilton積）。aを(w, x)と(y, z)の組とその入れ替え、bの成分を両側に広げた値
+// （bxとbzは下側の符号を反転）で、依存の連鎖が短くなるように2つずつ足す
+//   (w, x) = (bw*(aw, ax) + (-bx, bx)*(ax, aw)) + ((-bz, bz)*(az, ay) - by*(ay, az))
+//   (y, z) = (bw*(ay, az) + by*(aw, ax)) + ((-bz, bz)*(ax, aw) - (-bx, bx)*(az, ay))
+static void emit_quat_mul(X86Emitter* emitter, const IrInstruction* instruction) {
+    // 下側だけの符号ビット（r11を使うのでポインタを読む前に作る）
+    emit(emitter, ASM_MOV, scratch_gpr(), asm_imm(INT64_MIN));
+    emit(emitter, ASM_MOVQ, asm_xmm(REGALLOC_SCRATCH_XMM), scratch_gpr());
+
+    X86Register dst = vector_pointer(emitter, instruction->args[0], REGALLOC_SCRATCH_GPR);
+    X86Register a = vector_pointer(emitter, instruction->a, X86_RAX);
+    X86Register b = vector_pointer(emitter, instruction->b, X86_RDX);
+
+    for (unsigned k = 0; k < 4; k++) emit_broadcast(emitter, 4 + k, b, 8 * k);
+    emit(emitter, ASM_XORPD, asm_xmm(5), asm_xmm(REGALLOC_SCRATCH_XMM));
+    emit(emitter, ASM_XORPD, asm_xmm(7), asm_xmm(REGALLOC_SCRATCH_XMM));
+    emit(emitter, ASM_MOVAPD, asm_xmm(0), asm_base(a, 0));
+    emit(emitter, ASM_MOVAPD, asm_xmm(1), asm_base(a, 16));
+    // xmm2 = (ax, aw)、xmm3 = (az, ay)
+    for (unsigned k = 0; k < 2; k++) {
+        emit(emitter, ASM_MOVAPD, asm_xmm(2 + k), asm_xmm(k));
+        emit(emitter, ASM_UNPCKHPD, asm_xmm(2 + k), asm_xmm(2 + k));
+        emit(emitter, ASM_UNPCKLPD, asm_xmm(2 + k), asm_xmm(k));
+    }
+
+    emit_product(emitter, 8, 0, 4);
+    emit_product(emitter, 10, 2, 5);
+    emit(emitter, ASM_ADDPD, asm_xmm(8), asm_xmm(10));
+    emit_product(emitter, 9, 3, 7);
+    emit_product(emitter, 10, 1, 6);
+    emit(emitter, ASM_SUBPD, asm_xmm(9), asm_xmm(10));
+    emit(emitter, ASM_ADDPD, asm_xmm(8), asm_xmm(9));
+
+    emit_product(emitter, 11, 1, 4);
+    emit_product(emitter, 12, 0, 6);
+    emit(emitter, ASM_ADDPD, asm_xmm(11), asm_xmm(12));
+    emit_product(emitter, 12, 2, 7);
+    emit_product(emitter, 13, 3, 5);
+    emit(emitter, ASM_SUBPD, asm_xmm(12), asm_xmm(13));
+    emit(emitter, ASM_ADDPD, asm_xmm(11), asm_xmm(12));
+
+    emit(emitter, ASM_MOVAPD, asm_base(dst, 0), asm_xmm(8));
+    emit(emitter, ASM_MOVAPD, asm_base(dst, 16), asm_xmm(11));
+}
+
+static SlangError emit_call(X86Emitter* emitter, const IrInstruction* instruction) {
+    ParallelMove* moves = NULL;
+    uint8_t* types = NULL;
+    Location* targets = NULL;
+    size_t count = instruction->arg_count;
+    size_t floats = 0;
+
+    if (count > 0) {
+        moves = malloc(count * sizeof(ParallelMove));
+        types = malloc(count);
+        targets = malloc(count * sizeof(Location));
+        if (moves == NULL || types == NULL || targets == NULL) {
+            free(moves);
+            free(types);
+            free(targets);
+            return SLANG_ERROR_INTERNAL;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        types[i] = emitter->function->value_types[instruction->args[i]];
+        floats += types[i] == IR_FLOAT;
+    }
+    SlangError error = abi_locations(types, count, targets);
+    if (error == SLANG_SUCCESS) {
+        for (size_t i = 0; i < count; i++) {
+            moves[i].to = targets[i];
+            moves[i].from = *location_of(emitter, instruction->args[i]);
+        }
+        emit_parallel_move(emitter, moves, count);
+
+        // 可変長引数の関数のため、alにXMMで渡す引数の数を入れる
+        if (floats > 0) emit(emitter, ASM_MOV, asm_reg32(X86_RAX), asm_imm((int64_t)floats));
+        emit1(emitter, ASM_CALL, asm_symbol_ref(instruction->symbol));
+
+        if (instruction->dest != IR_NO_VALUE) {
+            if (instruction->type == IR_FLOAT) {
+                store_xmm(emitter, instruction->dest, 0);
+            } else {
+                store_gpr(emitter, instruction->dest, X86_RAX);
+            }
+        }
+    }
+
+    free(moves);
+    free(types);
+    free(targets);
+    return error;
+}
+
+// 引数レジスタから割り当て先への転送
+static SlangError emit_parameters(X86Emitter* emitter) {
+    const IrFunction* function = emitter->function;
+    size_t count = function->param_count;
+    if (count == 0) return SLANG_SUCCESS;
+
+    uint8_t* types = calloc(count, 1);
+    IrValue* values = malloc(count * sizeof(IrValue));
+    Location* sources = malloc(count * sizeof(Location));
+    ParallelMove* moves = malloc(count * sizeof(ParallelMove));
+    if (types == NULL || values == NULL || sources == NULL || moves == NULL) {
+        free(types);
+        free(values);
+        free(sources);
+        free(moves);
+        return SLANG_ERROR_INTERNAL;
+    }
+
+    for (size_t i = 0; i < count; i++) values[i] = IR_NO_VALUE;
+    for (size_t i = 0; i < function->count; i++) {
+        const IrInstruction* instruction = &function->code[i];
+        if (instruction->op != IR_PARAM) continue;
+        types[instruction->imm.integer] = instruction->type;
+        values[instruction->imm.integer] = instruction->dest;
+    }
+
+    SlangError error = abi_locations(types, count, sources);
+    if (error == SLANG_SUCCESS) {
+        size_t move_count = 0;
+        for (size_t i = 0; i < count; i++) {
+            // 使われない引数の割り当て先は、生きている引数と重なっていることがある
+            if (values[i] == IR_NO_VALUE || emitter->use_counts[values[i]] == 0) continue;
+            if (location_of(emitter, values[i])->kind == LOCATION_NONE) continue;
+            moves[move_count].to = *location_of(emitter, values[i]);
+            moves[move_count].from = sources[i];
+            move_count++;
+        }
+        emit_parallel_move(emitter, moves, move_count);
+    }
+
+    free(types);
+    free(values);
+    free(sources);
+    free(moves);
+    return error;
+}
+
+// 即値にできる定数を探す（定義が1つで、使われるのがすべて整数演算・比較の右辺）
+static void find_immediates(X86Emitter* emitter) {
+    const IrFunction* function = emitter->function;
+
+    for (size_t i = 0; i < function->count; i++) {
+        const IrInstruction* instruction = &function->code[i];
+        if (instruction->dest != IR_NO_VALUE) emitter->def_counts[instruction->dest]++;
+        if (instruction->a != IR_NO_VALUE) emitter->use_counts[instruction->a]++;
+        if (instruction->b != IR_NO_VALUE) emitter->use_counts[instruction->b]++;
+        for (uint32_t j = 0; j < instruction->arg_count; j++) emitter->use_counts[instruction->args[j]]++;
+    }
+
+    for (size_t i = 0; i < function->count; i++) {
+        const IrInstruction* instruction = &function->code[i];
+        if (instruction->op == IR_CONST && instruction->type == IR_INT &&
+            emitter->def_counts[instruction->dest] == 1 && emitter->use_counts[instruction->dest] > 0 &&
+            instruction->imm.integer >= INT32_MIN && instruction->imm.integer <= INT32_MAX) {
+            emitter->immediate[instruction->dest] = true;
+            emitter->immediate_values[instruction->dest] = instruction->imm.integer;
+        }
+    }
+
+    for (size_t i = 0; i < function->count; i++) {
+        const IrInstruction* instruction = &function->code[i];
+        bool right_ok = instruction->type == IR_INT &&
+                        (instruction->op == IR_ADD || instruction->op == IR_SUB || instruction->op == IR_MUL ||
+                         ir_is_comparison((IrOpcode)instruction->op));
+        if (instruction->a != IR_NO_VALUE) emitter->immediate[instruction->a] = false;
+        if (instruction->b != IR_NO_VALUE && !right_ok) emitter->immediate[instruction->b] = false;
+        for (uint32_t j = 0; j < instruction->arg_count; j++) emitter->immediate[instruction->args[j]] = false;
+    }
+}
+
+static SlangError emit_instruction(X86Emitter* emitter, size_t index, size_t* next) {
+    const IrFunction* function = emitter->function;
+    const IrInstruction* instruction = &function->code[index];
+    bool is_float = instruction->type == IR_FLOAT;
+    *next = index + 1;
+
+    switch (instruction->op) {
+        case IR_CONST: {
+            if (emitter->immediate[instruction->dest]) break;
+            const Location* location = location_of(emitter, instruction->dest);
+            if (location->kind == LOCATION_NONE) break;
+
+            int64_t bits = instruction->imm.integer;
+            if (is_float) memcpy(&bits, &instruction->imm.number, sizeof(bits));
+
+            if (location->kind == LOCATION_GPR && bits == 0) {
+                emit(emitter, ASM_XOR, asm_reg32((X86Register)location->reg), asm_reg32((X86Register)location->reg));
+            } else if (location->kind == LOCATION_GPR) {
+                emit(emitter, ASM_MOV, asm_reg((X86Register)location->reg), asm_imm(bits));
+            } else if (location->kind == LOCATION_XMM && bits == 0) {
+                emit(emitter, ASM_XORPD, asm_xmm(location->reg), asm_xmm(location->reg));
+            } else if (location->kind == LOCATION_STACK && bits >= INT32_MIN && bits <= INT32_MAX) {
+                emit(emitter, ASM_MOV, location_operand(emitter, location), asm_imm(bits));
+            } else {
+                // 64ビットの値はr11を経由する（XMMへはmovq）
+                emit(emitter, ASM_MOV, scratch_gpr(), asm_imm(bits));
+                store_gpr(emitter, instruction->dest, REGALLOC_SCRATCH_GPR);
+            }
+            break;
+        }
+
+        case IR_ADDRESS: {
+            uint8_t target = int_target(emitter, instruction->dest);
+            emit(emitter, ASM_LEA, asm_reg((X86Register)target), asm_address(instruction->symbol));
+            store_gpr(emitter, instruction->dest, target);
+            break;
+        }
+
+        case IR_STACK_ALLOC: {
+            uint8_t target = int_target(emitter, instruction->dest);
+            emit(emitter, ASM_LEA, asm_reg((X86Register)target), asm_frame(-(int64_t)emitter->stack_offsets[index]));
+            store_gpr(emitter, instruction->dest, target);
+            break;
+        }
+
+        case IR_ALLOC:
+            emit(emitter, ASM_MOV, asm_reg32(X86_RDI), asm_imm(instruction->imm.integer));
+            emit1(emitter, ASM_CALL, asm_symbol_ref("malloc"));
+            store_gpr(emitter, instruction->dest, X86_RAX);
+            break;
+
+        case IR_DROP:
+            load_gpr(emitter, X86_RDI, instruction->a);
+            emit1(emitter, ASM_CALL, asm_symbol_ref("free"));
+            break;
+
+        case IR_LOAD: {
+            X86Register block = vector_pointer(emitter, instruction->a, REGALLOC_SCRATCH_GPR);
+            uint8_t target = float_target(emitter, instruction->dest);
+            emit(emitter, ASM_MOVSD, asm_xmm(target), asm_base(block, instruction->imm.integer));
+            store_xmm(emitter, instruction->dest, target);
+            break;
+        }
+
+        case IR_STORE: {
+            X86Register block = vector_pointer(emitter, instruction->a, REGALLOC_SCRATCH_GPR);
+            const Location* location = location_of(emitter, instruction->b);
+            uint8_t source = location->kind == LOCATION_XMM ? location->reg : REGALLOC_SCRATCH_XMM;
+            load_xmm(emitter, source, instruction->b);
+            emit(emitter, ASM_MOVSD, asm_base(block, instruction->imm.integer), asm_xmm(source));
+            break;
+        }
+
+        case IR_PARAM:
+            // プロローグで転送済み
+            break;
+
+        case IR_MOVE:
+            move_location(emitter, location_of(emitter, instruction->dest), location_of(emitter, instruction->a));
+            break;
+
+        case IR_LOAD_GLOBAL: {
+            const Location* location = location_of(emitter, instruction->dest);
+            if (location->kind == LOCATION_XMM) {
+                emit(emitter, ASM_MOVSD, asm_xmm(location->reg), asm_global(instruction->symbol));
+            } else {
+                uint8_t target = int_target(emitter, instruction->dest);
+                emit(emitter, ASM_MOV, asm_reg((X86Register)target), asm_global(instruction->symbol));
+                store_gpr(emitter, instruction->dest, target);
+            }
+            break;
+        }
+
+        case IR_STORE_GLOBAL: {
+            const Location* location = location_of(emitter, instruction->a);
+            if (location->kind == LOCATION_XMM) {
+                emit(emitter, ASM_MOVSD, asm_global(instruction->symbol), asm_xmm(location->reg));
+            } else {
+                uint8_t source = location->kind == LOCATION_GPR ? location->reg : REGALLOC_SCRATCH_GPR;
+                load_gpr(emitter, source, instruction->a);
+                emit(emitter, ASM_MOV, asm_global(instruction->symbol), asm_reg((X86Register)source));
+            }
+            break;
+        }
+
+        case IR_ADD:
+            if (is_float) emit_float_arithmetic(emitter, instruction, ASM_ADDSD, true);
+            else emit_int_arithmetic(emitter, instruction, ASM_ADD, true);
+            break;
+        case IR_SUB:
+            if (is_float) emit_float_arithmetic(emitter, instruction, ASM_SUBSD, false);
+            else emit_int_arithmetic(emitter, instruction, ASM_SUB, false);
+            break;
+        case IR_MUL:
+            if (is_float) emit_float_arithmetic(emitter, instruction, ASM_MULSD, true);
+            else emit_int_arithmetic(emitter, instruction, ASM_IMUL, true);
+            break;
+        case IR_DIV:
+            if (is_float) emit_float_arithmetic(emitter, instruction, ASM_DIVSD, false);
+            else emit_int_division(emitter, instruction);
+            break;
+        case IR_MOD:
+            if (is_float) return SLANG_ERROR_TYPE;
+            emit_int_division(emitter, instruction);
+            break;
+
+        case IR_NEG:
+            if (is_float) {
+                uint8_t target = float_target(emitter, instruction->dest);
+                load_xmm(emitter, target, instruction->a);
+                emit(emitter, ASM_MOV, scratch_gpr(), asm_imm(INT64_MIN));
+                emit(emitter, ASM_MOVQ, asm_xmm(REGALLOC_SCRATCH_XMM2), scratch_gpr());
+                emit(emitter, ASM_XORPD, asm_xmm(target), asm_xmm(REGALLOC_SCRATCH_XMM2));
+                store_xmm(emitter, instruction->dest, target);
+            } else {
+                uint8_t target = int_target(emitter, instruction->dest);
+                load_gpr(emitter, target, instruction->a);
+                emit1(emitter, ASM_NEG, asm_reg((X86Register)target));
+                store_gpr(emitter, instruction->dest, target);
+            }
+            break;
+
+        case IR_INT_TO_FLOAT: {
+            uint8_t target = float_target(emitter, instruction->dest);
+            emit(emitter, ASM_CVTSI2SD, asm_xmm(target), operand(emitter, instruction->a));
+            store_xmm(emitter, instruction->dest, target);
+            break;
+        }
+
+        case IR_NOT: {
+            X86Register target = (X86Register)int_target(emitter, instruction->dest);
+            emit(emitter, ASM_CMP, operand(emitter, instruction->a), asm_imm(0));
+            emit1(emitter, ASM_SETE, asm_reg8(target));
+            emit(emitter, ASM_MOVZX, asm_reg32(target), asm_reg8(target));
+            store_gpr(emitter, instruction->dest, target);
+            break;
+        }
+
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_LE:
+        case IR_GT:
+        case IR_GE: {
+            // 分岐だけが使う比較は結果を作らずにフラグで分岐する
+            const IrInstruction* following = index + 1 < function->count ? &function->code[index + 1] : NULL;
+            if (following != NULL && following->op == IR_BRANCH_FALSE && following->a == instruction->dest &&
+                emitter->use_counts[instruction->dest] == 1 && emitter->def_counts[instruction->dest] == 1) {
+                emit_compare_branch(emitter, instruction, index, following->imm.label);
+                *next = index + 2;
+            } else {
+                emit_compare(emitter, instruction);
+            }
+            break;
+        }
+
+        case IR_LABEL:
+            asm_label(emitter->out, function->name, instruction->imm.label);
+            break;
+
+        case IR_JUMP: {
+            // 直後のラベルへのジャンプは省く
+            const IrInstruction* following = index + 1 < function->count ? &function->code[index + 1] : NULL;
+            if (following != NULL && following->op == IR_LABEL && following->imm.label == instruction->imm.label) break;
+            emit1(emitter, ASM_JMP, label_ref(emitter, instruction->imm.label));
+            break;
+        }
+
+        case IR_BRANCH_FALSE: {
+            const Location* location = location_of(emitter, instruction->a);
+            if (location->kind == LOCATION_GPR) {
+                emit(emitter, ASM_TEST, asm_reg((X86Register)location->reg), asm_reg((X86Register)location->reg));
+            } else {
+                emit(emitter, ASM_CMP, location_operand(emitter, location), asm_imm(0));
+            }
+            emit1(emitter, ASM_JE, label_ref(emitter, instruction->imm.label));
+            break;
+        }
+
+        case IR_CALL:
+            return emit_call(emitter, instruction);
+
+        case IR_VEC_ADD:   emit_vector_elementwise(emitter, instruction, ASM_ADDPD); break;
+        case IR_VEC_SUB:   emit_vector_elementwise(emitter, instruction, ASM_SUBPD); break;
+        case IR_VEC_MUL:   emit_vector_elementwise(emitter, instruction, ASM_MULPD); break;
+        case IR_VEC_DIV:   emit_vector_elementwise(emitter, instruction, ASM_DIVPD); break;
+        case IR_VEC_SCALE: emit_vector_elementwise(emitter, instruction, ASM_MULPD); break;
+        case IR_VEC_COPY:  emit_vector_elementwise(emitter, instruction, ASM_MOVAPD); break;
+        case IR_VEC_DOT:   emit_vector_dot(emitter, instruction); break;
+        case IR_MAT4_MUL:  emit_mat4_mul(emitter, instruction); break;
+        case IR_QUAT_MUL:  emit_quat_mul(emitter, instruction); break;
+
+        case IR_RETURN:
+            // 値のないreturnも末尾に達したときと同じく0を返す（SSA形式から戻すと末尾はreturnになる）
+            if (instruction->a == IR_NO_VALUE) {
+                emit(emitter, ASM_XOR, asm_reg32(X86_RAX), asm_reg32(X86_RAX));
+            } else if (is_float) {
+                load_xmm(emitter, 0, instruction->a);
+            } else {
+                load_gpr(emitter, X86_RAX, instruction->a);
+            }
+            if (index + 1 < function->count) emit1(emitter, ASM_JMP, label_ref(emitter, exit_label(emitter)));
+            break;
+    }
+    return SLANG_SUCCESS;
+}
+
+// 関数1つ分の出力
+SlangError x86_emit_function(AsmWriter* out, const IrFunction* function, const RegisterAllocation* allocation, X86EmitStats* stats) {
+    if (out == NULL || function == NULL || function->name == NULL || allocation == NULL) return SLANG_ERROR_INTERNAL;
+    if (function->failed || allocation->count != function->value_count) return SLANG_ERROR_INTERNAL;
+
+    X86EmitStats local_stats = { 0, 0 };
+    X86Emitter emitter;
+    emitter.out = out;
+    emitter.function = function;
+    emitter.allocation = allocation;
+    emitter.stats = stats ? stats : &local_stats;
+
+    size_t value_count = function->value_count ? function->value_count : 1;
+    emitter.use_counts = calloc(value_count, sizeof(uint32_t));
+    emitter.def_counts = calloc(value_count, sizeof(uint32_t));
+    emitter.immediate = calloc(value_count, sizeof(bool));
+    emitter.immediate_values = calloc(value_count, sizeof(int64_t));
+    emitter.stack_offsets = calloc(function->count ? function->count : 1, sizeof(uint32_t));
+    if (emitter.use_counts == NULL || emitter.def_counts == NULL || emitter.immediate == NULL ||
+        emitter.immediate_values == NULL || emitter.stack_offsets == NULL) {
+        free(emitter.use_counts);
+        free(emitter.def_counts);
+        free(emitter.immediate);
+        free(emitter.immediate_values);
+        free(emitter.stack_offsets);
+        return SLANG_ERROR_INTERNAL;
+    }
+    find_immediates(&emitter);
+
+    // フレーム: rbp、退避レジスタ、スピルスロット、IR_STACK_ALLOCの領域の順。rspは16バイト境界に揃える
+    // （rbpは16バイト境界にあるので、領域もrbpから16の倍数の位置に置けば揃う）
+    uint8_t saved[SAVED_REGISTER_COUNT];
+    size_t saved_count = 0;
+    for (size_t i = 0; i < SAVED_REGISTER_COUNT; i++) {
+        if (allocation->callee_saved & (1u << saved_registers[i])) saved[saved_count++] = saved_registers[i];
+    }
+    emitter.frame_base = (uint32_t)(8 * saved_count);
+    uint32_t spill_size = 8 * allocation->spill_slots;
+    uint32_t padding = (16 - (emitter.frame_base + spill_size) % 16) % 16;
+    uint32_t locals_top = emitter.frame_base + spill_size + padding;
+    uint32_t locals = 0;
+    for (size_t i = 0; i < function->count; i++) {
+        if (function->code[i].op != IR_STACK_ALLOC) continue;
+        locals += ((uint32_t)function->code[i].imm.integer + 15) & ~15u;
+        emitter.stack_offsets[i] = locals_top + locals;
+    }
+    uint32_t frame_size = spill_size + padding + locals;
+
+    asm_write(out, "\n", 1);
+    // プロファイラが標本を優先度に振り分けられるように、宣言された優先度を局所記号に残す
+    if (function->priority != 0) {
+        size_t length = sizeof(PROFILER_PRIORITY_PREFIX) + strlen(function->name);
+        char* name = malloc(length);
+        if (name != NULL) {
+            snprintf(name, length, "%s%s", PROFILER_PRIORITY_PREFIX, function->name);
+            asm_absolute_symbol(out, name, function->priority);
+            free(name);
+        }
+    }
+    asm_symbol(out, function->name);
+    emit1(&emitter, ASM_PUSH, asm_reg(X86_RBP));
+    emit(&emitter, ASM_MOV, asm_reg(X86_RBP), asm_reg(X86_RSP));
+    for (size_t i = 0; i < saved_count; i++) emit1(&emitter, ASM_PUSH, asm_reg((X86Register)saved[i]));
+    if (frame_size > 0) emit(&emitter, ASM_SUB, asm_reg(X86_RSP), asm_imm(frame_size));
+
+    SlangError error = emit_parameters(&emitter);
+    for (size_t i = 0; i < function->count && error == SLANG_SUCCESS;) {
+        error = emit_instruction(&emitter, i, &i);
+    }
+
+    if (error == SLANG_SUCCESS) {
+        // 戻り値のないまま末尾に達したら0を返す
+        if (function->count == 0 || function->code[function->count - 1].op != IR_RETURN) {
+            emit(&emitter, ASM_XOR, asm_reg32(X86_RAX), asm_reg32(X86_RAX));
+        }
+        asm_label(out, function->name, exit_label(&emitter));
+        if (saved_count > 0) {
+            if (frame_size > 0) emit(&emitter, ASM_LEA, asm_reg(X86_RSP), asm_frame(-(int64_t)emitter.frame_base));
+            for (size_t i = saved_count; i-- > 0;) emit1(&emitter, ASM_POP, asm_reg((X86Register)saved[i]));
+            emit1(&emitter, ASM_POP, asm_reg(X86_RBP));
+        } else if (frame_size > 0) {
+            emit0(&emitter, ASM_LEAVE);
+        } else {
+            emit1(&emitter, ASM_POP, asm_reg(X86_RBP));
+        }
+        emit0(&emitter, ASM_RET);
+    }
+
+    free(emitter.use_counts);
+    free(emitter.def_counts);
+    free(emitter.immediate);
+    free(emitter.immediate_values);
+    free(emitter.stack_offsets);
+    return error;
+}
@@ -0,0 +1,414 @@
+#include "../include/x86_encoder.h"
+#include <string.h>
+
+typedef struct {
+    uint8_t* out;
+    size_t length;
+    X86Encoding* encoding;
+} Encoder;
+
+// 条件コード（ASM_CC_*の順、Jcc/SETccの下位4ビット）
+static const uint8_t condition_codes[] = {
+    0x4, 0x5, 0xC, 0xE, 0xF, 0xD, 0x2, 0x6, 0x7, 0x3, 0xA, 0xB
+};
+
+// 整数演算のModRM.reg（80/81/83のグループ1）
+typedef enum {
+    ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7
+} AluOp;
+
+static void put_byte(Encoder* e, uint8_t value) {
+    e->out[e->length++] = value;
+}
+
+static void put_int32(Encoder* e, int64_t value) {
+    uint32_t bits = (uint32_t)(int32_t)value;
+    for (int i = 0; i < 4; i++) put_byte(e, (uint8_t)(bits >> (8 * i)));
+}
+
+static void put_int64(Encoder* e, int64_t value) {
+    uint64_t bits = (uint64_t)value;
+    for (int i = 0; i < 8; i++) put_byte(e, (uint8_t)(bits >> (8 * i)));
+}
+
+static bool fits_int8(int64_t value) {
+    return value >= INT8_MIN && value <= INT8_MAX;
+}
+
+static bool fits_int32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static bool is_gpr(const AsmOperand* operand) {
+    return operand->kind == ASM_OPERAND_REG64 || operand->kind == ASM_OPERAND_REG32 ||
+           operand->kind == ASM_OPERAND_REG8;
+}
+
+static bool is_register(const AsmOperand* operand) {
+    return is_gpr(operand) || operand->kind == ASM_OPERAND_XMM;
+}
+
+static bool is_memory(const AsmOperand* operand) {
+    return asm_is_memory(*operand);
+}
+
+// spl/bpl/sil/dilはREXがないとah/ch/dh/bhになる
+static bool needs_byte_rex(const AsmOperand* operand) {
+    return operand->kind == ASM_OPERAND_REG8 && operand->reg >= 4 && operand->reg < 8;
+}
+
+static void record_fixup(Encoder* e, X86FixupKind kind, const AsmOperand* target) {
+    e->encoding->fixup = (uint8_t)kind;
+    e->encoding->fixup_offset = (uint8_t)e->length;
+    e->encoding->target = *target;
+}
+
+// [prefix] [REX] opcode ModRM [SIB] [disp] [imm]
+// regはModRM.regに入れる値（レジスタ番号または拡張オペコード）、rmはレジスタかメモリ
+static void encode_modrm(Encoder* e, uint8_t prefix, bool wide, const uint8_t* opcode, size_t opcode_length,
+                         uint8_t reg, bool reg_byte, const AsmOperand* rm, size_t immediate_size, int64_t immediate) {
+    if (prefix != 0) put_byte(e, prefix);
+
+    uint8_t rex = (uint8_t)((wide ? 8 : 0) | ((reg & 8) ? 4 : 0));
+    if ((is_register(rm) || rm->kind == ASM_OPERAND_BASE) && (rm->reg & 8)) rex |= 1;
+    if (rex != 0 || reg_byte || needs_byte_rex(rm)) put_byte(e, (uint8_t)(0x40 | rex));
+
+    for (size_t i = 0; i < opcode_length; i++) put_byte(e, opcode[i]);
+
+    uint8_t reg_bits = (uint8_t)((reg & 7) << 3);
+    switch (rm->kind) {
+        case ASM_OPERAND_FRAME:
+            // rbpを基底にするとdispが必須になる
+            if (fits_int8(rm->value)) {
+                put_byte(e, (uint8_t)(0x45 | reg_bits));
+                put_byte(e, (uint8_t)(int8_t)rm->value);
+            } else {
+                put_byte(e, (uint8_t)(0x85 | reg_bits));
+                put_int32(e, rm->value);
+            }
+            break;
+        case ASM_OPERAND_STACK:
+            // rspを基底にするとSIBが必須になる
+            if (rm->value == 0) {
+                put_byte(e, (uint8_t)(0x04 | reg_bits));
+                put_byte(e, 0x24);
+            } else if (fits_int8(rm->value)) {
+                put_byte(e, (uint8_t)(0x44 | reg_bits));
+                put_byte(e, 0x24);
+                put_byte(e, (uint8_t)(int8_t)rm->value);
+            } else {
+                put_byte(e, (uint8_t)(0x84 | reg_bits));
+                put_byte(e, 0x24);
+                put_int32(e, rm->value);
+            }
+            break;
+        case ASM_OPERAND_BASE: {
+            // rsp/r12はSIBが必須、rbp/r13はdispが必須になる
+            uint8_t base = (uint8_t)(rm->reg & 7);
+            uint8_t mode = rm->value == 0 && base != 5 ? 0x00 : fits_int8(rm->value) ? 0x40 : 0x80;
+            put_byte(e, (uint8_t)(mode | reg_bits | base));
+            if (base == 4) put_byte(e, 0x24);
+            if (mode == 0x40) put_byte(e, (uint8_t)(int8_t)rm->value);
+            else if (mode == 0x80) put_int32(e, rm->value);
+            break;
+        }
+        case ASM_OPERAND_GLOBAL:
+        case ASM_OPERAND_ADDRESS:
+        case ASM_OPERAND_STRING:
+            put_byte(e, (uint8_t)(0x05 | reg_bits));
+            record_fixup(e, X86_FIXUP_PC32, rm);
+            put_int32(e, 0);
+            break;
+        default:
+            put_byte(e, (uint8_t)(0xC0 | reg_bits | (rm->reg & 7)));
+            break;
+    }
+
+    if (immediate_size == 1) put_byte(e, (uint8_t)(int8_t)immediate);
+    else if (immediate_size == 4) put_int32(e, immediate);
+}
+
+static void encode_rm(Encoder* e, uint8_t prefix, bool wide, const uint8_t* opcode, size_t opcode_length,
+                      uint8_t reg, const AsmOperand* rm) {
+    encode_modrm(e, prefix, wide, opcode, opcode_length, reg, false, rm, 0, 0);
+}
+
+// 1バイトのオペコードの短縮
+#define OPCODE1(value) ((const uint8_t[]){ value }), 1
+#define OPCODE2(first, second) ((const uint8_t[]){ first, second }), 2
+
+// オペランドの大きさ（メモリはすべてqword）
+static bool is_wide(const AsmOperand* a, const AsmOperand* b) {
+    return a->kind == ASM_OPERAND_REG64 || b->kind == ASM_OPERAND_REG64 || (is_memory(a) && !is_gpr(b)) ||
+           (is_memory(b) && !is_gpr(a));
+}
+
+// add/or/and/sub/xor/cmp
+static bool encode_alu(Encoder* e, AluOp alu, const AsmOperand* a, const AsmOperand* b) {
+    uint8_t base = (uint8_t)(alu * 8);
+
+    if (b->kind == ASM_OPERAND_IMM) {
+        if (!is_gpr(a) && !is_memory(a)) return false;
+        if (a->kind == ASM_OPERAND_REG8) {
+            if (!fits_int8(b->value)) return false;
+            encode_modrm(e, 0, false, OPCODE1(0x80), alu, false, a, 1, b->value);
+        } else if (fits_int8(b->value)) {
+            encode_modrm(e, 0, a->kind != ASM_OPERAND_REG32, OPCODE1(0x83), alu, false, a, 1, b->value);
+        } else if (fits_int32(b->value)) {
+            encode_modrm(e, 0, a->kind != ASM_OPERAND_REG32, OPCODE1(0x81), alu, false, a, 4, b->value);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    if (is_gpr(b) && (is_gpr(a) || is_memory(a))) {
+        if (is_gpr(a) && a->kind != b->kind) return false;
+        bool byte = b->kind == ASM_OPERAND_REG8;
+        encode_modrm(e, 0, b->kind == ASM_OPERAND_REG64 || (is_memory(a) && !byte), OPCODE1(byte ? base : base + 1),
+                     b->reg, needs_byte_rex(b), a, 0, 0);
+        return true;
+    }
+    if (is_gpr(a) && is_memory(b)) {
+        bool byte = a->kind == ASM_OPERAND_REG8;
+        encode_modrm(e, 0, !byte && a->kind == ASM_OPERAND_REG64, OPCODE1(byte ? base + 2 : base + 3),
+                     a->reg, needs_byte_rex(a), b, 0, 0);
+        return true;
+    }
+    return false;
+}
+
+static bool encode_mov(Encoder* e, const AsmOperand* a, const AsmOperand* b) {
+    if (b->kind == ASM_OPERAND_IMM) {
+        if (a->kind == ASM_OPERAND_REG32) {
+            if (a->reg & 8) put_byte(e, 0x41);
+            put_byte(e, (uint8_t)(0xB8 + (a->reg & 7)));
+            put_int32(e, b->value);
+        } else if (a->kind == ASM_OPERAND_REG64 && !fits_int32(b->value)) {
+            put_byte(e, (uint8_t)(0x48 | ((a->reg & 8) ? 1 : 0)));
+            put_byte(e, (uint8_t)(0xB8 + (a->reg & 7)));
+            put_int64(e, b->value);
+        } else if ((a->kind == ASM_OPERAND_REG64 || is_memory(a)) && fits_int32(b->value)) {
+            encode_modrm(e, 0, true, OPCODE1(0xC7), 0, false, a, 4, b->value);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    if (is_gpr(b) && (is_gpr(a) || is_memory(a))) {
+        if (is_gpr(a) && a->kind != b->kind) return false;
+        bool byte = b->kind == ASM_OPERAND_REG8;
+        encode_modrm(e, 0, b->kind == ASM_OPERAND_REG64, OPCODE1(byte ? 0x88 : 0x89), b->reg, needs_byte_rex(b), a, 0, 0);
+        return true;
+    }
+    if (is_gpr(a) && is_memory(b)) {
+        bool byte = a->kind == ASM_OPERAND_REG8;
+        encode_modrm(e, 0, a->kind == ASM_OPERAND_REG64, OPCODE1(byte ? 0x8A : 0x8B), a->reg, needs_byte_rex(a), b, 0, 0);
+        return true;
+    }
+    return false;
+}
+
+// SSE2の命令（xmm, xmm/m64）。パックド命令のメモリは16バイト境界の128ビットなので、
+// 8バイトのスロットやグローバル変数は受け付けず、ベクトルの要素を指すasm_baseだけを受け付ける
+static bool encode_sse(Encoder* e, uint8_t prefix, uint8_t opcode, const AsmOperand* a, const AsmOperand* b) {
+    bool packed = prefix == 0x66 && opcode != 0x2E && opcode != 0x2F;
+    bool memory_ok = packed ? b->kind == ASM_OPERAND_BASE : is_memory(b);
+    if (a->kind != ASM_OPERAND_XMM || (b->kind != ASM_OPERAND_XMM && !memory_ok)) return false;
+    encode_rm(e, prefix, false, OPCODE2(0x0F, opcode), a->reg, b);
+    return true;
+}
+
+static bool encode_unary_group(Encoder* e, uint8_t extension, const AsmOperand* a) {
+    if (!is_gpr(a) && !is_memory(a)) return false;
+    if (a->kind == ASM_OPERAND_REG8) return false;
+    encode_rm(e, 0, a->kind != ASM_OPERAND_REG32, OPCODE1(0xF7), extension, a);
+    return true;
+}
+
+static bool encode_branch(Encoder* e, const uint8_t* opcode, size_t opcode_length, const AsmOperand* target) {
+    if (target->kind != ASM_OPERAND_LABEL) return false;
+    for (size_t i = 0; i < opcode_length; i++) put_byte(e, opcode[i]);
+    record_fixup(e, X86_FIXUP_LABEL, target);
+    put_int32(e, 0);
+    return true;
+}
+
+bool x86_encode(AsmOp op, AsmOperand a, AsmOperand b, uint8_t* out, X86Encoding* encoding) {
+    Encoder e = { out, 0, encoding };
+    memset(encoding, 0, sizeof(X86Encoding));
+    bool ok = false;
+
+    if (op >= ASM_SETE && op <= ASM_SETNP) {
+        if (a.kind != ASM_OPERAND_REG8) return false;
+        encode_modrm(&e, 0, false, OPCODE2(0x0F, (uint8_t)(0x90 | condition_codes[op - ASM_SETE])), 0, false, &a, 0, 0);
+        encoding->length = (uint8_t)e.length;
+        return true;
+    }
+    if (op >= ASM_JE && op <= ASM_JNP) {
+        ok = encode_branch(&e, OPCODE2(0x0F, (uint8_t)(0x80 | condition_codes[op - ASM_JE])), &a);
+        encoding->length = (uint8_t)e.length;
+        return ok;
+    }
+
+    switch (op) {
+        case ASM_MOV:
+            ok = encode_mov(&e, &a, &b);
+            break;
+
+        case ASM_MOVZX:
+            if ((a.kind == ASM_OPERAND_REG32 || a.kind == ASM_OPERAND_REG64) && b.kind == ASM_OPERAND_REG8) {
+                encode_rm(&e, 0, a.kind == ASM_OPERAND_REG64, OPCODE2(0x0F, 0xB6), a.reg, &b);
+                ok = true;
+            }
+            break;
+
+        case ASM_MOVQ:
+            if (a.kind == ASM_OPERAND_XMM && (b.kind == ASM_OPERAND_REG64 || is_memory(&b))) {
+                encode_rm(&e, 0x66, true, OPCODE2(0x0F, 0x6E), a.reg, &b);
+                ok = true;
+            } else if ((a.kind == ASM_OPERAND_REG64 || is_memory(&a)) && b.kind == ASM_OPERAND_XMM) {
+                encode_rm(&e, 0x66, true, OPCODE2(0x0F, 0x7E), b.reg, &a);
+                ok = true;
+            }
+            break;
+
+        case ASM_MOVSD:
+            if (is_memory(&a) && b.kind == ASM_OPERAND_XMM) {
+                encode_rm(&e, 0xF2, false, OPCODE2(0x0F, 0x11), b.reg, &a);
+                ok = true;
+            } else {
+                ok = encode_sse(&e, 0xF2, 0x10, &a, &b);
+            }
+            break;
+
+        case ASM_MOVAPD:
+            if (a.kind == ASM_OPERAND_BASE && b.kind == ASM_OPERAND_XMM) {
+                encode_rm(&e, 0x66, false, OPCODE2(0x0F, 0x29), b.reg, &a);
+                ok = true;
+            } else {
+                ok = encode_sse(&e, 0x66, 0x28, &a, &b);
+            }
+            break;
+        case ASM_ADDSD:  ok = encode_sse(&e, 0xF2, 0x58, &a, &b); break;
+        case ASM_SUBSD:  ok = encode_sse(&e, 0xF2, 0x5C, &a, &b); break;
+        case ASM_MULSD:  ok = encode_sse(&e, 0xF2, 0x59, &a, &b); break;
+        case ASM_DIVSD:  ok = encode_sse(&e, 0xF2, 0x5E, &a, &b); break;
+        case ASM_XORPD:  ok = encode_sse(&e, 0x66, 0x57, &a, &b); break;
+        case ASM_ADDPD:  ok = encode_sse(&e, 0x66, 0x58, &a, &b); break;
+        case ASM_SUBPD:  ok = encode_sse(&e, 0x66, 0x5C, &a, &b); break;
+        case ASM_MULPD:  ok = encode_sse(&e, 0x66, 0x59, &a, &b); break;
+        case ASM_DIVPD:  ok = encode_sse(&e, 0x66, 0x5E, &a, &b); break;
+        case ASM_UNPCKLPD: ok = encode_sse(&e, 0x66, 0x14, &a, &b); break;
+        case ASM_UNPCKHPD: ok = encode_sse(&e, 0x66, 0x15, &a, &b); break;
+        case ASM_UCOMISD: ok = encode_sse(&e, 0x66, 0x2E, &a, &b); break;
+        case ASM_COMISD: ok = encode_sse(&e, 0x66, 0x2F, &a, &b); break;
+
+        case ASM_CVTSI2SD:
+            if (a.kind == ASM_OPERAND_XMM && (b.kind == ASM_OPERAND_REG64 || is_memory(&b))) {
+                encode_rm(&e, 0xF2, true, OPCODE2(0x0F, 0x2A), a.reg, &b);
+                ok = true;
+            }
+            break;
+
+        case ASM_LEA:
+            if (a.kind == ASM_OPERAND_REG64 && is_memory(&b)) {
+                encode_rm(&e, 0, true, OPCODE1(0x8D), a.reg, &b);
+                ok = true;
+            }
+            break;
+
+        case ASM_PUSH:
+            if (a.kind == ASM_OPERAND_REG64) {
+                if (a.reg & 8) put_byte(&e, 0x41);
+                put_byte(&e, (uint8_t)(0x50 + (a.reg & 7)));
+                ok = true;
+            } else if (is_memory(&a)) {
+                encode_rm(&e, 0, false, OPCODE1(0xFF), 6, &a);
+                ok = true;
+            }
+            break;
+
+        case ASM_POP:
+            if (a.kind == ASM_OPERAND_REG64) {
+                if (a.reg & 8) put_byte(&e, 0x41);
+                put_byte(&e, (uint8_t)(0x58 + (a.reg & 7)));
+                ok = true;
+            } else if (is_memory(&a)) {
+                encode_rm(&e, 0, false, OPCODE1(0x8F), 0, &a);
+                ok = true;
+            }
+            break;
+
+        case ASM_ADD: ok = encode_alu(&e, ALU_ADD, &a, &b); break;
+        case ASM_SUB: ok = encode_alu(&e, ALU_SUB, &a, &b); break;
+        case ASM_AND: ok = encode_alu(&e, ALU_AND, &a, &b); break;
+        case ASM_OR:  ok = encode_alu(&e, ALU_OR, &a, &b); break;
+        case ASM_XOR: ok = encode_alu(&e, ALU_XOR, &a, &b); break;
+        case ASM_CMP: ok = encode_alu(&e, ALU_CMP, &a, &b); break;
+
+        case ASM_IMUL:
+            if (a.kind != ASM_OPERAND_REG64 && a.kind != ASM_OPERAND_REG32) break;
+            if (b.kind == ASM_OPERAND_IMM) {
+                bool short_form = fits_int8(b.value);
+                if (!short_form && !fits_int32(b.value)) break;
+                encode_modrm(&e, 0, a.kind == ASM_OPERAND_REG64, OPCODE1(short_form ? 0x6B : 0x69), a.reg, false, &a,
+                             short_form ? 1 : 4, b.value);
+                ok = true;
+            } else if ((is_gpr(&b) && b.kind == a.kind) || is_memory(&b)) {
+                encode_rm(&e, 0, a.kind == ASM_OPERAND_REG64, OPCODE2(0x0F, 0xAF), a.reg, &b);
+                ok = true;
+            }
+            break;
+
+        case ASM_IDIV: ok = encode_unary_group(&e, 7, &a); break;
+        case ASM_NEG:  ok = encode_unary_group(&e, 3, &a); break;
+
+        case ASM_TEST:
+            if (is_gpr(&b) && (is_memory(&a) || a.kind == b.kind)) {
+                bool byte = b.kind == ASM_OPERAND_REG8;
+                encode_modrm(&e, 0, is_wide(&a, &b) && !byte, OPCODE1(byte ? 0x84 : 0x85), b.reg, needs_byte_rex(&b), &a, 0, 0);
+                ok = true;
+            }
+            break;
+
+        case ASM_CQO:
+            put_byte(&e, 0x48);
+            put_byte(&e, 0x99);
+            ok = true;
+            break;
+
+        case ASM_JMP:
+            ok = encode_branch(&e, OPCODE1(0xE9), &a);
+            break;
+
+        case ASM_CALL:
+            if (a.kind == ASM_OPERAND_SYMBOL) {
+                put_byte(&e, 0xE8);
+                record_fixup(&e, X86_FIXUP_PLT32, &a);
+                put_int32(&e, 0);
+                ok = true;
+            } else if (a.kind == ASM_OPERAND_REG64 || is_memory(&a)) {
+                encode_rm(&e, 0, false, OPCODE1(0xFF), 2, &a);
+                ok = true;
+            }
+            break;
+
+        case ASM_RET:
+            put_byte(&e, 0xC3);
+            ok = true;
+            break;
+
+        case ASM_LEAVE:
+            put_byte(&e, 0xC9);
+            ok = true;
+            break;
+
+        default:
+            break;
+    }
+
+    encoding->length = (uint8_t)e.length;
+    return ok;
+}
@@ -0,0 +1,79 @@
+// keywords.defからキーワードの完全ハッシュ表を生成する
+// 使い方: gen_keywords > keyword_table.h
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "keyword.h"
+
+typedef struct {
+    const char* text;
+    const char* type;
+} KeywordSpec;
+
+static const KeywordSpec keywords[] = {
+#define KEYWORD(text, type) {text, #type},
+#include "keywords.def"
+#undef KEYWORD
+};
+
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+#define MAX_TABLE_SIZE 4096
+#define MAX_MULTIPLIER 256
+
+// 与えたパラメータで衝突がないか確認する
+static bool try_parameters(uint32_t size, uint32_t k1, uint32_t k2, int* slots) {
+    for (uint32_t i = 0; i < size; i++) slots[i] = -1;
+
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        uint32_t slot = keyword_hash(keywords[i].text, strlen(keywords[i].text), k1, k2) & (size - 1);
+        if (slots[slot] != -1) return false;
+        slots[slot] = (int)i;
+    }
+    return true;
+}
+
+int main(void) {
+    static int slots[MAX_TABLE_SIZE];
+    size_t min_length = SIZE_MAX;
+    size_t max_length = 0;
+
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        size_t length = strlen(keywords[i].text);
+        if (length < min_length) min_length = length;
+        if (length > max_length) max_length = length;
+    }
+
+    // 最小の表の大きさから順に、衝突しない乗数の組を探す
+    uint32_t size = 1;
+    while (size < KEYWORD_COUNT) size *= 2;
+
+    for (; size <= MAX_TABLE_SIZE; size *= 2) {
+        for (uint32_t k1 = 1; k1 < MAX_MULTIPLIER; k1++) {
+            for (uint32_t k2 = 0; k2 < MAX_MULTIPLIER; k2++) {
+                if (!try_parameters(size, k1, k2, slots)) continue;
+
+                printf("// このファイルは tools/gen_keywords.c が生成する。編集しないこと。\n");
+                printf("#define KEYWORD_HASH_K1 %uu\n", k1);
+                printf("#define KEYWORD_HASH_K2 %uu\n", k2);
+                printf("#define KEYWORD_TABLE_MASK %uu\n", size - 1);
+                printf("#define KEYWORD_MIN_LENGTH %zu\n", min_length);
+                printf("#define KEYWORD_MAX_LENGTH %zu\n\n", max_length);
+                printf("static const KeywordEntry keyword_table[%u] = {\n", size);
+                for (uint32_t slot = 0; slot < size; slot++) {
+                    if (slots[slot] == -1) {
+                        printf("    {NULL, 0, TOKEN_IDENTIFIER},\n");
+                    } else {
+                        const KeywordSpec* kw = &keywords[slots[slot]];
+                        printf("    {\"%s\", %zu, %s},\n", kw->text, strlen(kw->text), kw->type);
+                    }
+                }
+                printf("};\n");
+                return 0;
+            }
+        }
+    }
+
+    fprintf(stderr, "gen_keywords: no perfect hash found for %zu keywords\n", (size_t)KEYWORD_COUNT);
+    return 1;
+}